@@ -0,0 +1,128 @@
+# Copyright (c) 2019, XMOS Ltd, All rights reserved
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import os
+import struct
+import sys
+
+# See audio_compress.h for the format
+SYNC = 0x5AAC
+HEADER_BYTES = 10
+MAX_ORDER = 4
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(
+        description="Decompresses the audio frames compressed by audio_compress_frame(), "
+                    "as sent over TCP when built with appconfQUEUE_TO_TCP_COMPRESSION, "
+                    "into raw little endian PCM, with the channels of each sample interleaved")
+    parser.add_argument("input", nargs="?", help="The compressed stream, or stdin if not given")
+    parser.add_argument("-output", help="The file to write the PCM to, or stdout if not given")
+
+    return parser.parse_args()
+
+class BitReader(object):
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def bits(self, count):
+        value = 0
+        for _ in range(count):
+            byte = self.data[self.pos >> 3]
+            value = (value << 1) | ((byte >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+    def signed(self, count):
+        value = self.bits(count)
+        if count > 0 and value & (1 << (count - 1)):
+            value -= 1 << count
+        return value
+
+    def rice(self, k):
+        q = 0
+        while self.bits(1) == 0:
+            q += 1
+        u = (q << k) | self.bits(k)
+        return (u >> 1) ^ -(u & 1)
+
+    def byte_align(self):
+        self.pos = (self.pos + 7) & ~7
+
+def fixed_predict(h, order):
+    """ The prediction from the order samples before, h[0] being the one just before """
+    if order == 0:
+        return 0
+    if order == 1:
+        return h[0]
+    if order == 2:
+        return 2 * h[0] - h[1]
+    if order == 3:
+        return 3 * h[0] - 3 * h[1] + h[2]
+    return 4 * h[0] - 6 * h[1] + 4 * h[2] - h[3]
+
+def decode_subframe(data, length, vbits):
+    order = data[0] - 1
+    k = data[1]
+    reader = BitReader(data[2:])
+    samples = []
+    h = [0] * MAX_ORDER
+
+    for i in range(length):
+        if order < 0 or i < order:
+            x = reader.signed(vbits)
+        else:
+            x = fixed_predict(h, order) + reader.rice(k)
+        samples.append(x)
+        h = [x] + h[:-1]
+
+    reader.byte_align()
+    return samples, 2 + (reader.pos >> 3)
+
+def decode_frame(data):
+    """ Returns the channels of the frame at the start of data, and the bytes it took """
+    sync, sample_bits, channels, shift, _, length, payload = struct.unpack_from("<HBBBBHH", data)
+    if sync != SYNC:
+        raise ValueError("Lost sync with the compressed stream")
+
+    frame = []
+    offset = HEADER_BYTES
+    for _ in range(channels):
+        samples, used = decode_subframe(data[offset:], length, sample_bits - shift)
+        frame.append([x << shift for x in samples])
+        offset += used
+
+    return frame, sample_bits, HEADER_BYTES + payload
+
+def main(input_path, output_path):
+    infile = open(input_path, "rb") if input_path else getattr(sys.stdin, "buffer", sys.stdin)
+    outfile = open(output_path, "wb") if output_path else getattr(sys.stdout, "buffer", sys.stdout)
+    data = bytearray()
+
+    while True:
+        chunk = os.read(infile.fileno(), 4096)
+        if not chunk:
+            break
+        data += chunk
+
+        while len(data) >= HEADER_BYTES:
+            payload = data[8] | (data[9] << 8)
+            if len(data) < HEADER_BYTES + payload:
+                break
+            frame, sample_bits, used = decode_frame(data)
+            del data[:used]
+
+            fmt = "<i" if sample_bits == 32 else "<h"
+            pcm = bytearray()
+            for samples in zip(*frame):
+                for x in samples:
+                    pcm += struct.pack(fmt, x)
+            outfile.write(pcm)
+        outfile.flush()
+
+if __name__ == "__main__":
+    args = parse_arguments()
+    main(args.input, args.output)
@@ -0,0 +1,69 @@
+# Copyright (c) 2019, XMOS Ltd, All rights reserved
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import os
+import socket
+import struct
+import sys
+import time
+
+# See udp_stream_to_queue.c for the format
+RTP_VERSION = 2
+RTP_PAYLOAD_TYPE = 96
+RTP_SSRC = 0x484F5354
+PORT = 54324
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(
+        description="Sends raw little endian mono PCM to an application built with "
+                    "CONFIG=udp_speaker, as an RTP stream of one frame per packet, "
+                    "at the rate it is to be played at")
+    parser.add_argument("ip", help="The IP of the board")
+    parser.add_argument("input", nargs="?", help="The PCM to send, or stdin if not given")
+    parser.add_argument("-port", type=int, default=PORT, help="The port to send to")
+    parser.add_argument("-rate", type=int, default=48000, help="The sample rate")
+    parser.add_argument("-bits", type=int, default=32, choices=[16, 32], help="The bits in each sample")
+    parser.add_argument("-frame", type=int, default=256, help="The samples in each frame")
+
+    return parser.parse_args()
+
+def read_frame(infile, frame_bytes):
+    """ Returns the next whole frame, or None at the end of the input """
+    data = bytearray()
+    while len(data) < frame_bytes:
+        chunk = os.read(infile.fileno(), frame_bytes - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+def main(ip, input_path, port, rate, bits, frame):
+    infile = open(input_path, "rb") if input_path else getattr(sys.stdin, "buffer", sys.stdin)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    frame_bytes = frame * bits // 8
+    sequence = 0
+    timestamp = 0
+    start = time.time()
+
+    while True:
+        data = read_frame(infile, frame_bytes)
+        if data is None:
+            break
+
+        header = struct.pack(">BBHII", RTP_VERSION << 6, RTP_PAYLOAD_TYPE, sequence & 0xFFFF,
+                             timestamp & 0xFFFFFFFF, RTP_SSRC)
+        sock.sendto(header + data, (ip, port))
+        sequence += 1
+        timestamp += frame
+
+        # A file is sent no faster than it plays, while a live input paces itself
+        delay = start + timestamp / rate - time.time()
+        if delay > 0:
+            time.sleep(delay)
+
+if __name__ == "__main__":
+    args = parse_arguments()
+    main(args.ip, args.input, args.port, args.rate, args.bits, args.frame)
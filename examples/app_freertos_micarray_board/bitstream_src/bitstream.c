@@ -3,6 +3,13 @@
 #include "soc.h"
 #include "bitstream.h"
 #include "bitstream_devices.h"
+#include "micarray_dev_conf_defaults.h"
+
+#if MICARRAYCONF_DMA_STREAMING
+#define MICARRAY_DEV_FLAGS SOC_PERIPHERAL_TX_DMA_STREAMING
+#else
+#define MICARRAY_DEV_FLAGS 0
+#endif
 
 static int initialized;
 
@@ -11,6 +18,9 @@ soc_peripheral_t bitstream_ethernet_devices[BITSTREAM_ETHERNET_DEVICE_COUNT];
 soc_peripheral_t bitstream_i2s_devices[BITSTREAM_I2S_DEVICE_COUNT];
 soc_peripheral_t bitstream_i2c_devices[BITSTREAM_I2C_DEVICE_COUNT];
 soc_peripheral_t bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_COUNT];
+#if SOC_LOOPBACK_PERIPHERAL_USED
+soc_peripheral_t bitstream_loopback_devices[BITSTREAM_LOOPBACK_DEVICE_COUNT];
+#endif
 
 void device_register(
         chanend mic_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
@@ -18,14 +28,18 @@ void device_register(
         chanend i2s_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
         chanend i2c_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
         chanend t0_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
-        chanend t1_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT])
+        chanend t1_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
+        chanend loopback_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT])
 {
-    bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_A] = soc_peripheral_register(mic_dev_ch);
+    bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_A] = soc_peripheral_register_flags(mic_dev_ch, MICARRAY_DEV_FLAGS);
     bitstream_ethernet_devices[BITSTREAM_ETHERNET_DEVICE_A] = soc_peripheral_register(eth_dev_ch);
     bitstream_i2s_devices[BITSTREAM_I2S_DEVICE_A] = soc_peripheral_register(i2s_dev_ch);
     bitstream_i2c_devices[BITSTREAM_I2C_DEVICE_A] = soc_peripheral_register(i2c_dev_ch);
     bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_A] = soc_peripheral_register(t0_gpio_dev_ch);
     bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_B] = soc_peripheral_register(t1_gpio_dev_ch);
+#if SOC_LOOPBACK_PERIPHERAL_USED
+    bitstream_loopback_devices[BITSTREAM_LOOPBACK_DEVICE_A] = soc_peripheral_register(loopback_dev_ch);
+#endif
 
     initialized = 1;
 }
@@ -60,7 +74,7 @@ void soc_tile0_bitstream(
     i2c_dev_ch[SOC_PERIPHERAL_FROM_DMA_CH] = 0;
     i2c_dev_ch[SOC_PERIPHERAL_TO_DMA_CH] = 0;
     i2c_dev_ch[SOC_PERIPHERAL_CONTROL_CH] = soc_channel_establish(xTile1Chan, soc_channel_inout);
-    i2c_dev_ch[SOC_PERIPHERAL_IRQ_CH] = 0;
+    i2c_dev_ch[SOC_PERIPHERAL_IRQ_CH] = soc_channel_establish(xTile1Chan, soc_channel_inout);
 
     t1_gpio_dev_ch[SOC_PERIPHERAL_FROM_DMA_CH] = 0;
     t1_gpio_dev_ch[SOC_PERIPHERAL_TO_DMA_CH] = 0;
@@ -95,7 +109,7 @@ void soc_tile1_bitstream(
     i2c_dev_ch[SOC_PERIPHERAL_FROM_DMA_CH] = 0;
     i2c_dev_ch[SOC_PERIPHERAL_TO_DMA_CH] = 0;
     i2c_dev_ch[SOC_PERIPHERAL_CONTROL_CH] = soc_channel_establish(xTile0Chan, soc_channel_inout);
-    i2c_dev_ch[SOC_PERIPHERAL_IRQ_CH] = 0;
+    i2c_dev_ch[SOC_PERIPHERAL_IRQ_CH] = soc_channel_establish(xTile0Chan, soc_channel_inout);
 
     t1_gpio_dev_ch[SOC_PERIPHERAL_FROM_DMA_CH] = 0;
     t1_gpio_dev_ch[SOC_PERIPHERAL_TO_DMA_CH] = 0;
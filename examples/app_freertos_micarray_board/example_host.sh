@@ -3,6 +3,8 @@
 function trace_help() {
     echo "Options:"
     echo "--ncaplay / -n IP : Connect to a stream over TCP and pipe into aplay"
+    echo "--ncaplayz / -z IP : Connect to a compressed stream over TCP, decompress it and pipe into aplay"
+    echo "--speaker / -s IP : Record from the default capture device and send it to the board to play"
     echo "--udpcli  / -u IP : Connect to CLI"
     echo "--thruput / -t IP : Run the throughput test"
     return
@@ -19,6 +21,12 @@ then
     if [ "$1" == "--ncaplay" ] || [ "$1" == "-n" ]
     then
         ncat --recv-only $2 54321 | aplay --format=S32_LE --rate=48000 --file-type=raw --buffer-size=14000
+    elif [ "$1" == "--ncaplayz" ] || [ "$1" == "-z" ]
+    then
+        ncat --recv-only $2 54321 | python "$(dirname "$0")/Python/audio_decompress.py" | aplay --format=S32_LE --rate=48000 --file-type=raw --buffer-size=14000
+    elif [ "$1" == "--speaker" ] || [ "$1" == "-s" ]
+    then
+        arecord --format=S32_LE --rate=48000 --channels=1 --file-type=raw | python "$(dirname "$0")/Python/rtp_send.py" $2
     elif [ "$1" == "--udpcli" ] || [ "$1" == "-u" ]
     then
         ncat -u $2 5432
@@ -5,10 +5,166 @@
 
 /* Audio Pipeline defines */
 #define appconfAUDIO_PIPELINE_STAGE_ONE_GAIN   42
-#define appconfMIC_FRAME_LENGTH                256
+#define appconfMIC_FRAME_LENGTH                (1 << MICARRAYCONF_FRAME_SIZE_LOG2)
+/* Enough mic frames for the mic DMA ring, all the queues, the I2S DMA ring and an extra ASRC output */
+#define appconfMIC_FRAME_POOL_COUNT            15
+#if configNUM_CORES >= 4
+/*
+ * The RTOS core each audio pipeline stage runs on, or -1 for any.
+ * Core 0 is left to the network stack and the other tasks. The first
+ * stage runs on the core that takes the mic array's interrupts, and
+ * output on the core that takes the I2S interrupts.
+ */
+#define appconfAUDIO_PIPELINE_BEAMFORMER_CORE  1
+#define appconfAUDIO_PIPELINE_NOISE_SUPPRESSOR_CORE 1
+#define appconfAUDIO_PIPELINE_VAD_CORE         1
+#define appconfAUDIO_PIPELINE_GAIN_CORE        2
+#define appconfAUDIO_PIPELINE_ASRC_CORE        2
+#define appconfAUDIO_PIPELINE_OUTPUT_CORE      3
+
+/* The beamformer stage makes half the beams itself, and a worker on another core makes the rest */
+#define appconfBEAMFORMER_WORKER_COUNT         1
+#define appconfBEAMFORMER_WORKER_CORE          2
+
+/* The RTOS core each device's interrupts are handled on */
+#define appconfMIC_ISR_CORE                    1
+#define appconfI2S_ISR_CORE                    3
+#define appconfGPIO_ISR_CORE                   0
+#define appconfLOOPBACK_ISR_CORE               2
+#else
+/* The RTOS core each audio pipeline stage runs on, or -1 for any */
+#define appconfAUDIO_PIPELINE_BEAMFORMER_CORE  -1
+#define appconfAUDIO_PIPELINE_NOISE_SUPPRESSOR_CORE -1
+#define appconfAUDIO_PIPELINE_VAD_CORE         -1
+#define appconfAUDIO_PIPELINE_GAIN_CORE        -1
+#define appconfAUDIO_PIPELINE_ASRC_CORE        -1
+#define appconfAUDIO_PIPELINE_OUTPUT_CORE      -1
+
+/* With only one core the beamformer stage makes every beam itself */
+#define appconfBEAMFORMER_WORKER_COUNT         0
+#define appconfBEAMFORMER_WORKER_CORE          -1
+
+/* The RTOS core each device's interrupts are handled on */
+#define appconfMIC_ISR_CORE                    0
+#define appconfI2S_ISR_CORE                    0
+#define appconfGPIO_ISR_CORE                   0
+#define appconfLOOPBACK_ISR_CORE               0
+#endif
+
+/*
+ * Audio pipeline deadline defines. Each stage's budget is a share, in percent,
+ * of the time between the frames it is given, which includes any time its task
+ * spends preempted. A frame that goes over its stage's budget, or one that is
+ * lost because a queue is full, makes the pipeline shed load for
+ * appconfAUDIO_PIPELINE_SHED_HOLD_MS. While it does, the VAD is skipped and the
+ * beamformer passes on mic 0 alone. A hold time of 0 sheds nothing.
+ */
+#define appconfAUDIO_PIPELINE_FRAME_TICKS      ((appconfMIC_FRAME_LENGTH >> MICARRAYCONF_FRAME_OVERLAP) * 100000 / (MICARRAYCONF_SAMPLE_RATE / 1000))
+#define appconfAUDIO_PIPELINE_BUDGET(percent)  (appconfAUDIO_PIPELINE_FRAME_TICKS / 100 * (percent))
+#define appconfAUDIO_PIPELINE_BEAMFORMER_BUDGET appconfAUDIO_PIPELINE_BUDGET(60)
+#define appconfAUDIO_PIPELINE_NOISE_SUPPRESSOR_BUDGET appconfAUDIO_PIPELINE_BUDGET(60)
+#define appconfAUDIO_PIPELINE_VAD_BUDGET       appconfAUDIO_PIPELINE_BUDGET(10)
+#define appconfAUDIO_PIPELINE_GAIN_BUDGET      appconfAUDIO_PIPELINE_BUDGET(10)
+#define appconfAUDIO_PIPELINE_ASRC_BUDGET      appconfAUDIO_PIPELINE_BUDGET(25)
+#define appconfAUDIO_PIPELINE_OUTPUT_BUDGET    appconfAUDIO_PIPELINE_BUDGET(10)
+#define appconfAUDIO_PIPELINE_SHED_HOLD_MS     500
+
+/* ASRC defines. The DAC's fill level to aim for, in frames, and the most its rate may be corrected by */
+#define appconfASRC_TARGET_LEVEL               2
+#define appconfASRC_MAX_PPM                    1000
+
+/*
+ * Beamformer defines. Build with CONFIG=beamformer to have the mic array send
+ * all seven mics in each frame, and pass on one beam of a delay and sum
+ * beamformer made from them rather than mic 0 alone.
+ */
+#ifndef appconfBEAMFORMER_ENABLED
+#define appconfBEAMFORMER_ENABLED              0
+#endif
+/* The beams are spread evenly around the array */
+#define appconfBEAMFORMER_BEAM_COUNT           6
+/* The beam to pass on, or -1 for the loudest. May be changed with the beam command. */
+#define appconfBEAMFORMER_BEAM                 -1
+
+/*
+ * Noise suppressor defines. Build with CONFIG=noise_suppressor to have the mic
+ * array send mics 0 and 1 as windowed, bit reversed, half overlapping frames,
+ * and pass on mic 0 with its noise suppressed in the frequency domain. It may
+ * not be used with the beamformer.
+ */
+#ifndef appconfNOISE_SUPPRESSOR_ENABLED
+#define appconfNOISE_SUPPRESSOR_ENABLED        0
+#endif
+/* The lowest gain applied to any frequency bin, in Q31. 0.125 is -18 dB. */
+#define appconfNOISE_SUPPRESSOR_GAIN_FLOOR     268435456
+
+/*
+ * Voice activity detection defines. The thresholds are frame powers before
+ * the gain is applied, in Q31 relative to full scale, and may be changed with
+ * the vad-threshold command. The defaults are about -70 and -76 dBFS.
+ */
+#define appconfVAD_ON_THRESHOLD                215
+#define appconfVAD_OFF_THRESHOLD               54
+/* The frames in a row that must fall below the off threshold before voice is taken to have stopped */
+#define appconfVAD_HANGOVER_FRAMES             20
+/* 1 mutes the frames that have no voice, rather than applying the gain to them */
+#define appconfVAD_IDLE_MUTE                   0
+/* While there is no voice only one frame in this many is sent over TCP and UDP. 0 sends none and 1 sends them all. */
+#define appconfVAD_IDLE_NETWORK_DECIMATION     1
 
 /* Queue to TCP defines */
 #define appconfQUEUE_TO_TCP_PORT                54321
+/* Copy each frame straight into the socket's TX stream space rather than passing it to FreeRTOS_send() */
+#define appconfQUEUE_TO_TCP_ZERO_COPY           1
+/* Frames are held back until a full MSS can be sent, but for no longer than this. 0 sends each frame as it arrives. */
+#define appconfQUEUE_TO_TCP_MAX_LATENCY_MS      20
+/* The most clients the mic stream may be sent to at once. Each shares the same frames. */
+#define appconfQUEUE_TO_TCP_MAX_CLIENTS         2
+/* The number of frames that may be queued for each client */
+#define appconfQUEUE_TO_TCP_CLIENT_QUEUE_LENGTH 2
+/* When a client's queue is full, 0 drops the frame for that client and 1 disconnects it */
+#define appconfQUEUE_TO_TCP_SLOW_CLIENT_DISCONNECT 0
+/*
+ * 1 compresses each frame with audio_compress_frame() before it is sent over TCP,
+ * once for all the clients. Play it with example_host.sh -z.
+ */
+#ifndef appconfQUEUE_TO_TCP_COMPRESSION
+#define appconfQUEUE_TO_TCP_COMPRESSION         0
+#endif
+/* The LSBs rounded off each sample before it is compressed. 0 is lossless. */
+#ifndef appconfQUEUE_TO_TCP_COMPRESSION_SHIFT
+#define appconfQUEUE_TO_TCP_COMPRESSION_SHIFT   0
+#endif
+/* The number of compressed frames that may be queued or held for sending, shared by the clients */
+#define appconfQUEUE_TO_TCP_PACKET_POOL_COUNT   8
+
+/* Queue to UDP defines */
+#define appconfQUEUE_TO_UDP_ENABLED             1
+#define appconfQUEUE_TO_UDP_PORT                54322
+/* A client must resubscribe at least this often to keep the RTP stream coming */
+#define appconfQUEUE_TO_UDP_SUBSCRIBE_TIMEOUT_MS 10000
+
+/*
+ * UDP to queue defines. Build with CONFIG=udp_speaker to play an RTP stream, in
+ * the same format as the one sent from appconfQUEUE_TO_UDP_PORT, sent to
+ * appconfUDP_TO_QUEUE_PORT out of the DAC in place of the mics. Send one with
+ * example_host.sh -s.
+ */
+#ifndef appconfUDP_TO_QUEUE_ENABLED
+#define appconfUDP_TO_QUEUE_ENABLED             0
+#endif
+#define appconfUDP_TO_QUEUE_PORT                54324
+/* The frames the jitter buffer holds. Must be a power of two. */
+#define appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES 8
+/* The least and most frames the jitter buffer fills to before it is played from, as it adapts to the jitter */
+#define appconfUDP_TO_QUEUE_MIN_LEVEL           2
+#define appconfUDP_TO_QUEUE_MAX_LEVEL           6
+/* The jitter buffer is shrunk by a frame after it has gone this long without running dry */
+#define appconfUDP_TO_QUEUE_ADAPT_MS            2000
+/* The lost frames in a row that are concealed by fading out the last one received. Silence is played after that. */
+#define appconfUDP_TO_QUEUE_PLC_MAX_FRAMES      4
+/* The stream is taken to have stopped, and the mics are played again, once nothing has been received for this long */
+#define appconfUDP_TO_QUEUE_TIMEOUT_MS          200
 
 #define DEBUG_PRINT_ENABLE_QUEUE_TO_TCP         0
 
@@ -21,19 +177,65 @@
 #define appconfCLI_UDP_PORT                     5432
 #define configCOMMAND_INT_MAX_OUTPUT_SIZE       128
 
+/* Telemetry defines */
+#define appconfTELEMETRY_PORT                   54323
+/* The interval counters are pushed at, unless the client asks for another */
+#define appconfTELEMETRY_INTERVAL_MS            100
+#define appconfTELEMETRY_MIN_INTERVAL_MS        10
+/* A client must resubscribe at least this often to keep the telemetry coming */
+#define appconfTELEMETRY_SUBSCRIBE_TIMEOUT_MS   10000
+/* The most tasks that telemetry is sent for */
+#define appconfTELEMETRY_MAX_TASKS              24
+
+/* Latency benchmark defines. Build with CONFIG=latency_bench to enable it. */
+#ifndef appconfLATENCY_BENCH
+#define appconfLATENCY_BENCH                    0
+#endif
+/* The width of each bucket of the latency histograms */
+#define appconfLATENCY_BENCH_BUCKET_US          2000
+
 /* Thruput test defines */
 #define appconfTHRUPUT_TEST_PORT            10000
+/* The number of bytes the TX, bidirectional and UDP tests send */
+#define appconfTHRUPUT_TEST_LENGTH          ( 100 * 1024 * 1024 )
 #define DEBUG_PRINT_ENABLE_THRUPUT_TEST         1
 
+/* DMA benchmark defines */
+#define DEBUG_PRINT_ENABLE_DMA_BENCH            1
+
+/* Power manager defines. Build with CONFIG=power_manager to enable it. */
+#ifndef appconfPOWER_MANAGER_ENABLED
+#define appconfPOWER_MANAGER_ENABLED           0
+#endif
+/* The interval the load is measured over, and the clock divider may change at */
+#define appconfPOWER_MANAGER_INTERVAL_MS       100
+/* The clock is undivided as soon as the busiest core or hub is loaded above this */
+#define appconfPOWER_MANAGER_RAISE_PERMILLE    700
+/* The divider is stepped up while the load would stay below this at the next divider */
+#define appconfPOWER_MANAGER_LOWER_PERMILLE    350
+/* The mic array's decimators are not measured, so the clock is never divided by more than this */
+#define appconfPOWER_MANAGER_MAX_DIVIDER       2
+
 /* GPIO defines */
 #define appconfGPIO_VOLUME_RAPID_FIRE_MS       100
+#define appconfGPIO_EVENT_QUEUE_LENGTH         16
+
+/* Deferred rtos_printf() and rtos_trace() defines, used when built with RTOS_PRINTF_DEFERRED=1 or RTOS_TRACE_ENABLE=1 */
+#define appconfPRINTF_DRAIN_INTERVAL_MS        10
 
 /* Task Priorities */
+#define appconfBOTTOM_HALF_TASK_PRIORITY       ( configMAX_PRIORITIES - 1 )
 #define appconfAUDIO_PIPELINE_TASK_PRIORITY    ( configMAX_PRIORITIES - 3 )
 #define appconfQUEUE_TO_TCP_TASK_PRIORITY      ( configMAX_PRIORITIES - 2 )
+#define appconfQUEUE_TO_UDP_TASK_PRIORITY      ( configMAX_PRIORITIES - 2 )
 #define appconfQUEUE_TO_I2S_TASK_PRIORITY      ( configMAX_PRIORITIES - 2 )
+#define appconfUDP_TO_QUEUE_TASK_PRIORITY      ( configMAX_PRIORITIES - 2 )
 #define appconfCLI_TASK_PRIORITY               ( configMAX_PRIORITIES - 3 )
+#define appconfTELEMETRY_TASK_PRIORITY         ( configMAX_PRIORITIES - 3 )
 #define appconfTHRUPUT_TEST_TASK_PRIORITY      ( configMAX_PRIORITIES - 3 )
+#define appconfDMA_BENCH_TASK_PRIORITY         ( configMAX_PRIORITIES - 3 )
 #define appconfGPIO_TASK_PRIORITY              ( configMAX_PRIORITIES - 2 )
+#define appconfPOWER_MANAGER_TASK_PRIORITY     ( configMAX_PRIORITIES - 2 )
+#define appconfPRINTF_DRAIN_TASK_PRIORITY      ( tskIDLE_PRIORITY )
 
 #endif /* APP_CONF_H_ */
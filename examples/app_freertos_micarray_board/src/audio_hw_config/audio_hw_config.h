@@ -7,4 +7,14 @@
 
 void audio_hw_config(soc_peripheral_t i2c_dev);
 
+/*
+ * Mutes or unmutes both DAC outputs, and sets their volume in 0.5 dB
+ * steps, as the two's complement AOUTx volume register value. Both
+ * may only be called once audio_hw_config() has completed, and not by
+ * more than one task at a time. They return the number of register
+ * writes that failed.
+ */
+int audio_hw_config_mute_set(int mute);
+int audio_hw_config_volume_set(int8_t volume);
+
 #endif /* AUDIO_HW_CONFIG_H_ */
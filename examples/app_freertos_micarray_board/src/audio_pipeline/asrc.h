@@ -0,0 +1,72 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef ASRC_H_
+#define ASRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "micarray_driver.h"
+
+/*
+ * An asynchronous sample rate converter for single channel mic frames.
+ *
+ * Frames given to it are resampled, by linear interpolation, by a ratio
+ * that tracks the difference between the rate they arrive at and the
+ * rate they are consumed at downstream. This is estimated from the
+ * fill level of the downstream buffer, which it steers towards a
+ * target level. Frames in and out are the same length, but over time
+ * one more or one fewer frame comes out for every frame the two rates
+ * drift apart by.
+ */
+
+typedef struct asrc asrc_t;
+
+/*
+ * Creates a converter for frames of frame_length samples. target_level
+ * is the downstream fill level, in frames, to aim for. The ratio is
+ * never moved more than max_ppm parts per million away from 1.
+ */
+asrc_t *asrc_create(
+        size_t frame_length,
+        int target_level,
+        int max_ppm);
+
+/*
+ * Updates the ratio from the current downstream fill level, in frames,
+ * in Q16. This should be called once for each frame given to
+ * asrc_input(). A level that is only ever a whole number of frames
+ * cannot tell the controller where between frames downstream is, so
+ * the fraction of the frame being consumed should be included.
+ */
+void asrc_level_update(
+        asrc_t *asrc,
+        int32_t level_q16);
+
+/*
+ * Adds a frame of input. If the output has not kept up and there is no
+ * room for it, the oldest frame's worth of input is dropped to make
+ * room, and -1 is returned. Otherwise returns 0.
+ */
+int asrc_input(
+        asrc_t *asrc,
+        const micarray_sample_t *frame);
+
+/*
+ * Writes the next frame of output to frame. Returns 0, leaving frame
+ * untouched, if there is not yet enough input for it, and otherwise 1.
+ * This should be called until it returns 0 after each frame of input.
+ */
+int asrc_output(
+        asrc_t *asrc,
+        micarray_sample_t *frame);
+
+/*
+ * Returns the current ratio, in parts per million away from 1. It is
+ * positive when more than one input sample is consumed for each output
+ * sample, in other words when downstream runs slow.
+ */
+int32_t asrc_ratio_ppm(
+        asrc_t *asrc);
+
+#endif /* ASRC_H_ */
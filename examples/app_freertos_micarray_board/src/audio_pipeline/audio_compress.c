@@ -0,0 +1,245 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "xassert.h"
+
+#include "audio_compress.h"
+
+#define SAMPLE_BITS (8 * sizeof(micarray_sample_t))
+
+/*
+ * Writes bits out MSB first. Whole bytes are written out as soon as
+ * they are complete, so fewer than 8 bits are ever held.
+ */
+typedef struct {
+    uint8_t *out;
+    uint64_t acc;
+    int bits;
+} bit_writer_t;
+
+static void bits_put(bit_writer_t *bw, uint32_t value, int count)
+{
+    if (count == 0) {
+        return;
+    }
+    if (count < 32) {
+        value &= (1u << count) - 1;
+    }
+
+    bw->acc = (bw->acc << count) | value;
+    bw->bits += count;
+
+    while (bw->bits >= 8) {
+        bw->bits -= 8;
+        *bw->out++ = (uint8_t) (bw->acc >> bw->bits);
+    }
+}
+
+/* Pads out the last byte with 0s */
+static void bits_flush(bit_writer_t *bw)
+{
+    if (bw->bits > 0) {
+        bits_put(bw, 0, 8 - bw->bits);
+    }
+}
+
+static void bits_rice_put(bit_writer_t *bw, uint32_t u, int k)
+{
+    uint32_t q = u >> k;
+
+    while (q >= 32) {
+        bits_put(bw, 0, 32);
+        q -= 32;
+    }
+    bits_put(bw, 1, q + 1);
+    bits_put(bw, u, k);
+}
+
+/*
+ * Rounds off the shift LSBs of a sample, without letting the largest
+ * samples round up past what fits back in a sample once shifted back up.
+ */
+static int32_t quantize(int32_t x, int shift)
+{
+    const int64_t max = ((int64_t) 1 << (SAMPLE_BITS - 1)) - 1;
+    int64_t q;
+
+    if (shift == 0) {
+        return x;
+    }
+
+    q = ((int64_t) x + ((int64_t) 1 << (shift - 1))) >> shift;
+    if (q > (max >> shift)) {
+        q = max >> shift;
+    }
+
+    return (int32_t) q;
+}
+
+static uint64_t zigzag(int64_t r)
+{
+    return r >= 0 ? (uint64_t) r << 1 : ((uint64_t) -r << 1) - 1;
+}
+
+/*
+ * The residual of the fixed predictor of an order, given the sample
+ * and the order samples before it, h[0] being the one just before.
+ */
+static int64_t fixed_residual(int64_t x, const int64_t h[AUDIO_COMPRESS_MAX_ORDER], int order)
+{
+    switch (order) {
+    case 0:
+        return x;
+    case 1:
+        return x - h[0];
+    case 2:
+        return x - (h[0] << 1) + h[1];
+    case 3:
+        return x - ((h[0] << 1) + h[0]) + ((h[1] << 1) + h[1]) - h[2];
+    default:
+        return x - (h[0] << 2) + ((h[1] << 2) + (h[1] << 1)) - (h[2] << 2) + h[3];
+    }
+}
+
+/*
+ * Picks the predictor order and Rice parameter that code a channel in
+ * the fewest bits, from the sum of its mapped residuals for each order.
+ * These are all found in one pass, as each order's residual is the
+ * difference of the last two of the order below. The count of bits is
+ * an upper bound, as the sum of each residual shifted down is never more
+ * than their sum shifted down.
+ *
+ * Returns the order, or -1 if the channel is best sent as it is.
+ */
+static int subframe_analyze(
+        const micarray_sample_t *samples,
+        size_t length,
+        int shift,
+        int *rice_k)
+{
+    const int vbits = SAMPLE_BITS - shift;
+    uint64_t sum[AUDIO_COMPRESS_MAX_ORDER + 1] = { 0 };
+    int fits[AUDIO_COMPRESS_MAX_ORDER + 1] = { 1, 1, 1, 1, 1 };
+    int64_t prev[AUDIO_COMPRESS_MAX_ORDER] = { 0 };
+    uint64_t best_bits = (uint64_t) length * vbits;
+    int best_order = -1;
+    size_t i;
+    int p;
+
+    for (i = 0; i < length; i++) {
+        int64_t d = quantize(samples[i], shift);
+
+        for (p = 0; p <= AUDIO_COMPRESS_MAX_ORDER; p++) {
+            if (i >= (size_t) p) {
+                uint64_t u = zigzag(d);
+                if (u > UINT32_MAX) {
+                    fits[p] = 0;
+                }
+                sum[p] += u;
+            }
+            if (p < AUDIO_COMPRESS_MAX_ORDER) {
+                int64_t next = d - prev[p];
+                prev[p] = d;
+                d = next;
+            }
+        }
+    }
+
+    for (p = 0; p <= AUDIO_COMPRESS_MAX_ORDER && (size_t) p < length; p++) {
+        int k;
+
+        if (!fits[p]) {
+            continue;
+        }
+        for (k = 0; k < vbits; k++) {
+            uint64_t bits = (uint64_t) p * vbits + (uint64_t) (length - p) * (k + 1) + (sum[p] >> k);
+            if (bits < best_bits) {
+                best_bits = bits;
+                best_order = p;
+                *rice_k = k;
+            }
+        }
+    }
+
+    return best_order;
+}
+
+static uint8_t *subframe_write(
+        const micarray_sample_t *samples,
+        size_t length,
+        int shift,
+        uint8_t *out)
+{
+    const int vbits = SAMPLE_BITS - shift;
+    int64_t h[AUDIO_COMPRESS_MAX_ORDER] = { 0 };
+    bit_writer_t bw;
+    int order;
+    int k = 0;
+    size_t i;
+
+    order = subframe_analyze(samples, length, shift, &k);
+
+    *out++ = (uint8_t) (order + 1);
+    *out++ = (uint8_t) k;
+
+    bw.out = out;
+    bw.acc = 0;
+    bw.bits = 0;
+
+    for (i = 0; i < length; i++) {
+        int64_t x = quantize(samples[i], shift);
+
+        if (order < 0 || i < (size_t) order) {
+            bits_put(&bw, (uint32_t) x, vbits);
+        } else {
+            bits_rice_put(&bw, (uint32_t) zigzag(fixed_residual(x, h, order)), k);
+        }
+
+        h[3] = h[2];
+        h[2] = h[1];
+        h[1] = h[0];
+        h[0] = x;
+    }
+    bits_flush(&bw);
+
+    return bw.out;
+}
+
+size_t audio_compress_frame(
+        const micarray_sample_t *frame,
+        size_t length,
+        int channels,
+        int shift,
+        uint8_t *out)
+{
+    uint8_t *p = out + AUDIO_COMPRESS_HEADER_BYTES;
+    size_t payload;
+    int ch;
+
+    xassert(shift >= 0 && shift < (int) SAMPLE_BITS);
+    xassert(length <= UINT16_MAX);
+
+    for (ch = 0; ch < channels; ch++) {
+        p = subframe_write(&frame[ch * length], length, shift, p);
+    }
+    payload = p - out - AUDIO_COMPRESS_HEADER_BYTES;
+    xassert(payload <= UINT16_MAX);
+
+    out[0] = AUDIO_COMPRESS_SYNC & 0xFF;
+    out[1] = AUDIO_COMPRESS_SYNC >> 8;
+    out[2] = SAMPLE_BITS;
+    out[3] = (uint8_t) channels;
+    out[4] = (uint8_t) shift;
+    out[5] = 0;
+    out[6] = length & 0xFF;
+    out[7] = length >> 8;
+    out[8] = payload & 0xFF;
+    out[9] = payload >> 8;
+
+    return AUDIO_COMPRESS_HEADER_BYTES + payload;
+}
+
+size_t audio_compress_frame_bytes(
+        const uint8_t *compressed)
+{
+    return AUDIO_COMPRESS_HEADER_BYTES + (compressed[8] | (compressed[9] << 8));
+}
@@ -0,0 +1,201 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <stdint.h>
+
+/* Library headers */
+#include "soc.h"
+
+/* App headers */
+#include "audio_kernels.h"
+
+#if MICARRAYCONF_WORD_LENGTH_SHORT
+#define SAMPLE_MAX INT16_MAX
+#define SAMPLE_MIN INT16_MIN
+#else
+#define SAMPLE_MAX INT32_MAX
+#define SAMPLE_MIN INT32_MIN
+#endif
+
+static inline micarray_sample_t saturate(int64_t x)
+{
+    if (x > SAMPLE_MAX) {
+        return SAMPLE_MAX;
+    } else if (x < SAMPLE_MIN) {
+        return SAMPLE_MIN;
+    }
+    return (micarray_sample_t) x;
+}
+
+void audio_kernel_gain(
+        micarray_sample_t *frame,
+        size_t length,
+        int32_t gain)
+{
+    size_t i;
+
+    for (i = 0; i + 4 <= length; i += 4) {
+        int64_t p0 = (int64_t) frame[i + 0] * gain;
+        int64_t p1 = (int64_t) frame[i + 1] * gain;
+        int64_t p2 = (int64_t) frame[i + 2] * gain;
+        int64_t p3 = (int64_t) frame[i + 3] * gain;
+
+        frame[i + 0] = saturate(p0);
+        frame[i + 1] = saturate(p1);
+        frame[i + 2] = saturate(p2);
+        frame[i + 3] = saturate(p3);
+    }
+    for (; i < length; i++) {
+        frame[i] = saturate((int64_t) frame[i] * gain);
+    }
+}
+
+void audio_kernel_gain_ramp(
+        micarray_sample_t *frame,
+        size_t length,
+        int32_t gain_from,
+        int32_t gain_to)
+{
+    /*
+     * The gain is held in Q16 so that it can step by a fraction each
+     * sample. Each product is made from the integer and fractional
+     * parts of the gain separately so that it cannot overflow.
+     */
+    const int64_t step = (((int64_t) gain_to - gain_from) << 16) / (int64_t) length;
+    int64_t gain = (int64_t) gain_from << 16;
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        const int64_t gain_int = gain >> 16;
+        const int64_t gain_frac = gain & 0xFFFF;
+
+        frame[i] = saturate(frame[i] * gain_int + ((frame[i] * gain_frac) >> 16));
+        gain += step;
+    }
+}
+
+void audio_kernel_scale(
+        micarray_sample_t *frame,
+        size_t length,
+        int shift)
+{
+    size_t i;
+
+    if (shift < 0) {
+        shift = -shift;
+        for (i = 0; i + 4 <= length; i += 4) {
+            frame[i + 0] >>= shift;
+            frame[i + 1] >>= shift;
+            frame[i + 2] >>= shift;
+            frame[i + 3] >>= shift;
+        }
+        for (; i < length; i++) {
+            frame[i] >>= shift;
+        }
+    } else if (shift > 0) {
+        /* Anything shifted further than this saturates */
+        if (shift > 8 * sizeof(micarray_sample_t)) {
+            shift = 8 * sizeof(micarray_sample_t);
+        }
+        for (i = 0; i + 4 <= length; i += 4) {
+            int64_t p0 = (int64_t) frame[i + 0] << shift;
+            int64_t p1 = (int64_t) frame[i + 1] << shift;
+            int64_t p2 = (int64_t) frame[i + 2] << shift;
+            int64_t p3 = (int64_t) frame[i + 3] << shift;
+
+            frame[i + 0] = saturate(p0);
+            frame[i + 1] = saturate(p1);
+            frame[i + 2] = saturate(p2);
+            frame[i + 3] = saturate(p3);
+        }
+        for (; i < length; i++) {
+            frame[i] = saturate((int64_t) frame[i] << shift);
+        }
+    }
+}
+
+void audio_kernel_frac_delay_mac(
+        int64_t *acc,
+        const micarray_sample_t *x,
+        size_t length,
+        int32_t c0,
+        int32_t c1)
+{
+    /* Each sample is loaded once, and used as x[i] and then x[i - 1] */
+    int32_t prev = x[-1];
+    size_t i;
+
+    for (i = 0; i + 4 <= length; i += 4) {
+        const int32_t x0 = x[i + 0];
+        const int32_t x1 = x[i + 1];
+        const int32_t x2 = x[i + 2];
+        const int32_t x3 = x[i + 3];
+
+        acc[i + 0] += (int64_t) c0 * x0 + (int64_t) c1 * prev;
+        acc[i + 1] += (int64_t) c0 * x1 + (int64_t) c1 * x0;
+        acc[i + 2] += (int64_t) c0 * x2 + (int64_t) c1 * x1;
+        acc[i + 3] += (int64_t) c0 * x3 + (int64_t) c1 * x2;
+        prev = x3;
+    }
+    for (; i < length; i++) {
+        acc[i] += (int64_t) c0 * x[i] + (int64_t) c1 * prev;
+        prev = x[i];
+    }
+}
+
+void audio_kernel_acc_store(
+        micarray_sample_t *frame,
+        const int64_t *acc,
+        size_t length)
+{
+    size_t i;
+
+    for (i = 0; i + 4 <= length; i += 4) {
+        frame[i + 0] = saturate(acc[i + 0] >> 31);
+        frame[i + 1] = saturate(acc[i + 1] >> 31);
+        frame[i + 2] = saturate(acc[i + 2] >> 31);
+        frame[i + 3] = saturate(acc[i + 3] >> 31);
+    }
+    for (; i < length; i++) {
+        frame[i] = saturate(acc[i] >> 31);
+    }
+}
+
+int32_t audio_kernel_power(
+        const micarray_sample_t *frame,
+        unsigned length_log2)
+{
+    const size_t length = (size_t) 1 << length_log2;
+    int64_t sum0 = 0;
+    int64_t sum1 = 0;
+    int64_t power;
+
+#if MICARRAYCONF_WORD_LENGTH_SHORT
+    /* Each square is Q30 and the sum cannot overflow */
+    for (size_t i = 0; i < length; i += 2) {
+        sum0 += (int32_t) frame[i + 0] * frame[i + 0];
+        sum1 += (int32_t) frame[i + 1] * frame[i + 1];
+    }
+
+    power = ((sum0 + sum1) << 1) >> length_log2;
+#else
+    /*
+     * Rather than shifting every 64 bit square down, each sample is
+     * shifted down first by just enough that the sum of the squares
+     * cannot overflow, so that each step is a single multiply
+     * accumulate.
+     */
+    const int headroom = (length_log2 + 1) / 2;
+
+    for (size_t i = 0; i < length; i += 2) {
+        int32_t s0 = frame[i + 0] >> headroom;
+        int32_t s1 = frame[i + 1] >> headroom;
+
+        sum0 += (int64_t) s0 * s0;
+        sum1 += (int64_t) s1 * s1;
+    }
+
+    power = (sum0 + sum1) >> (31 - 2 * headroom + length_log2);
+#endif
+
+    return power > INT32_MAX ? INT32_MAX : (int32_t) power;
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_support.h"
+
+/* App headers */
+#include "audio_params.h"
+#include "app_conf.h"
+
+/*
+ * seq is odd while a set is being made. Writers are kept apart by a
+ * critical section, while readers instead retry whenever seq changed
+ * under them, so that the pipeline stages never wait on a writer.
+ * The version starts at 1 so that a zeroed copy is always out of date.
+ */
+static struct {
+    volatile uint32_t seq;
+    uint32_t version;
+    int32_t value[AUDIO_PARAM_COUNT];
+} param_store = {
+    .seq = 0,
+    .version = 1,
+    .value = {
+        [AUDIO_PARAM_STAGE1_GAIN] = appconfAUDIO_PIPELINE_STAGE_ONE_GAIN,
+        [AUDIO_PARAM_VAD_ON_THRESHOLD] = appconfVAD_ON_THRESHOLD,
+        [AUDIO_PARAM_VAD_OFF_THRESHOLD] = appconfVAD_OFF_THRESHOLD,
+        [AUDIO_PARAM_BEAM] = appconfBEAMFORMER_BEAM,
+    },
+};
+
+void audio_param_set(audio_param_t param, int32_t value)
+{
+    audio_params_set(1, &param, &value);
+}
+
+void audio_params_set(size_t count, const audio_param_t param[], const int32_t value[])
+{
+    for (size_t i = 0; i < count; i++) {
+        configASSERT(param[i] < AUDIO_PARAM_COUNT);
+    }
+
+    taskENTER_CRITICAL();
+    {
+        param_store.seq++;
+        RTOS_MEMORY_BARRIER();
+
+        for (size_t i = 0; i < count; i++) {
+            param_store.value[param[i]] = value[i];
+        }
+        param_store.version++;
+
+        RTOS_MEMORY_BARRIER();
+        param_store.seq++;
+    }
+    taskEXIT_CRITICAL();
+}
+
+int32_t audio_param_get(audio_param_t param)
+{
+    configASSERT(param < AUDIO_PARAM_COUNT);
+
+    /* A single word cannot be seen half written */
+    return param_store.value[param];
+}
+
+int audio_params_update(audio_params_t *params)
+{
+    uint32_t seq;
+
+    if (params->version == param_store.version) {
+        return 0;
+    }
+
+    do {
+        seq = param_store.seq;
+        RTOS_MEMORY_BARRIER();
+
+        params->version = param_store.version;
+        memcpy(params->value, param_store.value, sizeof(params->value));
+
+        RTOS_MEMORY_BARRIER();
+    } while ((seq & 1) != 0 || seq != param_store.seq);
+
+    return 1;
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef AUDIO_PARAMS_H_
+#define AUDIO_PARAMS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A store for the parameters that control the audio pipeline, such as
+ * its gain, which may be set from any task or core while the pipeline
+ * runs.
+ *
+ * Each set increments the store's version. A pipeline stage keeps its
+ * own copy of the parameters and brings it up to date once per frame
+ * with audio_params_update(), so that a frame is processed with one
+ * consistent set of values, and the stage can tell from the version
+ * whether it needs to change how it processes the next frame. Readers
+ * never take a lock and never see a set half done.
+ */
+
+typedef enum {
+    AUDIO_PARAM_STAGE1_GAIN,
+    AUDIO_PARAM_VAD_ON_THRESHOLD,
+    AUDIO_PARAM_VAD_OFF_THRESHOLD,
+    AUDIO_PARAM_BEAM,
+    AUDIO_PARAM_COUNT
+} audio_param_t;
+
+/* A copy of every parameter, as of one version of the store */
+typedef struct {
+    uint32_t version;
+    int32_t value[AUDIO_PARAM_COUNT];
+} audio_params_t;
+
+/*
+ * Sets a parameter. It takes effect from the next frame each stage
+ * processes. May be called from any task.
+ */
+void audio_param_set(audio_param_t param, int32_t value);
+
+/*
+ * Sets count parameters together, so that no stage ever processes a
+ * frame with some of them changed but not the others.
+ */
+void audio_params_set(size_t count, const audio_param_t param[], const int32_t value[]);
+
+/*
+ * Returns the value a parameter was last set to.
+ */
+int32_t audio_param_get(audio_param_t param);
+
+/*
+ * Copies the store into params if anything has been set since params
+ * was last updated. Returns 1 if params changed, and otherwise 0.
+ * params must start zeroed so that the first call fills it in.
+ */
+int audio_params_update(audio_params_t *params);
+
+#endif /* AUDIO_PARAMS_H_ */
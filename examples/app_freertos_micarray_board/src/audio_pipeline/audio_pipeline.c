@@ -9,9 +9,11 @@
 /* Library headers */
 #include <string.h>
 #include "soc.h"
+#include "soc_dma_buf_pool.h"
 #include "dsp_qformat.h"
 
 /* BSP/bitstream headers */
+#include "soc_bsp_common.h"
 #include "bitstream_devices.h"
 #include "micarray_driver.h"
 #include "i2c_driver.h"
@@ -19,149 +21,457 @@
 
 /* App headers */
 #include "audio_pipeline.h"
+#include "audio_kernels.h"
+#include "audio_params.h"
+#include "vad.h"
+#include "beamformer.h"
+#include "noise_suppressor.h"
+#include "asrc.h"
+#include "pipeline.h"
 #include "app_conf.h"
 #include "audio_hw_config.h"
 #include "queue_to_tcp_stream.h"
-
-static BaseType_t xStage1_Gain = appconfAUDIO_PIPELINE_STAGE_ONE_GAIN;
+#include "queue_to_udp_stream.h"
+#include "queue_to_i2s.h"
+#include "udp_stream_to_queue.h"
+#include "latency_bench.h"
+#include "gpio_ctrl.h"
 
 static QueueHandle_t stage1_out_queue0;
 static QueueHandle_t stage1_out_queue1;
-
-#define MIN(X, Y) ((X) <= (Y) ? (X) : (Y))
+static QueueHandle_t stage1_out_queue2;
+
+static soc_peripheral_t mic_dev;
+static pipeline_t *mic_pipeline;
+static asrc_t *mic_asrc;
+static vad_t mic_vad;
+
+#if appconfBEAMFORMER_ENABLED
+static beamformer_t *mic_beamformer;
+static volatile int mic_beam;
+
+/*
+ * Where the mic array board's mics are, in micrometres, in the order
+ * the mic array sends them. Mic 0 is in the centre, and mics 1 to 6
+ * go round a circle of 45 mm radius at 60 degree steps.
+ */
+static const beamformer_mic_t mic_positions[] = {
+        {      0,      0 },
+        {  45000,      0 },
+        {  22500,  38971 },
+        { -22500,  38971 },
+        { -45000,      0 },
+        { -22500, -38971 },
+        {  22500, -38971 },
+};
+
+#if MICARRAYCONF_DMA_CHANNEL_COUNT != 7
+#error The beamformer needs the mic array to send all seven mics
+#endif
+#endif
+
+#if appconfNOISE_SUPPRESSOR_ENABLED
+static noise_suppressor_t *mic_ns;
+
+#if appconfBEAMFORMER_ENABLED
+#error The noise suppressor may not be used with the beamformer
+#endif
+#if !MICARRAYCONF_FFT_PREPROCESSED || !MICARRAYCONF_FRAME_OVERLAP || MICARRAYCONF_DMA_CHANNEL_COUNT != 2
+#error The noise suppressor needs mics 0 and 1 sent as half overlapping FFT preprocessed frames
+#endif
+#endif
+
+/* The index of the ASRC stage in the pipeline */
+#define AUDIO_PIPELINE_ASRC_STAGE (2 + appconfBEAMFORMER_ENABLED + appconfNOISE_SUPPRESSOR_ENABLED)
+
+/* All mic frames come from and go back to this pool */
+static soc_dma_buf_pool_t *frame_pool;
+
+/* The number of bytes in each single channel mic frame */
+#define MIC_FRAME_SIZE (appconfMIC_FRAME_LENGTH * sizeof(micarray_sample_t))
+
+/*
+ * The number of bytes in each frame from the mic array, which holds
+ * every mic it sends. Each frame is only one channel once it is past
+ * the beamformer or noise suppressor, so this is the size of the pool's
+ * frames.
+ */
+#define MIC_DMA_FRAME_SIZE MICARRAYCONF_DMA_FRAME_SIZE
+
+/* The most mic frames the mic array ISR gets from the DMA per interrupt */
+#define MIC_ARRAY_ISR_RX_BUF_MAX 4
 
 BaseType_t audiopipeline_get_stage1_gain( void )
 {
-    return xStage1_Gain;
+    return audio_param_get(AUDIO_PARAM_STAGE1_GAIN);
 }
 
 BaseType_t audiopipeline_set_stage1_gain( BaseType_t xnewgain )
 {
-    xStage1_Gain = xnewgain;
-    return xStage1_Gain;
+    audio_param_set(AUDIO_PARAM_STAGE1_GAIN, xnewgain);
+    return xnewgain;
 }
 
-int frame_power(int32_t *mic_data)
+int audio_pipeline_vad_active(void)
 {
-    uint64_t frame_power = 0;
-    int return_power;
-
-    for (size_t k = 0; k < appconfMIC_FRAME_LENGTH; ++k) {
-        int64_t smp = mic_data[k];
-        frame_power += (smp * smp) >> 31;
-    }
-
-    /* divide by appconfMIC_FRAME_LENGTH (2^8) */
-    frame_power >>= 8;
+    return mic_vad.active;
+}
 
-    return_power = MIN(frame_power, (uint64_t) Q31(F31(INT32_MAX)));
+void audio_pipeline_vad_get(vad_t *vad)
+{
+    *vad = mic_vad;
+}
 
-    return return_power;
+int frame_power(micarray_sample_t *mic_data)
+{
+    return audio_kernel_power(mic_data, MICARRAYCONF_FRAME_SIZE_LOG2);
 }
 
 RTOS_IRQ_ISR_ATTR
 int mic_array_isr(soc_peripheral_t device)
 {
-    QueueHandle_t mic_data_queue = soc_peripheral_app_data(device);
+    pipeline_t *pipeline = soc_peripheral_app_data(device);
     BaseType_t xYieldRequired = pdFALSE;
     uint32_t status;
 
     status = soc_peripheral_interrupt_status(device);
 
     if (status & SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM) {
-        soc_dma_ring_buf_t *rx_ring_buf;
-        int length;
-        int32_t *rx_buf;
+        void *rx_bufs[MIC_ARRAY_ISR_RX_BUF_MAX];
+        int rx_count;
 
         /*
          * This must be from the mic array device
          */
         configASSERT(device == bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_A]);
 
-        rx_ring_buf = soc_peripheral_rx_dma_ring_buf(device);
-        rx_buf = soc_dma_ring_rx_buf_get(rx_ring_buf, &length);
-        configASSERT(rx_buf != NULL);
-//        debug_printf("mic data rx %d bytes\n", length);
+        /*
+         * Get every frame that is ready, as one interrupt may stand for
+         * more than one completed DMA buffer. Each is replaced in the RX
+         * ring by a free frame from the pool here, so that the mic array
+         * never runs out of buffers however late the pipeline is. Each
+         * frame is stamped with the time the hub received it, so that
+         * its latency may be measured from then at each output.
+         */
+        rx_count = soc_dma_buf_pool_rx_refill(device, frame_pool, rx_bufs, MIC_ARRAY_ISR_RX_BUF_MAX);
+//        debug_printf("mic data rx %d frames\n", rx_count);
 
-        if (xQueueSendFromISR(mic_data_queue, &rx_buf, &xYieldRequired) == errQUEUE_FULL) {
-//            debug_printf("mic data lost\n", length);
-            soc_dma_ring_rx_buf_set(rx_ring_buf, rx_buf, sizeof(int32_t) * appconfMIC_FRAME_LENGTH);
-            soc_peripheral_hub_dma_request(device, SOC_DMA_RX_REQUEST);
+        for (int i = 0; i < rx_count; i++) {
+            if (pipeline_input_from_isr(pipeline, rx_bufs[i], &xYieldRequired) == errQUEUE_FULL) {
+//                debug_printf("mic data lost\n");
+                soc_dma_buf_pool_put(rx_bufs[i]);
+            }
         }
     }
 
     return xYieldRequired;
 }
 
-/* Apply gain to mic data */
-void audio_pipeline_stage1(void *arg)
+#if appconfBEAMFORMER_ENABLED
+/*
+ * Makes every beam from the mics in the frame, and passes on the one
+ * picked, or the loudest, in its place as a single channel frame.
+ */
+static void *audio_pipeline_beamformer(void *frame, void *arg)
 {
-    soc_peripheral_t mic_dev = arg;
-    QueueHandle_t mic_data_queue = soc_peripheral_app_data(mic_dev);
-    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(mic_dev);
+    static audio_params_t params;
+    micarray_sample_t *mic_data = frame;
+    int beam;
+
+    audio_params_update(&params);
+    beamformer_process(mic_beamformer, mic_data);
+
+    beam = params.value[AUDIO_PARAM_BEAM];
+    if (beam < 0 || beam >= appconfBEAMFORMER_BEAM_COUNT) {
+        beam = beamformer_loudest_beam(mic_beamformer);
+    }
+    mic_beam = beam;
+
+    memcpy(mic_data, beamformer_beam(mic_beamformer, beam), MIC_FRAME_SIZE);
 
-    for (;;) {
-        int32_t *mic_data;
-        int32_t *new_rx_buffer;
-        int32_t *mic_data_copy;
+    return mic_data;
+}
 
-        xQueueReceive(mic_data_queue, &mic_data, portMAX_DELAY);
+/*
+ * Passes on mic 0 alone, in place of a beam, while the pipeline is
+ * shedding load. Mic 0 is the centre mic, and its samples are already
+ * first in the frame.
+ */
+static void *audio_pipeline_beamformer_shed(void *frame, void *arg)
+{
+    return frame;
+}
 
-        new_rx_buffer = pvPortMalloc(appconfMIC_FRAME_LENGTH * sizeof(int32_t));
-        soc_dma_ring_rx_buf_set(rx_ring_buf, new_rx_buffer, sizeof(int32_t) * appconfMIC_FRAME_LENGTH);
-        soc_peripheral_hub_dma_request(mic_dev, SOC_DMA_RX_REQUEST);
+int audio_pipeline_beam_get(int32_t power[], int count)
+{
+    for (int beam = 0; beam < count && beam < appconfBEAMFORMER_BEAM_COUNT; beam++) {
+        power[beam] = beamformer_beam_power(mic_beamformer, beam);
+    }
+
+    return mic_beam;
+}
+#endif
+
+#if appconfNOISE_SUPPRESSOR_ENABLED
+/*
+ * Suppresses the noise in each frame of mics 0 and 1, which makes half
+ * a frame of mic 0 output, as the frames overlap by half. Every other
+ * frame is passed on, in place of mic 0's samples, once it completes a
+ * whole single channel frame, and the rest are released.
+ */
+static void *audio_pipeline_noise_suppressor(void *frame, void *arg)
+{
+    static micarray_sample_t out[appconfMIC_FRAME_LENGTH];
+    static int half;
+
+    noise_suppressor_process(mic_ns, frame, &out[half * appconfMIC_FRAME_LENGTH / 2]);
+
+    if (++half < 2) {
+        soc_dma_buf_pool_put(frame);
+        return NULL;
+    }
+    half = 0;
+
+    memcpy(frame, out, MIC_FRAME_SIZE);
+
+    return frame;
+}
+#endif
+
+/*
+ * Detects whether there is voice in the mic data, from the power of
+ * each frame before any gain, and shows it on the GPIO LEDs.
+ */
+static void *audio_pipeline_vad(void *frame, void *arg)
+{
+    static audio_params_t params;
+    micarray_sample_t *mic_data = frame;
+    int was_active = mic_vad.active;
+
+    audio_params_update(&params);
+    vad_update(&mic_vad, frame_power(mic_data),
+            params.value[AUDIO_PARAM_VAD_ON_THRESHOLD],
+            params.value[AUDIO_PARAM_VAD_OFF_THRESHOLD]);
+
+    if (mic_vad.active != was_active) {
+        gpio_ctrl_vad_indicate(mic_vad.active);
+    }
+
+    return mic_data;
+}
+
+/*
+ * Apply gain to mic data. A new gain is picked up at the start of a
+ * frame, and the gain ramps to it over that frame. Frames with no
+ * voice may be muted instead, which ramps the gain down to 0 and then
+ * just clears them.
+ */
+static void *audio_pipeline_gain(void *frame, void *arg)
+{
+    static audio_params_t params;
+    static int32_t gain;
+    micarray_sample_t *mic_data = frame;
+    int32_t new_gain;
+
+    audio_params_update(&params);
+    new_gain = params.value[AUDIO_PARAM_STAGE1_GAIN];
+#if appconfVAD_IDLE_MUTE
+    if (!mic_vad.active) {
+        new_gain = 0;
+    }
+#endif
+
+    if (new_gain != gain) {
+        audio_kernel_gain_ramp(mic_data, appconfMIC_FRAME_LENGTH, gain, new_gain);
+        gain = new_gain;
+    } else if (gain == 0) {
+        memset(mic_data, 0, MIC_FRAME_SIZE);
+    } else {
+        audio_kernel_gain(mic_data, appconfMIC_FRAME_LENGTH, gain);
+    }
 
-        //debug_printf("Mic power: %d\n", frame_power(mic_data));
+    return mic_data;
+}
 
-        for (int i = 0; i < appconfMIC_FRAME_LENGTH; i++) {
-            mic_data[i] *= xStage1_Gain;
+/*
+ * Resamples mic frames to the rate the DAC is actually playing them at,
+ * which drifts from the mic array's, as they run from different clocks.
+ * The drift is estimated from the DAC's fill level. This usually passes
+ * on one frame for each it is given, but sometimes none or two.
+ */
+static void *audio_pipeline_asrc(void *frame, void *arg)
+{
+    micarray_sample_t *mic_data = frame;
+    micarray_sample_t *out = NULL;
+    micarray_sample_t *next;
+    uint32_t timestamp = soc_dma_buf_pool_timestamp_get(mic_data);
+
+    asrc_level_update(mic_asrc, queue_to_i2s_fill_level());
+    asrc_input(mic_asrc, mic_data);
+    soc_dma_buf_pool_put(mic_data);
+
+    while ((next = soc_dma_buf_pool_get(frame_pool)) != NULL) {
+        if (!asrc_output(mic_asrc, next)) {
+            soc_dma_buf_pool_put(next);
+            break;
+        }
+        /* Each output is as late as the newest frame it was made from */
+        soc_dma_buf_pool_timestamp_set(next, timestamp);
+        if (out != NULL) {
+            pipeline_stage_output(mic_pipeline, AUDIO_PIPELINE_ASRC_STAGE, out);
         }
+        out = next;
+    }
 
-        mic_data_copy = pvPortMalloc(appconfMIC_FRAME_LENGTH * sizeof(int32_t));
-        memcpy(mic_data_copy, mic_data, appconfMIC_FRAME_LENGTH * sizeof(int32_t));
+    return out;
+}
 
-        if ( is_queue_to_tcp_connected() )
-        {
-            if (xQueueSend(stage1_out_queue0, &mic_data, pdMS_TO_TICKS(1)) == errQUEUE_FULL) {
-                //            debug_printf("stage 1 output lost\n");
-                vPortFree(mic_data);
-            }
+/*
+ * Returns non-zero if the next frame should be sent over the network.
+ * While there is no voice only one frame in every
+ * appconfVAD_IDLE_NETWORK_DECIMATION is, to save bandwidth.
+ */
+static int audio_pipeline_network_send(void)
+{
+#if appconfVAD_IDLE_NETWORK_DECIMATION == 1
+    return 1;
+#else
+    static unsigned idle_frames;
+
+    if (mic_vad.active) {
+        idle_frames = 0;
+        return 1;
+    }
+#if appconfVAD_IDLE_NETWORK_DECIMATION == 0
+    return 0;
+#else
+    return idle_frames++ % appconfVAD_IDLE_NETWORK_DECIMATION == 0;
+#endif
+#endif
+}
+
+/* Send mic data to all the outputs */
+static void *audio_pipeline_output(void *frame, void *arg)
+{
+    micarray_sample_t *mic_data = frame;
+    int network_send = audio_pipeline_network_send();
+
+    /*
+     * The outputs share the frame rather than each getting a
+     * copy. Each releases its own reference to it when done.
+     */
+    soc_dma_buf_pool_ref(mic_data, stage1_out_queue2 != NULL ? 2 : 1);
+
+    if (stage1_out_queue2 != NULL)
+    {
+        if (!network_send || !is_queue_to_udp_subscribed() ||
+                xQueueSend(stage1_out_queue2, &mic_data, 0) == errQUEUE_FULL) {
+            soc_dma_buf_pool_put(mic_data);
         }
-        else
-        {
-            vPortFree(mic_data);
+    }
+
+    if ( network_send && is_queue_to_tcp_connected() )
+    {
+        if (xQueueSend(stage1_out_queue0, &mic_data, pdMS_TO_TICKS(1)) == errQUEUE_FULL) {
+            //            debug_printf("stage 1 output lost\n");
+            soc_dma_buf_pool_put(mic_data);
         }
+    }
+    else
+    {
+        soc_dma_buf_pool_put(mic_data);
+    }
 
-        if (xQueueSend(stage1_out_queue1, &mic_data_copy, pdMS_TO_TICKS(1)) == errQUEUE_FULL) {
+    /* The DAC plays the stream from the network in place of the mics while there is one */
+    if (udp_stream_to_queue_playing() ||
+            xQueueSend(stage1_out_queue1, &mic_data, pdMS_TO_TICKS(1)) == errQUEUE_FULL) {
 //            debug_printf("dac output lost\n");
-            vPortFree(mic_data_copy);
-        }
+        soc_dma_buf_pool_put(mic_data);
     }
+
+    return NULL;
 }
 
-void audio_pipeline_create(QueueHandle_t output0, QueueHandle_t output1, UBaseType_t priority)
+pipeline_t *audio_pipeline_get(void)
 {
-    QueueHandle_t queue;
+    return mic_pipeline;
+}
+
+/*
+ * Configures the PLL and DACs and then exits. The I2C transactions take
+ * several milliseconds, so they are made by this task, while the rest of
+ * the application and the IP stack start up, rather than before the
+ * scheduler is started.
+ */
+static void audio_hw_config_task(void *arg)
+{
+    soc_peripheral_t dev = arg;
+
+    audio_hw_config(dev);
+
+    vTaskDelete(NULL);
+}
+
+void audio_pipeline_create(QueueHandle_t output0, QueueHandle_t output1, QueueHandle_t output2, UBaseType_t priority)
+{
+    const pipeline_stage_t stages[] = {
+#if appconfBEAMFORMER_ENABLED
+            { "beamformer", audio_pipeline_beamformer, NULL, priority, appconfAUDIO_PIPELINE_BEAMFORMER_CORE, appconfAUDIO_PIPELINE_BEAMFORMER_BUDGET, audio_pipeline_beamformer_shed },
+#endif
+#if appconfNOISE_SUPPRESSOR_ENABLED
+            { "ns",     audio_pipeline_noise_suppressor, NULL, priority, appconfAUDIO_PIPELINE_NOISE_SUPPRESSOR_CORE, appconfAUDIO_PIPELINE_NOISE_SUPPRESSOR_BUDGET, NULL },
+#endif
+            { "vad",    audio_pipeline_vad,    NULL, priority, appconfAUDIO_PIPELINE_VAD_CORE,    appconfAUDIO_PIPELINE_VAD_BUDGET,    pipeline_stage_bypass },
+            { "gain",   audio_pipeline_gain,   NULL, priority, appconfAUDIO_PIPELINE_GAIN_CORE,   appconfAUDIO_PIPELINE_GAIN_BUDGET,   NULL },
+            { "asrc",   audio_pipeline_asrc,   NULL, priority, appconfAUDIO_PIPELINE_ASRC_CORE,   appconfAUDIO_PIPELINE_ASRC_BUDGET,   NULL },
+            { "output", audio_pipeline_output, NULL, priority, appconfAUDIO_PIPELINE_OUTPUT_CORE, appconfAUDIO_PIPELINE_OUTPUT_BUDGET, NULL },
+    };
     soc_peripheral_t dev;
 
     stage1_out_queue0 = output0;
     stage1_out_queue1 = output1;
-    /*
-     * Configure the PLL and DACs. Do this now before
-     * starting the scheduler.
-     */
+    stage1_out_queue2 = output2;
     dev = i2c_driver_init(BITSTREAM_I2C_DEVICE_A);
-    audio_hw_config(dev);
+    xTaskCreate(audio_hw_config_task, "hw_config", portTASK_STACK_DEPTH(audio_hw_config_task), dev, priority, NULL);
+
+    frame_pool = soc_dma_buf_pool_create(MIC_DMA_FRAME_SIZE, appconfMIC_FRAME_POOL_COUNT);
+
+    vad_init(&mic_vad, appconfVAD_HANGOVER_FRAMES);
+
+#if appconfBEAMFORMER_ENABLED
+    {
+        const int worker_core[] = { appconfBEAMFORMER_WORKER_CORE };
+
+        mic_beamformer = beamformer_create(
+                MICARRAYCONF_FRAME_SIZE_LOG2,
+                sizeof(mic_positions) / sizeof(mic_positions[0]),
+                mic_positions,
+                MICARRAYCONF_SAMPLE_RATE,
+                appconfBEAMFORMER_BEAM_COUNT,
+                appconfBEAMFORMER_WORKER_COUNT,
+                worker_core,
+                priority);
+    }
+#endif
+
+#if appconfNOISE_SUPPRESSOR_ENABLED
+    mic_ns = noise_suppressor_create(MICARRAYCONF_FRAME_SIZE_LOG2, appconfNOISE_SUPPRESSOR_GAIN_FLOOR);
+#endif
+
+    mic_asrc = asrc_create(appconfMIC_FRAME_LENGTH, appconfASRC_TARGET_LEVEL, appconfASRC_MAX_PPM);
+
+    mic_pipeline = pipeline_create(stages, sizeof(stages) / sizeof(stages[0]), 2, soc_dma_buf_pool_put);
+    pipeline_shed_hold_time_set(mic_pipeline, appconfAUDIO_PIPELINE_SHED_HOLD_MS * 100000);
 
-    queue = xQueueCreate(2, sizeof(void *));
-    dev = micarray_driver_init(
+    mic_dev = micarray_driver_init(
             BITSTREAM_MICARRAY_DEVICE_A,       /* Initializing mic array device A */
             3,                                  /* Give this device 3 RX buffer descriptors */
-            appconfMIC_FRAME_LENGTH * sizeof(int32_t), /* Make each DMA RX buffer MIC_FRAME_LENGTH samples */
+            0,                                  /* The DMA RX buffers come from the frame pool below */
             0,                                  /* Give this device no TX buffer descriptors */
-            queue,                              /* The queue associated with this device */
-            0,                                  /* This device's interrupts should happen on core 0 */
+            mic_pipeline,                       /* The pipeline associated with this device */
+            appconfMIC_ISR_CORE,                /* The core this device's interrupts should happen on */
             (rtos_irq_isr_t) mic_array_isr); /* The ISR to handle this device's interrupts */
 
-    xTaskCreate(audio_pipeline_stage1, "stage1", portTASK_STACK_DEPTH(audio_pipeline_stage1), dev, priority, NULL);
+    soc_peripheral_common_dma_open(mic_dev);
+    soc_dma_ring_rx_buf_pool_fill(soc_peripheral_rx_dma_ring_buf(mic_dev), frame_pool, 3);
 }
@@ -0,0 +1,86 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef BEAMFORMER_H_
+#define BEAMFORMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+#include "micarray_driver.h"
+
+/*
+ * A delay and sum beamformer for planar multichannel mic frames.
+ *
+ * Each beam listens in one direction in the plane of the array, with
+ * the beams spread evenly around the circle. Every mic's signal is
+ * delayed by the time sound from the beam's direction takes to reach
+ * the edge of the array after reaching the mic, so that sound from
+ * that direction adds up in phase while sound from elsewhere partly
+ * cancels. The delays are fractional, each made by interpolating
+ * between two adjacent samples.
+ *
+ * The beams may be shared out between several worker tasks, pinned to
+ * their own cores, which each make a subset of them for every frame.
+ */
+
+/* The position of a mic in the plane of the array, in micrometres */
+typedef struct {
+    int32_t x;
+    int32_t y;
+} beamformer_mic_t;
+
+typedef struct beamformer beamformer_t;
+
+/*
+ * Creates a beamformer for frames of (1 << frame_length_log2) samples
+ * from each of mic_count mics at sample_rate, with beam_count beams.
+ * worker_count tasks, at priority, are created to make the beams along
+ * with the caller of beamformer_process(). The worker_core array gives
+ * the RTOS core each is pinned to, or -1 for any, and may be NULL if
+ * worker_count is 0.
+ */
+beamformer_t *beamformer_create(
+        unsigned frame_length_log2,
+        int mic_count,
+        const beamformer_mic_t mics[],
+        unsigned sample_rate,
+        int beam_count,
+        int worker_count,
+        const int worker_core[],
+        UBaseType_t priority);
+
+/*
+ * Makes every beam from frame, which holds the frame_length samples
+ * of each mic in turn. Must only be called by one task.
+ */
+void beamformer_process(
+        beamformer_t *bf,
+        const micarray_sample_t *frame);
+
+/*
+ * Returns the samples of a beam from the last frame processed.
+ */
+const micarray_sample_t *beamformer_beam(
+        beamformer_t *bf,
+        int beam);
+
+/*
+ * Returns the power of a beam, in the same units as
+ * audio_kernel_power(), smoothed over the last few frames.
+ */
+int32_t beamformer_beam_power(
+        beamformer_t *bf,
+        int beam);
+
+/*
+ * Returns the beam with the most smoothed power.
+ */
+int beamformer_loudest_beam(
+        beamformer_t *bf);
+
+int beamformer_beam_count(
+        beamformer_t *bf);
+
+#endif /* BEAMFORMER_H_ */
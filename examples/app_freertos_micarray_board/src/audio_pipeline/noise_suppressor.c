@@ -0,0 +1,215 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <math.h>
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "dsp.h"
+
+/* App headers */
+#include "noise_suppressor.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * Each bin's noise floor rises by 2^-NOISE_SUPPRESSOR_RISE_SHIFT of
+ * itself per frame while the bin is louder than it. At 375 frames per
+ * second this is about 3 dB per second, slow enough that it does not
+ * climb up to speech before the next pause brings it back down.
+ */
+#define NOISE_SUPPRESSOR_RISE_SHIFT 9
+
+/*
+ * Each bin's gain moves 2^-NOISE_SUPPRESSOR_GAIN_SMOOTH_SHIFT of the
+ * way to its new value every frame, which keeps bins hovering around
+ * the noise floor from flickering on and off as musical noise.
+ */
+#define NOISE_SUPPRESSOR_GAIN_SMOOTH_SHIFT 1
+
+struct noise_suppressor {
+    unsigned frame_length_log2;
+    size_t frame_length;
+    const int32_t *sine;
+    int32_t gain_floor;
+
+    /* The first half of the symmetric synthesis window, in Q31 */
+    int32_t *window;
+
+    /* The noise floor and gain of each of the frame_length / 2 bins */
+    uint64_t *noise;
+    int32_t *gain;
+
+    /* The second half of the last frame, still to be added to the next */
+    int32_t *overlap;
+};
+
+static const int32_t *noise_suppressor_sine_table(
+        unsigned frame_length_log2)
+{
+    switch (frame_length_log2) {
+    case 6:  return dsp_sine_64;
+    case 7:  return dsp_sine_128;
+    case 8:  return dsp_sine_256;
+    case 9:  return dsp_sine_512;
+    case 10: return dsp_sine_1024;
+    default:
+        configASSERT(0);
+        return NULL;
+    }
+}
+
+static uint64_t noise_suppressor_bin_power(
+        const dsp_complex_t *bin)
+{
+    return (uint64_t) ((int64_t) bin->re * bin->re) + (uint64_t) ((int64_t) bin->im * bin->im);
+}
+
+/*
+ * Returns the Wiener gain 1 - noise / power, in Q31, or gain_floor if
+ * that is lower.
+ */
+static int32_t noise_suppressor_bin_gain(
+        uint64_t power,
+        uint64_t noise,
+        int32_t gain_floor)
+{
+    int32_t gain;
+    int shift = 0;
+
+    if (noise >= power) {
+        return gain_floor;
+    }
+
+    /* Keep power within 32 bits, so that the ratio's numerator fits in 64 */
+    if (power >> 32) {
+        shift = 32 - __builtin_clz((uint32_t) (power >> 32));
+    }
+    power >>= shift;
+    noise >>= shift;
+
+    gain = INT32_MAX - (int32_t) ((noise << 31) / power);
+
+    return gain > gain_floor ? gain : gain_floor;
+}
+
+static int32_t noise_suppressor_q31_mul(
+        int32_t x,
+        int32_t q31)
+{
+    return (int32_t) (((int64_t) x * q31) >> 31);
+}
+
+static micarray_sample_t noise_suppressor_saturate(
+        int64_t x)
+{
+    if (x > INT32_MAX) {
+        return INT32_MAX;
+    } else if (x < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (micarray_sample_t) x;
+}
+
+noise_suppressor_t *noise_suppressor_create(
+        unsigned frame_length_log2,
+        int32_t gain_floor)
+{
+    noise_suppressor_t *ns;
+    size_t frame_length = 1 << frame_length_log2;
+    size_t half = frame_length / 2;
+
+    configASSERT(gain_floor >= 0);
+
+    ns = pvPortMalloc(sizeof(noise_suppressor_t));
+    configASSERT(ns != NULL);
+
+    ns->frame_length_log2 = frame_length_log2;
+    ns->frame_length = frame_length;
+    ns->sine = noise_suppressor_sine_table(frame_length_log2);
+    ns->gain_floor = gain_floor;
+
+    ns->window = pvPortMalloc(half * sizeof(int32_t));
+    ns->noise = pvPortMalloc(half * sizeof(uint64_t));
+    ns->gain = pvPortMalloc(half * sizeof(int32_t));
+    ns->overlap = pvPortMalloc(half * sizeof(int32_t));
+    configASSERT(ns->window != NULL && ns->noise != NULL && ns->gain != NULL && ns->overlap != NULL);
+
+    /* The same window the mic array applies before the FFT */
+    for (int i = 0; i < half; i++) {
+        double hann = 0.5 * (1.0 - cos(2.0 * M_PI * (i + 0.5) / frame_length));
+        ns->window[i] = (int32_t) (INT32_MAX * sqrt(hann));
+    }
+
+    /* Each noise floor starts high, so that it drops to the first frame's power */
+    for (int i = 0; i < half; i++) {
+        ns->noise[i] = UINT64_MAX;
+        ns->gain[i] = gain_floor;
+    }
+
+    memset(ns->overlap, 0, half * sizeof(int32_t));
+
+    return ns;
+}
+
+void noise_suppressor_process(
+        noise_suppressor_t *ns,
+        dsp_complex_t frame[],
+        micarray_sample_t out[])
+{
+    const size_t n = ns->frame_length;
+    const size_t half = n / 2;
+    dsp_complex_t *mic0 = &frame[0];
+    dsp_complex_t *mic1 = &frame[half];
+
+    /*
+     * The mic array has already put the samples in bit reversed order,
+     * which is the order the forward FFT takes them in.
+     */
+    dsp_fft_forward(frame, n, ns->sine);
+    dsp_fft_split_spectrum(frame, n);
+
+    /*
+     * Bin 0 holds the DC component in its real part and the Nyquist
+     * component in its imaginary part. Both are tiny once the DC offset
+     * has been removed, so they are just given the gain of their sum.
+     */
+    for (int k = 0; k < half; k++) {
+        uint64_t power = (noise_suppressor_bin_power(&mic0[k]) >> 1) + (noise_suppressor_bin_power(&mic1[k]) >> 1);
+        int32_t gain;
+
+        if (power < ns->noise[k]) {
+            ns->noise[k] = power;
+        } else {
+            ns->noise[k] += (ns->noise[k] >> NOISE_SUPPRESSOR_RISE_SHIFT) + 1;
+        }
+
+        gain = noise_suppressor_bin_gain(power, ns->noise[k], ns->gain_floor);
+        ns->gain[k] += (gain - ns->gain[k]) >> NOISE_SUPPRESSOR_GAIN_SMOOTH_SHIFT;
+
+        mic0[k].re = noise_suppressor_q31_mul(mic0[k].re, ns->gain[k]);
+        mic0[k].im = noise_suppressor_q31_mul(mic0[k].im, ns->gain[k]);
+
+        /* Only mic 0 is output, so mic 1 is left out of the inverse FFT */
+        mic1[k].re = 0;
+        mic1[k].im = 0;
+    }
+
+    dsp_fft_merge_spectra(frame, n);
+    dsp_fft_bit_reverse(frame, n);
+    dsp_fft_inverse(frame, n, ns->sine);
+
+    /*
+     * Mic 0's samples are now the real parts. Windowing them again makes
+     * a Hann window overall, and Hann windows half a frame apart sum to 1.
+     */
+    for (int i = 0; i < half; i++) {
+        out[i] = noise_suppressor_saturate(
+                (int64_t) ns->overlap[i] + noise_suppressor_q31_mul(frame[i].re, ns->window[i]));
+        ns->overlap[i] = noise_suppressor_q31_mul(frame[half + i].re, ns->window[half - 1 - i]);
+    }
+}
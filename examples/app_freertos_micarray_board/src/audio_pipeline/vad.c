@@ -0,0 +1,43 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+/* App headers */
+#include "vad.h"
+
+void vad_init(
+        vad_t *vad,
+        int hangover)
+{
+    memset(vad, 0, sizeof(*vad));
+    vad->hangover = hangover;
+}
+
+int vad_update(
+        vad_t *vad,
+        int32_t power,
+        int32_t on_threshold,
+        int32_t off_threshold)
+{
+    vad->power = power;
+    vad->frames++;
+
+    if (power >= on_threshold) {
+        vad->active = 1;
+        vad->quiet_frames = 0;
+    } else if (vad->active) {
+        if (power < off_threshold) {
+            if (++vad->quiet_frames >= vad->hangover) {
+                vad->active = 0;
+            }
+        } else {
+            vad->quiet_frames = 0;
+        }
+    }
+
+    if (vad->active) {
+        vad->voice_frames++;
+    }
+
+    return vad->active;
+}
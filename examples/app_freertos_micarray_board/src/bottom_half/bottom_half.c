@@ -0,0 +1,44 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_support.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "bottom_half.h"
+
+static TaskHandle_t bottom_half_task_handle;
+
+static void bottom_half_task( void *arg )
+{
+    for( ;; )
+    {
+        /* One notification stands for every rtos_bh_queue() since the last */
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+        rtos_bh_run();
+    }
+}
+
+BaseType_t bottom_half_queue_from_isr( rtos_bh_fn_t fn, void *arg, uint32_t data, BaseType_t *pxYieldRequired )
+{
+    switch( rtos_bh_queue( fn, arg, data ) )
+    {
+    case RTOS_BH_QUEUED_WAKE:
+        vTaskNotifyGiveFromISR( bottom_half_task_handle, pxYieldRequired );
+        return pdPASS;
+    case RTOS_BH_QUEUED:
+        return pdPASS;
+    default:
+        return pdFAIL;
+    }
+}
+
+void bottom_half_create( UBaseType_t priority )
+{
+    xTaskCreate( bottom_half_task, "bottom_half", portTASK_STACK_DEPTH(bottom_half_task), NULL, priority, &bottom_half_task_handle );
+    configASSERT( bottom_half_task_handle != NULL );
+}
@@ -0,0 +1,242 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#define DEBUG_UNIT DMA_BENCH
+#include "app_conf.h"
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "soc.h"
+
+/* BSP/bitstream headers */
+#include "soc_bsp_common.h"
+#include "bitstream_devices.h"
+#include "loopback_driver.h"
+#include "loopback_dev_conf_defaults.h"
+
+/* App headers */
+#include "dma_bench.h"
+#include "dma_ring_bench.h"
+
+#if SOC_LOOPBACK_PERIPHERAL_USED
+
+/* The most frames in flight, and the most buffers each is gathered from */
+#define DMA_BENCH_DESC_MAX      8
+#define DMA_BENCH_FAN_IN_MAX    4
+
+/* The number of frames looped back for each measurement */
+#define DMA_BENCH_TRANSFERS     1000
+
+/* The reference clock runs at 100 MHz */
+#define DMA_BENCH_TICKS_PER_US  100
+
+static const int buf_sizes[] = { 64, 256, 1024, LOOPBACKCONF_MAX_BUF_LEN };
+static const int desc_counts[] = { 1, 2, 4, DMA_BENCH_DESC_MAX };
+static const int fan_ins[] = { 1, 2, DMA_BENCH_FAN_IN_MAX };
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static uint32_t tx_buf[LOOPBACKCONF_MAX_BUF_LEN / sizeof(uint32_t)];
+static uint32_t rx_bufs[DMA_BENCH_DESC_MAX][LOOPBACKCONF_MAX_BUF_LEN / sizeof(uint32_t)];
+
+RTOS_IRQ_ISR_ATTR
+int dma_bench_isr(soc_peripheral_t device)
+{
+    TaskHandle_t bench_task = soc_peripheral_app_data(device);
+    BaseType_t xYieldRequired = pdFALSE;
+    uint32_t status;
+
+    status = soc_peripheral_interrupt_status(device);
+
+    if (status & SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM) {
+        vTaskNotifyGiveFromISR(bench_task, &xYieldRequired);
+    }
+
+    return xYieldRequired;
+}
+
+/*
+ * Sends one frame of buf_size bytes to the loopback device,
+ * gathered from fan_in buffers.
+ */
+static void dma_bench_frame_send(
+        soc_dma_ring_buf_t *tx_ring_buf,
+        int buf_size,
+        int fan_in)
+{
+    int part_size = buf_size / fan_in;
+    int i;
+
+    /* The first buffer of the frame must be set last */
+    for (i = fan_in - 1; i >= 0; i--) {
+        soc_dma_ring_tx_buf_sg_set(tx_ring_buf, (uint8_t *) tx_buf + i * part_size, part_size, i, fan_in);
+    }
+}
+
+/*
+ * Loops back DMA_BENCH_TRANSFERS frames of buf_size bytes, keeping
+ * desc_count of them in flight, and reports the throughput and the
+ * time from sending each frame to receiving it back.
+ */
+static void dma_bench_run(
+        soc_peripheral_t dev,
+        int mode,
+        int buf_size,
+        int desc_count,
+        int fan_in)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+    uint32_t send_time[DMA_BENCH_DESC_MAX];
+    uint32_t start_time;
+    uint32_t elapsed;
+    uint32_t latency;
+    uint32_t latency_max = 0;
+    uint64_t latency_total = 0;
+    uint64_t bytes_per_sec;
+    int hub_busy_pct = -1; /* Unknown unless SOC_PERIPHERAL_STATS is set */
+#if SOC_PERIPHERAL_STATS
+    soc_peripheral_hub_stats_t hub_start;
+    soc_peripheral_hub_stats_t hub_end;
+#endif
+    int sent = 0;
+    int received = 0;
+    int i;
+
+    for (i = 0; i < desc_count; i++) {
+        soc_dma_ring_rx_buf_set(rx_ring_buf, rx_bufs[i], buf_size);
+    }
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_RX_REQUEST);
+
+#if SOC_PERIPHERAL_STATS
+    /* The loopback device is serviced by hub 0 unless mapped elsewhere */
+    soc_peripheral_hub_stats_get(SOC_PERIPHERAL_HUB_MAP(BITSTREAM_LOOPBACK_DEVICE_A), &hub_start);
+#endif
+    start_time = get_reference_time();
+
+    for (; sent < desc_count; sent++) {
+        send_time[sent % desc_count] = get_reference_time();
+        dma_bench_frame_send(tx_ring_buf, buf_size, fan_in);
+    }
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+
+    while (received < DMA_BENCH_TRANSFERS) {
+        void *rx_buf;
+        int length;
+        int sent_more = 0;
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        /*
+         * Every frame is sent before it can be received back, so
+         * the TX descriptors of the frames received are free.
+         */
+        while (soc_dma_ring_tx_buf_get(tx_ring_buf, NULL, NULL) != NULL);
+
+        while ((rx_buf = soc_dma_ring_rx_buf_get(rx_ring_buf, &length)) != NULL) {
+            configASSERT(length == buf_size);
+
+            /* Frames come back in the order they were sent */
+            latency = get_reference_time() - send_time[received % desc_count];
+            latency_total += latency;
+            if (latency > latency_max) {
+                latency_max = latency;
+            }
+            received++;
+
+            soc_dma_ring_rx_buf_set(rx_ring_buf, rx_buf, buf_size);
+
+            if (sent < DMA_BENCH_TRANSFERS) {
+                send_time[sent % desc_count] = get_reference_time();
+                dma_bench_frame_send(tx_ring_buf, buf_size, fan_in);
+                sent++;
+                sent_more = 1;
+            }
+        }
+
+        soc_peripheral_hub_dma_request(dev, SOC_DMA_RX_REQUEST);
+        if (sent_more) {
+            soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+        }
+    }
+
+    elapsed = get_reference_time() - start_time;
+#if SOC_PERIPHERAL_STATS
+    soc_peripheral_hub_stats_get(SOC_PERIPHERAL_HUB_MAP(BITSTREAM_LOOPBACK_DEVICE_A), &hub_end);
+    {
+        uint64_t busy = hub_end.busy_ticks - hub_start.busy_ticks;
+        uint64_t total = busy + hub_end.idle_ticks - hub_start.idle_ticks;
+        if (total > 0) {
+            hub_busy_pct = (int) (100 * busy / total);
+        }
+    }
+#endif
+
+    /* Each frame crosses the DMA framework twice, once each way */
+    bytes_per_sec = (2ULL * DMA_BENCH_TRANSFERS * buf_size * DMA_BENCH_TICKS_PER_US * 1000000) / elapsed;
+
+    debug_printf("%s size %d desc %d fan-in %d: %d KiB/s, latency avg %d us max %d us, hub busy %d%%\n",
+            mode == LOOPBACK_DEV_MODE_DIRECT ? "direct " : "channel",
+            buf_size, desc_count, fan_in,
+            (int) (bytes_per_sec / 1024),
+            (int) (latency_total / DMA_BENCH_TRANSFERS / DMA_BENCH_TICKS_PER_US),
+            (int) (latency_max / DMA_BENCH_TICKS_PER_US),
+            hub_busy_pct);
+}
+
+static void dma_bench(void *arg)
+{
+    static const int modes[] = { LOOPBACK_DEV_MODE_CHANNEL, LOOPBACK_DEV_MODE_DIRECT };
+    soc_peripheral_t dev;
+    int m, s, d, f;
+
+    (void) arg;
+
+    /* The ring operations are measured on their own first, without the hub */
+    dma_ring_bench_run();
+
+    dev = loopback_driver_init(
+            BITSTREAM_LOOPBACK_DEVICE_A,        /* Initializing loopback device A */
+            DMA_BENCH_DESC_MAX,                 /* Enough RX descriptors for the most frames in flight */
+            0,                                  /* The RX buffers are given to the ring by each run */
+            DMA_BENCH_DESC_MAX * DMA_BENCH_FAN_IN_MAX, /* Enough TX descriptors to gather each of them */
+            xTaskGetCurrentTaskHandle(),        /* This task is notified of each frame looped back */
+            appconfLOOPBACK_ISR_CORE,           /* The core this device's interrupts should happen on */
+            (rtos_irq_isr_t) dma_bench_isr);    /* The ISR to handle this device's interrupts */
+
+    soc_peripheral_common_dma_open(dev);
+
+    for (m = 0; m < ARRAY_SIZE(modes); m++) {
+        loopback_driver_mode_set(dev, modes[m]);
+
+        for (s = 0; s < ARRAY_SIZE(buf_sizes); s++) {
+            for (d = 0; d < ARRAY_SIZE(desc_counts); d++) {
+                for (f = 0; f < ARRAY_SIZE(fan_ins); f++) {
+                    dma_bench_run(dev, modes[m], buf_sizes[s], desc_counts[d], fan_ins[f]);
+                }
+            }
+        }
+    }
+
+    loopback_driver_mode_set(dev, LOOPBACK_DEV_MODE_CHANNEL);
+
+    debug_printf("DMA benchmark done\n");
+
+    vTaskDelete(NULL);
+}
+
+void dma_bench_create( UBaseType_t priority )
+{
+    xTaskCreate(dma_bench, "dma_bench", portTASK_STACK_DEPTH(dma_bench), NULL, priority, NULL);
+}
+
+#else
+
+void dma_bench_create( UBaseType_t priority )
+{
+    (void) priority;
+}
+
+#endif /* SOC_LOOPBACK_PERIPHERAL_USED */
@@ -0,0 +1,277 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#define DEBUG_UNIT DMA_BENCH
+#include "app_conf.h"
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "soc.h"
+#include "soc_fifo.h"
+
+/* App headers */
+#include "dma_ring_bench.h"
+
+#if SOC_LOOPBACK_PERIPHERAL_USED
+
+/*
+ * The functions the peripheral hub calls to move a ring on. They are
+ * not part of the application API, so are declared here just as they
+ * are in peripheral_hub.c.
+ */
+void *soc_dma_ring_buf_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more);
+
+void soc_dma_ring_buf_release(
+        soc_dma_ring_buf_t *ring_buf,
+        int rx,
+        int length);
+
+/* The number of descriptors in the ring each operation is timed on */
+#define DMA_RING_BENCH_DESC_COUNT       8
+
+/* The number of times the ring is filled and emptied for each measurement */
+#define DMA_RING_BENCH_PASSES           1000
+
+/* The number of buffers pushed through the ring by the stress test */
+#define DMA_RING_BENCH_STRESS_FRAMES    100000
+
+/* The reference clock runs at 100 MHz */
+#define DMA_RING_BENCH_NS_PER_TICK      10
+
+static SOC_DMA_BUF_DESC_ARRAY(ring_desc, DMA_RING_BENCH_DESC_COUNT);
+static soc_dma_ring_buf_t ring;
+
+/* The stress test's buffers each just hold the sequence number they were sent with */
+static uint32_t stress_bufs[DMA_RING_BENCH_DESC_COUNT];
+
+static struct {
+    TaskHandle_t bench_task;
+    uint32_t received;
+    uint32_t errors;
+} stress_hub;
+
+static void dma_ring_bench_report(
+        const char *op,
+        uint32_t ticks,
+        int ops)
+{
+    debug_printf("ring %-14s %d ns\n", op, (int) ((uint64_t) ticks * DMA_RING_BENCH_NS_PER_TICK / ops));
+}
+
+/*
+ * Times the application and hub sides of the ring in each direction,
+ * a full ring of descriptors at a time.
+ */
+static void dma_ring_bench_ops(void)
+{
+    static const char * const op_names[] = {
+        "tx_buf_set", "hub tx", "tx_buf_get",
+        "rx_buf_set", "hub rx", "rx_buf_get",
+    };
+    uint32_t ticks[6] = { 0 };
+    uint32_t t;
+    int pass;
+    int i;
+
+    soc_dma_ring_buf_init(&ring, ring_desc, DMA_RING_BENCH_DESC_COUNT);
+
+    for (pass = 0; pass < DMA_RING_BENCH_PASSES; pass++) {
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            soc_dma_ring_tx_buf_set(&ring, &stress_bufs[i], sizeof(uint32_t));
+        }
+        ticks[0] += get_reference_time() - t;
+
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            int length;
+            (void) soc_dma_ring_buf_get(&ring, &length, NULL);
+            soc_dma_ring_buf_release(&ring, 0, length);
+        }
+        ticks[1] += get_reference_time() - t;
+
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            (void) soc_dma_ring_tx_buf_get(&ring, NULL, NULL);
+        }
+        ticks[2] += get_reference_time() - t;
+    }
+
+    soc_dma_ring_buf_init(&ring, ring_desc, DMA_RING_BENCH_DESC_COUNT);
+
+    for (pass = 0; pass < DMA_RING_BENCH_PASSES; pass++) {
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            soc_dma_ring_rx_buf_set(&ring, &stress_bufs[i], sizeof(uint32_t));
+        }
+        ticks[3] += get_reference_time() - t;
+
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            (void) soc_dma_ring_buf_get(&ring, NULL, NULL);
+            soc_dma_ring_buf_release(&ring, 1, sizeof(uint32_t));
+        }
+        ticks[4] += get_reference_time() - t;
+
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            (void) soc_dma_ring_rx_buf_get(&ring, NULL);
+        }
+        ticks[5] += get_reference_time() - t;
+    }
+
+    for (i = 0; i < 6; i++) {
+        dma_ring_bench_report(op_names[i], ticks[i], DMA_RING_BENCH_PASSES * DMA_RING_BENCH_DESC_COUNT);
+    }
+}
+
+/*
+ * Times putting words into a FIFO and getting them back out,
+ * a full FIFO at a time.
+ */
+static void dma_ring_bench_fifo_ops(void)
+{
+    soc_fifo_t fifo;
+    uint32_t put_ticks = 0;
+    uint32_t get_ticks = 0;
+    uint32_t word = 0;
+    uint32_t t;
+    int pass;
+    int i;
+
+    soc_fifo_init(fifo, DMA_RING_BENCH_DESC_COUNT, sizeof(uint32_t), 1);
+
+    for (pass = 0; pass < DMA_RING_BENCH_PASSES; pass++) {
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            (void) soc_fifo_put(fifo, &word);
+        }
+        put_ticks += get_reference_time() - t;
+
+        t = get_reference_time();
+        for (i = 0; i < DMA_RING_BENCH_DESC_COUNT; i++) {
+            (void) soc_fifo_get(fifo, &word);
+        }
+        get_ticks += get_reference_time() - t;
+    }
+
+    dma_ring_bench_report("fifo_put", put_ticks, DMA_RING_BENCH_PASSES * DMA_RING_BENCH_DESC_COUNT);
+    dma_ring_bench_report("fifo_get", get_ticks, DMA_RING_BENCH_PASSES * DMA_RING_BENCH_DESC_COUNT);
+}
+
+/*
+ * Plays the peripheral hub in the stress test. Each buffer must arrive
+ * in the order it was sent, with the length it was sent with.
+ */
+static void dma_ring_bench_stress_hub(void *arg)
+{
+    (void) arg;
+
+    while (stress_hub.received < DMA_RING_BENCH_STRESS_FRAMES) {
+        uint32_t *buf;
+        int length;
+
+        buf = soc_dma_ring_buf_get(&ring, &length, NULL);
+        if (buf == NULL) {
+            taskYIELD();
+            continue;
+        }
+
+        if (*buf != stress_hub.received || length != 1 + (stress_hub.received & 0xFF)) {
+            stress_hub.errors++;
+        }
+        stress_hub.received++;
+
+        soc_dma_ring_buf_release(&ring, 0, length);
+    }
+
+    xTaskNotifyGive(stress_hub.bench_task);
+    vTaskDelete(NULL);
+}
+
+/*
+ * Sends DMA_RING_BENCH_STRESS_FRAMES buffers through the ring to a
+ * task playing the hub, and takes each back once it is done with.
+ */
+static void dma_ring_bench_stress(void)
+{
+    TaskHandle_t hub_task;
+    uint32_t sent = 0;
+    uint32_t done = 0;
+    uint32_t errors = 0;
+    uint32_t start_time;
+    uint32_t elapsed;
+
+    soc_dma_ring_buf_init(&ring, ring_desc, DMA_RING_BENCH_DESC_COUNT);
+    stress_hub.bench_task = xTaskGetCurrentTaskHandle();
+    stress_hub.received = 0;
+    stress_hub.errors = 0;
+
+    xTaskCreate(dma_ring_bench_stress_hub, "ring_hub", portTASK_STACK_DEPTH(dma_ring_bench_stress_hub),
+            NULL, uxTaskPriorityGet(NULL), &hub_task);
+#if ( configUSE_CORE_AFFINITY == 1 && configNUM_CORES > 1 )
+    vTaskCoreAffinitySet(hub_task, 1 << 1);
+    vTaskCoreAffinitySet(NULL, 1 << 0);
+#else
+    (void) hub_task;
+#endif
+
+    start_time = get_reference_time();
+
+    while (done < DMA_RING_BENCH_STRESS_FRAMES) {
+        uint32_t *buf;
+        int length;
+        int progress = 0;
+
+        /* A buffer is only rewritten once the hub has released it and it has been taken back */
+        if (sent < DMA_RING_BENCH_STRESS_FRAMES && sent - done < DMA_RING_BENCH_DESC_COUNT) {
+            buf = &stress_bufs[sent % DMA_RING_BENCH_DESC_COUNT];
+            *buf = sent;
+            if (soc_dma_ring_tx_buf_try_set(&ring, buf, 1 + (sent & 0xFF)) == 0) {
+                sent++;
+                progress = 1;
+            }
+        }
+
+        while ((buf = soc_dma_ring_tx_buf_get(&ring, &length, NULL)) != NULL) {
+            if (buf != &stress_bufs[done % DMA_RING_BENCH_DESC_COUNT] || length != 1 + (done & 0xFF)) {
+                errors++;
+            }
+            done++;
+            progress = 1;
+        }
+
+        if (!progress) {
+            taskYIELD();
+        }
+    }
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    elapsed = get_reference_time() - start_time;
+
+#if ( configUSE_CORE_AFFINITY == 1 && configNUM_CORES > 1 )
+    vTaskCoreAffinitySet(NULL, tskNO_AFFINITY);
+#endif
+
+    errors += stress_hub.errors;
+
+    debug_printf("ring stress: %d buffers in %d us, %d errors\n",
+            DMA_RING_BENCH_STRESS_FRAMES,
+            (int) ((uint64_t) elapsed * DMA_RING_BENCH_NS_PER_TICK / 1000),
+            (int) errors);
+    configASSERT(errors == 0);
+}
+
+void dma_ring_bench_run(void)
+{
+    dma_ring_bench_ops();
+    dma_ring_bench_fifo_ops();
+    dma_ring_bench_stress();
+}
+
+#endif /* SOC_LOOPBACK_PERIPHERAL_USED */
@@ -0,0 +1,17 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef DMA_RING_BENCH_H_
+#define DMA_RING_BENCH_H_
+
+/*
+ * Measures the cost of each DMA ring buffer and FIFO operation, with
+ * the calling task playing both the application and the peripheral hub,
+ * and then stress tests a ring with the two played by separate tasks,
+ * on separate cores in the dma_bench_smp config, checking that every
+ * buffer comes through each side once and in order. Neither needs a
+ * peripheral or a board to be attached, so both run in the simulator
+ * too.
+ */
+void dma_ring_bench_run(void);
+
+#endif /* DMA_RING_BENCH_H_ */
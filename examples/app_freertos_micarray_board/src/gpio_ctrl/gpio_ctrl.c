@@ -11,16 +11,26 @@
 #include "rtos_support.h"
 
 /* BSP/bitstream headers */
+#include "soc_bsp_common.h"
 #include "bitstream_devices.h"
 #include "gpio_driver.h"
 
 /* App headers */
 #include "app_conf.h"
 #include "audio_pipeline.h"
+#include "bottom_half.h"
 #include "xcore_c.h"
 
+/* The number of DMA RX buffers for port events */
+#define GPIO_CTRL_RX_DESC_COUNT 2
+
+/* The gpio_id of the events that gpio_ctrl_vad_indicate() queues, which is not a real port */
+#define GPIO_CTRL_VAD_EVENT GPIO_TOTAL_PORT_CNT
+
 static QueueHandle_t gpio_event_q;
-static TaskHandle_t gpio_handler_task;
+
+/* Set while gpio_events_bh() is queued and has yet to start getting events */
+static volatile int gpio_events_bh_queued;
 static TimerHandle_t volume_up_timer;
 static TimerHandle_t volume_down_timer;
 
@@ -46,6 +56,41 @@ static void volume_down( void )
     audiopipeline_set_stage1_gain( gain );
 }
 
+/*
+ * Moves the port events received onto the event queue. Called from the
+ * bottom half with pxYieldRequired NULL, or from the ISR otherwise.
+ */
+static void gpio_events_forward( soc_peripheral_t device, BaseType_t *pxYieldRequired )
+{
+    gpio_event_t events[ GPIOCONF_EVENT_BATCH_MAX * GPIO_CTRL_RX_DESC_COUNT ];
+    int count;
+
+    count = gpio_events_get( device, events, sizeof( events ) / sizeof( events[ 0 ] ) );
+
+    for( int i = 0; i < count; i++ )
+    {
+        /* An event that does not fit is lost, but the next one has the port's latest value */
+        if( pxYieldRequired != NULL )
+        {
+            xQueueSendFromISR( gpio_event_q, &events[ i ], pxYieldRequired );
+        }
+        else
+        {
+            xQueueSend( gpio_event_q, &events[ i ], 0 );
+        }
+    }
+}
+
+RTOS_BH_FN_ATTR
+static void gpio_events_bh( void *arg, uint32_t data )
+{
+    /* Cleared first, so that any events that arrive from here on queue this again */
+    gpio_events_bh_queued = 0;
+    RTOS_MEMORY_BARRIER();
+
+    gpio_events_forward( arg, NULL );
+}
+
 RTOS_IRQ_ISR_ATTR
 int gpio_isr( soc_peripheral_t device )
 {
@@ -55,11 +100,38 @@ int gpio_isr( soc_peripheral_t device )
     configASSERT(device == bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_A]);
 
     status = soc_peripheral_interrupt_status(device);
-    xTaskNotifyFromISR( gpio_handler_task, status, eSetBits, &xYieldRequired );
+
+    if( status & SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM )
+    {
+        /*
+         * Getting the events and queueing them is left to the bottom
+         * half. Events that arrive before it has started are got along
+         * with the rest, so it is only queued once for them all.
+         */
+        if( !gpio_events_bh_queued )
+        {
+            gpio_events_bh_queued = 1;
+            if( bottom_half_queue_from_isr( gpio_events_bh, device, 0, &xYieldRequired ) == pdFAIL )
+            {
+                gpio_events_bh_queued = 0;
+                gpio_events_forward( device, &xYieldRequired );
+            }
+        }
+    }
 
     return xYieldRequired;
 }
 
+void gpio_ctrl_vad_indicate( int active )
+{
+    gpio_event_t event = { GPIO_CTRL_VAD_EVENT, active, 0 };
+
+    if( gpio_event_q != NULL )
+    {
+        xQueueSend( gpio_event_q, &event, 0 );
+    }
+}
+
 void vVolumeUpCallback( TimerHandle_t pxTimer )
 {
     volume_up();
@@ -73,12 +145,15 @@ void vVolumeDownCallback( TimerHandle_t pxTimer )
 void gpio_ctrl_t0(void *arg)
 {
     soc_peripheral_t dev = arg;
+    gpio_event_t event;
     uint32_t mabs_buttons;
     uint32_t buttonA, buttonB, buttonC, buttonD;
-    uint32_t status;
+    uint32_t leds;
     BaseType_t gain = 0;
     BaseType_t saved_gain = 0;
 
+    soc_peripheral_common_dma_open(dev);
+
     volume_up_timer = xTimerCreate(
                             "vol_up",
                             pdMS_TO_TICKS(appconfGPIO_VOLUME_RAPID_FIRE_MS),
@@ -103,38 +178,37 @@ void gpio_ctrl_t0(void *arg)
     /* Initialize button inputs */
     gpio_init(dev, gpio_4A);
 
-    /* Enable interrupts on buttons */
-    gpio_irq_setup(dev, gpio_4A);
-    gpio_irq_enable(dev, gpio_4A);
+    /* Enable events on buttons */
+    gpio_event_enable(dev, gpio_4A);
+
+    /* Start from the buttons' current state */
+    mabs_buttons = gpio_read( dev, gpio_4A );
 
-    /* Turn on center LED */
-    gpio_write_pin(dev, gpio_8D, 2, 0);
+    /* The center LED is lit while voice is detected, which it is not yet */
+    gpio_write_pin(dev, gpio_8D, 2, 1);
 
     for (;;) {
-        xTaskNotifyWait(
-                0x00000000UL,    /* Don't clear notification bits on entry */
-                0xFFFFFFFFUL,    /* Reset full notification value on exit */
-                &status,         /* Pass out notification value into status */
-                portMAX_DELAY ); /* Wait indefinitely until next notification */
+        xQueueReceive( gpio_event_q, &event, portMAX_DELAY );
 
-        if( ( status & ( 1 << gpio_4A ) ) != 0 )
+        if( event.gpio_id == GPIO_CTRL_VAD_EVENT )
         {
-            mabs_buttons = gpio_read( dev, gpio_4A );
-            buttonA = ( mabs_buttons >> 0 ) & 0x01;
-            buttonB = ( mabs_buttons >> 1 ) & 0x01;
-            buttonC = ( mabs_buttons >> 2 ) & 0x01;
-            buttonD = ( mabs_buttons >> 3 ) & 0x01;
+            gpio_write_pin(dev, gpio_8D, 2, event.value ? 0 : 1);
+            continue;
         }
 
-        /* Turn on LEDS based on buttons */
-        gpio_write_pin(dev, gpio_8C, 0, buttonA);
-        gpio_write_pin(dev, gpio_8C, 1, buttonA);
-        gpio_write_pin(dev, gpio_8C, 2, buttonB);
-        gpio_write_pin(dev, gpio_8C, 3, buttonB);
-        gpio_write_pin(dev, gpio_8C, 4, buttonC);
-        gpio_write_pin(dev, gpio_8C, 5, buttonC);
-        gpio_write_pin(dev, gpio_8C, 6, buttonD);
-        gpio_write_pin(dev, gpio_8C, 7, buttonD);
+        if( event.gpio_id == gpio_4A )
+        {
+            mabs_buttons = event.value;
+        }
+
+        buttonA = ( mabs_buttons >> 0 ) & 0x01;
+        buttonB = ( mabs_buttons >> 1 ) & 0x01;
+        buttonC = ( mabs_buttons >> 2 ) & 0x01;
+        buttonD = ( mabs_buttons >> 3 ) & 0x01;
+
+        /* Turn on LEDS based on buttons, two LEDs per button, in one write */
+        leds = ( buttonA * 0x03 ) | ( buttonB * 0x0C ) | ( buttonC * 0x30 ) | ( buttonD * 0xC0 );
+        gpio_write_pins(dev, gpio_8C, leds, ~leds & 0xFF);
 
         /* Adjust volume based on LEDs */
         if( buttonA == 0 )   /* Up */
@@ -184,15 +258,16 @@ void gpio_ctrl_create( UBaseType_t priority )
 {
     soc_peripheral_t dev;
 
-    gpio_event_q = xQueueCreate(2, sizeof(void *));
+    gpio_event_q = xQueueCreate(appconfGPIO_EVENT_QUEUE_LENGTH, sizeof(gpio_event_t));
 
     dev = gpio_driver_init(
             BITSTREAM_GPIO_DEVICE_A,        /* Initializing GPIO device A */
+            GPIO_CTRL_RX_DESC_COUNT,        /* Give this device DMA RX buffers for its port events */
             NULL,                           /* No app data */
-            0,                              /* This device's interrupts should happen on core 0 */
+            appconfGPIO_ISR_CORE,           /* The core this device's interrupts should happen on */
             (rtos_irq_isr_t) gpio_isr );    /* The ISR to handle this device's interrupts */
 
-    xTaskCreate(gpio_ctrl_t0, "t0_gpio_ctrl", portTASK_STACK_DEPTH(gpio_ctrl_t0), dev, priority, &gpio_handler_task);
+    xTaskCreate(gpio_ctrl_t0, "t0_gpio_ctrl", portTASK_STACK_DEPTH(gpio_ctrl_t0), dev, priority, NULL);
 
 //    dev = gpio_driver_init(BITSTREAM_GPIO_DEVICE_B);
 
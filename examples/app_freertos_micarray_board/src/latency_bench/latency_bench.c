@@ -0,0 +1,72 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#define DEBUG_UNIT LATENCY_BENCH
+#include "app_conf.h"
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "soc.h"
+#include "soc_dma_buf_pool.h"
+
+/* App headers */
+#include "latency_bench.h"
+
+#if appconfLATENCY_BENCH
+
+/* The reference clock runs at 100 MHz */
+#define LATENCY_BENCH_TICKS_PER_US  100
+
+static latency_bench_hist_t hists[LATENCY_BENCH_SINK_COUNT];
+
+static const char *const sink_names[LATENCY_BENCH_SINK_COUNT] = { "i2s", "tcp", "udp" };
+
+const char *latency_bench_sink_name( latency_bench_sink_t sink )
+{
+    return sink < LATENCY_BENCH_SINK_COUNT ? sink_names[sink] : "?";
+}
+
+void latency_bench_record( latency_bench_sink_t sink, const void *frame )
+{
+    latency_bench_hist_t *hist = &hists[sink];
+    uint32_t us = ( get_reference_time() - soc_dma_buf_pool_timestamp_get( frame ) ) / LATENCY_BENCH_TICKS_PER_US;
+    uint32_t bucket = us / appconfLATENCY_BENCH_BUCKET_US;
+
+    if( bucket >= LATENCY_BENCH_BUCKET_COUNT )
+    {
+        bucket = LATENCY_BENCH_BUCKET_COUNT - 1;
+    }
+
+    /* The TCP sink is recorded by one task for each client */
+    taskENTER_CRITICAL();
+    hist->count++;
+    hist->total += us;
+    if( us > hist->max )
+    {
+        hist->max = us;
+    }
+    hist->buckets[bucket]++;
+    taskEXIT_CRITICAL();
+}
+
+void latency_bench_get( latency_bench_sink_t sink, latency_bench_hist_t *hist )
+{
+    configASSERT( sink < LATENCY_BENCH_SINK_COUNT );
+
+    taskENTER_CRITICAL();
+    *hist = hists[sink];
+    taskEXIT_CRITICAL();
+}
+
+void latency_bench_reset( void )
+{
+    taskENTER_CRITICAL();
+    memset( hists, 0, sizeof( hists ) );
+    taskEXIT_CRITICAL();
+}
+
+#endif /* appconfLATENCY_BENCH */
@@ -3,10 +3,13 @@
 #define DEBUG_UNIT QUEUE_TO_TCP
 #include "app_conf.h"
 
+#include <string.h>
+
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
 
 /* FreeRTOS Plus headers */
 #include "FreeRTOS_IP.h"
@@ -14,28 +17,250 @@
 
 /* Library headers */
 #include "soc.h"
+#include "soc_dma_buf_pool.h"
 
 /* BSP/bitstream headers */
 #include "bitstream_devices.h"
 #include "ethernet_driver.h"
+#include "micarray_driver.h"
 
 /* App headers */
 #include "queue_to_tcp_stream.h"
+#include "latency_bench.h"
+#include "audio_compress.h"
 
 static QueueHandle_t queue_to_tcp;
 
-static BaseType_t xConnected = 0;
+/*
+ * A connected client. Every frame from queue_to_tcp is shared by
+ * reference with each active client, through its own queue.
+ */
+typedef struct {
+    Socket_t xSocket;
+    QueueHandle_t xQueue;
+    BaseType_t xActive;
+    volatile BaseType_t xTooSlow;   /* Set when its queue overflowed and it is to be disconnected */
+    uint32_t ulDropped;             /* The frames dropped because its queue was full */
+} tcp_client_t;
+
+static tcp_client_t clients[appconfQUEUE_TO_TCP_MAX_CLIENTS];
+
+/* Held while xActive is changed, and while frames are handed to the clients */
+static SemaphoreHandle_t clients_lock;
+
+static volatile UBaseType_t uxClientCount = 0;
 
 BaseType_t is_queue_to_tcp_connected( void )
 {
-    return xConnected;
+    return uxClientCount > 0;
+}
+
+#define QUEUE_TO_TCP_SEND_TIMEOUT_MS 5000
+
+#define QUEUE_TO_TCP_FRAME_BYTES ( sizeof(micarray_sample_t) * appconfMIC_FRAME_LENGTH )
+
+#if appconfQUEUE_TO_TCP_COMPRESSION
+/*
+ * Each frame is compressed into a packet of its own from this pool,
+ * which takes its place from then on. A packet is at most this big.
+ */
+#define QUEUE_TO_TCP_PACKET_BYTES AUDIO_COMPRESS_MAX_BYTES( appconfMIC_FRAME_LENGTH, 1 )
+
+static soc_dma_buf_pool_t *packet_pool;
+
+/*
+ * A packet may be much smaller than a frame, so a full MSS may take
+ * more packets than there are. Everything held is sent once this many
+ * are.
+ */
+#define QUEUE_TO_TCP_PENDING_MAX appconfQUEUE_TO_TCP_PACKET_POOL_COUNT
+#else
+/*
+ * Less than a full MSS is held before a new frame is added, so this many
+ * frames is always enough.
+ */
+#define QUEUE_TO_TCP_PENDING_MAX ( ( ipconfigTCP_MSS - 1 ) / QUEUE_TO_TCP_FRAME_BYTES + 2 )
+#endif
+
+/*
+ * The frames, or compressed packets, received from the queue that have
+ * not yet all been sent. They are held by reference in the buffer pool,
+ * not copied.
+ */
+typedef struct {
+    void *frames[QUEUE_TO_TCP_PENDING_MAX];
+    size_t lengths[QUEUE_TO_TCP_PENDING_MAX];
+    TickType_t received[QUEUE_TO_TCP_PENDING_MAX];
+    int count;
+    size_t bytes;       /* The number of bytes of all the frames held */
+    size_t offset;      /* The number of bytes of frames[0] already sent */
+} tcp_aggregate_t;
+
+static size_t tcp_aggregate_bytes( const tcp_aggregate_t *agg )
+{
+    return agg->bytes - agg->offset;
+}
+
+static void tcp_aggregate_add( tcp_aggregate_t *agg, void *frame )
+{
+#if appconfQUEUE_TO_TCP_COMPRESSION
+    size_t length = audio_compress_frame_bytes( frame );
+#else
+    size_t length = QUEUE_TO_TCP_FRAME_BYTES;
+#endif
+
+    agg->frames[agg->count] = frame;
+    agg->lengths[agg->count] = length;
+    agg->received[agg->count] = xTaskGetTickCount();
+    agg->count++;
+    agg->bytes += length;
+}
+
+/*
+ * Drops the first length bytes held, returning each frame that has
+ * all been sent, or discarded when xSent is pdFALSE, to the pool.
+ */
+static void tcp_aggregate_consume( tcp_aggregate_t *agg, size_t length, BaseType_t xSent )
+{
+    int sent = 0;
+
+    agg->offset += length;
+    while( sent < agg->count && agg->offset >= agg->lengths[sent] )
+    {
+        agg->offset -= agg->lengths[sent];
+        agg->bytes -= agg->lengths[sent];
+        sent++;
+    }
+
+    for( int i = 0; i < sent; i++ )
+    {
+        if( xSent )
+        {
+            latency_bench_record( LATENCY_BENCH_SINK_TCP, agg->frames[i] );
+        }
+        soc_dma_buf_pool_put( agg->frames[i] );
+    }
+    for( int i = sent; i < agg->count; i++ )
+    {
+        agg->frames[i - sent] = agg->frames[i];
+        agg->lengths[i - sent] = agg->lengths[i];
+        agg->received[i - sent] = agg->received[i];
+    }
+    agg->count -= sent;
 }
 
+#if appconfQUEUE_TO_TCP_ZERO_COPY
+/*
+ * Copies the first length bytes held, across frame boundaries, into dst.
+ */
+static void tcp_aggregate_copy( const tcp_aggregate_t *agg, uint8_t *dst, size_t length )
+{
+    size_t offset = agg->offset;
+
+    for( int i = 0; length > 0; i++ )
+    {
+        size_t count = agg->lengths[i] - offset;
+
+        if( count > length )
+        {
+            count = length;
+        }
+        memcpy( dst, ( const uint8_t * ) agg->frames[i] + offset, count );
+        dst += count;
+        length -= count;
+        offset = 0;
+    }
+}
+#endif
+
+/*
+ * Sends the first length bytes held.
+ *
+ * With appconfQUEUE_TO_TCP_ZERO_COPY the frames are copied straight into
+ * the free space at the head of the socket's TX stream, which
+ * FreeRTOS_send() is then only told to commit. This saves FreeRTOS_send()
+ * from copying them again itself. Each commit wakes the IP task, which may
+ * send whatever is in the stream right away, so as much as fits before
+ * the end of the stream buffer is committed at once. The space is polled
+ * for when the stream is full, for up to QUEUE_TO_TCP_SEND_TIMEOUT_MS.
+ *
+ * Returns pdFALSE if the connection failed or timed out.
+ */
+static BaseType_t tcp_aggregate_send( Socket_t xSocket, tcp_aggregate_t *agg, size_t length )
+{
+#if appconfQUEUE_TO_TCP_ZERO_COPY
+    TickType_t xStart = xTaskGetTickCount();
+#endif
+
+    while( length > 0 )
+    {
+        uint8_t *pucHead = NULL;
+        BaseType_t xSpace = 0;
+
+#if appconfQUEUE_TO_TCP_ZERO_COPY
+        pucHead = FreeRTOS_get_tx_head( xSocket, &xSpace );
+#endif
+
+        if( pucHead == NULL )
+        {
+            /* The TX stream is only created by the first FreeRTOS_send(),
+            so up to the end of the first frame is sent the plain way. */
+            BaseType_t xCount = agg->lengths[0] - agg->offset;
+
+            if( ( size_t ) xCount > length )
+            {
+                xCount = length;
+            }
+            if( FreeRTOS_send( xSocket, ( const uint8_t * ) agg->frames[0] + agg->offset, xCount, 0 ) != xCount )
+            {
+                return pdFALSE;
+            }
+            tcp_aggregate_consume( agg, xCount, pdTRUE );
+            length -= xCount;
+        }
+#if appconfQUEUE_TO_TCP_ZERO_COPY
+        else if( xSpace > 0 )
+        {
+            BaseType_t xCount = length < ( size_t ) xSpace ? ( BaseType_t ) length : xSpace;
+
+            tcp_aggregate_copy( agg, pucHead, xCount );
+            if( FreeRTOS_send( xSocket, NULL, xCount, 0 ) != xCount )
+            {
+                return pdFALSE;
+            }
+            tcp_aggregate_consume( agg, xCount, pdTRUE );
+            length -= xCount;
+        }
+        else if( FreeRTOS_issocketconnected( xSocket ) == pdFALSE ||
+                 xTaskGetTickCount() - xStart > pdMS_TO_TICKS( QUEUE_TO_TCP_SEND_TIMEOUT_MS ) )
+        {
+            return pdFALSE;
+        }
+        else
+        {
+            vTaskDelay( 1 );
+        }
+#endif
+    }
+
+    return pdTRUE;
+}
+
+/*
+ * When the frame size does not line up with the MSS, sending each frame
+ * as it arrives wastes a short segment, and often an ACK, on most of
+ * them. Instead frames are held until at least a full
+ * MSS may be sent, and then only whole segments are sent, keeping the
+ * rest back. Held data is sent regardless once its oldest frame has
+ * waited appconfQUEUE_TO_TCP_MAX_LATENCY_MS.
+ */
 static void queue_to_tcp_sender(void *arg)
 {
-    Socket_t xConnectedSocket = ( Socket_t ) arg;
-    const TickType_t xSendTimeOut = pdMS_TO_TICKS( 5000 );
-    BaseType_t xSent;
+    tcp_client_t *client = arg;
+    Socket_t xConnectedSocket = client->xSocket;
+    const TickType_t xSendTimeOut = pdMS_TO_TICKS( QUEUE_TO_TCP_SEND_TIMEOUT_MS );
+    const TickType_t xMaxLatency = pdMS_TO_TICKS( appconfQUEUE_TO_TCP_MAX_LATENCY_MS );
+    tcp_aggregate_t agg = { .count = 0, .bytes = 0, .offset = 0 };
 
     xConnected = pdTRUE;
 
@@ -46,16 +271,50 @@ static void queue_to_tcp_sender(void *arg)
                          sizeof( xSendTimeOut ) );
 
     for (;;) {
-        int32_t *audio_data;
+        micarray_sample_t *audio_data;
+        TickType_t xWait = portMAX_DELAY;
+        BaseType_t xOk = pdTRUE;
+
+        if( agg.count > 0 )
+        {
+            TickType_t xWaited = xTaskGetTickCount() - agg.received[0];
+            xWait = xWaited < xMaxLatency ? xMaxLatency - xWaited : 0;
+        }
 
-        xQueueReceive(queue_to_tcp, &audio_data, portMAX_DELAY);
+        if( client->xTooSlow )
+        {
+            debug_printf("Disconnecting slow client\n");
+            xOk = pdFALSE;
+        }
+        else if( xWait == 0 || xQueueReceive(client->xQueue, &audio_data, xWait) == pdFALSE )
+        {
+            /* The oldest frame held has waited long enough */
+            xOk = tcp_aggregate_send( xConnectedSocket, &agg, tcp_aggregate_bytes( &agg ) );
+        }
+        else
+        {
+            size_t bytes;
 
-        xSent = FreeRTOS_send( xConnectedSocket,
-                               audio_data,
-                               sizeof(int32_t) * appconfMIC_FRAME_LENGTH,
-                               0);
+            tcp_aggregate_add( &agg, audio_data );
 
-        if( xSent != ( sizeof(int32_t) * appconfMIC_FRAME_LENGTH ) )
+            bytes = tcp_aggregate_bytes( &agg );
+
+            if( xMaxLatency == 0 )
+            {
+                xOk = tcp_aggregate_send( xConnectedSocket, &agg, bytes );
+            }
+            else if( bytes >= ipconfigTCP_MSS )
+            {
+                xOk = tcp_aggregate_send( xConnectedSocket, &agg, bytes - bytes % ipconfigTCP_MSS );
+            }
+            else if( agg.count == QUEUE_TO_TCP_PENDING_MAX )
+            {
+                /* Only compressed packets may fill it before a full MSS */
+                xOk = tcp_aggregate_send( xConnectedSocket, &agg, bytes );
+            }
+        }
+
+        if( xOk == pdFALSE )
         {
             FreeRTOS_shutdown( xConnectedSocket, FREERTOS_SHUT_RDWR );
 
@@ -68,16 +327,102 @@ static void queue_to_tcp_sender(void *arg)
             configASSERT( FreeRTOS_issocketconnected( xConnectedSocket ) == pdFALSE );
             FreeRTOS_closesocket( xConnectedSocket );
 
-            debug_printf("Connection closed\n");
+            debug_printf("Connection closed, %u frames dropped\n", client->ulDropped);
             debug_printf("Heap free: %d\n", xPortGetFreeHeapSize());
             debug_printf("Minimum heap free: %d\n", xPortGetMinimumEverFreeHeapSize());
 
-            vPortFree(audio_data);
-            xConnected = pdFALSE;
+            tcp_aggregate_consume( &agg, tcp_aggregate_bytes( &agg ), pdFALSE );
+
+            /* No more frames are queued once it is inactive */
+            xSemaphoreTake( clients_lock, portMAX_DELAY );
+            client->xActive = pdFALSE;
+            uxClientCount--;
+            xSemaphoreGive( clients_lock );
+
+            while( xQueueReceive( client->xQueue, &audio_data, 0 ) == pdTRUE )
+            {
+                soc_dma_buf_pool_put( audio_data );
+            }
+
             vTaskDelete( NULL );
         }
+    }
+}
 
-        vPortFree(audio_data);
+#if appconfQUEUE_TO_TCP_COMPRESSION
+/*
+ * Compresses a frame into a packet from the packet pool, keeping its
+ * timestamp so that its latency is still measured from when the hub
+ * received it. The frame is released either way. Returns NULL, so that
+ * the frame is dropped, when there is no packet free.
+ */
+static void *queue_to_tcp_compress( micarray_sample_t *audio_data )
+{
+    uint8_t *packet = soc_dma_buf_pool_get( packet_pool );
+
+    if( packet != NULL )
+    {
+        audio_compress_frame( audio_data, appconfMIC_FRAME_LENGTH, 1, appconfQUEUE_TO_TCP_COMPRESSION_SHIFT, packet );
+        soc_dma_buf_pool_timestamp_set( packet, soc_dma_buf_pool_timestamp_get( audio_data ) );
+    }
+    soc_dma_buf_pool_put( audio_data );
+
+    return packet;
+}
+#endif
+
+/*
+ * Shares each frame from queue_to_tcp with every active client, adding a
+ * reference to it for each one rather than copying it. With
+ * appconfQUEUE_TO_TCP_COMPRESSION it is compressed first, once for all
+ * of them, and its packet is shared instead. A client whose
+ * queue is full misses the frame, and is disconnected when
+ * appconfQUEUE_TO_TCP_SLOW_CLIENT_DISCONNECT is set, so that a slow
+ * client never holds up the others.
+ */
+static void queue_to_tcp_fanout( void *arg )
+{
+    for( ;; )
+    {
+        micarray_sample_t *audio_data;
+
+        xQueueReceive( queue_to_tcp, &audio_data, portMAX_DELAY );
+
+#if appconfQUEUE_TO_TCP_COMPRESSION
+        audio_data = queue_to_tcp_compress( audio_data );
+        if( audio_data == NULL )
+        {
+            continue;
+        }
+#endif
+
+        xSemaphoreTake( clients_lock, portMAX_DELAY );
+
+        if( uxClientCount > 1 )
+        {
+            soc_dma_buf_pool_ref( audio_data, uxClientCount - 1 );
+        }
+
+        for( int i = 0; i < appconfQUEUE_TO_TCP_MAX_CLIENTS; i++ )
+        {
+            tcp_client_t *client = &clients[i];
+
+            if( client->xActive && xQueueSend( client->xQueue, &audio_data, 0 ) == errQUEUE_FULL )
+            {
+                client->ulDropped++;
+#if appconfQUEUE_TO_TCP_SLOW_CLIENT_DISCONNECT
+                client->xTooSlow = pdTRUE;
+#endif
+                soc_dma_buf_pool_put( audio_data );
+            }
+        }
+
+        if( uxClientCount == 0 )
+        {
+            soc_dma_buf_pool_put( audio_data );
+        }
+
+        xSemaphoreGive( clients_lock );
     }
 }
 
@@ -87,7 +432,7 @@ static void vlisten_for_mic_tcp_conn( void *arg )
     Socket_t xListeningSocket, xConnectedSocket;
     socklen_t xSize = sizeof( xClient );
     const TickType_t xReceiveTimeOut = portMAX_DELAY;
-    const BaseType_t xBacklog = 1;
+    const BaseType_t xBacklog = appconfQUEUE_TO_TCP_MAX_CLIENTS;
 
     while( FreeRTOS_IsNetworkUp() == pdFALSE )
     {
@@ -125,12 +470,55 @@ static void vlisten_for_mic_tcp_conn( void *arg )
         xConnectedSocket = FreeRTOS_accept( xListeningSocket, &xClient, &xSize );
         configASSERT( xConnectedSocket != FREERTOS_INVALID_SOCKET );
 
-        xTaskCreate( queue_to_tcp_sender, "q2tcp_send", portTASK_STACK_DEPTH(queue_to_tcp_sender), ( void * ) xConnectedSocket, uxTaskPriorityGet( NULL ), NULL );
+        tcp_client_t *client = NULL;
+
+        xSemaphoreTake( clients_lock, portMAX_DELAY );
+        for( int i = 0; i < appconfQUEUE_TO_TCP_MAX_CLIENTS; i++ )
+        {
+            if( !clients[i].xActive )
+            {
+                client = &clients[i];
+                client->xSocket = xConnectedSocket;
+                client->xTooSlow = pdFALSE;
+                client->ulDropped = 0;
+                client->xActive = pdTRUE;
+                uxClientCount++;
+                break;
+            }
+        }
+        xSemaphoreGive( clients_lock );
+
+        if( client != NULL )
+        {
+            xTaskCreate( queue_to_tcp_sender, "q2tcp_send", portTASK_STACK_DEPTH(queue_to_tcp_sender), client, uxTaskPriorityGet( NULL ), NULL );
+        }
+        else
+        {
+            debug_printf("Too many clients, connection refused\n");
+            FreeRTOS_shutdown( xConnectedSocket, FREERTOS_SHUT_RDWR );
+            FreeRTOS_closesocket( xConnectedSocket );
+        }
     }
 }
 
 void queue_to_tcp_stream_create(QueueHandle_t input, UBaseType_t priority)
 {
     queue_to_tcp = input;
+
+    clients_lock = xSemaphoreCreateMutex();
+    configASSERT( clients_lock != NULL );
+
+#if appconfQUEUE_TO_TCP_COMPRESSION
+    packet_pool = soc_dma_buf_pool_create( QUEUE_TO_TCP_PACKET_BYTES, appconfQUEUE_TO_TCP_PACKET_POOL_COUNT );
+    configASSERT( packet_pool != NULL );
+#endif
+
+    for( int i = 0; i < appconfQUEUE_TO_TCP_MAX_CLIENTS; i++ )
+    {
+        clients[i].xQueue = xQueueCreate( appconfQUEUE_TO_TCP_CLIENT_QUEUE_LENGTH, sizeof( void * ) );
+        configASSERT( clients[i].xQueue != NULL );
+    }
+
+    xTaskCreate( queue_to_tcp_fanout, "q2tcp_fanout", portTASK_STACK_DEPTH(queue_to_tcp_fanout), NULL, priority, NULL );
     xTaskCreate( vlisten_for_mic_tcp_conn, "q2tcp_listen", portTASK_STACK_DEPTH(vlisten_for_mic_tcp_conn), NULL, priority, NULL );
 }
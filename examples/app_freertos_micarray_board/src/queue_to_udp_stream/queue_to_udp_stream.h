@@ -0,0 +1,9 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef QUEUE_TO_UDP_STREAM_H_
+#define QUEUE_TO_UDP_STREAM_H_
+
+void queue_to_udp_stream_create(QueueHandle_t input, UBaseType_t priority);
+BaseType_t is_queue_to_udp_subscribed( void );
+
+#endif /* QUEUE_TO_UDP_STREAM_H_ */
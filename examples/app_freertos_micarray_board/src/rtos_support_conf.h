@@ -0,0 +1,16 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_SUPPORT_CONF_H_
+#define RTOS_SUPPORT_CONF_H_
+
+#include "FreeRTOSConfig.h"
+#include "soc_conf.h"
+#include "soc_conf_defaults.h"
+
+/* Size the per core tables for just the cores FreeRTOS runs on */
+#define RTOS_MAX_CORE_COUNT                 configNUM_CORES
+
+/* Each peripheral registered with the hub on tile 0 takes one IRQ source */
+#define RTOS_IRQ_MAX_PERIPHERAL_SOURCES     SOC_MAX_PERIPHERALS
+
+#endif /* RTOS_SUPPORT_CONF_H_ */
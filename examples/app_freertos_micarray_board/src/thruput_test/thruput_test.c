@@ -3,9 +3,12 @@
 #define DEBUG_UNIT THRUPUT_TEST
 #include "app_conf.h"
 
+#include <string.h>
+
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
 /* FreeRTOS Plus headers */
 #include "FreeRTOS_IP.h"
@@ -17,45 +20,153 @@
 /* App headers */
 #include "thruput_test.h"
 
-static void thruput_test_sender( void *arg )
+#define THRUPUT_TEST_MAX_SEND_SIZE ( ipconfigTCP_MSS * 4 )
+
+/* The largest datagram that is not fragmented */
+#define THRUPUT_TEST_MAX_UDP_SEND_SIZE ( ipconfigNETWORK_MTU - 28 )
+
+/* Only ever read, so shared by every test */
+static uint8_t snd_buf[THRUPUT_TEST_MAX_SEND_SIZE];
+
+static volatile thruput_test_mode_t xMode = THRUPUT_TEST_TX;
+static volatile size_t xSendSize = THRUPUT_TEST_MAX_SEND_SIZE;
+
+/* Taken for the whole of a test, so that only one runs at a time */
+static SemaphoreHandle_t xTestLock;
+
+/* The task a bidirectional test's receiver tells once it is done */
+static TaskHandle_t xBidirSender;
+
+static thruput_test_result_t xResult;
+static BaseType_t xResultValid = pdFALSE;
+
+/* The counts taken as a test starts, to find the result from */
+static struct {
+    TickType_t ticks;
+#if RTOS_CPU_STATS
+    rtos_cpu_stats_t cpu;
+#endif
+#if SOC_PERIPHERAL_STATS
+    soc_peripheral_hub_stats_t hub[SOC_PERIPHERAL_HUB_COUNT];
+#endif
+} xStart;
+
+static const char *const pcModeNames[THRUPUT_TEST_MODE_COUNT] = { "tx", "rx", "bidir", "udp" };
+
+const char *thruput_test_mode_name( thruput_test_mode_t mode )
 {
-    Socket_t xConnectedSocket = ( Socket_t ) arg;
-    const TickType_t xSendTimeOut = pdMS_TO_TICKS( 5000 );
-    const size_t xTotalLengthToSend = 100*1024*1024; /* 100 MiB */
-    size_t xLenToSend;
-    BaseType_t xMSS;
-    BaseType_t xAlreadyTransmitted = 0, xBytesSent = 0;
-    uint8_t snd_buf[ipconfigTCP_MSS * 4];
+    return mode < THRUPUT_TEST_MODE_COUNT ? pcModeNames[mode] : "?";
+}
 
-    const BaseType_t xWaitForFullMSS = 1;
+void thruput_test_configure( thruput_test_mode_t mode, size_t send_size )
+{
+    size_t xMax = mode == THRUPUT_TEST_UDP ? THRUPUT_TEST_MAX_UDP_SEND_SIZE : THRUPUT_TEST_MAX_SEND_SIZE;
 
-    for( int i = 0; i < sizeof(snd_buf); i++ )
+    configASSERT( mode < THRUPUT_TEST_MODE_COUNT );
+
+    if( send_size == 0 || send_size > xMax )
     {
-        snd_buf[i] = i & 0xFF;
+        send_size = xMax;
     }
 
-    FreeRTOS_setsockopt( xConnectedSocket,
-                         0,
-                         FREERTOS_SO_SNDTIMEO,
-                         &xSendTimeOut,
-                         sizeof( xSendTimeOut ) );
+    xMode = mode;
+    xSendSize = send_size;
+}
 
-    /* Wait until we are sending a full MSS window. */
-    FreeRTOS_setsockopt( xConnectedSocket,
-                         0,
-                         FREERTOS_SO_SET_FULL_SIZE,
-                         &xWaitForFullMSS,
-                         sizeof( xWaitForFullMSS ) );
+BaseType_t thruput_test_result_get( thruput_test_result_t *result )
+{
+    BaseType_t xValid;
 
-    xMSS = FreeRTOS_mss( xConnectedSocket );
+    /* The result is not waited for while a test runs */
+    if( xSemaphoreTake( xTestLock, 0 ) == pdFALSE )
+    {
+        return pdFALSE;
+    }
+    xValid = xResultValid;
+    *result = xResult;
+    xSemaphoreGive( xTestLock );
+
+    return xValid;
+}
+
+/*
+ * Begins a test with the mode and send size set now. Waits for any test
+ * already running to finish.
+ */
+static void thruput_test_begin( void )
+{
+    xSemaphoreTake( xTestLock, portMAX_DELAY );
+
+    memset( &xResult, 0, sizeof( xResult ) );
+    xResult.mode = xMode;
+    xResult.send_size = xSendSize;
+
+#if RTOS_CPU_STATS
+    rtos_cpu_stats_get( &xStart.cpu );
+#endif
+#if SOC_PERIPHERAL_STATS
+    for( int i = 0; i < SOC_PERIPHERAL_HUB_COUNT; i++ )
+    {
+        soc_peripheral_hub_stats_get( i, &xStart.hub[i] );
+    }
+#endif
+    xStart.ticks = xTaskGetTickCount();
 
-    debug_printf("Thruput test begin, mss is %d\n", xMSS);
+    debug_printf("Thruput test begin, mode %s, send size %d\n", thruput_test_mode_name( xResult.mode ), xResult.send_size);
+}
+
+static void thruput_test_end( void )
+{
+    xResult.ms = ( xTaskGetTickCount() - xStart.ticks ) * portTICK_PERIOD_MS;
+
+#if RTOS_CPU_STATS
+    {
+        static rtos_cpu_stats_t xEnd;
+
+        rtos_cpu_stats_get( &xEnd );
+        xResult.core_count = xEnd.core_count;
+        xResult.core_total_ticks = xEnd.time - xStart.cpu.time;
+        for( int i = 0; i < xEnd.core_count; i++ )
+        {
+            xResult.core_busy_ticks[i] = xResult.core_total_ticks -
+                    ( xEnd.core[i].ticks[RTOS_CPU_STATS_IDLE] - xStart.cpu.core[i].ticks[RTOS_CPU_STATS_IDLE] );
+        }
+    }
+#endif
+#if SOC_PERIPHERAL_STATS
+    for( int i = 0; i < SOC_PERIPHERAL_HUB_COUNT; i++ )
+    {
+        soc_peripheral_hub_stats_t xEnd;
+
+        soc_peripheral_hub_stats_get( i, &xEnd );
+        xResult.hub_busy_ticks += xEnd.busy_ticks - xStart.hub[i].busy_ticks;
+        xResult.hub_total_ticks += ( xEnd.busy_ticks - xStart.hub[i].busy_ticks ) +
+                                   ( xEnd.idle_ticks - xStart.hub[i].idle_ticks );
+    }
+#endif
+
+    xResultValid = pdTRUE;
+
+    debug_printf("Thruput test complete, %u bytes sent and %u received in %u ms\n",
+                 ( unsigned ) xResult.tx_bytes, ( unsigned ) xResult.rx_bytes, ( unsigned ) xResult.ms);
+
+    xSemaphoreGive( xTestLock );
+}
+
+/*
+ * Sends appconfTHRUPUT_TEST_LENGTH bytes, xSendSize at a time.
+ */
+static void thruput_test_tcp_send( Socket_t xConnectedSocket )
+{
+    size_t xLenToSend;
+    size_t xAlreadyTransmitted = 0;
+    BaseType_t xBytesSent;
 
     /* Keep sending until the entire buffer has been sent. */
-    while( xAlreadyTransmitted < xTotalLengthToSend )
+    while( xAlreadyTransmitted < appconfTHRUPUT_TEST_LENGTH )
     {
         /* How many bytes are left to send? */
-        xLenToSend = FreeRTOS_min_int32(xTotalLengthToSend - xAlreadyTransmitted, 4 * xMSS);
+        xLenToSend = FreeRTOS_min_int32(appconfTHRUPUT_TEST_LENGTH - xAlreadyTransmitted, xResult.send_size);
 
         xBytesSent = FreeRTOS_send(
                 xConnectedSocket,
@@ -70,6 +181,7 @@ static void thruput_test_sender( void *arg )
         {
             /* Data was sent successfully. */
             xAlreadyTransmitted += xBytesSent;
+            xResult.tx_bytes += xBytesSent;
         }
         else if ( xBytesSent != -pdFREERTOS_ERRNO_ENOSPC )
         {
@@ -77,11 +189,88 @@ static void thruput_test_sender( void *arg )
             break;
         }
     }
+}
+
+/*
+ * Receives until the peer closes the connection.
+ */
+static void thruput_test_tcp_receive( Socket_t xConnectedSocket )
+{
+    static uint8_t rcv_buf[ipconfigTCP_MSS];
+    BaseType_t xBytesReceived;
+
+    while( ( xBytesReceived = FreeRTOS_recv( xConnectedSocket, rcv_buf, sizeof( rcv_buf ), 0 ) ) >= 0 )
+    {
+        xResult.rx_bytes += xBytesReceived;
+    }
+}
+
+/*
+ * Runs the receiving half of a bidirectional test, alongside the sending
+ * half in thruput_test_sender().
+ */
+static void thruput_test_receiver( void *arg )
+{
+    Socket_t xConnectedSocket = ( Socket_t ) arg;
+
+    thruput_test_tcp_receive( xConnectedSocket );
+
+    xTaskNotifyGive( xBidirSender );
+    vTaskDelete( NULL );
+}
+
+static void thruput_test_sender( void *arg )
+{
+    Socket_t xConnectedSocket = ( Socket_t ) arg;
+    const TickType_t xSendTimeOut = pdMS_TO_TICKS( 5000 );
+    BaseType_t xMSS;
+    uint8_t dummy;
+
+    const BaseType_t xWaitForFullMSS = 1;
+
+    FreeRTOS_setsockopt( xConnectedSocket,
+                         0,
+                         FREERTOS_SO_SNDTIMEO,
+                         &xSendTimeOut,
+                         sizeof( xSendTimeOut ) );
+
+    /* Wait until we are sending a full MSS window. */
+    FreeRTOS_setsockopt( xConnectedSocket,
+                         0,
+                         FREERTOS_SO_SET_FULL_SIZE,
+                         &xWaitForFullMSS,
+                         sizeof( xWaitForFullMSS ) );
+
+    xMSS = FreeRTOS_mss( xConnectedSocket );
+
+    thruput_test_begin();
+
+    debug_printf("mss is %d\n", xMSS);
+
+    switch( xResult.mode )
+    {
+    case THRUPUT_TEST_RX:
+        thruput_test_tcp_receive( xConnectedSocket );
+        break;
 
-    debug_printf("Thruput test complete, closing connection\n");
+    case THRUPUT_TEST_BIDIR:
+        xBidirSender = xTaskGetCurrentTaskHandle();
+        xTaskCreate( thruput_test_receiver, "thruput_test_receiver", portTASK_STACK_DEPTH(thruput_test_receiver), ( void * ) xConnectedSocket, uxTaskPriorityGet( NULL ), NULL );
+        thruput_test_tcp_send( xConnectedSocket );
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+        break;
+
+    default:
+        thruput_test_tcp_send( xConnectedSocket );
+        break;
+    }
+
+    thruput_test_end();
+
+    debug_printf("Closing thruput test connection\n");
     /* Initiate graceful shutdown. */
     FreeRTOS_shutdown( xConnectedSocket, FREERTOS_SHUT_RDWR );
-    while( FreeRTOS_recv( xConnectedSocket, snd_buf, sizeof(snd_buf), FREERTOS_MSG_DONTWAIT ) >= 0 )
+    while( FreeRTOS_recv( xConnectedSocket, &dummy, sizeof(dummy), FREERTOS_MSG_DONTWAIT ) >= 0 )
     {
         vTaskDelay(pdMS_TO_TICKS( 100 ));
     }
@@ -91,6 +280,67 @@ static void thruput_test_sender( void *arg )
     vTaskDelete( NULL );
 }
 
+/*
+ * Any datagram sent to appconfTHRUPUT_TEST_PORT starts a UDP test when
+ * that is the mode set, which sends back to where it came from. Any
+ * datagrams received while it runs are counted, so the peer may send
+ * at the same time.
+ */
+static void vthruput_test_udp( void *arg )
+{
+    struct freertos_sockaddr xClient, xFrom, xBindAddress;
+    socklen_t xSize = sizeof( xFrom );
+    static uint8_t rcv_buf[THRUPUT_TEST_MAX_UDP_SEND_SIZE];
+    Socket_t xSocket;
+    BaseType_t xBytesReceived;
+
+    while( FreeRTOS_IsNetworkUp() == pdFALSE )
+    {
+        vTaskDelay(pdMS_TO_TICKS( 100 ));
+    }
+
+    xSocket = FreeRTOS_socket(
+            FREERTOS_AF_INET,
+            FREERTOS_SOCK_DGRAM,
+            FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    xBindAddress.sin_port = FreeRTOS_htons( appconfTHRUPUT_TEST_PORT );
+    FreeRTOS_bind( xSocket, &xBindAddress, sizeof( xBindAddress ) );
+
+    for( ;; )
+    {
+        size_t xAlreadyTransmitted = 0;
+
+        /* Wait for a datagram to start the test */
+        if( FreeRTOS_recvfrom( xSocket, rcv_buf, sizeof( rcv_buf ), 0, &xClient, &xSize ) < 0 || xMode != THRUPUT_TEST_UDP )
+        {
+            continue;
+        }
+
+        thruput_test_begin();
+
+        while( xAlreadyTransmitted < appconfTHRUPUT_TEST_LENGTH )
+        {
+            size_t xLenToSend = FreeRTOS_min_int32(appconfTHRUPUT_TEST_LENGTH - xAlreadyTransmitted, xResult.send_size);
+
+            /* Nothing is counted as sent that the stack could not buffer */
+            if( FreeRTOS_sendto( xSocket, snd_buf, xLenToSend, 0, &xClient, sizeof( xClient ) ) > 0 )
+            {
+                xResult.tx_bytes += xLenToSend;
+            }
+            xAlreadyTransmitted += xLenToSend;
+
+            while( ( xBytesReceived = FreeRTOS_recvfrom( xSocket, rcv_buf, sizeof( rcv_buf ), FREERTOS_MSG_DONTWAIT, &xFrom, &xSize ) ) > 0 )
+            {
+                xResult.rx_bytes += xBytesReceived;
+            }
+        }
+
+        thruput_test_end();
+    }
+}
+
 static void vthruput_test( void *arg )
 {
     struct freertos_sockaddr xClient, xBindAddress;
@@ -151,5 +401,14 @@ static void vthruput_test( void *arg )
 
 void thruput_test_create( UBaseType_t priority )
 {
+    for( int i = 0; i < sizeof(snd_buf); i++ )
+    {
+        snd_buf[i] = i & 0xFF;
+    }
+
+    xTestLock = xSemaphoreCreateMutex();
+    configASSERT( xTestLock != NULL );
+
     xTaskCreate( vthruput_test, "thruput_test", portTASK_STACK_DEPTH(vthruput_test), NULL, priority, NULL );
+    xTaskCreate( vthruput_test_udp, "thruput_udp", portTASK_STACK_DEPTH(vthruput_test_udp), NULL, priority, NULL );
 }
@@ -3,6 +3,49 @@
 #ifndef THRUPUT_TEST_H_
 #define THRUPUT_TEST_H_
 
+#include "rtos_support.h"
+
+typedef enum {
+    THRUPUT_TEST_TX,        /* Send appconfTHRUPUT_TEST_LENGTH bytes over TCP */
+    THRUPUT_TEST_RX,        /* Receive over TCP until the peer closes the connection */
+    THRUPUT_TEST_BIDIR,     /* Both of the above at once, over the same connection */
+    THRUPUT_TEST_UDP,       /* Send appconfTHRUPUT_TEST_LENGTH bytes over UDP, counting any received meanwhile */
+    THRUPUT_TEST_MODE_COUNT
+} thruput_test_mode_t;
+
+/*
+ * The result of the last test that ran. The CPU and hub times are only
+ * filled in when RTOS_CPU_STATS and SOC_PERIPHERAL_STATS are set. The
+ * CPU counts can only cover a test shorter than 42 seconds.
+ */
+typedef struct {
+    thruput_test_mode_t mode;
+    size_t send_size;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t ms;                                /* How long the test ran for */
+    uint32_t core_count;
+    uint32_t core_busy_ticks[RTOS_MAX_CORE_COUNT];
+    uint32_t core_total_ticks;
+    uint64_t hub_busy_ticks;
+    uint64_t hub_total_ticks;
+} thruput_test_result_t;
+
 void thruput_test_create( UBaseType_t priority );
 
+/*
+ * Sets the mode of, and the size of each send made by, the tests run by
+ * the connections or datagrams that arrive from now on. send_size is
+ * clamped to what the mode allows.
+ */
+void thruput_test_configure( thruput_test_mode_t mode, size_t send_size );
+
+/*
+ * Gets the result of the last test that finished. Returns pdFALSE if
+ * none has, or if a test is running now.
+ */
+BaseType_t thruput_test_result_get( thruput_test_result_t *result );
+
+const char *thruput_test_mode_name( thruput_test_mode_t mode );
+
 #endif /* THRUPUT_TEST_H_ */
@@ -0,0 +1,85 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_support.h"
+
+/* App headers */
+#include "tickless_idle.h"
+
+#if configUSE_TICKLESS_IDLE
+
+/* The number of reference timer ticks in each RTOS tick */
+#define TICKLESS_IDLE_TICK_PERIOD ( configCPU_CLOCK_HZ / configTICK_RATE_HZ )
+
+/*
+ * The reference time that the current tick began at. It is moved on by
+ * a tick period for each tick counted, whether by the tick ISR or by
+ * vTaskStepTick(), so that however many times the core sleeps the tick
+ * count never drifts from the reference time by more than a tick.
+ */
+static uint32_t tick_time;
+static int tick_started;
+
+void tickless_idle_tick( uint32_t tick_count )
+{
+    ( void ) tick_count;
+
+    if( !tick_started )
+    {
+        tick_time = get_reference_time();
+        tick_started = 1;
+    }
+    else
+    {
+        tick_time += TICKLESS_IDLE_TICK_PERIOD;
+    }
+}
+
+void tickless_idle_step( uint32_t ticks )
+{
+    tick_time += ticks * TICKLESS_IDLE_TICK_PERIOD;
+}
+
+void tickless_idle_sleep( uint32_t expected_idle_ticks )
+{
+    uint32_t mask;
+    uint32_t missed;
+
+    mask = rtos_interrupt_mask_all();
+
+    /*
+     * Before the first tick there is no tick time to sleep from. A task
+     * may also have been readied by an ISR since the idle task decided
+     * to sleep, in which case it must not.
+     */
+    if( tick_started && eTaskConfirmSleepModeStatus() != eAbortSleep )
+    {
+        /* Wake when the tick that unblocks the next task is due */
+        rtos_irq_sleep( tick_time + expected_idle_ticks * TICKLESS_IDLE_TICK_PERIOD );
+
+        /*
+         * The tick timer's interrupt is left pending while the core
+         * sleeps, so the tick ISR runs once interrupts are unmasked and
+         * counts one of the ticks missed. vTaskStepTick() counts the rest,
+         * but may not count the tick that unblocks the next task, which
+         * must be left to the tick ISR.
+         */
+        missed = ( get_reference_time() - tick_time ) / TICKLESS_IDLE_TICK_PERIOD;
+        if( missed > expected_idle_ticks )
+        {
+            missed = expected_idle_ticks;
+        }
+        if( missed > 1 )
+        {
+            vTaskStepTick( missed - 1 );
+        }
+    }
+
+    rtos_interrupt_mask_set( mask );
+}
+
+#endif /* configUSE_TICKLESS_IDLE */
@@ -0,0 +1,26 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef TICKLESS_IDLE_H_
+#define TICKLESS_IDLE_H_
+
+#include <stdint.h>
+
+/*
+ * The tickless idle used when configUSE_TICKLESS_IDLE is set. FreeRTOSConfig.h
+ * maps portSUPPRESS_TICKS_AND_SLEEP() onto tickless_idle_sleep(), and the tick
+ * count trace macros onto the other two, which keep track of the reference time
+ * that the current tick began at.
+ *
+ * The core sleeps with rtos_irq_sleep(), with interrupts masked, so the tick
+ * timer cannot interrupt it and the tick is stopped without having to touch
+ * the port's tick timer. It is woken either by the deadline of the next task
+ * timeout, or by an IRQ, such as a DMA completion sent by the peripheral hub.
+ */
+
+void tickless_idle_sleep( uint32_t expected_idle_ticks );
+
+void tickless_idle_tick( uint32_t tick_count );
+
+void tickless_idle_step( uint32_t ticks );
+
+#endif /* TICKLESS_IDLE_H_ */
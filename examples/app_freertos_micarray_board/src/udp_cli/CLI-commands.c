@@ -36,6 +36,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* FreeRTOS includes. */
 #include "FreeRTOS.h"
@@ -54,6 +55,11 @@ commands. */
 /* App includes */
 #include "CLI-commands.h"
 #include "audio_pipeline.h"
+#include "audio_params.h"
+#include "thruput_test.h"
+#include "latency_bench.h"
+#include "power_manager.h"
+#include "rtos_support.h"
 
 #ifndef  configINCLUDE_TRACE_RELATED_CLI_COMMANDS
 	#define configINCLUDE_TRACE_RELATED_CLI_COMMANDS 0
@@ -90,6 +96,73 @@ portCLI_CALLBACK_FUNCTION_PROTO(prvGetMicGain, pcWriteBuffer, xWriteBufferLen ,
  */
 portCLI_CALLBACK_FUNCTION_PROTO(prvSetMicGain, pcWriteBuffer, xWriteBufferLen , pcCommandString);
 
+/*
+ * Implements the pipeline-stats command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvPipelineStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+
+#if RTOS_IRQ_STATS
+/*
+ * Implements the irq-stats command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvIRQStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
+#if RTOS_CPU_STATS
+/*
+ * Implements the cpu-stats command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvCPUStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
+#if RTOS_STACK_PAINT
+/*
+ * Implements the kstack-stats command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvKStackStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
+#if RTOS_IRQ_SLEEP
+/*
+ * Implements the sleep-stats command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvSleepStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
+#if appconfPOWER_MANAGER_ENABLED
+/*
+ * Implements the power-stats command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvPowerStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
+/*
+ * Implements the vad and vad-threshold commands.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvVADCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+portCLI_CALLBACK_FUNCTION_PROTO(prvVADThresholdCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+
+#if appconfBEAMFORMER_ENABLED
+/*
+ * Implements the beam command.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvBeamCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
+/*
+ * Implements the thruput-mode and thruput-stats commands.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvThruputModeCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+portCLI_CALLBACK_FUNCTION_PROTO(prvThruputStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+
+#if appconfLATENCY_BENCH
+/*
+ * Implements the latency-stats and latency-reset commands.
+ */
+portCLI_CALLBACK_FUNCTION_PROTO(prvLatencyStatsCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+portCLI_CALLBACK_FUNCTION_PROTO(prvLatencyResetCommand, pcWriteBuffer, xWriteBufferLen , pcCommandString);
+#endif
+
 /*
  * Defines a command that prints out IP address information.
  */
@@ -137,6 +210,149 @@ static const CLI_Command_Definition_t xGetMicGain =
     0
 };
 
+/* Structure that defines the "pipeline-stats" command line command.  This
+generates a table that shows the cost and latency of each audio pipeline stage */
+static const CLI_Command_Definition_t xPipelineStats =
+{
+    "pipeline-stats",
+    "pipeline-stats:\r\n Displays the audio pipeline's overloads, and a table showing the frame count, budget overruns, processing time and latency of each stage, in reference clock ticks\r\n\r\n",
+    prvPipelineStatsCommand,
+    0
+};
+
+#if RTOS_IRQ_STATS
+/* Structure that defines the "irq-stats" command line command.  This
+generates a table that shows the latency of each IRQ source */
+static const CLI_Command_Definition_t xIRQStats =
+{
+    "irq-stats",
+    "irq-stats:\r\n Displays a table showing the count and latency of each IRQ source, in reference clock ticks\r\n\r\n",
+    prvIRQStatsCommand,
+    0
+};
+#endif
+
+#if RTOS_CPU_STATS
+/* Structure that defines the "cpu-stats" command line command.  This
+outputs the time each RTOS core has spent idle, in tasks, in ISRs and in
+intercore yields, as hex words that are cheap to produce and to parse */
+static const CLI_Command_Definition_t xCPUStats =
+{
+    "cpu-stats",
+    "cpu-stats:\r\n Outputs the reference time and core count, then for each core its idle, task, ISR and yield ticks, in hex\r\n\r\n",
+    prvCPUStatsCommand,
+    0
+};
+#endif
+
+#if RTOS_STACK_PAINT
+/* Structure that defines the "kstack-stats" command line command.  This
+generates a table that shows how much of each RTOS core's kernel stack has
+been used.  The task stacks are shown by task-stats */
+static const CLI_Command_Definition_t xKStackStats =
+{
+    "kstack-stats",
+    "kstack-stats:\r\n Displays a table showing the size of each RTOS core's kernel stack and the most of it used, in words\r\n\r\n",
+    prvKStackStatsCommand,
+    0
+};
+#endif
+
+#if RTOS_IRQ_SLEEP
+/* Structure that defines the "sleep-stats" command line command.  This
+generates a table that shows how often and for how long each RTOS core has
+slept in tickless idle. */
+static const CLI_Command_Definition_t xSleepStats =
+{
+    "sleep-stats",
+    "sleep-stats:\r\n Displays a table showing how many times each RTOS core has slept, how many of those an IRQ woke it from, and the time asleep in microseconds\r\n\r\n",
+    prvSleepStatsCommand,
+    0
+};
+#endif
+
+#if appconfPOWER_MANAGER_ENABLED
+/* Structure that defines the "power-stats" command line command.  This shows
+the core clock divider the power manager has set, and the load it set it for. */
+static const CLI_Command_Definition_t xPowerStats =
+{
+    "power-stats",
+    "power-stats:\r\n Displays the core clock divider, the load of the busiest core or hub over the last interval, and how many times the divider has been raised and lowered\r\n\r\n",
+    prvPowerStatsCommand,
+    0
+};
+#endif
+
+/* Structure that defines the "vad" command line command.  This shows the
+state of the audio pipeline's voice activity detector */
+static const CLI_Command_Definition_t xVAD =
+{
+    "vad",
+    "vad:\r\n Displays whether voice is detected, the power of the last mic frame and the VAD thresholds, in Q31 of full scale\r\n\r\n",
+    prvVADCommand,
+    0
+};
+
+static const CLI_Command_Definition_t xVADThreshold =
+{
+    "vad-threshold",
+    "vad-threshold <on> <off>:\r\n Sets the frame powers at which voice is detected and taken to have stopped, in Q31 of full scale\r\n\r\n",
+    prvVADThresholdCommand,
+    2
+};
+
+#if appconfBEAMFORMER_ENABLED
+/* Structure that defines the "beam" command line command.  This shows the
+power of each beam, and may pick the one passed on */
+static const CLI_Command_Definition_t xBeam =
+{
+    "beam",
+    "beam [<beam>|auto]:\r\n Passes on the given beam, or the loudest, then displays the power of each beam and the one passed on\r\n\r\n",
+    prvBeamCommand,
+    -1
+};
+#endif
+
+/* Structure that defines the "thruput-mode" command line command.  This
+sets what the next thruput test connection or datagram does */
+static const CLI_Command_Definition_t xThruputMode =
+{
+    "thruput-mode",
+    "thruput-mode <tx|rx|bidir|udp> [send size]:\r\n Sets the mode of the next thruput test, and the number of bytes sent by each send it makes\r\n\r\n",
+    prvThruputModeCommand,
+    -1
+};
+
+/* Structure that defines the "thruput-stats" command line command.  This
+outputs the rates, CPU use and hub use measured by the last thruput test */
+static const CLI_Command_Definition_t xThruputStats =
+{
+    "thruput-stats",
+    "thruput-stats:\r\n Displays the rates, CPU use and hub use measured by the last thruput test\r\n\r\n",
+    prvThruputStatsCommand,
+    0
+};
+
+#if appconfLATENCY_BENCH
+/* Structure that defines the "latency-stats" command line command.  This
+generates a histogram of the latency of mic frames at each output */
+static const CLI_Command_Definition_t xLatencyStats =
+{
+    "latency-stats",
+    "latency-stats:\r\n Displays the count, average and maximum latency of the mic frames at each output in us, then a histogram of them\r\n\r\n",
+    prvLatencyStatsCommand,
+    0
+};
+
+static const CLI_Command_Definition_t xLatencyReset =
+{
+    "latency-reset",
+    "latency-reset:\r\n Clears the latency histograms\r\n\r\n",
+    prvLatencyResetCommand,
+    0
+};
+#endif
+
 #if configINCLUDE_DEMO_DEBUG_STATS != 0
 	/* Structure that defines the "ip-debug-stats" command line command. */
 	static const CLI_Command_Definition_t xIPDebugStats =
@@ -230,6 +446,33 @@ void vRegisterCLICommands( void )
 	FreeRTOS_CLIRegisterCommand( &xIPConfig );
     FreeRTOS_CLIRegisterCommand( &xGetMicGain );
     FreeRTOS_CLIRegisterCommand( &xSetMicGain );
+    FreeRTOS_CLIRegisterCommand( &xPipelineStats );
+#if RTOS_IRQ_STATS
+    FreeRTOS_CLIRegisterCommand( &xIRQStats );
+#endif
+#if RTOS_CPU_STATS
+    FreeRTOS_CLIRegisterCommand( &xCPUStats );
+#endif
+#if RTOS_STACK_PAINT
+    FreeRTOS_CLIRegisterCommand( &xKStackStats );
+#endif
+#if RTOS_IRQ_SLEEP
+    FreeRTOS_CLIRegisterCommand( &xSleepStats );
+#endif
+#if appconfPOWER_MANAGER_ENABLED
+    FreeRTOS_CLIRegisterCommand( &xPowerStats );
+#endif
+    FreeRTOS_CLIRegisterCommand( &xVAD );
+    FreeRTOS_CLIRegisterCommand( &xVADThreshold );
+#if appconfBEAMFORMER_ENABLED
+    FreeRTOS_CLIRegisterCommand( &xBeam );
+#endif
+    FreeRTOS_CLIRegisterCommand( &xThruputMode );
+    FreeRTOS_CLIRegisterCommand( &xThruputStats );
+#if appconfLATENCY_BENCH
+    FreeRTOS_CLIRegisterCommand( &xLatencyStats );
+    FreeRTOS_CLIRegisterCommand( &xLatencyReset );
+#endif
 
 	#if ipconfigSUPPORT_OUTGOING_PINGS == 1
 	{
@@ -468,6 +711,522 @@ BaseType_t xCurrentGain;
 }
 /*-----------------------------------------------------------*/
 
+portCLI_CALLBACK_FUNCTION( prvPipelineStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xStage = -1;
+pipeline_t *pxPipeline = audio_pipeline_get();
+pipeline_stats_t xStats;
+pipeline_overload_stats_t xOverload;
+BaseType_t xReturn;
+
+    /* Remove compile time warnings about unused parameters, and check the
+    write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+    write buffer length is adequate, so does not check for buffer overflows. */
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xStage == -1 )
+    {
+        /* The first time the function is called after the command has been
+        entered the overloads and a header string are returned. */
+        pipeline_overload_stats_get( pxPipeline, &xOverload );
+        sprintf( pcWriteBuffer, "Input dropped: %u\r\nOverload events: %u\r\nShedding: %s\r\n\r\nStage\tFrames\tDropped\tOverruns\tShed\tAvg busy\tMax busy\tAvg latency\tMax latency\r\n********************************************************************************************\r\n",
+                 ( unsigned ) xOverload.input_dropped,
+                 ( unsigned ) xOverload.events,
+                 xOverload.shedding ? "yes" : "no" );
+        xStage = 0;
+        return pdTRUE;
+    }
+
+    if( xStage < pipeline_stage_count( pxPipeline ) )
+    {
+        pipeline_stats_get( pxPipeline, xStage, &xStats );
+        sprintf( pcWriteBuffer, "%s\t%u\t%u\t%u\t\t%u\t%u\t\t%u\t\t%u\t\t%u\r\n",
+                 pipeline_stage_name( pxPipeline, xStage ),
+                 ( unsigned ) xStats.frames,
+                 ( unsigned ) xStats.dropped,
+                 ( unsigned ) xStats.overruns,
+                 ( unsigned ) xStats.shed,
+                 ( unsigned ) ( xStats.frames > 0 ? xStats.busy_total / xStats.frames : 0 ),
+                 ( unsigned ) xStats.busy_max,
+                 ( unsigned ) ( xStats.frames > 0 ? xStats.latency_total / xStats.frames : 0 ),
+                 ( unsigned ) xStats.latency_max );
+        xStage++;
+        xReturn = pdTRUE;
+    }
+    else
+    {
+        /* Start over the next time this command is executed. */
+        pcWriteBuffer[ 0 ] = 0x00;
+        xStage = -1;
+        xReturn = pdFALSE;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+#if RTOS_IRQ_STATS
+portCLI_CALLBACK_FUNCTION( prvIRQStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xSourceID = -1;
+rtos_irq_stats_t xStats;
+BaseType_t xReturn;
+
+    /* Remove compile time warnings about unused parameters, and check the
+    write buffer is not NULL.  NOTE - for simplicity, this example assumes the
+    write buffer length is adequate, so does not check for buffer overflows. */
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xSourceID == -1 )
+    {
+        /* The first time the function is called after the command has been
+        entered just a header string is returned. */
+        sprintf( pcWriteBuffer, "Source\tCount\tCoalesced\tMin\tAvg\tMax\r\n****************************************************\r\n" );
+        xSourceID = 0;
+        return pdTRUE;
+    }
+
+    /* Skip over the source IDs that are not in use. */
+    while( xSourceID < RTOS_IRQ_SOURCE_ID_COUNT && rtos_irq_stats_get( xSourceID, &xStats ) != 0 )
+    {
+        xSourceID++;
+    }
+
+    if( xSourceID < RTOS_IRQ_SOURCE_ID_COUNT )
+    {
+        sprintf( pcWriteBuffer, "%d\t%u\t%u\t\t%u\t%u\t%u\r\n",
+                 ( int ) xSourceID,
+                 ( unsigned ) xStats.count,
+                 ( unsigned ) xStats.coalesced,
+                 ( unsigned ) xStats.latency_min,
+                 ( unsigned ) ( xStats.count > 0 ? xStats.latency_total / xStats.count : 0 ),
+                 ( unsigned ) xStats.latency_max );
+        xSourceID++;
+        xReturn = pdTRUE;
+    }
+    else
+    {
+        /* Start over the next time this command is executed. */
+        pcWriteBuffer[ 0 ] = 0x00;
+        xSourceID = -1;
+        xReturn = pdFALSE;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+#endif /* RTOS_IRQ_STATS */
+
+#if RTOS_CPU_STATS
+portCLI_CALLBACK_FUNCTION( prvCPUStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xCoreID = -1;
+static rtos_cpu_stats_t xStats;
+BaseType_t xReturn;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xCoreID == -1 )
+    {
+        /* All the cores are read at once, the first time the function
+        is called, so that their counts are for the same moment. */
+        rtos_cpu_stats_get( &xStats );
+        sprintf( pcWriteBuffer, "%08x %08x\r\n", ( unsigned ) xStats.time, ( unsigned ) xStats.core_count );
+        xCoreID = 0;
+        return pdTRUE;
+    }
+
+    if( ( uint32_t ) xCoreID < xStats.core_count )
+    {
+        const uint32_t *pulTicks = xStats.core[ xCoreID ].ticks;
+
+        sprintf( pcWriteBuffer, "%08x %08x %08x %08x\r\n",
+                 ( unsigned ) pulTicks[ RTOS_CPU_STATS_IDLE ],
+                 ( unsigned ) pulTicks[ RTOS_CPU_STATS_TASK ],
+                 ( unsigned ) pulTicks[ RTOS_CPU_STATS_ISR ],
+                 ( unsigned ) pulTicks[ RTOS_CPU_STATS_YIELD ] );
+        xCoreID++;
+        xReturn = pdTRUE;
+    }
+    else
+    {
+        /* Start over the next time this command is executed. */
+        pcWriteBuffer[ 0 ] = 0x00;
+        xCoreID = -1;
+        xReturn = pdFALSE;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+#endif /* RTOS_CPU_STATS */
+
+#if RTOS_STACK_PAINT
+portCLI_CALLBACK_FUNCTION( prvKStackStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xCoreID = -1;
+rtos_kstack_stats_t xStats;
+BaseType_t xReturn;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xCoreID == -1 )
+    {
+        /* The first time the function is called after the command has been
+        entered just a header string is returned. */
+        sprintf( pcWriteBuffer, "Core\tWords\tUsed\tFree\r\n****************************\r\n" );
+        xCoreID = 0;
+        return pdTRUE;
+    }
+
+    /* Skip over the cores that have not painted their kernel stack. */
+    while( xCoreID < rtos_core_count() && rtos_kstack_stats_get( xCoreID, &xStats ) == 0 )
+    {
+        xCoreID++;
+    }
+
+    if( xCoreID < rtos_core_count() )
+    {
+        sprintf( pcWriteBuffer, "%d\t%u\t%u\t%u\r\n",
+                 ( int ) xCoreID,
+                 ( unsigned ) xStats.words,
+                 ( unsigned ) xStats.used_words,
+                 ( unsigned ) ( xStats.words - xStats.used_words ) );
+        xCoreID++;
+        xReturn = pdTRUE;
+    }
+    else
+    {
+        /* Start over the next time this command is executed. */
+        pcWriteBuffer[ 0 ] = 0x00;
+        xCoreID = -1;
+        xReturn = pdFALSE;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+#endif /* RTOS_STACK_PAINT */
+
+#if RTOS_IRQ_SLEEP
+portCLI_CALLBACK_FUNCTION( prvSleepStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xCoreID = -1;
+rtos_irq_sleep_stats_t xStats;
+BaseType_t xReturn;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xCoreID == -1 )
+    {
+        /* The first time the function is called after the command has been
+        entered just a header string is returned. */
+        sprintf( pcWriteBuffer, "Core\tSleeps\tIRQ\tTime(us)\r\n****************************\r\n" );
+        xCoreID = 0;
+        return pdTRUE;
+    }
+
+    if( rtos_irq_sleep_stats_get( xCoreID, &xStats ) == 0 )
+    {
+        sprintf( pcWriteBuffer, "%d\t%u\t%u\t%u\r\n",
+                 ( int ) xCoreID,
+                 ( unsigned ) xStats.sleeps,
+                 ( unsigned ) xStats.irq_wakes,
+                 ( unsigned ) ( xStats.ticks / ( configCPU_CLOCK_HZ / 1000000 ) ) );
+        xCoreID++;
+        xReturn = pdTRUE;
+    }
+    else
+    {
+        /* Start over the next time this command is executed. */
+        pcWriteBuffer[ 0 ] = 0x00;
+        xCoreID = -1;
+        xReturn = pdFALSE;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+#endif /* RTOS_IRQ_SLEEP */
+
+#if appconfPOWER_MANAGER_ENABLED
+portCLI_CALLBACK_FUNCTION( prvPowerStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+power_manager_stats_t xStats;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    power_manager_stats_get( &xStats );
+
+    sprintf( pcWriteBuffer, "Divider: %u\r\nLoad: %u.%u%%\r\nRaised: %u Lowered: %u\r\n",
+             ( unsigned ) xStats.divider,
+             ( unsigned ) xStats.load_permille / 10,
+             ( unsigned ) xStats.load_permille % 10,
+             ( unsigned ) xStats.raises,
+             ( unsigned ) xStats.lowers );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+#endif /* appconfPOWER_MANAGER_ENABLED */
+
+portCLI_CALLBACK_FUNCTION( prvVADCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+vad_t xVAD;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    audio_pipeline_vad_get( &xVAD );
+
+    sprintf( pcWriteBuffer, "Voice: %s\r\nPower: %d\r\nOn: %d Off: %d\r\nVoice frames: %u of %u\r\n",
+             xVAD.active ? "yes" : "no",
+             ( int ) xVAD.power,
+             ( int ) audio_param_get( AUDIO_PARAM_VAD_ON_THRESHOLD ),
+             ( int ) audio_param_get( AUDIO_PARAM_VAD_OFF_THRESHOLD ),
+             ( unsigned ) xVAD.voice_frames,
+             ( unsigned ) xVAD.frames );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+portCLI_CALLBACK_FUNCTION( prvVADThresholdCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+const audio_param_t xParams[] = { AUDIO_PARAM_VAD_ON_THRESHOLD, AUDIO_PARAM_VAD_OFF_THRESHOLD };
+int32_t lValues[ 2 ];
+const char *pcParameter;
+BaseType_t xParameterStringLength;
+
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &xParameterStringLength );
+    configASSERT( pcParameter );
+    lValues[ 0 ] = atol( pcParameter );
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &xParameterStringLength );
+    configASSERT( pcParameter );
+    lValues[ 1 ] = atol( pcParameter );
+
+    if( lValues[ 1 ] > lValues[ 0 ] )
+    {
+        sprintf( pcWriteBuffer, "The off threshold must not be above the on threshold\r\n" );
+        return pdFALSE;
+    }
+
+    audio_params_set( 2, xParams, lValues );
+    sprintf( pcWriteBuffer, "VAD thresholds set to %d and %d\r\n", ( int ) lValues[ 0 ], ( int ) lValues[ 1 ] );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+#if appconfBEAMFORMER_ENABLED
+portCLI_CALLBACK_FUNCTION( prvBeamCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xBeam = -1;
+static int32_t lPower[ appconfBEAMFORMER_BEAM_COUNT ];
+static BaseType_t xCurrentBeam;
+const char *pcParameter;
+BaseType_t xParameterStringLength;
+
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xBeam == -1 )
+    {
+        pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &xParameterStringLength );
+        if( pcParameter != NULL )
+        {
+            if( strncmp( pcParameter, "auto", xParameterStringLength ) == 0 )
+            {
+                audio_param_set( AUDIO_PARAM_BEAM, -1 );
+            }
+            else
+            {
+                audio_param_set( AUDIO_PARAM_BEAM, atoi( pcParameter ) );
+            }
+        }
+
+        xCurrentBeam = audio_pipeline_beam_get( lPower, appconfBEAMFORMER_BEAM_COUNT );
+        sprintf( pcWriteBuffer, "Beam\tPower\r\n********************\r\n" );
+    }
+    else
+    {
+        sprintf( pcWriteBuffer, "%d%s\t%d\r\n", ( int ) xBeam, xBeam == xCurrentBeam ? "*" : "", ( int ) lPower[ xBeam ] );
+    }
+
+    if( ++xBeam < appconfBEAMFORMER_BEAM_COUNT )
+    {
+        return pdTRUE;
+    }
+
+    xBeam = -1;
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+#endif
+
+portCLI_CALLBACK_FUNCTION( prvThruputModeCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+const char *pcParameter;
+BaseType_t xParameterStringLength;
+thruput_test_mode_t xMode;
+size_t xSendSize = 0;
+
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 1, &xParameterStringLength );
+
+    for( xMode = 0; xMode < THRUPUT_TEST_MODE_COUNT; xMode++ )
+    {
+        const char *pcName = thruput_test_mode_name( xMode );
+
+        if( pcParameter != NULL && strlen( pcName ) == ( size_t ) xParameterStringLength &&
+                strncmp( pcParameter, pcName, xParameterStringLength ) == 0 )
+        {
+            break;
+        }
+    }
+
+    if( xMode == THRUPUT_TEST_MODE_COUNT )
+    {
+        sprintf( pcWriteBuffer, "Mode must be tx, rx, bidir or udp\r\n" );
+        return pdFALSE;
+    }
+
+    pcParameter = FreeRTOS_CLIGetParameter( pcCommandString, 2, &xParameterStringLength );
+    if( pcParameter != NULL )
+    {
+        xSendSize = atoi( pcParameter );
+    }
+
+    thruput_test_configure( xMode, xSendSize );
+    sprintf( pcWriteBuffer, "Thruput test mode set to %s\r\n", thruput_test_mode_name( xMode ) );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+portCLI_CALLBACK_FUNCTION( prvThruputStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+thruput_test_result_t xResult;
+uint32_t ulMs;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( thruput_test_result_get( &xResult ) == pdFALSE )
+    {
+        sprintf( pcWriteBuffer, "No thruput test result, or a test is running\r\n" );
+        return pdFALSE;
+    }
+
+    ulMs = xResult.ms > 0 ? xResult.ms : 1;
+
+    pcWriteBuffer += sprintf( pcWriteBuffer, "Mode %s, send size %u, %u ms\r\nTX %u bytes, %u bytes/s\r\nRX %u bytes, %u bytes/s\r\n",
+                              thruput_test_mode_name( xResult.mode ),
+                              ( unsigned ) xResult.send_size,
+                              ( unsigned ) xResult.ms,
+                              ( unsigned ) xResult.tx_bytes,
+                              ( unsigned ) ( xResult.tx_bytes * 1000 / ulMs ),
+                              ( unsigned ) xResult.rx_bytes,
+                              ( unsigned ) ( xResult.rx_bytes * 1000 / ulMs ) );
+
+    for( uint32_t i = 0; i < xResult.core_count; i++ )
+    {
+        pcWriteBuffer += sprintf( pcWriteBuffer, "Core %u busy %u%%\r\n",
+                                  ( unsigned ) i,
+                                  ( unsigned ) ( xResult.core_total_ticks > 0 ? ( uint64_t ) xResult.core_busy_ticks[ i ] * 100 / xResult.core_total_ticks : 0 ) );
+    }
+
+    if( xResult.hub_total_ticks > 0 )
+    {
+        sprintf( pcWriteBuffer, "Hub busy %u%%\r\n", ( unsigned ) ( xResult.hub_busy_ticks * 100 / xResult.hub_total_ticks ) );
+    }
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+
+#if appconfLATENCY_BENCH
+portCLI_CALLBACK_FUNCTION( prvLatencyStatsCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+static BaseType_t xSink = -1;
+latency_bench_hist_t xHist;
+BaseType_t xReturn;
+
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    if( xSink == -1 )
+    {
+        /* The first time the function is called after the command has been
+        entered just a header string is returned. */
+        sprintf( pcWriteBuffer, "Output\tCount\tAvg\tMax\tBuckets of %u us\r\n****************************************************\r\n", ( unsigned ) appconfLATENCY_BENCH_BUCKET_US );
+        xSink = 0;
+        return pdTRUE;
+    }
+
+    if( xSink < LATENCY_BENCH_SINK_COUNT )
+    {
+        latency_bench_get( xSink, &xHist );
+        pcWriteBuffer += sprintf( pcWriteBuffer, "%s\t%u\t%u\t%u\t",
+                                  latency_bench_sink_name( xSink ),
+                                  ( unsigned ) xHist.count,
+                                  ( unsigned ) ( xHist.count > 0 ? xHist.total / xHist.count : 0 ),
+                                  ( unsigned ) xHist.max );
+        for( int i = 0; i < LATENCY_BENCH_BUCKET_COUNT; i++ )
+        {
+            pcWriteBuffer += sprintf( pcWriteBuffer, " %u", ( unsigned ) xHist.buckets[ i ] );
+        }
+        sprintf( pcWriteBuffer, "\r\n" );
+        xSink++;
+        xReturn = pdTRUE;
+    }
+    else
+    {
+        /* Start over the next time this command is executed. */
+        pcWriteBuffer[ 0 ] = 0x00;
+        xSink = -1;
+        xReturn = pdFALSE;
+    }
+
+    return xReturn;
+}
+/*-----------------------------------------------------------*/
+
+portCLI_CALLBACK_FUNCTION( prvLatencyResetCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
+{
+    ( void ) pcCommandString;
+    ( void ) xWriteBufferLen;
+    configASSERT( pcWriteBuffer );
+
+    latency_bench_reset();
+    sprintf( pcWriteBuffer, "Latency histograms cleared\r\n" );
+
+    return pdFALSE;
+}
+/*-----------------------------------------------------------*/
+#endif /* appconfLATENCY_BENCH */
+
 portCLI_CALLBACK_FUNCTION( prvParameterEchoCommand, pcWriteBuffer, xWriteBufferLen, pcCommandString )
 {
 const char *pcParameter;
@@ -3,6 +3,21 @@
 #include "soc.h"
 #include "bitstream.h"
 #include "bitstream_devices.h"
+#include "micarray_dev_conf_defaults.h"
+
+#if MICARRAYCONF_DMA_STREAMING
+#define MICARRAY_DEV_STREAMING_FLAG SOC_PERIPHERAL_TX_DMA_STREAMING
+#else
+#define MICARRAY_DEV_STREAMING_FLAG 0
+#endif
+
+#if MICARRAYCONF_DMA_REMOTE
+#define MICARRAY_DEV_REMOTE_FLAG SOC_PERIPHERAL_TX_DMA_REMOTE
+#else
+#define MICARRAY_DEV_REMOTE_FLAG 0
+#endif
+
+#define MICARRAY_DEV_FLAGS (MICARRAY_DEV_STREAMING_FLAG | MICARRAY_DEV_REMOTE_FLAG)
 
 static int initialized;
 
@@ -11,6 +26,9 @@ soc_peripheral_t bitstream_ethernet_devices[BITSTREAM_ETHERNET_DEVICE_COUNT];
 soc_peripheral_t bitstream_i2s_devices[BITSTREAM_I2S_DEVICE_COUNT];
 soc_peripheral_t bitstream_i2c_devices[BITSTREAM_I2C_DEVICE_COUNT];
 soc_peripheral_t bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_COUNT];
+#if SOC_LOOPBACK_PERIPHERAL_USED
+soc_peripheral_t bitstream_loopback_devices[BITSTREAM_LOOPBACK_DEVICE_COUNT];
+#endif
 
 void device_register(
         chanend mic_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
@@ -18,14 +36,18 @@ void device_register(
         chanend i2s_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
         chanend i2c_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
         chanend t0_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
-        chanend t1_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT])
+        chanend t1_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
+        chanend loopback_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT])
 {
-    bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_A] = soc_peripheral_register(mic_dev_ch);
+    bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_A] = soc_peripheral_register_flags(mic_dev_ch, MICARRAY_DEV_FLAGS);
     bitstream_ethernet_devices[BITSTREAM_ETHERNET_DEVICE_A] = soc_peripheral_register(eth_dev_ch);
     bitstream_i2s_devices[BITSTREAM_I2S_DEVICE_A] = soc_peripheral_register(i2s_dev_ch);
     bitstream_i2c_devices[BITSTREAM_I2C_DEVICE_A] = soc_peripheral_register(i2c_dev_ch);
     bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_A] = soc_peripheral_register(t0_gpio_dev_ch);
     bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_B] = soc_peripheral_register(t1_gpio_dev_ch);
+#if SOC_LOOPBACK_PERIPHERAL_USED
+    bitstream_loopback_devices[BITSTREAM_LOOPBACK_DEVICE_A] = soc_peripheral_register(loopback_dev_ch);
+#endif
 
     initialized = 1;
 }
@@ -11,6 +11,7 @@
 #include "i2c_dev.h"
 #include "i2s_dev.h"
 #include "gpio_dev.h"
+#include "loopback_dev.h"
 #endif //__XC__
 
 /*
@@ -52,7 +53,8 @@ void device_register(
         chanend i2s_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
         chanend i2c_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
         chanend t0_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
-        chanend t1_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT]);
+        chanend t1_gpio_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT],
+        chanend loopback_dev_ch[SOC_PERIPHERAL_CHANNEL_COUNT]);
 
 #ifdef __XC__
 }
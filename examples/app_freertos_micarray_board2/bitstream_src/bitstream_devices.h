@@ -34,5 +34,21 @@ enum {
 };
 extern soc_peripheral_t bitstream_gpio_devices[BITSTREAM_GPIO_DEVICE_COUNT];
 
+#if SOC_LOOPBACK_PERIPHERAL_USED
+enum {
+    BITSTREAM_LOOPBACK_DEVICE_A,
+    BITSTREAM_LOOPBACK_DEVICE_COUNT
+};
+extern soc_peripheral_t bitstream_loopback_devices[BITSTREAM_LOOPBACK_DEVICE_COUNT];
+#endif
+
+#if SOC_INTERTILE_PERIPHERAL_USED
+enum {
+    BITSTREAM_INTERTILE_DEVICE_A,
+    BITSTREAM_INTERTILE_DEVICE_COUNT
+};
+extern soc_peripheral_t bitstream_intertile_devices[BITSTREAM_INTERTILE_DEVICE_COUNT];
+#endif
+
 
 #endif /* BITSTREAM_DEVICES_H_ */
@@ -5,8 +5,8 @@
 
 /* Tile descriptors */
 #define SOC_MULTITILE        1
-#define SOC_TILE_0_INCLUDE   SOC_TILE_HAS_BITSTREAM
-#define SOC_TILE_1_INCLUDE   SOC_TILE_HAS_BOTH
+#define SOC_TILE_0_INCLUDE   SOC_TILE_HAS_BOTH
+#define SOC_TILE_1_INCLUDE   SOC_TILE_HAS_BITSTREAM
 #define SOC_TILE_2_INCLUDE   SOC_TILE_UNUSED
 #define SOC_TILE_3_INCLUDE   SOC_TILE_UNUSED
 
@@ -17,6 +17,20 @@
 #define SOC_I2S_PERIPHERAL_USED             (1)
 #define SOC_MICARRAY_PERIPHERAL_USED        (1)
 #define SOC_SDRAM_PERIPHERAL_USED           (0)
+#define SOC_INTERTILE_PERIPHERAL_USED       (0)
+
+/* GPIO devices A and B, on tiles 0 and 1 */
+#define SOC_GPIO_PERIPHERAL_COUNT           (2)
+
+/* The GPIO device on tile 0, left out by the smp build config */
+#ifndef SOC_TILE0_GPIO_PERIPHERAL_USED
+#define SOC_TILE0_GPIO_PERIPHERAL_USED      (1)
+#endif
+
+/* Only used by the DMA benchmark, see the dma_bench build config */
+#ifndef SOC_LOOPBACK_PERIPHERAL_USED
+#define SOC_LOOPBACK_PERIPHERAL_USED        (0)
+#endif
 
 /*
  * Peripheral Configuration
@@ -25,9 +39,10 @@
 /* I2S Config */
 #define I2SCONF_SAMPLE_FREQ         (48000)
 #define I2SCONF_MASTER_CLK_FREQ     (24576000)
-#define I2SCONF_AUDIO_FRAME_LEN     (256)
+#define I2SCONF_AUDIO_FRAME_LEN     (1 << MICARRAYCONF_FRAME_SIZE_LOG2)
 #define I2SCONF_FRAME_BUF_CNT       (4)
-#define I2SCONF_OFF_TILE            (0)
+#define I2SCONF_OFF_TILE            (1)
+#define I2SCONF_WORD_LENGTH_SHORT   MICARRAYCONF_WORD_LENGTH_SHORT
 
 /* I2C Config */
 #define I2CCONF_MAX_BUF_LEN         (128)
@@ -49,12 +64,29 @@
 /* MicArray Config */
 #define MICARRAYCONF_WORD_LENGTH_SHORT              (0)
 #define MICARRAYCONF_MAX_FRAME_SIZE_LOG2            (8)
+#define MICARRAYCONF_FRAME_SIZE_LOG2                (8)
+#if appconfNOISE_SUPPRESSOR_ENABLED
+/* The noise suppressor takes mics 0 and 1 as half overlapping frames ready for an FFT */
+#define MICARRAYCONF_FRAME_OVERLAP                  (1)
+#define MICARRAYCONF_FFT_PREPROCESSED               (1)
+#define MICARRAYCONF_DMA_CHANNEL_MASK               (0x0003)
+#else
+#define MICARRAYCONF_FRAME_OVERLAP                  (0)
+#endif
+#if appconfBEAMFORMER_ENABLED
+/* The beamformer needs all seven mics, which take two decimators */
+#define MICARRAYCONF_NUM_MICS                       (8)
+#define MICARRAYCONF_DECIMATOR_COUNT                (2)
+#define MICARRAYCONF_DMA_CHANNEL_MASK               (0x007F)
+#else
 #define MICARRAYCONF_NUM_MICS                       (4)
 #define MICARRAYCONF_DECIMATOR_COUNT                (1)
+#endif
 #define MICARRAYCONF_NUM_FRAME_BUFFERS              (2)
 #define MICARRAYCONF_PDM_INTEGRATION_FACTOR         (32)
 #define MICARRAYCONF_SAMPLE_RATE                    (48000)
 #define MICARRAYCONF_MASTER_TO_PDM_CLOCK_DIVIDER    (8)
 #define MICARRAYCONF_MASTER_CLOCK_FREQUENCY         (24576000)
+#define MICARRAYCONF_DMA_STREAMING                  (1)
 
 #endif /* SOC_CONF_H_ */
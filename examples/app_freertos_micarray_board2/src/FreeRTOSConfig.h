@@ -7,9 +7,23 @@ your application. */
 
 #define configUSE_PREEMPTION                    1
 #define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
-#define configUSE_TICKLESS_IDLE                 0
+#ifndef configUSE_TICKLESS_IDLE
+#define configUSE_TICKLESS_IDLE                 0   /* Set to 1 by the tickless build config */
+#endif
 #define configCPU_CLOCK_HZ                      100000000
-#define configNUM_CORES                         1
+#ifndef configNUM_CORES
+#define configNUM_CORES                         1   /* Set to 4 by the smp build config */
+#endif
+#define configUSE_CORE_AFFINITY                 ( configNUM_CORES > 1 )
+
+#if configUSE_TICKLESS_IDLE
+#if configNUM_CORES > 1
+#error Tickless idle is only supported when FreeRTOS runs on a single core
+#endif
+#if !RTOS_IRQ_SLEEP
+#error Tickless idle sleeps with rtos_irq_sleep(), which needs RTOS_IRQ_SLEEP
+#endif
+#endif
 #define configTICK_RATE_HZ                      1000
 #define configMAX_PRIORITIES                    32
 #define configRUN_MULTIPLE_PRIORITIES           1
@@ -97,5 +111,18 @@ your application. */
 
 /* A header file that defines trace macro can be included here. */
 
+#if configUSE_TICKLESS_IDLE && !defined(__ASSEMBLER__) && !defined(__XC__)
+/* See tickless_idle.h */
+#include "tickless_idle.h"
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) tickless_idle_sleep( xExpectedIdleTime )
+#define traceTASK_INCREMENT_TICK( xTickCount ) tickless_idle_tick( xTickCount )
+#define traceINCREASE_TICK_COUNT( xTicksToJump ) tickless_idle_step( xTicksToJump )
+#endif
+
+#if RTOS_CPU_STATS
+/* Tasks at the idle priority have their time counted as idle time */
+#define traceTASK_SWITCHED_IN() rtos_cpu_stats_task_switched( pxCurrentTCB->uxPriority == tskIDLE_PRIORITY )
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
 
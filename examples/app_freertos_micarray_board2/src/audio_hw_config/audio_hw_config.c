@@ -2,52 +2,66 @@
 
 /* BSP/bitstream headers */
 #include "i2c_driver.h"
+#include "i2c_regmap.h"
 
 /* Library headers */
 #include "soc.h"
 
 /* Application headers */
 #include "CS43L21.h"
+#include "audio_hw_config.h"
 
 #define I2S_CHANS_DAC 2
+#define CS43L21_COUNT (I2S_CHANS_DAC / 2)
 
+/*
+ * The CS43L21 registers, from the ID register up to the last one. They
+ * are kept so that the codec's volume and mute may be changed later
+ * without reading any of them back from it.
+ */
+#define CS43L21_REG_COUNT (CS43L21_REG_NONAME - CS43L21_REG_ID + 1)
+
+static i2c_regmap_t codec_regmap[CS43L21_COUNT];
+static uint8_t codec_regmap_mem[CS43L21_COUNT][I2C_REGMAP_MEM_SIZE(CS43L21_REG_COUNT)];
 
 static void initCS43L21(soc_peripheral_t i2c_dev)
 {
-    i2c_regop_res_t res;
+    int failed;
+
+    for (int i = 0; i < CS43L21_COUNT; i++) {
+        i2c_regmap_t *map = &codec_regmap[i];
+
+        i2c_regmap_init(map, i2c_dev, CS43L21_I2C_ADDR + i, CS43L21_REG_ID, CS43L21_REG_COUNT, codec_regmap_mem[i]);
+        i2c_regmap_volatile_set(map, CS43L21_REG_STATUS);
 
-    for (int i = CS43L21_I2C_ADDR; i < CS43L21_I2C_ADDR + (I2S_CHANS_DAC / 2); i++) {
         /* Power control (turn DAC off)
          * |7:reserved|6:PDN_DACB|5:PDN_DACA|4..1:reserved|0:PDN|
          */
-        res = i2c_driver_write_reg(i2c_dev, i, CS43L21_REG_POWER_CTL, 0x01);
-        xassert(res == I2C_REGOP_SUCCESS);
+        i2c_regmap_write(map, CS43L21_REG_POWER_CTL, 0x01);
         /* I2S Mode
          * |7:reserved|6:M/S|5..3:fmt|2..0:reserved|
          */
         // I2S mode, up to 24-bit data
-        res = i2c_driver_write_reg(i2c_dev, i, CS43L21_REG_IFACE_CTL, 0x08);
-        xassert(res == I2C_REGOP_SUCCESS);
+        i2c_regmap_write(map, CS43L21_REG_IFACE_CTL, 0x08);
         /* Speed Control
          * |7:AUTO|6..5:SPEED|4:tristate|3..1:reserved|0:MCLKDIV2|
          */
-        res = i2c_driver_write_reg(i2c_dev, i, CS43L21_REG_SPEED_CTL, 0b10000001);
-        xassert(res == I2C_REGOP_SUCCESS);
+        i2c_regmap_write(map, CS43L21_REG_SPEED_CTL, 0b10000001);
         /* DAC Output Control
          * |7..5:ampgain|4:DAC_SNGVOL|3:INV_PCMB|2:INV_PCMA|1:DACB_MUTE|0:DACA_MUTE|
          */
-        res = i2c_driver_write_reg(i2c_dev, i, CS43L21_REG_DAC_OUT_CTL, 0b00000000);
-        xassert(res == I2C_REGOP_SUCCESS);
+        i2c_regmap_write(map, CS43L21_REG_DAC_OUT_CTL, 0b00000000);
         /* DAC Control (disable DSP)
          * |7..6:DATA_SEL|5:FREEZE|4:reserved|3:DEEMPH|2:AMUTE|1::0:DAC_SZC|
          */
-        res = i2c_driver_write_reg(i2c_dev, i, CS43L21_REG_DAC_CTL, 0x00);
-        xassert(res == I2C_REGOP_SUCCESS);
+        i2c_regmap_write(map, CS43L21_REG_DAC_CTL, 0x00);
         /* Power control (turn DAC on)
          * |7:reserved|6:PDN_DACB|5:PDN_DACA|4..1:reserved|0:PDN|
          */
-        res = i2c_driver_write_reg(i2c_dev, i, CS43L21_REG_POWER_CTL, 0x00);
-        xassert(res == I2C_REGOP_SUCCESS);
+        i2c_regmap_write(map, CS43L21_REG_POWER_CTL, 0x00);
+
+        failed = i2c_regmap_flush(map);
+        xassert(failed == 0);
     }
 }
 
@@ -83,43 +97,48 @@ static void pll_init(soc_peripheral_t i2c_dev)
     #define SI5351A_MS2_P2_LOWER (0x41) /* Register 65 - Multisynth2 Parameters:
                                          *  - MS2_P2[7:0]
                                          */
-    i2c_regop_res_t res;
     // Configure SI5351A clock generator
-      int clock_gen_i2c_address = 0x62;
-    // Disable the CLK0 output (to xCORE MCLK in).
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_OE_CTRL, 0xFD);
-
-    // Enable Fanout of MS0 to other outputs.
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_FANOUT_EN, 0xD0);
-
-    /* Change R0 divider to divide by 2 instead of divide by 1.
-     * This stays at this value.
-     */
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_MS0_R0_DIV, 0x10);
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_MS2_R2_DIV, 0x30);
-
-    /* MCLK = 24.576MHz (12,24,48,96,192kHz)
-     * Sets powered up, integer mode, src PLLA, not inverted,
-     * Sel MS0 as src for CLK0 o/p, 4mA drive strength
-     */
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_CLK0_CTRL, 0x4D);
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_CLK2_CTRL, 0x69);
-    // Sets relevant bits of P1 divider setting
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_MS0_P1_UPPER, 0x05);
-
-    /* Now we write the lower bits of Multisynth Parameter P2.
-     * This updates all the divider values into the Multisynth block.
-     * The other multisynth parameters are correct so no need to write them.
-     */
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_MS0_P2_LOWER, 0x00);
-
-    // Wait a bit for Multisynth output to settle.
-    delay_microseconds(1000);
-
-    /* Enable all the clock outputs now we've finished changing the settings.
-     * This will output 24.576MHz on CLK0 to xcore
-     */
-    res = i2c_driver_write_reg(i2c_dev, clock_gen_i2c_address, SI5351A_OE_CTRL, 0xF8);
+    #define SI5351A_I2C_ADDR     (0x62)
+
+    static i2c_op_t ops[] = {
+        // Disable the CLK0 output (to xCORE MCLK in).
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_OE_CTRL, 0xFD),
+
+        // Enable Fanout of MS0 to other outputs.
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_FANOUT_EN, 0xD0),
+
+        /* Change R0 divider to divide by 2 instead of divide by 1.
+         * This stays at this value.
+         */
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_MS0_R0_DIV, 0x10),
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_MS2_R2_DIV, 0x30),
+
+        /* MCLK = 24.576MHz (12,24,48,96,192kHz)
+         * Sets powered up, integer mode, src PLLA, not inverted,
+         * Sel MS0 as src for CLK0 o/p, 4mA drive strength
+         */
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_CLK0_CTRL, 0x4D),
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_CLK2_CTRL, 0x69),
+        // Sets relevant bits of P1 divider setting
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_MS0_P1_UPPER, 0x05),
+
+        /* Now we write the lower bits of Multisynth Parameter P2.
+         * This updates all the divider values into the Multisynth block.
+         * The other multisynth parameters are correct so no need to write them.
+         */
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_MS0_P2_LOWER, 0x00),
+
+        // Wait a bit for Multisynth output to settle.
+        I2C_OP_WAIT(1000),
+
+        /* Enable all the clock outputs now we've finished changing the settings.
+         * This will output 24.576MHz on CLK0 to xcore
+         */
+        I2C_OP_WRITE(SI5351A_I2C_ADDR, SI5351A_OE_CTRL, 0xF8),
+    };
+
+    /* A failed write does not stop the rest from being made */
+    (void) i2c_driver_batch(i2c_dev, ops, sizeof(ops) / sizeof(ops[0]));
 }
 
 void audio_hw_config(soc_peripheral_t i2c_dev)
@@ -127,3 +146,33 @@ void audio_hw_config(soc_peripheral_t i2c_dev)
     pll_init(i2c_dev);
     initCS43L21(i2c_dev);
 }
+
+/*
+ * Each change is made with a single batch of writes to just the
+ * registers whose values change. DAC_OUT_CTL is already known from
+ * initCS43L21(), so muting never reads it back from the codec.
+ */
+int audio_hw_config_mute_set(int mute)
+{
+    int failed = 0;
+
+    for (int i = 0; i < CS43L21_COUNT; i++) {
+        i2c_regmap_update_bits(&codec_regmap[i], CS43L21_REG_DAC_OUT_CTL, 0x03, mute ? 0x03 : 0x00);
+        failed += i2c_regmap_flush(&codec_regmap[i]);
+    }
+
+    return failed;
+}
+
+int audio_hw_config_volume_set(int8_t volume)
+{
+    int failed = 0;
+
+    for (int i = 0; i < CS43L21_COUNT; i++) {
+        i2c_regmap_write(&codec_regmap[i], CS43L21_REG_VOL_CTL_AOUTA, (uint8_t) volume);
+        i2c_regmap_write(&codec_regmap[i], CS43L21_REG_VOL_CTL_AOUTB, (uint8_t) volume);
+        failed += i2c_regmap_flush(&codec_regmap[i]);
+    }
+
+    return failed;
+}
@@ -0,0 +1,169 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "soc.h"
+
+/* App headers */
+#include "asrc.h"
+
+/*
+ * The input is held in a buffer of this many frames. The controller
+ * keeps less than two frames in it, so the rest is headroom for it to
+ * settle.
+ */
+#define ASRC_BUF_FRAMES 3
+
+/*
+ * The fill level is filtered by a single pole low pass filter with a
+ * time constant of 2^ASRC_LEVEL_FILTER_SHIFT frames, to smooth out the
+ * jitter in when frames arrive and are consumed.
+ */
+#define ASRC_LEVEL_FILTER_SHIFT 5
+
+/*
+ * The controller gains. The proportional gain is in ppm per frame of
+ * error. The integral gain is in ppm per frame of error per frame, in
+ * Q16, and removes the error that is left when the rates differ.
+ */
+#define ASRC_KP_PPM         1000
+#define ASRC_KI_PPM_Q16     (65536 / 64)
+
+/* One ppm of the step, which is in Q32 */
+#define ASRC_STEP_PER_PPM   4295
+
+struct asrc {
+    size_t frame_length;
+    int32_t target_level_q16;
+    int32_t max_ppm_q16;
+
+    int32_t level_q16;
+    int32_t integral_q16;
+    int32_t ppm_q16;
+
+    /* The input samples consumed for each output sample, in Q32 */
+    uint64_t step;
+    /* The position in buf of the next output sample, in Q32 */
+    uint64_t pos;
+
+    size_t count;
+    micarray_sample_t buf[];
+};
+
+static int32_t clamp(int64_t x, int32_t limit)
+{
+    if (x > limit) {
+        return limit;
+    } else if (x < -limit) {
+        return -limit;
+    }
+    return (int32_t) x;
+}
+
+asrc_t *asrc_create(
+        size_t frame_length,
+        int target_level,
+        int max_ppm)
+{
+    asrc_t *asrc;
+
+    configASSERT(frame_length > 0);
+
+    asrc = pvPortMalloc(sizeof(asrc_t) + ASRC_BUF_FRAMES * frame_length * sizeof(micarray_sample_t));
+    configASSERT(asrc != NULL);
+
+    asrc->frame_length = frame_length;
+    asrc->target_level_q16 = target_level << 16;
+    asrc->max_ppm_q16 = max_ppm << 16;
+    asrc->level_q16 = asrc->target_level_q16;
+    asrc->integral_q16 = 0;
+    asrc->ppm_q16 = 0;
+    asrc->step = 1ULL << 32;
+    asrc->pos = 0;
+    asrc->count = 0;
+
+    return asrc;
+}
+
+void asrc_level_update(
+        asrc_t *asrc,
+        int32_t level_q16)
+{
+    int32_t err;
+
+    asrc->level_q16 += (level_q16 - asrc->level_q16) >> ASRC_LEVEL_FILTER_SHIFT;
+    err = asrc->level_q16 - asrc->target_level_q16;
+
+    asrc->integral_q16 = clamp(asrc->integral_q16 + (((int64_t) err * ASRC_KI_PPM_Q16) >> 16), asrc->max_ppm_q16);
+    asrc->ppm_q16 = clamp((int64_t) err * ASRC_KP_PPM + asrc->integral_q16, asrc->max_ppm_q16);
+
+    asrc->step = (1ULL << 32) + (((int64_t) asrc->ppm_q16 * ASRC_STEP_PER_PPM) >> 16);
+}
+
+int asrc_input(
+        asrc_t *asrc,
+        const micarray_sample_t *frame)
+{
+    size_t n = asrc->frame_length;
+    int ret = 0;
+
+    if (asrc->count + n > ASRC_BUF_FRAMES * n) {
+        memmove(asrc->buf, asrc->buf + n, (asrc->count - n) * sizeof(micarray_sample_t));
+        asrc->count -= n;
+        if ((asrc->pos >> 32) >= n) {
+            asrc->pos -= (uint64_t) n << 32;
+        } else {
+            asrc->pos &= 0xFFFFFFFF;
+        }
+        ret = -1;
+    }
+
+    memcpy(asrc->buf + asrc->count, frame, n * sizeof(micarray_sample_t));
+    asrc->count += n;
+
+    return ret;
+}
+
+int asrc_output(
+        asrc_t *asrc,
+        micarray_sample_t *frame)
+{
+    size_t n = asrc->frame_length;
+    uint64_t pos = asrc->pos;
+    size_t consumed;
+
+    /*
+     * The last output sample is interpolated between the input
+     * samples at its position and the one after.
+     */
+    if (((pos + (n - 1) * asrc->step) >> 32) + 1 >= asrc->count) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        size_t k = pos >> 32;
+        int64_t x0 = asrc->buf[k];
+        int64_t x1 = asrc->buf[k + 1];
+        int64_t frac = (uint32_t) pos >> 2;  /* Q30 */
+
+        frame[i] = (micarray_sample_t) (x0 + (((x1 - x0) * frac) >> 30));
+        pos += asrc->step;
+    }
+
+    consumed = pos >> 32;
+    memmove(asrc->buf, asrc->buf + consumed, (asrc->count - consumed) * sizeof(micarray_sample_t));
+    asrc->count -= consumed;
+    asrc->pos = pos - ((uint64_t) consumed << 32);
+
+    return 1;
+}
+
+int32_t asrc_ratio_ppm(
+        asrc_t *asrc)
+{
+    return asrc->ppm_q16 >> 16;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef AUDIO_COMPRESS_H_
+#define AUDIO_COMPRESS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "micarray_driver.h"
+
+/*
+ * A FLAC-like frame compressor for mic frames, made to be cheap enough
+ * to run on every frame sent over the network. Each channel of a frame
+ * is coded on its own, as a subframe, with whichever of the fixed
+ * polynomial predictors of order 0 to 4 leaves the smallest residuals,
+ * and those are Rice coded with the parameter that codes them in the
+ * fewest bits. A subframe that would not be any smaller is sent as it
+ * is. Everything is integer arithmetic, with no multiplies in the
+ * predictors.
+ *
+ * It is lossless unless the frame is compressed with a shift, in which
+ * case that many LSBs are rounded off each sample first. The samples
+ * then take fewer bits even when sent as they are, and the noise in the
+ * LSBs of the mics no longer costs any bits.
+ *
+ * Each compressed frame starts with an AUDIO_COMPRESS_HEADER_BYTES
+ * header, which holds, with multi-byte fields little endian:
+ *   0-1  AUDIO_COMPRESS_SYNC
+ *   2    the bits in each uncompressed sample, 16 or 32
+ *   3    the number of channels
+ *   4    the shift
+ *   5    0
+ *   6-7  the samples in each channel
+ *   8-9  the bytes that follow the header
+ *
+ * Each subframe then starts with a byte giving its predictor order plus
+ * 1, or 0 for one sent as it is, and a byte giving its Rice parameter.
+ * Its bits follow, MSB first, padded at the end to a whole byte. These
+ * are the first order samples, then the Rice code of the residual of
+ * each of the rest. Each sample sent as it is takes the sample bits less
+ * the shift. Each residual r is mapped to (r << 1) ^ (r >> 31), and coded
+ * as that shifted down by the Rice parameter in unary, as 0s ended by a
+ * 1, and then the parameter's number of LSBs of it. The samples of a
+ * subframe sent as it is are just written out the same way as the first
+ * order samples.
+ *
+ * Python/audio_decompress.py decodes a stream of them on the host.
+ */
+
+#define AUDIO_COMPRESS_SYNC                 0x5AAC
+#define AUDIO_COMPRESS_HEADER_BYTES         10
+#define AUDIO_COMPRESS_SUBFRAME_HEADER_BYTES 2
+#define AUDIO_COMPRESS_MAX_ORDER            4
+
+/*
+ * The most bytes audio_compress_frame() may write for a frame of
+ * channels channels of length samples each.
+ */
+#define AUDIO_COMPRESS_MAX_BYTES(length, channels) \
+    (AUDIO_COMPRESS_HEADER_BYTES + (channels) * (AUDIO_COMPRESS_SUBFRAME_HEADER_BYTES + (length) * sizeof(micarray_sample_t)))
+
+/*
+ * Compresses a frame of channels channels, each length samples long and
+ * one after the other, into out, which must have space for
+ * AUDIO_COMPRESS_MAX_BYTES(length, channels) bytes. shift is the number
+ * of LSBs to round off each sample first, 0 for lossless.
+ *
+ * Returns the number of bytes written to out.
+ */
+size_t audio_compress_frame(
+        const micarray_sample_t *frame,
+        size_t length,
+        int channels,
+        int shift,
+        uint8_t *out);
+
+/*
+ * Returns the number of bytes of a frame compressed by
+ * audio_compress_frame(), from its header.
+ */
+size_t audio_compress_frame_bytes(
+        const uint8_t *compressed);
+
+#endif /* AUDIO_COMPRESS_H_ */
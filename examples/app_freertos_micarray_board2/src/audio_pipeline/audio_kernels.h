@@ -0,0 +1,79 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef AUDIO_KERNELS_H_
+#define AUDIO_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "micarray_driver.h"
+
+/*
+ * Block kernels for single channel mic frames. Each loop handles
+ * several samples per iteration with independent accumulators, so
+ * that loads, multiplies and stores from different samples can be
+ * issued together.
+ */
+
+/*
+ * Multiplies every sample by gain, saturating to the range of
+ * micarray_sample_t.
+ */
+void audio_kernel_gain(
+        micarray_sample_t *frame,
+        size_t length,
+        int32_t gain);
+
+/*
+ * Multiplies the samples by a gain that moves in equal steps from
+ * gain_from, for the first sample, to gain_to, for the sample after the
+ * last, so that a change of gain made at a frame boundary does not
+ * click. Saturates to the range of micarray_sample_t.
+ */
+void audio_kernel_gain_ramp(
+        micarray_sample_t *frame,
+        size_t length,
+        int32_t gain_from,
+        int32_t gain_to);
+
+/*
+ * Scales every sample by 2^shift, saturating when shift is positive
+ * and rounding towards minus infinity when it is negative.
+ */
+void audio_kernel_scale(
+        micarray_sample_t *frame,
+        size_t length,
+        int shift);
+
+/*
+ * Adds c0 * x[i] + c1 * x[i - 1] onto acc[i] for each of the length
+ * samples, where c0 and c1 are Q31, so that x[-1] must be readable.
+ * With c0 + c1 constant this delays x by a fraction of a sample, by
+ * linear interpolation.
+ */
+void audio_kernel_frac_delay_mac(
+        int64_t *acc,
+        const micarray_sample_t *x,
+        size_t length,
+        int32_t c0,
+        int32_t c1);
+
+/*
+ * Stores each Q31 accumulator from audio_kernel_frac_delay_mac() as a
+ * sample, saturating to the range of micarray_sample_t.
+ */
+void audio_kernel_acc_store(
+        micarray_sample_t *frame,
+        const int64_t *acc,
+        size_t length);
+
+/*
+ * Returns the mean power of a frame of (1 << length_log2) samples, in
+ * Q31 relative to a full scale square wave, saturated to INT32_MAX.
+ * length_log2 must be at least 1.
+ */
+int32_t audio_kernel_power(
+        const micarray_sample_t *frame,
+        unsigned length_log2);
+
+#endif /* AUDIO_KERNELS_H_ */
@@ -3,9 +3,38 @@
 #ifndef AUDIO_PIPELINE_H_
 #define AUDIO_PIPELINE_H_
 
-void audio_pipeline_create(QueueHandle_t output0, QueueHandle_t output1, UBaseType_t priority);
+#include "soc_dma_buf_pool.h"
+#include "pipeline.h"
+#include "vad.h"
+
+/*
+ * Frames are sent to output0 for TCP, output1 for I2S and output2 for
+ * UDP. output2 may be NULL.
+ */
+void audio_pipeline_create(QueueHandle_t output0, QueueHandle_t output1, QueueHandle_t output2, UBaseType_t priority);
 
 BaseType_t audiopipeline_get_stage1_gain( void );
 BaseType_t audiopipeline_set_stage1_gain( BaseType_t xnewgain );
 
+pipeline_t *audio_pipeline_get(void);
+
+/*
+ * Returns non-zero while the pipeline's voice activity detector finds
+ * voice in the mic frames.
+ */
+int audio_pipeline_vad_active(void);
+
+/*
+ * Gets a copy of the voice activity detector's state. This is updated
+ * by the pipeline's vad stage, so the copy may be out by a frame.
+ */
+void audio_pipeline_vad_get(vad_t *vad);
+
+/*
+ * Gets the smoothed power of up to count of the beamformer's beams,
+ * and returns the beam being passed on. Only present when built with
+ * appconfBEAMFORMER_ENABLED.
+ */
+int audio_pipeline_beam_get(int32_t power[], int count);
+
 #endif /* AUDIO_PIPELINE_H_ */
@@ -0,0 +1,296 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <math.h>
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Library headers */
+#include "soc.h"
+
+/* App headers */
+#include "beamformer.h"
+#include "audio_kernels.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* The speed of sound, in micrometres per second */
+#define BEAMFORMER_SPEED_OF_SOUND 343000000.0
+
+/*
+ * The beam powers are filtered by a single pole low pass filter with a
+ * time constant of 2^BEAMFORMER_POWER_FILTER_SHIFT frames, so that the
+ * loudest beam does not flick between beams on every syllable.
+ */
+#define BEAMFORMER_POWER_FILTER_SHIFT 3
+
+/*
+ * How one mic contributes to one beam. Its signal is delayed by delay
+ * whole samples plus a fraction, by taking c0 of the sample delay back
+ * and c1 of the one before it. The weights, in Q31, also divide by the
+ * number of mics.
+ */
+typedef struct {
+    int delay;
+    int32_t c0;
+    int32_t c1;
+} beamformer_tap_t;
+
+/* The beams that one task makes */
+typedef struct {
+    beamformer_t *bf;
+    int first_beam;
+    int end_beam;
+    TaskHandle_t task;
+    int64_t *acc;
+} beamformer_worker_t;
+
+struct beamformer {
+    unsigned frame_length_log2;
+    size_t frame_length;
+    int mic_count;
+    int beam_count;
+
+    /* The samples of each mic kept from the frames before the current one */
+    size_t history;
+
+    /* beam_count sets of mic_count taps */
+    beamformer_tap_t *taps;
+
+    /* mic_count runs of history samples, then the current frame's */
+    micarray_sample_t *mic_buf;
+
+    /* beam_count frames of output */
+    micarray_sample_t *beam_buf;
+    int32_t *power;
+
+    /* Given by each worker when it has made its beams */
+    SemaphoreHandle_t done;
+
+    /* The worker tasks, followed by the share of the caller of beamformer_process() */
+    int worker_count;
+    beamformer_worker_t workers[];
+};
+
+static void beamformer_beams_make(
+        beamformer_t *bf,
+        beamformer_worker_t *worker)
+{
+    const size_t stride = bf->history + bf->frame_length;
+
+    for (int beam = worker->first_beam; beam < worker->end_beam; beam++) {
+        const beamformer_tap_t *taps = &bf->taps[beam * bf->mic_count];
+        micarray_sample_t *out = &bf->beam_buf[beam * bf->frame_length];
+        int32_t power;
+
+        memset(worker->acc, 0, bf->frame_length * sizeof(int64_t));
+
+        for (int mic = 0; mic < bf->mic_count; mic++) {
+            const micarray_sample_t *x = &bf->mic_buf[mic * stride + bf->history - taps[mic].delay];
+
+            audio_kernel_frac_delay_mac(worker->acc, x, bf->frame_length, taps[mic].c0, taps[mic].c1);
+        }
+
+        audio_kernel_acc_store(out, worker->acc, bf->frame_length);
+
+        power = audio_kernel_power(out, bf->frame_length_log2);
+        bf->power[beam] += (power - bf->power[beam]) >> BEAMFORMER_POWER_FILTER_SHIFT;
+    }
+}
+
+static void beamformer_worker(void *arg)
+{
+    beamformer_worker_t *worker = arg;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        beamformer_beams_make(worker->bf, worker);
+        xSemaphoreGive(worker->bf->done);
+    }
+}
+
+/*
+ * Works out the taps that point each beam. Sound from the beam's
+ * direction reaches a mic earlier than the centre of the array by the
+ * mic's distance along that direction over the speed of sound. Each
+ * mic is delayed by that time plus the time sound takes to cross the
+ * array's radius, so that no delay is negative.
+ */
+static int beamformer_taps_init(
+        beamformer_t *bf,
+        const beamformer_mic_t mics[],
+        unsigned sample_rate)
+{
+    const double samples_per_um = sample_rate / BEAMFORMER_SPEED_OF_SOUND;
+    double radius = 0;
+    int max_delay = 0;
+
+    for (int mic = 0; mic < bf->mic_count; mic++) {
+        double r = sqrt((double) mics[mic].x * mics[mic].x + (double) mics[mic].y * mics[mic].y);
+
+        if (r > radius) {
+            radius = r;
+        }
+    }
+
+    for (int beam = 0; beam < bf->beam_count; beam++) {
+        const double angle = 2 * M_PI * beam / bf->beam_count;
+        const double ux = cos(angle);
+        const double uy = sin(angle);
+
+        for (int mic = 0; mic < bf->mic_count; mic++) {
+            beamformer_tap_t *tap = &bf->taps[beam * bf->mic_count + mic];
+            double delay = (mics[mic].x * ux + mics[mic].y * uy + radius) * samples_per_um;
+            double frac;
+
+            if (delay < 0) {
+                delay = 0;
+            }
+            tap->delay = (int) delay;
+            frac = delay - tap->delay;
+            tap->c0 = (int32_t) ((1 - frac) / bf->mic_count * INT32_MAX);
+            tap->c1 = (int32_t) (frac / bf->mic_count * INT32_MAX);
+
+            if (tap->delay > max_delay) {
+                max_delay = tap->delay;
+            }
+        }
+    }
+
+    return max_delay;
+}
+
+beamformer_t *beamformer_create(
+        unsigned frame_length_log2,
+        int mic_count,
+        const beamformer_mic_t mics[],
+        unsigned sample_rate,
+        int beam_count,
+        int worker_count,
+        const int worker_core[],
+        UBaseType_t priority)
+{
+    const size_t frame_length = (size_t) 1 << frame_length_log2;
+    const int task_count = worker_count + 1;
+    beamformer_t *bf;
+
+    configASSERT(mic_count > 0);
+    configASSERT(beam_count > 0);
+    configASSERT(worker_count >= 0 && worker_count < beam_count);
+
+    bf = pvPortMalloc(sizeof(beamformer_t) + task_count * sizeof(beamformer_worker_t));
+    configASSERT(bf != NULL);
+
+    bf->frame_length_log2 = frame_length_log2;
+    bf->frame_length = frame_length;
+    bf->mic_count = mic_count;
+    bf->beam_count = beam_count;
+    bf->worker_count = worker_count;
+
+    bf->taps = pvPortMalloc(beam_count * mic_count * sizeof(beamformer_tap_t));
+    configASSERT(bf->taps != NULL);
+
+    /* Each tap also reads the sample before the one it is delayed to */
+    bf->history = beamformer_taps_init(bf, mics, sample_rate) + 1;
+    configASSERT(bf->history <= frame_length);
+
+    bf->mic_buf = pvPortMalloc(mic_count * (bf->history + frame_length) * sizeof(micarray_sample_t));
+    bf->beam_buf = pvPortMalloc(beam_count * frame_length * sizeof(micarray_sample_t));
+    bf->power = pvPortMalloc(beam_count * sizeof(int32_t));
+    bf->done = xSemaphoreCreateCounting(task_count, 0);
+    configASSERT(bf->mic_buf != NULL && bf->beam_buf != NULL && bf->power != NULL && bf->done != NULL);
+
+    memset(bf->mic_buf, 0, mic_count * (bf->history + frame_length) * sizeof(micarray_sample_t));
+    memset(bf->beam_buf, 0, beam_count * frame_length * sizeof(micarray_sample_t));
+    memset(bf->power, 0, beam_count * sizeof(int32_t));
+
+    for (int i = 0; i < task_count; i++) {
+        beamformer_worker_t *worker = &bf->workers[i];
+
+        worker->bf = bf;
+        worker->first_beam = i * beam_count / task_count;
+        worker->end_beam = (i + 1) * beam_count / task_count;
+        worker->task = NULL;
+        worker->acc = pvPortMalloc(frame_length * sizeof(int64_t));
+        configASSERT(worker->acc != NULL);
+
+        if (i < worker_count) {
+            xTaskCreate(beamformer_worker, "beamformer", portTASK_STACK_DEPTH(beamformer_worker),
+                    worker, priority, &worker->task);
+
+#if ( configUSE_CORE_AFFINITY == 1 && configNUM_CORES > 1 )
+            if (worker_core[i] >= 0) {
+                vTaskCoreAffinitySet(worker->task, 1 << worker_core[i]);
+            }
+#endif
+        }
+    }
+
+    return bf;
+}
+
+void beamformer_process(
+        beamformer_t *bf,
+        const micarray_sample_t *frame)
+{
+    const size_t stride = bf->history + bf->frame_length;
+
+    /* Slide each mic's history along, and add the new frame after it */
+    for (int mic = 0; mic < bf->mic_count; mic++) {
+        micarray_sample_t *buf = &bf->mic_buf[mic * stride];
+
+        memmove(buf, buf + bf->frame_length, bf->history * sizeof(micarray_sample_t));
+        memcpy(buf + bf->history, frame + mic * bf->frame_length, bf->frame_length * sizeof(micarray_sample_t));
+    }
+
+    for (int i = 0; i < bf->worker_count; i++) {
+        xTaskNotifyGive(bf->workers[i].task);
+    }
+
+    beamformer_beams_make(bf, &bf->workers[bf->worker_count]);
+
+    for (int i = 0; i < bf->worker_count; i++) {
+        xSemaphoreTake(bf->done, portMAX_DELAY);
+    }
+}
+
+const micarray_sample_t *beamformer_beam(
+        beamformer_t *bf,
+        int beam)
+{
+    configASSERT(beam >= 0 && beam < bf->beam_count);
+    return &bf->beam_buf[beam * bf->frame_length];
+}
+
+int32_t beamformer_beam_power(
+        beamformer_t *bf,
+        int beam)
+{
+    configASSERT(beam >= 0 && beam < bf->beam_count);
+    return bf->power[beam];
+}
+
+int beamformer_loudest_beam(
+        beamformer_t *bf)
+{
+    int loudest = 0;
+
+    for (int beam = 1; beam < bf->beam_count; beam++) {
+        if (bf->power[beam] > bf->power[loudest]) {
+            loudest = beam;
+        }
+    }
+
+    return loudest;
+}
+
+int beamformer_beam_count(
+        beamformer_t *bf)
+{
+    return bf->beam_count;
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef NOISE_SUPPRESSOR_H_
+#define NOISE_SUPPRESSOR_H_
+
+#include <stdint.h>
+
+#include "dsp.h"
+
+#include "micarray_driver.h"
+
+/*
+ * A frequency domain noise suppressor for a pair of mics, fed the
+ * frames the mic array makes with MICARRAYCONF_FFT_PREPROCESSED set.
+ *
+ * Each frame holds the two mics packed into complex samples, already
+ * in bit reversed order and windowed by a square root Hann window, so
+ * a single FFT gives both mics' spectra. The noise in each bin is
+ * tracked by a floor that drops to the bin's power at once but only
+ * creeps up slowly, so that it follows the quietest the bin has been
+ * recently rather than speech. Mic 0's spectrum is then scaled in each
+ * bin by a Wiener gain from how far the power of the two mics is above
+ * that floor, no lower than a gain floor, and turned back into time
+ * domain samples. Windowing these again and overlap-adding frames that
+ * overlap by half gives each new half frame of output.
+ */
+
+typedef struct noise_suppressor noise_suppressor_t;
+
+/*
+ * Creates a noise suppressor for frames of (1 << frame_length_log2)
+ * complex samples, with no bin's gain lower than gain_floor, in Q31.
+ */
+noise_suppressor_t *noise_suppressor_create(
+        unsigned frame_length_log2,
+        int32_t gain_floor);
+
+/*
+ * Suppresses the noise in frame, overwriting it, and writes the next
+ * half frame of mic 0's output samples to out. The frames must overlap
+ * by half.
+ */
+void noise_suppressor_process(
+        noise_suppressor_t *ns,
+        dsp_complex_t frame[],
+        micarray_sample_t out[]);
+
+#endif /* NOISE_SUPPRESSOR_H_ */
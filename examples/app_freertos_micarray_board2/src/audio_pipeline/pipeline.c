@@ -0,0 +1,295 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* Library headers */
+#include "rtos_support.h"
+
+/* App headers */
+#include "pipeline.h"
+
+typedef struct {
+    void *frame;
+    uint32_t start_time;
+} pipeline_item_t;
+
+typedef struct {
+    pipeline_t *pipeline;
+    const char *name;
+    pipeline_stage_fn_t fn;
+    pipeline_stage_fn_t shed_fn;
+    void *arg;
+    uint32_t budget;
+    QueueHandle_t input;
+    QueueHandle_t output;
+    pipeline_stats_t stats;
+} pipeline_stage_state_t;
+
+struct pipeline {
+    int stage_count;
+    void (*drop_fn)(void *frame);
+    uint32_t shed_hold_time;
+
+    /*
+     * Every overload is counted by a single writer, either a stage's own
+     * task or the caller of pipeline_input(). The first stage's task sums
+     * these counts for every frame, and owns all of the shedding state.
+     */
+    uint32_t overload_count;
+    uint32_t shed_until;
+    volatile int shedding;
+    pipeline_overload_stats_t overload;
+
+    pipeline_stage_state_t stages[];
+};
+
+static void pipeline_drop(
+        pipeline_stage_state_t *stage,
+        void *frame)
+{
+    stage->stats.dropped++;
+    if (stage->pipeline->drop_fn != NULL) {
+        stage->pipeline->drop_fn(frame);
+    }
+}
+
+static void pipeline_send(
+        pipeline_stage_state_t *stage,
+        pipeline_item_t *item)
+{
+    configASSERT(stage->output != NULL);
+    if (xQueueSend(stage->output, item, 0) == errQUEUE_FULL) {
+        pipeline_drop(stage, item->frame);
+    }
+}
+
+/*
+ * Starts shedding load for the hold time if there has been an overload
+ * since the last frame, and stops once the hold time has passed. Only
+ * called by the first stage's task, once per frame.
+ */
+static void pipeline_overload_check(
+        pipeline_t *pipeline,
+        uint32_t now)
+{
+    uint32_t count = pipeline->overload.input_dropped;
+
+    for (int i = 0; i < pipeline->stage_count; i++) {
+        count += pipeline->stages[i].stats.overruns + pipeline->stages[i].stats.dropped;
+    }
+
+    if (count != pipeline->overload_count) {
+        pipeline->overload_count = count;
+        if (!pipeline->shedding) {
+            pipeline->overload.events++;
+        }
+        pipeline->shed_until = now + pipeline->shed_hold_time;
+        pipeline->shedding = pipeline->shed_hold_time != 0;
+    } else if (pipeline->shedding && (int32_t) (now - pipeline->shed_until) >= 0) {
+        pipeline->shedding = 0;
+    }
+}
+
+static void pipeline_stage_task(void *arg)
+{
+    pipeline_stage_state_t *stage = arg;
+    pipeline_t *pipeline = stage->pipeline;
+    pipeline_item_t item;
+    uint32_t start, end;
+
+    for (;;) {
+        xQueueReceive(stage->input, &item, portMAX_DELAY);
+
+        start = get_reference_time();
+        if (stage == &pipeline->stages[0]) {
+            pipeline_overload_check(pipeline, start);
+        }
+        if (pipeline->shedding && stage->shed_fn != NULL) {
+            stage->stats.shed++;
+            item.frame = stage->shed_fn(item.frame, stage->arg);
+        } else {
+            item.frame = stage->fn(item.frame, stage->arg);
+        }
+        end = get_reference_time();
+
+        stage->stats.frames++;
+        stage->stats.busy_total += end - start;
+        if (end - start > stage->stats.busy_max) {
+            stage->stats.busy_max = end - start;
+        }
+        if (stage->budget != 0 && end - start > stage->budget) {
+            stage->stats.overruns++;
+        }
+        stage->stats.latency_total += end - item.start_time;
+        if (end - item.start_time > stage->stats.latency_max) {
+            stage->stats.latency_max = end - item.start_time;
+        }
+
+        if (item.frame == NULL) {
+            continue;
+        }
+
+        pipeline_send(stage, &item);
+    }
+}
+
+pipeline_t *pipeline_create(
+        const pipeline_stage_t stages[],
+        int stage_count,
+        int queue_length,
+        void (*drop_fn)(void *frame))
+{
+    pipeline_t *pipeline;
+
+    configASSERT(stage_count > 0);
+
+    pipeline = pvPortMalloc(sizeof(pipeline_t) + stage_count * sizeof(pipeline_stage_state_t));
+    configASSERT(pipeline != NULL);
+
+    pipeline->stage_count = stage_count;
+    pipeline->drop_fn = drop_fn;
+    pipeline->shed_hold_time = 0;
+    pipeline->overload_count = 0;
+    pipeline->shed_until = 0;
+    pipeline->shedding = 0;
+    memset(&pipeline->overload, 0, sizeof(pipeline->overload));
+
+    for (int i = 0; i < stage_count; i++) {
+        pipeline_stage_state_t *stage = &pipeline->stages[i];
+
+        stage->pipeline = pipeline;
+        stage->name = stages[i].name;
+        stage->fn = stages[i].fn;
+        stage->shed_fn = stages[i].shed_fn;
+        stage->arg = stages[i].arg;
+        stage->budget = stages[i].budget;
+        stage->input = xQueueCreate(queue_length, sizeof(pipeline_item_t));
+        stage->output = NULL;
+        memset(&stage->stats, 0, sizeof(stage->stats));
+        configASSERT(stage->input != NULL);
+
+        if (i > 0) {
+            pipeline->stages[i - 1].output = stage->input;
+        }
+    }
+
+    for (int i = 0; i < stage_count; i++) {
+        TaskHandle_t task;
+
+        xTaskCreate(pipeline_stage_task, stages[i].name, portTASK_STACK_DEPTH(pipeline_stage_task),
+                &pipeline->stages[i], stages[i].priority, &task);
+
+#if ( configUSE_CORE_AFFINITY == 1 && configNUM_CORES > 1 )
+        if (stages[i].core >= 0) {
+            vTaskCoreAffinitySet(task, 1 << stages[i].core);
+        }
+#else
+        (void) task;
+#endif
+    }
+
+    return pipeline;
+}
+
+void pipeline_shed_hold_time_set(
+        pipeline_t *pipeline,
+        uint32_t hold_time)
+{
+    pipeline->shed_hold_time = hold_time;
+}
+
+void *pipeline_stage_bypass(
+        void *frame,
+        void *arg)
+{
+    return frame;
+}
+
+BaseType_t pipeline_input(
+        pipeline_t *pipeline,
+        void *frame,
+        TickType_t timeout)
+{
+    pipeline_item_t item;
+    BaseType_t ret;
+
+    item.frame = frame;
+    item.start_time = get_reference_time();
+
+    ret = xQueueSend(pipeline->stages[0].input, &item, timeout);
+    if (ret == errQUEUE_FULL) {
+        pipeline->overload.input_dropped++;
+    }
+
+    return ret;
+}
+
+BaseType_t pipeline_input_from_isr(
+        pipeline_t *pipeline,
+        void *frame,
+        BaseType_t *yield_required)
+{
+    pipeline_item_t item;
+    BaseType_t ret;
+
+    item.frame = frame;
+    item.start_time = get_reference_time();
+
+    ret = xQueueSendFromISR(pipeline->stages[0].input, &item, yield_required);
+    if (ret == errQUEUE_FULL) {
+        pipeline->overload.input_dropped++;
+    }
+
+    return ret;
+}
+
+void pipeline_stage_output(
+        pipeline_t *pipeline,
+        int stage,
+        void *frame)
+{
+    pipeline_item_t item;
+
+    configASSERT(stage >= 0 && stage < pipeline->stage_count);
+
+    item.frame = frame;
+    item.start_time = get_reference_time();
+
+    pipeline_send(&pipeline->stages[stage], &item);
+}
+
+int pipeline_stage_count(
+        pipeline_t *pipeline)
+{
+    return pipeline->stage_count;
+}
+
+const char *pipeline_stage_name(
+        pipeline_t *pipeline,
+        int stage)
+{
+    configASSERT(stage >= 0 && stage < pipeline->stage_count);
+    return pipeline->stages[stage].name;
+}
+
+void pipeline_stats_get(
+        pipeline_t *pipeline,
+        int stage,
+        pipeline_stats_t *stats)
+{
+    configASSERT(stage >= 0 && stage < pipeline->stage_count);
+    *stats = pipeline->stages[stage].stats;
+}
+
+void pipeline_overload_stats_get(
+        pipeline_t *pipeline,
+        pipeline_overload_stats_t *stats)
+{
+    *stats = pipeline->overload;
+    stats->shedding = pipeline->shedding;
+}
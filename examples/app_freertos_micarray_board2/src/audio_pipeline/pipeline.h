@@ -0,0 +1,159 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+/*
+ * A pipeline of stages, each run by its own task, that frames pass
+ * through in order. Stages are connected by queues of frame pointers,
+ * so frames are never copied between them.
+ *
+ * A stage function is given each frame in turn, and returns the frame
+ * to pass to the next stage. This may be the same frame, modified in
+ * place, or another one. It returns NULL if it has consumed the frame,
+ * or dropped it. The last stage must always consume its frames.
+ *
+ * When the queue to the next stage is full the frame is given to the
+ * pipeline's drop function instead.
+ *
+ * Each stage may be given a budget, the most time its function should
+ * take per frame. A frame that takes longer is an overrun. An overrun,
+ * a frame dropped between stages, or a frame refused by the first
+ * stage is an overload. After any overload the pipeline sheds load for
+ * its hold time, running each stage's shed function, when it has one,
+ * in place of its usual function. A stage that may simply be skipped
+ * uses pipeline_stage_bypass() as its shed function, while one that
+ * has a cheaper way to make its output, such as from fewer channels,
+ * uses that.
+ */
+typedef void *(*pipeline_stage_fn_t)(void *frame, void *arg);
+
+typedef struct {
+    const char *name;
+    pipeline_stage_fn_t fn;
+    void *arg;
+    UBaseType_t priority;
+    int core;               /* The RTOS core to run the stage on, or -1 for any */
+    uint32_t budget;        /* The most reference clock ticks fn should take per frame, or 0 for no limit */
+    pipeline_stage_fn_t shed_fn; /* Run in place of fn while shedding load, or NULL to always run fn */
+} pipeline_stage_t;
+
+/*
+ * Per stage statistics, in reference clock ticks. busy is the time
+ * spent in the stage function. latency is the time from the frame
+ * entering the pipeline to the stage function returning. overruns is
+ * the number of frames that went over the stage's budget, and shed
+ * the number given to its shed function.
+ */
+typedef struct {
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t overruns;
+    uint32_t shed;
+    uint32_t busy_max;
+    uint64_t busy_total;
+    uint32_t latency_max;
+    uint64_t latency_total;
+} pipeline_stats_t;
+
+/*
+ * Statistics for the pipeline as a whole. input_dropped is the number
+ * of frames refused because the first stage's queue was full. events is
+ * the number of times the pipeline has become overloaded, with any
+ * overloads within the hold time of the last counted as one.
+ */
+typedef struct {
+    uint32_t input_dropped;
+    uint32_t events;
+    int shedding;           /* Non-zero while the pipeline is shedding load */
+} pipeline_overload_stats_t;
+
+typedef struct pipeline pipeline_t;
+
+/*
+ * Creates a pipeline of stage_count stages, and a task for each. Each
+ * queue between stages holds up to queue_length frames. drop_fn may
+ * be NULL.
+ */
+pipeline_t *pipeline_create(
+        const pipeline_stage_t stages[],
+        int stage_count,
+        int queue_length,
+        void (*drop_fn)(void *frame));
+
+/*
+ * Sets how long, in reference clock ticks, the pipeline sheds load for
+ * after the last overload. 0, the default, never sheds load, although
+ * overloads are still counted.
+ */
+void pipeline_shed_hold_time_set(
+        pipeline_t *pipeline,
+        uint32_t hold_time);
+
+/*
+ * A shed function for stages that may be skipped, which passes each
+ * frame straight on.
+ */
+void *pipeline_stage_bypass(
+        void *frame,
+        void *arg);
+
+/*
+ * Gives a frame to the first stage. Returns errQUEUE_FULL, leaving
+ * the frame with the caller, if the first stage's queue is full, which
+ * counts as an overload. Frames must only be given to a pipeline from
+ * one task or ISR.
+ */
+BaseType_t pipeline_input(
+        pipeline_t *pipeline,
+        void *frame,
+        TickType_t timeout);
+
+/*
+ * The same as pipeline_input(), but for use in an ISR.
+ */
+BaseType_t pipeline_input_from_isr(
+        pipeline_t *pipeline,
+        void *frame,
+        BaseType_t *yield_required);
+
+/*
+ * Passes a frame on to the stage after stage, ahead of the one that
+ * stage's function returns. This is for stages that may produce more
+ * than one frame from one, and must only be called from within the
+ * stage's own function. The frame's latency is counted from now.
+ */
+void pipeline_stage_output(
+        pipeline_t *pipeline,
+        int stage,
+        void *frame);
+
+int pipeline_stage_count(
+        pipeline_t *pipeline);
+
+const char *pipeline_stage_name(
+        pipeline_t *pipeline,
+        int stage);
+
+/*
+ * Gets a copy of a stage's statistics. These are updated by the
+ * stage's own task, so the copy may be out by a frame.
+ */
+void pipeline_stats_get(
+        pipeline_t *pipeline,
+        int stage,
+        pipeline_stats_t *stats);
+
+/*
+ * Gets a copy of the pipeline's overload statistics.
+ */
+void pipeline_overload_stats_get(
+        pipeline_t *pipeline,
+        pipeline_overload_stats_t *stats);
+
+#endif /* PIPELINE_H_ */
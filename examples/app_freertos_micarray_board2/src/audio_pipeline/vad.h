@@ -0,0 +1,41 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef VAD_H_
+#define VAD_H_
+
+#include <stdint.h>
+
+/*
+ * A voice activity detector that works from the power of each frame.
+ * It switches on as soon as a frame's power reaches the on threshold,
+ * but only switches off once the power has stayed below the lower off
+ * threshold for hangover frames. This keeps it from chattering on
+ * noise near a threshold, and from dropping out between words.
+ */
+typedef struct {
+    int active;             /* Non-zero while voice is present */
+    int quiet_frames;       /* The frames in a row below the off threshold */
+    int hangover;
+    int32_t power;          /* The power of the last frame */
+    uint32_t frames;        /* The frames seen */
+    uint32_t voice_frames;  /* The frames seen while active */
+} vad_t;
+
+/*
+ * Starts the detector off inactive.
+ */
+void vad_init(
+        vad_t *vad,
+        int hangover);
+
+/*
+ * Updates the detector with the power of the next frame, in the same
+ * units as the thresholds. Returns non-zero if voice is present.
+ */
+int vad_update(
+        vad_t *vad,
+        int32_t power,
+        int32_t on_threshold,
+        int32_t off_threshold);
+
+#endif /* VAD_H_ */
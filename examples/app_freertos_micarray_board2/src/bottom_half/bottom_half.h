@@ -0,0 +1,25 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef BOTTOM_HALF_H_
+#define BOTTOM_HALF_H_
+
+#include "rtos_support.h"
+
+/*
+ * The worker task that runs the work ISRs leave to a bottom half with
+ * bottom_half_queue_from_isr(). It runs above every other task, so the
+ * work is done as soon as the ISRs that queued it return, but with
+ * interrupts enabled. Work queued by several IRQs while the worker has
+ * yet to run is run together.
+ */
+
+void bottom_half_create( UBaseType_t priority );
+
+/*
+ * Queues work for the worker from an ISR, notifying the worker if it
+ * is not already due to run. Returns pdFAIL if there is no room on the
+ * calling core for the work, which the ISR must then do itself.
+ */
+BaseType_t bottom_half_queue_from_isr( rtos_bh_fn_t fn, void *arg, uint32_t data, BaseType_t *pxYieldRequired );
+
+#endif /* BOTTOM_HALF_H_ */
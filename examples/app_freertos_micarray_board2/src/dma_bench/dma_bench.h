@@ -0,0 +1,8 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef DMA_BENCH_H_
+#define DMA_BENCH_H_
+
+void dma_bench_create( UBaseType_t priority );
+
+#endif /* DMA_BENCH_H_ */
@@ -5,4 +5,11 @@
 
 void gpio_ctrl_create( UBaseType_t priority );
 
+/*
+ * Shows whether voice is detected on the center LED. May be called
+ * from any task, and does nothing if the GPIO control task was not
+ * created.
+ */
+void gpio_ctrl_vad_indicate( int active );
+
 #endif /* GPIO_CTRL_H_ */
@@ -0,0 +1,58 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef LATENCY_BENCH_H_
+#define LATENCY_BENCH_H_
+
+#include "app_conf.h"
+
+/*
+ * The places a mic frame's latency is measured at, from the time the
+ * hub received it from the mic array.
+ */
+typedef enum {
+    LATENCY_BENCH_SINK_I2S,     /* When all of it has been sent to the DAC */
+    LATENCY_BENCH_SINK_TCP,     /* When all of it has been committed to a client's TCP stream */
+    LATENCY_BENCH_SINK_UDP,     /* When it has been handed to the IP stack in a datagram */
+    LATENCY_BENCH_SINK_COUNT
+} latency_bench_sink_t;
+
+#define LATENCY_BENCH_BUCKET_COUNT 32
+
+/*
+ * A histogram of the latencies measured at one sink. buckets[i] counts
+ * those of at least i * appconfLATENCY_BENCH_BUCKET_US, and the last
+ * bucket also counts all those that are longer. The times are in
+ * microseconds.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[LATENCY_BENCH_BUCKET_COUNT];
+} latency_bench_hist_t;
+
+#if appconfLATENCY_BENCH
+
+/*
+ * Records the latency of frame, which must be from a soc_dma_buf_pool
+ * and stamped with the time it was captured, as it reaches sink.
+ */
+void latency_bench_record( latency_bench_sink_t sink, const void *frame );
+
+/*
+ * Gets a snapshot of a sink's histogram.
+ */
+void latency_bench_get( latency_bench_sink_t sink, latency_bench_hist_t *hist );
+
+/*
+ * Clears every sink's histogram.
+ */
+void latency_bench_reset( void );
+
+const char *latency_bench_sink_name( latency_bench_sink_t sink );
+
+#else
+#define latency_bench_record( sink, frame )
+#endif
+
+#endif /* LATENCY_BENCH_H_ */
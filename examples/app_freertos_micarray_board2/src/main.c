@@ -3,6 +3,7 @@
 /* FreeRTOS headers */
 #include "FreeRTOS.h"
 #include "queue.h"
+#include "task.h"
 #include "FreeRTOS_IP.h"
 #include "FreeRTOS_Sockets.h"
 #include "FreeRTOS_DHCP.h"
@@ -13,10 +14,16 @@
 #include "audio_pipeline.h"
 #include "network.h"
 #include "queue_to_tcp_stream.h"
+#include "queue_to_udp_stream.h"
 #include "queue_to_i2s.h"
+#include "udp_stream_to_queue.h"
 #include "UDPCommandInterpreter.h"
 #include "thruput_test.h"
+#include "telemetry.h"
+#include "dma_bench.h"
 #include "gpio_ctrl.h"
+#include "bottom_half.h"
+#include "power_manager.h"
 #include "app_conf.h"
 
 eDHCPCallbackAnswer_t xApplicationDHCPHook( eDHCPCallbackPhase_t eDHCPPhase,
@@ -32,33 +39,80 @@ eDHCPCallbackAnswer_t xApplicationDHCPHook( eDHCPCallbackPhase_t eDHCPPhase,
     return eDHCPContinue;
 }
 
+#if RTOS_PRINTF_DEFERRED || RTOS_TRACE_ENABLE
+/*
+ * Writes out the messages rtos_printf() has deferred, and sends those
+ * stored by rtos_trace() to the host, at a priority low enough not to
+ * get in the way of anything else.
+ */
+static void printf_drain_task(void *arg)
+{
+    for (;;) {
+        rtos_printf_deferred_drain();
+        rtos_trace_flush();
+        vTaskDelay(pdMS_TO_TICKS(appconfPRINTF_DRAIN_INTERVAL_MS));
+    }
+}
+#endif
+
 void soc_tile1_main(
         int tile)
 {
     QueueHandle_t ap_output_queue0;
     QueueHandle_t ap_output_queue1;
+    QueueHandle_t ap_output_queue2 = NULL;
 
     ap_output_queue0 = xQueueCreate(2, sizeof(void *));
     ap_output_queue1 = xQueueCreate(2, sizeof(void *));
+#if appconfQUEUE_TO_UDP_ENABLED
+    ap_output_queue2 = xQueueCreate(2, sizeof(void *));
+#endif
+
+    /* Create the bottom half worker before any ISR that queues work for it */
+    bottom_half_create( appconfBOTTOM_HALF_TASK_PRIORITY );
 
     /* Create audio pipeline */
-    audio_pipeline_create( ap_output_queue0, ap_output_queue1, appconfAUDIO_PIPELINE_TASK_PRIORITY );
+    audio_pipeline_create( ap_output_queue0, ap_output_queue1, ap_output_queue2, appconfAUDIO_PIPELINE_TASK_PRIORITY );
 
     /* Create queue to tcp task */
     queue_to_tcp_stream_create( ap_output_queue0, appconfQUEUE_TO_TCP_TASK_PRIORITY );
 
+#if appconfQUEUE_TO_UDP_ENABLED
+    /* Create queue to udp task */
+    queue_to_udp_stream_create( ap_output_queue2, appconfQUEUE_TO_UDP_TASK_PRIORITY );
+#endif
+
     /* Create queue to i2s task */
     queue_to_i2s_create( ap_output_queue1, appconfQUEUE_TO_I2S_TASK_PRIORITY );
 
+#if appconfUDP_TO_QUEUE_ENABLED
+    /* Create udp to queue task, which plays a stream from the network to i2s in place of the mics */
+    udp_stream_to_queue_create( ap_output_queue1, appconfUDP_TO_QUEUE_TASK_PRIORITY );
+#endif
+
     /* Create UDP CLI */
     vStartUDPCommandInterpreterTask( portTASK_STACK_DEPTH(vUDPCommandInterpreterTask), appconfCLI_UDP_PORT, appconfCLI_TASK_PRIORITY );
 
+    /* Create the telemetry endpoint */
+    telemetry_create( appconfTELEMETRY_TASK_PRIORITY );
+
     /* Create the thruput test */
     thruput_test_create( appconfTHRUPUT_TEST_TASK_PRIORITY );
 
+    /* Create the DMA benchmark, which only runs when built with CONFIG=dma_bench */
+    dma_bench_create( appconfDMA_BENCH_TASK_PRIORITY );
+
+    /* Create the power manager, which only runs when built with CONFIG=power_manager */
+    power_manager_create( appconfPOWER_MANAGER_TASK_PRIORITY );
+
     /* Create the gpio control task */
     gpio_ctrl_create( appconfGPIO_TASK_PRIORITY );
 
+#if RTOS_PRINTF_DEFERRED || RTOS_TRACE_ENABLE
+    /* Create the deferred printf and trace drain task */
+    xTaskCreate( printf_drain_task, "printf_drain", portTASK_STACK_DEPTH(printf_drain_task), NULL, appconfPRINTF_DRAIN_TASK_PRIORITY, NULL );
+#endif
+
     /* Initialize FreeRTOS IP*/
     initalize_FreeRTOS_IP();
 
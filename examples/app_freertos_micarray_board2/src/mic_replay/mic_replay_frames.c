@@ -0,0 +1,21 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+/*
+ * The frames the mic array sends in place of the mics when built with
+ * CONFIG=mic_replay. This is a single frame of silence, to be replaced
+ * with frames recorded from a build with CONFIG=mic_capture. See the
+ * README.
+ */
+
+#include "soc.h"
+#include "micarray_dev_conf_defaults.h"
+#include "micarray_dev_dma.h"
+
+#if MICARRAYCONF_REPLAY
+
+const unsigned micarray_dev_replay_frame_count = 1;
+const unsigned micarray_dev_replay_frame_size = MICARRAYCONF_DMA_FRAME_SIZE;
+
+const uint32_t micarray_dev_replay_frames[MICARRAYCONF_DMA_FRAME_SIZE / sizeof(uint32_t)] = { 0 };
+
+#endif
@@ -0,0 +1,138 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "app_conf.h"
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "soc.h"
+#include "rtos_support.h"
+
+/* App headers */
+#include "power_manager.h"
+
+#if appconfPOWER_MANAGER_ENABLED
+
+static power_manager_stats_t power_manager_stats = { 1, 0, 0, 0 };
+
+/* Returns busy out of total in permille */
+static uint32_t power_manager_permille( uint64_t busy, uint64_t total )
+{
+    return total > 0 ? ( uint32_t ) ( ( busy * 1000 ) / total ) : 0;
+}
+
+static void power_manager( void *arg )
+{
+#if RTOS_CPU_STATS
+    static rtos_cpu_stats_t cpu_stats[ 2 ];
+#endif
+#if SOC_PERIPHERAL_STATS
+    soc_peripheral_hub_stats_t hub_stats[ 2 ][ SOC_PERIPHERAL_HUB_COUNT ];
+#endif
+    int last = 0;
+    TickType_t xLastWakeTime;
+
+#if RTOS_CPU_STATS
+    rtos_cpu_stats_get( &cpu_stats[ last ] );
+#endif
+#if SOC_PERIPHERAL_STATS
+    for( int hub_id = 0; hub_id < SOC_PERIPHERAL_HUB_COUNT; hub_id++ )
+    {
+        soc_peripheral_hub_stats_get( hub_id, &hub_stats[ last ][ hub_id ] );
+    }
+#endif
+
+    xLastWakeTime = xTaskGetTickCount();
+
+    for( ;; )
+    {
+        int next = !last;
+        uint32_t load = 0;
+        uint32_t divider = power_manager_stats.divider;
+
+        vTaskDelayUntil( &xLastWakeTime, pdMS_TO_TICKS( appconfPOWER_MANAGER_INTERVAL_MS ) );
+
+#if RTOS_CPU_STATS
+        rtos_cpu_stats_get( &cpu_stats[ next ] );
+        for( int core_id = 0; core_id < cpu_stats[ next ].core_count; core_id++ )
+        {
+            uint32_t elapsed = cpu_stats[ next ].time - cpu_stats[ last ].time;
+            uint32_t idle = cpu_stats[ next ].core[ core_id ].ticks[ RTOS_CPU_STATS_IDLE ] -
+                            cpu_stats[ last ].core[ core_id ].ticks[ RTOS_CPU_STATS_IDLE ];
+            uint32_t core_load = power_manager_permille( elapsed - idle, elapsed );
+
+            if( core_load > load )
+            {
+                load = core_load;
+            }
+        }
+#endif
+#if SOC_PERIPHERAL_STATS
+        for( int hub_id = 0; hub_id < SOC_PERIPHERAL_HUB_COUNT; hub_id++ )
+        {
+            uint64_t busy;
+            uint64_t idle;
+            uint32_t hub_load;
+
+            soc_peripheral_hub_stats_get( hub_id, &hub_stats[ next ][ hub_id ] );
+            busy = hub_stats[ next ][ hub_id ].busy_ticks - hub_stats[ last ][ hub_id ].busy_ticks;
+            idle = hub_stats[ next ][ hub_id ].idle_ticks - hub_stats[ last ][ hub_id ].idle_ticks;
+            hub_load = power_manager_permille( busy, busy + idle );
+
+            if( hub_load > load )
+            {
+                load = hub_load;
+            }
+        }
+#endif
+        last = next;
+
+        /*
+         * The load's share of the time grows with the divider, so the
+         * load with the divider one larger is found by scaling it.
+         */
+        if( load > appconfPOWER_MANAGER_RAISE_PERMILLE )
+        {
+            if( divider > 1 )
+            {
+                divider = 1;
+                power_manager_stats.raises++;
+            }
+        }
+        else if( divider < appconfPOWER_MANAGER_MAX_DIVIDER &&
+                 load * ( divider + 1 ) / divider < appconfPOWER_MANAGER_LOWER_PERMILLE )
+        {
+            divider++;
+            power_manager_stats.lowers++;
+        }
+
+        soc_core_clock_divider_set( divider );
+        power_manager_stats.divider = divider;
+        power_manager_stats.load_permille = load;
+    }
+}
+
+void power_manager_stats_get( power_manager_stats_t *stats )
+{
+    taskENTER_CRITICAL();
+    {
+        *stats = power_manager_stats;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void power_manager_create( UBaseType_t priority )
+{
+    xTaskCreate( power_manager, "power_manager", portTASK_STACK_DEPTH(power_manager), NULL, priority, NULL );
+}
+
+#else
+
+void power_manager_create( UBaseType_t priority )
+{
+    (void) priority;
+}
+
+#endif /* appconfPOWER_MANAGER_ENABLED */
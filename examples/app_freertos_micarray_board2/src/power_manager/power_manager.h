@@ -0,0 +1,33 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef POWER_MANAGER_H_
+#define POWER_MANAGER_H_
+
+#include <stdint.h>
+
+/*
+ * A task that divides tile 0's core clock down while it is lightly
+ * loaded, and back up as soon as the load rises, when built with
+ * CONFIG=power_manager. Every appconfPOWER_MANAGER_INTERVAL_MS it takes
+ * the load of the busiest of the RTOS cores and the peripheral hub
+ * instances over the interval, from their idle time counters. If this is
+ * above appconfPOWER_MANAGER_RAISE_PERMILLE the clock is undivided at
+ * once. Otherwise, if the load would still be below
+ * appconfPOWER_MANAGER_LOWER_PERMILLE with the clock divided by one more,
+ * the divider is stepped up by one, to no more than
+ * appconfPOWER_MANAGER_MAX_DIVIDER.
+ */
+
+typedef struct {
+    uint32_t divider;           /* The core clock's current divider */
+    uint32_t load_permille;     /* The busiest core or hub's load over the last interval */
+    uint32_t raises;            /* The times the clock has been undivided */
+    uint32_t lowers;            /* The times the divider has been stepped up */
+} power_manager_stats_t;
+
+void power_manager_create( UBaseType_t priority );
+
+/* Only defined when built with CONFIG=power_manager */
+void power_manager_stats_get( power_manager_stats_t *stats );
+
+#endif /* POWER_MANAGER_H_ */
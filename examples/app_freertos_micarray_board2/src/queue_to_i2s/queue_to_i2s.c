@@ -11,19 +11,75 @@
 
 /* Library headers */
 #include "soc.h"
+#include "soc_dma_buf_pool.h"
 
 /* BSP/bitstream headers */
+#include "soc_bsp_common.h"
 #include "bitstream_devices.h"
 #include "i2s_driver.h"
+#include "micarray_driver.h"
 
 /* App headers */
 #include "queue_to_i2s.h"
+#include "latency_bench.h"
+
+/* Mic frames are sent to the DAC as they are */
+#if I2SCONF_WORD_LENGTH_SHORT != MICARRAYCONF_WORD_LENGTH_SHORT
+#error I2SCONF_WORD_LENGTH_SHORT must match MICARRAYCONF_WORD_LENGTH_SHORT
+#endif
+
+/* The reference clock ticks it takes the DAC to play one frame */
+#define I2S_FRAME_TICKS ((uint32_t) ((uint64_t) appconfMIC_FRAME_LENGTH * configCPU_CLOCK_HZ / I2SCONF_SAMPLE_FREQ))
+
+/* Two frames of two halves each */
+#define I2S_TX_DESC_COUNT 4
+
+static QueueHandle_t i2s_input_queue;
+static volatile int i2s_ring_frames;
+static volatile uint32_t i2s_frame_release_time;
+
+int32_t queue_to_i2s_fill_level(void)
+{
+    uint32_t elapsed = get_reference_time() - i2s_frame_release_time;
+    int32_t level_q16;
+
+    level_q16 = (uxQueueMessagesWaiting(i2s_input_queue) + i2s_ring_frames) << 16;
+
+    /*
+     * The frame that the DAC is playing has been going down since
+     * the one before it was released.
+     */
+    if (elapsed > I2S_FRAME_TICKS) {
+        elapsed = I2S_FRAME_TICKS;
+    }
+    level_q16 -= ((uint64_t) elapsed << 16) / I2S_FRAME_TICKS;
+
+    return level_q16;
+}
 
 RTOS_IRQ_ISR_ATTR
 int i2s_array_isr(soc_peripheral_t device)
 {
-    BaseType_t xYieldRequired = pdFALSE;
-    return xYieldRequired;
+    /* Wakes vqueue_to_i2s() when the DMA has finished with its buffers */
+    return soc_bsp_ring_owner_notify_from_isr(device, soc_peripheral_interrupt_status(device));
+}
+
+/*
+ * Releases each frame sent to the I2S DAC once the DMA engine has
+ * sent its second half.
+ */
+static void i2s_frames_release(void *bufs[], int more[], int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (!more[i]) {
+            i2s_sample_t *frame = (i2s_sample_t *) bufs[i] - appconfMIC_FRAME_LENGTH/2;
+
+            latency_bench_record(LATENCY_BENCH_SINK_I2S, frame);
+            soc_dma_buf_pool_put(frame);
+            i2s_frame_release_time = get_reference_time();
+            i2s_ring_frames--;
+        }
+    }
 }
 
 void vqueue_to_i2s(void *arg)
@@ -31,39 +87,39 @@ void vqueue_to_i2s(void *arg)
     soc_peripheral_t i2s_dev = arg;
     QueueHandle_t input_queue = soc_peripheral_app_data(i2s_dev);
     soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(i2s_dev);
-    int available = 4;
+    void *done_bufs[I2S_TX_DESC_COUNT];
+    int done_more[I2S_TX_DESC_COUNT];
+    int count;
+
+    soc_peripheral_common_dma_open(i2s_dev);
+    soc_bsp_ring_owner_set(i2s_dev, SOC_DMA_TX_REQUEST);
 
     for (;;) {
-        int32_t *audio_data;
-        int32_t *tx_buf;
+        i2s_sample_t *audio_data;
 
         xQueueReceive(input_queue, &audio_data, portMAX_DELAY);
 
-        while ((tx_buf = soc_dma_ring_tx_buf_get(tx_ring_buf, NULL, NULL)) != NULL || available < 2) {
-            /*
-             * Free the buffers sent to the I2S DAC after the DMA
-             * engine sends them.
-             */
-            if (tx_buf != NULL) {
-                vPortFree(tx_buf);
-                available++;
-            }
-        }
+        count = soc_bsp_tx_ring_wait(i2s_dev, done_bufs, NULL, done_more, I2S_TX_DESC_COUNT, 0);
+        i2s_frames_release(done_bufs, done_more, count);
 
         /*
-         * Demonstrate the DMA scatter gather capability
+         * Demonstrate the DMA scatter gather capability by sending
+         * each half of the frame with its own descriptor. The frame
+         * is shared with the TCP output, so it is not modified.
+         *
+         * The descriptors are given back in order, so once the one for
+         * the second half is free, so is the one for the first. Until
+         * then this task sleeps until the DMA finishes with another.
          */
-
-        char *audio_data2 = pvPortMalloc(sizeof(int32_t) * appconfMIC_FRAME_LENGTH / 2);
-        memcpy(audio_data2, audio_data + appconfMIC_FRAME_LENGTH/2, sizeof(int32_t) * appconfMIC_FRAME_LENGTH/2);
-        memset(audio_data + appconfMIC_FRAME_LENGTH/2, 0, sizeof(int32_t) * appconfMIC_FRAME_LENGTH/2);
-
-        soc_dma_ring_tx_buf_sg_set(tx_ring_buf, audio_data2, sizeof(int32_t) * appconfMIC_FRAME_LENGTH/2,
-                1, 2);
-        soc_dma_ring_tx_buf_sg_set(tx_ring_buf, audio_data, sizeof(int32_t) * appconfMIC_FRAME_LENGTH/2,
+        while (soc_dma_ring_tx_buf_sg_try_set(tx_ring_buf, audio_data + appconfMIC_FRAME_LENGTH/2, sizeof(i2s_sample_t) * appconfMIC_FRAME_LENGTH/2,
+                1, 2) != 0) {
+            count = soc_bsp_tx_ring_wait(i2s_dev, done_bufs, NULL, done_more, I2S_TX_DESC_COUNT, SOC_BSP_WAIT_FOREVER);
+            i2s_frames_release(done_bufs, done_more, count);
+        }
+        soc_dma_ring_tx_buf_sg_set(tx_ring_buf, audio_data, sizeof(i2s_sample_t) * appconfMIC_FRAME_LENGTH/2,
                 0, 2);
 
-        available -= 2;
+        i2s_ring_frames++;
 
         soc_peripheral_hub_dma_request(i2s_dev, SOC_DMA_TX_REQUEST);
     }
@@ -76,11 +132,13 @@ void queue_to_i2s_create(QueueHandle_t input, UBaseType_t priority)
     dev = i2s_driver_init(
             BITSTREAM_I2S_DEVICE_A,             /* Initializing I2S device A */
             0,                                  /* Give this device no RX buffer descriptors */
-            appconfMIC_FRAME_LENGTH * sizeof(int32_t), /* Make each DMA RX buffer MIC_FRAME_LENGTH samples */
-            4,                                  /* Give this device 2 TX buffer descriptors */
+            appconfMIC_FRAME_LENGTH * sizeof(i2s_sample_t), /* Make each DMA RX buffer MIC_FRAME_LENGTH samples */
+            I2S_TX_DESC_COUNT,                  /* Give this device 2 frames of TX buffer descriptors */
             input,                              /* Queue associated with this device */
-            0,                                  /* This device's interrupts should happen on core 0 */
+            appconfI2S_ISR_CORE,                /* The core this device's interrupts should happen on */
             (rtos_irq_isr_t) i2s_array_isr);    /* The ISR to handle this device's interrupts */
 
+    i2s_input_queue = input;
+
     xTaskCreate(vqueue_to_i2s, "queue_to_i2s", portTASK_STACK_DEPTH(vqueue_to_i2s), dev, priority, NULL);
 }
@@ -5,4 +5,10 @@
 
 void queue_to_i2s_create(QueueHandle_t input, UBaseType_t priority);
 
+/*
+ * Returns the number of frames waiting to be played by the DAC, in
+ * Q16, including the part of the frame it is playing that is left.
+ */
+int32_t queue_to_i2s_fill_level(void);
+
 #endif /* QUEUE_TO_I2S_H_ */
@@ -0,0 +1,199 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#define DEBUG_UNIT QUEUE_TO_UDP
+#include "app_conf.h"
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* FreeRTOS Plus headers */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+/* Library headers */
+#include "soc.h"
+#include "soc_dma_buf_pool.h"
+
+/* BSP/bitstream headers */
+#include "bitstream_devices.h"
+#include "micarray_driver.h"
+
+/* App headers */
+#include "queue_to_udp_stream.h"
+#include "latency_bench.h"
+
+/*
+ * Each mic frame is sent as the payload of one RTP packet, with no
+ * retransmission, so a lost frame shows up to the receiver as a gap in
+ * the sequence numbers rather than as a stall. The timestamp counts
+ * samples, and goes up by a whole frame for each frame received from the
+ * queue, including those that could not be sent. The payload is the
+ * frame's raw little endian samples, under a dynamic payload type.
+ *
+ * A client subscribes by sending any datagram to appconfQUEUE_TO_UDP_PORT,
+ * and must keep doing so at least every
+ * appconfQUEUE_TO_UDP_SUBSCRIBE_TIMEOUT_MS to keep the stream coming.
+ * Only the most recent client is sent to.
+ */
+
+#define RTP_HEADER_SIZE     12
+#define RTP_VERSION         2
+#define RTP_PAYLOAD_TYPE    96
+#define RTP_SSRC            0x584D4F53
+
+#define UDP_IP_HEADER_SIZE  28      /* The IPv4 and UDP headers */
+
+#define QUEUE_TO_UDP_FRAME_BYTES ( sizeof(micarray_sample_t) * appconfMIC_FRAME_LENGTH )
+
+#if ( RTP_HEADER_SIZE + QUEUE_TO_UDP_FRAME_BYTES + UDP_IP_HEADER_SIZE ) > ipconfigNETWORK_MTU
+#error A mic frame does not fit into one datagram
+#endif
+
+static QueueHandle_t queue_to_udp;
+
+static volatile BaseType_t xSubscribed = pdFALSE;
+
+BaseType_t is_queue_to_udp_subscribed( void )
+{
+    return xSubscribed;
+}
+
+static void rtp_header_write( uint8_t *pucHeader, uint16_t usSequence, uint32_t ulTimestamp )
+{
+    pucHeader[ 0 ] = RTP_VERSION << 6;
+    pucHeader[ 1 ] = RTP_PAYLOAD_TYPE;
+    pucHeader[ 2 ] = usSequence >> 8;
+    pucHeader[ 3 ] = usSequence;
+    pucHeader[ 4 ] = ulTimestamp >> 24;
+    pucHeader[ 5 ] = ulTimestamp >> 16;
+    pucHeader[ 6 ] = ulTimestamp >> 8;
+    pucHeader[ 7 ] = ulTimestamp;
+    pucHeader[ 8 ] = RTP_SSRC >> 24;
+    pucHeader[ 9 ] = RTP_SSRC >> 16;
+    pucHeader[ 10 ] = RTP_SSRC >> 8;
+    pucHeader[ 11 ] = RTP_SSRC;
+}
+
+/*
+ * Sends one frame to the client. The frame is written straight into a
+ * network buffer from FreeRTOS_GetUDPPayloadBuffer() after its RTP
+ * header, and the buffer handed to the stack with FREERTOS_ZERO_COPY, so
+ * the stack itself copies nothing. The frame is shared with the other
+ * outputs, so it cannot be given to the stack in place.
+ *
+ * Returns pdFALSE if no network buffer was free.
+ */
+static BaseType_t rtp_frame_send( Socket_t xSocket, const struct freertos_sockaddr *pxClient,
+                                  const micarray_sample_t *audio_data, uint16_t usSequence, uint32_t ulTimestamp )
+{
+    const size_t xLength = RTP_HEADER_SIZE + QUEUE_TO_UDP_FRAME_BYTES;
+    uint8_t *pucBuffer;
+
+    pucBuffer = FreeRTOS_GetUDPPayloadBuffer( xLength, 0 );
+    if( pucBuffer == NULL )
+    {
+        return pdFALSE;
+    }
+
+    rtp_header_write( pucBuffer, usSequence, ulTimestamp );
+    memcpy( pucBuffer + RTP_HEADER_SIZE, audio_data, QUEUE_TO_UDP_FRAME_BYTES );
+
+    if( FreeRTOS_sendto( xSocket, pucBuffer, xLength, FREERTOS_ZERO_COPY, pxClient, sizeof( *pxClient ) ) == 0 )
+    {
+        /* The stack only takes the buffer when the send succeeds */
+        FreeRTOS_ReleaseUDPPayloadBuffer( pucBuffer );
+        return pdFALSE;
+    }
+
+    return pdTRUE;
+}
+
+static void queue_to_udp_sender( void *arg )
+{
+    struct freertos_sockaddr xBindAddress, xClient, xFrom;
+    socklen_t xSize = sizeof( xFrom );
+    const TickType_t xReceiveTimeOut = 0;
+    const TickType_t xSubscribeTimeOut = pdMS_TO_TICKS( appconfQUEUE_TO_UDP_SUBSCRIBE_TIMEOUT_MS );
+    TickType_t xSubscribedTime = 0;
+    Socket_t xSocket;
+    uint16_t usSequence = 0;
+    uint32_t ulTimestamp = 0;
+    uint32_t ulDropped = 0;
+
+    while( FreeRTOS_IsNetworkUp() == pdFALSE )
+    {
+        vTaskDelay(pdMS_TO_TICKS( 100 ));
+    }
+
+    xSocket = FreeRTOS_socket(
+            FREERTOS_AF_INET,
+            FREERTOS_SOCK_DGRAM,
+            FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    /* Subscriptions are polled for between frames */
+    FreeRTOS_setsockopt( xSocket,
+                         0,
+                         FREERTOS_SO_RCVTIMEO,
+                         &xReceiveTimeOut,
+                         sizeof( xReceiveTimeOut ) );
+
+    xBindAddress.sin_port = FreeRTOS_htons( appconfQUEUE_TO_UDP_PORT );
+    FreeRTOS_bind( xSocket, &xBindAddress, sizeof( xBindAddress ) );
+
+    for( ;; )
+    {
+        micarray_sample_t *audio_data;
+        char dummy;
+
+        while( FreeRTOS_recvfrom( xSocket, &dummy, sizeof( dummy ), 0, &xFrom, &xSize ) >= 0 )
+        {
+            if( !xSubscribed || xFrom.sin_addr != xClient.sin_addr || xFrom.sin_port != xClient.sin_port )
+            {
+                debug_printf("UDP stream subscribed\n");
+            }
+            xClient = xFrom;
+            xSubscribedTime = xTaskGetTickCount();
+            xSubscribed = pdTRUE;
+        }
+
+        if( xSubscribed && xTaskGetTickCount() - xSubscribedTime > xSubscribeTimeOut )
+        {
+            debug_printf("UDP stream subscription expired, %u frames dropped\n", ulDropped);
+            xSubscribed = pdFALSE;
+            ulDropped = 0;
+        }
+
+        if( xQueueReceive( queue_to_udp, &audio_data, pdMS_TO_TICKS( 100 ) ) == pdFALSE )
+        {
+            continue;
+        }
+
+        if( xSubscribed )
+        {
+            if( rtp_frame_send( xSocket, &xClient, audio_data, usSequence, ulTimestamp ) )
+            {
+                latency_bench_record( LATENCY_BENCH_SINK_UDP, audio_data );
+                usSequence++;
+            }
+            else
+            {
+                ulDropped++;
+            }
+        }
+
+        ulTimestamp += appconfMIC_FRAME_LENGTH;
+
+        soc_dma_buf_pool_put( audio_data );
+    }
+}
+
+void queue_to_udp_stream_create(QueueHandle_t input, UBaseType_t priority)
+{
+    queue_to_udp = input;
+    xTaskCreate( queue_to_udp_sender, "q2udp_send", portTASK_STACK_DEPTH(queue_to_udp_sender), NULL, priority, NULL );
+}
@@ -0,0 +1,315 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#define DEBUG_UNIT TELEMETRY
+#include "app_conf.h"
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* FreeRTOS Plus headers */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+/* Library headers */
+#include "soc.h"
+#include "rtos_support.h"
+
+/* BSP/bitstream headers */
+#include "bitstream_devices.h"
+
+/* App headers */
+#include "telemetry.h"
+
+/*
+ * A client subscribes by sending a datagram to appconfTELEMETRY_PORT,
+ * which may hold the interval it wants in ms as a 32-bit word, and
+ * must keep doing so at least every appconfTELEMETRY_SUBSCRIBE_TIMEOUT_MS.
+ * Only the most recent client is sent to.
+ *
+ * Nothing is formatted and nothing is allocated. Each push reads the
+ * counters straight into one preallocated packet, which is sent once
+ * for each type of record. So the cost of a push is the same every
+ * time, and it is only made at the interval the client asked for.
+ */
+
+/* The largest datagram that is not fragmented */
+#define TELEMETRY_PACKET_SIZE ( ipconfigNETWORK_MTU - 28 )
+#define TELEMETRY_RECORDS_SIZE ( TELEMETRY_PACKET_SIZE - sizeof( telemetry_header_t ) )
+
+static uint32_t packet[TELEMETRY_PACKET_SIZE / sizeof( uint32_t )];
+
+#if configUSE_TRACE_FACILITY
+static TaskStatus_t task_status[appconfTELEMETRY_MAX_TASKS];
+#endif
+
+/*
+ * Each of these fills in as many records of its type as fit into max
+ * bytes as of now, and returns the number filled in.
+ */
+
+static int telemetry_heap_fill( telemetry_heap_t *records, size_t max )
+{
+    records[0].free_bytes = xPortGetFreeHeapSize();
+    records[0].min_free_bytes = xPortGetMinimumEverFreeHeapSize();
+
+    return 1;
+}
+
+static int telemetry_cpu_fill( telemetry_cpu_t *records, size_t max )
+{
+    int count = 0;
+#if RTOS_CPU_STATS
+    static rtos_cpu_stats_t stats;
+
+    rtos_cpu_stats_get( &stats );
+
+    for( ; count < stats.core_count && ( count + 1 ) * sizeof( *records ) <= max; count++ )
+    {
+        for( int i = 0; i < RTOS_CPU_STATS_CATEGORY_COUNT; i++ )
+        {
+            records[count].ticks[i] = stats.core[count].ticks[i];
+        }
+    }
+#endif
+
+    return count;
+}
+
+static int telemetry_irq_fill( telemetry_irq_t *records, size_t max )
+{
+    int count = 0;
+#if RTOS_IRQ_STATS
+    for( int source_id = 0; source_id < RTOS_IRQ_SOURCE_ID_COUNT && ( count + 1 ) * sizeof( *records ) <= max; source_id++ )
+    {
+        rtos_irq_stats_t stats;
+
+        if( rtos_irq_stats_get( source_id, &stats ) == 0 )
+        {
+            records[count].source_id = source_id;
+            records[count].count = stats.count;
+            records[count].coalesced = stats.coalesced;
+            records[count].latency_min = stats.latency_min;
+            records[count].latency_max = stats.latency_max;
+            records[count].latency_total = stats.latency_total;
+            count++;
+        }
+    }
+#endif
+
+    return count;
+}
+
+static int telemetry_dma_fill( telemetry_dma_t *records, size_t max )
+{
+    int count = 0;
+#if SOC_PERIPHERAL_STATS
+    const soc_peripheral_t devices[] = {
+            bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_A],
+            bitstream_ethernet_devices[BITSTREAM_ETHERNET_DEVICE_A],
+            bitstream_i2s_devices[BITSTREAM_I2S_DEVICE_A],
+    };
+
+    for( int device = 0; device < sizeof( devices ) / sizeof( devices[0] ) && ( count + 1 ) * sizeof( *records ) <= max; device++ )
+    {
+        soc_peripheral_stats_t stats;
+
+        if( devices[device] == NULL )
+        {
+            continue;
+        }
+
+        soc_peripheral_stats_get( devices[device], &stats );
+        records[count].device = device;
+        records[count].tx_bytes = stats.tx_bytes;
+        records[count].rx_bytes = stats.rx_bytes;
+        records[count].tx_transfers = stats.tx_transfers;
+        records[count].rx_transfers = stats.rx_transfers;
+        records[count].rx_stalls = stats.rx_stalls;
+        records[count].rx_drops = stats.rx_drops;
+        records[count].tx_ticks = stats.tx_ticks;
+        records[count].rx_ticks = stats.rx_ticks;
+        count++;
+    }
+#endif
+
+    return count;
+}
+
+static int telemetry_lock_fill( telemetry_lock_t *records, size_t max )
+{
+    int count = 0;
+#if RTOS_LOCKS_PROFILE
+    for( int lock_id = 0; lock_id < RTOS_LOCK_TOTAL_COUNT && ( count + 1 ) * sizeof( *records ) <= max; lock_id++ )
+    {
+        rtos_lock_profile_t profile;
+
+        rtos_lock_profile_get( lock_id, &profile );
+        if( profile.acquire_count > 0 )
+        {
+            records[count].lock_id = lock_id;
+            records[count].acquire_count = profile.acquire_count;
+            records[count].wait_ticks_max = profile.wait_ticks_max;
+            records[count].wait_ticks_total = profile.wait_ticks_total;
+            records[count].hold_ticks_max = profile.hold_ticks_max;
+            count++;
+        }
+    }
+#endif
+
+    return count;
+}
+
+static int telemetry_task_fill( telemetry_task_t *records, size_t max )
+{
+    int count = 0;
+#if configUSE_TRACE_FACILITY
+    UBaseType_t task_count = uxTaskGetSystemState( task_status, appconfTELEMETRY_MAX_TASKS, NULL );
+
+    for( ; count < task_count && ( count + 1 ) * sizeof( *records ) <= max; count++ )
+    {
+        records[count].task_number = task_status[count].xTaskNumber;
+        records[count].run_time = task_status[count].ulRunTimeCounter;
+        records[count].stack_high_water_mark = task_status[count].usStackHighWaterMark;
+        records[count].priority = task_status[count].uxCurrentPriority;
+        records[count].state = task_status[count].eCurrentState;
+    }
+#endif
+
+    return count;
+}
+
+static void telemetry_push( Socket_t xSocket, const struct freertos_sockaddr *pxClient, uint32_t seq )
+{
+    telemetry_header_t *header = ( telemetry_header_t * ) packet;
+    void *records = header + 1;
+    const size_t record_sizes[TELEMETRY_TYPE_COUNT] = {
+            sizeof( telemetry_heap_t ),
+            sizeof( telemetry_cpu_t ),
+            sizeof( telemetry_irq_t ),
+            sizeof( telemetry_dma_t ),
+            sizeof( telemetry_lock_t ),
+            sizeof( telemetry_task_t ),
+    };
+
+    header->magic = TELEMETRY_MAGIC;
+    header->seq = seq;
+
+    for( int type = 0; type < TELEMETRY_TYPE_COUNT; type++ )
+    {
+        int count = 0;
+
+        header->time = get_reference_time();
+
+        switch( type )
+        {
+        case TELEMETRY_TYPE_HEAP:
+            count = telemetry_heap_fill( records, TELEMETRY_RECORDS_SIZE );
+            break;
+        case TELEMETRY_TYPE_CPU:
+            count = telemetry_cpu_fill( records, TELEMETRY_RECORDS_SIZE );
+            break;
+        case TELEMETRY_TYPE_IRQ:
+            count = telemetry_irq_fill( records, TELEMETRY_RECORDS_SIZE );
+            break;
+        case TELEMETRY_TYPE_DMA:
+            count = telemetry_dma_fill( records, TELEMETRY_RECORDS_SIZE );
+            break;
+        case TELEMETRY_TYPE_LOCK:
+            count = telemetry_lock_fill( records, TELEMETRY_RECORDS_SIZE );
+            break;
+        case TELEMETRY_TYPE_TASK:
+            count = telemetry_task_fill( records, TELEMETRY_RECORDS_SIZE );
+            break;
+        }
+
+        /* Types not built in send nothing */
+        if( count > 0 )
+        {
+            header->type = type;
+            header->count = count;
+            FreeRTOS_sendto( xSocket, packet, sizeof( *header ) + count * record_sizes[type], 0, pxClient, sizeof( *pxClient ) );
+        }
+    }
+}
+
+static void telemetry_task( void *arg )
+{
+    struct freertos_sockaddr xBindAddress, xClient, xFrom;
+    socklen_t xSize = sizeof( xFrom );
+    const TickType_t xReceiveTimeOut = 0;
+    const TickType_t xSubscribeTimeOut = pdMS_TO_TICKS( appconfTELEMETRY_SUBSCRIBE_TIMEOUT_MS );
+    TickType_t xInterval = pdMS_TO_TICKS( appconfTELEMETRY_INTERVAL_MS );
+    TickType_t xSubscribedTime = 0;
+    TickType_t xLastWakeTime;
+    BaseType_t xSubscribed = pdFALSE;
+    Socket_t xSocket;
+    uint32_t seq = 0;
+
+    while( FreeRTOS_IsNetworkUp() == pdFALSE )
+    {
+        vTaskDelay(pdMS_TO_TICKS( 100 ));
+    }
+
+    xSocket = FreeRTOS_socket(
+            FREERTOS_AF_INET,
+            FREERTOS_SOCK_DGRAM,
+            FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    /* Subscriptions are polled for between pushes */
+    FreeRTOS_setsockopt( xSocket,
+                         0,
+                         FREERTOS_SO_RCVTIMEO,
+                         &xReceiveTimeOut,
+                         sizeof( xReceiveTimeOut ) );
+
+    xBindAddress.sin_port = FreeRTOS_htons( appconfTELEMETRY_PORT );
+    FreeRTOS_bind( xSocket, &xBindAddress, sizeof( xBindAddress ) );
+
+    xLastWakeTime = xTaskGetTickCount();
+
+    for( ;; )
+    {
+        uint32_t request;
+        int32_t lBytes;
+
+        while( ( lBytes = FreeRTOS_recvfrom( xSocket, &request, sizeof( request ), 0, &xFrom, &xSize ) ) >= 0 )
+        {
+            if( lBytes == sizeof( request ) )
+            {
+                if( request < appconfTELEMETRY_MIN_INTERVAL_MS )
+                {
+                    request = appconfTELEMETRY_MIN_INTERVAL_MS;
+                }
+                xInterval = pdMS_TO_TICKS( request );
+            }
+            if( !xSubscribed )
+            {
+                debug_printf("Telemetry subscribed, every %u ms\n", ( unsigned ) ( xInterval * portTICK_PERIOD_MS ));
+            }
+            xClient = xFrom;
+            xSubscribedTime = xTaskGetTickCount();
+            xSubscribed = pdTRUE;
+        }
+
+        if( xSubscribed && xTaskGetTickCount() - xSubscribedTime > xSubscribeTimeOut )
+        {
+            debug_printf("Telemetry subscription expired\n");
+            xSubscribed = pdFALSE;
+            xInterval = pdMS_TO_TICKS( appconfTELEMETRY_INTERVAL_MS );
+        }
+
+        if( xSubscribed )
+        {
+            telemetry_push( xSocket, &xClient, seq++ );
+        }
+
+        vTaskDelayUntil( &xLastWakeTime, xInterval );
+    }
+}
+
+void telemetry_create( UBaseType_t priority )
+{
+    xTaskCreate( telemetry_task, "telemetry", portTASK_STACK_DEPTH(telemetry_task), NULL, priority, NULL );
+}
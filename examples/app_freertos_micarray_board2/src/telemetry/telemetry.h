@@ -0,0 +1,85 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+/*
+ * The binary telemetry pushed to a subscribed client. Every interval
+ * one datagram of each type is sent, each starting with a
+ * telemetry_header_t followed by count records of that type. All
+ * fields are little endian, and all counters are free running 32-bit
+ * values, so that rates are found from the difference between two
+ * pushes. Times are in 100 MHz reference clock ticks.
+ */
+
+#define TELEMETRY_MAGIC 0x4D4C4554 /* "TELM" */
+
+typedef enum {
+    TELEMETRY_TYPE_HEAP,    /* One telemetry_heap_t */
+    TELEMETRY_TYPE_CPU,     /* A telemetry_cpu_t for each RTOS core, needs RTOS_CPU_STATS */
+    TELEMETRY_TYPE_IRQ,     /* A telemetry_irq_t for each IRQ source in use, needs RTOS_IRQ_STATS */
+    TELEMETRY_TYPE_DMA,     /* A telemetry_dma_t for each streaming device, needs SOC_PERIPHERAL_STATS */
+    TELEMETRY_TYPE_LOCK,    /* A telemetry_lock_t for each lock acquired so far, needs RTOS_LOCKS_PROFILE */
+    TELEMETRY_TYPE_TASK,    /* A telemetry_task_t for each task */
+    TELEMETRY_TYPE_COUNT
+} telemetry_type_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;           /* The same for each datagram of one push */
+    uint32_t time;          /* The reference clock time the records were read at */
+    uint16_t type;
+    uint16_t count;
+} telemetry_header_t;
+
+typedef struct {
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;
+} telemetry_heap_t;
+
+typedef struct {
+    uint32_t ticks[4];      /* Idle, task, ISR and intercore yield time */
+} telemetry_cpu_t;
+
+typedef struct {
+    uint32_t source_id;
+    uint32_t count;
+    uint32_t coalesced;
+    uint32_t latency_min;
+    uint32_t latency_max;
+    uint32_t latency_total; /* The low word only */
+} telemetry_irq_t;
+
+typedef struct {
+    uint32_t device;        /* 0 for the mic array, 1 for Ethernet, 2 for I2S */
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t tx_transfers;
+    uint32_t rx_transfers;
+    uint32_t rx_stalls;
+    uint32_t rx_drops;
+    uint32_t tx_ticks;
+    uint32_t rx_ticks;
+} telemetry_dma_t;
+
+typedef struct {
+    uint32_t lock_id;
+    uint32_t acquire_count;
+    uint32_t wait_ticks_max;
+    uint32_t wait_ticks_total;
+    uint32_t hold_ticks_max;
+} telemetry_lock_t;
+
+typedef struct {
+    uint32_t task_number;   /* As shown in the # column of task-stats */
+    uint32_t run_time;
+    uint16_t stack_high_water_mark;
+    uint8_t priority;
+    uint8_t state;
+} telemetry_task_t;
+
+void telemetry_create( UBaseType_t priority );
+
+#endif /* TELEMETRY_H_ */
@@ -49,12 +49,42 @@ one of the application files:
 	#define configAPPLICATION_PROVIDES_cOutputBuffer 0
 #endif
 
+/* The number of buckets in the hash table that registered commands are looked
+up in.  Must be a power of two. */
+#ifndef configCLI_HASH_TABLE_SIZE
+	#define configCLI_HASH_TABLE_SIZE 16
+#endif
+
+/* The number of parameters whose positions are remembered when the command
+being executed is tokenized.  FreeRTOS_CLIGetParameter() searches the command
+string for any parameter beyond this. */
+#ifndef configCLI_MAX_CACHED_PARAMETERS
+	#define configCLI_MAX_CACHED_PARAMETERS 8
+#endif
+
+#if( ( configCLI_HASH_TABLE_SIZE & ( configCLI_HASH_TABLE_SIZE - 1 ) ) != 0 )
+	#error configCLI_HASH_TABLE_SIZE must be a power of two
+#endif
+
 typedef struct xCOMMAND_INPUT_LIST
 {
 	const CLI_Command_Definition_t *pxCommandLineDefinition;
 	struct xCOMMAND_INPUT_LIST *pxNext;
+	struct xCOMMAND_INPUT_LIST *pxNextInBucket;	/* The next command in the same hash table bucket. */
+	uint32_t ulHash;							/* The hash of pcCommand. */
+	size_t xCommandStringLength;				/* The length of pcCommand. */
 } CLI_Definition_List_Item_t;
 
+/* The parameters of the command being executed, found once when the command
+is looked up rather than each time FreeRTOS_CLIGetParameter() is called. */
+typedef struct xCOMMAND_PARAMETERS
+{
+	const char *pcCommandString;	/* The command string the parameters are from, or NULL. */
+	UBaseType_t uxParameterCount;	/* The number of parameters, which may be more than are cached. */
+	const char *pcParameter[ configCLI_MAX_CACHED_PARAMETERS ];
+	BaseType_t xParameterStringLength[ configCLI_MAX_CACHED_PARAMETERS ];
+} CLI_Parameters_t;
+
 /*
  * The callback function that is executed when "help" is entered.  This is the
  * only default command that is always present.
@@ -62,9 +92,32 @@ typedef struct xCOMMAND_INPUT_LIST
 static BaseType_t prvHelpCommand( char *pcWriteBuffer, size_t xWriteBufferLen, const char *pcCommandString );
 
 /*
- * Return the number of parameters that follow the command name.
+ * Return the hash of the first space delimited word in pcCommandString, and
+ * its length in *pxLength.
+ */
+static uint32_t prvHashCommand( const char *pcCommandString, size_t *pxLength );
+
+/*
+ * Add a list item to the end of its hash table bucket.
  */
-static int8_t prvGetNumberOfParameters( const char *pcCommandString );
+static void prvAddToHashTable( CLI_Definition_List_Item_t *pxItem );
+
+/*
+ * Add the help command to the hash table, if it has not been added already.
+ */
+static void prvInitialiseHashTable( void );
+
+/*
+ * Find the parameters that follow the command name in pcCommandString, and
+ * remember them in xParameters.  pcParameters points to just after the
+ * command name.
+ */
+static void prvTokenizeParameters( const char *pcCommandString, const char *pcParameters );
+
+/*
+ * Search pcCommandString for the uxWantedParameter'th parameter.
+ */
+static const char *prvFindParameter( const char *pcCommandString, UBaseType_t uxWantedParameter, BaseType_t *pxParameterStringLength );
 
 /* The definition of the "help" command.  This command is always at the front
 of the list of registered commands. */
@@ -81,9 +134,20 @@ added to this list. */
 static CLI_Definition_List_Item_t xRegisteredCommands =
 {
 	&xHelpCommand,	/* The first command in the list is always the help command, defined in this file. */
-	NULL			/* The next pointer is initialised to NULL, as there are no other registered commands yet. */
+	NULL,			/* The next pointer is initialised to NULL, as there are no other registered commands yet. */
+	NULL,			/* The help command is added to the hash table by prvInitialiseHashTable(). */
+	0,
+	0
 };
 
+/* The hash table that commands are looked up in.  Each bucket holds the
+commands whose hash has the same low bits, in the order they were registered. */
+static CLI_Definition_List_Item_t *pxHashTable[ configCLI_HASH_TABLE_SIZE ];
+static BaseType_t xHashTableInitialised = pdFALSE;
+
+/* The parameters of the command being executed. */
+static CLI_Parameters_t xParameters;
+
 /* A buffer into which command outputs can be written is declared here, rather
 than in the command console implementation, to allow multiple command consoles
 to share the same buffer.  For example, an application may allow access to the
@@ -122,6 +186,8 @@ BaseType_t xReturn = pdFAIL;
 	{
 		taskENTER_CRITICAL();
 		{
+			prvInitialiseHashTable();
+
 			/* Reference the command being registered from the newly created
 			list item. */
 			pxNewListItem->pxCommandLineDefinition = pxCommandToRegister;
@@ -136,6 +202,10 @@ BaseType_t xReturn = pdFAIL;
 
 			/* Set the end of list marker to the new list item. */
 			pxLastCommandInList = pxNewListItem;
+
+			/* Hash the command name now, so that it is not compared with
+			every command string that is entered. */
+			prvAddToHashTable( pxNewListItem );
 		}
 		taskEXIT_CRITICAL();
 
@@ -149,7 +219,7 @@ BaseType_t FreeRTOS_CLIProcessCommand( const char * const pcCommandInput, char *
 {
 static const CLI_Definition_List_Item_t *pxCommand = NULL;
 BaseType_t xReturn = pdTRUE;
-const char *pcRegisteredCommandString;
+uint32_t ulHash;
 size_t xCommandStringLength;
 
 	/* Note:  This function is not re-entrant.  It must not be called from more
@@ -157,27 +227,33 @@ size_t xCommandStringLength;
 
 	if( pxCommand == NULL )
 	{
-		/* Search for the command string in the list of registered commands. */
-		for( pxCommand = &xRegisteredCommands; pxCommand != NULL; pxCommand = pxCommand->pxNext )
+		if( xHashTableInitialised == pdFALSE )
 		{
-			pcRegisteredCommandString = pxCommand->pxCommandLineDefinition->pcCommand;
-			xCommandStringLength = strlen( pcRegisteredCommandString );
-
-			/* To ensure the string lengths match exactly, so as not to pick up
-			a sub-string of a longer command, check the byte after the expected
-			end of the string is either the end of the string or a space before
-			a parameter. */
-			if( ( pcCommandInput[ xCommandStringLength ] == ' ' ) || ( pcCommandInput[ xCommandStringLength ] == 0x00 ) )
+			taskENTER_CRITICAL();
+			prvInitialiseHashTable();
+			taskEXIT_CRITICAL();
+		}
+
+		/* Hash the first word of the input, which is the command name, and
+		search only the commands in its bucket.  Comparing the lengths ensures
+		a sub-string of a longer command is not picked up. */
+		ulHash = prvHashCommand( pcCommandInput, &xCommandStringLength );
+
+		for( pxCommand = pxHashTable[ ulHash & ( configCLI_HASH_TABLE_SIZE - 1 ) ]; pxCommand != NULL; pxCommand = pxCommand->pxNextInBucket )
+		{
+			if( ( pxCommand->ulHash == ulHash ) && ( pxCommand->xCommandStringLength == xCommandStringLength ) )
 			{
-				if( strncmp( pcCommandInput, pcRegisteredCommandString, xCommandStringLength ) == 0 )
+				if( strncmp( pcCommandInput, pxCommand->pxCommandLineDefinition->pcCommand, xCommandStringLength ) == 0 )
 				{
-					/* The command has been found.  Check it has the expected
-					number of parameters.  If cExpectedNumberOfParameters is -1,
-					then there could be a variable number of parameters and no
-					check is made. */
+					/* The command has been found.  Tokenize its parameters
+					then check it has the expected number of them.  If
+					cExpectedNumberOfParameters is -1, then there could be a
+					variable number of parameters and no check is made. */
+					prvTokenizeParameters( pcCommandInput, pcCommandInput + xCommandStringLength );
+
 					if( pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters >= 0 )
 					{
-						if( prvGetNumberOfParameters( pcCommandInput ) != pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters )
+						if( xParameters.uxParameterCount != ( UBaseType_t ) pxCommand->pxCommandLineDefinition->cExpectedNumberOfParameters )
 						{
 							xReturn = pdFALSE;
 						}
@@ -195,6 +271,7 @@ size_t xCommandStringLength;
 		was incorrect. */
 		strncpy( pcWriteBuffer, "Incorrect command parameter(s).  Enter \"help\" to view a list of available commands.\r\n\r\n", xWriteBufferLen );
 		pxCommand = NULL;
+		xParameters.pcCommandString = NULL;
 	}
 	else if( pxCommand != NULL )
 	{
@@ -207,6 +284,10 @@ size_t xCommandStringLength;
 		if( xReturn == pdFALSE )
 		{
 			pxCommand = NULL;
+
+			/* The input buffer may be reused for the next command, so the
+			cached parameters must not be used again. */
+			xParameters.pcCommandString = NULL;
 		}
 	}
 	else
@@ -228,6 +309,31 @@ char *FreeRTOS_CLIGetOutputBuffer( void )
 
 const char *FreeRTOS_CLIGetParameter( const char *pcCommandString, UBaseType_t uxWantedParameter, BaseType_t *pxParameterStringLength )
 {
+const char *pcReturn = NULL;
+
+	if( ( pcCommandString == xParameters.pcCommandString ) && ( uxWantedParameter > 0 ) && ( uxWantedParameter <= configCLI_MAX_CACHED_PARAMETERS ) )
+	{
+		/* This is the command being executed, which was tokenized when it was
+		looked up. */
+		*pxParameterStringLength = 0;
+
+		if( uxWantedParameter <= xParameters.uxParameterCount )
+		{
+			pcReturn = xParameters.pcParameter[ uxWantedParameter - 1 ];
+			*pxParameterStringLength = xParameters.xParameterStringLength[ uxWantedParameter - 1 ];
+		}
+	}
+	else
+	{
+		pcReturn = prvFindParameter( pcCommandString, uxWantedParameter, pxParameterStringLength );
+	}
+
+	return pcReturn;
+}
+/*-----------------------------------------------------------*/
+
+static const char *prvFindParameter( const char *pcCommandString, UBaseType_t uxWantedParameter, BaseType_t *pxParameterStringLength )
+{
 UBaseType_t uxParametersFound = 0;
 const char *pcReturn = NULL;
 
@@ -315,39 +421,93 @@ BaseType_t xReturn;
 }
 /*-----------------------------------------------------------*/
 
-static int8_t prvGetNumberOfParameters( const char *pcCommandString )
+static uint32_t prvHashCommand( const char *pcCommandString, size_t *pxLength )
 {
-int8_t cParameters = 0;
-BaseType_t xLastCharacterWasSpace = pdFALSE;
+uint32_t ulHash = 2166136261UL;
+size_t xLength = 0;
 
-	/* Count the number of space delimited words in pcCommandString. */
-	while( *pcCommandString != 0x00 )
+	/* FNV-1a over the characters up to the first space or the end of the
+	string. */
+	while( ( pcCommandString[ xLength ] != 0x00 ) && ( pcCommandString[ xLength ] != ' ' ) )
 	{
-		if( ( *pcCommandString ) == ' ' )
+		ulHash ^= ( uint8_t ) pcCommandString[ xLength ];
+		ulHash *= 16777619UL;
+		xLength++;
+	}
+
+	*pxLength = xLength;
+
+	return ulHash;
+}
+/*-----------------------------------------------------------*/
+
+static void prvAddToHashTable( CLI_Definition_List_Item_t *pxItem )
+{
+CLI_Definition_List_Item_t **ppxBucketItem;
+
+	pxItem->ulHash = prvHashCommand( pxItem->pxCommandLineDefinition->pcCommand, &( pxItem->xCommandStringLength ) );
+	pxItem->pxNextInBucket = NULL;
+
+	/* Add the item to the end of its bucket so that, as when the list was
+	searched, the command registered first is found if two share a name. */
+	ppxBucketItem = &pxHashTable[ pxItem->ulHash & ( configCLI_HASH_TABLE_SIZE - 1 ) ];
+	while( *ppxBucketItem != NULL )
+	{
+		ppxBucketItem = &( ( *ppxBucketItem )->pxNextInBucket );
+	}
+
+	*ppxBucketItem = pxItem;
+}
+/*-----------------------------------------------------------*/
+
+static void prvInitialiseHashTable( void )
+{
+	/* Must be called from within a critical section. */
+	if( xHashTableInitialised == pdFALSE )
+	{
+		prvAddToHashTable( &xRegisteredCommands );
+		xHashTableInitialised = pdTRUE;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvTokenizeParameters( const char *pcCommandString, const char *pcParameters )
+{
+UBaseType_t uxParameterCount = 0;
+const char *pcParameter;
+
+	for( ;; )
+	{
+		/* Find the start of the next parameter. */
+		while( ( *pcParameters ) == ' ' )
 		{
-			if( xLastCharacterWasSpace != pdTRUE )
-			{
-				cParameters++;
-				xLastCharacterWasSpace = pdTRUE;
-			}
+			pcParameters++;
 		}
-		else
+
+		if( ( *pcParameters ) == 0x00 )
 		{
-			xLastCharacterWasSpace = pdFALSE;
+			break;
 		}
 
-		pcCommandString++;
-	}
+		/* Find the end of it. */
+		pcParameter = pcParameters;
+		while( ( ( *pcParameters ) != 0x00 ) && ( ( *pcParameters ) != ' ' ) )
+		{
+			pcParameters++;
+		}
 
-	/* If the command string ended with spaces, then there will have been too
-	many parameters counted. */
-	if( xLastCharacterWasSpace == pdTRUE )
-	{
-		cParameters--;
+		/* Parameters that do not fit are still counted, so that the number
+		of parameters can be checked, and are found by prvFindParameter(). */
+		if( uxParameterCount < configCLI_MAX_CACHED_PARAMETERS )
+		{
+			xParameters.pcParameter[ uxParameterCount ] = pcParameter;
+			xParameters.xParameterStringLength[ uxParameterCount ] = ( BaseType_t ) ( pcParameters - pcParameter );
+		}
+
+		uxParameterCount++;
 	}
 
-	/* The value returned is one less than the number of space delimited words,
-	as the first word should be the command itself. */
-	return cParameters;
+	xParameters.uxParameterCount = uxParameterCount;
+	xParameters.pcCommandString = pcCommandString;
 }
 
@@ -0,0 +1,386 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#define DEBUG_UNIT UDP_TO_QUEUE
+#include "app_conf.h"
+
+#include <string.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* FreeRTOS Plus headers */
+#include "FreeRTOS_IP.h"
+#include "FreeRTOS_Sockets.h"
+
+/* Library headers */
+#include "soc.h"
+#include "soc_dma_buf_pool.h"
+#include "soc_fifo.h"
+
+/* BSP/bitstream headers */
+#include "bitstream_devices.h"
+#include "i2s_driver.h"
+#include "micarray_driver.h"
+
+/* App headers */
+#include "udp_stream_to_queue.h"
+
+#if appconfUDP_TO_QUEUE_ENABLED
+
+/*
+ * Each datagram received is expected to be one RTP packet holding one
+ * frame of appconfMIC_FRAME_LENGTH raw little endian mono samples, as
+ * sent by queue_to_udp_stream. Any that are not are ignored. Whoever
+ * sends to appconfUDP_TO_QUEUE_PORT is played, and a new SSRC or a jump
+ * in the sequence numbers starts the stream over.
+ *
+ * The receiver task copies the frames into frames from its own pool
+ * and puts them into a jitter buffer, which is a soc_fifo of frame
+ * pointers, with the receiver as its producer and the playout task as
+ * its consumer. A gap in the sequence numbers is filled with NULLs, so
+ * the playout task knows where a frame was lost, and a frame that
+ * arrives after its place has gone is dropped.
+ *
+ * The playout task takes one frame from the jitter buffer for each it
+ * sends to the output queue, which it blocks on, so it runs at the
+ * DAC's rate. Nothing is played until the jitter buffer has first
+ * filled to its ready level. Whenever it runs dry after that, the FIFO
+ * is not ready again until it has refilled to that level, and the
+ * level is raised by a frame, up to appconfUDP_TO_QUEUE_MAX_LEVEL.
+ * After appconfUDP_TO_QUEUE_ADAPT_MS without it running dry, the level
+ * is lowered by a frame, down to appconfUDP_TO_QUEUE_MIN_LEVEL. The
+ * level so tracks the network's jitter.
+ *
+ * The fill level left after each frame is taken also shows how much
+ * more is buffered than is needed. When it stays above the ready level
+ * for all of appconfUDP_TO_QUEUE_ADAPT_MS a frame is dropped. This is
+ * also how a sender whose clock runs fast of the DAC's is kept up with,
+ * while one that runs slow shows up as the jitter buffer running dry.
+ *
+ * Lost frames, and those missing while the jitter buffer refills, are
+ * concealed by playing the last frame received again, fading out by
+ * 6 dB each time. After appconfUDP_TO_QUEUE_PLC_MAX_FRAMES silence is
+ * played, and after appconfUDP_TO_QUEUE_TIMEOUT_MS the stream is taken
+ * to have stopped.
+ */
+
+#define RTP_HEADER_SIZE     12
+#define RTP_VERSION         2
+#define RTP_PAYLOAD_TYPE    96
+
+#define UDP_TO_QUEUE_FRAME_BYTES ( sizeof(micarray_sample_t) * appconfMIC_FRAME_LENGTH )
+
+/* Frames are played to the DAC as they are */
+#if I2SCONF_WORD_LENGTH_SHORT != MICARRAYCONF_WORD_LENGTH_SHORT
+#error I2SCONF_WORD_LENGTH_SHORT must match MICARRAYCONF_WORD_LENGTH_SHORT
+#endif
+
+#define UDP_TO_QUEUE_MS_TO_FRAMES(ms) ( (ms) * (I2SCONF_SAMPLE_FREQ / 1000) / appconfMIC_FRAME_LENGTH )
+
+/*
+ * Enough frames for a full jitter buffer, the output queue and the I2S
+ * DMA ring, and the one being received and the one being played out.
+ */
+#define UDP_TO_QUEUE_FRAME_POOL_COUNT ( appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES + 6 )
+
+#if appconfUDP_TO_QUEUE_MAX_LEVEL > appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES
+#error appconfUDP_TO_QUEUE_MAX_LEVEL must not be more than appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES
+#endif
+
+static QueueHandle_t output_queue;
+static soc_dma_buf_pool_t *frame_pool;
+static TaskHandle_t playout_task;
+static volatile int playing;
+
+int udp_stream_to_queue_playing(void)
+{
+    return playing;
+}
+
+/*
+ * Fills frame with the last frame received, faded from 6 dB quieter
+ * for each frame concealed before it to 6 dB quieter again, so that
+ * repeating it does not step. concealed counts this frame too.
+ */
+static void plc_frame_fill(
+        micarray_sample_t *frame,
+        const micarray_sample_t *last,
+        int concealed)
+{
+    int32_t start;
+    int32_t end;
+
+    if (concealed > appconfUDP_TO_QUEUE_PLC_MAX_FRAMES) {
+        memset(frame, 0, UDP_TO_QUEUE_FRAME_BYTES);
+        return;
+    }
+
+    start = 0x8000 >> (concealed - 1);
+    end = start >> 1;
+
+    for (int i = 0; i < appconfMIC_FRAME_LENGTH; i++) {
+        int32_t gain = start - (start - end) * i / appconfMIC_FRAME_LENGTH;
+        frame[i] = (micarray_sample_t) (((int64_t) last[i] * gain) >> 15);
+    }
+}
+
+/*
+ * Puts whatever is left in the jitter buffer back into the pool, and
+ * puts its ready level back to the least.
+ */
+static void jitter_buffer_flush(soc_fifo_t fifo)
+{
+    micarray_sample_t *frame;
+
+    soc_fifo_ready_level_set(fifo, 1);
+    while (soc_fifo_get(fifo, &frame) == 0) {
+        if (frame != NULL) {
+            soc_dma_buf_pool_put(frame);
+        }
+    }
+    soc_fifo_ready_level_set(fifo, appconfUDP_TO_QUEUE_MIN_LEVEL);
+}
+
+static void udp_to_queue_playout(void *arg)
+{
+    soc_fifo_t fifo = arg;
+    const int adapt_frames = UDP_TO_QUEUE_MS_TO_FRAMES(appconfUDP_TO_QUEUE_ADAPT_MS);
+    const int timeout_frames = UDP_TO_QUEUE_MS_TO_FRAMES(appconfUDP_TO_QUEUE_TIMEOUT_MS);
+    static micarray_sample_t last[appconfMIC_FRAME_LENGTH];
+
+    for (;;) {
+        unsigned min_level = appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES;
+        int window_frames = 0;
+        int window_underruns = 0;
+        int underrun = 0;
+        int concealed = 0;
+        uint32_t played = 0;
+        uint32_t lost = 0;
+        uint32_t underruns = 0;
+        uint32_t dropped = 0;
+
+        /* Wait for the jitter buffer to first fill */
+        while (!soc_fifo_ready(fifo)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        debug_printf("UDP playout started\n");
+        memset(last, 0, sizeof(last));
+        playing = 1;
+
+        while (concealed < timeout_frames) {
+            micarray_sample_t *frame;
+            unsigned level;
+
+            if (soc_fifo_get(fifo, &frame) == 0) {
+                underrun = 0;
+                if (frame == NULL) {
+                    lost++;
+                }
+            } else if (!underrun) {
+                /* Wait for more to be buffered this time before playing again */
+                underrun = 1;
+                underruns++;
+                window_underruns++;
+                if (soc_fifo_ready_level(fifo) < appconfUDP_TO_QUEUE_MAX_LEVEL) {
+                    soc_fifo_ready_level_set(fifo, soc_fifo_ready_level(fifo) + 1);
+                }
+            }
+
+            if (frame != NULL) {
+                memcpy(last, frame, UDP_TO_QUEUE_FRAME_BYTES);
+                concealed = 0;
+            } else {
+                frame = soc_dma_buf_pool_get(frame_pool);
+                configASSERT(frame != NULL);
+                plc_frame_fill(frame, last, ++concealed);
+                soc_dma_buf_pool_timestamp_set(frame, get_reference_time());
+            }
+
+            level = soc_fifo_level(fifo);
+            if (!underrun && level < min_level) {
+                min_level = level;
+            }
+
+            if (++window_frames == adapt_frames) {
+                if (window_underruns == 0) {
+                    if (min_level > soc_fifo_ready_level(fifo)) {
+                        micarray_sample_t *excess;
+
+                        soc_fifo_get(fifo, &excess);
+                        if (excess != NULL) {
+                            soc_dma_buf_pool_put(excess);
+                        }
+                        dropped++;
+                    }
+                    if (soc_fifo_ready_level(fifo) > appconfUDP_TO_QUEUE_MIN_LEVEL) {
+                        soc_fifo_ready_level_set(fifo, soc_fifo_ready_level(fifo) - 1);
+                    }
+                }
+                min_level = appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES;
+                window_frames = 0;
+                window_underruns = 0;
+            }
+
+            xQueueSend(output_queue, &frame, portMAX_DELAY);
+            played++;
+        }
+
+        playing = 0;
+        jitter_buffer_flush(fifo);
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        debug_printf("UDP playout stopped, %u frames played, %u lost, %u underruns, %u dropped\n",
+                played - concealed, lost, underruns, dropped);
+    }
+}
+
+/*
+ * Returns pdTRUE if the datagram is an RTP packet of one frame, and
+ * gets its sequence number and SSRC.
+ */
+static BaseType_t rtp_frame_check( const uint8_t *pucBuffer, int32_t lBytes, uint16_t *pusSequence, uint32_t *pulSSRC )
+{
+    if( lBytes != RTP_HEADER_SIZE + UDP_TO_QUEUE_FRAME_BYTES ||
+        ( pucBuffer[ 0 ] >> 6 ) != RTP_VERSION ||
+        ( pucBuffer[ 0 ] & 0x3F ) != 0 ||
+        ( pucBuffer[ 1 ] & 0x7F ) != RTP_PAYLOAD_TYPE )
+    {
+        return pdFALSE;
+    }
+
+    *pusSequence = ( pucBuffer[ 2 ] << 8 ) | pucBuffer[ 3 ];
+    *pulSSRC = ( pucBuffer[ 8 ] << 24 ) | ( pucBuffer[ 9 ] << 16 ) | ( pucBuffer[ 10 ] << 8 ) | pucBuffer[ 11 ];
+
+    return pdTRUE;
+}
+
+static void udp_to_queue_receiver( void *arg )
+{
+    struct freertos_sockaddr xBindAddress, xFrom;
+    socklen_t xSize = sizeof( xFrom );
+    const TickType_t xReceiveTimeOut = pdMS_TO_TICKS( appconfUDP_TO_QUEUE_TIMEOUT_MS );
+    const micarray_sample_t *const pxLost = NULL;
+    Socket_t xSocket;
+    soc_fifo_t fifo;
+    BaseType_t xSynced = pdFALSE;
+    uint16_t usNextSequence = 0;
+    uint32_t ulStreamSSRC = 0;
+    uint32_t ulLate = 0;
+    uint32_t ulOverflows = 0;
+
+    /* The jitter buffer lives on this task's stack, which is never freed */
+    soc_fifo_init( fifo, appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES, sizeof( void * ), appconfUDP_TO_QUEUE_MIN_LEVEL );
+
+    xTaskCreate( udp_to_queue_playout, "udp2q_play", portTASK_STACK_DEPTH(udp_to_queue_playout), fifo, uxTaskPriorityGet( NULL ), &playout_task );
+
+    while( FreeRTOS_IsNetworkUp() == pdFALSE )
+    {
+        vTaskDelay(pdMS_TO_TICKS( 100 ));
+    }
+
+    xSocket = FreeRTOS_socket(
+            FREERTOS_AF_INET,
+            FREERTOS_SOCK_DGRAM,
+            FREERTOS_IPPROTO_UDP );
+    configASSERT( xSocket != FREERTOS_INVALID_SOCKET );
+
+    /* The stream starts over after it has stopped for this long */
+    FreeRTOS_setsockopt( xSocket,
+                         0,
+                         FREERTOS_SO_RCVTIMEO,
+                         &xReceiveTimeOut,
+                         sizeof( xReceiveTimeOut ) );
+
+    xBindAddress.sin_port = FreeRTOS_htons( appconfUDP_TO_QUEUE_PORT );
+    FreeRTOS_bind( xSocket, &xBindAddress, sizeof( xBindAddress ) );
+
+    for( ;; )
+    {
+        uint8_t *pucBuffer;
+        micarray_sample_t *frame;
+        int32_t lBytes;
+        uint16_t usSequence;
+        uint32_t ulSSRC;
+        int16_t sGap = 0;
+
+        /* The datagram is received in place in the stack's network buffer */
+        lBytes = FreeRTOS_recvfrom( xSocket, &pucBuffer, 0, FREERTOS_ZERO_COPY, &xFrom, &xSize );
+        if( lBytes < 0 )
+        {
+            if( xSynced )
+            {
+                debug_printf("UDP stream stopped, %u frames late, %u overflowed\n", ulLate, ulOverflows);
+                xSynced = pdFALSE;
+                ulLate = 0;
+                ulOverflows = 0;
+            }
+            continue;
+        }
+
+        if( !rtp_frame_check( pucBuffer, lBytes, &usSequence, &ulSSRC ) )
+        {
+            FreeRTOS_ReleaseUDPPayloadBuffer( pucBuffer );
+            continue;
+        }
+
+        if( xSynced && ulSSRC == ulStreamSSRC )
+        {
+            sGap = ( int16_t ) ( usSequence - usNextSequence );
+            if( sGap < 0 )
+            {
+                /* Its place in the jitter buffer has already been played */
+                ulLate++;
+                FreeRTOS_ReleaseUDPPayloadBuffer( pucBuffer );
+                continue;
+            }
+            if( sGap > appconfUDP_TO_QUEUE_JITTER_BUFFER_FRAMES )
+            {
+                /* Too many lost to conceal, so start over from this one */
+                sGap = 0;
+            }
+        }
+        else
+        {
+            debug_printf("UDP stream from %x started\n", ulSSRC);
+        }
+
+        xSynced = pdTRUE;
+        ulStreamSSRC = ulSSRC;
+        usNextSequence = usSequence + 1;
+
+        frame = soc_dma_buf_pool_get( frame_pool );
+        if( frame != NULL )
+        {
+            memcpy( frame, pucBuffer + RTP_HEADER_SIZE, UDP_TO_QUEUE_FRAME_BYTES );
+            soc_dma_buf_pool_timestamp_set( frame, get_reference_time() );
+        }
+        FreeRTOS_ReleaseUDPPayloadBuffer( pucBuffer );
+
+        /* Mark where each lost frame was */
+        while( sGap-- > 0 && soc_fifo_put( fifo, &pxLost ) == 0 );
+
+        if( frame == NULL || soc_fifo_put( fifo, &frame ) != 0 )
+        {
+            ulOverflows++;
+            if( frame != NULL )
+            {
+                soc_dma_buf_pool_put( frame );
+            }
+        }
+
+        xTaskNotifyGive( playout_task );
+    }
+}
+
+void udp_stream_to_queue_create(QueueHandle_t output, UBaseType_t priority)
+{
+    output_queue = output;
+    frame_pool = soc_dma_buf_pool_create( UDP_TO_QUEUE_FRAME_BYTES, UDP_TO_QUEUE_FRAME_POOL_COUNT );
+
+    xTaskCreate( udp_to_queue_receiver, "udp2q_recv", portTASK_STACK_DEPTH(udp_to_queue_receiver), NULL, priority, NULL );
+}
+
+#endif /* appconfUDP_TO_QUEUE_ENABLED */
@@ -0,0 +1,29 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef UDP_STREAM_TO_QUEUE_H_
+#define UDP_STREAM_TO_QUEUE_H_
+
+#include "app_conf.h"
+
+#if appconfUDP_TO_QUEUE_ENABLED
+
+/*
+ * Receives an RTP stream of mono frames, in the same format as
+ * queue_to_udp_stream sends, on appconfUDP_TO_QUEUE_PORT, and plays it
+ * out to output, one frame at a time, as fast as output takes them.
+ * output is expected to be the I2S input queue, so it is paced by the
+ * DAC.
+ */
+void udp_stream_to_queue_create(QueueHandle_t output, UBaseType_t priority);
+
+/*
+ * Returns non-zero while a stream is being played out to the output
+ * queue, during which nothing else should send to it.
+ */
+int udp_stream_to_queue_playing(void);
+
+#else
+#define udp_stream_to_queue_playing() 0
+#endif
+
+#endif /* UDP_STREAM_TO_QUEUE_H_ */
@@ -0,0 +1,64 @@
+# Copyright (c) 2019, XMOS Ltd, All rights reserved
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import sys
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser(
+        description="Compares the output of app_freertos_rtos_bench from two runs, "
+                    "such as from two releases of lib_rtos_support and lib_soc")
+    parser.add_argument("baseline", help="Output of the baseline run")
+    parser.add_argument("new", help="Output of the run to compare with the baseline")
+    parser.add_argument("-threshold", type=float, default=10.0,
+                        help="Percentage by which the mean time per op may rise before it is a regression")
+
+    return parser.parse_args()
+
+def load_results(path):
+    """
+    Returns a dict of (test, cores) to (mean, max) ticks per op. Any line
+    that does not start with "rtos_bench," is not a result, and the header
+    and end lines are skipped.
+    """
+    results = {}
+
+    with open(path) as f:
+        for line in f:
+            fields = line.strip().split(",")
+            if fields[0] != "rtos_bench" or len(fields) != 6 or fields[1] == "test":
+                continue
+            test, cores, ops, mean, max_ = fields[1:]
+            results[(test, int(cores))] = (int(mean) / 100, int(max_) / 100)
+
+    return results
+
+def main(baseline_path, new_path, threshold):
+    baseline = load_results(baseline_path)
+    new = load_results(new_path)
+    regressions = 0
+
+    print("{:<14} {:>5} {:>10} {:>10} {:>8}".format("test", "cores", "baseline", "new", "change"))
+
+    for key in sorted(set(baseline) | set(new)):
+        if key not in baseline or key not in new:
+            print("{:<14} {:>5} only in {}".format(key[0], key[1], "baseline" if key in baseline else "new"))
+            continue
+
+        old_mean = baseline[key][0]
+        new_mean = new[key][0]
+        change = (new_mean - old_mean) * 100 / old_mean if old_mean else 0.0
+        flag = ""
+        if change > threshold:
+            flag = " REGRESSION"
+            regressions += 1
+
+        print("{:<14} {:>5} {:>10.2f} {:>10.2f} {:>+7.1f}%{}".format(key[0], key[1], old_mean, new_mean, change, flag))
+
+    return 1 if regressions else 0
+
+if __name__ == "__main__":
+    args = parse_arguments()
+    sys.exit(main(args.baseline, args.new, args.threshold))
@@ -0,0 +1,12 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "soc.h"
+
+/*
+ * There is no bitstream on tile 0 to wait for, so the
+ * software may start straight away.
+ */
+int soc_tile0_bitstream_initialized(void)
+{
+    return 1;
+}
@@ -0,0 +1,12 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef BITSTREAM_DEVICES_H_
+#define BITSTREAM_DEVICES_H_
+
+/*
+ * There is no bitstream, so there are no devices. Each driver
+ * declares its own empty device table when its peripheral is
+ * not used.
+ */
+
+#endif /* BITSTREAM_DEVICES_H_ */
@@ -0,0 +1,29 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_CONF_H_
+#define SOC_CONF_H_
+
+/*
+ * Tile descriptors. FreeRTOS gets the whole of tile 0 to itself,
+ * so that nothing but the benchmarks contends with its cores.
+ */
+#define SOC_MULTITILE        0
+#define SOC_TILE_0_INCLUDE   SOC_TILE_HAS_SOFTWARE
+#define SOC_TILE_1_INCLUDE   SOC_TILE_UNUSED
+#define SOC_TILE_2_INCLUDE   SOC_TILE_UNUSED
+#define SOC_TILE_3_INCLUDE   SOC_TILE_UNUSED
+
+/*
+ * Peripherals. None are needed, as the DMA ring benchmarks
+ * play the peripheral hub themselves.
+ */
+#define SOC_ETHERNET_PERIPHERAL_USED        (0)
+#define SOC_GPIO_PERIPHERAL_USED            (0)
+#define SOC_I2C_PERIPHERAL_USED             (0)
+#define SOC_I2S_PERIPHERAL_USED             (0)
+#define SOC_MICARRAY_PERIPHERAL_USED        (0)
+#define SOC_SDRAM_PERIPHERAL_USED           (0)
+#define SOC_INTERTILE_PERIPHERAL_USED       (0)
+#define SOC_LOOPBACK_PERIPHERAL_USED        (0)
+
+#endif /* SOC_CONF_H_ */
@@ -0,0 +1,26 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+
+/* App headers */
+#include "rtos_bench.h"
+
+void soc_tile0_main(
+        int tile)
+{
+    /* Create the benchmark, which writes out its results and then stops */
+    rtos_bench_create( configMAX_PRIORITIES - 3 );
+
+    vTaskStartScheduler();
+}
+
+
+void vApplicationMallocFailedHook(void)
+{
+    debug_printf("Malloc failed!\n");
+    configASSERT(0);
+}
@@ -0,0 +1,467 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Library headers */
+#include "rtos_support.h"
+#include "soc.h"
+#include "soc_fifo.h"
+
+/* App headers */
+#include "rtos_bench.h"
+
+/*
+ * The functions the peripheral hub calls to move a ring on. They are
+ * not part of the application API, so are declared here just as they
+ * are in peripheral_hub.c.
+ */
+void *soc_dma_ring_buf_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more);
+
+void soc_dma_ring_buf_release(
+        soc_dma_ring_buf_t *ring_buf,
+        int rx,
+        int length);
+
+/* The number of times each core runs an operation for each measurement */
+#ifndef RTOS_BENCH_OPS
+#define RTOS_BENCH_OPS                  1024
+#endif
+
+/*
+ * The number of times each core calls rtos_printf() for its measurement.
+ * This is kept low as each call writes a line out.
+ */
+#ifndef RTOS_BENCH_PRINTF_OPS
+#define RTOS_BENCH_PRINTF_OPS           16
+#endif
+
+/* The hardware lock that the lock benchmark contends for */
+#ifndef RTOS_BENCH_LOCK_ID
+#define RTOS_BENCH_LOCK_ID              0
+#endif
+
+/* The number of elements in each core's FIFO, and descriptors in its DMA ring */
+#define RTOS_BENCH_FIFO_LEN             16
+#define RTOS_BENCH_RING_DESC_COUNT      16
+
+/*
+ * How far ahead of the controller notifying them the cores are told to
+ * start, so that they all start together. 1 ms of the reference clock.
+ */
+#define RTOS_BENCH_START_DELAY_TICKS    100000
+
+/* The words each core's DMA ring descriptors take, rounded up to keep each core's aligned */
+#define RTOS_BENCH_RING_DESC_WORDS \
+    ((RTOS_BENCH_RING_DESC_COUNT * SOC_DMA_BUF_DESC_WORDSIZE * sizeof(uint32_t) + SOC_DMA_BUF_DESC_ALIGNMENT - 1) \
+            / SOC_DMA_BUF_DESC_ALIGNMENT * SOC_DMA_BUF_DESC_ALIGNMENT / sizeof(uint32_t))
+
+typedef struct rtos_bench_worker rtos_bench_worker_t;
+
+/*
+ * Runs an operation ops times on the calling core, and returns how
+ * many reference clock ticks were spent in it. Anything that only sets
+ * up or tears down the operation is left out of the time. It must be
+ * defined with RTOS_BENCH_TEST_ATTR.
+ */
+typedef uint32_t (*rtos_bench_test_fn_t)(rtos_bench_worker_t *worker, int ops);
+
+#define RTOS_BENCH_TEST_ATTR __attribute__((fptrgroup("rtos_bench_test")))
+
+typedef struct {
+    const char *name;
+    RTOS_BENCH_TEST_ATTR rtos_bench_test_fn_t fn;
+    int ops;
+    int min_cores;
+} rtos_bench_test_t;
+
+struct rtos_bench_worker {
+    TaskHandle_t task;
+    int core_id;
+    uint32_t ticks;
+
+    /* Written by the core's own task, and by the core the IRQ benchmark sends to */
+    volatile uint32_t irq_sent;
+    volatile uint32_t irq_ticks;
+
+    /* Keeps the results of the operations live so they are not optimised away */
+    uint32_t sink;
+
+    soc_dma_ring_buf_t ring;
+};
+
+static struct {
+    TaskHandle_t controller;
+    const rtos_bench_test_t *test;
+    int cores;
+    uint32_t start_time;
+    rtos_bench_worker_t workers[configNUM_CORES];
+} bench;
+
+static uint32_t ring_desc[configNUM_CORES * RTOS_BENCH_RING_DESC_WORDS]
+    __attribute__((aligned(SOC_DMA_BUF_DESC_ALIGNMENT))) SOC_DMA_BUF_DESC_SECTION_ATTR;
+static uint32_t ring_bufs[configNUM_CORES][RTOS_BENCH_RING_DESC_COUNT];
+
+/*
+ * Every core contends for the same hardware lock. Interrupts are
+ * masked, as they are whenever the RTOS takes one of its locks.
+ */
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_lock(rtos_bench_worker_t *worker, int ops)
+{
+    uint32_t mask;
+    uint32_t t;
+    int i;
+
+    mask = rtos_interrupt_mask_all();
+    t = get_reference_time();
+    for (i = 0; i < ops; i++) {
+        rtos_lock_acquire(RTOS_BENCH_LOCK_ID);
+        rtos_lock_release(RTOS_BENCH_LOCK_ID);
+    }
+    t = get_reference_time() - t;
+    rtos_interrupt_mask_set(mask);
+
+    return t;
+}
+
+/*
+ * Called on the core that the IRQ benchmark sends to, from its IRQ
+ * handler. Adds the time since the sending core sent it.
+ */
+static RTOS_CORE_CALL_FN_ATTR void rtos_bench_irq_dispatched(void *arg, int core_id)
+{
+    rtos_bench_worker_t *sender = arg;
+
+    (void) core_id;
+    sender->irq_ticks += get_reference_time() - sender->irq_sent;
+}
+
+/*
+ * Each core sends IRQs to the next, with rtos_core_call(), while it
+ * takes those sent by the one before. The time is from the send to the
+ * called function starting on the other core, so includes the IRQ
+ * handler's dispatch.
+ */
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_irq(rtos_bench_worker_t *worker, int ops)
+{
+    int target = bench.workers[(worker - bench.workers + 1) % bench.cores].core_id;
+    int i;
+
+    worker->irq_ticks = 0;
+    for (i = 0; i < ops; i++) {
+        worker->irq_sent = get_reference_time();
+        rtos_core_call(target, rtos_bench_irq_dispatched, worker, 1);
+    }
+
+    return worker->irq_ticks;
+}
+
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_core_id(rtos_bench_worker_t *worker, int ops)
+{
+    uint32_t sum = 0;
+    uint32_t mask;
+    uint32_t t;
+    int i;
+
+    mask = rtos_interrupt_mask_all();
+    t = get_reference_time();
+    for (i = 0; i < ops; i++) {
+        sum += rtos_core_id_get();
+    }
+    t = get_reference_time() - t;
+    rtos_interrupt_mask_set(mask);
+
+    worker->sink = sum;
+    return t;
+}
+
+/* Formats a short line with a few arguments, without writing it out */
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_snprintf(rtos_bench_worker_t *worker, int ops)
+{
+    char line[32];
+    uint32_t mask;
+    uint32_t t;
+    int i;
+
+    mask = rtos_interrupt_mask_all();
+    t = get_reference_time();
+    for (i = 0; i < ops; i++) {
+        worker->sink += rtos_snprintf(line, sizeof(line), "# %d %x %s\n", i, i, "bench");
+    }
+    t = get_reference_time() - t;
+    rtos_interrupt_mask_set(mask);
+
+    return t;
+}
+
+/*
+ * Formats and writes out a short line, or just defers it when built
+ * with RTOS_PRINTF_DEFERRED. The lines start with "#" so that they are
+ * not taken for results.
+ */
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_printf(rtos_bench_worker_t *worker, int ops)
+{
+    uint32_t t;
+    int i;
+
+    t = get_reference_time();
+    for (i = 0; i < ops; i++) {
+        rtos_printf("# %d %d\n", worker->core_id, i);
+    }
+    t = get_reference_time() - t;
+
+    return t;
+}
+
+/*
+ * Each core has its own FIFO, so the cores only contend for the
+ * pipeline. A full FIFO is put at a time, and is emptied again
+ * outside of the time.
+ */
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_fifo_put(rtos_bench_worker_t *worker, int ops)
+{
+    soc_fifo_t fifo;
+    uint32_t word = 0;
+    uint32_t ticks = 0;
+    uint32_t mask;
+    uint32_t t;
+    int i;
+
+    soc_fifo_init(fifo, RTOS_BENCH_FIFO_LEN, sizeof(uint32_t), 1);
+
+    mask = rtos_interrupt_mask_all();
+    while (ops > 0) {
+        t = get_reference_time();
+        for (i = 0; i < RTOS_BENCH_FIFO_LEN; i++) {
+            (void) soc_fifo_put(fifo, &word);
+        }
+        ticks += get_reference_time() - t;
+
+        for (i = 0; i < RTOS_BENCH_FIFO_LEN; i++) {
+            (void) soc_fifo_get(fifo, &word);
+        }
+        ops -= RTOS_BENCH_FIFO_LEN;
+    }
+    rtos_interrupt_mask_set(mask);
+
+    worker->sink = word;
+    return ticks;
+}
+
+/* As rtos_bench_fifo_put(), but the FIFO is filled outside of the time and emptied inside it */
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_fifo_get(rtos_bench_worker_t *worker, int ops)
+{
+    soc_fifo_t fifo;
+    uint32_t word = 0;
+    uint32_t ticks = 0;
+    uint32_t mask;
+    uint32_t t;
+    int i;
+
+    soc_fifo_init(fifo, RTOS_BENCH_FIFO_LEN, sizeof(uint32_t), 1);
+
+    mask = rtos_interrupt_mask_all();
+    while (ops > 0) {
+        for (i = 0; i < RTOS_BENCH_FIFO_LEN; i++) {
+            (void) soc_fifo_put(fifo, &word);
+        }
+
+        t = get_reference_time();
+        for (i = 0; i < RTOS_BENCH_FIFO_LEN; i++) {
+            (void) soc_fifo_get(fifo, &word);
+        }
+        ticks += get_reference_time() - t;
+        ops -= RTOS_BENCH_FIFO_LEN;
+    }
+    rtos_interrupt_mask_set(mask);
+
+    worker->sink = word;
+    return ticks;
+}
+
+/*
+ * Each core has its own DMA ring, with the core playing the peripheral
+ * hub as well. A full ring of buffers is submitted with
+ * soc_dma_ring_tx_buf_set() at a time, then moved on by the hub side
+ * and taken back with soc_dma_ring_tx_buf_get(). Only one of the
+ * application side steps is timed, given by complete.
+ */
+static uint32_t rtos_bench_ring(rtos_bench_worker_t *worker, int ops, int complete)
+{
+    uint32_t *bufs = ring_bufs[worker - bench.workers];
+    uint32_t ticks = 0;
+    uint32_t mask;
+    uint32_t t;
+    int length;
+    int i;
+
+    soc_dma_ring_buf_init(&worker->ring,
+            &ring_desc[(worker - bench.workers) * RTOS_BENCH_RING_DESC_WORDS],
+            RTOS_BENCH_RING_DESC_COUNT);
+
+    mask = rtos_interrupt_mask_all();
+    while (ops > 0) {
+        t = get_reference_time();
+        for (i = 0; i < RTOS_BENCH_RING_DESC_COUNT; i++) {
+            soc_dma_ring_tx_buf_set(&worker->ring, &bufs[i], sizeof(uint32_t));
+        }
+        if (!complete) {
+            ticks += get_reference_time() - t;
+        }
+
+        for (i = 0; i < RTOS_BENCH_RING_DESC_COUNT; i++) {
+            (void) soc_dma_ring_buf_get(&worker->ring, &length, NULL);
+            soc_dma_ring_buf_release(&worker->ring, 0, length);
+        }
+
+        t = get_reference_time();
+        for (i = 0; i < RTOS_BENCH_RING_DESC_COUNT; i++) {
+            (void) soc_dma_ring_tx_buf_get(&worker->ring, NULL, NULL);
+        }
+        if (complete) {
+            ticks += get_reference_time() - t;
+        }
+        ops -= RTOS_BENCH_RING_DESC_COUNT;
+    }
+    rtos_interrupt_mask_set(mask);
+
+    return ticks;
+}
+
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_ring_submit(rtos_bench_worker_t *worker, int ops)
+{
+    return rtos_bench_ring(worker, ops, 0);
+}
+
+static RTOS_BENCH_TEST_ATTR uint32_t rtos_bench_ring_complete(rtos_bench_worker_t *worker, int ops)
+{
+    return rtos_bench_ring(worker, ops, 1);
+}
+
+/*
+ * The IRQ benchmark needs a core to send to other than the sender's
+ * own, as rtos_core_call() just calls the function on the calling core.
+ */
+static const rtos_bench_test_t tests[] = {
+    { "lock",          rtos_bench_lock,          RTOS_BENCH_OPS,        1 },
+    { "irq",           rtos_bench_irq,           RTOS_BENCH_OPS,        2 },
+    { "core_id_get",   rtos_bench_core_id,       RTOS_BENCH_OPS,        1 },
+    { "snprintf",      rtos_bench_snprintf,      RTOS_BENCH_OPS,        1 },
+    { "printf",        rtos_bench_printf,        RTOS_BENCH_PRINTF_OPS, 1 },
+    { "fifo_put",      rtos_bench_fifo_put,      RTOS_BENCH_OPS,        1 },
+    { "fifo_get",      rtos_bench_fifo_get,      RTOS_BENCH_OPS,        1 },
+    { "ring_submit",   rtos_bench_ring_submit,   RTOS_BENCH_OPS,        1 },
+    { "ring_complete", rtos_bench_ring_complete, RTOS_BENCH_OPS,        1 },
+};
+
+/*
+ * Pinned to one core each. Waits to be told to run a test, then spins
+ * until the start time that every core running it was given before
+ * running it, so that they all contend with each other from the start.
+ */
+static void rtos_bench_worker(void *arg)
+{
+    rtos_bench_worker_t *worker = arg;
+
+    worker->core_id = rtos_core_id_get();
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while ((int32_t) (get_reference_time() - bench.start_time) < 0) {
+            ;
+        }
+
+        worker->ticks = bench.test->fn(worker, bench.test->ops);
+
+        xTaskNotifyGive(bench.controller);
+    }
+}
+
+/*
+ * Runs a test on the first cores workers, and writes out the mean
+ * and max time each took per operation.
+ */
+static void rtos_bench_test_run(const rtos_bench_test_t *test, int cores)
+{
+    uint64_t sum = 0;
+    uint32_t max = 0;
+    int i;
+
+    bench.test = test;
+    bench.cores = cores;
+    bench.start_time = get_reference_time() + RTOS_BENCH_START_DELAY_TICKS;
+
+    /*
+     * Worker 0 shares core 0 with this task, and preempts it as soon
+     * as it is notified, so it is notified last.
+     */
+    for (i = cores - 1; i >= 0; i--) {
+        xTaskNotifyGive(bench.workers[i].task);
+    }
+    for (i = 0; i < cores; i++) {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+
+    for (i = 0; i < cores; i++) {
+        uint32_t per_op = (uint32_t) ((uint64_t) bench.workers[i].ticks * 100 / test->ops);
+        sum += per_op;
+        if (per_op > max) {
+            max = per_op;
+        }
+    }
+
+#if RTOS_PRINTF_DEFERRED
+    /* Only one core may drain at a time, so the printf benchmark's lines are left until now */
+    rtos_printf_deferred_drain();
+#endif
+
+    rtos_printf("rtos_bench,%s,%d,%d,%u,%u\n", test->name, cores, test->ops, (uint32_t) (sum / cores), max);
+}
+
+static void rtos_bench(void *arg)
+{
+    int cores;
+    int i;
+
+    (void) arg;
+
+    /* Give each worker the time to find out which core it is on */
+    vTaskDelay(pdMS_TO_TICKS(10));
+
+    rtos_printf("rtos_bench,test,cores,ops,ticks_per_op_x100_mean,ticks_per_op_x100_max\n");
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        for (cores = tests[i].min_cores; cores <= configNUM_CORES; cores++) {
+            rtos_bench_test_run(&tests[i], cores);
+        }
+    }
+
+    rtos_printf("rtos_bench,end\n");
+
+    vTaskDelete(NULL);
+}
+
+void rtos_bench_create( UBaseType_t priority )
+{
+    int i;
+
+    configASSERT(priority < configMAX_PRIORITIES - 1);
+
+    for (i = 0; i < configNUM_CORES; i++) {
+        xTaskCreate(rtos_bench_worker, "bench_worker", portTASK_STACK_DEPTH(rtos_bench_worker),
+                &bench.workers[i], priority + 1, &bench.workers[i].task);
+#if ( configUSE_CORE_AFFINITY == 1 && configNUM_CORES > 1 )
+        vTaskCoreAffinitySet(bench.workers[i].task, 1 << i);
+#endif
+    }
+
+    xTaskCreate(rtos_bench, "rtos_bench", portTASK_STACK_DEPTH(rtos_bench), NULL, priority, &bench.controller);
+#if ( configUSE_CORE_AFFINITY == 1 && configNUM_CORES > 1 )
+    vTaskCoreAffinitySet(bench.controller, 1 << 0);
+#endif
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_BENCH_H_
+#define RTOS_BENCH_H_
+
+/*
+ * Times each of the lib_rtos_support and lib_soc primitives that the
+ * rest of the system is built on, with 1 and then up to configNUM_CORES
+ * RTOS cores all running it at once. Each result is written out with
+ * rtos_printf() as a line of the form:
+ *
+ *   rtos_bench,<test>,<cores>,<ops per core>,<mean ticks per op x100>,<max ticks per op x100>
+ *
+ * where the ticks are of the 100 MHz reference clock, the mean is taken
+ * over the cores and the max is that of the slowest core. The first line
+ * out names the fields, and the last is "rtos_bench,end". Any other line
+ * does not start with "rtos_bench," and may be ignored, so the output of
+ * two releases may be compared with Python/rtos_bench_compare.py.
+ */
+void rtos_bench_create( UBaseType_t priority );
+
+#endif /* RTOS_BENCH_H_ */
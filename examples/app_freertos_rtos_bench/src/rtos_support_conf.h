@@ -0,0 +1,11 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_SUPPORT_CONF_H_
+#define RTOS_SUPPORT_CONF_H_
+
+#include "FreeRTOSConfig.h"
+
+/* Size the per core tables for just the cores FreeRTOS runs on */
+#define RTOS_MAX_CORE_COUNT                 configNUM_CORES
+
+#endif /* RTOS_SUPPORT_CONF_H_ */
@@ -0,0 +1,109 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_ARENA_H_
+#define RTOS_ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtos_support_rtos_config.h"
+#include "rtos_cores.h"
+
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/*
+ * Per-core fixed-block arenas.
+ *
+ * Each RTOS core has its own arena of RTOS_ARENA_BLOCK_COUNT blocks of
+ * RTOS_ARENA_BLOCK_SIZE bytes. rtos_arena_alloc() only ever takes a
+ * block from the calling core's own arena, and neither it nor
+ * rtos_arena_free() takes a lock, so tasks and ISRs on different cores
+ * never contend with each other for them.
+ *
+ * A block may be freed on any core. One freed on a core other than
+ * the one it was allocated on is put on a return list kept by the
+ * freeing core for the owning core. The list is handed to the owner
+ * whenever the owner has taken back the previous one, and the owner
+ * takes back all the lists handed to it the next time its arena is
+ * found empty. A list that could not be handed over yet waits for the
+ * freeing core's next free, or for rtos_arena_flush().
+ *
+ * Set RTOS_ARENA_BLOCK_COUNT to more than 0 to enable the arenas.
+ */
+#ifndef RTOS_ARENA_BLOCK_COUNT
+#define RTOS_ARENA_BLOCK_COUNT 0
+#endif
+
+/* The size of each block in bytes. Must be a multiple of 4. */
+#ifndef RTOS_ARENA_BLOCK_SIZE
+#define RTOS_ARENA_BLOCK_SIZE 1024
+#endif
+
+/*
+ * The number of RTOS cores that are given an arena. The blocks of
+ * RTOS_ARENA_CORE_COUNT * RTOS_ARENA_BLOCK_COUNT are all allocated
+ * statically, so this should be set to the number of cores the RTOS
+ * actually runs on.
+ */
+#ifndef RTOS_ARENA_CORE_COUNT
+#define RTOS_ARENA_CORE_COUNT RTOS_MAX_CORE_COUNT
+#endif
+
+#if (RTOS_ARENA_BLOCK_SIZE & 3) != 0
+#error RTOS_ARENA_BLOCK_SIZE must be a multiple of 4
+#endif
+
+#if RTOS_ARENA_CORE_COUNT > RTOS_MAX_CORE_COUNT
+#error RTOS_ARENA_CORE_COUNT may not be greater than RTOS_MAX_CORE_COUNT
+#endif
+
+#if defined(__cplusplus) || defined(__XC__)
+extern "C" {
+#endif
+
+#if RTOS_ARENA_BLOCK_COUNT > 0
+
+/**
+ * Allocates a block from the calling core's arena. May be called by
+ * tasks and ISRs on any RTOS core.
+ *
+ * \returns the block, of RTOS_ARENA_BLOCK_SIZE bytes, or NULL if none
+ * of the calling core's blocks are free.
+ */
+void *rtos_arena_alloc(void);
+
+/**
+ * Frees a block allocated by rtos_arena_alloc(). May be called by
+ * tasks and ISRs on any RTOS core, not only the one that allocated it.
+ *
+ * \param block  The block.
+ */
+void rtos_arena_free(void *block);
+
+/**
+ * Hands any blocks freed on the calling core that belong to other cores
+ * back to them, where they have taken back the previous ones. May be run
+ * on every core with rtos_core_call_all(), for example from an idle task
+ * or when an arena runs out.
+ */
+void rtos_arena_flush(void);
+
+/**
+ * Checks whether a buffer is a block from one of the arenas, for
+ * code that takes buffers from both the arenas and a heap.
+ *
+ * \param ptr  The buffer.
+ *
+ * \returns non-zero if ptr is an arena block.
+ */
+int rtos_arena_owns(const void *ptr);
+
+#endif /* RTOS_ARENA_BLOCK_COUNT > 0 */
+
+#if defined(__cplusplus) || defined(__XC__)
+}
+#endif
+
+#endif /* RTOS_ARENA_H_ */
@@ -0,0 +1,113 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_BH_H_
+#define RTOS_BH_H_
+
+#include <stdint.h>
+
+#include "rtos_support_rtos_config.h"
+#include "rtos_cores.h"
+
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/*
+ * When set to 1, an ISR may leave the bulk of its work to a bottom half
+ * with rtos_bh_queue(). This only stores the work's function, argument
+ * and a data word into a ring belonging to the calling RTOS core, with
+ * interrupts masked for just those few stores, and returns. The work is
+ * run later, with interrupts enabled, by rtos_bh_run(), which the RTOS
+ * application should call from a high priority worker task.
+ *
+ * rtos_bh_queue() only asks for the worker to be woken when the work
+ * it queues is the only work in its ring, so any further work queued
+ * by later IRQs before the worker gets to run is run in the same batch.
+ */
+#ifndef RTOS_BH_ENABLE
+#define RTOS_BH_ENABLE 0
+#endif
+
+/* The number of work items each RTOS core's ring holds. Must be a power of two. */
+#ifndef RTOS_BH_QUEUE_LENGTH
+#define RTOS_BH_QUEUE_LENGTH 16
+#endif
+
+#if (RTOS_BH_QUEUE_LENGTH & (RTOS_BH_QUEUE_LENGTH - 1)) != 0
+#error RTOS_BH_QUEUE_LENGTH must be a power of two
+#endif
+
+/**
+ * The type of function queued by rtos_bh_queue(). It must
+ * be defined with RTOS_BH_FN_ATTR.
+ *
+ * \param arg   The argument given to rtos_bh_queue().
+ * \param data  The data word given to rtos_bh_queue().
+ */
+typedef void (*rtos_bh_fn_t)(void *arg, uint32_t data);
+
+#define RTOS_BH_FN_ATTR __attribute__((fptrgroup("rtos_bh_fn")))
+
+/**
+ * The bottom half counts for one RTOS core. Each only ever increases,
+ * and wraps.
+ */
+typedef struct {
+    uint32_t queued;    /* Work queued by the core's ISRs */
+    uint32_t run;       /* Work of the core's run by rtos_bh_run() */
+    uint32_t dropped;   /* Work that did not fit in the core's ring */
+    uint32_t batches;   /* Calls of rtos_bh_run() that found work queued by the core */
+} rtos_bh_stats_t;
+
+/* Returned by rtos_bh_queue() */
+#define RTOS_BH_QUEUED      0
+#define RTOS_BH_QUEUED_WAKE 1
+#define RTOS_BH_FULL        (-1)
+
+#if __XC__
+extern "C" {
+#endif //__XC__
+
+#if RTOS_BH_ENABLE
+
+/**
+ * Queues work to be run by rtos_bh_run(). Should be called from an
+ * ISR, but may be called from any RTOS core.
+ *
+ * \param fn    The function to run.
+ * \param arg   The argument to pass to the function.
+ * \param data  A data word to pass to the function.
+ *
+ * \returns RTOS_BH_QUEUED_WAKE if the work has been queued and the worker
+ * that calls rtos_bh_run() must be woken, RTOS_BH_QUEUED if it has been
+ * queued and the worker is already due to run, or RTOS_BH_FULL if the
+ * calling core's ring is full, in which case the caller must do the work
+ * itself or lose it.
+ */
+int rtos_bh_queue(rtos_bh_fn_t fn, void *arg, uint32_t data);
+
+/**
+ * Runs the work queued by every RTOS core, in the order each core
+ * queued it, including any queued while it runs. Must only be called
+ * by one task.
+ *
+ * \returns the number of work items run.
+ */
+int rtos_bh_run(void);
+
+/**
+ * Gets the bottom half counts for an RTOS core. May be called from
+ * any core.
+ *
+ * \param core_id  The RTOS core.
+ * \param stats    Filled in with its counts.
+ */
+void rtos_bh_stats_get(int core_id, rtos_bh_stats_t *stats);
+
+#endif /* RTOS_BH_ENABLE */
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* RTOS_BH_H_ */
@@ -5,8 +5,26 @@
 
 #include "xcore_c.h"
 
-/* The maximum number of cores an SMP RTOS may use */
-#define RTOS_MAX_CORE_COUNT 8
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/* The number of logical cores on a tile */
+#define RTOS_LOGICAL_CORE_COUNT 8
+
+/*
+ * The maximum number of cores an SMP RTOS may use. The per core
+ * tables throughout this library are sized by it, some of them by
+ * its square, so an RTOS that never runs on all of a tile's cores
+ * should set it to the number it does run on.
+ */
+#ifndef RTOS_MAX_CORE_COUNT
+#define RTOS_MAX_CORE_COUNT RTOS_LOGICAL_CORE_COUNT
+#endif
+
+#if RTOS_MAX_CORE_COUNT < 1 || RTOS_MAX_CORE_COUNT > RTOS_LOGICAL_CORE_COUNT
+#error RTOS_MAX_CORE_COUNT must be between 1 and RTOS_LOGICAL_CORE_COUNT
+#endif
 
 #if __XC__
 extern "C" {
@@ -52,4 +70,25 @@ int rtos_core_count(void);
 }
 #endif //__XC__
 
+#ifndef __XC__
+
+/**
+ * Inline version of rtos_core_id_get() for use on hot paths
+ * such as ISRs. It is a single read of the logical core ID
+ * followed by a single load from the core map.
+ *
+ * rtos_core_register() must have been previously
+ * called on the calling core.
+ *
+ * \returns the ID of the calling core.
+ */
+inline int rtos_core_id_get_inline(void)
+{
+    extern int rtos_core_map[RTOS_LOGICAL_CORE_COUNT];
+
+    return rtos_core_map[get_logical_core_id()];
+}
+
+#endif // __XC__
+
 #endif /* RTOS_CORES_H_ */
@@ -0,0 +1,104 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_CPU_STATS_H_
+#define RTOS_CPU_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtos_support_rtos_config.h"
+#include "rtos_cores.h"
+
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/*
+ * When set to 1, the time each RTOS core spends in idle tasks, in other
+ * tasks, in rtos_irq_handler(), and in the intercore yield it makes, is
+ * counted with the reference timer. rtos_cpu_stats_get() returns the
+ * counts for every core as one binary record that may be polled often
+ * without any formatting.
+ *
+ * The RTOS must call rtos_cpu_stats_task_switched() each time it
+ * switches a task in. The time spent in intercore yields is not also
+ * counted as ISR time.
+ */
+#ifndef RTOS_CPU_STATS
+#define RTOS_CPU_STATS 0
+#endif
+
+/* The categories that a core's time is divided into */
+#define RTOS_CPU_STATS_IDLE     0
+#define RTOS_CPU_STATS_TASK     1
+#define RTOS_CPU_STATS_ISR      2
+#define RTOS_CPU_STATS_YIELD    3
+#define RTOS_CPU_STATS_CATEGORY_COUNT 4
+
+/**
+ * The time one core has spent in each category, in reference clock
+ * ticks. The counts wrap, so should be polled at least once every 42
+ * seconds, and the difference between two polls taken.
+ */
+typedef struct {
+    uint32_t ticks[RTOS_CPU_STATS_CATEGORY_COUNT];
+} rtos_cpu_stats_core_t;
+
+/**
+ * The record returned by rtos_cpu_stats_get(). Only the first
+ * core_count entries of core are filled in.
+ */
+typedef struct {
+    uint32_t time;          /* The reference clock time the record was taken at */
+    uint32_t core_count;    /* The number of RTOS cores */
+    rtos_cpu_stats_core_t core[RTOS_MAX_CORE_COUNT];
+} rtos_cpu_stats_t;
+
+#if __XC__
+extern "C" {
+#endif //__XC__
+
+#if RTOS_CPU_STATS
+
+/**
+ * Gets the time spent in each category by every RTOS core. May be
+ * called from any core.
+ *
+ * \param stats  Filled in with the record.
+ *
+ * \returns the number of bytes of the record that were filled in.
+ */
+size_t rtos_cpu_stats_get(rtos_cpu_stats_t *stats);
+
+/**
+ * Must be called by the RTOS on the core switching a task in,
+ * with interrupts masked.
+ *
+ * \param idle  Non-zero if the task is an idle task.
+ */
+void rtos_cpu_stats_task_switched(int idle);
+
+/**
+ * Starts counting the calling core's time against category, which
+ * is RTOS_CPU_STATS_ISR or RTOS_CPU_STATS_YIELD. Called by the IRQ
+ * handler.
+ */
+void rtos_cpu_stats_enter(int core_id, int category);
+
+/**
+ * Goes back to counting the calling core's time against the task
+ * it is running. Called by the IRQ handler as it returns.
+ */
+void rtos_cpu_stats_exit(int core_id);
+
+#else
+#define rtos_cpu_stats_task_switched(idle)
+#define rtos_cpu_stats_enter(core_id, category)
+#define rtos_cpu_stats_exit(core_id)
+#endif /* RTOS_CPU_STATS */
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* RTOS_CPU_STATS_H_ */
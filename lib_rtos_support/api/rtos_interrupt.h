@@ -29,7 +29,10 @@
  *  allows a kernel stack to be no larger than that required by its greediest member.
  *
  *  **The kernel stack is not re-entrant so kernel mode must not be masked
- *  from within an interrupt_callback_t**
+ *  from within an interrupt_callback_t**, other than by the RTOS IRQ handler
+ *  when RTOS_IRQ_NESTING is set. It then gives each nested handler its own
+ *  partition of the kernel stack, and the kernel stack is made large enough
+ *  for one partition per RTOS IRQ priority level.
  *
  *  The user may specify a larger kernel stack by defining XCORE_C_KSTACK_WORDS.
  *
@@ -88,7 +91,8 @@
  *      The interrupt_callback_t function name is accessed using the RTOS_INTERRUPT_CALLBACK() macro
  *
  *  **The kernel stack is not re-entrant so kernel mode must not be masked
- *  from within an interrupt_callback_t**
+ *  from within an interrupt_callback_t**, other than as described for
+ *  DEFINE_RTOS_INTERRUPT_PERMITTED.
  *
  *  Example usage: \code
  *    DEFINE_RTOS_INTERRUPT_CALLBACK(myfunc, arg)
@@ -221,4 +225,24 @@ inline uint32_t rtos_isr_running(void)
     return kernel_mode;
 }
 
+/*
+ * This function gets the calling core's kernel stack pointer.
+ *
+ * \returns the address of the word at the top of the kernel stack.
+ */
+inline uint32_t rtos_kstack_pointer_get(void)
+{
+    uint32_t ksp;
+
+    asm volatile(
+        "get r11, ksp\n"
+        "mov %0, r11"
+        : "=r"(ksp)
+        : /* no inputs */
+        : /* clobbers */ "r11"
+    );
+
+    return ksp;
+}
+
 #endif /* RTOS_INTERRUPT_H_ */
@@ -4,6 +4,145 @@
 #define RTOS_IRQ_H_
 
 #include "xcore_c.h"
+#include "rtos_cores.h"
+
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/*
+ * When set to 1, the per core IRQ pending flags are kept as one
+ * single-writer flag per IRQ source rather than as a single word
+ * protected by the IRQ domain lock. Raising an IRQ that is already
+ * pending, and draining the pending flags in the IRQ handler, then
+ * never take a lock. A lock is only taken by rtos_irq() when the
+ * target core has no IRQ token outstanding, to decide which source
+ * sends it.
+ */
+#ifndef RTOS_IRQ_LOCKLESS_PENDING
+#define RTOS_IRQ_LOCKLESS_PENDING 0
+#endif
+
+/*
+ * When set to 1, the latency between each call to rtos_irq()
+ * and the dispatch of the IRQ on the target core is recorded
+ * per IRQ source, and may be read with rtos_irq_stats_get().
+ */
+#ifndef RTOS_IRQ_STATS
+#define RTOS_IRQ_STATS 0
+#endif
+
+/*
+ * When set to 1, an xSCOPE integer probe is output each time an IRQ
+ * is sent with rtos_irq() or rtos_irq_batch(), and each time an IRQ
+ * source is dispatched by the IRQ handler. The value output is the
+ * target RTOS core ID in bits 16 and up, and the source ID in bits
+ * 15..0. The probes must be in the application's config.xscope.
+ */
+#ifndef RTOS_IRQ_XSCOPE_PROBES
+#define RTOS_IRQ_XSCOPE_PROBES 0
+#endif
+
+/* The ID of the probe for IRQs sent, generated from config.xscope */
+#ifndef RTOS_IRQ_SEND_PROBE_ID
+#define RTOS_IRQ_SEND_PROBE_ID RTOS_IRQ_SEND
+#endif
+
+/* The ID of the probe for IRQs dispatched, generated from config.xscope */
+#ifndef RTOS_IRQ_DISPATCH_PROBE_ID
+#define RTOS_IRQ_DISPATCH_PROBE_ID RTOS_IRQ_DISPATCH
+#endif
+
+/*
+ * When set to 1, the IRQs that RTOS cores send each other carry a
+ * type. An IRQ sent by rtos_irq() from one RTOS core to another is
+ * a RTOS_IPI_RESCHEDULE, as before, and enters the scheduler on the
+ * target core. One sent by rtos_core_call() is a RTOS_IPI_CALL, which
+ * only runs a function on the target core. The target then only enters
+ * the scheduler when one of the cores that interrupted it asked it to.
+ * When 0, every IRQ from another RTOS core enters the scheduler, even
+ * one only sent to make a call.
+ */
+#ifndef RTOS_IRQ_IPI
+#define RTOS_IRQ_IPI 0
+#endif
+
+/*
+ * The maximum number of IRQ sources that may be
+ * registered with rtos_irq_register(). May be up to
+ * 1024 - RTOS_MAX_CORE_COUNT. The pending sources are
+ * kept in groups of 32 with a summary word, so the cost
+ * of dispatching grows with the number pending rather
+ * than with this. Each core's per source tables are
+ * sized by it though, so it is best set to the number
+ * of sources that are actually registered.
+ */
+#ifndef RTOS_IRQ_MAX_PERIPHERAL_SOURCES
+#define RTOS_IRQ_MAX_PERIPHERAL_SOURCES 8
+#endif
+
+/*
+ * The number of IRQ priority levels. Peripheral IRQ sources
+ * at a higher level are dispatched before those at a lower
+ * level when several are pending at once.
+ */
+#ifndef RTOS_IRQ_PRIORITY_LEVELS
+#define RTOS_IRQ_PRIORITY_LEVELS 4
+#endif
+
+#define RTOS_IRQ_PRIORITY_LOWEST  0
+#define RTOS_IRQ_PRIORITY_HIGHEST (RTOS_IRQ_PRIORITY_LEVELS - 1)
+
+/*
+ * When set to 1, interrupts are unmasked while a peripheral ISR below
+ * RTOS_IRQ_PRIORITY_HIGHEST runs, so that a source at a higher level
+ * that is raised meanwhile is dispatched straight away by a nested
+ * call of the IRQ handler rather than once the ISR returns. Sources
+ * at the same level or lower, and IPIs from other RTOS cores, are left
+ * for the handler that was interrupted. ISRs at the highest level are
+ * never interrupted.
+ *
+ * The nested handler runs on its own partition of the kernel stack,
+ * below the stack of the ISR it interrupted, and DEFINE_RTOS_INTERRUPT_PERMITTED
+ * makes the kernel stack large enough for one partition per level.
+ *
+ * The RTOS port must define RTOS_SUPPORT_INTERRUPT_NESTING to 1 in
+ * rtos_support_rtos_config.h to say that its rtos_interrupt_callback_common
+ * may be entered from kernel mode. When it is, the port must save and
+ * restore the interrupted ISR's registers, including SPC, SSR, SED and
+ * ET, on the kernel stack rather than in the current task's context,
+ * and leave any context switch until the outermost callback returns.
+ *
+ * An ISR below the highest level must mask interrupts while it holds
+ * a lock that an ISR at a higher level on the same core may take.
+ */
+#ifndef RTOS_IRQ_NESTING
+#define RTOS_IRQ_NESTING 0
+#endif
+
+/*
+ * When set to 1, rtos_irq_enable() also allocates a hardware timer for
+ * each RTOS core, and rtos_irq_sleep() may be used to idle a core
+ * without a tick. Every IRQ a core may be woken by, whether it is a
+ * peripheral's, such as the DMA completion IRQs sent by lib_soc's
+ * peripheral hub, or an IPI from another RTOS core, arrives on the
+ * core's IRQ channel end, so the core need only wait on that and on
+ * the timer set for its next timeout.
+ */
+#ifndef RTOS_IRQ_SLEEP
+#define RTOS_IRQ_SLEEP 0
+#endif
+
+/*
+ * The total number of IRQ source IDs. IDs below RTOS_MAX_CORE_COUNT
+ * belong to RTOS cores, the rest are returned by rtos_irq_register().
+ */
+#define RTOS_IRQ_SOURCE_ID_COUNT (RTOS_MAX_CORE_COUNT + RTOS_IRQ_MAX_PERIPHERAL_SOURCES)
+
+/*
+ * The number of 32-bit words required to hold one bit per IRQ source ID.
+ */
+#define RTOS_IRQ_SOURCE_WORD_COUNT ((RTOS_IRQ_SOURCE_ID_COUNT + 31) / 32)
 
 /**
  * IRQ ISR callback function pointer type.
@@ -38,6 +177,42 @@ typedef void (*rtos_irq_isr_t)( void *param );
 void rtos_irq(int core_id, int source_id);
 
 
+/**
+ * A set of IRQs to be sent together by rtos_irq_batch().
+ * Must be emptied with rtos_irq_batch_init() before first use.
+ */
+typedef struct {
+    uint32_t core_mask;
+    uint32_t sources[RTOS_MAX_CORE_COUNT][RTOS_IRQ_SOURCE_WORD_COUNT];
+} rtos_irq_batch_t;
+
+/**
+ * This function empties an IRQ batch.
+ *
+ * \param batch          The IRQ batch.
+ */
+void rtos_irq_batch_init(rtos_irq_batch_t *batch);
+
+/**
+ * This function adds an IRQ to a batch. It is not sent until the batch
+ * is passed to rtos_irq_batch().
+ *
+ * \param batch          The IRQ batch.
+ * \param core_id        The core ID of the RTOS core to interrupt.
+ * \param source_id      The ID of source of the IRQ, as for rtos_irq().
+ */
+void rtos_irq_batch_add(rtos_irq_batch_t *batch, int core_id, int source_id);
+
+/**
+ * This function sends all of the IRQs in a batch, and then empties it.
+ * This is equivalent to calling rtos_irq() for each of them, but the
+ * pending flags are all set at once, and at most one channel send is
+ * performed per core interrupted.
+ *
+ * \param batch          The IRQ batch.
+ */
+void rtos_irq_batch(rtos_irq_batch_t *batch);
+
 /**
  * This function sends an IRQ to a peripheral on a non-RTOS core.
  * It must be called by an RTOS core. The non-RTOS core does not
@@ -48,6 +223,18 @@ void rtos_irq(int core_id, int source_id);
  */
 void rtos_irq_peripheral(chanend dest_chanend);
 
+/**
+ * The same as rtos_irq_peripheral(), but a data word is sent to the
+ * peripheral along with the interrupt, for example to say what the
+ * interrupt is for. The peripheral must read the word with
+ * s_chan_in_word() before it checks for the end token.
+ *
+ * \param dest_chanend  The channel end used by the peripheral to receive
+ *                      the interrupt.
+ * \param data          The word to send to the peripheral.
+ */
+void rtos_irq_peripheral_data(chanend dest_chanend, uint32_t data);
+
 /**
  * This function registers a non-RTOS IRQ source. The source ID
  * returned must be passed to the non-RTOS peripheral that will be
@@ -64,6 +251,47 @@ void rtos_irq_peripheral(chanend dest_chanend);
 
 int rtos_irq_register(rtos_irq_isr_t isr, void *data, chanend source_chanend);
 
+/**
+ * This function sets the priority of a non-RTOS IRQ source. When several
+ * IRQ sources are pending on a core at once, the ISRs of those with a higher
+ * priority are run first. IRQs from other RTOS cores are always handled
+ * before any non-RTOS source. Sources are given RTOS_IRQ_PRIORITY_LOWEST
+ * when they are registered.
+ *
+ * \param source_id      An IRQ source ID returned by rtos_irq_register().
+ * \param priority       The priority, from RTOS_IRQ_PRIORITY_LOWEST to
+ *                       RTOS_IRQ_PRIORITY_HIGHEST.
+ */
+void rtos_irq_priority_set(int source_id, int priority);
+
+/**
+ * This function masks a single non-RTOS IRQ source, so that its ISR is
+ * not called until it is unmasked with rtos_irq_source_unmask(). Other
+ * sources are still dispatched meanwhile. An IRQ that the source sends
+ * while it is masked is held rather than lost, and is dispatched once it
+ * is unmasked. This is cheaper than rtos_interrupt_mask_all() when a
+ * task only needs to keep out one ISR for a while.
+ *
+ * Once this returns, the ISR will not be started again on the calling
+ * core, but an ISR that is already running on another core is not
+ * waited for. Masks are not counted, so a single call to
+ * rtos_irq_source_unmask() unmasks the source however many times it
+ * was masked.
+ *
+ * \param source_id      An IRQ source ID returned by rtos_irq_register().
+ */
+void rtos_irq_source_mask(int source_id);
+
+/**
+ * This function unmasks an IRQ source masked by rtos_irq_source_mask().
+ * If the source sent an IRQ while it was masked, that core is sent an
+ * IRQ from the calling core, which must be an RTOS core, and then
+ * dispatches the source itself.
+ *
+ * \param source_id      An IRQ source ID returned by rtos_irq_register().
+ */
+void rtos_irq_source_unmask(int source_id);
+
 /**
  * This function enables the calling core to receive RTOS IRQs. It
  * should be called once during initialization by each RTOS core
@@ -80,4 +308,145 @@ void rtos_irq_enable(int total_rtos_cores);
  */
 int rtos_irq_ready(void);
 
+#if RTOS_IRQ_SLEEP
+
+/**
+ * The sleep counts for one RTOS core. Each only ever increases,
+ * and wraps.
+ */
+typedef struct {
+    uint32_t sleeps;       /* Calls of rtos_irq_sleep() */
+    uint32_t irq_wakes;    /* Sleeps ended by an IRQ before the deadline */
+    uint64_t ticks;        /* Reference timer ticks spent asleep */
+} rtos_irq_sleep_stats_t;
+
+/**
+ * Pauses the calling RTOS core until an IRQ is sent to it, or until
+ * the reference time deadline, whichever is first. A paused core takes
+ * no pipeline cycles away from the other cores on its tile.
+ *
+ * This must be called with interrupts masked, and returns with them
+ * still masked. An IRQ that is sent to the core before or during the
+ * sleep is left pending, and its ISR runs as soon as the caller unmasks
+ * interrupts. Any other interrupt source the RTOS has set up on the core,
+ * such as its tick timer, cannot wake it.
+ *
+ * It is meant to be called by an RTOS's tickless idle, such as the
+ * FreeRTOS port's portSUPPRESS_TICKS_AND_SLEEP(), once it has found the
+ * time of the next task timeout, stopped its tick and confirmed that no
+ * task has been readied meanwhile. The RTOS must then add the time that
+ * has passed onto its tick count before it unmasks interrupts.
+ *
+ * \param deadline  The reference time to wake at if no IRQ is sent first.
+ *
+ * \returns non-zero if the core was woken by an IRQ, or 0 if it was
+ * woken by the deadline.
+ */
+int rtos_irq_sleep(uint32_t deadline);
+
+/**
+ * Gets the sleep counts for an RTOS core. May be called from
+ * any core.
+ *
+ * \param core_id  The RTOS core.
+ * \param stats    Filled in with its counts.
+ *
+ * \returns 0 if the core ID is in use, or -1 if it is not.
+ */
+int rtos_irq_sleep_stats_get(int core_id, rtos_irq_sleep_stats_t *stats);
+
+#endif /* RTOS_IRQ_SLEEP */
+
+/* The types of IPI that one RTOS core may send another */
+#define RTOS_IPI_RESCHEDULE 0
+#define RTOS_IPI_CALL       1
+#define RTOS_IPI_TYPE_COUNT 2
+
+/**
+ * The type of function run on an RTOS core by rtos_core_call().
+ * It is run from the target core's IRQ handler, so must be
+ * as short as an ISR, and defined with RTOS_CORE_CALL_FN_ATTR.
+ *
+ * \param arg      The argument given to rtos_core_call().
+ * \param core_id  The RTOS core it is running on.
+ */
+typedef void (*rtos_core_call_fn_t)( void *arg, int core_id );
+
+#define RTOS_CORE_CALL_FN_ATTR __attribute__((fptrgroup("rtos_core_call_fn")))
+
+/**
+ * Runs a function on an RTOS core, from its IRQ handler. This lets
+ * per-core work, such as draining a per-core cache or reading per-core
+ * counters, be done from any RTOS core without a task pinned to each
+ * core. Must be called by an RTOS core, with interrupts enabled. Each
+ * core may have one call outstanding to each other core. If the previous
+ * one has not yet been run, this waits for it first. When core_id is
+ * the calling core, the function is simply called.
+ *
+ * \param core_id  The RTOS core to run the function on.
+ * \param fn       The function.
+ * \param arg      The argument to pass to the function.
+ * \param wait     When non-zero, this does not return until the
+ *                 function has returned on the target core.
+ */
+void rtos_core_call(int core_id, rtos_core_call_fn_t fn, void *arg, int wait);
+
+/**
+ * Runs a function on every RTOS core, including the calling one, as
+ * rtos_core_call() does. The calls to the other cores are all made
+ * before the function is run on the calling core, so they run at the
+ * same time.
+ *
+ * \param fn       The function.
+ * \param arg      The argument to pass to the function.
+ * \param wait     When non-zero, this does not return until the
+ *                 function has returned on every core.
+ */
+void rtos_core_call_all(rtos_core_call_fn_t fn, void *arg, int wait);
+
+/**
+ * Gets the number of IPIs of a type that have been handled
+ * by all of the RTOS cores. Reschedules are only counted
+ * when RTOS_IRQ_IPI is set.
+ *
+ * \param type  One of the RTOS_IPI_* types.
+ *
+ * \returns the count.
+ */
+uint32_t rtos_ipi_count_get(int type);
+
+#if RTOS_IRQ_STATS
+
+/**
+ * IRQ statistics for a single IRQ source, accumulated over all
+ * of the cores it has interrupted. All times are in 100 MHz
+ * reference timer ticks.
+ */
+typedef struct {
+    uint32_t count;              /* The number of times the source's IRQ has been dispatched */
+    uint32_t coalesced;          /* The number of IRQs raised while the source's IRQ was already pending */
+    uint32_t last_send_time;     /* The time of the most recent rtos_irq() call that set the source pending */
+    uint32_t last_dispatch_time; /* The time the source's IRQ was most recently dispatched */
+    uint32_t latency_min;
+    uint32_t latency_max;
+    uint64_t latency_total;      /* Divide by count for the average latency */
+} rtos_irq_stats_t;
+
+/**
+ * Gets the IRQ statistics for an IRQ source.
+ *
+ * \param source_id  The IRQ source ID, between 0 and RTOS_IRQ_SOURCE_ID_COUNT - 1.
+ * \param stats      Filled in with the statistics for the source.
+ *
+ * \returns 0 if the source ID is in use, or -1 if it is not.
+ */
+int rtos_irq_stats_get(int source_id, rtos_irq_stats_t *stats);
+
+/**
+ * Clears the IRQ statistics for all sources.
+ */
+void rtos_irq_stats_reset(void);
+
+#endif /* RTOS_IRQ_STATS */
+
 #endif /* RTOS_IRQ_H_ */
@@ -25,17 +25,139 @@
 #error XCORE does not support more than 4 hardware locks
 #endif
 
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/*
+ * The number of additional hardware locks, on top of the
+ * RTOS_LOCK_COUNT locks used by the RTOS, to allocate for
+ * the lock domains. When 0, all lock domains use lock 0.
+ * This is reduced if there are not enough hardware locks
+ * available, in which case the lock domains are spread
+ * across the locks that are.
+ */
+#ifndef RTOS_LOCK_DOMAIN_LOCK_COUNT
+#define RTOS_LOCK_DOMAIN_LOCK_COUNT 0
+#endif
+
+#if RTOS_LOCK_COUNT + RTOS_LOCK_DOMAIN_LOCK_COUNT > 4
+#undef RTOS_LOCK_DOMAIN_LOCK_COUNT
+#define RTOS_LOCK_DOMAIN_LOCK_COUNT (4 - RTOS_LOCK_COUNT)
+#endif
+
+/* The total number of hardware locks allocated by rtos_locks_initialize() */
+#define RTOS_LOCK_TOTAL_COUNT (RTOS_LOCK_COUNT + RTOS_LOCK_DOMAIN_LOCK_COUNT)
+
+/*
+ * When enabled, rtos_lock_acquire() and rtos_lock_release() record
+ * how often each lock is acquired, how long cores wait for it, how
+ * long it is held for and by which core. See rtos_lock_profile_get().
+ */
+#ifndef RTOS_LOCKS_PROFILE
+#define RTOS_LOCKS_PROFILE 0
+#endif
+
+/*
+ * When enabled, rtos_lock_domain_acquire() and rtos_lock_domain_release()
+ * use rtos_lock_acquire_fast() and rtos_lock_release_fast(). Only enable
+ * this if no lock domain is used before rtos_locks_initialize() is called.
+ */
+#ifndef RTOS_LOCKS_FAST_DOMAINS
+#define RTOS_LOCKS_FAST_DOMAINS 0
+#endif
+
+/*
+ * Lock domains. Each of these protects an unrelated set
+ * of data, so they may use separate hardware locks.
+ */
+#define RTOS_LOCK_DOMAIN_IRQ                0
+#define RTOS_LOCK_DOMAIN_CORES              1
+#define RTOS_LOCK_DOMAIN_BUF_POOL           2
+#define RTOS_LOCK_DOMAIN_CONTROL            3
+#define RTOS_LOCK_DOMAIN_PRINTF             4
+#define RTOS_LOCK_DOMAIN_DMA_RING           5
+#define RTOS_LOCK_DOMAIN_PERIPHERAL_BASE    6
+#define RTOS_LOCK_DOMAIN_PERIPHERAL(n)      (RTOS_LOCK_DOMAIN_PERIPHERAL_BASE + (n))
+
 void rtos_locks_initialize(void);
 
+#if RTOS_LOCKS_PROFILE
+/**
+ * Contention profile of a single lock. All times are in
+ * reference clock ticks. Only the outermost acquisition
+ * of a recursively acquired lock is counted.
+ */
+typedef struct {
+    uint32_t acquire_count;     /* The number of times the lock was acquired */
+    uint32_t wait_ticks_max;    /* The longest time spent waiting to acquire the lock */
+    uint64_t wait_ticks_total;  /* The total time spent waiting to acquire the lock */
+    uint32_t hold_ticks_max;    /* The longest time the lock was held for */
+    int hold_max_core;          /* The logical core that held the lock for hold_ticks_max */
+    int owner;                  /* The logical core currently holding the lock, or -1 */
+    uint32_t hold_start;        /* The time the current owner acquired the lock */
+} rtos_lock_profile_t;
+
+/**
+ * Gets the contention profile of a lock.
+ *
+ * \param lock_id  The ID of the lock.
+ * \param profile  Filled in with the lock's profile.
+ */
+void rtos_lock_profile_get(int lock_id, rtos_lock_profile_t *profile);
+
+/**
+ * Clears the contention profiles of all locks.
+ */
+void rtos_lock_profile_reset(void);
+
+inline void rtos_lock_profile_acquired(int lock_id, uint32_t wait_start)
+{
+    extern rtos_lock_profile_t rtos_lock_profiles[RTOS_LOCK_TOTAL_COUNT];
+    rtos_lock_profile_t *profile = &rtos_lock_profiles[lock_id];
+    uint32_t now = get_reference_time();
+    uint32_t wait = now - wait_start;
+
+    profile->acquire_count++;
+    profile->wait_ticks_total += wait;
+    if (wait > profile->wait_ticks_max) {
+        profile->wait_ticks_max = wait;
+    }
+    profile->owner = get_logical_core_id();
+    profile->hold_start = now;
+}
+
+inline void rtos_lock_profile_releasing(int lock_id)
+{
+    extern rtos_lock_profile_t rtos_lock_profiles[RTOS_LOCK_TOTAL_COUNT];
+    rtos_lock_profile_t *profile = &rtos_lock_profiles[lock_id];
+    uint32_t hold = get_reference_time() - profile->hold_start;
+
+    if (hold > profile->hold_ticks_max) {
+        profile->hold_ticks_max = hold;
+        profile->hold_max_core = profile->owner;
+    }
+    profile->owner = -1;
+}
+#endif
+
 inline int rtos_lock_acquire(int lock_id)
 {
-    extern lock_t rtos_locks[RTOS_LOCK_COUNT];
-    extern int rtos_lock_counters[RTOS_LOCK_COUNT];
+    extern lock_t rtos_locks[RTOS_LOCK_TOTAL_COUNT];
+    extern int rtos_lock_counters[RTOS_LOCK_TOTAL_COUNT];
 
-    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_COUNT);
+    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_TOTAL_COUNT);
     if (rtos_locks[lock_id] != -1) {
+        #if RTOS_LOCKS_PROFILE
+            uint32_t wait_start = get_reference_time();
+        #endif
         lock_acquire(rtos_locks[lock_id]);
         rtos_lock_counters[lock_id]++;
+        #if RTOS_LOCKS_PROFILE
+            if (rtos_lock_counters[lock_id] == 1) {
+                rtos_lock_profile_acquired(lock_id, wait_start);
+            }
+        #endif
     }
 
     return rtos_lock_counters[lock_id];
@@ -51,18 +173,21 @@ inline int rtos_lock_acquire(int lock_id)
  */
 inline int rtos_lock_release(int lock_id)
 {
-    extern lock_t rtos_locks[RTOS_LOCK_COUNT];
-    extern int rtos_lock_counters[RTOS_LOCK_COUNT];
+    extern lock_t rtos_locks[RTOS_LOCK_TOTAL_COUNT];
+    extern int rtos_lock_counters[RTOS_LOCK_TOTAL_COUNT];
     int counter = 0;
 
-    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_COUNT);
+    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_TOTAL_COUNT);
     if (rtos_locks[lock_id] != -1) {
         #if RTOS_LOCKS_SAFE
             lock_acquire(rtos_locks[lock_id]);
-            xassert(rtos_lock_counters[lock_id] > 0)
+            xassert(rtos_lock_counters[lock_id] > 0);
         #endif
         counter = --rtos_lock_counters[lock_id];
         if (counter == 0) {
+            #if RTOS_LOCKS_PROFILE
+                rtos_lock_profile_releasing(lock_id);
+            #endif
             lock_release(rtos_locks[lock_id]);
         }
     }
@@ -70,6 +195,191 @@ inline int rtos_lock_release(int lock_id)
     return counter;
 }
 
+/**
+ * The same as rtos_lock_acquire(), but without the check of the lock ID
+ * and of whether the locks have been allocated yet. When lock_id is a
+ * constant this is just the hardware lock acquire and the counter update.
+ *
+ * \warning This must not be called before rtos_locks_initialize(),
+ *          and lock_id must be less than RTOS_LOCK_TOTAL_COUNT.
+ */
+inline int rtos_lock_acquire_fast(int lock_id)
+{
+    extern lock_t rtos_locks[RTOS_LOCK_TOTAL_COUNT];
+    extern int rtos_lock_counters[RTOS_LOCK_TOTAL_COUNT];
+    #if RTOS_LOCKS_PROFILE
+        uint32_t wait_start = get_reference_time();
+    #endif
+
+    lock_acquire(rtos_locks[lock_id]);
+    rtos_lock_counters[lock_id]++;
+    #if RTOS_LOCKS_PROFILE
+        if (rtos_lock_counters[lock_id] == 1) {
+            rtos_lock_profile_acquired(lock_id, wait_start);
+        }
+    #endif
+
+    return rtos_lock_counters[lock_id];
+}
+
+/**
+ * The same as rtos_lock_release(), but without the check of the lock ID
+ * and of whether the locks have been allocated yet.
+ *
+ * \warning This must not be called before rtos_locks_initialize(),
+ *          and lock_id must be less than RTOS_LOCK_TOTAL_COUNT.
+ */
+inline int rtos_lock_release_fast(int lock_id)
+{
+    extern lock_t rtos_locks[RTOS_LOCK_TOTAL_COUNT];
+    extern int rtos_lock_counters[RTOS_LOCK_TOTAL_COUNT];
+    int counter;
+
+    #if RTOS_LOCKS_SAFE
+        lock_acquire(rtos_locks[lock_id]);
+        xassert(rtos_lock_counters[lock_id] > 0);
+    #endif
+    counter = --rtos_lock_counters[lock_id];
+    if (counter == 0) {
+        #if RTOS_LOCKS_PROFILE
+            rtos_lock_profile_releasing(lock_id);
+        #endif
+        lock_release(rtos_locks[lock_id]);
+    }
+
+    return counter;
+}
+
+/*
+ * The ID of the hardware lock used by a lock domain, as a constant
+ * expression for use in static initializers.
+ */
+#if RTOS_LOCK_DOMAIN_LOCK_COUNT > 0
+#define RTOS_LOCK_DOMAIN_ID(domain) (RTOS_LOCK_COUNT + ((domain) % RTOS_LOCK_DOMAIN_LOCK_COUNT))
+#else
+#define RTOS_LOCK_DOMAIN_ID(domain) (0)
+#endif
+
+/**
+ * Returns the ID of the hardware lock used by a lock domain.
+ *
+ * \param domain  One of the RTOS_LOCK_DOMAIN_* values.
+ *
+ * \returns the lock ID that may be passed to rtos_lock_acquire().
+ */
+inline int rtos_lock_domain_id(int domain)
+{
+    xassert(domain >= 0);
+    return RTOS_LOCK_DOMAIN_ID(domain);
+}
+
+/**
+ * Acquires the lock used by a lock domain.
+ *
+ * \warning Several domains may share a hardware lock, so a core must
+ *          not wait on another core while it holds a domain lock, and
+ *          must not hold two domain locks at once unless they are always
+ *          acquired in the same order.
+ */
+inline int rtos_lock_domain_acquire(int domain)
+{
+#if RTOS_LOCKS_FAST_DOMAINS
+    return rtos_lock_acquire_fast(rtos_lock_domain_id(domain));
+#else
+    return rtos_lock_acquire(rtos_lock_domain_id(domain));
+#endif
+}
+
+/**
+ * Releases the lock used by a lock domain.
+ */
+inline int rtos_lock_domain_release(int domain)
+{
+#if RTOS_LOCKS_FAST_DOMAINS
+    return rtos_lock_release_fast(rtos_lock_domain_id(domain));
+#else
+    return rtos_lock_release(rtos_lock_domain_id(domain));
+#endif
+}
+
+/**
+ * A fair lock. Cores acquire the lock in the order in which
+ * they first try to, so none can be starved under contention.
+ * A hardware lock is only held while taking a ticket.
+ *
+ * These locks are not recursive.
+ */
+typedef struct {
+    volatile uint32_t next_ticket;
+    volatile uint32_t now_serving;
+    int lock_id;
+} rtos_ticket_lock_t;
+
+/**
+ * Initializes a ticket lock.
+ *
+ * \param lock     The ticket lock.
+ * \param lock_id  The ID of the hardware lock used to take tickets,
+ *                 for example one returned by rtos_lock_domain_id().
+ */
+void rtos_ticket_lock_init(rtos_ticket_lock_t *lock, int lock_id);
+
+/**
+ * Acquires a ticket lock, waiting for every core that
+ * tried to acquire it earlier to release it first.
+ */
+void rtos_ticket_lock_acquire(rtos_ticket_lock_t *lock);
+
+/**
+ * Releases a ticket lock held by the calling core.
+ */
+void rtos_ticket_lock_release(rtos_ticket_lock_t *lock);
+
+/**
+ * A reader-writer lock. Any number of cores may hold the lock for
+ * reading at once, or a single core may hold it for writing. Once a
+ * writer is waiting no new readers acquire the lock, so writers are
+ * not starved by a steady stream of readers. A hardware lock is only
+ * held while the lock's state is updated.
+ *
+ * These locks are not recursive.
+ */
+typedef struct {
+    volatile int readers;
+    volatile int writer;
+    int lock_id;
+} rtos_rw_lock_t;
+
+/**
+ * Initializes a reader-writer lock.
+ *
+ * \param lock     The reader-writer lock.
+ * \param lock_id  The ID of the hardware lock used to update the
+ *                 lock's state, for example one returned by
+ *                 rtos_lock_domain_id().
+ */
+void rtos_rw_lock_init(rtos_rw_lock_t *lock, int lock_id);
+
+/**
+ * Acquires a reader-writer lock for reading.
+ */
+void rtos_rw_lock_read_acquire(rtos_rw_lock_t *lock);
+
+/**
+ * Releases a reader-writer lock held for reading by the calling core.
+ */
+void rtos_rw_lock_read_release(rtos_rw_lock_t *lock);
+
+/**
+ * Acquires a reader-writer lock for writing.
+ */
+void rtos_rw_lock_write_acquire(rtos_rw_lock_t *lock);
+
+/**
+ * Releases a reader-writer lock held for writing by the calling core.
+ */
+void rtos_rw_lock_write_release(rtos_rw_lock_t *lock);
+
 #endif // !defined(__XC__)
 
 #endif /* RTOS_LOCKS_H_ */
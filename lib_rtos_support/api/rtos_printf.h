@@ -42,6 +42,66 @@ It also provides sprintf and snprintf functions.
 
 #endif /* RTOS_DEBUG_PRINTF_REMAP */
 
+/*
+ * When enabled, rtos_printf() does not format or write anything itself.
+ * It only copies its format pointer and arguments into a ring buffer
+ * belonging to the calling logical core, with interrupts masked for
+ * just the few stores needed, and returns. The messages are formatted
+ * and written later by rtos_printf_deferred_drain(), which should be
+ * called regularly by a low priority task or by a core that does not
+ * run the RTOS.
+ *
+ * Because formatting is deferred, the format string and any string
+ * passed for a %s must still exist when the message is drained, which
+ * is the case for string literals. Each argument is stored as a single
+ * 32-bit word, and only the first RTOS_PRINTF_DEFERRED_MAX_ARGS are
+ * kept, with any after them printed as 0. When a core's ring is full,
+ * its messages are dropped and the number dropped is printed when it
+ * is next drained.
+ */
+#ifndef RTOS_PRINTF_DEFERRED
+#define RTOS_PRINTF_DEFERRED 0
+#endif
+
+/* The number of messages each logical core's ring buffer holds. Must be a power of two. */
+#ifndef RTOS_PRINTF_DEFERRED_BUF_CNT
+#define RTOS_PRINTF_DEFERRED_BUF_CNT 8
+#endif
+
+/* The most arguments kept for one deferred message */
+#ifndef RTOS_PRINTF_DEFERRED_MAX_ARGS
+#define RTOS_PRINTF_DEFERRED_MAX_ARGS 6
+#endif
+
+/*
+ * When enabled, rtos_printf() formats into a line buffer belonging to
+ * the calling logical core with interrupts enabled. Only writing the
+ * formatted line out is done with interrupts masked, while holding a
+ * lock so that lines from different cores do not interleave. A line
+ * longer than RTOS_PRINTF_LINE_BUFSIZE is written out in pieces, each
+ * of which is whole.
+ *
+ * If the core's line buffer is already in use, because an ISR has
+ * interrupted a print, or a task was preempted in the middle of one,
+ * a smaller buffer on the stack is used instead.
+ */
+#ifndef RTOS_PRINTF_LINE_BUFFERED
+#define RTOS_PRINTF_LINE_BUFFERED 0
+#endif
+
+/* The size of each logical core's line buffer */
+#ifndef RTOS_PRINTF_LINE_BUFSIZE
+#define RTOS_PRINTF_LINE_BUFSIZE 256
+#endif
+
+#if RTOS_PRINTF_DEFERRED && RTOS_PRINTF_LINE_BUFFERED
+#error RTOS_PRINTF_DEFERRED and RTOS_PRINTF_LINE_BUFFERED may not both be enabled
+#endif
+
+#if (RTOS_PRINTF_DEFERRED_BUF_CNT & (RTOS_PRINTF_DEFERRED_BUF_CNT - 1)) != 0
+#error RTOS_PRINTF_DEFERRED_BUF_CNT must be a power of two
+#endif
+
 #ifndef DEBUG_UNIT
 #define DEBUG_UNIT APPLICATION
 #endif
@@ -97,6 +157,15 @@ size_t rtos_sprintf(char *str, const char *fmt, ...);
  */
 size_t rtos_printf(const char *fmt, ...);
 
+/**
+ * Formats and writes out all the messages deferred by rtos_printf()
+ * on every core, when RTOS_PRINTF_DEFERRED is enabled. Only one task
+ * or core may call this at a time.
+ *
+ * \returns the number of messages written.
+ */
+size_t rtos_printf_deferred_drain(void);
+
 #if defined(__cplusplus) || defined(__XC__)
 }
 #endif
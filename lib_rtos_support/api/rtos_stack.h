@@ -0,0 +1,87 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_STACK_H_
+#define RTOS_STACK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtos_support_rtos_config.h"
+#include "rtos_cores.h"
+
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+/*
+ * When set to 1, each RTOS core's kernel stack is filled with
+ * RTOS_STACK_PAINT_WORD by rtos_irq_enable(), and rtos_kstack_stats_get()
+ * finds how much of it has been used since by looking for the deepest
+ * word that has been overwritten. This shows how much of the size that
+ * DEFINE_RTOS_INTERRUPT_PERMITTED works out from the rtos_isr group, or
+ * from XCORE_C_KSTACK_WORDS, is really used.
+ *
+ * Any other stack that is filled with RTOS_STACK_PAINT_WORD before it
+ * is used, such as that of a thread sized with RTOS_THREAD_STACK_SIZE,
+ * may be measured the same way with rtos_stack_unused_words(). An RTOS
+ * usually does this for its own task stacks already.
+ */
+#ifndef RTOS_STACK_PAINT
+#define RTOS_STACK_PAINT 0
+#endif
+
+/* The same as FreeRTOS fills its task stacks with, so that both look alike in a memory dump */
+#define RTOS_STACK_PAINT_WORD 0xA5A5A5A5
+
+/**
+ * The size of one RTOS core's kernel stack, and the most of it that
+ * has been used, in words.
+ */
+typedef struct {
+    uint32_t words;
+    uint32_t used_words;
+} rtos_kstack_stats_t;
+
+#if __XC__
+extern "C" {
+#endif //__XC__
+
+/**
+ * Finds how much of a stack filled with RTOS_STACK_PAINT_WORD has
+ * never been written to, by counting the words up from its bottom
+ * that are still painted.
+ *
+ * \param bottom  The lowest word of the stack.
+ * \param words   The size of the stack in words.
+ *
+ * \returns the number of words that have never been used.
+ */
+size_t rtos_stack_unused_words(const uint32_t *bottom, size_t words);
+
+#if RTOS_STACK_PAINT
+
+/**
+ * Fills the calling RTOS core's kernel stack with RTOS_STACK_PAINT_WORD.
+ * Called by rtos_irq_enable(). Interrupts are masked while it runs, so
+ * no ISR is using the kernel stack.
+ */
+void rtos_kstack_paint(void);
+
+/**
+ * Gets the size of an RTOS core's kernel stack and the most of it that
+ * has been used. May be called from any core.
+ *
+ * \param core_id  The RTOS core.
+ * \param stats    Filled in with the sizes.
+ *
+ * \returns 0 if the core has not yet painted its kernel stack, otherwise 1.
+ */
+int rtos_kstack_stats_get(int core_id, rtos_kstack_stats_t *stats);
+
+#endif /* RTOS_STACK_PAINT */
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* RTOS_STACK_H_ */
@@ -7,11 +7,16 @@
 #include "rtos_support_rtos_config.h"
 
 /* Library header files */
+#include "rtos_arena.h"
+#include "rtos_bh.h"
 #include "rtos_cores.h"
+#include "rtos_cpu_stats.h"
 #include "rtos_interrupt.h"
 #include "rtos_locks.h"
 #include "rtos_macros.h"
 #include "rtos_printf.h"
+#include "rtos_stack.h"
+#include "rtos_trace.h"
 
 #ifndef __XC__
 #include "rtos_irq.h"
@@ -0,0 +1,98 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef RTOS_TRACE_H_
+#define RTOS_TRACE_H_
+
+/**
+Tokenized Trace Module
+======================
+
+rtos_trace() is used like rtos_printf(), but nothing is formatted on
+the target. Its format string is placed in the .rtos_trace_fmt section
+of the binary and its address is used as the message's ID. A call only
+stores that ID, a timestamp and the raw arguments into a ring buffer
+belonging to the calling logical core.
+
+rtos_trace_flush() sends the stored messages to the host over the
+xSCOPE probe RTOS_TRACE_XSCOPE_PROBE, which must be added to the
+application's config.xscope. The host script rtos_trace_decode.py
+looks the format strings up in the application's ELF file and prints
+the messages.
+
+It uses the same debug units as rtos_printf(), so a trace is only
+compiled in when printing is enabled for its unit and RTOS_TRACE_ENABLE
+is set.
+
+Every argument must be an integer of no more than 32 bits, and there
+may be no more than RTOS_TRACE_MAX_ARGS. A pointer may be passed for a
+%s, cast to an integer, when it points into the ELF file, such as a
+string literal.
+**/
+
+#include "rtos_support_rtos_config.h"
+
+#ifdef __rtos_support_conf_h_exists__
+#include "rtos_support_conf.h"
+#endif
+
+#include "rtos_printf.h"
+
+#ifndef RTOS_TRACE_ENABLE
+#define RTOS_TRACE_ENABLE 0
+#endif
+
+/* The xSCOPE probe the trace is sent over */
+#ifndef RTOS_TRACE_XSCOPE_PROBE
+#define RTOS_TRACE_XSCOPE_PROBE RTOS_TRACE
+#endif
+
+/* The number of words each logical core's ring buffer holds. Must be a power of two. */
+#ifndef RTOS_TRACE_BUF_WORDS
+#define RTOS_TRACE_BUF_WORDS 256
+#endif
+
+/* The most arguments one message may have */
+#define RTOS_TRACE_MAX_ARGS 6
+
+#if (RTOS_TRACE_BUF_WORDS & (RTOS_TRACE_BUF_WORDS - 1)) != 0
+#error RTOS_TRACE_BUF_WORDS must be a power of two
+#endif
+
+#if defined(__cplusplus) || defined(__XC__)
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Stores a message into the calling core's ring buffer. Used by
+ * rtos_trace(), and not meant to be called directly.
+ */
+void rtos_trace_put(const char *fmt, size_t argc, const uint32_t *argv);
+
+/**
+ * Sends all the messages stored by rtos_trace() on every core to the
+ * host. Only one task or core may call this at a time.
+ *
+ * \returns the number of messages sent.
+ */
+size_t rtos_trace_flush(void);
+
+#if defined(__cplusplus) || defined(__XC__)
+}
+#endif
+
+#if RTOS_TRACE_ENABLE && DEBUG_PRINT_ENABLE0 && !defined(__XC__)
+#define rtos_trace(fmt, ...) \
+    do { \
+        static const char rtos_trace_fmt[] __attribute__((section(".rtos_trace_fmt"))) = fmt; \
+        const uint32_t rtos_trace_argv[] = { 0, ##__VA_ARGS__ }; \
+        _Static_assert(sizeof(rtos_trace_argv) / sizeof(uint32_t) - 1 <= RTOS_TRACE_MAX_ARGS, "too many rtos_trace() arguments"); \
+        rtos_trace_put(rtos_trace_fmt, sizeof(rtos_trace_argv) / sizeof(uint32_t) - 1, &rtos_trace_argv[1]); \
+    } while (0)
+#else
+#define rtos_trace(fmt, ...)
+#endif
+
+#endif /* RTOS_TRACE_H_ */
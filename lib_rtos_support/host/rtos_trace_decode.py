@@ -0,0 +1,197 @@
+# Copyright (c) 2019, XMOS Ltd, All rights reserved
+"""
+Decodes the messages sent by rtos_trace() over xSCOPE.
+
+The format strings are looked up in the ELF file of the tile the
+messages came from. An .xe file holds one ELF file per tile, which
+may be extracted with:
+
+    xobjdump --split app.xe
+
+The messages are either read live from an xSCOPE server, started with
+something like:
+
+    xrun --xscope-port localhost:10101 app.xe
+
+    python rtos_trace_decode.py image_n0c0_2.elf -port 10101
+
+or from a file holding the raw bytes sent over the probe, one message
+after another.
+"""
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import ctypes
+import os
+import re
+import struct
+import sys
+import time
+
+REF_CLOCK_HZ = 100000000
+HEADER_WORDS = 3
+PROBE_NAME = b"rtos_trace"
+
+SHT_NOBITS = 8
+
+FORMAT_SPEC = re.compile(r"%([-0-9.]*)(l?)([%diupxXsc])")
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("elf", help="ELF file of the tile being traced")
+    parser.add_argument("-file", help="File of raw trace messages to decode")
+    parser.add_argument("-host", default="localhost", help="xSCOPE server host")
+    parser.add_argument("-port", help="xSCOPE server port")
+
+    args = parser.parse_args()
+    if (args.file is None) == (args.port is None):
+        parser.error("exactly one of -file and -port must be given")
+
+    return args
+
+
+class Elf(object):
+    """ The loadable sections of a little endian 32-bit ELF file """
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            raise ValueError("%s is not a little endian 32-bit ELF file" % path)
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            sh = struct.unpack_from("<10I", data, shoff + i * shentsize)
+            sh_type, sh_addr, sh_offset, sh_size = sh[1], sh[3], sh[4], sh[5]
+            if sh_type != SHT_NOBITS and sh_addr != 0 and sh_size != 0:
+                self.sections.append((sh_addr, data[sh_offset:sh_offset + sh_size]))
+
+    def string(self, address):
+        """ Returns the string at address, or None if it is not in the file """
+        for base, contents in self.sections:
+            if base <= address < base + len(contents):
+                offset = address - base
+                end = contents.find(b"\0", offset)
+                if end < 0:
+                    end = len(contents)
+                return contents[offset:end].decode("utf-8", "replace")
+        return None
+
+
+def format_message(elf, fmt, args):
+    """ Formats args the way rtos_printf() would format them with fmt """
+    args = list(args)
+
+    def convert(match):
+        flags, _, conv = match.groups()
+        if conv == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        if conv in "di":
+            value = struct.unpack("<i", struct.pack("<I", value))[0]
+            conv = "d"
+        elif conv == "u":
+            conv = "d"
+        elif conv in "pxX":
+            conv = "X"
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        elif conv == "s":
+            s = elf.string(value)
+            value = s if s is not None else "<0x%08X>" % value
+        return ("%" + flags + conv) % value
+
+    return FORMAT_SPEC.sub(convert, fmt)
+
+
+def decode_message(elf, data, out):
+    """ Decodes one message. Returns the number of bytes it took up, or 0 if data is too short """
+    if len(data) < HEADER_WORDS * 4:
+        return 0
+
+    fmt_addr, timestamp, info = struct.unpack_from("<3I", data)
+    core_id = (info >> 8) & 0xFF
+    argc = info & 0xFF
+    length = (HEADER_WORDS + argc) * 4
+    if len(data) < length:
+        return 0
+
+    args = struct.unpack_from("<%dI" % argc, data, HEADER_WORDS * 4)
+
+    if fmt_addr == 0:
+        text = "[%d messages dropped]\n" % args[0]
+    else:
+        fmt = elf.string(fmt_addr)
+        if fmt is None:
+            text = "[unknown format 0x%08X%s]\n" % (fmt_addr, "".join(" 0x%08X" % a for a in args))
+        else:
+            text = format_message(elf, fmt, args)
+
+    out.write("%12.3f core %d: %s" % (timestamp * 1e6 / REF_CLOCK_HZ, core_id, text))
+    if not text.endswith("\n"):
+        out.write("\n")
+    out.flush()
+
+    return length
+
+
+def decode_file(elf, path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    while data:
+        length = decode_message(elf, data, sys.stdout)
+        if length == 0:
+            break
+        data = data[length:]
+
+
+def decode_xscope(elf, host, port):
+    tool_path = os.environ.get("XMOS_TOOL_PATH", "")
+    lib = ctypes.CDLL(os.path.join(tool_path, "lib", "xscope_endpoint.so"))
+
+    probe_id = [None]
+
+    REGISTER_CB = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint,
+                                   ctypes.c_uint, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_uint,
+                                   ctypes.c_char_p)
+    RECORD_CB = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_ulonglong, ctypes.c_uint,
+                                 ctypes.c_ulonglong, ctypes.POINTER(ctypes.c_char))
+
+    def register(id, type, r, g, b, name, unit, data_type, data_name):
+        if name == PROBE_NAME:
+            probe_id[0] = id
+
+    def record(id, timestamp, length, dataval, databytes):
+        if id == probe_id[0]:
+            decode_message(elf, ctypes.string_at(databytes, length), sys.stdout)
+
+    register_cb = REGISTER_CB(register)
+    record_cb = RECORD_CB(record)
+    lib.xscope_ep_set_register_cb(register_cb)
+    lib.xscope_ep_set_record_cb(record_cb)
+
+    if lib.xscope_ep_connect(host.encode(), port.encode()) != 0:
+        raise RuntimeError("Unable to connect to the xSCOPE server at %s:%s" % (host, port))
+
+    while True:
+        time.sleep(1)
+
+
+def main(args):
+    elf = Elf(args.elf)
+
+    if args.file is not None:
+        decode_file(elf, args.file)
+    else:
+        decode_xscope(elf, args.host, args.port)
+
+
+if __name__ == "__main__":
+    main(parse_arguments())
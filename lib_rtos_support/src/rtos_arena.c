@@ -0,0 +1,178 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "rtos_support.h"
+
+#if RTOS_ARENA_BLOCK_COUNT > 0
+
+/* A free block holds the link to the next free block in its first word */
+typedef struct free_block {
+    struct free_block *next;
+} free_block_t;
+
+#define ARENA_BLOCK_WORDS (RTOS_ARENA_BLOCK_SIZE / sizeof(uint32_t))
+#define ARENA_SIZE (RTOS_ARENA_BLOCK_COUNT * RTOS_ARENA_BLOCK_SIZE)
+
+static uint32_t arena_blocks[RTOS_ARENA_CORE_COUNT][RTOS_ARENA_BLOCK_COUNT][ARENA_BLOCK_WORDS];
+
+/*
+ * The state of each core's arena. Everything but handoff is only
+ * accessed by the core the state belongs to, with interrupts masked.
+ *
+ * pending[owner] is this core's list of blocks freed on it that belong
+ * to the core owner. It is passed to the owner through
+ * handoff[owner][this core]. That is only set by this core, and only
+ * when it is NULL, and only cleared by the owner, so no lock is needed.
+ */
+typedef struct {
+    int initialized;
+    free_block_t *free;
+    free_block_t *pending[RTOS_ARENA_CORE_COUNT];
+} arena_t;
+
+static arena_t arenas[RTOS_ARENA_CORE_COUNT];
+
+static free_block_t * volatile handoff[RTOS_ARENA_CORE_COUNT][RTOS_ARENA_CORE_COUNT];
+
+/*
+ * Builds a core's free list the first time the core uses its arena,
+ * so that nothing needs to be set up at boot.
+ */
+static void arena_init(arena_t *arena, int core_id)
+{
+    int i;
+
+    arena->free = NULL;
+    for (i = RTOS_ARENA_BLOCK_COUNT - 1; i >= 0; i--) {
+        free_block_t *block = (free_block_t *) arena_blocks[core_id][i];
+        block->next = arena->free;
+        arena->free = block;
+    }
+    arena->initialized = 1;
+}
+
+/*
+ * Takes back all the blocks that other cores have handed back to core_id.
+ */
+static void arena_reclaim(arena_t *arena, int core_id)
+{
+    int i;
+
+    for (i = 0; i < RTOS_ARENA_CORE_COUNT; i++) {
+        free_block_t *list = handoff[core_id][i];
+
+        if (list != NULL) {
+            free_block_t *tail = list;
+
+            RTOS_MEMORY_BARRIER();
+            while (tail->next != NULL) {
+                tail = tail->next;
+            }
+            tail->next = arena->free;
+            arena->free = list;
+
+            RTOS_MEMORY_BARRIER();
+            handoff[core_id][i] = NULL;
+        }
+    }
+}
+
+/*
+ * Hands this core's list of blocks belonging to owner over to
+ * it, if it has taken the last one.
+ */
+static void arena_handoff(arena_t *arena, int core_id, int owner)
+{
+    if (arena->pending[owner] != NULL && handoff[owner][core_id] == NULL) {
+        RTOS_MEMORY_BARRIER();
+        handoff[owner][core_id] = arena->pending[owner];
+        arena->pending[owner] = NULL;
+    }
+}
+
+void *rtos_arena_alloc(void)
+{
+    uint32_t mask;
+    int core_id;
+    arena_t *arena;
+    free_block_t *block;
+
+    mask = rtos_interrupt_mask_all();
+
+    core_id = rtos_core_id_get_inline();
+    xassert(core_id < RTOS_ARENA_CORE_COUNT);
+    arena = &arenas[core_id];
+
+    if (!arena->initialized) {
+        arena_init(arena, core_id);
+    }
+
+    if (arena->free == NULL) {
+        arena_reclaim(arena, core_id);
+    }
+
+    block = arena->free;
+    if (block != NULL) {
+        arena->free = block->next;
+    }
+
+    rtos_interrupt_mask_set(mask);
+
+    return block;
+}
+
+void rtos_arena_free(void *ptr)
+{
+    free_block_t *block = ptr;
+    uint32_t mask;
+    int core_id;
+    int owner;
+    arena_t *arena;
+
+    xassert(rtos_arena_owns(ptr));
+    owner = ((uint8_t *) ptr - (uint8_t *) arena_blocks) / ARENA_SIZE;
+
+    mask = rtos_interrupt_mask_all();
+
+    core_id = rtos_core_id_get_inline();
+    xassert(core_id < RTOS_ARENA_CORE_COUNT);
+    arena = &arenas[core_id];
+
+    if (owner == core_id) {
+        block->next = arena->free;
+        arena->free = block;
+    } else {
+        block->next = arena->pending[owner];
+        arena->pending[owner] = block;
+        arena_handoff(arena, core_id, owner);
+    }
+
+    rtos_interrupt_mask_set(mask);
+}
+
+void rtos_arena_flush(void)
+{
+    uint32_t mask;
+    int core_id;
+    int owner;
+
+    mask = rtos_interrupt_mask_all();
+
+    core_id = rtos_core_id_get_inline();
+    xassert(core_id < RTOS_ARENA_CORE_COUNT);
+
+    for (owner = 0; owner < RTOS_ARENA_CORE_COUNT; owner++) {
+        arena_handoff(&arenas[core_id], core_id, owner);
+    }
+
+    rtos_interrupt_mask_set(mask);
+}
+
+int rtos_arena_owns(const void *ptr)
+{
+    const uint8_t *p = ptr;
+    const uint8_t *base = (const uint8_t *) arena_blocks;
+
+    return p >= base && p < base + sizeof(arena_blocks) && (p - base) % RTOS_ARENA_BLOCK_SIZE == 0;
+}
+
+#endif /* RTOS_ARENA_BLOCK_COUNT > 0 */
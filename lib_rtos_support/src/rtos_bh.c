@@ -0,0 +1,101 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "rtos_support.h"
+
+#if RTOS_BH_ENABLE
+
+typedef struct {
+    RTOS_BH_FN_ATTR rtos_bh_fn_t fn;
+    void *arg;
+    uint32_t data;
+} bh_work_t;
+
+/*
+ * Each ring is written only by its own RTOS core, and read only by
+ * rtos_bh_run(), so no lock is needed between cores. Interrupts are
+ * masked while work is stored so that an ISR on the same core cannot
+ * store work at the same time.
+ *
+ * The worker must be woken whenever it may have found every ring empty
+ * and gone to sleep. So rtos_bh_queue() checks the tail after it has
+ * moved the head on, and rtos_bh_run() checks the head after it has
+ * moved the tail on. Whichever of them is later sees the other's store,
+ * and so either the worker runs the work, or it is woken to.
+ */
+static struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    uint32_t batches;
+    bh_work_t work[RTOS_BH_QUEUE_LENGTH];
+} bh_ring[RTOS_MAX_CORE_COUNT];
+
+int rtos_bh_queue(rtos_bh_fn_t fn, void *arg, uint32_t data)
+{
+    int core_id;
+    uint32_t mask;
+    uint32_t head;
+    int ret;
+
+    /* Masking first keeps a task that calls this on one core until it returns */
+    mask = rtos_interrupt_mask_all();
+    core_id = rtos_core_id_get();
+    head = bh_ring[core_id].head;
+    if (head - bh_ring[core_id].tail < RTOS_BH_QUEUE_LENGTH) {
+        bh_work_t *work = &bh_ring[core_id].work[head & (RTOS_BH_QUEUE_LENGTH - 1)];
+        work->fn = fn;
+        work->arg = arg;
+        work->data = data;
+        RTOS_MEMORY_BARRIER();
+        bh_ring[core_id].head = ++head;
+        RTOS_MEMORY_BARRIER();
+        ret = head - bh_ring[core_id].tail == 1 ? RTOS_BH_QUEUED_WAKE : RTOS_BH_QUEUED;
+    } else {
+        bh_ring[core_id].dropped++;
+        ret = RTOS_BH_FULL;
+    }
+    rtos_interrupt_mask_set(mask);
+
+    return ret;
+}
+
+int rtos_bh_run(void)
+{
+    int count = 0;
+
+    for (int core_id = 0; core_id < RTOS_MAX_CORE_COUNT; core_id++) {
+        uint32_t tail = bh_ring[core_id].tail;
+
+        if (tail == bh_ring[core_id].head) {
+            continue;
+        }
+
+        bh_ring[core_id].batches++;
+
+        while (tail != bh_ring[core_id].head) {
+            bh_work_t work;
+
+            /* The slot is given back before the work is run, so that it may be reused by a long one */
+            RTOS_MEMORY_BARRIER();
+            work = bh_ring[core_id].work[tail & (RTOS_BH_QUEUE_LENGTH - 1)];
+            RTOS_MEMORY_BARRIER();
+            bh_ring[core_id].tail = ++tail;
+            RTOS_MEMORY_BARRIER();
+
+            work.fn(work.arg, work.data);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void rtos_bh_stats_get(int core_id, rtos_bh_stats_t *stats)
+{
+    stats->run = bh_ring[core_id].tail;
+    stats->batches = bh_ring[core_id].batches;
+    stats->dropped = bh_ring[core_id].dropped;
+    stats->queued = bh_ring[core_id].head;
+}
+
+#endif /* RTOS_BH_ENABLE */
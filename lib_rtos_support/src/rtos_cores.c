@@ -14,7 +14,7 @@
  * Not static so that it can be accessed directly by
  * RTOS functions written in assembly.
  */
-int rtos_core_map[RTOS_MAX_CORE_COUNT] = {0};
+int rtos_core_map[RTOS_LOGICAL_CORE_COUNT] = {0};
 
 /*
  * This is indexed by the RTOS core ID
@@ -45,13 +45,14 @@ int rtos_core_register(void)
 
     core_id = (int) get_logical_core_id();
 
-    rtos_lock_acquire(0);
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_CORES);
     {
+        xassert(rtos_core_init_count < RTOS_MAX_CORE_COUNT);
         rtos_core_map[core_id] = rtos_core_init_count;
         rtos_core_map_reverse[rtos_core_init_count] = core_id;
         core_id = rtos_core_init_count++;
     }
-    rtos_lock_release(0);
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_CORES);
 
     return core_id;
 }
@@ -59,7 +60,7 @@ int rtos_core_register(void)
 /* Note, always returns 0 before the scheduler is started. */
 int rtos_core_id_get(void)
 {
-    return rtos_core_map[get_logical_core_id()];
+    return rtos_core_id_get_inline();
 }
 
 int rtos_logical_core_id_get(int core_id)
@@ -0,0 +1,100 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "rtos_support.h"
+
+#if RTOS_CPU_STATS
+
+/*
+ * Each core's counts are only written by the core itself. seq is
+ * incremented before and after each update, so that a reader on
+ * another core can tell when it has read a count mid update.
+ */
+typedef struct {
+    volatile uint32_t seq;
+    int started;
+    int active;             /* The category now being counted */
+    int task_category;      /* The category of the task now switched in */
+    uint32_t last_time;     /* The time counting against active last started */
+    uint32_t ticks[RTOS_CPU_STATS_CATEGORY_COUNT];
+} cpu_stats_t;
+
+static cpu_stats_t cpu_stats[RTOS_MAX_CORE_COUNT];
+
+/*
+ * Adds the time since the last change onto the active category,
+ * and then makes category active.
+ */
+static void cpu_stats_switch(cpu_stats_t *stats, int category)
+{
+    uint32_t now = get_reference_time();
+
+    stats->seq++;
+    RTOS_MEMORY_BARRIER();
+
+    if (stats->started) {
+        stats->ticks[stats->active] += now - stats->last_time;
+    } else {
+        stats->started = 1;
+    }
+    stats->last_time = now;
+    stats->active = category;
+
+    RTOS_MEMORY_BARRIER();
+    stats->seq++;
+}
+
+void rtos_cpu_stats_task_switched(int idle)
+{
+    cpu_stats_t *stats = &cpu_stats[rtos_core_id_get_inline()];
+
+    stats->task_category = idle ? RTOS_CPU_STATS_IDLE : RTOS_CPU_STATS_TASK;
+
+    /* A switch made from an ISR, such as an intercore yield,
+    takes effect once the ISR returns. */
+    if (stats->active == RTOS_CPU_STATS_IDLE || stats->active == RTOS_CPU_STATS_TASK) {
+        cpu_stats_switch(stats, stats->task_category);
+    }
+}
+
+void rtos_cpu_stats_enter(int core_id, int category)
+{
+    cpu_stats_switch(&cpu_stats[core_id], category);
+}
+
+void rtos_cpu_stats_exit(int core_id)
+{
+    cpu_stats_switch(&cpu_stats[core_id], cpu_stats[core_id].task_category);
+}
+
+size_t rtos_cpu_stats_get(rtos_cpu_stats_t *stats)
+{
+    int core_count = rtos_core_count();
+
+    stats->core_count = core_count;
+
+    for (int core_id = 0; core_id < core_count; core_id++) {
+        cpu_stats_t *core_stats = &cpu_stats[core_id];
+        uint32_t seq;
+
+        do {
+            seq = core_stats->seq;
+            RTOS_MEMORY_BARRIER();
+
+            memcpy(stats->core[core_id].ticks, core_stats->ticks, sizeof(core_stats->ticks));
+            stats->time = get_reference_time();
+
+            /* Include the time counted against the active category so far */
+            if (core_stats->started) {
+                stats->core[core_id].ticks[core_stats->active] += stats->time - core_stats->last_time;
+            }
+
+            RTOS_MEMORY_BARRIER();
+        } while ((seq & 1) != 0 || seq != core_stats->seq);
+    }
+
+    return offsetof(rtos_cpu_stats_t, core) + core_count * sizeof(rtos_cpu_stats_core_t);
+}
+
+#endif /* RTOS_CPU_STATS */
@@ -12,10 +12,41 @@
 #include "xcore_c_interrupt_impl.h"
 #include "rtos_support_rtos_config.h"
 
-#define _DEFINE_RTOS_INTERRUPT_PERMITTED_DEF(root_function) \
+/*
+ * The minimum size of the kernel stack in words. It is made
+ * larger than this if the rtos_isr group requires it.
+ */
+#ifndef XCORE_C_KSTACK_WORDS
+#define XCORE_C_KSTACK_WORDS 0
+#endif
+
+/*
+ * The kernel stack is one partition deep for the interrupt_callback_t
+ * that is entered from a thread, plus one more for each level that
+ * rtos_irq_nested_levels says may interrupt it when RTOS_IRQ_NESTING
+ * is set. rtos_irq_nested_levels is defined by rtos_irq.c. Each of
+ * these partitions must hold the rtos_isr group twice, once for the
+ * ISR that is interrupted and once for the nested callback, along with
+ * the context that the nested callback pushes.
+ */
+#define _RTOS_KSTACK_NESTED_WORDS \
+    (2 * _fptrgroup.rtos_isr.nstackwords + RTOS_SUPPORT_INTERRUPT_STACK_GROWTH + 2)
+
+/*
+ * The size of the kernel stack in words, which may be loaded with ldc
+ * by any asm that first includes _RTOS_KSTACK_SYMBOLS_DEF.
+ */
+#define _RTOS_KSTACK_WORDS \
+    _XCORE_C_STACK_ALIGN(XCORE_C_KSTACK_WORDS $M (_fptrgroup.rtos_isr.nstackwords + rtos_irq_nested_levels * _RTOS_KSTACK_NESTED_WORDS))
+
+#define _RTOS_KSTACK_SYMBOLS_DEF \
     .weak  _fptrgroup.rtos_isr.nstackwords.group; \
     .max_reduce _fptrgroup.rtos_isr.nstackwords, _fptrgroup.rtos_isr.nstackwords.group, 0; \
-    .set _kstack_words, _XCORE_C_STACK_ALIGN(_fptrgroup.rtos_isr.nstackwords); \
+    .weak  rtos_irq_nested_levels;
+
+#define _DEFINE_RTOS_INTERRUPT_PERMITTED_DEF(root_function) \
+    _RTOS_KSTACK_SYMBOLS_DEF \
+    .set _kstack_words, _RTOS_KSTACK_WORDS; \
     .globl _xcore_c_interrupt_permitted_common; \
     .globl _INTERRUPT_PERMITTED(root_function); \
     .align _XCORE_C_CODE_ALIGNMENT; \
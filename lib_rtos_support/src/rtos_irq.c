@@ -1,17 +1,43 @@
 // Copyright (c) 2019, XMOS Ltd, All rights reserved
 
+#include <string.h>
+
 #include "rtos_support.h"
 
+#if RTOS_IRQ_XSCOPE_PROBES
+#include <xscope.h>
+#define irq_probe( probe_id, core_id, source_id ) xscope_int( ( probe_id ), ( ( core_id ) << 16 ) | ( source_id ) )
+#else
+#define irq_probe( probe_id, core_id, source_id )
+#endif
+
 /*
- * Source IDs 0-7 are reserved for RTOS cores
- * Source IDs 8-15 are allowed for other use
- *
- * (Assuming RTOS_MAX_CORE_COUNT == 8)
+ * Source IDs 0 to RTOS_MAX_CORE_COUNT-1 are reserved for RTOS cores
+ * Source IDs RTOS_MAX_CORE_COUNT and up are allowed for other use
  */
 #define RTOS_CORE_SOURCE_MASK ( ( 1 << RTOS_MAX_CORE_COUNT ) - 1)
-#define MAX_ADDITIONAL_SOURCES 8
+#define MAX_ADDITIONAL_SOURCES RTOS_IRQ_MAX_PERIPHERAL_SOURCES
 #define MAX_SOURCE_ID ( RTOS_MAX_CORE_COUNT + MAX_ADDITIONAL_SOURCES - 1 )
 
+/*
+ * The pending sources are kept in groups of 32, one bit per
+ * source, with a summary word that has one bit per group. The
+ * RTOS core sources are always in the first group.
+ */
+#define IRQ_GROUP_SIZE 32
+#define IRQ_GROUP_COUNT ( ( MAX_SOURCE_ID / IRQ_GROUP_SIZE ) + 1 )
+#define IRQ_GROUP( source_id ) ( ( source_id ) / IRQ_GROUP_SIZE )
+#define IRQ_GROUP_BIT( source_id ) ( 1UL << ( ( source_id ) % IRQ_GROUP_SIZE ) )
+
+#if IRQ_GROUP_COUNT > 32
+#error RTOS_IRQ_MAX_PERIPHERAL_SOURCES is too large
+#endif
+
+typedef struct {
+    uint32_t summary;
+    uint32_t group[ IRQ_GROUP_COUNT ];
+} irq_pending_t;
+
 /*
  * The channel ends used by RTOS cores to send and receive IRQs.
  */
@@ -22,10 +48,28 @@ static chanend rtos_irq_chanend[ RTOS_MAX_CORE_COUNT ];
  */
 static chanend peripheral_irq_chanend[ MAX_ADDITIONAL_SOURCES ];
 
+#if RTOS_IRQ_LOCKLESS_PENDING
 /*
- * Flag set per core indicating which IRQ sources are pending
+ * Flag set per core per IRQ source indicating which IRQ sources
+ * are pending. Each flag is only ever set by the one core that
+ * raises that source, and only ever cleared by the IRQ handler
+ * of the core it targets, so no lock is required to update them.
  */
-static volatile uint32_t irq_pending[ RTOS_MAX_CORE_COUNT ];
+static volatile uint8_t irq_source_pending[ RTOS_MAX_CORE_COUNT ][ MAX_SOURCE_ID + 1 ];
+
+/*
+ * Flag set per core while an IRQ token is on its way to, or waiting
+ * in, the core's IRQ channel end. Only set with the IRQ domain lock
+ * held, and cleared by the core's IRQ handler once it has read the
+ * token.
+ */
+static volatile int irq_token_outstanding[ RTOS_MAX_CORE_COUNT ];
+#else
+/*
+ * Flags set per core indicating which IRQ sources are pending
+ */
+static volatile irq_pending_t irq_pending[ RTOS_MAX_CORE_COUNT ];
+#endif
 
 static int peripheral_source_count;
 
@@ -47,159 +91,1437 @@ typedef struct {
 
 static isr_info_t isr_info[MAX_ADDITIONAL_SOURCES];
 
-DEFINE_RTOS_INTERRUPT_CALLBACK( rtos_irq_handler, data )
+/*
+ * The peripheral sources at each priority level.
+ * A source is in exactly one level, other than while
+ * rtos_irq_priority_set() is moving it, when it may
+ * briefly be in two.
+ */
+static uint32_t irq_priority_mask[ RTOS_IRQ_PRIORITY_LEVELS ][ IRQ_GROUP_COUNT ];
+
+/*
+ * The priority level of each peripheral source.
+ */
+static int irq_source_priority[ MAX_ADDITIONAL_SOURCES ];
+
+/*
+ * The peripheral sources masked with rtos_irq_source_mask(), with
+ * a summary word that has one bit per group with any masked.
+ */
+static volatile uint32_t irq_source_masked[ IRQ_GROUP_COUNT ];
+static volatile uint32_t irq_source_masked_summary;
+
+/*
+ * The masked sources that each core's IRQ handler has taken and
+ * not dispatched, with a summary word per core that has one bit per
+ * group with any held. Each core's are only updated by its own IRQ
+ * handler, with the lock held. Once a source is unmasked, the core
+ * is sent an IRQ and its handler dispatches it along with the rest.
+ */
+static uint32_t irq_source_held[ RTOS_MAX_CORE_COUNT ][ IRQ_GROUP_COUNT ];
+static volatile uint32_t irq_source_held_summary[ RTOS_MAX_CORE_COUNT ];
+
+#if RTOS_IRQ_NESTING
+#if !RTOS_SUPPORT_INTERRUPT_NESTING
+#error RTOS_IRQ_NESTING requires an RTOS port that sets RTOS_SUPPORT_INTERRUPT_NESTING
+#endif
+
+/*
+ * Every level but the highest may be interrupted by a nested
+ * IRQ handler, which needs its own kernel stack partition.
+ */
+#define IRQ_NESTED_LEVELS ( RTOS_IRQ_PRIORITY_LEVELS - 1 )
+
+/*
+ * The priority level of the ISR that each core is running with
+ * interrupts unmasked, or -1 when it is not running one. Only
+ * accessed by the core itself with interrupts masked.
+ */
+static int irq_dispatch_level[ RTOS_MAX_CORE_COUNT ];
+
+/*
+ * The sources taken by a nested IRQ handler that it may not dispatch
+ * itself, left for the handler that it interrupted. Only accessed by
+ * the core itself with interrupts masked.
+ */
+static irq_pending_t irq_deferred[ RTOS_MAX_CORE_COUNT ];
+
+#define irq_outermost( core_id ) ( irq_dispatch_level[ core_id ] < 0 )
+#else
+#define IRQ_NESTED_LEVELS 0
+#define irq_outermost( core_id ) 1
+#endif
+
+/*
+ * The number of kernel stack partitions needed beyond the first,
+ * read by DEFINE_RTOS_INTERRUPT_PERMITTED to size the kernel stack.
+ */
+asm( ".globl rtos_irq_nested_levels\n"
+     ".set rtos_irq_nested_levels, " _XCORE_C_STR( IRQ_NESTED_LEVELS ) );
+
+/*
+ * The IPIs pending from each RTOS core to each other, indexed by the
+ * target core and then the sending core. Each type has a sequence
+ * number that is only incremented by the sending core, and one that
+ * is only set by the target core's IRQ handler to the value it has
+ * handled, so no lock is needed. A type is pending while the two
+ * differ. Reschedules are only tracked when RTOS_IRQ_IPI is set.
+ */
+typedef struct {
+    volatile uint32_t reschedule_seq;
+    volatile uint32_t reschedule_taken_seq;
+    volatile uint32_t call_seq;
+    volatile uint32_t call_done_seq;
+    RTOS_CORE_CALL_FN_ATTR rtos_core_call_fn_t call_fn;
+    void *call_arg;
+} ipi_mailbox_t;
+
+static ipi_mailbox_t ipi_mailbox[ RTOS_MAX_CORE_COUNT ][ RTOS_MAX_CORE_COUNT ];
+
+/*
+ * The number of IPIs of each type handled by each core.
+ * Each entry is only written by its own core.
+ */
+static uint32_t ipi_count[ RTOS_MAX_CORE_COUNT ][ RTOS_IPI_TYPE_COUNT ];
+
+#if RTOS_IRQ_SLEEP
+/*
+ * The timer each core sets for the deadline of rtos_irq_sleep(),
+ * and its sleep counts. Each entry is only written by its own core.
+ */
+static hwtimer_t irq_sleep_timer[ RTOS_MAX_CORE_COUNT ];
+static rtos_irq_sleep_stats_t irq_sleep_stats[ RTOS_MAX_CORE_COUNT ];
+
+/* The select event IDs used by rtos_irq_sleep() */
+#define IRQ_SLEEP_EVENT_IRQ      0
+#define IRQ_SLEEP_EVENT_DEADLINE 1
+#endif
+
+#if RTOS_IRQ_STATS
+/*
+ * IRQ statistics, kept per core per source so that each entry has
+ * a single writer. The send time and coalesced count are only written
+ * by the core raising the source, and the rest only by the target
+ * core's IRQ handler.
+ */
+static rtos_irq_stats_t irq_stats[ RTOS_MAX_CORE_COUNT ][ MAX_SOURCE_ID + 1 ];
+
+static void irq_stats_sent( int core_id, int source_id, int coalesced )
 {
-    int core_id;
-    uint32_t pending;
+    if( coalesced )
+    {
+        irq_stats[ core_id ][ source_id ].coalesced++;
+    }
+    else
+    {
+        irq_stats[ core_id ][ source_id ].last_send_time = get_reference_time();
+    }
+}
 
-    core_id = rtos_core_id_get();
+static void irq_stats_dispatched( int core_id, const irq_pending_t *pending )
+{
+    uint32_t now = get_reference_time();
+    uint32_t summary = pending->summary;
 
-    xassert( irq_pending[ core_id ] );
+    while ( summary != 0 )
+    {
+        int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+        uint32_t bits = pending->group[ group ];
 
-    _s_chan_check_ct_end( rtos_irq_chanend[ core_id ] );
+        summary &= ~( 1 << group );
 
-    /* just ensure the channel read is done before clearing the pending flags. */
+        while ( bits != 0 )
+        {
+            int bit = 31UL - ( uint32_t ) __builtin_clz( bits );
+            int source_id = group * IRQ_GROUP_SIZE + bit;
+            rtos_irq_stats_t *stats = &irq_stats[ core_id ][ source_id ];
+            uint32_t latency = now - stats->last_send_time;
+
+            bits &= ~( 1 << bit );
+
+            if( stats->count == 0 || latency < stats->latency_min )
+            {
+                stats->latency_min = latency;
+            }
+            if( latency > stats->latency_max )
+            {
+                stats->latency_max = latency;
+            }
+            stats->latency_total += latency;
+            stats->last_dispatch_time = now;
+            stats->count++;
+        }
+    }
+}
+
+static void irq_stats_sent_group( int core_id, int group, uint32_t bits, uint32_t already_pending )
+{
+    while ( bits != 0 )
+    {
+        int bit = 31UL - ( uint32_t ) __builtin_clz( bits );
+
+        bits &= ~( 1 << bit );
+
+        irq_stats_sent( core_id, group * IRQ_GROUP_SIZE + bit, already_pending & ( 1 << bit ) );
+    }
+}
+#else
+#define irq_stats_sent( core_id, source_id, coalesced )
+#define irq_stats_sent_group( core_id, group, bits, already_pending )
+#define irq_stats_dispatched( core_id, pending )
+#endif
+
+/*
+ * Sends the IRQ token on behalf of source_id to core_id.
+ * The caller must have already ensured that the core does
+ * not have a token outstanding.
+ */
+static void irq_token_send( int core_id, int source_id, int num_cores )
+{
+    chanend source_chanend;
+
+    if( source_id < num_cores )
+    {
+        source_chanend = rtos_irq_chanend[ source_id ];
+    }
+    else if ( source_id >= RTOS_MAX_CORE_COUNT && source_id < RTOS_MAX_CORE_COUNT + peripheral_source_count )
+    {
+        source_chanend = peripheral_irq_chanend[ source_id - RTOS_MAX_CORE_COUNT ];
+    }
+    else
+    {
+        xassert(0);
+        return;
+    }
+
+    /* just ensure the pending flag is set before the channel send. */
     RTOS_MEMORY_BARRIER();
 
-    /* grab a snapshot of the pending flags before clearing them.
-    After the clear, this core may be interrupted again. We will
-    handle all the interrupts at the time the snapshot is taken now,
-    and any more will be handled when this ISR is called again. */
+    chanend_set_dest( source_chanend, rtos_irq_chanend[ core_id ] );
+    _s_chan_out_ct_end( source_chanend );
+}
+
+#if RTOS_IRQ_LOCKLESS_PENDING
+/*
+ * Takes and clears all of the pending source flags for core_id.
+ * There is no summary of the flags that are set, so all of the
+ * sources that are in use must be checked.
+ */
+static void irq_pending_take( int core_id, irq_pending_t *pending )
+{
+    volatile uint8_t *source_pending = irq_source_pending[ core_id ];
+    int source_id;
+    int last_source_id;
+    int num_cores = rtos_core_count();
+
+    last_source_id = RTOS_MAX_CORE_COUNT + peripheral_source_count - 1;
+
+    memset( pending, 0, sizeof( irq_pending_t ) );
 
-    rtos_lock_acquire(0);
+    for ( source_id = 0; source_id <= last_source_id; source_id++ )
     {
-        pending = irq_pending[ core_id ];
-        irq_pending[ core_id ] = 0;
+        if ( source_id == num_cores )
+        {
+            source_id = RTOS_MAX_CORE_COUNT;
+            if ( source_id > last_source_id )
+            {
+                break;
+            }
+        }
+
+        if ( source_pending[ source_id ] )
+        {
+            source_pending[ source_id ] = 0;
+            pending->group[ IRQ_GROUP( source_id ) ] |= IRQ_GROUP_BIT( source_id );
+            pending->summary |= ( 1 << IRQ_GROUP( source_id ) );
+        }
     }
-    rtos_lock_release(0);
+}
+#else
+/*
+ * Takes and clears all of the pending source flags for core_id.
+ * Only the groups that have pending sources are visited.
+ */
+static void irq_pending_take( int core_id, irq_pending_t *pending )
+{
+    uint32_t summary;
 
-    if (pending & RTOS_CORE_SOURCE_MASK )
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
     {
-        /* This core is being yielded by at least one other RTOS core.
-        Clear the pending flags from all of them and enter the scheduler. */
+        summary = irq_pending[ core_id ].summary;
+        pending->summary = summary;
+
+        while ( summary != 0 )
+        {
+            int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+
+            summary &= ~( 1 << group );
 
-        pending &= ~RTOS_CORE_SOURCE_MASK;
+            pending->group[ group ] = irq_pending[ core_id ].group[ group ];
+            irq_pending[ core_id ].group[ group ] = 0;
+        }
 
-        RTOS_INTERCORE_INTERRUPT_ISR();
+        irq_pending[ core_id ].summary = 0;
     }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+}
+#endif
+
+/*
+ * Handles the IPIs pending from the RTOS cores in sources.
+ * Returns non-zero if the scheduler must be entered.
+ */
+static int ipi_dispatch( int core_id, uint32_t sources )
+{
+#if RTOS_IRQ_IPI
+    int reschedule = 0;
+#else
+    int reschedule = 1;
+#endif
 
-    while ( pending != 0 )
+    while( sources != 0 )
     {
-        int source_id = 31UL - ( uint32_t ) __builtin_clz( pending );
+        int source_id = 31UL - ( uint32_t ) __builtin_clz( sources );
+        ipi_mailbox_t *mailbox = &ipi_mailbox[ core_id ][ source_id ];
 
-        xassert( source_id >= RTOS_MAX_CORE_COUNT && source_id <= MAX_SOURCE_ID );
+        sources &= ~( 1 << source_id );
 
-        pending &= ~( 1 << source_id );
+        /* Either may have already been handled along with an earlier IRQ
+        from the same core, in which case there is nothing to do. */
+#if RTOS_IRQ_IPI
+        if( mailbox->reschedule_seq != mailbox->reschedule_taken_seq )
+        {
+            mailbox->reschedule_taken_seq = mailbox->reschedule_seq;
+            ipi_count[ core_id ][ RTOS_IPI_RESCHEDULE ]++;
+            reschedule = 1;
+        }
+#endif
 
-        source_id -= RTOS_MAX_CORE_COUNT;
-        isr_info[ source_id ].isr( isr_info[ source_id ].data );
+        if( mailbox->call_seq != mailbox->call_done_seq )
+        {
+            uint32_t seq = mailbox->call_seq;
+
+            /* just ensure the function and its argument are read after the sequence number. */
+            RTOS_MEMORY_BARRIER();
+            mailbox->call_fn( mailbox->call_arg, core_id );
+            RTOS_MEMORY_BARRIER();
+            mailbox->call_done_seq = seq;
+            ipi_count[ core_id ][ RTOS_IPI_CALL ]++;
+        }
     }
+
+    return reschedule;
 }
 
+#if RTOS_IRQ_NESTING
+asm( _XCORE_C_STR( _RTOS_KSTACK_SYMBOLS_DEF ) );
+
 /*
- * May be called by a non-RTOS core provided
- * xSourceID >= RTOS_MAX_CORE_COUNT.
+ * Sets the kernel stack pointer. KRESTSP is the only way to set it,
+ * and it also loads sp from the word at the new ksp, so sp is stored
+ * there first. That word is put back afterwards, as it may hold the
+ * sp that an interrupted handler restores when it returns.
  */
-void rtos_irq( int core_id, int source_id )
+static inline void irq_ksp_set( uint32_t ksp )
 {
-    chanend source_chanend;
-    uint32_t pending;
-    int num_cores = rtos_core_count();
+    uint32_t word = *( volatile uint32_t * ) ksp;
 
-    xassert( core_id >= 0 && core_id < num_cores );
+    asm volatile(
+        "ldaw r11, sp[0]\n"
+        "set sp, %0\n"
+        "stw r11, sp[0]\n"
+        "krestsp 0"
+        : /* no outputs */
+        : "r"( ksp )
+        : /* clobbers */ "r11", "memory"
+    );
 
-    /*
-     * Atomically set the pending flag and, if the core we are
-     * sending an IRQ does not already have a pending IRQ, interrupt
-     * it with a channel send. This guarantees that if two cores
-     * simultaneously send a core an IRQ that only one will perform
-     * the channel send. Another channel send will not be performed
-     * until the core reads the token from the channel and clears the
-     * pending flags.
-     */
-    rtos_lock_acquire(0);
+    *( volatile uint32_t * ) ksp = word;
+}
+
+/*
+ * Returns the top of the kernel stack partition for a handler that
+ * interrupts an ISR called by the calling function. It leaves room
+ * below the caller's stack for the whole rtos_isr group, which the
+ * ISR is part of, and for the context that the nested callback pushes
+ * onto the ISR's stack before it switches to the kernel stack.
+ */
+static inline uint32_t irq_nested_ksp( void )
+{
+    uint32_t sp;
+    uint32_t words;
+
+    asm volatile(
+        "ldaw %0, sp[0]\n"
+        "ldc %1, _fptrgroup.rtos_isr.nstackwords + " _XCORE_C_STR( RTOS_SUPPORT_INTERRUPT_STACK_GROWTH ) " + 2"
+        : "=r"( sp ), "=r"( words )
+    );
+
+    return ( sp - words * sizeof( uint32_t ) ) & ~7;
+}
+
+/*
+ * Moves the sources in pending that a handler which has interrupted
+ * an ISR at floor_level may not dispatch to the core's deferred
+ * sources. These are the RTOS core sources, and the peripheral sources
+ * at floor_level or below.
+ */
+static void irq_defer( int core_id, irq_pending_t *pending, int floor_level )
+{
+    irq_pending_t *deferred = &irq_deferred[ core_id ];
+    uint32_t summary = pending->summary;
+
+    while ( summary != 0 )
     {
-        pending = irq_pending[ core_id ];
-        irq_pending[ core_id ] |= ( 1 << source_id );
+        int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+        uint32_t keep = 0;
+        uint32_t bits;
+        int level;
+
+        summary &= ~( 1 << group );
+
+        for ( level = floor_level + 1; level <= RTOS_IRQ_PRIORITY_HIGHEST; level++ )
+        {
+            keep |= irq_priority_mask[ level ][ group ];
+        }
 
-        if( pending == 0 )
+        bits = pending->group[ group ] & ~keep;
+        if ( bits != 0 )
         {
-            if( source_id < num_cores )
+            if ( deferred->summary & ( 1 << group ) )
             {
-                source_chanend = rtos_irq_chanend[ source_id ];
+                deferred->group[ group ] |= bits;
             }
-            else if ( source_id >= RTOS_MAX_CORE_COUNT && source_id < RTOS_MAX_CORE_COUNT + peripheral_source_count )
+            else
             {
-                source_chanend = peripheral_irq_chanend[ source_id - RTOS_MAX_CORE_COUNT ];
+                deferred->group[ group ] = bits;
+                deferred->summary |= ( 1 << group );
             }
-            else
+
+            pending->group[ group ] &= ~bits;
+            if ( pending->group[ group ] == 0 )
             {
-                xassert(0);
+                pending->summary &= ~( 1 << group );
             }
+        }
+    }
+}
 
-            /* just ensure the pending flag is set before the channel send. */
-            RTOS_MEMORY_BARRIER();
+/*
+ * Moves the core's deferred sources into pending.
+ * Returns non-zero if there were any.
+ */
+static int irq_deferred_take( int core_id, irq_pending_t *pending )
+{
+    irq_pending_t *deferred = &irq_deferred[ core_id ];
+    uint32_t summary = deferred->summary;
+    int taken = summary != 0;
 
-            chanend_set_dest( source_chanend, rtos_irq_chanend[ core_id ] );
-            _s_chan_out_ct_end( source_chanend );
+    while ( summary != 0 )
+    {
+        int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+
+        summary &= ~( 1 << group );
+
+        /* pending only holds valid words for the groups in its summary */
+        if ( pending->summary & ( 1 << group ) )
+        {
+            pending->group[ group ] |= deferred->group[ group ];
+        }
+        else
+        {
+            pending->group[ group ] = deferred->group[ group ];
+            pending->summary |= ( 1 << group );
         }
     }
-    rtos_lock_release(0);
+
+    deferred->summary = 0;
+
+    return taken;
 }
 
 /*
- * Must be called by an RTOS core to interrupt a
- * non-RTOS core.
+ * Called by the IRQ handler each time it has dispatched what it has
+ * pending. Takes any sources that nested handlers have left for it
+ * meanwhile that it may dispatch itself. Returns non-zero if there
+ * are any.
  */
-void rtos_irq_peripheral( chanend dest_chanend )
+static int irq_deferred_resume( int core_id, int outermost, irq_pending_t *pending )
 {
-    int core_id;
+    if ( !irq_deferred_take( core_id, pending ) )
+    {
+        return 0;
+    }
 
-    uint32_t mask = rtos_interrupt_mask_all();
-    core_id = rtos_core_id_get();
-    chanend_set_dest( rtos_irq_chanend[ core_id ], dest_chanend );
-    _s_chan_out_ct_end( rtos_irq_chanend[ core_id ] );
-    rtos_interrupt_mask_set(mask);
+    if ( !outermost )
+    {
+        irq_defer( core_id, pending, irq_dispatch_level[ core_id ] );
+    }
+
+    return pending->summary != 0;
 }
+#else
+#define irq_deferred_resume( core_id, outermost, pending ) 0
+#endif /* RTOS_IRQ_NESTING */
 
-int rtos_irq_register(rtos_irq_isr_t isr, void *data, chanend source_chanend)
+/*
+ * Calls the ISR of peripheral source_id, which is at level. With
+ * RTOS_IRQ_NESTING, an ISR below the highest level is called with
+ * interrupts unmasked and the kernel stack pointer moved down to a
+ * new partition, so that a higher level source may interrupt it.
+ */
+static void irq_isr_call( int core_id, int source_id, int level )
 {
-    int source_id;
+#if RTOS_IRQ_NESTING
+    if ( level < RTOS_IRQ_PRIORITY_HIGHEST )
+    {
+        int outer_level = irq_dispatch_level[ core_id ];
+        uint32_t ksp = rtos_kstack_pointer_get();
 
-    xassert( peripheral_source_count < MAX_ADDITIONAL_SOURCES );
+        irq_dispatch_level[ core_id ] = level;
+        irq_ksp_set( irq_nested_ksp() );
+        rtos_interrupt_unmask_all();
 
-    rtos_lock_acquire(0);
-    source_id = peripheral_source_count++;
-    rtos_lock_release(0);
+        isr_info[ source_id ].isr( isr_info[ source_id ].data );
 
-    isr_info[ source_id ].isr = isr;
-    isr_info[ source_id ].data = data;
-    peripheral_irq_chanend[ source_id ] = source_chanend;
+        rtos_interrupt_mask_all();
+        irq_ksp_set( ksp );
+        irq_dispatch_level[ core_id ] = outer_level;
+        return;
+    }
+#endif
 
-    return RTOS_MAX_CORE_COUNT + source_id;
+    isr_info[ source_id ].isr( isr_info[ source_id ].data );
 }
 
-void rtos_irq_enable( int total_rtos_cores )
+/*
+ * Moves the sources in pending that are masked to the core's held
+ * sources, without taking the lock when none are masked.
+ */
+static void irq_hold_masked( int core_id, irq_pending_t *pending )
 {
-    int core_id;
+    uint32_t summary = pending->summary & irq_source_masked_summary;
 
-    core_id = rtos_core_id_get();
-    chanend_alloc( &rtos_irq_chanend[ core_id ] );
-    chanend_setup_interrupt_callback( rtos_irq_chanend[ core_id ], NULL, RTOS_INTERRUPT_CALLBACK( rtos_irq_handler ) );
-    chanend_enable_trigger( rtos_irq_chanend[ core_id ] );
+    if ( summary == 0 )
+    {
+        return;
+    }
 
-    rtos_lock_acquire(0);
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
     {
-        irq_enable_bf |= (1 << core_id);
+        while ( summary != 0 )
+        {
+            int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+            uint32_t bits = pending->group[ group ] & irq_source_masked[ group ];
 
-        if (irq_enable_bf == (1 << total_rtos_cores) - 1) {
-            irq_ready = 1;
+            summary &= ~( 1 << group );
+
+            irq_source_held[ core_id ][ group ] |= bits;
+            irq_source_held_summary[ core_id ] |= ( 1 << group );
+            pending->group[ group ] &= ~bits;
+            if ( pending->group[ group ] == 0 )
+            {
+                pending->summary &= ~( 1 << group );
+            }
         }
     }
-    rtos_lock_release(0);
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
 }
 
-int rtos_irq_ready(void)
+/*
+ * Moves the core's held sources that have since been unmasked back
+ * into pending, without taking the lock when none are held.
+ */
+static void irq_held_release( int core_id, irq_pending_t *pending )
 {
-    return irq_ready;
+    uint32_t summary = irq_source_held_summary[ core_id ];
+
+    if ( summary == 0 )
+    {
+        return;
+    }
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        while ( summary != 0 )
+        {
+            int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+            uint32_t bits = irq_source_held[ core_id ][ group ] & ~irq_source_masked[ group ];
+
+            summary &= ~( 1 << group );
+
+            if ( bits == 0 )
+            {
+                continue;
+            }
+
+            irq_source_held[ core_id ][ group ] &= ~bits;
+            if ( irq_source_held[ core_id ][ group ] == 0 )
+            {
+                irq_source_held_summary[ core_id ] &= ~( 1 << group );
+            }
+
+            /* pending only holds valid words for the groups in its summary */
+            if ( pending->summary & ( 1 << group ) )
+            {
+                pending->group[ group ] |= bits;
+            }
+            else
+            {
+                pending->group[ group ] = bits;
+                pending->summary |= ( 1 << group );
+            }
+        }
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+}
+
+DEFINE_RTOS_INTERRUPT_CALLBACK( rtos_irq_handler, data )
+{
+    int core_id;
+    int outermost;
+    irq_pending_t pending;
+    uint32_t summary;
+    int level;
+
+    core_id = rtos_core_id_get_inline();
+
+    /* A nested handler's time is already being counted as ISR time */
+    outermost = irq_outermost( core_id );
+
+    if ( outermost )
+    {
+        rtos_cpu_stats_enter( core_id, RTOS_CPU_STATS_ISR );
+    }
+
+#if RTOS_IRQ_LOCKLESS_PENDING
+    _s_chan_check_ct_end( rtos_irq_chanend[ core_id ] );
+
+    /* just ensure the channel read is done before allowing another token. */
+    RTOS_MEMORY_BARRIER();
+
+    /* The token must be marked as consumed before the pending flags
+    are taken. A source that raises its flag after this point will
+    send a new token, and one that raised it before is seen below. */
+    irq_token_outstanding[ core_id ] = 0;
+
+    RTOS_MEMORY_BARRIER();
+
+    irq_pending_take( core_id, &pending );
+#else
+    xassert( irq_pending[ core_id ].summary );
+
+    _s_chan_check_ct_end( rtos_irq_chanend[ core_id ] );
+
+    /* just ensure the channel read is done before clearing the pending flags. */
+    RTOS_MEMORY_BARRIER();
+
+    /* grab a snapshot of the pending flags before clearing them.
+    After the clear, this core may be interrupted again. We will
+    handle all the interrupts at the time the snapshot is taken now,
+    and any more will be handled when this ISR is called again. */
+
+    irq_pending_take( core_id, &pending );
+#endif
+
+    irq_stats_dispatched( core_id, &pending );
+
+    /* Held sources were counted when they were first taken */
+    irq_held_release( core_id, &pending );
+
+#if RTOS_IRQ_LOCKLESS_PENDING
+    /* The flags that a token was sent for may have already been
+    handled by the previous invocation of this ISR. */
+    if ( pending.summary == 0 )
+    {
+        if ( outermost )
+        {
+            rtos_cpu_stats_exit( core_id );
+        }
+        return;
+    }
+#endif
+
+#if RTOS_IRQ_NESTING
+    /* A nested handler leaves the sources it may not dispatch for
+    the handler that called the ISR it has interrupted. */
+    if ( !outermost )
+    {
+        irq_defer( core_id, &pending, irq_dispatch_level[ core_id ] );
+    }
+#endif
+
+    do
+    {
+        irq_hold_masked( core_id, &pending );
+
+        if ( ( pending.summary & 1 ) && ( pending.group[ 0 ] & RTOS_CORE_SOURCE_MASK ) )
+        {
+            /* This core is being interrupted by at least one other RTOS core.
+            Clear the pending flags from all of them and, unless they only sent
+            calls, enter the scheduler. */
+
+#if RTOS_IRQ_XSCOPE_PROBES
+            for( uint32_t bits = pending.group[ 0 ] & RTOS_CORE_SOURCE_MASK; bits != 0; )
+            {
+                int source_id = 31UL - ( uint32_t ) __builtin_clz( bits );
+
+                bits &= ~( 1 << source_id );
+                irq_probe( RTOS_IRQ_DISPATCH_PROBE_ID, core_id, source_id );
+            }
+#endif
+
+            /* With RTOS_IRQ_IPI, the scheduler is only entered if one of the cores asked for it. */
+            int reschedule = ipi_dispatch( core_id, pending.group[ 0 ] & RTOS_CORE_SOURCE_MASK );
+
+            pending.group[ 0 ] &= ~RTOS_CORE_SOURCE_MASK;
+
+            if( reschedule )
+            {
+                rtos_cpu_stats_enter( core_id, RTOS_CPU_STATS_YIELD );
+                RTOS_INTERCORE_INTERRUPT_ISR();
+                rtos_cpu_stats_enter( core_id, RTOS_CPU_STATS_ISR );
+            }
+        }
+
+        /* Dispatch the peripheral sources from the highest priority level
+        down. Within a level, the source with the highest ID goes first. */
+        for ( level = RTOS_IRQ_PRIORITY_HIGHEST; level >= RTOS_IRQ_PRIORITY_LOWEST && pending.summary != 0; level-- )
+        {
+            summary = pending.summary;
+
+            while ( summary != 0 )
+            {
+                int group = 31UL - ( uint32_t ) __builtin_clz( summary );
+                uint32_t bits = pending.group[ group ] & irq_priority_mask[ level ][ group ];
+
+                summary &= ~( 1 << group );
+
+                /* ensure no source is dispatched twice if its level is
+                changed while this handler is running. */
+                pending.group[ group ] &= ~bits;
+                if ( pending.group[ group ] == 0 )
+                {
+                    pending.summary &= ~( 1 << group );
+                }
+
+                while ( bits != 0 )
+                {
+                    int bit = 31UL - ( uint32_t ) __builtin_clz( bits );
+                    int source_id = group * IRQ_GROUP_SIZE + bit;
+
+                    xassert( source_id >= RTOS_MAX_CORE_COUNT && source_id <= MAX_SOURCE_ID );
+
+                    bits &= ~( 1 << bit );
+
+                    irq_probe( RTOS_IRQ_DISPATCH_PROBE_ID, core_id, source_id );
+
+                    irq_isr_call( core_id, source_id - RTOS_MAX_CORE_COUNT, level );
+                }
+            }
+        }
+    } while( irq_deferred_resume( core_id, outermost, &pending ) );
+
+    if ( outermost )
+    {
+        rtos_cpu_stats_exit( core_id );
+    }
+}
+
+/*
+ * Sets source_id pending on core_id, and sends it a token if it
+ * does not already have one.
+ */
+static void irq_send( int core_id, int source_id )
+{
+    int num_cores = rtos_core_count();
+
+    xassert( core_id >= 0 && core_id < num_cores );
+
+    irq_probe( RTOS_IRQ_SEND_PROBE_ID, core_id, source_id );
+
+#if RTOS_IRQ_LOCKLESS_PENDING
+    xassert( source_id >= 0 && source_id <= MAX_SOURCE_ID );
+
+    /*
+     * Only this core ever sets this source's flag, so if it is
+     * already set then the target core has yet to take it and
+     * there is nothing more to do.
+     */
+    if( irq_source_pending[ core_id ][ source_id ] )
+    {
+        irq_stats_sent( core_id, source_id, 1 );
+        return;
+    }
+
+    irq_stats_sent( core_id, source_id, 0 );
+    irq_source_pending[ core_id ][ source_id ] = 1;
+
+    /* the flag must be visible before checking for an outstanding token. */
+    RTOS_MEMORY_BARRIER();
+
+    /*
+     * If a token is outstanding then the target's IRQ handler has
+     * not yet cleared it, and it will see the flag set above once
+     * it has. Otherwise the first source to get the lock sends one.
+     * This still guarantees that a core never has more than one
+     * token outstanding.
+     */
+    if( irq_token_outstanding[ core_id ] )
+    {
+        return;
+    }
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        if( !irq_token_outstanding[ core_id ] )
+        {
+            irq_token_outstanding[ core_id ] = 1;
+            irq_token_send( core_id, source_id, num_cores );
+        }
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+#else
+    int was_pending;
+    const int group = IRQ_GROUP( source_id );
+    const uint32_t bit = IRQ_GROUP_BIT( source_id );
+
+    xassert( source_id >= 0 && source_id <= MAX_SOURCE_ID );
+
+    /*
+     * Atomically set the pending flag and, if the core we are
+     * sending an IRQ does not already have a pending IRQ, interrupt
+     * it with a channel send. This guarantees that if two cores
+     * simultaneously send a core an IRQ that only one will perform
+     * the channel send. Another channel send will not be performed
+     * until the core reads the token from the channel and clears the
+     * pending flags.
+     */
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        was_pending = irq_pending[ core_id ].summary != 0;
+        irq_stats_sent( core_id, source_id, irq_pending[ core_id ].group[ group ] & bit );
+        irq_pending[ core_id ].group[ group ] |= bit;
+        irq_pending[ core_id ].summary |= ( 1 << group );
+
+        if( !was_pending )
+        {
+            irq_token_send( core_id, source_id, num_cores );
+        }
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+#endif
+}
+
+#if RTOS_IRQ_IPI
+/*
+ * Marks a reschedule pending from the calling core, source_id, to
+ * core_id. Interrupts are masked so that the increment cannot be
+ * interrupted by an ISR on the same core doing the same.
+ */
+static void ipi_reschedule_post( int core_id, int source_id )
+{
+    uint32_t mask = rtos_interrupt_mask_all();
+    ipi_mailbox[ core_id ][ source_id ].reschedule_seq++;
+    rtos_interrupt_mask_set( mask );
+}
+#endif
+
+/*
+ * May be called by a non-RTOS core provided
+ * xSourceID >= RTOS_MAX_CORE_COUNT.
+ */
+void rtos_irq( int core_id, int source_id )
+{
+#if RTOS_IRQ_IPI
+    if( source_id >= 0 && source_id < RTOS_MAX_CORE_COUNT )
+    {
+        /* An IRQ from an RTOS core without a type asks for a reschedule. */
+        ipi_reschedule_post( core_id, source_id );
+    }
+#endif
+
+    irq_send( core_id, source_id );
+}
+
+void rtos_irq_batch_init( rtos_irq_batch_t *batch )
+{
+    batch->core_mask = 0;
+}
+
+void rtos_irq_batch_add( rtos_irq_batch_t *batch, int core_id, int source_id )
+{
+    xassert( core_id >= 0 && core_id < rtos_core_count() );
+    xassert( source_id >= 0 && source_id <= MAX_SOURCE_ID );
+
+    /* A core's source words are only cleared when it is first added. */
+    if( ( batch->core_mask & ( 1 << core_id ) ) == 0 )
+    {
+        memset( batch->sources[ core_id ], 0, sizeof( batch->sources[ core_id ] ) );
+        batch->core_mask |= ( 1 << core_id );
+    }
+
+    batch->sources[ core_id ][ IRQ_GROUP( source_id ) ] |= IRQ_GROUP_BIT( source_id );
+
+#if RTOS_IRQ_IPI
+    if( source_id < RTOS_MAX_CORE_COUNT )
+    {
+        ipi_reschedule_post( core_id, source_id );
+    }
+#endif
+}
+
+void rtos_irq_batch( rtos_irq_batch_t *batch )
+{
+    int num_cores = rtos_core_count();
+    uint32_t core_mask = batch->core_mask;
+    int token_source[ RTOS_MAX_CORE_COUNT ];
+    int group;
+
+    if( core_mask == 0 )
+    {
+        return;
+    }
+
+#if RTOS_IRQ_XSCOPE_PROBES
+    for( uint32_t cores = core_mask; cores != 0; )
+    {
+        int core_id = 31UL - ( uint32_t ) __builtin_clz( cores );
+
+        cores &= ~( 1 << core_id );
+
+        for( group = 0; group < IRQ_GROUP_COUNT; group++ )
+        {
+            for( uint32_t bits = batch->sources[ core_id ][ group ]; bits != 0; )
+            {
+                int bit = 31UL - ( uint32_t ) __builtin_clz( bits );
+
+                bits &= ~( 1 << bit );
+                irq_probe( RTOS_IRQ_SEND_PROBE_ID, core_id, group * IRQ_GROUP_SIZE + bit );
+            }
+        }
+    }
+#endif
+
+#if RTOS_IRQ_LOCKLESS_PENDING
+    uint32_t token_mask = 0;
+    uint32_t cores;
+
+    /* Set each source's flag, as rtos_irq() does, remembering which
+    cores have had a flag newly set. */
+    for( cores = core_mask; cores != 0; )
+    {
+        int core_id = 31UL - ( uint32_t ) __builtin_clz( cores );
+
+        cores &= ~( 1 << core_id );
+
+        for( group = 0; group < IRQ_GROUP_COUNT; group++ )
+        {
+            uint32_t bits = batch->sources[ core_id ][ group ];
+
+            while( bits != 0 )
+            {
+                int bit = 31UL - ( uint32_t ) __builtin_clz( bits );
+                int source_id = group * IRQ_GROUP_SIZE + bit;
+
+                bits &= ~( 1 << bit );
+
+                if( irq_source_pending[ core_id ][ source_id ] )
+                {
+                    irq_stats_sent( core_id, source_id, 1 );
+                    continue;
+                }
+
+                irq_stats_sent( core_id, source_id, 0 );
+                irq_source_pending[ core_id ][ source_id ] = 1;
+
+                token_source[ core_id ] = source_id;
+                token_mask |= ( 1 << core_id );
+            }
+        }
+    }
+
+    /* the flags must be visible before checking for outstanding tokens. */
+    RTOS_MEMORY_BARRIER();
+
+    for( cores = token_mask; cores != 0; )
+    {
+        int core_id = 31UL - ( uint32_t ) __builtin_clz( cores );
+
+        cores &= ~( 1 << core_id );
+
+        if( irq_token_outstanding[ core_id ] )
+        {
+            token_mask &= ~( 1 << core_id );
+        }
+    }
+
+    if( token_mask != 0 )
+    {
+        rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+        {
+            for( cores = token_mask; cores != 0; )
+            {
+                int core_id = 31UL - ( uint32_t ) __builtin_clz( cores );
+
+                cores &= ~( 1 << core_id );
+
+                if( !irq_token_outstanding[ core_id ] )
+                {
+                    irq_token_outstanding[ core_id ] = 1;
+                    irq_token_send( core_id, token_source[ core_id ], num_cores );
+                }
+            }
+        }
+        rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+    }
+#else
+    /*
+     * Set all of the pending flags in a single critical section,
+     * sending at most one token to each core. As with rtos_irq(),
+     * only cores without any pending IRQs are sent one.
+     */
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        while( core_mask != 0 )
+        {
+            int core_id = 31UL - ( uint32_t ) __builtin_clz( core_mask );
+            int was_pending = irq_pending[ core_id ].summary != 0;
+
+            core_mask &= ~( 1 << core_id );
+            token_source[ core_id ] = -1;
+
+            for( group = 0; group < IRQ_GROUP_COUNT; group++ )
+            {
+                uint32_t bits = batch->sources[ core_id ][ group ];
+
+                if( bits != 0 )
+                {
+                    irq_stats_sent_group( core_id, group, bits, irq_pending[ core_id ].group[ group ] );
+                    irq_pending[ core_id ].group[ group ] |= bits;
+                    irq_pending[ core_id ].summary |= ( 1 << group );
+
+                    token_source[ core_id ] = group * IRQ_GROUP_SIZE + ( 31UL - ( uint32_t ) __builtin_clz( bits ) );
+                }
+            }
+
+            if( !was_pending && token_source[ core_id ] >= 0 )
+            {
+                irq_token_send( core_id, token_source[ core_id ], num_cores );
+            }
+        }
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+#endif
+
+    batch->core_mask = 0;
+}
+
+/*
+ * Posts a call from the calling core to core_id in its mailbox, and
+ * sends it the IRQ, waiting first for any earlier call to it to have
+ * been run. The calling core is returned in source_id. Returns the
+ * call's sequence number. When core_id is the calling core, the function
+ * is instead run straight away, with interrupts masked just as it would
+ * be in the IRQ handler, and 0 is returned.
+ */
+static uint32_t core_call_post( int core_id, rtos_core_call_fn_t fn, void *arg, int *source_id )
+{
+    ipi_mailbox_t *mailbox;
+    uint32_t seq;
+    uint32_t mask;
+
+    xassert( core_id >= 0 && core_id < rtos_core_count() );
+
+    /*
+     * Interrupts are masked from choosing the mailbox until the IRQ
+     * is sent, so that the calling task cannot be moved to another
+     * core part way through. They are unmasked while waiting for the
+     * mailbox, so that a core waiting on this one cannot deadlock it.
+     */
+    for( ;; )
+    {
+        mask = rtos_interrupt_mask_all();
+        *source_id = rtos_core_id_get_inline();
+
+        if( *source_id == core_id )
+        {
+            fn( arg, core_id );
+            rtos_interrupt_mask_set( mask );
+            return 0;
+        }
+
+        mailbox = &ipi_mailbox[ core_id ][ *source_id ];
+        if( mailbox->call_seq == mailbox->call_done_seq )
+        {
+            break;
+        }
+
+        rtos_interrupt_mask_set( mask );
+    }
+
+    mailbox->call_fn = fn;
+    mailbox->call_arg = arg;
+    RTOS_MEMORY_BARRIER();
+    seq = ++mailbox->call_seq;
+    if( seq == 0 )
+    {
+        /* 0 is kept to mean that the call has already been run. */
+        seq = ++mailbox->call_seq;
+    }
+    irq_send( core_id, *source_id );
+    rtos_interrupt_mask_set( mask );
+
+    return seq;
+}
+
+/*
+ * Waits for the call with sequence number seq, posted from source_id
+ * to core_id, to have been run. The calling task may since have been
+ * moved to another core, which does not matter here.
+ */
+static void core_call_wait( int core_id, int source_id, uint32_t seq )
+{
+    if( seq != 0 )
+    {
+        while( ipi_mailbox[ core_id ][ source_id ].call_done_seq != seq );
+        RTOS_MEMORY_BARRIER();
+    }
+}
+
+void rtos_core_call( int core_id, rtos_core_call_fn_t fn, void *arg, int wait )
+{
+    uint32_t seq;
+    int source_id;
+
+    seq = core_call_post( core_id, fn, arg, &source_id );
+
+    if( wait )
+    {
+        core_call_wait( core_id, source_id, seq );
+    }
+}
+
+void rtos_core_call_all( rtos_core_call_fn_t fn, void *arg, int wait )
+{
+    int num_cores = rtos_core_count();
+    uint32_t seq[ RTOS_MAX_CORE_COUNT ];
+    int source_id[ RTOS_MAX_CORE_COUNT ];
+    int first;
+    int i;
+
+    /* Start with the core after this one, so that this
+    one is normally posted to, and so run on, last. */
+    first = rtos_core_id_get() + 1;
+
+    for( i = 0; i < num_cores; i++ )
+    {
+        int core_id = ( first + i ) % num_cores;
+        seq[ core_id ] = core_call_post( core_id, fn, arg, &source_id[ core_id ] );
+    }
+
+    if( wait )
+    {
+        for( i = 0; i < num_cores; i++ )
+        {
+            core_call_wait( i, source_id[ i ], seq[ i ] );
+        }
+    }
+}
+
+uint32_t rtos_ipi_count_get( int type )
+{
+    uint32_t count = 0;
+    int core_id;
+
+    xassert( type >= 0 && type < RTOS_IPI_TYPE_COUNT );
+
+    for( core_id = 0; core_id < rtos_core_count(); core_id++ )
+    {
+        count += ipi_count[ core_id ][ type ];
+    }
+
+    return count;
+}
+
+/*
+ * Must be called by an RTOS core to interrupt a
+ * non-RTOS core.
+ */
+void rtos_irq_peripheral( chanend dest_chanend )
+{
+    int core_id;
+
+    uint32_t mask = rtos_interrupt_mask_all();
+    core_id = rtos_core_id_get_inline();
+    chanend_set_dest( rtos_irq_chanend[ core_id ], dest_chanend );
+    _s_chan_out_ct_end( rtos_irq_chanend[ core_id ] );
+    rtos_interrupt_mask_set(mask);
+}
+
+void rtos_irq_peripheral_data( chanend dest_chanend, uint32_t data )
+{
+    int core_id;
+
+    uint32_t mask = rtos_interrupt_mask_all();
+    core_id = rtos_core_id_get_inline();
+    chanend_set_dest( rtos_irq_chanend[ core_id ], dest_chanend );
+    _s_chan_out_word( rtos_irq_chanend[ core_id ], data );
+    _s_chan_out_ct_end( rtos_irq_chanend[ core_id ] );
+    rtos_interrupt_mask_set(mask);
+}
+
+int rtos_irq_register(rtos_irq_isr_t isr, void *data, chanend source_chanend)
+{
+    int source_id;
+
+    xassert( peripheral_source_count < MAX_ADDITIONAL_SOURCES );
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        source_id = peripheral_source_count++;
+
+        irq_source_priority[ source_id ] = RTOS_IRQ_PRIORITY_LOWEST;
+        irq_priority_mask[ RTOS_IRQ_PRIORITY_LOWEST ][ IRQ_GROUP( RTOS_MAX_CORE_COUNT + source_id ) ] |= IRQ_GROUP_BIT( RTOS_MAX_CORE_COUNT + source_id );
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+
+    isr_info[ source_id ].isr = isr;
+    isr_info[ source_id ].data = data;
+    peripheral_irq_chanend[ source_id ] = source_chanend;
+
+    return RTOS_MAX_CORE_COUNT + source_id;
+}
+
+void rtos_irq_priority_set( int source_id, int priority )
+{
+    const int group = IRQ_GROUP( source_id );
+    const uint32_t bit = IRQ_GROUP_BIT( source_id );
+    int old_priority;
+
+    xassert( source_id >= RTOS_MAX_CORE_COUNT && source_id < RTOS_MAX_CORE_COUNT + peripheral_source_count );
+    xassert( priority >= RTOS_IRQ_PRIORITY_LOWEST && priority <= RTOS_IRQ_PRIORITY_HIGHEST );
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        old_priority = irq_source_priority[ source_id - RTOS_MAX_CORE_COUNT ];
+
+        /* Add the source to its new level before removing it from
+        the old one so that a running IRQ handler always finds it. */
+        irq_priority_mask[ priority ][ group ] |= bit;
+        RTOS_MEMORY_BARRIER();
+        if ( old_priority != priority )
+        {
+            irq_priority_mask[ old_priority ][ group ] &= ~bit;
+        }
+
+        irq_source_priority[ source_id - RTOS_MAX_CORE_COUNT ] = priority;
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+}
+
+void rtos_irq_source_mask( int source_id )
+{
+    const int group = IRQ_GROUP( source_id );
+    const uint32_t bit = IRQ_GROUP_BIT( source_id );
+    uint32_t mask;
+
+    xassert( source_id >= RTOS_MAX_CORE_COUNT && source_id < RTOS_MAX_CORE_COUNT + peripheral_source_count );
+
+    /* The IRQ handler takes the same lock, so it must not run on this core while it is held */
+    mask = rtos_interrupt_mask_all();
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        irq_source_masked[ group ] |= bit;
+        irq_source_masked_summary |= ( 1 << group );
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+    rtos_interrupt_mask_set( mask );
+}
+
+void rtos_irq_source_unmask( int source_id )
+{
+    const int group = IRQ_GROUP( source_id );
+    const uint32_t bit = IRQ_GROUP_BIT( source_id );
+    uint32_t held_cores = 0;
+    uint32_t mask;
+    int self_id;
+    int core_id;
+
+    xassert( source_id >= RTOS_MAX_CORE_COUNT && source_id < RTOS_MAX_CORE_COUNT + peripheral_source_count );
+
+    mask = rtos_interrupt_mask_all();
+    self_id = rtos_core_id_get_inline();
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        irq_source_masked[ group ] &= ~bit;
+        if ( irq_source_masked[ group ] == 0 )
+        {
+            irq_source_masked_summary &= ~( 1 << group );
+        }
+
+        for ( core_id = 0; core_id < RTOS_MAX_CORE_COUNT; core_id++ )
+        {
+            if ( irq_source_held[ core_id ][ group ] & bit )
+            {
+                held_cores |= ( 1 << core_id );
+            }
+        }
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+
+    /*
+     * Each core that took the source while it was masked is sent an
+     * IRQ from this core, and its handler then dispatches the source
+     * itself. The source's pending flag and send stats are only ever
+     * written by the core that raises it, which is not this one.
+     */
+    while ( held_cores != 0 )
+    {
+        core_id = 31UL - ( uint32_t ) __builtin_clz( held_cores );
+        held_cores &= ~( 1 << core_id );
+        irq_send( core_id, self_id );
+    }
+
+    rtos_interrupt_mask_set( mask );
+}
+
+void rtos_irq_enable( int total_rtos_cores )
+{
+    int core_id;
+
+    core_id = rtos_core_id_get_inline();
+#if RTOS_IRQ_NESTING
+    irq_dispatch_level[ core_id ] = -1;
+#endif
+#if RTOS_STACK_PAINT
+    rtos_kstack_paint();
+#endif
+    chanend_alloc( &rtos_irq_chanend[ core_id ] );
+    chanend_setup_interrupt_callback( rtos_irq_chanend[ core_id ], NULL, RTOS_INTERRUPT_CALLBACK( rtos_irq_handler ) );
+    chanend_enable_trigger( rtos_irq_chanend[ core_id ] );
+#if RTOS_IRQ_SLEEP
+    hwtimer_alloc( &irq_sleep_timer[ core_id ] );
+#endif
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_IRQ);
+    {
+        irq_enable_bf |= (1 << core_id);
+
+        if (irq_enable_bf == (1 << total_rtos_cores) - 1) {
+            irq_ready = 1;
+        }
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_IRQ);
+}
+
+int rtos_irq_ready(void)
+{
+    return irq_ready;
+}
+
+#if RTOS_IRQ_SLEEP
+int rtos_irq_sleep( uint32_t deadline )
+{
+    int core_id;
+    chanend irq_chanend;
+    hwtimer_t timer;
+    uint32_t start;
+    int woken;
+
+    core_id = rtos_core_id_get_inline();
+    irq_chanend = rtos_irq_chanend[ core_id ];
+    timer = irq_sleep_timer[ core_id ];
+
+    /*
+     * With interrupts masked, the IRQ channel end is switched over to
+     * raise an event instead, alongside the deadline timer. An IRQ token
+     * that is already waiting in the channel end then ends the wait as
+     * soon as it starts, so an IRQ sent just before the sleep cannot be
+     * missed. The token is left in the channel end for the IRQ handler.
+     */
+    chanend_setup_select( irq_chanend, IRQ_SLEEP_EVENT_IRQ );
+    chanend_enable_trigger( irq_chanend );
+    hwtimer_setup_select( timer, deadline, IRQ_SLEEP_EVENT_DEADLINE );
+    hwtimer_enable_trigger( timer );
+
+    start = get_reference_time();
+    woken = select_wait() == IRQ_SLEEP_EVENT_IRQ;
+
+    irq_sleep_stats[ core_id ].ticks += get_reference_time() - start;
+    irq_sleep_stats[ core_id ].sleeps++;
+    if( woken )
+    {
+        irq_sleep_stats[ core_id ].irq_wakes++;
+    }
+
+    hwtimer_disable_trigger( timer );
+    chanend_setup_interrupt_callback( irq_chanend, NULL, RTOS_INTERRUPT_CALLBACK( rtos_irq_handler ) );
+    chanend_enable_trigger( irq_chanend );
+
+    return woken;
+}
+
+int rtos_irq_sleep_stats_get( int core_id, rtos_irq_sleep_stats_t *stats )
+{
+    if( !( core_id >= 0 && core_id < rtos_core_count() ) )
+    {
+        return -1;
+    }
+
+    *stats = irq_sleep_stats[ core_id ];
+
+    return 0;
+}
+#endif /* RTOS_IRQ_SLEEP */
+
+#if RTOS_IRQ_STATS
+int rtos_irq_stats_get( int source_id, rtos_irq_stats_t *stats )
+{
+    int core_id;
+
+    if( !( source_id >= 0 && source_id < rtos_core_count() ) &&
+        !( source_id >= RTOS_MAX_CORE_COUNT && source_id < RTOS_MAX_CORE_COUNT + peripheral_source_count ) )
+    {
+        return -1;
+    }
+
+    memset( stats, 0, sizeof( rtos_irq_stats_t ) );
+
+    for( core_id = 0; core_id < rtos_core_count(); core_id++ )
+    {
+        rtos_irq_stats_t *core_stats = &irq_stats[ core_id ][ source_id ];
+
+        if( core_stats->count > 0 )
+        {
+            if( stats->count == 0 || core_stats->latency_min < stats->latency_min )
+            {
+                stats->latency_min = core_stats->latency_min;
+            }
+            if( core_stats->latency_max > stats->latency_max )
+            {
+                stats->latency_max = core_stats->latency_max;
+            }
+            if( stats->count == 0 || ( int32_t ) ( core_stats->last_dispatch_time - stats->last_dispatch_time ) > 0 )
+            {
+                stats->last_dispatch_time = core_stats->last_dispatch_time;
+            }
+            stats->latency_total += core_stats->latency_total;
+            stats->count += core_stats->count;
+        }
+
+        if( ( int32_t ) ( core_stats->last_send_time - stats->last_send_time ) > 0 )
+        {
+            stats->last_send_time = core_stats->last_send_time;
+        }
+        stats->coalesced += core_stats->coalesced;
+    }
+
+    return 0;
+}
+
+void rtos_irq_stats_reset( void )
+{
+    memset( irq_stats, 0, sizeof( irq_stats ) );
 }
+#endif
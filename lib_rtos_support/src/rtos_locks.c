@@ -3,29 +3,175 @@
 #include "rtos_support.h"
 #include "xassert.h"
 
-lock_t rtos_locks[RTOS_LOCK_COUNT] = {
-#if RTOS_LOCK_COUNT >= 1
+lock_t rtos_locks[RTOS_LOCK_TOTAL_COUNT] = {
+#if RTOS_LOCK_TOTAL_COUNT >= 1
         -1,
 #endif
-#if RTOS_LOCK_COUNT >= 2
+#if RTOS_LOCK_TOTAL_COUNT >= 2
         -1,
 #endif
-#if RTOS_LOCK_COUNT >= 3
+#if RTOS_LOCK_TOTAL_COUNT >= 3
         -1,
 #endif
-#if RTOS_LOCK_COUNT >= 4
+#if RTOS_LOCK_TOTAL_COUNT >= 4
         -1
 #endif
 };
 
-int rtos_lock_counters[RTOS_LOCK_COUNT] = {0};
+int rtos_lock_counters[RTOS_LOCK_TOTAL_COUNT] = {0};
+
+#if RTOS_LOCKS_PROFILE
+rtos_lock_profile_t rtos_lock_profiles[RTOS_LOCK_TOTAL_COUNT];
+#endif
 
 void rtos_locks_initialize(void)
 {
     int i;
 
-    for (i = 0; i < RTOS_LOCK_COUNT; i++) {
+    for (i = 0; i < RTOS_LOCK_TOTAL_COUNT; i++) {
         lock_alloc(&rtos_locks[i]);
         xassert(rtos_locks[i] != 0);
     }
+
+#if RTOS_LOCKS_PROFILE
+    rtos_lock_profile_reset();
+#endif
+}
+
+#if RTOS_LOCKS_PROFILE
+void rtos_lock_profile_get(int lock_id, rtos_lock_profile_t *profile)
+{
+    int counter;
+
+    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_TOTAL_COUNT);
+
+    /*
+     * The profile is only updated by the lock's owner, so take
+     * the lock to get a consistent copy of it.
+     */
+    counter = rtos_lock_acquire(lock_id);
+    *profile = rtos_lock_profiles[lock_id];
+    rtos_lock_release(lock_id);
+
+    if (counter == 1) {
+        /* Don't report this function's own use of the lock */
+        profile->acquire_count--;
+        profile->owner = -1;
+    }
+}
+
+void rtos_lock_profile_reset(void)
+{
+    int i;
+
+    for (i = 0; i < RTOS_LOCK_TOTAL_COUNT; i++) {
+        rtos_lock_profile_t *profile = &rtos_lock_profiles[i];
+
+        /* The owner and hold start are left for rtos_lock_release() */
+        rtos_lock_acquire(i);
+        profile->acquire_count = 0;
+        profile->wait_ticks_max = 0;
+        profile->wait_ticks_total = 0;
+        profile->hold_ticks_max = 0;
+        profile->hold_max_core = -1;
+        rtos_lock_release(i);
+    }
+}
+#endif
+
+void rtos_ticket_lock_init(rtos_ticket_lock_t *lock, int lock_id)
+{
+    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_TOTAL_COUNT);
+
+    lock->next_ticket = 0;
+    lock->now_serving = 0;
+    lock->lock_id = lock_id;
+}
+
+void rtos_ticket_lock_acquire(rtos_ticket_lock_t *lock)
+{
+    uint32_t ticket;
+
+    rtos_lock_acquire(lock->lock_id);
+    ticket = lock->next_ticket++;
+    rtos_lock_release(lock->lock_id);
+
+    while (lock->now_serving != ticket);
+
+    /* ensure nothing protected by the lock is accessed before it is owned. */
+    RTOS_MEMORY_BARRIER();
+}
+
+void rtos_ticket_lock_release(rtos_ticket_lock_t *lock)
+{
+    /* ensure everything protected by the lock is done before handing it on. */
+    RTOS_MEMORY_BARRIER();
+
+    /* Only the owner ever writes now_serving, so there is no need for the hardware lock. */
+    lock->now_serving++;
+}
+
+void rtos_rw_lock_init(rtos_rw_lock_t *lock, int lock_id)
+{
+    xassert(lock_id >= 0 && lock_id < RTOS_LOCK_TOTAL_COUNT);
+
+    lock->readers = 0;
+    lock->writer = 0;
+    lock->lock_id = lock_id;
+}
+
+void rtos_rw_lock_read_acquire(rtos_rw_lock_t *lock)
+{
+    for (;;) {
+        rtos_lock_acquire(lock->lock_id);
+        if (!lock->writer) {
+            lock->readers++;
+            rtos_lock_release(lock->lock_id);
+            break;
+        }
+        rtos_lock_release(lock->lock_id);
+
+        /* Wait for the writer without holding the hardware lock. */
+        while (lock->writer);
+    }
+
+    RTOS_MEMORY_BARRIER();
+}
+
+void rtos_rw_lock_read_release(rtos_rw_lock_t *lock)
+{
+    RTOS_MEMORY_BARRIER();
+
+    rtos_lock_acquire(lock->lock_id);
+    xassert(lock->readers > 0);
+    lock->readers--;
+    rtos_lock_release(lock->lock_id);
+}
+
+void rtos_rw_lock_write_acquire(rtos_rw_lock_t *lock)
+{
+    for (;;) {
+        rtos_lock_acquire(lock->lock_id);
+        if (!lock->writer) {
+            /* From here on no new readers will get the lock */
+            lock->writer = 1;
+            rtos_lock_release(lock->lock_id);
+            break;
+        }
+        rtos_lock_release(lock->lock_id);
+
+        while (lock->writer);
+    }
+
+    /* Wait for the current readers to finish */
+    while (lock->readers != 0);
+
+    RTOS_MEMORY_BARRIER();
+}
+
+void rtos_rw_lock_write_release(rtos_rw_lock_t *lock)
+{
+    RTOS_MEMORY_BARRIER();
+
+    lock->writer = 0;
 }
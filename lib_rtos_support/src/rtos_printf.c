@@ -22,6 +22,15 @@
 #define LONG64 (LONG_MAX == 9223372036854775807L)
 #define POINTER64 (INTPTR_MAX == 9223372036854775807L)
 
+#if RTOS_PRINTF_DEFERRED && (LONG64 || POINTER64)
+#error RTOS_PRINTF_DEFERRED requires 32-bit longs and pointers
+#endif
+
+/* What to do with the output buffer when it fills up */
+#define WRITEOUT_NONE   0 /* Nothing, any more output is dropped */
+#define WRITEOUT_DIRECT 1 /* Write it out */
+#define WRITEOUT_LOCKED 2 /* Write it out with line_write() */
+
 typedef struct {
     size_t size;
     size_t pos;
@@ -34,8 +43,76 @@ typedef struct {
     int32_t left_flag;
     int32_t unsigned_flag;
     char pad_character;
+
+    /*
+     * The arguments come either from ap, or from the argc
+     * words at argv when argv is not NULL.
+     */
+    va_list *ap;
+    const uint32_t *argv;
+    size_t argc;
 } params_t;
 
+#if RTOS_PRINTF_LINE_BUFFERED
+static rtos_ticket_lock_t printf_lock = { 0, 0, RTOS_LOCK_DOMAIN_ID(RTOS_LOCK_DOMAIN_PRINTF) };
+
+/*
+ * Writes out len bytes at str with interrupts masked, and
+ * without any other core writing out at the same time.
+ */
+static void line_write(const char *str, size_t len)
+{
+    uint32_t mask;
+
+    mask = rtos_interrupt_mask_all();
+    rtos_ticket_lock_acquire(&printf_lock);
+    _write(FD_STDOUT, str, len);
+    rtos_ticket_lock_release(&printf_lock);
+    rtos_interrupt_mask_set(mask);
+}
+#endif
+
+static void writeout(params_t *par)
+{
+#if RTOS_PRINTF_LINE_BUFFERED
+    if (par->writeout == WRITEOUT_LOCKED) {
+        line_write(par->str, par->size);
+    } else
+#endif
+    {
+        _write(FD_STDOUT, par->str, par->size);
+    }
+    par->pos = 0;
+}
+
+static int32_t arg_int32(params_t *par)
+{
+    if (par->argv == NULL) {
+        return va_arg(*par->ap, int32_t);
+    } else if (par->argc > 0) {
+        par->argc--;
+        return (int32_t) *par->argv++;
+    } else {
+        return 0;
+    }
+}
+
+static char *arg_str(params_t *par)
+{
+    if (par->argv == NULL) {
+        return va_arg(*par->ap, char *);
+    } else {
+        return (char *) (uintptr_t) arg_int32(par);
+    }
+}
+
+#if LONG64
+static int64_t arg_int64(params_t *par)
+{
+    return va_arg(*par->ap, int64_t);
+}
+#endif
+
 static void outbyte(char b, params_t *par)
 {
     if (par->pos < par->size) {
@@ -43,9 +120,42 @@ static void outbyte(char b, params_t *par)
     }
     par->pos++;
 
-    if (par->writeout && par->pos >= par->size) {
-        _write(FD_STDOUT, par->str, par->size);
-        par->pos = 0;
+    if (par->writeout != WRITEOUT_NONE && par->pos >= par->size) {
+        writeout(par);
+    }
+}
+
+/*---------------------------------------------------*/
+/*                                                   */
+/* This routine moves a run of n bytes to the output */
+/* buffer, just like n calls to outbyte(), but with  */
+/* one copy per buffer full.                         */
+/*                                                   */
+static void outbytes(const char *b, size_t n, params_t *par)
+{
+    while (n > 0) {
+        size_t count = 0;
+
+        if (par->pos < par->size) {
+            count = par->size - par->pos;
+            if (count > n) {
+                count = n;
+            }
+            memcpy(&par->str[par->pos], b, count);
+        }
+
+        if (par->writeout == WRITEOUT_NONE) {
+            par->pos += n;
+            return;
+        }
+
+        par->pos += count;
+        b += count;
+        n -= count;
+
+        if (par->pos >= par->size) {
+            writeout(par);
+        }
     }
 }
 
@@ -89,10 +199,13 @@ static void outs(const char *lp, params_t *par)
     padding(!(par->left_flag), par);
 
     /* Move string to the buffer                     */
-    while (((*lp) != (char)0) && ((par->num2) != 0)) {
-        (par->num2)--;
-        outbyte(*lp, par);
-        lp += 1;
+    if (lp != NULL) {
+        size_t n = (size_t) par->len;
+        if (n > (size_t) par->num2) {
+            n = (size_t) par->num2;
+        }
+        outbytes(lp, n, par);
+        par->num2 -= n;
     }
 
     padding(par->left_flag, par);
@@ -104,21 +217,104 @@ static void outs(const char *lp, params_t *par)
 /* as directed by the padding and positioning flags. */
 /*                                                   */
 
+static const char digit_pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+static const char hex_digits[16] = "0123456789ABCDEF";
+
+/*
+ * Writes num in base 10 backwards from end, two digits
+ * per step, and returns a pointer to its first digit.
+ * The divisions are by constants so they are done by
+ * multiplying by their reciprocal.
+ */
+static char *format_dec32(uint32_t num, char *end)
+{
+    char *p = end;
+
+    while (num >= 100) {
+        uint32_t pair = num % 100;
+        num /= 100;
+        p -= 2;
+        p[0] = digit_pairs[2 * pair];
+        p[1] = digit_pairs[2 * pair + 1];
+    }
+
+    if (num >= 10) {
+        p -= 2;
+        p[0] = digit_pairs[2 * num];
+        p[1] = digit_pairs[2 * num + 1];
+    } else {
+        *--p = '0' + num;
+    }
+
+    return p;
+}
+
+/*
+ * Writes num in base 16 backwards from end, by shifting
+ * and masking, and returns a pointer to its first digit.
+ */
+static char *format_hex32(uint32_t num, char *end)
+{
+    char *p = end;
+
+    do {
+        *--p = hex_digits[num & 0xF];
+        num >>= 4;
+    } while (num != 0);
+
+    return p;
+}
+
+/*
+ * Writes num in any other base backwards from end,
+ * and returns a pointer to its first digit.
+ */
+static char *format_base32(uint32_t num, uint32_t base, char *end)
+{
+    char *p = end;
+
+    do {
+        *--p = hex_digits[num % base];
+        num /= base;
+    } while (num != 0);
+
+    return p;
+}
+
+/*---------------------------------------------------*/
+/*                                                   */
+/* This routine moves the len characters at p, which */
+/* are a converted number, to the output buffer, and */
+/* adds in the padding where needed.                 */
+/*                                                   */
+static void outdigits(const char *p, size_t len, params_t *par)
+{
+    par->len = (int32_t) len;
+    padding(!(par->left_flag), par);
+    outbytes(p, len, par);
+    padding(par->left_flag, par);
+}
+
+/*---------------------------------------------------*/
+/*                                                   */
+/* This routine moves a number to the output buffer  */
+/* as directed by the padding and positioning flags. */
+/*                                                   */
+
 static void outnum(const int32_t n, const int32_t base, params_t *par)
 {
-    int32_t negative;
-    int32_t i;
-    char outbuf[32];
-    const char digits[] = "0123456789ABCDEF";
+    char outbuf[34];
+    char *end = &outbuf[sizeof(outbuf)];
+    char *p;
     uint32_t num;
-    for(i = 0; i<32; i++) {
-        outbuf[i] = '0';
-    }
+    int32_t negative;
 
     /* Check if number is negative                   */
     if ((par->unsigned_flag == 0) && (base == 10) && (n < 0L)) {
         negative = 1;
-        num =(-(n));
+        num = -((uint32_t) n);
     }
     else{
         num = n;
@@ -126,30 +322,19 @@ static void outnum(const int32_t n, const int32_t base, params_t *par)
     }
 
     /* Build number (backwards) in outbuf            */
-    i = 0;
-    do {
-        outbuf[i] = digits[(num % base)];
-        i++;
-        num /= base;
-    } while (num > 0);
+    if (base == 10) {
+        p = format_dec32(num, end);
+    } else if (base == 16) {
+        p = format_hex32(num, end);
+    } else {
+        p = format_base32(num, base, end);
+    }
 
     if (negative != 0) {
-        outbuf[i] = '-';
-        i++;
+        *--p = '-';
     }
 
-    outbuf[i] = '\0';
-    i--;
-
-    /* Move the converted number to the buffer and   */
-    /* add in the padding where needed.              */
-    par->len = (int32_t)strlen(outbuf);
-    padding(!(par->left_flag), par);
-    while (&outbuf[i] >= outbuf) {
-        outbyte(outbuf[i], par);
-        i--;
-    }
-    padding(par->left_flag, par);
+    outdigits(p, end - p, par);
 }
 /*---------------------------------------------------*/
 /*                                                   */
@@ -160,19 +345,16 @@ static void outnum(const int32_t n, const int32_t base, params_t *par)
 #if LONG64
 static void outnum1(const int64_t n, const int32_t base, params_t *par)
 {
-    int32_t negative;
-    int32_t i;
-    char outbuf[64];
-    const char digits[] = "0123456789ABCDEF";
+    char outbuf[66];
+    char *end = &outbuf[sizeof(outbuf)];
+    char *p = end;
     uint64_t num;
-    for(i = 0; i<64; i++) {
-        outbuf[i] = '0';
-    }
+    int32_t negative;
 
     /* Check if number is negative                   */
     if ((par->unsigned_flag == 0) && (base == 10) && (n < 0L)) {
         negative = 1;
-        num =(-(n));
+        num = -((uint64_t) n);
     }
     else{
         num = (n);
@@ -180,30 +362,40 @@ static void outnum1(const int64_t n, const int32_t base, params_t *par)
     }
 
     /* Build number (backwards) in outbuf            */
-    i = 0;
-    do {
-        outbuf[i] = digits[(num % base)];
-        i++;
-        num /= base;
-    } while (num > 0);
+    if (base == 10) {
+        /* Peel off nine digits at a time, so that there */
+        /* are at most two 64-bit divisions.             */
+        while (num > UINT32_MAX) {
+            char *chunk_end = p;
+            p = format_dec32((uint32_t) (num % 1000000000), p);
+            while (p > chunk_end - 9) {
+                *--p = '0';
+            }
+            num /= 1000000000;
+        }
+        p = format_dec32((uint32_t) num, p);
+    } else if (base == 16) {
+        while (num > UINT32_MAX) {
+            char *chunk_end = p;
+            p = format_hex32((uint32_t) num, p);
+            while (p > chunk_end - 8) {
+                *--p = '0';
+            }
+            num >>= 32;
+        }
+        p = format_hex32((uint32_t) num, p);
+    } else {
+        do {
+            *--p = hex_digits[num % base];
+            num /= base;
+        } while (num > 0);
+    }
 
     if (negative != 0) {
-        outbuf[i] = '-';
-        i++;
+        *--p = '-';
     }
 
-    outbuf[i] = '\0';
-    i--;
-
-    /* Move the converted number to the buffer and   */
-    /* add in the padding where needed.              */
-    par->len = (int32_t)strlen(outbuf);
-    padding(!(par->left_flag), par);
-    while (&outbuf[i] >= outbuf) {
-        outbyte(outbuf[i], par);
-        i--;
-    }
-    padding(par->left_flag, par);
+    outdigits(p, end - p, par);
 }
 #endif
 /*---------------------------------------------------*/
@@ -248,7 +440,7 @@ static int32_t getnum(char **linep)
 /* the supported formats.                            */
 /*                                                   */
 
-static size_t rtos_vsnwprintf(char *str, size_t size, int writeout, const char *fmt, va_list ap)
+static size_t rtos_snwprintf_args(char *str, size_t size, int writeout, const char *fmt, va_list *ap, const uint32_t *argv, size_t argc)
 {
     int32_t Check;
 #if LONG64
@@ -265,14 +457,20 @@ static size_t rtos_vsnwprintf(char *str, size_t size, int writeout, const char *
     par.pos = 0;
     par.str = str;
     par.writeout = writeout;
+    par.ap = ap;
+    par.argv = argv;
+    par.argc = argc;
 
     while ((ctrl != NULL) && (*ctrl != (char)0)) {
 
         /* move format string chars to buffer until a  */
         /* format control is found.                    */
         if (*ctrl != '%') {
-            outbyte(*ctrl, &par);
-            ctrl += 1;
+            const char *run = ctrl;
+            do {
+                ctrl += 1;
+            } while ((*ctrl != (char)0) && (*ctrl != '%'));
+            outbytes(run, ctrl - run, &par);
             continue;
         }
 
@@ -349,20 +547,20 @@ static size_t rtos_vsnwprintf(char *str, size_t size, int writeout, const char *
             case 'd':
                 #if LONG64
                 if (long_flag != 0){
-                    outnum1((int64_t)va_arg(ap, int64_t), 10L, &par);
+                    outnum1(arg_int64(&par), 10L, &par);
                 }
                 else {
-                    outnum(va_arg(ap, int32_t), 10L, &par);
+                    outnum(arg_int32(&par), 10L, &par);
                 }
                 #else
-                outnum(va_arg(ap, int32_t), 10L, &par);
+                outnum(arg_int32(&par), 10L, &par);
                 #endif
                 Check = 1;
                 break;
             case 'p':
                 #if POINTER64
                 par.unsigned_flag = 1;
-                outnum1((int64_t)va_arg(ap, int64_t), 16L, &par);
+                outnum1(arg_int64(&par), 16L, &par);
                 Check = 1;
                 break;
                 #endif
@@ -371,24 +569,24 @@ static size_t rtos_vsnwprintf(char *str, size_t size, int writeout, const char *
                 par.unsigned_flag = 1;
                 #if LONG64
                 if (long_flag != 0) {
-                    outnum1((int64_t)va_arg(ap, int64_t), 16L, &par);
+                    outnum1(arg_int64(&par), 16L, &par);
                 }
                 else {
-                    outnum((int32_t)va_arg(ap, int32_t), 16L, &par);
+                    outnum(arg_int32(&par), 16L, &par);
                 }
                 #else
-                outnum((int32_t)va_arg(ap, int32_t), 16L, &par);
+                outnum(arg_int32(&par), 16L, &par);
                 #endif
                 Check = 1;
                 break;
 
             case 's':
-                outs(va_arg(ap, char *), &par);
+                outs(arg_str(&par), &par);
                 Check = 1;
                 break;
 
             case 'c':
-                outbyte(va_arg(ap, int32_t), &par);
+                outbyte(arg_int32(&par), &par);
                 Check = 1;
                 break;
 
@@ -434,6 +632,18 @@ static size_t rtos_vsnwprintf(char *str, size_t size, int writeout, const char *
 
     return par.pos;
 }
+
+static size_t rtos_vsnwprintf(char *str, size_t size, int writeout, const char *fmt, va_list ap)
+{
+    size_t len;
+    va_list aq;
+
+    va_copy(aq, ap);
+    len = rtos_snwprintf_args(str, size, writeout, fmt, &aq, NULL, 0);
+    va_end(aq);
+
+    return len;
+}
 /*---------------------------------------------------*/
 
 size_t rtos_snprintf(char *str, size_t size, const char *fmt, ...)
@@ -442,7 +652,7 @@ size_t rtos_snprintf(char *str, size_t size, const char *fmt, ...)
     va_list ap;
 
     va_start(ap, fmt);
-    len = rtos_vsnwprintf(str, size, 0, fmt, ap);
+    len = rtos_vsnwprintf(str, size, WRITEOUT_NONE, fmt, ap);
     va_end(ap);
 
     return len;
@@ -454,7 +664,7 @@ size_t rtos_sprintf(char *str, const char *fmt, ...)
     va_list ap;
 
     va_start(ap, fmt);
-    len = rtos_vsnwprintf(str, SIZE_MAX, 0, fmt, ap);
+    len = rtos_vsnwprintf(str, SIZE_MAX, WRITEOUT_NONE, fmt, ap);
     va_end(ap);
 
     return len;
@@ -464,6 +674,187 @@ size_t rtos_sprintf(char *str, const char *fmt, ...)
 #define RTOS_PRINTF_BUFSIZE 130
 #endif
 
+#if RTOS_PRINTF_DEFERRED
+
+typedef struct {
+    const char *fmt;
+    size_t argc;
+    uint32_t argv[RTOS_PRINTF_DEFERRED_MAX_ARGS];
+} deferred_msg_t;
+
+/*
+ * Each ring is written only by its own logical core, and read only by
+ * rtos_printf_deferred_drain(), so no lock is needed between cores.
+ * Interrupts are masked while a message is stored so that an ISR on
+ * the same core cannot store one at the same time.
+ */
+static struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    uint32_t dropped_reported;
+    deferred_msg_t msg[RTOS_PRINTF_DEFERRED_BUF_CNT];
+} deferred_ring[RTOS_MAX_CORE_COUNT];
+
+/*
+ * Returns the number of arguments the format string consumes,
+ * following the same rules as rtos_snwprintf_args().
+ */
+static size_t deferred_argc(const char *fmt)
+{
+    size_t argc = 0;
+
+    while (*fmt != '\0') {
+        if (*fmt++ != '%') {
+            continue;
+        }
+        while (isdigit((int32_t) *fmt) || *fmt == '-' || *fmt == '.' || tolower((int32_t) *fmt) == 'l') {
+            fmt++;
+        }
+        switch (tolower((int32_t) *fmt)) {
+        case 'u':
+        case 'i':
+        case 'd':
+        case 'p':
+        case 'x':
+        case 's':
+        case 'c':
+            argc++;
+            break;
+        case '\0':
+            return argc;
+        }
+        fmt++;
+    }
+
+    return argc;
+}
+
+size_t rtos_printf(const char *fmt, ...)
+{
+    va_list ap;
+    uint32_t mask;
+    uint32_t head;
+    size_t argc;
+    uint32_t argv[RTOS_PRINTF_DEFERRED_MAX_ARGS];
+    int core_id = get_logical_core_id();
+
+    argc = deferred_argc(fmt);
+    if (argc > RTOS_PRINTF_DEFERRED_MAX_ARGS) {
+        argc = RTOS_PRINTF_DEFERRED_MAX_ARGS;
+    }
+
+    va_start(ap, fmt);
+    for (int i = 0; i < argc; i++) {
+        argv[i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    mask = rtos_interrupt_mask_all();
+    head = deferred_ring[core_id].head;
+    if (head - deferred_ring[core_id].tail < RTOS_PRINTF_DEFERRED_BUF_CNT) {
+        deferred_msg_t *msg = &deferred_ring[core_id].msg[head & (RTOS_PRINTF_DEFERRED_BUF_CNT - 1)];
+        msg->fmt = fmt;
+        msg->argc = argc;
+        memcpy(msg->argv, argv, argc * sizeof(uint32_t));
+        RTOS_MEMORY_BARRIER();
+        deferred_ring[core_id].head = head + 1;
+    } else {
+        deferred_ring[core_id].dropped++;
+    }
+    rtos_interrupt_mask_set(mask);
+
+    return 0;
+}
+
+size_t rtos_printf_deferred_drain(void)
+{
+    size_t count = 0;
+    size_t len;
+    char buf[RTOS_PRINTF_BUFSIZE];
+
+    for (int core_id = 0; core_id < RTOS_MAX_CORE_COUNT; core_id++) {
+        uint32_t tail = deferred_ring[core_id].tail;
+        uint32_t dropped;
+
+        while (tail != deferred_ring[core_id].head) {
+            deferred_msg_t *msg = &deferred_ring[core_id].msg[tail & (RTOS_PRINTF_DEFERRED_BUF_CNT - 1)];
+
+            RTOS_MEMORY_BARRIER();
+            len = rtos_snwprintf_args(buf, RTOS_PRINTF_BUFSIZE, WRITEOUT_DIRECT, msg->fmt, NULL, msg->argv, msg->argc);
+            _write(FD_STDOUT, buf, len);
+
+            RTOS_MEMORY_BARRIER();
+            deferred_ring[core_id].tail = ++tail;
+            count++;
+        }
+
+        dropped = deferred_ring[core_id].dropped;
+        if (dropped != deferred_ring[core_id].dropped_reported) {
+            uint32_t argv[2] = { dropped - deferred_ring[core_id].dropped_reported, core_id };
+
+            len = rtos_snwprintf_args(buf, RTOS_PRINTF_BUFSIZE, WRITEOUT_DIRECT, "[%u messages dropped on core %d]\n", NULL, argv, 2);
+            _write(FD_STDOUT, buf, len);
+            deferred_ring[core_id].dropped_reported = dropped;
+        }
+    }
+
+    return count;
+}
+
+#elif RTOS_PRINTF_LINE_BUFFERED
+
+static struct {
+    char buf[RTOS_PRINTF_LINE_BUFSIZE];
+    volatile int busy;
+} line_buf[RTOS_MAX_CORE_COUNT];
+
+size_t rtos_printf(const char *fmt, ...)
+{
+    size_t len;
+    va_list ap;
+    uint32_t mask;
+    char *buf = NULL;
+    size_t size;
+    char stack_buf[RTOS_PRINTF_BUFSIZE];
+    int core_id = get_logical_core_id();
+
+    /*
+     * The buffer is claimed by the print rather than by the core, so
+     * it is still released correctly if the task moves to another core.
+     */
+    mask = rtos_interrupt_mask_all();
+    if (!line_buf[core_id].busy) {
+        line_buf[core_id].busy = 1;
+        buf = line_buf[core_id].buf;
+    }
+    rtos_interrupt_mask_set(mask);
+
+    if (buf != NULL) {
+        size = RTOS_PRINTF_LINE_BUFSIZE;
+    } else {
+        buf = stack_buf;
+        size = RTOS_PRINTF_BUFSIZE;
+    }
+
+    va_start(ap, fmt);
+    len = rtos_vsnwprintf(buf, size, WRITEOUT_LOCKED, fmt, ap);
+    va_end(ap);
+
+    if (len > 0) {
+        line_write(buf, len);
+    }
+
+    if (buf != stack_buf) {
+        RTOS_MEMORY_BARRIER();
+        line_buf[core_id].busy = 0;
+    }
+
+    return len;
+}
+
+#else
+
 size_t rtos_printf(const char *fmt, ...)
 {
     size_t len;
@@ -473,7 +864,7 @@ size_t rtos_printf(const char *fmt, ...)
 
     va_start(ap, fmt);
     mask = rtos_interrupt_mask_all();
-    len = rtos_vsnwprintf(buf, RTOS_PRINTF_BUFSIZE, 1, fmt, ap);
+    len = rtos_vsnwprintf(buf, RTOS_PRINTF_BUFSIZE, WRITEOUT_DIRECT, fmt, ap);
     va_end(ap);
 
     _write(FD_STDOUT, buf, len);
@@ -482,3 +873,12 @@ size_t rtos_printf(const char *fmt, ...)
 
     return len;
 }
+
+#endif
+
+#if !RTOS_PRINTF_DEFERRED
+size_t rtos_printf_deferred_drain(void)
+{
+    return 0;
+}
+#endif /* RTOS_PRINTF_DEFERRED */
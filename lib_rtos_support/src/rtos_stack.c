@@ -0,0 +1,72 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "rtos_support.h"
+
+size_t rtos_stack_unused_words(const uint32_t *bottom, size_t words)
+{
+    size_t unused = 0;
+
+    while (unused < words && bottom[unused] == RTOS_STACK_PAINT_WORD) {
+        unused++;
+    }
+
+    return unused;
+}
+
+#if RTOS_STACK_PAINT
+
+asm(_XCORE_C_STR(_RTOS_KSTACK_SYMBOLS_DEF));
+
+/*
+ * The kernel stack of each RTOS core, written by the core itself
+ * when it paints it, before which words is 0.
+ */
+static struct {
+    const uint32_t *bottom;
+    volatile uint32_t words;
+} kstack[RTOS_MAX_CORE_COUNT];
+
+void rtos_kstack_paint(void)
+{
+    uint32_t mask;
+    uint32_t words;
+    uint32_t *bottom;
+    int core_id;
+
+    asm volatile(
+        "ldc %0, " _XCORE_C_STR(_RTOS_KSTACK_WORDS)
+        : "=r"(words)
+    );
+
+    mask = rtos_interrupt_mask_all();
+    core_id = rtos_core_id_get();
+
+    /* The word at ksp itself is where the sp of an interrupted task is saved */
+    bottom = (uint32_t *) rtos_kstack_pointer_get() - words;
+    for (int i = 0; i < words; i++) {
+        bottom[i] = RTOS_STACK_PAINT_WORD;
+    }
+
+    kstack[core_id].bottom = bottom;
+    RTOS_MEMORY_BARRIER();
+    kstack[core_id].words = words;
+
+    rtos_interrupt_mask_set(mask);
+}
+
+int rtos_kstack_stats_get(int core_id, rtos_kstack_stats_t *stats)
+{
+    uint32_t words = kstack[core_id].words;
+
+    if (words == 0) {
+        return 0;
+    }
+
+    RTOS_MEMORY_BARRIER();
+    stats->words = words;
+    stats->used_words = words - rtos_stack_unused_words(kstack[core_id].bottom, words);
+
+    return 1;
+}
+
+#endif /* RTOS_STACK_PAINT */
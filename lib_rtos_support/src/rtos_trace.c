@@ -0,0 +1,110 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "rtos_support.h"
+
+#if RTOS_TRACE_ENABLE
+
+#include <xscope.h>
+
+/*
+ * Each message is stored, and sent to the host, as the words:
+ *   - the address of its format string, or 0 for a count of dropped messages
+ *   - the reference clock time it was stored at
+ *   - the logical core it was stored on in bits 15..8, and its argument count in bits 7..0
+ *   - its arguments
+ */
+#define TRACE_HEADER_WORDS 3
+#define TRACE_MSG_MAX_WORDS (TRACE_HEADER_WORDS + RTOS_TRACE_MAX_ARGS)
+
+/*
+ * Each ring is written only by its own logical core, and read only by
+ * rtos_trace_flush(), so no lock is needed between cores. Interrupts
+ * are masked while a message is stored so that an ISR on the same core
+ * cannot store one at the same time.
+ */
+static struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    uint32_t dropped_reported;
+    uint32_t buf[RTOS_TRACE_BUF_WORDS];
+} trace_ring[RTOS_MAX_CORE_COUNT];
+
+void rtos_trace_put(const char *fmt, size_t argc, const uint32_t *argv)
+{
+    int core_id = get_logical_core_id();
+    uint32_t *buf = trace_ring[core_id].buf;
+    uint32_t mask;
+    uint32_t head;
+
+    mask = rtos_interrupt_mask_all();
+    head = trace_ring[core_id].head;
+    if (RTOS_TRACE_BUF_WORDS - (head - trace_ring[core_id].tail) >= TRACE_HEADER_WORDS + argc) {
+        buf[head++ & (RTOS_TRACE_BUF_WORDS - 1)] = (uint32_t) (uintptr_t) fmt;
+        buf[head++ & (RTOS_TRACE_BUF_WORDS - 1)] = get_reference_time();
+        buf[head++ & (RTOS_TRACE_BUF_WORDS - 1)] = (core_id << 8) | argc;
+        for (int i = 0; i < argc; i++) {
+            buf[head++ & (RTOS_TRACE_BUF_WORDS - 1)] = argv[i];
+        }
+        RTOS_MEMORY_BARRIER();
+        trace_ring[core_id].head = head;
+    } else {
+        trace_ring[core_id].dropped++;
+    }
+    rtos_interrupt_mask_set(mask);
+}
+
+size_t rtos_trace_flush(void)
+{
+    size_t count = 0;
+    uint32_t msg[TRACE_MSG_MAX_WORDS];
+
+    for (int core_id = 0; core_id < RTOS_MAX_CORE_COUNT; core_id++) {
+        const uint32_t *buf = trace_ring[core_id].buf;
+        uint32_t tail = trace_ring[core_id].tail;
+        uint32_t dropped;
+
+        while (tail != trace_ring[core_id].head) {
+            size_t words;
+
+            RTOS_MEMORY_BARRIER();
+            msg[0] = buf[tail++ & (RTOS_TRACE_BUF_WORDS - 1)];
+            msg[1] = buf[tail++ & (RTOS_TRACE_BUF_WORDS - 1)];
+            msg[2] = buf[tail++ & (RTOS_TRACE_BUF_WORDS - 1)];
+            words = TRACE_HEADER_WORDS + (msg[2] & 0xFF);
+            for (int i = TRACE_HEADER_WORDS; i < words; i++) {
+                msg[i] = buf[tail++ & (RTOS_TRACE_BUF_WORDS - 1)];
+            }
+            RTOS_MEMORY_BARRIER();
+            trace_ring[core_id].tail = tail;
+
+            xscope_bytes(RTOS_TRACE_XSCOPE_PROBE, words * sizeof(uint32_t), (const unsigned char *) msg);
+            count++;
+        }
+
+        dropped = trace_ring[core_id].dropped;
+        if (dropped != trace_ring[core_id].dropped_reported) {
+            msg[0] = 0;
+            msg[1] = get_reference_time();
+            msg[2] = (core_id << 8) | 1;
+            msg[3] = dropped - trace_ring[core_id].dropped_reported;
+            xscope_bytes(RTOS_TRACE_XSCOPE_PROBE, 4 * sizeof(uint32_t), (const unsigned char *) msg);
+            trace_ring[core_id].dropped_reported = dropped;
+        }
+    }
+
+    return count;
+}
+
+#else
+
+void rtos_trace_put(const char *fmt, size_t argc, const uint32_t *argv)
+{
+}
+
+size_t rtos_trace_flush(void)
+{
+    return 0;
+}
+
+#endif /* RTOS_TRACE_ENABLE */
@@ -0,0 +1,192 @@
+# Copyright (c) 2019, XMOS Ltd, All rights reserved
+"""
+Records the frames a mic array device sends to the DMA, as captured over
+xSCOPE when it is built with MICARRAYCONF_CAPTURE_XSCOPE=1, and turns a
+recording into the frames a device built with MICARRAYCONF_REPLAY=1
+replays.
+
+Recording reads from an xSCOPE server, started with something like:
+
+    xrun --xscope-port localhost:10101 app.xe
+
+    python mic_capture.py record capture.raw -port 10101 -frames 1000
+
+The frames are written one after another, exactly as they were sent, so
+a recording of a single mic is raw mono PCM. Frames that xSCOPE lost are
+reported and left out.
+
+    python mic_capture.py source capture.raw mic_replay_frames.c -frames 16
+
+writes a C file that defines micarray_dev_replay_frames[] with the given
+number of frames from the recording, to be built into the application.
+"""
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import ctypes
+import os
+import struct
+import sys
+import time
+
+PROBE_NAME = b"mic_capture"
+
+# See micarray_dev_dma.h
+CAPTURE_MAGIC = 0x4D434150
+HEADER_BYTES = 12
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser()
+    commands = parser.add_subparsers(dest="command")
+    commands.required = True
+
+    record = commands.add_parser("record", help="Record the captured frames to a file")
+    record.add_argument("output", help="The file to write the frames to")
+    record.add_argument("-host", default="localhost", help="xSCOPE server host")
+    record.add_argument("-port", required=True, help="xSCOPE server port")
+    record.add_argument("-frames", type=int, default=0, help="Stop after this many frames, or never if 0")
+
+    source = commands.add_parser("source", help="Write frames from a recording out as C source")
+    source.add_argument("input", help="The recording")
+    source.add_argument("output", help="The C file to write")
+    source.add_argument("-frame-bytes", type=int, default=1024,
+                        help="The bytes in each frame, as printed when it was recorded")
+    source.add_argument("-frames", type=int, default=16, help="The number of frames to take")
+    source.add_argument("-skip", type=int, default=0, help="The number of frames to skip first")
+
+    return parser.parse_args()
+
+
+class FrameAssembler(object):
+    """ Puts the frames back together from the records sent over the probe """
+
+    def __init__(self, out):
+        self.out = out
+        self.frame = None
+        self.length = 0
+        self.next_seq = None
+        self.frame_bytes = None
+        self.count = 0
+        self.lost = 0
+
+    def record(self, data):
+        if len(data) == HEADER_BYTES:
+            magic, seq, length = struct.unpack("<3I", data)
+            if magic == CAPTURE_MAGIC:
+                if self.frame is not None:
+                    self.lost += 1
+                if self.next_seq is not None and seq != self.next_seq:
+                    self.lost += (seq - self.next_seq) & 0xFFFFFFFF
+                self.next_seq = (seq + 1) & 0xFFFFFFFF
+                self.frame = bytearray()
+                self.length = length
+                return
+
+        if self.frame is None:
+            return
+
+        self.frame += data
+        if len(self.frame) >= self.length:
+            if len(self.frame) == self.length:
+                self.frame_complete(self.frame)
+            else:
+                self.lost += 1
+            self.frame = None
+
+    def frame_complete(self, frame):
+        if self.frame_bytes is None:
+            self.frame_bytes = len(frame)
+            print("Recording frames of %d bytes" % self.frame_bytes, file=sys.stderr)
+        elif len(frame) != self.frame_bytes:
+            print("Frame %d is %d bytes rather than %d" % (self.count, len(frame), self.frame_bytes), file=sys.stderr)
+
+        self.out.write(frame)
+        self.count += 1
+
+
+def record(output, host, port, frames):
+    tool_path = os.environ.get("XMOS_TOOL_PATH", "")
+    lib = ctypes.CDLL(os.path.join(tool_path, "lib", "xscope_endpoint.so"))
+
+    probe_id = [None]
+
+    REGISTER_CB = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint, ctypes.c_uint,
+                                   ctypes.c_uint, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_uint,
+                                   ctypes.c_char_p)
+    RECORD_CB = ctypes.CFUNCTYPE(None, ctypes.c_uint, ctypes.c_ulonglong, ctypes.c_uint,
+                                 ctypes.c_ulonglong, ctypes.POINTER(ctypes.c_char))
+
+    with open(output, "wb") as out:
+        assembler = FrameAssembler(out)
+
+        def register(id, type, r, g, b, name, unit, data_type, data_name):
+            if name == PROBE_NAME:
+                probe_id[0] = id
+
+        def record(id, timestamp, length, dataval, databytes):
+            if id == probe_id[0]:
+                assembler.record(ctypes.string_at(databytes, length))
+
+        register_cb = REGISTER_CB(register)
+        record_cb = RECORD_CB(record)
+        lib.xscope_ep_set_register_cb(register_cb)
+        lib.xscope_ep_set_record_cb(record_cb)
+
+        if lib.xscope_ep_connect(host.encode(), port.encode()) != 0:
+            raise RuntimeError("Unable to connect to the xSCOPE server at %s:%s" % (host, port))
+
+        try:
+            while frames == 0 or assembler.count < frames:
+                time.sleep(0.1)
+        except KeyboardInterrupt:
+            pass
+
+        lib.xscope_ep_disconnect()
+
+    print("Recorded %d frames, lost %d" % (assembler.count, assembler.lost), file=sys.stderr)
+
+
+def source(input_path, output, frame_bytes, frames, skip):
+    if frame_bytes % 4 != 0:
+        raise ValueError("Frames must be a whole number of words")
+
+    with open(input_path, "rb") as f:
+        f.seek(skip * frame_bytes)
+        data = f.read(frames * frame_bytes)
+
+    if len(data) < frames * frame_bytes:
+        raise ValueError("The recording only has %d frames after the first %d" % (len(data) // frame_bytes, skip))
+
+    words = struct.unpack("<%dI" % (len(data) // 4), data)
+
+    with open(output, "w") as out:
+        out.write("// Copyright (c) 2019, XMOS Ltd, All rights reserved\n\n")
+        out.write("/*\n * Generated by mic_capture.py from %s, frames %d to %d.\n */\n\n"
+                  % (os.path.basename(input_path), skip, skip + frames - 1))
+        out.write('#include "soc.h"\n')
+        out.write('#include "micarray_dev_conf_defaults.h"\n')
+        out.write('#include "micarray_dev_dma.h"\n\n')
+        out.write("#if MICARRAYCONF_REPLAY\n\n")
+        out.write("#if MICARRAYCONF_DMA_FRAME_SIZE != %d\n" % frame_bytes)
+        out.write("#warning These frames were not recorded with the frame size the mic array starts with\n")
+        out.write("#endif\n\n")
+        out.write("const unsigned micarray_dev_replay_frame_count = %d;\n" % frames)
+        out.write("const unsigned micarray_dev_replay_frame_size = %d;\n\n" % frame_bytes)
+        out.write("const uint32_t micarray_dev_replay_frames[%d] = {\n" % len(words))
+        for i in range(0, len(words), 8):
+            out.write("    " + " ".join("0x%08X," % w for w in words[i:i + 8]) + "\n")
+        out.write("};\n\n")
+        out.write("#endif\n")
+
+
+def main(args):
+    if args.command == "record":
+        record(args.output, args.host, args.port, args.frames)
+    else:
+        source(args.input, args.output, args.frame_bytes, args.frames, args.skip)
+
+
+if __name__ == "__main__":
+    main(parse_arguments())
@@ -0,0 +1,174 @@
+# Copyright (c) 2019, XMOS Ltd, All rights reserved
+"""
+Reports the static memory taken by each module of an application.
+
+The object files of a build are found under its build directory, and
+each is put down to the module it was built from. xcommon builds the
+objects of a module used by the application under a directory named
+after the module, and those of the application's own sources under the
+source directory they are in, so these are reported separately:
+
+    python soc_footprint.py .build
+
+    module                          code  rodata    data     bss   total
+    ...
+
+Every section is held in the tile's RAM, so the total is the static RAM
+the module takes. It does not include the heap, or stacks, which are
+only sized at link time. With -symbols, the largest objects in the data
+and bss sections of each module are listed too.
+"""
+from __future__ import print_function
+
+import argparse
+import os
+import struct
+import sys
+
+SHT_SYMTAB = 2
+SHT_NOBITS = 8
+
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+SHF_EXECINSTR = 0x4
+
+STT_OBJECT = 1
+
+CATEGORIES = ("code", "rodata", "data", "bss")
+
+MODULE_PREFIXES = ("lib_", "module_")
+BUILD_PREFIXES = ("_l_", "_m_")
+
+
+def parse_arguments():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("build", help="Build directory, such as .build or .build_<config>")
+    parser.add_argument("-symbols", type=int, default=0, metavar="N",
+                        help="Also list the N largest data and bss objects of each module")
+
+    return parser.parse_args()
+
+
+def section_category(sh_type, sh_flags):
+    """ Returns the category a section counts against, or None if it takes no memory """
+    if not sh_flags & SHF_ALLOC:
+        return None
+    if sh_flags & SHF_EXECINSTR:
+        return "code"
+    if sh_type == SHT_NOBITS:
+        return "bss"
+    if sh_flags & SHF_WRITE:
+        return "data"
+    return "rodata"
+
+
+class ObjectFile(object):
+    """ The sizes of the allocated sections of a little endian 32-bit ELF object file """
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+
+        if data[:4] != b"\x7fELF" or data[4:5] != b"\x01" or data[5:6] != b"\x01":
+            raise ValueError("%s is not a little endian 32-bit ELF file" % path)
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+
+        headers = [struct.unpack_from("<10I", data, shoff + i * shentsize) for i in range(shnum)]
+
+        self.sizes = dict((category, 0) for category in CATEGORIES)
+        self.objects = []
+
+        categories = []
+        for sh in headers:
+            sh_type, sh_flags, sh_size = sh[1], sh[2], sh[5]
+            category = section_category(sh_type, sh_flags)
+            categories.append(category)
+            if category is not None:
+                self.sizes[category] += sh_size
+
+        for sh in headers:
+            if sh[1] == SHT_SYMTAB:
+                self._read_symbols(data, headers, categories, sh)
+
+    def _read_symbols(self, data, headers, categories, symtab):
+        sh_offset, sh_size, sh_link, sh_entsize = symtab[4], symtab[5], symtab[6], symtab[9]
+        strtab = headers[sh_link]
+        strings = data[strtab[4]:strtab[4] + strtab[5]]
+
+        for offset in range(sh_offset, sh_offset + sh_size, sh_entsize):
+            st_name, _, st_size, st_info, _, st_shndx = struct.unpack_from("<IIIBBH", data, offset)
+            if st_info & 0xF != STT_OBJECT or st_size == 0 or st_shndx >= len(categories):
+                continue
+            if categories[st_shndx] not in ("data", "bss"):
+                continue
+            end = strings.find(b"\0", st_name)
+            name = strings[st_name:end].decode("utf-8", "replace")
+            self.objects.append((st_size, name))
+
+
+def object_module(build, path):
+    """ Returns the name of the module, or application source directory, an object was built from """
+    parts = os.path.relpath(os.path.dirname(path), build).split(os.sep)
+
+    for part in parts:
+        for prefix in BUILD_PREFIXES:
+            if part.startswith(prefix):
+                return part[len(prefix):]
+    for part in parts:
+        if part.startswith(MODULE_PREFIXES):
+            return part
+
+    parts = [part for part in parts if part not in (os.curdir, os.pardir)]
+    return "/".join(parts) if parts else "app"
+
+
+def find_objects(build):
+    for root, _, files in os.walk(build):
+        for name in sorted(files):
+            if name.endswith(".o"):
+                yield os.path.join(root, name)
+
+
+def main(args):
+    modules = {}
+
+    for path in find_objects(args.build):
+        try:
+            obj = ObjectFile(path)
+        except ValueError as e:
+            print("skipping %s" % e, file=sys.stderr)
+            continue
+
+        module = modules.setdefault(object_module(args.build, path), {
+            "sizes": dict((category, 0) for category in CATEGORIES),
+            "objects": [],
+        })
+        for category in CATEGORIES:
+            module["sizes"][category] += obj.sizes[category]
+        module["objects"].extend(obj.objects)
+
+    if not modules:
+        print("no object files found under %s, has the application been built?" % args.build, file=sys.stderr)
+        return 1
+
+    def total(sizes):
+        return sum(sizes[category] for category in CATEGORIES)
+
+    print("%-30s" % "module" + "".join("%8s" % category for category in CATEGORIES) + "%8s" % "total")
+
+    for name in sorted(modules, key=lambda name: -total(modules[name]["sizes"])):
+        sizes = modules[name]["sizes"]
+        print("%-30s" % name + "".join("%8d" % sizes[category] for category in CATEGORIES) + "%8d" % total(sizes))
+        for size, symbol in sorted(modules[name]["objects"], reverse=True)[:args.symbols]:
+            print("    %-58s%8d" % (symbol, size))
+
+    sums = dict((category, sum(module["sizes"][category] for module in modules.values())) for category in CATEGORIES)
+    print("%-30s" % "total" + "".join("%8d" % sums[category] for category in CATEGORIES) + "%8d" % total(sums))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(parse_arguments()))
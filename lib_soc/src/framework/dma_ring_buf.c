@@ -3,134 +3,416 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-#include "soc_dma_ring_buf.h"
+#define SOC_DMA_RING_BUF_IMPL
+#include "soc.h"
+#include "soc_dma_ring_buf_inline.h"
 
 #include "xassert.h"
 
-/*
- * The buffer descriptor status when a DMA receive operation
- * on it has just completed. The application should receive
- * these by calling soc_dma_ring_rx_buf_get().
- */
-#define SOC_DMA_BUF_DESC_STATUS_RX_DONE  3
+void soc_dma_ring_buf_init(
+        soc_dma_ring_buf_t *ring_buf,
+        uint32_t *desc_buf,
+        int buf_desc_count)
+{
+    soc_dma_buf_desc_t *desc = (soc_dma_buf_desc_t *) desc_buf;
+    int i;
+
+    xassert(((uintptr_t) desc_buf & (sizeof(uint32_t) - 1)) == 0);
+
+    for (i = 0; i < buf_desc_count; i++) {
+        desc[i].buf = NULL;
+        SOC_DMA_DESC_FIELDS_SET(&desc[i], 0, 1);
+        SOC_DMA_DESC_PUBLISH(&desc[i], 0, 1, SOC_DMA_BUF_DESC_STATUS_READY);
+    }
+
+    ring_buf->dma_next = 0;
+    ring_buf->app_next = 0;
+    ring_buf->done_next = 0;
+    ring_buf->desc_count = buf_desc_count;
+    ring_buf->desc_mask = buf_desc_count > 1 && (buf_desc_count & (buf_desc_count - 1)) == 0 ? buf_desc_count - 1 : 0;
+    ring_buf->wait_hook = NULL;
+    ring_buf->wait_hook_arg = NULL;
+#if SOC_DMA_RING_MULTI_PRODUCER
+    ring_buf->multi_producer = 0;
+#endif
+
+    /*
+     * The hub ignores a ring until its descriptors are set, so they are
+     * set last. The ring may then be initialized while the hub is running,
+     * as it is when its device's init is deferred.
+     */
+    RTOS_MEMORY_BARRIER();
+    ring_buf->desc = desc;
+}
+
+void soc_dma_ring_buf_wait_hook_set(
+        soc_dma_ring_buf_t *ring_buf,
+        soc_dma_ring_wait_hook_t wait_hook,
+        void *arg)
+{
+    ring_buf->wait_hook_arg = arg;
+    ring_buf->wait_hook = wait_hook;
+}
 
 /*
- * The buffer descriptor status when a DMA transmit operation
- * on it has just completed. The application should receive
- * these by calling soc_dma_ring_tx_buf_get().
+ * Waits for a descriptor to be ready for a new buffer, with
+ * the ring's wait hook if it has one.
  */
-#define SOC_DMA_BUF_DESC_STATUS_TX_DONE  2
+static void tx_desc_wait(
+        soc_dma_ring_buf_t *ring_buf,
+        int index)
+{
+    while (SOC_DMA_DESC_STATUS(&ring_buf->desc[index]) != SOC_DMA_BUF_DESC_STATUS_READY) {
+        if (ring_buf->wait_hook != NULL) {
+            ring_buf->wait_hook(ring_buf, ring_buf->wait_hook_arg);
+        }
+    }
+}
+
+#if SOC_DMA_RING_MULTI_PRODUCER
+
+void soc_dma_ring_buf_multi_producer_set(
+        soc_dma_ring_buf_t *ring_buf,
+        int enable)
+{
+    ring_buf->multi_producer = enable;
+}
 
 /*
- * The buffer descriptor status when the application has sent
- * it to the DMA and is waiting for the operation to complete.
+ * Claims the count descriptors at app_next for the calling task of a
+ * multi-producer ring, if they are all ready, and moves app_next past
+ * them. Interrupts are masked while the lock is held, so that neither
+ * an ISR nor another task on the same core can claim them at the same
+ * time. Returns the index of the first, or -1 if they are not ready.
  */
-#define SOC_DMA_BUF_DESC_STATUS_WAITING  1
+static int tx_desc_reserve(
+        soc_dma_ring_buf_t *ring_buf,
+        int count)
+{
+    uint32_t mask;
+    int index;
+    int i;
+
+    mask = rtos_interrupt_mask_all();
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_DMA_RING);
+
+    index = ring_buf->app_next;
+    for (i = 0; i < count; i++) {
+        if (SOC_DMA_DESC_STATUS(&ring_buf->desc[soc_dma_ring_buf_add(ring_buf, index, i)]) != SOC_DMA_BUF_DESC_STATUS_READY) {
+            index = -1;
+            break;
+        }
+    }
+    if (index >= 0) {
+        for (i = 0; i < count; i++) {
+            SOC_DMA_DESC_PUBLISH(&ring_buf->desc[soc_dma_ring_buf_add(ring_buf, index, i)], 0, 1, SOC_DMA_BUF_DESC_STATUS_RESERVED);
+        }
+        ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, index, count);
+    }
+
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_DMA_RING);
+    rtos_interrupt_mask_set(mask);
+
+    return index;
+}
 
 /*
- * The buffer descriptor status when it is ready to be assigned
- * a new buffer by the application.
+ * Claims count descriptors of a multi-producer ring, waiting for them
+ * to be ready with the ring's wait hook if it has one.
  */
-#define SOC_DMA_BUF_DESC_STATUS_READY 0
+static int tx_desc_reserve_wait(
+        soc_dma_ring_buf_t *ring_buf,
+        int count)
+{
+    int index;
 
-struct soc_dma_buf_desc {
-    void *buf;
-    uint16_t length;
-    volatile uint8_t status;
-    uint8_t last;
-};
+    while ((index = tx_desc_reserve(ring_buf, count)) < 0) {
+        if (ring_buf->wait_hook != NULL) {
+            ring_buf->wait_hook(ring_buf, ring_buf->wait_hook_arg);
+        }
+    }
+
+    return index;
+}
+
+#endif /* SOC_DMA_RING_MULTI_PRODUCER */
+
+void soc_dma_ring_rx_buf_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void *buf,
+        soc_dma_length_t length)
+{
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->app_next];
 
-static int add(
+    xassert(SOC_DMA_DESC_STATUS(desc) == SOC_DMA_BUF_DESC_STATUS_READY);
+
+    desc->buf = buf;
+    SOC_DMA_DESC_SET(desc, length, 1, SOC_DMA_BUF_DESC_STATUS_WAITING);
+
+    ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, 1);
+}
+
+/*
+ * Fills in the descriptors for count buffers starting at first, and
+ * then hands them all to the DMA after a single barrier. The
+ * descriptors must all have status READY, or RESERVED by the calling
+ * task. Returns the index of the descriptor after them.
+ */
+static int bufs_set(
         soc_dma_ring_buf_t *ring_buf,
-        int i,
-        int n)
+        int first,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
 {
-    i += n;
-    if (i >= ring_buf->desc_count) {
-        i -= ring_buf->desc_count;
+    int i;
+    int index;
+
+    index = first;
+    for (i = 0; i < count; i++) {
+        ring_buf->desc[index].buf = bufs[i];
+        SOC_DMA_DESC_TIMESTAMP_SET(&ring_buf->desc[index], get_reference_time());
+        SOC_DMA_DESC_FIELDS_SET(&ring_buf->desc[index], lengths[i], 1);
+        index = soc_dma_ring_buf_add(ring_buf, index, 1);
     }
 
-    return i;
+    asm volatile( "" ::: "memory" );
+
+    index = first;
+    for (i = 0; i < count; i++) {
+        SOC_DMA_DESC_PUBLISH(&ring_buf->desc[index], lengths[i], 1, SOC_DMA_BUF_DESC_STATUS_WAITING);
+        index = soc_dma_ring_buf_add(ring_buf, index, 1);
+    }
+
+    return index;
 }
 
-void soc_dma_ring_buf_init(
+void soc_dma_ring_rx_bufs_set(
         soc_dma_ring_buf_t *ring_buf,
-        uint32_t *desc_buf,
-        int buf_desc_count)
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
 {
     int i;
+    int index;
 
-    ring_buf->dma_next = 0;
-    ring_buf->app_next = 0;
-    ring_buf->done_next = 0;
-    ring_buf->desc_count = buf_desc_count;
-    ring_buf->desc = (soc_dma_buf_desc_t *) desc_buf;
+    xassert(count <= ring_buf->desc_count);
 
-    for (i = 0; i < ring_buf->desc_count; i++) {
-        ring_buf->desc[i].buf = NULL;
-        ring_buf->desc[i].length = 0;
-        ring_buf->desc[i].last = 1;
-        ring_buf->desc[i].status = SOC_DMA_BUF_DESC_STATUS_READY;
+    index = ring_buf->app_next;
+    for (i = 0; i < count; i++) {
+        xassert(SOC_DMA_DESC_STATUS(&ring_buf->desc[index]) == SOC_DMA_BUF_DESC_STATUS_READY);
+        index = soc_dma_ring_buf_add(ring_buf, index, 1);
     }
+
+    ring_buf->app_next = bufs_set(ring_buf, ring_buf->app_next, bufs, lengths, count);
 }
 
-void soc_dma_ring_rx_buf_set(
+void soc_dma_ring_rx_buf_sg_set(
         soc_dma_ring_buf_t *ring_buf,
         void *buf,
-        uint16_t length)
+        soc_dma_length_t length,
+        int index,
+        int buf_count)
 {
-    xassert(ring_buf->desc[ring_buf->app_next].status == SOC_DMA_BUF_DESC_STATUS_READY);
+    int last;
 
-    ring_buf->desc[ring_buf->app_next].buf = buf;
-    ring_buf->desc[ring_buf->app_next].length = length;
-    ring_buf->desc[ring_buf->app_next].last = 1;
-    asm volatile( "" ::: "memory" );
-    ring_buf->desc[ring_buf->app_next].status = SOC_DMA_BUF_DESC_STATUS_WAITING;
+    xassert(buf_count <= ring_buf->desc_count);
+    xassert(index < buf_count);
+
+    last = (index == (buf_count - 1));
+    index = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, index);
 
-    ring_buf->app_next = add(ring_buf, ring_buf->app_next, 1);
+    xassert(SOC_DMA_DESC_STATUS(&ring_buf->desc[index]) == SOC_DMA_BUF_DESC_STATUS_READY);
+
+    ring_buf->desc[index].buf = buf;
+    SOC_DMA_DESC_SET(&ring_buf->desc[index], length, last, SOC_DMA_BUF_DESC_STATUS_WAITING);
+
+    if (index == ring_buf->app_next) {
+        ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, buf_count);
+    }
 }
 
 void *soc_dma_ring_rx_buf_get(
         soc_dma_ring_buf_t *ring_buf,
         int *length)
 {
-    void *buf = NULL;
+    return soc_dma_ring_rx_buf_get_inline(ring_buf, length);
+}
 
-    if (ring_buf->desc[ring_buf->done_next].status == SOC_DMA_BUF_DESC_STATUS_RX_DONE) {
+void *soc_dma_ring_rx_buf_sg_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more)
+{
+    return soc_dma_ring_rx_buf_sg_get_inline(ring_buf, length, more);
+}
 
-        if (length != NULL) {
-            *length = ring_buf->desc[ring_buf->done_next].length;
+#if SOC_DMA_BUF_DESC_META
+void *soc_dma_ring_rx_buf_ex_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more,
+        uint32_t *timestamp,
+        uint32_t *meta)
+{
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->done_next];
+    void *buf;
+
+    /* As in soc_dma_ring_rx_buf_ts_get(), the descriptor may still be read once got */
+    buf = soc_dma_ring_rx_buf_sg_get(ring_buf, length, more);
+    if (buf != NULL) {
+        if (timestamp != NULL) {
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+            *timestamp = desc->timestamp;
+#else
+            *timestamp = 0;
+#endif
+        }
+        if (meta != NULL) {
+            *meta = desc->meta;
         }
+    }
 
-        buf = ring_buf->desc[ring_buf->done_next].buf;
-        asm volatile( "" ::: "memory" );
-        ring_buf->desc[ring_buf->done_next].status = SOC_DMA_BUF_DESC_STATUS_READY;
-        ring_buf->done_next = add(ring_buf, ring_buf->done_next, 1);
+    return buf;
+}
+#endif
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+void *soc_dma_ring_rx_buf_ts_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        uint32_t *timestamp)
+{
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->done_next];
+    void *buf;
+
+    /*
+     * The descriptor is only rewritten by the application once it is
+     * ready, so its timestamp may still be read after it is got.
+     */
+    buf = soc_dma_ring_rx_buf_get(ring_buf, length);
+    if (buf != NULL && timestamp != NULL) {
+        *timestamp = desc->timestamp;
     }
 
     return buf;
 }
+#endif
+
+int soc_dma_ring_rx_bufs_get(
+        soc_dma_ring_buf_t *ring_buf,
+        void *bufs[],
+        int lengths[],
+        int max)
+{
+    int count = 0;
+
+    while (count < max) {
+        soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->done_next];
+        soc_dma_desc_info_t info = SOC_DMA_DESC_INFO(desc);
+
+        if (SOC_DMA_INFO_STATUS(info) != SOC_DMA_BUF_DESC_STATUS_RX_DONE) {
+            break;
+        }
+
+        if (lengths != NULL) {
+            lengths[count] = SOC_DMA_INFO_LENGTH(info);
+        }
+
+        bufs[count++] = desc->buf;
+        asm volatile( "" ::: "memory" );
+        SOC_DMA_DESC_PUBLISH(desc, SOC_DMA_INFO_LENGTH(info), SOC_DMA_INFO_LAST(info), SOC_DMA_BUF_DESC_STATUS_READY);
+        ring_buf->done_next = soc_dma_ring_buf_add(ring_buf, ring_buf->done_next, 1);
+    }
+
+    return count;
+}
 
 void soc_dma_ring_tx_buf_set(
         soc_dma_ring_buf_t *ring_buf,
         void *buf,
-        uint16_t length)
+        soc_dma_length_t length)
 {
-    while (ring_buf->desc[ring_buf->app_next].status != SOC_DMA_BUF_DESC_STATUS_READY);
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->app_next];
 
-    ring_buf->desc[ring_buf->app_next].buf = buf;
-    ring_buf->desc[ring_buf->app_next].length = length;
-    ring_buf->desc[ring_buf->app_next].last = 1;
-    asm volatile( "" ::: "memory" );
-    ring_buf->desc[ring_buf->app_next].status = SOC_DMA_BUF_DESC_STATUS_WAITING;
+#if SOC_DMA_RING_MULTI_PRODUCER
+    if (ring_buf->multi_producer) {
+        (void) bufs_set(ring_buf, tx_desc_reserve_wait(ring_buf, 1), &buf, &length, 1);
+        return;
+    }
+#endif
+
+    tx_desc_wait(ring_buf, ring_buf->app_next);
+
+    desc->buf = buf;
+    SOC_DMA_DESC_TIMESTAMP_SET(desc, get_reference_time());
+    SOC_DMA_DESC_SET(desc, length, 1, SOC_DMA_BUF_DESC_STATUS_WAITING);
+
+    ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, 1);
+}
+
+int soc_dma_ring_tx_buf_try_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void *buf,
+        soc_dma_length_t length)
+{
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->app_next];
+
+#if SOC_DMA_RING_MULTI_PRODUCER
+    if (ring_buf->multi_producer) {
+        int index = tx_desc_reserve(ring_buf, 1);
+        if (index < 0) {
+            return -1;
+        }
+        (void) bufs_set(ring_buf, index, &buf, &length, 1);
+        return 0;
+    }
+#endif
+
+    if (SOC_DMA_DESC_STATUS(desc) != SOC_DMA_BUF_DESC_STATUS_READY) {
+        return -1;
+    }
+
+    desc->buf = buf;
+    SOC_DMA_DESC_TIMESTAMP_SET(desc, get_reference_time());
+    SOC_DMA_DESC_SET(desc, length, 1, SOC_DMA_BUF_DESC_STATUS_WAITING);
+
+    ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, 1);
+
+    return 0;
+}
+
+void soc_dma_ring_tx_bufs_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
+{
+    int i;
+    int index;
+
+    xassert(count <= ring_buf->desc_count);
+
+#if SOC_DMA_RING_MULTI_PRODUCER
+    if (ring_buf->multi_producer) {
+        (void) bufs_set(ring_buf, tx_desc_reserve_wait(ring_buf, count), bufs, lengths, count);
+        return;
+    }
+#endif
+
+    index = ring_buf->app_next;
+    for (i = 0; i < count; i++) {
+        tx_desc_wait(ring_buf, index);
+        index = soc_dma_ring_buf_add(ring_buf, index, 1);
+    }
 
-    ring_buf->app_next = add(ring_buf, ring_buf->app_next, 1);
+    ring_buf->app_next = bufs_set(ring_buf, ring_buf->app_next, bufs, lengths, count);
 }
 
 void soc_dma_ring_tx_buf_sg_set(
         soc_dma_ring_buf_t *ring_buf,
         void *buf,
-        uint16_t length,
+        soc_dma_length_t length,
         int index,
         int buf_count)
 {
@@ -138,21 +420,55 @@ void soc_dma_ring_tx_buf_sg_set(
 
     xassert(buf_count <= ring_buf->desc_count);
     xassert(index < buf_count);
+#if SOC_DMA_RING_MULTI_PRODUCER
+    xassert(!ring_buf->multi_producer);
+#endif
 
     last = (index == (buf_count - 1));
-    index = add(ring_buf, ring_buf->app_next, index);
+    index = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, index);
 
-    while (ring_buf->desc[index].status != SOC_DMA_BUF_DESC_STATUS_READY);
+    tx_desc_wait(ring_buf, index);
 
     ring_buf->desc[index].buf = buf;
-    ring_buf->desc[index].length = length;
-    ring_buf->desc[index].last = last;
-    asm volatile( "" ::: "memory" );
-    ring_buf->desc[index].status = SOC_DMA_BUF_DESC_STATUS_WAITING;
+    SOC_DMA_DESC_TIMESTAMP_SET(&ring_buf->desc[index], get_reference_time());
+    SOC_DMA_DESC_SET(&ring_buf->desc[index], length, last, SOC_DMA_BUF_DESC_STATUS_WAITING);
+
+    if (index == ring_buf->app_next) {
+        ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, buf_count);
+    }
+}
+
+int soc_dma_ring_tx_buf_sg_try_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void *buf,
+        soc_dma_length_t length,
+        int index,
+        int buf_count)
+{
+    int last;
+
+    xassert(buf_count <= ring_buf->desc_count);
+    xassert(index < buf_count);
+#if SOC_DMA_RING_MULTI_PRODUCER
+    xassert(!ring_buf->multi_producer);
+#endif
+
+    last = (index == (buf_count - 1));
+    index = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, index);
+
+    if (SOC_DMA_DESC_STATUS(&ring_buf->desc[index]) != SOC_DMA_BUF_DESC_STATUS_READY) {
+        return -1;
+    }
+
+    ring_buf->desc[index].buf = buf;
+    SOC_DMA_DESC_TIMESTAMP_SET(&ring_buf->desc[index], get_reference_time());
+    SOC_DMA_DESC_SET(&ring_buf->desc[index], length, last, SOC_DMA_BUF_DESC_STATUS_WAITING);
 
     if (index == ring_buf->app_next) {
-        ring_buf->app_next = add(ring_buf, ring_buf->app_next, buf_count);
+        ring_buf->app_next = soc_dma_ring_buf_add(ring_buf, ring_buf->app_next, buf_count);
     }
+
+    return 0;
 }
 
 void *soc_dma_ring_tx_buf_get(
@@ -160,24 +476,59 @@ void *soc_dma_ring_tx_buf_get(
         int *length,
         int *more)
 {
-    void *buf = NULL;
+    return soc_dma_ring_tx_buf_get_inline(ring_buf, length, more);
+}
 
-    if (ring_buf->desc[ring_buf->done_next].status == SOC_DMA_BUF_DESC_STATUS_TX_DONE) {
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+void *soc_dma_ring_tx_buf_ts_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more,
+        uint32_t *timestamp)
+{
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->done_next];
+    void *buf;
 
-        if (length != NULL) {
-            *length = ring_buf->desc[ring_buf->done_next].length;
+    buf = soc_dma_ring_tx_buf_get(ring_buf, length, more);
+    if (buf != NULL && timestamp != NULL) {
+        *timestamp = desc->timestamp;
+    }
+
+    return buf;
+}
+#endif
+
+int soc_dma_ring_tx_bufs_get(
+        soc_dma_ring_buf_t *ring_buf,
+        void *bufs[],
+        int lengths[],
+        int more[],
+        int max)
+{
+    int count = 0;
+
+    while (count < max) {
+        soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->done_next];
+        soc_dma_desc_info_t info = SOC_DMA_DESC_INFO(desc);
+
+        if (SOC_DMA_INFO_STATUS(info) != SOC_DMA_BUF_DESC_STATUS_TX_DONE) {
+            break;
+        }
+
+        if (lengths != NULL) {
+            lengths[count] = SOC_DMA_INFO_LENGTH(info);
         }
         if (more != NULL) {
-            *more = !ring_buf->desc[ring_buf->done_next].last;
+            more[count] = !SOC_DMA_INFO_LAST(info);
         }
 
-        buf = ring_buf->desc[ring_buf->done_next].buf;
+        bufs[count++] = desc->buf;
         asm volatile( "" ::: "memory" );
-        ring_buf->desc[ring_buf->done_next].status = SOC_DMA_BUF_DESC_STATUS_READY;
-        ring_buf->done_next = add(ring_buf, ring_buf->done_next, 1);
+        SOC_DMA_DESC_PUBLISH(desc, SOC_DMA_INFO_LENGTH(info), SOC_DMA_INFO_LAST(info), SOC_DMA_BUF_DESC_STATUS_READY);
+        ring_buf->done_next = soc_dma_ring_buf_add(ring_buf, ring_buf->done_next, 1);
     }
 
-    return buf;
+    return count;
 }
 
 /*
@@ -190,11 +541,12 @@ int soc_dma_ring_buf_length_get(
     int last = 0;
     int i;
 
-    if (ring_buf->desc[ring_buf->dma_next].status == SOC_DMA_BUF_DESC_STATUS_WAITING) {
-        for (i = ring_buf->dma_next; !last; i = add(ring_buf, i, 1)) {
-            xassert(ring_buf->desc[i].status == SOC_DMA_BUF_DESC_STATUS_WAITING);
-            total_length += ring_buf->desc[i].length;
-            last = ring_buf->desc[i].last;
+    if (SOC_DMA_DESC_STATUS(&ring_buf->desc[ring_buf->dma_next]) == SOC_DMA_BUF_DESC_STATUS_WAITING) {
+        for (i = ring_buf->dma_next; !last; i = soc_dma_ring_buf_add(ring_buf, i, 1)) {
+            soc_dma_desc_info_t info = SOC_DMA_DESC_INFO(&ring_buf->desc[i]);
+            xassert(SOC_DMA_INFO_STATUS(info) == SOC_DMA_BUF_DESC_STATUS_WAITING);
+            total_length += SOC_DMA_INFO_LENGTH(info);
+            last = SOC_DMA_INFO_LAST(info);
         }
         return total_length;
     } else {
@@ -202,6 +554,44 @@ int soc_dma_ring_buf_length_get(
     }
 }
 
+/*
+ * To be called only by the peripheral hub, or by a device doing its own
+ * direct transfers. Returns the number of descriptors waiting for the
+ * DMA, and sets *done to the number that the DMA has completed but the
+ * application has not yet taken back.
+ */
+int soc_dma_ring_buf_occupancy_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *done)
+{
+    int waiting = 0;
+    int completed = 0;
+    int i;
+
+    for (i = ring_buf->dma_next;
+         waiting < ring_buf->desc_count && SOC_DMA_DESC_STATUS(&ring_buf->desc[i]) == SOC_DMA_BUF_DESC_STATUS_WAITING;
+         i = soc_dma_ring_buf_add(ring_buf, i, 1)) {
+        waiting++;
+    }
+
+    /* The completed descriptors are the ones just behind dma_next */
+    i = ring_buf->dma_next;
+    while (waiting + completed < ring_buf->desc_count) {
+        uint32_t status;
+
+        i = soc_dma_ring_buf_add(ring_buf, i, ring_buf->desc_count - 1);
+        status = SOC_DMA_DESC_STATUS(&ring_buf->desc[i]);
+        if (status != SOC_DMA_BUF_DESC_STATUS_RX_DONE && status != SOC_DMA_BUF_DESC_STATUS_TX_DONE) {
+            break;
+        }
+        completed++;
+    }
+
+    *done = completed;
+
+    return waiting;
+}
+
 /*
  * To be called only by the peripheral hub
  */
@@ -210,19 +600,48 @@ void *soc_dma_ring_buf_get(
         int *length,
         int *more)
 {
-    if (ring_buf->desc[ring_buf->dma_next].status == SOC_DMA_BUF_DESC_STATUS_WAITING) {
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->dma_next];
+    soc_dma_desc_info_t info = SOC_DMA_DESC_INFO(desc);
+
+    if (SOC_DMA_INFO_STATUS(info) == SOC_DMA_BUF_DESC_STATUS_WAITING) {
         if (length != NULL) {
-            *length = ring_buf->desc[ring_buf->dma_next].length;
+            *length = SOC_DMA_INFO_LENGTH(info);
         }
         if (more != NULL) {
-            *more = !ring_buf->desc[ring_buf->dma_next].last;
+            *more = !SOC_DMA_INFO_LAST(info);
         }
-        return ring_buf->desc[ring_buf->dma_next].buf;
+        return desc->buf;
     } else {
         return NULL;
     }
 }
 
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+/*
+ * To be called only by the peripheral hub, before the descriptor
+ * is released.
+ */
+void soc_dma_ring_buf_timestamp_set(
+        soc_dma_ring_buf_t *ring_buf,
+        uint32_t timestamp)
+{
+    SOC_DMA_DESC_TIMESTAMP_SET(&ring_buf->desc[ring_buf->dma_next], timestamp);
+}
+#endif
+
+#if SOC_DMA_BUF_DESC_META
+/*
+ * To be called only by the peripheral hub, before the descriptor
+ * is released.
+ */
+void soc_dma_ring_buf_meta_set(
+        soc_dma_ring_buf_t *ring_buf,
+        uint32_t meta)
+{
+    ring_buf->desc[ring_buf->dma_next].meta = meta;
+}
+#endif
+
 /*
  * To be called only by the peripheral hub
  */
@@ -231,10 +650,11 @@ void soc_dma_ring_buf_release(
         int rx,
         int length)
 {
-    xassert(ring_buf->desc[ring_buf->dma_next].status == SOC_DMA_BUF_DESC_STATUS_WAITING);
-    ring_buf->desc[ring_buf->dma_next].length = length;
-    asm volatile( "" ::: "memory" );
-    ring_buf->desc[ring_buf->dma_next].status = rx ? SOC_DMA_BUF_DESC_STATUS_RX_DONE : SOC_DMA_BUF_DESC_STATUS_TX_DONE;
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->dma_next];
+    soc_dma_desc_info_t info = SOC_DMA_DESC_INFO(desc);
+
+    xassert(SOC_DMA_INFO_STATUS(info) == SOC_DMA_BUF_DESC_STATUS_WAITING);
+    SOC_DMA_DESC_SET(desc, length, SOC_DMA_INFO_LAST(info), rx ? SOC_DMA_BUF_DESC_STATUS_RX_DONE : SOC_DMA_BUF_DESC_STATUS_TX_DONE);
 
-    ring_buf->dma_next = add(ring_buf, ring_buf->dma_next, 1);
+    ring_buf->dma_next = soc_dma_ring_buf_add(ring_buf, ring_buf->dma_next, 1);
 }
@@ -0,0 +1,196 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "soc.h"
+#include "rtos_support.h"
+
+#include "xassert.h"
+
+/*
+ * The header word at the start of each packet. The length is
+ * the length of a message, or the number of credits returned.
+ */
+#define MSG_HEADER(type, src, length)  (((type) << 24) | ((src) << 16) | (length))
+#define MSG_HEADER_TYPE(header)        ((header) >> 24)
+#define MSG_HEADER_SRC(header)         (((header) >> 16) & 0xFF)
+#define MSG_HEADER_LENGTH(header)      ((header) & 0xFFFF)
+
+#define MSG_TYPE_DATA   0
+#define MSG_TYPE_CREDIT 1
+
+#define MSG_WORDS(length) (((length) + sizeof(uint32_t) - 1) / sizeof(uint32_t))
+
+static void msg_packet_begin(
+        soc_msg_endpoint_t *ep,
+        int dst_tile,
+        uint32_t header)
+{
+    chanend_set_dest(ep->tx_c, ep->peer[dst_tile]);
+    s_chan_out_word(ep->tx_c, header);
+}
+
+void soc_msg_endpoint_init(
+        soc_msg_endpoint_t *ep,
+        int tile,
+        chanend xTile0Chan,
+        chanend xTile1Chan,
+        chanend xTile2Chan,
+        chanend xTile3Chan)
+{
+    chanend tile_chan[SOC_MSG_TILE_COUNT] = {xTile0Chan, xTile1Chan, xTile2Chan, xTile3Chan};
+    int i;
+
+    xassert(tile >= 0 && tile < SOC_MSG_TILE_COUNT);
+    xassert(tile_chan[tile] == 0);
+
+    memset(ep, 0, sizeof(*ep));
+    ep->tile = tile;
+
+    chanend_alloc(&ep->rx_c);
+    xassert(ep->rx_c != 0);
+    chanend_alloc(&ep->tx_c);
+    xassert(ep->tx_c != 0);
+
+    /*
+     * Each pair of tiles swaps mailboxes over the channel between them.
+     * Every tile visits the others in the same order, so no two are
+     * ever waiting on each other for a different pair.
+     */
+    for (i = 0; i < SOC_MSG_TILE_COUNT; i++) {
+        if (tile_chan[i] != 0) {
+            s_chan_out_word(tile_chan[i], ep->rx_c);
+            s_chan_out_ct_end(tile_chan[i]);
+            s_chan_in_word(tile_chan[i], (uint32_t *) &ep->peer[i]);
+            s_chan_check_ct_end(tile_chan[i]);
+        }
+    }
+}
+
+void soc_msg_endpoint_receiver(
+        soc_msg_endpoint_t *ep)
+{
+    uint32_t header;
+    int src;
+    int length;
+    soc_msg_slot_t *slot;
+
+    for (;;) {
+        s_chan_in_word(ep->rx_c, &header);
+        src = MSG_HEADER_SRC(header);
+        length = MSG_HEADER_LENGTH(header);
+        xassert(src < SOC_MSG_TILE_COUNT && ep->peer[src] != 0);
+
+        if (MSG_HEADER_TYPE(header) == MSG_TYPE_CREDIT) {
+            ep->tx_credits_returned[src] += length;
+        } else {
+            /*
+             * The sender held a credit for this message, so there
+             * is always a free slot for it and it is never refused.
+             */
+            xassert(ep->slot_in - ep->slot_out < SOC_MSG_SLOT_COUNT);
+            xassert(length <= SOC_MSG_MAX_LEN);
+
+            slot = &ep->slot[ep->slot_in % SOC_MSG_SLOT_COUNT];
+            slot->src = src;
+            slot->length = length;
+            s_chan_in_buf_word(ep->rx_c, slot->data, MSG_WORDS(length));
+
+            /* The slot must be filled in before the application can see it */
+            RTOS_MEMORY_BARRIER();
+            ep->slot_in++;
+        }
+
+        s_chan_check_ct_end(ep->rx_c);
+    }
+}
+
+int soc_msg_send(
+        soc_msg_endpoint_t *ep,
+        int dst_tile,
+        const void *msg,
+        size_t length)
+{
+    uint32_t state;
+
+    xassert(dst_tile >= 0 && dst_tile < SOC_MSG_TILE_COUNT && ep->peer[dst_tile] != 0);
+    xassert(length <= SOC_MSG_MAX_LEN);
+    xassert(((uintptr_t) msg & 3) == 0);
+
+    if (ep->tx_credits_used[dst_tile] - ep->tx_credits_returned[dst_tile] >= SOC_MSG_CREDITS) {
+        return -1;
+    }
+    ep->tx_credits_used[dst_tile]++;
+
+    /*
+     * Interrupts are masked so that the packet is not left half sent,
+     * holding its route through the switch open, while an ISR runs.
+     */
+    state = rtos_interrupt_mask_all();
+
+    msg_packet_begin(ep, dst_tile, MSG_HEADER(MSG_TYPE_DATA, ep->tile, length));
+    s_chan_out_buf_word(ep->tx_c, msg, MSG_WORDS(length));
+    s_chan_out_ct_end(ep->tx_c);
+
+    rtos_interrupt_mask_set(state);
+
+    return 0;
+}
+
+int soc_msg_try_receive(
+        soc_msg_endpoint_t *ep,
+        int *src_tile,
+        void *msg,
+        size_t max_length)
+{
+    soc_msg_slot_t *slot;
+    int length;
+    int src;
+    uint32_t state;
+
+    if (ep->slot_in == ep->slot_out) {
+        return -1;
+    }
+
+    /* The slot must not be read before the receiver has filled it in */
+    RTOS_MEMORY_BARRIER();
+
+    slot = &ep->slot[ep->slot_out % SOC_MSG_SLOT_COUNT];
+    length = slot->length;
+    if (length > max_length) {
+        return -2;
+    }
+
+    src = slot->src;
+    memcpy(msg, slot->data, length);
+    if (src_tile != NULL) {
+        *src_tile = src;
+    }
+
+    /* The slot must be read before the receiver may fill it in again */
+    RTOS_MEMORY_BARRIER();
+    ep->slot_out++;
+
+    /* The slot is free again, so the credit goes back to the sender */
+    state = rtos_interrupt_mask_all();
+
+    msg_packet_begin(ep, src, MSG_HEADER(MSG_TYPE_CREDIT, ep->tile, 1));
+    s_chan_out_ct_end(ep->tx_c);
+
+    rtos_interrupt_mask_set(state);
+
+    return length;
+}
+
+int soc_msg_receive(
+        soc_msg_endpoint_t *ep,
+        int *src_tile,
+        void *msg,
+        size_t max_length)
+{
+    int length;
+
+    while ((length = soc_msg_try_receive(ep, src_tile, msg, max_length)) == -1);
+
+    return length;
+}
@@ -4,6 +4,108 @@
 #include <stdint.h>
 
 #include "rtos_support.h"
+#include "soc.h"
+#include "soc_chan_buf.h"
+
+#include "xassert.h"
+
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+
+/*
+ * There is a chanend lock for each of the tile's chanends, so that
+ * only transactions on the same chanend ever wait on one another.
+ * Those are all made by one device's driver, which serializes them
+ * with its control mutex, so a task never spins here on a lock that
+ * a task it has preempted holds.
+ */
+#define CONTROL_LOCK_COUNT 32
+
+static volatile int control_lock_held[CONTROL_LOCK_COUNT];
+
+/*
+ * Takes the lock for chanend c, and returns with interrupts masked.
+ * Interrupts are unmasked while waiting for it, so that a task that
+ * holds it may be switched back in if it is on the same core.
+ */
+static uint32_t control_lock_acquire(chanend c, int *lock)
+{
+    uint32_t state;
+    int acquired;
+
+    /* The resource number of the chanend is in bits 8 to 15 */
+    *lock = (((uint32_t) c) >> 8) & 0xFF;
+    xassert(*lock < CONTROL_LOCK_COUNT);
+
+    for (;;) {
+        state = rtos_interrupt_mask_all();
+
+        rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_CONTROL);
+        acquired = !control_lock_held[*lock];
+        if (acquired) {
+            control_lock_held[*lock] = 1;
+        }
+        rtos_lock_domain_release(RTOS_LOCK_DOMAIN_CONTROL);
+
+        if (acquired) {
+            return state;
+        }
+
+        rtos_interrupt_mask_set(state);
+    }
+}
+
+static void control_lock_release(int lock, uint32_t state)
+{
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_CONTROL);
+    control_lock_held[lock] = 0;
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_CONTROL);
+
+    rtos_interrupt_mask_set(state);
+}
+
+/*
+ * Lets any pending interrupts be taken between two chunks.
+ * The chanend lock stays held throughout.
+ */
+static uint32_t control_unmask_window(uint32_t state)
+{
+    rtos_interrupt_mask_set(state);
+    return rtos_interrupt_mask_all();
+}
+
+static void control_chunked_out(transacting_chanend_t *tc, const uint8_t *p, size_t length, uint32_t *state)
+{
+    size_t chunk;
+
+    for (;;) {
+        chunk = length < SOC_PERIPHERAL_CONTROL_CHUNK_SIZE ? length : SOC_PERIPHERAL_CONTROL_CHUNK_SIZE;
+        soc_t_chan_out_buf(tc, p, chunk);
+        p += chunk;
+        length -= chunk;
+        if (length == 0) {
+            break;
+        }
+        *state = control_unmask_window(*state);
+    }
+}
+
+static void control_chunked_in(transacting_chanend_t *tc, uint8_t *p, size_t length, uint32_t *state)
+{
+    size_t chunk;
+
+    for (;;) {
+        chunk = length < SOC_PERIPHERAL_CONTROL_CHUNK_SIZE ? length : SOC_PERIPHERAL_CONTROL_CHUNK_SIZE;
+        soc_t_chan_in_buf(tc, p, chunk);
+        p += chunk;
+        length -= chunk;
+        if (length == 0) {
+            break;
+        }
+        *state = control_unmask_window(*state);
+    }
+}
+
+#endif /* SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0 */
 
 void soc_peripheral_function_code_tx(
         chanend c,
@@ -25,8 +127,12 @@ void soc_peripheral_varlist_tx(
     transacting_chanend_t tc;
     va_list ap;
     int i;
-
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+    int lock;
+    uint32_t state = control_lock_acquire(c, &lock);
+#else
     uint32_t state = rtos_interrupt_mask_all();
+#endif
 
     chan_init_transaction_master(&c, &tc);
 
@@ -35,13 +141,21 @@ void soc_peripheral_varlist_tx(
         int arg_size = va_arg(ap, int);
         void *arg_ptr = va_arg(ap, void *);
 
-        t_chan_out_buf_byte(&tc, arg_ptr, arg_size);
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+        control_chunked_out(&tc, arg_ptr, arg_size, &state);
+#else
+        soc_t_chan_out_buf(&tc, arg_ptr, arg_size);
+#endif
     }
     va_end(ap);
 
     chan_complete_transaction(&c, &tc);
 
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+    control_lock_release(lock, state);
+#else
     rtos_interrupt_mask_set(state);
+#endif
 }
 
 void soc_peripheral_function_code_rx(
@@ -64,8 +178,12 @@ void soc_peripheral_varlist_rx(
     transacting_chanend_t tc;
     va_list ap;
     int i;
-
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+    int lock;
+    uint32_t state = control_lock_acquire(c, &lock);
+#else
     uint32_t state = rtos_interrupt_mask_all();
+#endif
 
     chan_init_transaction_slave(&c, &tc);
 
@@ -74,11 +192,204 @@ void soc_peripheral_varlist_rx(
         int arg_size = va_arg(ap, int);
         void *arg_ptr = va_arg(ap, void *);
 
-        t_chan_in_buf_byte(&tc, arg_ptr, arg_size);
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+        control_chunked_in(&tc, arg_ptr, arg_size, &state);
+#else
+        soc_t_chan_in_buf(&tc, arg_ptr, arg_size);
+#endif
     }
     va_end(ap);
 
     chan_complete_transaction(&c, &tc);
 
+#if SOC_PERIPHERAL_CONTROL_CHUNK_SIZE > 0
+    control_lock_release(lock, state);
+#else
+    rtos_interrupt_mask_set(state);
+#endif
+}
+
+void soc_peripheral_control_call(
+        chanend c,
+        uint8_t code,
+        int num_args,
+        int num_results,
+        ...)
+{
+    va_list ap;
+    int i;
+
+    uint32_t state = rtos_interrupt_mask_all();
+
+    va_start(ap, num_results);
+
+    s_chan_out_byte(c, code);
+    for (i = 0; i < num_args; i++) {
+        int arg_size = va_arg(ap, int);
+        void *arg_ptr = va_arg(ap, void *);
+
+        s_chan_out_buf_byte(c, arg_ptr, arg_size);
+    }
+    s_chan_out_ct_end(c);
+
+    if (num_results > 0) {
+        for (i = 0; i < num_results; i++) {
+            int arg_size = va_arg(ap, int);
+            void *arg_ptr = va_arg(ap, void *);
+
+            s_chan_in_buf_byte(c, arg_ptr, arg_size);
+        }
+        s_chan_check_ct_end(c);
+    }
+
+    va_end(ap);
+
     rtos_interrupt_mask_set(state);
 }
+
+void soc_peripheral_control_submit(
+        chanend c,
+        uint8_t code,
+        int num_args,
+        ...)
+{
+    va_list ap;
+    int i;
+
+    uint32_t state = rtos_interrupt_mask_all();
+
+    va_start(ap, num_args);
+
+    s_chan_out_byte(c, code | SOC_PERIPHERAL_CONTROL_ASYNC);
+    for (i = 0; i < num_args; i++) {
+        int arg_size = va_arg(ap, int);
+        void *arg_ptr = va_arg(ap, void *);
+
+        s_chan_out_buf_byte(c, arg_ptr, arg_size);
+    }
+    s_chan_out_ct_end(c);
+
+    va_end(ap);
+
+    rtos_interrupt_mask_set(state);
+}
+
+void soc_peripheral_control_result_rx(
+        chanend c,
+        int num_results,
+        ...)
+{
+    va_list ap;
+    int i;
+
+    uint32_t state = rtos_interrupt_mask_all();
+
+    va_start(ap, num_results);
+    for (i = 0; i < num_results; i++) {
+        int arg_size = va_arg(ap, int);
+        void *arg_ptr = va_arg(ap, void *);
+
+        s_chan_in_buf_byte(c, arg_ptr, arg_size);
+    }
+    va_end(ap);
+
+    s_chan_check_ct_end(c);
+
+    rtos_interrupt_mask_set(state);
+}
+
+void soc_peripheral_control_code_rx(
+        chanend c,
+        uint8_t *code)
+{
+    uint32_t state = rtos_interrupt_mask_all();
+
+    s_chan_in_byte(c, code);
+
+    rtos_interrupt_mask_set(state);
+}
+
+void soc_peripheral_control_args_rx(
+        chanend c,
+        int num_args,
+        ...)
+{
+    va_list ap;
+    int i;
+
+    uint32_t state = rtos_interrupt_mask_all();
+
+    va_start(ap, num_args);
+    for (i = 0; i < num_args; i++) {
+        int arg_size = va_arg(ap, int);
+        void *arg_ptr = va_arg(ap, void *);
+
+        s_chan_in_buf_byte(c, arg_ptr, arg_size);
+    }
+    va_end(ap);
+
+    rtos_interrupt_mask_set(state);
+}
+
+static void control_results_tx(
+        chanend c,
+        chanend irq_c,
+        uint8_t code,
+        int num_results,
+        va_list ap)
+{
+    int i;
+
+    uint32_t state = rtos_interrupt_mask_all();
+
+    s_chan_check_ct_end(c);
+
+    if ((code & SOC_PERIPHERAL_CONTROL_ASYNC) != 0) {
+        xassert(irq_c != 0);
+        soc_peripheral_irq_send(irq_c, SOC_PERIPHERAL_ISR_CONTROL_DONE_BM);
+    }
+
+    /*
+     * The driver does not wait for a reply to a synchronous call
+     * with no return values, but always receives one to an
+     * asynchronous call.
+     */
+    if (num_results > 0 || (code & SOC_PERIPHERAL_CONTROL_ASYNC) != 0) {
+        for (i = 0; i < num_results; i++) {
+            int arg_size = va_arg(ap, int);
+            void *arg_ptr = va_arg(ap, void *);
+
+            s_chan_out_buf_byte(c, arg_ptr, arg_size);
+        }
+
+        s_chan_out_ct_end(c);
+    }
+
+    rtos_interrupt_mask_set(state);
+}
+
+void soc_peripheral_control_results_tx(
+        chanend c,
+        int num_results,
+        ...)
+{
+    va_list ap;
+
+    va_start(ap, num_results);
+    control_results_tx(c, 0, 0, num_results, ap);
+    va_end(ap);
+}
+
+void soc_peripheral_control_results_irq_tx(
+        chanend c,
+        chanend irq_c,
+        uint8_t code,
+        int num_results,
+        ...)
+{
+    va_list ap;
+
+    va_start(ap, num_results);
+    control_results_tx(c, irq_c, code, num_results, ap);
+    va_end(ap);
+}
@@ -3,12 +3,20 @@
 #include <string.h>
 
 #include "soc.h"
+#include "soc_chan_buf.h"
 
 #include "xassert.h"
 
+#if SOC_PERIPHERAL_XSCOPE_PROBES
+#include <xscope.h>
+#define dma_probe(probe_id, device, ring) xscope_int((probe_id), ((ring) << 16) | (device)->id)
+#else
+#define dma_probe(probe_id, device, ring)
+#endif
+
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
-#define MAX_PERIPHERALS 8
+#define MAX_PERIPHERALS SOC_MAX_PERIPHERALS
 
 int soc_dma_ring_buf_length_get(
         soc_dma_ring_buf_t *ring_buf);
@@ -23,24 +31,226 @@ void soc_dma_ring_buf_release(
         int rx,
         int length);
 
+int soc_dma_ring_buf_occupancy_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *done);
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+void soc_dma_ring_buf_timestamp_set(
+        soc_dma_ring_buf_t *ring_buf,
+        uint32_t timestamp);
+#endif
+
+#if SOC_DMA_BUF_DESC_META
+void soc_dma_ring_buf_meta_set(
+        soc_dma_ring_buf_t *ring_buf,
+        uint32_t meta);
+#endif
+
+/*
+ * Set in the length word sent by a device ahead of its data when it
+ * is followed by a timestamp word, see soc_peripheral_tx_dma_ts_xfer().
+ */
+#define DMA_XFER_TIMESTAMP_FLAG 0x80000000
+
+/*
+ * Set in the length word sent by a device ahead of its data when it is
+ * followed by a metadata word, after any timestamp word. See
+ * soc_peripheral_tx_dma_ex_xfer().
+ */
+#define DMA_XFER_META_FLAG      0x40000000
+
+/*
+ * The word sent by the RTOS with each request to the peripheral
+ * hub, saying which device and which of its rings it is for.
+ */
+#define HUB_REQUEST_WORD(device_id, request) (((uint32_t) (device_id) << 1) | (request))
+#define HUB_REQUEST_DEVICE(word)             ((word) >> 1)
+#define HUB_REQUEST_TYPE(word)               ((word) & 1)
+
 /*
- * The channel end used by the peripheral hub to
- * interrupt the RTOS and to receive requests
- * from the RTOS.
+ * Bitmaps of the devices whose TX and RX channel triggers must be
+ * re-armed, because either the hub has just completed a transfer for
+ * them or the RTOS has changed their ring. Only the hub uses these.
  */
-static chanend rtos_irq_c;
+#define HUB_DIRTY_WORDS ((MAX_PERIPHERALS + 31) / 32)
+
+#define HUB_DIRTY_SET(map, device_id) ((map)[(device_id) >> 5] |= 1UL << ((device_id) & 31))
+
+/*
+ * The events a hub instance waits for. The first three are
+ * each device's, the others belong to the hub instance.
+ */
+#define HUB_EVENT_TX            0   /* A device is ready to receive data */
+#define HUB_EVENT_RX            1   /* A device is sending data */
+#define HUB_EVENT_IRQ           2   /* A device is sending an IRQ */
+#define HUB_EVENT_RTOS_REQUEST  3   /* An RTOS task has changed a ring */
+#define HUB_EVENT_IRQ_DEADLINE  4   /* A deferred IRQ's deadline has passed */
+#define HUB_EVENT_TYPE_COUNT    5
+
+#define HUB_DEVICE_EVENT_COUNT  3
+
+#if SOC_PERIPHERAL_STATS
+/*
+ * A set of counters that only one thread updates. The writer makes
+ * seq odd while it updates them, so that a reader on another core can
+ * tell when it has read them part way through an update and must try
+ * again. This way the writer never waits for a reader.
+ */
+typedef struct {
+    volatile uint32_t seq;
+    soc_peripheral_stats_t counts;
+} stats_block_t;
+
+static void stats_begin(volatile uint32_t *seq)
+{
+    (*seq)++;
+    RTOS_MEMORY_BARRIER();
+}
+
+static void stats_end(volatile uint32_t *seq)
+{
+    RTOS_MEMORY_BARRIER();
+    (*seq)++;
+}
+
+static void stats_read(volatile uint32_t *seq, void *dst, const void *src, size_t size)
+{
+    uint32_t start;
+
+    do {
+        start = *seq;
+        RTOS_MEMORY_BARRIER();
+        memcpy(dst, src, size);
+        RTOS_MEMORY_BARRIER();
+    } while ((start & 1) != 0 || start != *seq);
+}
+#endif
+
+/*
+ * The state of one peripheral hub instance. Each instance runs on
+ * its own logical core and only touches the peripherals that
+ * SOC_PERIPHERAL_HUB_MAP() assigns to it, so none of this needs
+ * a lock.
+ */
+typedef struct {
+    int id;
+
+    /*
+     * The channel end used by the peripheral hub to
+     * interrupt the RTOS and to receive requests
+     * from the RTOS.
+     */
+    chanend rtos_irq_c;
+
+    /*
+     * The timer used by the peripheral hub to deliver
+     * IRQs that have been deferred by IRQ moderation.
+     */
+    hwtimer_t irq_moderation_tmr;
+
+    uint32_t dirty_tx[HUB_DIRTY_WORDS];
+    uint32_t dirty_rx[HUB_DIRTY_WORDS];
+
+    /* The number of devices with at least one deferred IRQ */
+    int irq_deferred_devices;
+
+#if SOC_PERIPHERAL_HUB_IRQ_BATCH
+    /*
+     * The IRQs raised by the peripheral hub while draining
+     * its events, sent together once they have all been handled.
+     */
+    rtos_irq_batch_t irq_batch;
+#endif
+
+#if SOC_PERIPHERAL_STATS
+    volatile uint32_t stats_seq;
+    soc_peripheral_hub_stats_t stats;
+#endif
+} hub_t;
+
+static hub_t hubs[SOC_PERIPHERAL_HUB_COUNT];
+
+/*
+ * A function that handles one type of hub event, for the device
+ * given by the event's ID. It must be defined with
+ * HUB_EVENT_HANDLER_ATTR.
+ */
+typedef void (*hub_event_handler_t)(hub_t *hub, int device_id);
+
+#define HUB_EVENT_HANDLER_ATTR __attribute__((fptrgroup("hub_event_handler")))
+
+/*
+ * The handler of one event and the device it is for. The ID that
+ * each event's resource is set up to return from select_wait() is the
+ * address of its hub_event_t, so the hub jumps straight to the handler
+ * with nothing to decode.
+ */
+typedef struct {
+    HUB_EVENT_HANDLER_ATTR hub_event_handler_t handler;
+    int device_id;
+} hub_event_t;
+
+static hub_event_t device_events[MAX_PERIPHERALS][HUB_DEVICE_EVENT_COUNT];
+static hub_event_t hub_events[SOC_PERIPHERAL_HUB_COUNT][HUB_EVENT_TYPE_COUNT - HUB_DEVICE_EVENT_COUNT];
+
+/*
+ * Set once hub instance 0 has started. The peripherals must all be
+ * registered by then, so the other instances wait for it before
+ * reading the peripheral table.
+ */
+static volatile int hub_started;
+
+/*
+ * The producers of a peripheral's interrupt status. The peripheral
+ * hub sets status on behalf of devices whose DMA it performs, and
+ * a device on the same tile may set its own status directly.
+ */
+#define STATUS_SLOT_HUB    0
+#define STATUS_SLOT_DIRECT 1
+#define STATUS_SLOT_COUNT  2
+
+#if SOC_PERIPHERAL_LOCKLESS_STATUS
+/*
+ * The bits that are pending in a slot are those that differ between
+ * posted and taken. posted is only written by the slot's producer and
+ * taken is only written by the ISR, so neither needs a lock. The
+ * direct slot's producer is whichever thread makes the device's
+ * direct calls, so these must all be made by the same one.
+ */
+typedef struct {
+    volatile uint32_t posted;
+    volatile uint32_t taken;
+} status_slot_t;
+#endif
 
 struct soc_peripheral {
 
     /* This device's ID */
     int id;
 
+    /* The hub instance that services this device */
+    int hub_id;
+
+    /*
+     * Set when the device sends its data with
+     * soc_peripheral_tx_dma_stream_xfer().
+     */
+    int rx_streaming;
+
     /* Channel used to send data to this device. */
     chanend tx_c;
 
     /* Channel used to receive data from this device. */
     chanend rx_c;
 
+    /*
+     * Channel used to receive data from this device when it was
+     * registered with SOC_PERIPHERAL_TX_DMA_REMOTE. It is serviced by
+     * soc_peripheral_tx_dma_remote_receiver() rather than by the hub.
+     */
+    chanend remote_rx_c;
+
     /* Channel used for control of this device. */
     chanend control_c;
 
@@ -59,21 +269,172 @@ struct soc_peripheral {
     /* The IRQ source ID number for this device. */
     int irq_source_id;
 
+    /*
+     * IRQ moderation. When irq_moderation_count is greater
+     * than 1, the hub defers the IRQ for completed DMA transfers
+     * until this many have completed, or until irq_moderation_ticks
+     * have elapsed since the first of them, whichever is first.
+     */
+    int irq_moderation_count;
+    uint32_t irq_moderation_ticks;
+
+    /* The number of completed DMA transfers with a deferred IRQ. */
+    int irq_deferred;
+
+    /* The time at which a deferred IRQ must be sent. */
+    uint32_t irq_deadline;
+
+    /* The ring occupancy watermarks. 0 when disabled. */
+    int rx_low_watermark;
+    int rx_high_watermark;
+    int tx_low_watermark;
+    int tx_high_watermark;
+
+#if SOC_PERIPHERAL_IRQ_AFFINITY
+    /* The ISR registered for this device, run by peripheral_isr() */
+    RTOS_IRQ_ISR_ATTR rtos_irq_isr_t isr;
+
+    /* Set while the ISR is running on any core */
+    volatile int isr_busy;
+
+    /* Set when the ISR must be run again by the core already running it */
+    volatile int isr_rerun;
+
+    /* The total time spent in this device's ISR */
+    uint32_t isr_ticks;
+
+    /* The value of isr_ticks at the previous call to soc_peripheral_irq_balance() */
+    uint32_t isr_ticks_balanced;
+#endif
+
     /* Interrupt status for the RTOS */
+#if SOC_PERIPHERAL_LOCKLESS_STATUS
+    status_slot_t interrupt_status[STATUS_SLOT_COUNT];
+
+    /* The logical core that posts to the direct slot, or -1 before it first does */
+    int direct_thread;
+#else
     uint32_t interrupt_status;
+#endif
 
     soc_dma_ring_buf_t tx_ring_buf;
     soc_dma_ring_buf_t rx_ring_buf;
 
+#if SOC_PERIPHERAL_STATS
+    /* The counters updated by the hub */
+    stats_block_t hub_stats;
+
+    /* The counters updated by the device's own direct transfers */
+    stats_block_t direct_stats;
+#endif
+
 };
 
 static struct soc_peripheral peripherals[MAX_PERIPHERALS];
 
 static int peripheral_count;
 
+/*
+ * Adds status to the device's interrupt status. slot is the
+ * producer setting it, and is ignored unless the lockless
+ * status mailbox is enabled.
+ */
+static void interrupt_status_post(
+        soc_peripheral_t device,
+        int slot,
+        uint32_t status)
+{
+#if SOC_PERIPHERAL_LOCKLESS_STATUS
+    status_slot_t *s = &device->interrupt_status[slot];
+    uint32_t pending;
+
+    if (slot == STATUS_SLOT_DIRECT) {
+        if (device->direct_thread < 0) {
+            device->direct_thread = get_logical_core_id();
+        }
+        xassert(device->direct_thread == get_logical_core_id());
+    }
+
+    /*
+     * Only toggle the bits that are not already pending. If the ISR
+     * takes a bit between the read of taken and the update of posted
+     * then it does so before it handles that bit, so the event being
+     * posted now is still seen by it.
+     */
+    pending = s->posted ^ s->taken;
+    s->posted ^= status & ~pending;
+#else
+    (void) slot;
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+    device->interrupt_status |= status;
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+#endif
+}
+
+/*
+ * Returns the watermark notifications due after a transfer that used
+ * desc_count descriptors of the ring, or 0 when none are due. Only
+ * crossings are reported, so each is sent once until the ring moves
+ * back to the other side of the watermark.
+ */
+static uint32_t dma_watermarks_check(
+        soc_dma_ring_buf_t *ring_buf,
+        int desc_count,
+        int low,
+        int high,
+        uint32_t low_bm,
+        uint32_t high_bm)
+{
+    uint32_t status = 0;
+    int waiting;
+    int done;
+
+    if (low == 0 && high == 0) {
+        return 0;
+    }
+
+    waiting = soc_dma_ring_buf_occupancy_get(ring_buf, &done);
+
+    if (low > 0 && waiting < low && waiting + desc_count >= low) {
+        status |= low_bm;
+    }
+    if (high > 0 && done >= high && done - desc_count < high) {
+        status |= high_bm;
+    }
+
+    return status;
+}
+
+static uint32_t rx_watermarks_check(
+        soc_peripheral_t device,
+        int desc_count)
+{
+    return dma_watermarks_check(&device->rx_ring_buf, desc_count,
+                                device->rx_low_watermark, device->rx_high_watermark,
+                                SOC_PERIPHERAL_ISR_DMA_RX_LOW_BM, SOC_PERIPHERAL_ISR_DMA_RX_HIGH_BM);
+}
+
+static uint32_t tx_watermarks_check(
+        soc_peripheral_t device,
+        int desc_count)
+{
+    return dma_watermarks_check(&device->tx_ring_buf, desc_count,
+                                device->tx_low_watermark, device->tx_high_watermark,
+                                SOC_PERIPHERAL_ISR_DMA_TX_LOW_BM, SOC_PERIPHERAL_ISR_DMA_TX_HIGH_BM);
+}
+
 /* To be called by the bitstream */
 soc_peripheral_t soc_peripheral_register(
         chanend c[SOC_PERIPHERAL_CHANNEL_COUNT])
+{
+    return soc_peripheral_register_flags(c, 0);
+}
+
+/* To be called by the bitstream */
+soc_peripheral_t soc_peripheral_register_flags(
+        chanend c[SOC_PERIPHERAL_CHANNEL_COUNT],
+        uint32_t flags)
 {
     int device_id;
 
@@ -82,14 +443,39 @@ soc_peripheral_t soc_peripheral_register(
     device_id = peripheral_count++;
 
     peripherals[device_id].id = device_id;
+    peripherals[device_id].hub_id = SOC_PERIPHERAL_HUB_MAP(device_id);
+    xassert(peripherals[device_id].hub_id >= 0 && peripherals[device_id].hub_id < SOC_PERIPHERAL_HUB_COUNT);
     peripherals[device_id].tx_c = c[SOC_PERIPHERAL_FROM_DMA_CH];
-    peripherals[device_id].rx_c = c[SOC_PERIPHERAL_TO_DMA_CH];
+    if (flags & SOC_PERIPHERAL_TX_DMA_REMOTE) {
+        peripherals[device_id].rx_c = 0;
+        peripherals[device_id].remote_rx_c = c[SOC_PERIPHERAL_TO_DMA_CH];
+    } else {
+        peripherals[device_id].rx_c = c[SOC_PERIPHERAL_TO_DMA_CH];
+        peripherals[device_id].remote_rx_c = 0;
+    }
+    peripherals[device_id].rx_streaming = (flags & SOC_PERIPHERAL_TX_DMA_STREAMING) != 0;
     peripherals[device_id].control_c = c[SOC_PERIPHERAL_CONTROL_CH];
     peripherals[device_id].irq_c = c[SOC_PERIPHERAL_IRQ_CH];
     peripherals[device_id].tx_ready = 0;
     peripherals[device_id].irq_source_id = -1;
+    peripherals[device_id].irq_moderation_count = 1;
+    peripherals[device_id].irq_moderation_ticks = 0;
+    peripherals[device_id].irq_deferred = 0;
+    peripherals[device_id].rx_low_watermark = 0;
+    peripherals[device_id].rx_high_watermark = 0;
+    peripherals[device_id].tx_low_watermark = 0;
+    peripherals[device_id].tx_high_watermark = 0;
     peripherals[device_id].app_data = NULL;
+#if SOC_PERIPHERAL_LOCKLESS_STATUS
+    memset(peripherals[device_id].interrupt_status, 0, sizeof(peripherals[device_id].interrupt_status));
+    peripherals[device_id].direct_thread = -1;
+#else
     peripherals[device_id].interrupt_status = 0;
+#endif
+#if SOC_PERIPHERAL_STATS
+    memset(&peripherals[device_id].hub_stats, 0, sizeof(peripherals[device_id].hub_stats));
+    memset(&peripherals[device_id].direct_stats, 0, sizeof(peripherals[device_id].direct_stats));
+#endif
 
     return &peripherals[device_id];
 }
@@ -100,10 +486,10 @@ void soc_peripheral_rx_dma_ready(
     s_chan_check_ct_end(c);
 }
 
-uint16_t soc_peripheral_rx_dma_xfer(
+soc_dma_length_t soc_peripheral_rx_dma_xfer(
         chanend c,
         void *data,
-        uint16_t max_length)
+        soc_dma_length_t max_length)
 {
     transacting_chanend_t tc;
     uint32_t length;
@@ -112,21 +498,22 @@ uint16_t soc_peripheral_rx_dma_xfer(
     t_chan_out_word(&tc, max_length);
     t_chan_in_word(&tc, &length);
     xassert(length <= max_length);
-    t_chan_in_buf_byte(&tc, data, length);
+    soc_t_chan_in_buf(&tc, data, length);
     chan_complete_transaction(&c, &tc);
 
-    return (uint16_t) length;
+    return (soc_dma_length_t) length;
 }
 
-uint16_t soc_peripheral_rx_dma_direct_xfer(
+soc_dma_length_t soc_peripheral_rx_dma_direct_xfer(
         soc_peripheral_t device,
         void *data,
-        uint16_t max_length)
+        soc_dma_length_t max_length)
 {
     void *tx_buf;
     int length;
     int total_length = 0;
     int more;
+    int desc_count = 0;
 
     if (device->tx_ring_buf.desc != NULL) {
         if (soc_dma_ring_buf_get(&device->tx_ring_buf, NULL, NULL) != NULL) {
@@ -140,65 +527,334 @@ uint16_t soc_peripheral_rx_dma_direct_xfer(
                 memcpy(data, tx_buf, length);
                 soc_dma_ring_buf_release(&device->tx_ring_buf, 0, length);
                 data += length;
+                desc_count++;
             } while (more);
 
-            rtos_lock_acquire(0);
-            device->interrupt_status |= SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM;
-            rtos_lock_release(0);
+#if SOC_PERIPHERAL_STATS
+            stats_begin(&device->direct_stats.seq);
+            device->direct_stats.counts.tx_bytes += total_length;
+            device->direct_stats.counts.tx_transfers++;
+            stats_end(&device->direct_stats.seq);
+#endif
+
+            dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_TX_REQUEST);
+
+            interrupt_status_post(device, STATUS_SLOT_DIRECT,
+                                  SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM | tx_watermarks_check(device, desc_count));
 
             rtos_irq(device->core_id, device->irq_source_id);
         }
     }
 
-    return (uint16_t) total_length;
+    return (soc_dma_length_t) total_length;
 }
 
 void soc_peripheral_tx_dma_xfer(
         chanend c,
         void *data,
-        uint16_t length)
+        soc_dma_length_t length)
 {
     transacting_chanend_t tc;
 
     chan_init_transaction_master(&c, &tc);
     t_chan_out_word(&tc, length);
-    t_chan_out_buf_byte(&tc, data, length);
+    soc_t_chan_out_buf(&tc, data, length);
+    chan_complete_transaction(&c, &tc);
+}
+
+void soc_peripheral_tx_dma_stream_xfer(
+        chanend c,
+        void *data,
+        soc_dma_length_t length)
+{
+    xassert(((uintptr_t) data & 3) == 0 && (length & 3) == 0);
+
+    /*
+     * No CT_END is sent, so the route to the hub opened by
+     * the first transfer stays open for all the others.
+     */
+    s_chan_out_word(c, length);
+    s_chan_out_buf_word(c, data, length / sizeof(uint32_t));
+}
+
+void soc_peripheral_tx_dma_ts_xfer(
+        chanend c,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp)
+{
+    transacting_chanend_t tc;
+
+    chan_init_transaction_master(&c, &tc);
+    t_chan_out_word(&tc, length | DMA_XFER_TIMESTAMP_FLAG);
+    t_chan_out_word(&tc, timestamp);
+    soc_t_chan_out_buf(&tc, data, length);
+    chan_complete_transaction(&c, &tc);
+}
+
+void soc_peripheral_tx_dma_ex_xfer(
+        chanend c,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp,
+        uint32_t meta)
+{
+    transacting_chanend_t tc;
+
+    chan_init_transaction_master(&c, &tc);
+    t_chan_out_word(&tc, length | DMA_XFER_TIMESTAMP_FLAG | DMA_XFER_META_FLAG);
+    t_chan_out_word(&tc, timestamp);
+    t_chan_out_word(&tc, meta);
+    soc_t_chan_out_buf(&tc, data, length);
     chan_complete_transaction(&c, &tc);
 }
 
 void soc_peripheral_tx_dma_direct_xfer(
         soc_peripheral_t device,
         void *data,
-        uint16_t length)
+        soc_dma_length_t length)
 {
-    void *rx_buf;
+    soc_peripheral_tx_dma_direct_ts_xfer(device, data, length, get_reference_time());
+}
+
+/*
+ * Copies count source buffers, one after the other, into the next frame
+ * of a device's RX ring, as if they were a single buffer.
+ */
+static void direct_rx_copy(
+        soc_peripheral_t device,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count,
+        uint32_t timestamp,
+        uint32_t meta)
+{
+    uint8_t *rx_buf;
     int max_length;
+    int length = 0;
     int more;
+    int desc_count = 0;
+    int s = 0;
+    int offset = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        length += lengths[i];
+    }
 
     if (device->rx_ring_buf.desc != NULL) {
+#if SOC_PERIPHERAL_STATS
+        if (soc_dma_ring_buf_get(&device->rx_ring_buf, NULL, NULL) == NULL) {
+            stats_begin(&device->direct_stats.seq);
+            device->direct_stats.counts.rx_stalls++;
+            stats_end(&device->direct_stats.seq);
+        }
+#endif
         while (soc_dma_ring_buf_get(&device->rx_ring_buf, NULL, NULL) == NULL);
 
         max_length = soc_dma_ring_buf_length_get(&device->rx_ring_buf);
         xassert(length <= max_length);
 
+#if SOC_PERIPHERAL_STATS
+        stats_begin(&device->direct_stats.seq);
+        device->direct_stats.counts.rx_bytes += length;
+        device->direct_stats.counts.rx_transfers++;
+        stats_end(&device->direct_stats.seq);
+#endif
+
         do {
+            int desc_length = 0;
+
             rx_buf = soc_dma_ring_buf_get(&device->rx_ring_buf, &max_length, &more);
             xassert(rx_buf != NULL);
-            max_length = MIN(length, max_length);
-            length -= max_length;
-            memcpy(rx_buf, data, max_length);
-            soc_dma_ring_buf_release(&device->rx_ring_buf, 1, max_length);
-            data += max_length;
+
+            while (max_length > 0 && s < count) {
+                int n = MIN(max_length, lengths[s] - offset);
+                memcpy(rx_buf + desc_length, (uint8_t *) bufs[s] + offset, n);
+                desc_length += n;
+                max_length -= n;
+                offset += n;
+                if (offset == lengths[s]) {
+                    s++;
+                    offset = 0;
+                }
+            }
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+            soc_dma_ring_buf_timestamp_set(&device->rx_ring_buf, timestamp);
+#endif
+#if SOC_DMA_BUF_DESC_META
+            soc_dma_ring_buf_meta_set(&device->rx_ring_buf, meta);
+#endif
+            soc_dma_ring_buf_release(&device->rx_ring_buf, 1, desc_length);
+            desc_count++;
         } while (more);
 
-        rtos_lock_acquire(0);
-        device->interrupt_status |= SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM;
-        rtos_lock_release(0);
+        dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_RX_REQUEST);
+
+        interrupt_status_post(device, STATUS_SLOT_DIRECT,
+                              SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM | rx_watermarks_check(device, desc_count));
+
+        rtos_irq(device->core_id, device->irq_source_id);
+    }
+}
+
+void soc_peripheral_tx_dma_direct_ts_xfer(
+        soc_peripheral_t device,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp)
+{
+    direct_rx_copy(device, &data, &length, 1, timestamp, 0);
+}
+
+void soc_peripheral_tx_dma_direct_ex_xfer(
+        soc_peripheral_t device,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp,
+        uint32_t meta)
+{
+    direct_rx_copy(device, &data, &length, 1, timestamp, meta);
+}
+
+void soc_peripheral_tx_dma_direct_gather_xfer(
+        soc_peripheral_t device,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
+{
+    direct_rx_copy(device, bufs, lengths, count, get_reference_time(), 0);
+}
+
+void soc_peripheral_tx_dma_gather_xfer(
+        chanend c,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
+{
+    transacting_chanend_t tc;
+    uint32_t length = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        length += lengths[i];
+    }
+
+    chan_init_transaction_master(&c, &tc);
+    t_chan_out_word(&tc, length);
+    for (i = 0; i < count; i++) {
+        soc_t_chan_out_buf(&tc, bufs[i], lengths[i]);
+    }
+    chan_complete_transaction(&c, &tc);
+}
+
+void soc_peripheral_tx_dma_stream_gather_xfer(
+        chanend c,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
+{
+    uint32_t length = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        xassert(((uintptr_t) bufs[i] & 3) == 0 && (lengths[i] & 3) == 0);
+        length += lengths[i];
+    }
+
+    s_chan_out_word(c, length);
+    for (i = 0; i < count; i++) {
+        s_chan_out_buf_word(c, bufs[i], lengths[i] / sizeof(uint32_t));
+    }
+}
+
+void *soc_peripheral_rx_dma_direct_get(
+        soc_peripheral_t device,
+        int *length,
+        int *more)
+{
+    if (device->tx_ring_buf.desc != NULL) {
+        return soc_dma_ring_buf_get(&device->tx_ring_buf, length, more);
+    } else {
+        return NULL;
+    }
+}
+
+void soc_peripheral_rx_dma_direct_commit(
+        soc_peripheral_t device)
+{
+    int length;
+    int more;
+    void *tx_buf;
+
+    tx_buf = soc_dma_ring_buf_get(&device->tx_ring_buf, &length, &more);
+    xassert(tx_buf != NULL);
+    soc_dma_ring_buf_release(&device->tx_ring_buf, 0, length);
+
+#if SOC_PERIPHERAL_STATS
+    stats_begin(&device->direct_stats.seq);
+    device->direct_stats.counts.tx_bytes += length;
+    if (!more) {
+        device->direct_stats.counts.tx_transfers++;
+    }
+    stats_end(&device->direct_stats.seq);
+#endif
+
+    if (!more) {
+        dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_TX_REQUEST);
+
+        interrupt_status_post(device, STATUS_SLOT_DIRECT, SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM);
 
         rtos_irq(device->core_id, device->irq_source_id);
     }
 }
 
+void *soc_peripheral_tx_dma_direct_get(
+        soc_peripheral_t device,
+        int *max_length)
+{
+    if (device->rx_ring_buf.desc != NULL) {
+        void *rx_buf = soc_dma_ring_buf_get(&device->rx_ring_buf, max_length, NULL);
+#if SOC_PERIPHERAL_STATS
+        if (rx_buf == NULL) {
+            stats_begin(&device->direct_stats.seq);
+            device->direct_stats.counts.rx_drops++;
+            stats_end(&device->direct_stats.seq);
+        }
+#endif
+        return rx_buf;
+    } else {
+        return NULL;
+    }
+}
+
+void soc_peripheral_tx_dma_direct_commit(
+        soc_peripheral_t device,
+        soc_dma_length_t length)
+{
+    void *rx_buf;
+    int max_length;
+
+    rx_buf = soc_dma_ring_buf_get(&device->rx_ring_buf, &max_length, NULL);
+    xassert(rx_buf != NULL);
+    xassert(length <= max_length);
+    soc_dma_ring_buf_release(&device->rx_ring_buf, 1, length);
+
+#if SOC_PERIPHERAL_STATS
+    stats_begin(&device->direct_stats.seq);
+    device->direct_stats.counts.rx_bytes += length;
+    device->direct_stats.counts.rx_transfers++;
+    stats_end(&device->direct_stats.seq);
+#endif
+
+    dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_RX_REQUEST);
+
+    interrupt_status_post(device, STATUS_SLOT_DIRECT, SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM);
+
+    rtos_irq(device->core_id, device->irq_source_id);
+}
+
 void soc_peripheral_irq_send(
         chanend c,
         uint32_t status)
@@ -210,13 +866,137 @@ void soc_peripheral_irq_direct_send(
         soc_peripheral_t device,
         uint32_t status)
 {
-    rtos_lock_acquire(0);
-    device->interrupt_status |= status;
-    rtos_lock_release(0);
+    interrupt_status_post(device, STATUS_SLOT_DIRECT, status);
 
     rtos_irq(device->core_id, device->irq_source_id);
 }
 
+#if SOC_PERIPHERAL_IRQ_AFFINITY
+/*
+ * Per RTOS core, the total time spent in peripheral ISRs.
+ * Each entry is only written by its own core.
+ */
+static uint32_t isr_core_ticks[RTOS_MAX_CORE_COUNT];
+
+/*
+ * Runs a peripheral's ISR and accounts for the time spent in it.
+ * This ensures that the ISR never runs on two cores at once when
+ * its IRQ is moved from one core to another. If it is already
+ * running then the core running it is asked to run it again.
+ */
+RTOS_IRQ_ISR_ATTR
+static void peripheral_isr(void *data)
+{
+    soc_peripheral_t device = data;
+    uint32_t start;
+    uint32_t ticks;
+    int rerun;
+
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+    if (device->isr_busy) {
+        device->isr_rerun = 1;
+        rtos_lock_domain_release(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+        return;
+    }
+    device->isr_busy = 1;
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+
+    do {
+        device->isr_rerun = 0;
+
+        start = get_reference_time();
+        device->isr(device);
+        ticks = get_reference_time() - start;
+
+        device->isr_ticks += ticks;
+        isr_core_ticks[rtos_core_id_get_inline()] += ticks;
+
+        rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+        rerun = device->isr_rerun;
+        if (!rerun) {
+            device->isr_busy = 0;
+        }
+        rtos_lock_domain_release(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+    } while (rerun);
+}
+
+void soc_peripheral_irq_core_set(
+        soc_peripheral_t device,
+        int core_id)
+{
+    xassert(core_id >= 0 && core_id < rtos_core_count());
+    device->core_id = core_id;
+}
+
+int soc_peripheral_irq_core_get(
+        soc_peripheral_t device)
+{
+    return device->core_id;
+}
+
+int soc_peripheral_irq_balance(
+        uint32_t threshold)
+{
+    static uint32_t core_ticks_balanced[RTOS_MAX_CORE_COUNT];
+    uint32_t core_load[RTOS_MAX_CORE_COUNT];
+    uint32_t device_load[MAX_PERIPHERALS];
+    int num_cores = rtos_core_count();
+    int busiest = 0;
+    int idlest = 0;
+    int best_device = -1;
+    uint32_t imbalance;
+    int i;
+
+    /* The load on each core and of each device since the previous call */
+    for (i = 0; i < num_cores; i++) {
+        uint32_t ticks = isr_core_ticks[i];
+        core_load[i] = ticks - core_ticks_balanced[i];
+        core_ticks_balanced[i] = ticks;
+
+        if (core_load[i] > core_load[busiest]) {
+            busiest = i;
+        }
+        if (core_load[i] < core_load[idlest]) {
+            idlest = i;
+        }
+    }
+
+    for (i = 0; i < peripheral_count; i++) {
+        uint32_t ticks = peripherals[i].isr_ticks;
+        device_load[i] = ticks - peripherals[i].isr_ticks_balanced;
+        peripherals[i].isr_ticks_balanced = ticks;
+    }
+
+    imbalance = core_load[busiest] - core_load[idlest];
+
+    if (imbalance <= threshold) {
+        return -1;
+    }
+
+    /*
+     * Move the device with the greatest load off the busiest core,
+     * provided that moving it reduces the imbalance between the
+     * busiest and the idlest cores.
+     */
+    for (i = 0; i < peripheral_count; i++) {
+        if (peripherals[i].irq_source_id >= 0 &&
+                peripherals[i].core_id == busiest &&
+                device_load[i] > 0 &&
+                device_load[i] < imbalance) {
+            if (best_device == -1 || device_load[i] > device_load[best_device]) {
+                best_device = i;
+            }
+        }
+    }
+
+    if (best_device != -1) {
+        soc_peripheral_irq_core_set(&peripherals[best_device], idlest);
+    }
+
+    return best_device;
+}
+#endif
+
 void soc_peripheral_handler_register(
         soc_peripheral_t device,
         int core_id,
@@ -225,7 +1005,67 @@ void soc_peripheral_handler_register(
 {
     device->core_id = core_id;
     device->app_data = app_data;
-    device->irq_source_id = rtos_irq_register(isr, device, rtos_irq_c);
+#if SOC_PERIPHERAL_IRQ_AFFINITY
+    device->isr = isr;
+    device->isr_busy = 0;
+    device->isr_rerun = 0;
+    device->isr_ticks = 0;
+    device->isr_ticks_balanced = 0;
+    device->irq_source_id = rtos_irq_register(peripheral_isr, device, hubs[device->hub_id].rtos_irq_c);
+#else
+    device->irq_source_id = rtos_irq_register(isr, device, hubs[device->hub_id].rtos_irq_c);
+#endif
+}
+
+void soc_peripheral_irq_priority_set(
+        soc_peripheral_t device,
+        int priority)
+{
+    xassert(device->irq_source_id >= 0);
+    rtos_irq_priority_set(device->irq_source_id, priority);
+}
+
+void soc_peripheral_irq_mask(
+        soc_peripheral_t device)
+{
+    xassert(device->irq_source_id >= 0);
+    rtos_irq_source_mask(device->irq_source_id);
+}
+
+void soc_peripheral_irq_unmask(
+        soc_peripheral_t device)
+{
+    xassert(device->irq_source_id >= 0);
+    rtos_irq_source_unmask(device->irq_source_id);
+}
+
+void soc_peripheral_irq_moderation_set(
+        soc_peripheral_t device,
+        int count,
+        uint32_t ticks)
+{
+    xassert(count >= 1);
+    xassert(count == 1 || ticks > 0);
+
+    device->irq_moderation_ticks = ticks;
+    device->irq_moderation_count = count;
+}
+
+void soc_peripheral_dma_watermarks_set(
+        soc_peripheral_t device,
+        soc_dma_request_t ring,
+        int low,
+        int high)
+{
+    xassert(low >= 0 && high >= 0);
+
+    if (ring == SOC_DMA_RX_REQUEST) {
+        device->rx_low_watermark = low;
+        device->rx_high_watermark = high;
+    } else {
+        device->tx_low_watermark = low;
+        device->tx_high_watermark = high;
+    }
 }
 
 void *soc_peripheral_app_data(
@@ -256,6 +1096,8 @@ void soc_peripheral_hub_dma_request(
         soc_peripheral_t device,
         soc_dma_request_t request)
 {
+    dma_probe(SOC_DMA_SUBMIT_PROBE_ID, device, request);
+
     if (request == SOC_DMA_TX_REQUEST) {
         if (device->tx_c != 0) {
             /*
@@ -266,7 +1108,7 @@ void soc_peripheral_hub_dma_request(
              * and that it may send them to the device when it is
              * ready.
              */
-            rtos_irq_peripheral(rtos_irq_c);
+            rtos_irq_peripheral_data(hubs[device->hub_id].rtos_irq_c, HUB_REQUEST_WORD(device->id, SOC_DMA_TX_REQUEST));
         } else if (device->control_c != 0) {
             /*
              * Otherwise, the peripheral itself must be told
@@ -284,7 +1126,7 @@ void soc_peripheral_hub_dma_request(
              * let it know that there are RX DMA buffers available
              * and that it may listen for data from the peripheral.
              */
-            rtos_irq_peripheral(rtos_irq_c);
+            rtos_irq_peripheral_data(hubs[device->hub_id].rtos_irq_c, HUB_REQUEST_WORD(device->id, SOC_DMA_RX_REQUEST));
         } else {
             /*
              * No need to tell the device directly that the
@@ -296,32 +1138,166 @@ void soc_peripheral_hub_dma_request(
     }
 }
 
+#if SOC_PERIPHERAL_STATS
+void soc_peripheral_stats_get(
+        soc_peripheral_t device,
+        soc_peripheral_stats_t *stats)
+{
+    soc_peripheral_stats_t direct;
+
+    stats_read(&device->hub_stats.seq, stats, &device->hub_stats.counts, sizeof(*stats));
+    stats_read(&device->direct_stats.seq, &direct, &device->direct_stats.counts, sizeof(direct));
+
+    stats->tx_bytes += direct.tx_bytes;
+    stats->rx_bytes += direct.rx_bytes;
+    stats->tx_transfers += direct.tx_transfers;
+    stats->rx_transfers += direct.rx_transfers;
+    stats->rx_stalls += direct.rx_stalls;
+    stats->rx_drops += direct.rx_drops;
+}
+
+void soc_peripheral_hub_stats_get(
+        int hub_id,
+        soc_peripheral_hub_stats_t *stats)
+{
+    xassert(hub_id >= 0 && hub_id < SOC_PERIPHERAL_HUB_COUNT);
+
+    stats_read(&hubs[hub_id].stats_seq, stats, &hubs[hub_id].stats, sizeof(*stats));
+}
+#endif /* SOC_PERIPHERAL_STATS */
+
 uint32_t soc_peripheral_interrupt_status(
         soc_peripheral_t device)
 {
     uint32_t status;
 
-    rtos_lock_acquire(0);
+#if SOC_PERIPHERAL_LOCKLESS_STATUS
+    int i;
+
+    status = 0;
+
+    for (i = 0; i < STATUS_SLOT_COUNT; i++) {
+        status_slot_t *s = &device->interrupt_status[i];
+        uint32_t posted = s->posted;
+
+        status |= posted ^ s->taken;
+        s->taken = posted;
+    }
+#else
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
     status = device->interrupt_status;
     device->interrupt_status = 0;
-    rtos_lock_release(0);
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_PERIPHERAL(device->id));
+#endif
 
     return status;
 }
 
-static void device_to_dma(soc_peripheral_t device)
+/*
+ * Sends the device's IRQ, along with any that have been deferred.
+ */
+static void hub_irq_send(soc_peripheral_t device)
+{
+    hub_t *hub = &hubs[device->hub_id];
+
+    if (device->irq_deferred > 0) {
+        device->irq_deferred = 0;
+        hub->irq_deferred_devices--;
+    }
+#if SOC_PERIPHERAL_HUB_IRQ_BATCH
+    rtos_irq_batch_add(&hub->irq_batch, device->core_id, device->irq_source_id);
+#else
+    (void) hub;
+    rtos_irq(device->core_id, device->irq_source_id);
+#endif
+}
+
+/*
+ * Called by the hub when it completes a DMA transfer for the device.
+ * Sends the IRQ now, or defers it when IRQ moderation is enabled.
+ */
+static void hub_irq_dma_done(soc_peripheral_t device)
+{
+    if (device->irq_moderation_count > 1) {
+        if (device->irq_deferred++ == 0) {
+            hub_t *hub = &hubs[device->hub_id];
+            uint32_t now;
+            hub->irq_deferred_devices++;
+            hwtimer_get_time(hub->irq_moderation_tmr, &now);
+            device->irq_deadline = now + device->irq_moderation_ticks;
+        }
+
+        if (device->irq_deferred < device->irq_moderation_count) {
+            return;
+        }
+    }
+
+    hub_irq_send(device);
+}
+
+/*
+ * Sends the deferred IRQs whose deadline has passed.
+ */
+static void hub_irq_deferred_flush(int hub_id)
+{
+    uint32_t now;
+    int i;
+
+    hwtimer_get_time(hubs[hub_id].irq_moderation_tmr, &now);
+
+    for (i = 0; i < peripheral_count; i++) {
+        if (peripherals[i].hub_id == hub_id && peripherals[i].irq_deferred > 0 && (int32_t) (now - peripherals[i].irq_deadline) >= 0) {
+            hub_irq_send(&peripherals[i]);
+        }
+    }
+}
+
+/*
+ * Receives one frame from a device over c into its RX ring.
+ * There must be at least one free buffer in the ring.
+ * Returns the number of descriptors the frame filled, and
+ * the frame's length in bytes.
+ */
+static int rx_frame_receive(soc_peripheral_t device, chanend c, uint32_t *bytes)
 {
     void *rx_buf;
     transacting_chanend_t tc;
     int length;
     uint32_t total_length;
+    uint32_t timestamp = 0;
+    uint32_t meta = 0;
     int more;
+    int desc_count = 0;
 
     length = soc_dma_ring_buf_length_get(&device->rx_ring_buf);
 
-    chan_init_transaction_slave(&device->rx_c, &tc);
-    t_chan_in_word(&tc, &total_length);
+    if (device->rx_streaming) {
+        s_chan_in_word(c, &total_length);
+        if (total_length & DMA_XFER_TIMESTAMP_FLAG) {
+            s_chan_in_word(c, &timestamp);
+        }
+        if (total_length & DMA_XFER_META_FLAG) {
+            s_chan_in_word(c, &meta);
+        }
+    } else {
+        chan_init_transaction_slave(&c, &tc);
+        t_chan_in_word(&tc, &total_length);
+        if (total_length & DMA_XFER_TIMESTAMP_FLAG) {
+            t_chan_in_word(&tc, &timestamp);
+        }
+        if (total_length & DMA_XFER_META_FLAG) {
+            t_chan_in_word(&tc, &meta);
+        }
+    }
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+    if ((total_length & DMA_XFER_TIMESTAMP_FLAG) == 0) {
+        timestamp = get_reference_time();
+    }
+#endif
+    total_length &= ~(DMA_XFER_TIMESTAMP_FLAG | DMA_XFER_META_FLAG);
     xassert(total_length <= length);
+    *bytes = total_length;
 
     do {
         rx_buf = soc_dma_ring_buf_get(&device->rx_ring_buf, &length, &more);
@@ -330,17 +1306,62 @@ static void device_to_dma(soc_peripheral_t device)
         length = MIN(total_length, length);
         total_length -= length;
 
-        t_chan_in_buf_byte(&tc, rx_buf, length);
+        if (device->rx_streaming) {
+            xassert(((uintptr_t) rx_buf & 3) == 0 && (length & 3) == 0);
+            s_chan_in_buf_word(c, rx_buf, length / sizeof(uint32_t));
+        } else {
+            soc_t_chan_in_buf(&tc, rx_buf, length);
+        }
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+        soc_dma_ring_buf_timestamp_set(&device->rx_ring_buf, timestamp);
+#endif
+#if SOC_DMA_BUF_DESC_META
+        soc_dma_ring_buf_meta_set(&device->rx_ring_buf, meta);
+#else
+        (void) meta;
+#endif
         soc_dma_ring_buf_release(&device->rx_ring_buf, 1, length);
+        desc_count++;
     } while (more);
 
-    chan_complete_transaction(&device->rx_c, &tc);
+    if (!device->rx_streaming) {
+        chan_complete_transaction(&c, &tc);
+    }
 
-    rtos_lock_acquire(0);
-    device->interrupt_status |= SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM;
-    rtos_lock_release(0);
+    return desc_count;
+}
 
-    rtos_irq(device->core_id, device->irq_source_id);
+static void device_to_dma(soc_peripheral_t device)
+{
+    int desc_count;
+    uint32_t watermarks;
+    uint32_t bytes;
+#if SOC_PERIPHERAL_STATS
+    uint32_t start_time = get_reference_time();
+#endif
+
+    desc_count = rx_frame_receive(device, device->rx_c, &bytes);
+
+#if SOC_PERIPHERAL_STATS
+    stats_begin(&device->hub_stats.seq);
+    device->hub_stats.counts.rx_bytes += bytes;
+    device->hub_stats.counts.rx_transfers++;
+    device->hub_stats.counts.rx_ticks += get_reference_time() - start_time;
+    stats_end(&device->hub_stats.seq);
+#endif
+
+    dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_RX_REQUEST);
+
+    watermarks = rx_watermarks_check(device, desc_count);
+
+    interrupt_status_post(device, STATUS_SLOT_HUB, SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM | watermarks);
+
+    if (watermarks != 0) {
+        /* Watermark notifications are not held back by IRQ moderation */
+        hub_irq_send(device);
+    } else {
+        hub_irq_dma_done(device);
+    }
 }
 
 static void dma_to_device_ready(soc_peripheral_t device)
@@ -357,9 +1378,21 @@ static void dma_to_device(soc_peripheral_t device)
     int total_length;
     uint32_t max_length;
     int more;
+    int desc_count = 0;
+    uint32_t watermarks;
+#if SOC_PERIPHERAL_STATS
+    uint32_t start_time = get_reference_time();
+#endif
 
     total_length = soc_dma_ring_buf_length_get(&device->tx_ring_buf);
 
+#if SOC_PERIPHERAL_STATS
+    stats_begin(&device->hub_stats.seq);
+    device->hub_stats.counts.tx_bytes += total_length;
+    device->hub_stats.counts.tx_transfers++;
+    stats_end(&device->hub_stats.seq);
+#endif
+
     chan_init_transaction_slave(&device->tx_c, &tc);
     t_chan_in_word(&tc, &max_length);
     xassert(total_length <= max_length);
@@ -370,8 +1403,9 @@ static void dma_to_device(soc_peripheral_t device)
         xassert(tx_buf != NULL);
         total_length -= length;
 
-        t_chan_out_buf_byte(&tc, tx_buf, length);
+        soc_t_chan_out_buf(&tc, tx_buf, length);
         soc_dma_ring_buf_release(&device->tx_ring_buf, 0, length);
+        desc_count++;
     } while (more);
 
     xassert(total_length == 0);
@@ -381,11 +1415,84 @@ static void dma_to_device(soc_peripheral_t device)
     xassert(device->tx_ready);
     device->tx_ready = 0;
 
-    rtos_lock_acquire(0);
-    device->interrupt_status |= SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM;
-    rtos_lock_release(0);
+#if SOC_PERIPHERAL_STATS
+    stats_begin(&device->hub_stats.seq);
+    device->hub_stats.counts.tx_ticks += get_reference_time() - start_time;
+    stats_end(&device->hub_stats.seq);
+#endif
 
-    rtos_irq(device->core_id, device->irq_source_id);
+    dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_TX_REQUEST);
+
+    watermarks = tx_watermarks_check(device, desc_count);
+
+    interrupt_status_post(device, STATUS_SLOT_HUB, SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM | watermarks);
+
+    if (watermarks != 0) {
+        /* Watermark notifications are not held back by IRQ moderation */
+        hub_irq_send(device);
+    } else {
+        hub_irq_dma_done(device);
+    }
+}
+
+/*
+ * Listens for a data request from the device if
+ * there is a buffer in its TX ring to send it.
+ */
+static void hub_tx_rearm(soc_peripheral_t device)
+{
+    if (device->tx_c != 0 && device->tx_ring_buf.desc != NULL) {
+        if (soc_dma_ring_buf_get(&device->tx_ring_buf, NULL, NULL) != NULL) {
+//            debug_printf("DMA to listen for data request from device %d\n", device->id);
+            chanend_enable_trigger(device->tx_c);
+
+            if (!device->tx_ready) {
+                dma_to_device_ready(device);
+            }
+        }
+    }
+}
+
+/*
+ * Listens for data from the device if there is
+ * a buffer in its RX ring to receive it into.
+ */
+static void hub_rx_rearm(soc_peripheral_t device)
+{
+    if (device->rx_c != 0 && device->rx_ring_buf.desc != NULL) {
+        if (soc_dma_ring_buf_get(&device->rx_ring_buf, NULL, NULL) != NULL) {
+//            debug_printf("DMA to listen for data from device %d\n", device->id);
+            chanend_enable_trigger(device->rx_c);
+        }
+#if SOC_PERIPHERAL_STATS
+        else {
+            /* The device may now be waiting for a free RX buffer */
+            stats_begin(&device->hub_stats.seq);
+            device->hub_stats.counts.rx_stalls++;
+            stats_end(&device->hub_stats.seq);
+        }
+#endif
+    }
+}
+
+/*
+ * Re-arms the triggers of the devices in a dirty bitmap
+ * and clears it.
+ */
+static void hub_rearm(uint32_t *dirty, void (*rearm)(soc_peripheral_t))
+{
+    int i;
+
+    for (i = 0; i < HUB_DIRTY_WORDS; i++) {
+        uint32_t bits = dirty[i];
+        dirty[i] = 0;
+
+        while (bits != 0) {
+            int bit = 31UL - ( uint32_t ) __builtin_clz( bits );
+            bits &= ~(1UL << bit);
+            rearm(&peripherals[32 * i + bit]);
+        }
+    }
 }
 
 static void device_to_hub_irq(soc_peripheral_t device)
@@ -394,127 +1501,287 @@ static void device_to_hub_irq(soc_peripheral_t device)
 
     chan_in_word(device->irq_c, &status);
 
-    rtos_lock_acquire(0);
-    device->interrupt_status |= status;
-    rtos_lock_release(0);
+    interrupt_status_post(device, STATUS_SLOT_HUB, status);
 
-    rtos_irq(device->core_id, device->irq_source_id);
+    hub_irq_send(device);
+}
+
+static HUB_EVENT_HANDLER_ATTR void hub_event_tx(hub_t *hub, int device_id)
+{
+    chanend_disable_trigger(peripherals[device_id].tx_c);
+    dma_to_device(&peripherals[device_id]);
+    HUB_DIRTY_SET(hub->dirty_tx, device_id);
+}
+
+static HUB_EVENT_HANDLER_ATTR void hub_event_rx(hub_t *hub, int device_id)
+{
+    chanend_disable_trigger(peripherals[device_id].rx_c);
+    device_to_dma(&peripherals[device_id]);
+    HUB_DIRTY_SET(hub->dirty_rx, device_id);
+}
+
+static HUB_EVENT_HANDLER_ATTR void hub_event_irq(hub_t *hub, int device_id)
+{
+    chanend_disable_trigger(peripherals[device_id].irq_c);
+    device_to_hub_irq(&peripherals[device_id]);
+    chanend_enable_trigger(peripherals[device_id].irq_c);
+}
+
+/*
+ * An RTOS task has added a new DMA buffer. Mark the ring it was
+ * added to so that the device's trigger is re-armed at the start
+ * of the loop.
+ */
+static HUB_EVENT_HANDLER_ATTR void hub_event_rtos_request(hub_t *hub, int unused)
+{
+    uint32_t request;
+
+    (void) unused;
+
+    s_chan_in_word(hub->rtos_irq_c, &request);
+    s_chan_check_ct_end(hub->rtos_irq_c);
+
+    xassert(HUB_REQUEST_DEVICE(request) < peripheral_count);
+    xassert(peripherals[HUB_REQUEST_DEVICE(request)].hub_id == hub->id);
+    if (HUB_REQUEST_TYPE(request) == SOC_DMA_TX_REQUEST) {
+        HUB_DIRTY_SET(hub->dirty_tx, HUB_REQUEST_DEVICE(request));
+    } else {
+        HUB_DIRTY_SET(hub->dirty_rx, HUB_REQUEST_DEVICE(request));
+    }
+}
+
+static HUB_EVENT_HANDLER_ATTR void hub_event_irq_deadline(hub_t *hub, int unused)
+{
+    (void) unused;
+
+    hwtimer_disable_trigger(hub->irq_moderation_tmr);
+    hub_irq_deferred_flush(hub->id);
+}
+
+/* Indexed by HUB_EVENT_* type */
+static HUB_EVENT_HANDLER_ATTR hub_event_handler_t const hub_event_handlers[HUB_EVENT_TYPE_COUNT] = {
+    hub_event_tx,
+    hub_event_rx,
+    hub_event_irq,
+    hub_event_rtos_request,
+    hub_event_irq_deadline,
+};
+
+/*
+ * Fills in an event's handler and device, and returns the
+ * ID to set the event's resource up to return.
+ */
+static int hub_event_id(hub_event_t *event, int type, int device_id)
+{
+    event->handler = hub_event_handlers[type];
+    event->device_id = device_id;
+
+    return (int) (uintptr_t) event;
 }
 
 void soc_peripheral_hub()
 {
+    soc_peripheral_hub_instance(0);
+}
+
+/*
+ * Runs peripheral hub instance hub_id, servicing only the peripherals
+ * that SOC_PERIPHERAL_HUB_MAP() assigns to it. All the peripherals
+ * must have been registered before instance 0 is started, and it
+ * allocates the RTOS request chanends of every instance. The other
+ * instances may be started at any time on other logical cores, and
+ * will wait for instance 0 before doing anything.
+ */
+void soc_peripheral_hub_instance(int hub_id)
+{
+    hub_t *hub;
     int i;
+#if SOC_PERIPHERAL_STATS
+    uint32_t busy_start;
+    uint32_t idle_start;
+    uint32_t now;
+#endif
+
+    xassert(hub_id >= 0 && hub_id < SOC_PERIPHERAL_HUB_COUNT);
+    hub = &hubs[hub_id];
+    hub->id = hub_id;
+
+    hwtimer_alloc(&hub->irq_moderation_tmr);
+
+    if (hub_id == 0) {
+        /*
+         * Every instance's RTOS request chanend is allocated here, so
+         * that drivers may register their ISRs and make requests as
+         * soon as instance 0 has started, however late the instance
+         * that services them starts.
+         */
+        for (i = 0; i < SOC_PERIPHERAL_HUB_COUNT; i++) {
+            chanend_alloc(&hubs[i].rtos_irq_c);
+        }
+        RTOS_MEMORY_BARRIER();
+        hub_started = 1;
+    } else {
+        while (!hub_started) {
+            hwtimer_delay(hub->irq_moderation_tmr, SOC_BOOT_POLL_TICKS);
+        }
+    }
 
-    chanend_alloc(&rtos_irq_c);
+#if SOC_PERIPHERAL_HUB_IRQ_BATCH
+    rtos_irq_batch_init(&hub->irq_batch);
+#endif
 
     select_disable_trigger_all();
 
     for (i = 0; i < peripheral_count; i++) {
+        if (peripherals[i].hub_id != hub_id) {
+            continue;
+        }
         if (peripherals[i].tx_c != 0) {
-            chanend_setup_select(peripherals[i].tx_c, 0 * MAX_PERIPHERALS + i);
+            chanend_setup_select(peripherals[i].tx_c,
+                                 hub_event_id(&device_events[i][HUB_EVENT_TX], HUB_EVENT_TX, i));
         }
         if (peripherals[i].rx_c != 0) {
-            chanend_setup_select(peripherals[i].rx_c, 1 * MAX_PERIPHERALS + i);
+            chanend_setup_select(peripherals[i].rx_c,
+                                 hub_event_id(&device_events[i][HUB_EVENT_RX], HUB_EVENT_RX, i));
         }
         if (peripherals[i].irq_c != 0) {
-            chanend_setup_select(peripherals[i].irq_c, 2 * MAX_PERIPHERALS + i);
+            chanend_setup_select(peripherals[i].irq_c,
+                                 hub_event_id(&device_events[i][HUB_EVENT_IRQ], HUB_EVENT_IRQ, i));
+            chanend_enable_trigger(peripherals[i].irq_c);
         }
+
+        /* Every device's rings must be checked the first time round */
+        HUB_DIRTY_SET(hub->dirty_tx, i);
+        HUB_DIRTY_SET(hub->dirty_rx, i);
     }
 
-    chanend_setup_select(rtos_irq_c, 3 * MAX_PERIPHERALS);
-    chanend_enable_trigger(rtos_irq_c);
+    chanend_setup_select(hub->rtos_irq_c,
+                         hub_event_id(&hub_events[hub_id][HUB_EVENT_RTOS_REQUEST - HUB_DEVICE_EVENT_COUNT],
+                                      HUB_EVENT_RTOS_REQUEST, 0));
+    chanend_enable_trigger(hub->rtos_irq_c);
+
+    hwtimer_setup_select(hub->irq_moderation_tmr, 0,
+                         hub_event_id(&hub_events[hub_id][HUB_EVENT_IRQ_DEADLINE - HUB_DEVICE_EVENT_COUNT],
+                                      HUB_EVENT_IRQ_DEADLINE, 0));
 
     /*
      * Should wait until all RTOS cores have enabled IRQs,
-     * or else rtos_irq() could fail.
+     * or else rtos_irq() could fail. The hub sleeps on its
+     * timer between polls so that it takes no pipeline
+     * cycles from the cores that are still booting.
      */
-    while (!rtos_irq_ready());
+    while (!rtos_irq_ready()) {
+        hwtimer_delay(hub->irq_moderation_tmr, SOC_BOOT_POLL_TICKS);
+    }
+
+#if SOC_PERIPHERAL_STATS
+    busy_start = get_reference_time();
+#endif
 
     for (;;) {
-        int device_id;
-
-        for (i = 0; i < peripheral_count; i++) {
-
-            if (peripherals[i].tx_c != 0 && peripherals[i].tx_ring_buf.desc != NULL) {
-                if (soc_dma_ring_buf_get(&peripherals[i].tx_ring_buf, NULL, NULL) != NULL) {
-                    /*
-                     * If there is a transmit channel and there is a transmit
-                     * buffer available, then we can listen for a data request
-                     * from the device.
-                     */
-//                    debug_printf("DMA to listen for data request from device %d\n", i);
-                    chanend_enable_trigger(peripherals[i].tx_c);
-
-                    if (!peripherals[i].tx_ready) {
-                        dma_to_device_ready(&peripherals[i]);
+        int event_id;
+        int irq_deferred = 0;
+        uint32_t irq_deadline = 0;
+
+        /*
+         * Only the devices whose rings have changed since the last time
+         * round need their triggers re-armed. The triggers of all the
+         * others are still as they were left.
+         */
+        hub_rearm(hub->dirty_tx, hub_tx_rearm);
+        hub_rearm(hub->dirty_rx, hub_rx_rearm);
+
+        if (hub->irq_deferred_devices > 0) {
+            for (i = 0; i < peripheral_count; i++) {
+                if (peripherals[i].hub_id == hub_id && peripherals[i].irq_deferred > 0) {
+                    /* Find the earliest deadline of all the deferred IRQs */
+                    if (!irq_deferred || (int32_t) (peripherals[i].irq_deadline - irq_deadline) < 0) {
+                        irq_deadline = peripherals[i].irq_deadline;
                     }
+                    irq_deferred = 1;
                 }
             }
+        }
 
-            if (peripherals[i].rx_c != 0 && peripherals[i].rx_ring_buf.desc != NULL) {
-                if (soc_dma_ring_buf_get(&peripherals[i].rx_ring_buf, NULL, NULL) != NULL) {
-                    /*
-                     * If there is a receive channel and there is a receive
-                     * buffer available, then we can listen for data from
-                     * the device.
-                     */
-//                    debug_printf("DMA to listen for data from device %d\n", i);
-                    chanend_enable_trigger(peripherals[i].rx_c);
-                }
-            }
-
-            if (peripherals[i].irq_c != 0) {
-                chanend_enable_trigger(peripherals[i].irq_c);
-            }
+        if (irq_deferred) {
+            hwtimer_change_trigger_time(hub->irq_moderation_tmr, irq_deadline);
+            hwtimer_enable_trigger(hub->irq_moderation_tmr);
         }
 
-        device_id = select_wait();
+#if SOC_PERIPHERAL_STATS
+        idle_start = get_reference_time();
+        event_id = select_wait();
+        now = get_reference_time();
+
+        stats_begin(&hub->stats_seq);
+        hub->stats.busy_ticks += idle_start - busy_start;
+        hub->stats.idle_ticks += now - idle_start;
+        stats_end(&hub->stats_seq);
+        busy_start = now;
+#else
+        event_id = select_wait();
+#endif
 
         do {
-            if (device_id < peripheral_count) {
-                /* The device is trying to receive data */
-
-                chanend_disable_trigger(peripherals[device_id].tx_c);
-                dma_to_device(&peripherals[device_id]);
-
-            } else if ((device_id - 1 * MAX_PERIPHERALS) < peripheral_count) {
-                /* The device is trying to send data */
-
-                /*
-                 * Select wait returns 1 * MAX_DEVICES + device_id when
-                 * data is received on the RX channel, so convert to
-                 * the actual device ID.
-                 */
-                device_id -= 1 * MAX_PERIPHERALS;
-
-                chanend_disable_trigger(peripherals[device_id].rx_c);
-                device_to_dma(&peripherals[device_id]);
-
-            } else if ((device_id - 2 * MAX_PERIPHERALS) < peripheral_count) {
-                /* The device is trying to send an IRQ */
-
-                /*
-                 * Select wait returns 2 * MAX_DEVICES + device_id when
-                 * data is received on the IRQ channel, so convert to
-                 * the actual device ID.
-                 */
-                device_id -= 2 * MAX_PERIPHERALS;
-
-                chanend_disable_trigger(peripherals[device_id].irq_c);
-                device_to_hub_irq(&peripherals[device_id]);
-
-            } else if (device_id == 3 * MAX_PERIPHERALS) {
-                /* request from the RTOS */
-
-                /*
-                 * An RTOS task has added a new DMA buffer so wake up
-                 * here so we go back to the start of the loop to make sure
-                 * we are waiting on the right channels.
-                 */
-                s_chan_check_ct_end(rtos_irq_c);
-            }
+            hub_event_t *event = (hub_event_t *) (uintptr_t) event_id;
+
+            event->handler(hub, event->device_id);
+            event_id = select_no_wait(-1);
+        } while (event_id != -1);
 
-            device_id = select_no_wait(-1);
-        } while (device_id != -1);
+#if SOC_PERIPHERAL_HUB_IRQ_BATCH
+        rtos_irq_batch(&hub->irq_batch);
+#endif
+    }
+}
+
+void soc_peripheral_tx_dma_remote_receiver(
+        soc_peripheral_t device)
+{
+    hwtimer_t tmr;
+
+    xassert(device->remote_rx_c != 0);
+
+    hwtimer_alloc(&tmr);
+
+    while (!rtos_irq_ready()) {
+        hwtimer_delay(tmr, SOC_BOOT_POLL_TICKS);
+    }
+
+    for (;;) {
+        int desc_count;
+        uint32_t bytes;
+
+        /*
+         * The device is held up on the channel until there is a
+         * buffer to receive its frame into, just as it would be
+         * by the hub.
+         */
+        if (device->rx_ring_buf.desc == NULL || soc_dma_ring_buf_get(&device->rx_ring_buf, NULL, NULL) == NULL) {
+#if SOC_PERIPHERAL_STATS
+            stats_begin(&device->direct_stats.seq);
+            device->direct_stats.counts.rx_stalls++;
+            stats_end(&device->direct_stats.seq);
+#endif
+            do {
+                hwtimer_delay(tmr, SOC_PERIPHERAL_TX_DMA_REMOTE_POLL_TICKS);
+            } while (device->rx_ring_buf.desc == NULL || soc_dma_ring_buf_get(&device->rx_ring_buf, NULL, NULL) == NULL);
+        }
+
+        desc_count = rx_frame_receive(device, device->remote_rx_c, &bytes);
+
+#if SOC_PERIPHERAL_STATS
+        stats_begin(&device->direct_stats.seq);
+        device->direct_stats.counts.rx_bytes += bytes;
+        device->direct_stats.counts.rx_transfers++;
+        stats_end(&device->direct_stats.seq);
+#endif
+
+        dma_probe(SOC_DMA_DONE_PROBE_ID, device, SOC_DMA_RX_REQUEST);
+
+        interrupt_status_post(device, STATUS_SLOT_DIRECT,
+                              SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM | rx_watermarks_check(device, desc_count));
+
+        rtos_irq(device->core_id, device->irq_source_id);
     }
 }
@@ -18,8 +18,11 @@
 #include "soc_conf_defaults.h"
 
 #include "soc_channel.h"
+#include "soc_clock.h"
+#include "soc_msg.h"
 #include "soc_peripheral_hub.h"
 #include "soc_peripheral_control.h"
+#include "soc_peripheral_tx_queue.h"
 
 /*
  * Bitstream may optionally implement this function if
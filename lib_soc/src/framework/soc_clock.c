@@ -0,0 +1,36 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <xs1.h>
+
+#include "soc.h"
+#include "xassert.h"
+
+static unsigned core_clock_divider = 1;
+
+void soc_core_clock_divider_set(unsigned divider)
+{
+    unsigned ctrl0;
+
+    xassert(divider >= 1 && divider <= SOC_CORE_CLOCK_DIVIDER_MAX);
+
+    if (divider == core_clock_divider) {
+        return;
+    }
+
+    /*
+     * The divider register holds one less than the divider. It is
+     * written before the divider is enabled, so that the clock goes
+     * straight to its new rate.
+     */
+    write_pswitch_reg(get_local_tile_id(), XS1_PSWITCH_PLL_CLK_DIVIDER_NUM, divider - 1);
+
+    ctrl0 = getps(XS1_PS_XCORE_CTRL0);
+    setps(XS1_PS_XCORE_CTRL0, XS1_XCORE_CTRL0_CLK_DIVIDER_EN_SET(ctrl0, divider > 1));
+
+    core_clock_divider = divider;
+}
+
+unsigned soc_core_clock_divider_get(void)
+{
+    return core_clock_divider;
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_CLOCK_H_
+#define SOC_CLOCK_H_
+
+/*
+ * The core clock of a tile is its PLL output, which may be divided down
+ * to cut the tile's power while it is lightly loaded. Every logical core
+ * on the tile is slowed by the same amount, including its bitstream
+ * devices, so the divider must never be so large that any of them then
+ * misses a deadline.
+ *
+ * Only the core clock is divided. The 100 MHz reference clock, which
+ * every timer and timeout is counted in, is left as it is.
+ */
+
+/* The largest divider that soc_core_clock_divider_set() accepts */
+#define SOC_CORE_CLOCK_DIVIDER_MAX 256
+
+#ifdef __XC__
+extern "C" {
+#endif //__XC__
+
+/**
+ * Divides the calling tile's core clock. Must only be called from one
+ * thread at a time.
+ *
+ * \param divider  From 1, for the undivided PLL clock, up to
+ *                 SOC_CORE_CLOCK_DIVIDER_MAX.
+ */
+void soc_core_clock_divider_set(unsigned divider);
+
+/**
+ * Returns the divider that the calling tile's core clock was last set
+ * to with soc_core_clock_divider_set(), or 1 if it has not been.
+ */
+unsigned soc_core_clock_divider_get(void);
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* SOC_CLOCK_H_ */
@@ -19,4 +19,381 @@
 #define SOC_TILE_3_INCLUDE SOC_TILE_UNUSED
 #endif
 
+/*
+ * When set to 1, soc_peripheral_common_dma_init(), and so each of the
+ * *_driver_init() functions, only registers the device's ISR and records
+ * the sizes of its rings. The descriptors and RX buffers are not allocated
+ * until soc_peripheral_common_dma_open() is called for the device, so a
+ * device that is never opened holds no RAM and costs nothing at boot.
+ * When 0, the rings are allocated at init and opening is a no-op.
+ */
+#ifndef SOC_PERIPHERAL_DMA_INIT_DEFERRED
+#define SOC_PERIPHERAL_DMA_INIT_DEFERRED 0
+#endif
+
+/*
+ * When greater than 0, the size in bytes of a static region that the
+ * descriptor rings and RX buffers allocated by
+ * soc_peripheral_common_dma_init(), and the pools created by
+ * soc_dma_buf_pool_create(), are all taken from in turn instead of
+ * from the BSP backend's heap. They are never freed, so this leaves the heap
+ * unfragmented and the memory layout fixed from one boot to the next.
+ */
+#ifndef SOC_DMA_HEAP_SIZE
+#define SOC_DMA_HEAP_SIZE 0
+#endif
+
+/*
+ * Optionally, the name of the linker section to place the
+ * SOC_DMA_HEAP_SIZE region in.
+ */
+#ifdef SOC_DMA_HEAP_SECTION
+#define SOC_DMA_HEAP_SECTION_ATTR __attribute__((section(SOC_DMA_HEAP_SECTION)))
+#else
+#define SOC_DMA_HEAP_SECTION_ATTR
+#endif
+
+/*
+ * The number of reference clock ticks a thread waits between polls
+ * while it waits at boot for something else to finish initializing.
+ * The thread is paused between polls so that, unlike with a spin, it
+ * takes no pipeline cycles from the threads it is waiting on.
+ */
+#ifndef SOC_BOOT_POLL_TICKS
+#define SOC_BOOT_POLL_TICKS 100
+#endif
+
+/*
+ * The number of sender-side queues for devices on another tile from
+ * their hub. See soc_peripheral_tx_queue.h.
+ */
+#ifndef SOC_PERIPHERAL_TX_QUEUE_COUNT
+#define SOC_PERIPHERAL_TX_QUEUE_COUNT 0
+#endif
+
+/* The number of frames each sender-side queue holds */
+#ifndef SOC_PERIPHERAL_TX_QUEUE_LEN
+#define SOC_PERIPHERAL_TX_QUEUE_LEN 2
+#endif
+
+/* The largest frame, in bytes, that may be put into a sender-side queue */
+#ifndef SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE
+#define SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE 4096
+#endif
+
+/*
+ * The number of reference clock ticks a sender-side queue's sender
+ * sleeps between polls while its queue is empty.
+ */
+#ifndef SOC_PERIPHERAL_TX_QUEUE_POLL_TICKS
+#define SOC_PERIPHERAL_TX_QUEUE_POLL_TICKS 100
+#endif
+
+/*
+ * The number of reference clock ticks soc_peripheral_tx_dma_remote_receiver()
+ * sleeps between polls while its device's RX ring is full.
+ */
+#ifndef SOC_PERIPHERAL_TX_DMA_REMOTE_POLL_TICKS
+#define SOC_PERIPHERAL_TX_DMA_REMOTE_POLL_TICKS 100
+#endif
+
+#if (SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE & 3) != 0
+#error SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE must be a multiple of 4
+#endif
+
+/*
+ * The number of devices of each peripheral type that the
+ * application registers with the peripheral hub. Each
+ * defaults to one if its SOC_*_PERIPHERAL_USED is set in
+ * soc_conf.h, and to none otherwise.
+ */
+#ifndef SOC_ETHERNET_PERIPHERAL_COUNT
+#if SOC_ETHERNET_PERIPHERAL_USED
+#define SOC_ETHERNET_PERIPHERAL_COUNT 1
+#else
+#define SOC_ETHERNET_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_GPIO_PERIPHERAL_COUNT
+#if SOC_GPIO_PERIPHERAL_USED
+#define SOC_GPIO_PERIPHERAL_COUNT 1
+#else
+#define SOC_GPIO_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_I2C_PERIPHERAL_COUNT
+#if SOC_I2C_PERIPHERAL_USED
+#define SOC_I2C_PERIPHERAL_COUNT 1
+#else
+#define SOC_I2C_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_I2S_PERIPHERAL_COUNT
+#if SOC_I2S_PERIPHERAL_USED
+#define SOC_I2S_PERIPHERAL_COUNT 1
+#else
+#define SOC_I2S_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_MICARRAY_PERIPHERAL_COUNT
+#if SOC_MICARRAY_PERIPHERAL_USED
+#define SOC_MICARRAY_PERIPHERAL_COUNT 1
+#else
+#define SOC_MICARRAY_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_SDRAM_PERIPHERAL_COUNT
+#if SOC_SDRAM_PERIPHERAL_USED
+#define SOC_SDRAM_PERIPHERAL_COUNT 1
+#else
+#define SOC_SDRAM_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_INTERTILE_PERIPHERAL_COUNT
+#if SOC_INTERTILE_PERIPHERAL_USED
+#define SOC_INTERTILE_PERIPHERAL_COUNT 1
+#else
+#define SOC_INTERTILE_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+#ifndef SOC_LOOPBACK_PERIPHERAL_COUNT
+#if SOC_LOOPBACK_PERIPHERAL_USED
+#define SOC_LOOPBACK_PERIPHERAL_COUNT 1
+#else
+#define SOC_LOOPBACK_PERIPHERAL_COUNT 0
+#endif
+#endif
+
+/*
+ * The maximum number of peripherals that may be registered
+ * with the peripheral hub on a tile. The hub's tables are
+ * sized by it, so by default it is the total of the counts
+ * above. Each peripheral that handles interrupts uses an
+ * RTOS IRQ source, so this should not be greater than
+ * RTOS_IRQ_MAX_PERIPHERAL_SOURCES.
+ */
+#ifndef SOC_MAX_PERIPHERALS
+#define SOC_MAX_PERIPHERALS ( \
+        SOC_ETHERNET_PERIPHERAL_COUNT + \
+        SOC_GPIO_PERIPHERAL_COUNT + \
+        SOC_I2C_PERIPHERAL_COUNT + \
+        SOC_I2S_PERIPHERAL_COUNT + \
+        SOC_MICARRAY_PERIPHERAL_COUNT + \
+        SOC_SDRAM_PERIPHERAL_COUNT + \
+        SOC_INTERTILE_PERIPHERAL_COUNT + \
+        SOC_LOOPBACK_PERIPHERAL_COUNT)
+#endif
+
+#if SOC_MAX_PERIPHERALS < 1
+#error SOC_MAX_PERIPHERALS must be at least 1, set the SOC_*_PERIPHERAL_USED flags in soc_conf.h
+#endif
+
+/*
+ * When set to 1, the interrupt status of each peripheral is
+ * accumulated in a slot per producer that is merged by the ISR
+ * rather than in a single word protected by a lock. This way the
+ * peripheral hub never waits on a lock held by an RTOS core.
+ */
+#ifndef SOC_PERIPHERAL_LOCKLESS_STATUS
+#define SOC_PERIPHERAL_LOCKLESS_STATUS 0
+#endif
+
+/*
+ * When set to 1, the IRQs raised by the peripheral hub for
+ * the DMA transfers it performs are collected while it handles
+ * all of its ready events, and then sent with a single call
+ * to rtos_irq_batch().
+ */
+#ifndef SOC_PERIPHERAL_HUB_IRQ_BATCH
+#define SOC_PERIPHERAL_HUB_IRQ_BATCH 1
+#endif
+
+/*
+ * The number of peripheral hub instances on a tile. Each one
+ * runs on its own logical core, started with
+ * soc_peripheral_hub_instance(), and services only the
+ * peripherals that SOC_PERIPHERAL_HUB_MAP() assigns to it.
+ */
+#ifndef SOC_PERIPHERAL_HUB_COUNT
+#define SOC_PERIPHERAL_HUB_COUNT 1
+#endif
+
+/*
+ * Maps the ID of a peripheral, which is the order in which it
+ * was registered starting from 0, to the hub instance that
+ * services it. This must be less than SOC_PERIPHERAL_HUB_COUNT.
+ */
+#ifndef SOC_PERIPHERAL_HUB_MAP
+#define SOC_PERIPHERAL_HUB_MAP(device_id) 0
+#endif
+
+/*
+ * When set to 1, peripheral ISRs are run through a wrapper that
+ * measures the time spent in them and allows the core handling
+ * each peripheral's interrupts to be changed at runtime with
+ * soc_peripheral_irq_core_set() or soc_peripheral_irq_balance().
+ */
+#ifndef SOC_PERIPHERAL_IRQ_AFFINITY
+#define SOC_PERIPHERAL_IRQ_AFFINITY 0
+#endif
+
+/*
+ * When set to 1, the peripheral hub counts the data moved for each
+ * peripheral and the time it spends moving it, as well as how busy
+ * each hub instance is. These are read with soc_peripheral_stats_get()
+ * and soc_peripheral_hub_stats_get().
+ */
+#ifndef SOC_PERIPHERAL_STATS
+#define SOC_PERIPHERAL_STATS 0
+#endif
+
+/*
+ * When set to 1, the peripheral hub outputs an xSCOPE integer probe
+ * each time a peripheral's DMA is requested, and each time one of its
+ * DMA transfers completes, whether moved by the hub or directly. The
+ * value output is the ring, SOC_DMA_TX_REQUEST or SOC_DMA_RX_REQUEST,
+ * in bits 16 and up, and the peripheral's ID in bits 15..0. The probes
+ * must be in the application's config.xscope.
+ */
+#ifndef SOC_PERIPHERAL_XSCOPE_PROBES
+#define SOC_PERIPHERAL_XSCOPE_PROBES 0
+#endif
+
+/* The ID of the probe for DMA requests, generated from config.xscope */
+#ifndef SOC_DMA_SUBMIT_PROBE_ID
+#define SOC_DMA_SUBMIT_PROBE_ID SOC_DMA_SUBMIT
+#endif
+
+/* The ID of the probe for completed DMA transfers, generated from config.xscope */
+#ifndef SOC_DMA_DONE_PROBE_ID
+#define SOC_DMA_DONE_PROBE_ID SOC_DMA_DONE
+#endif
+
+/*
+ * When greater than 0, soc_peripheral_varlist_tx() and
+ * soc_peripheral_varlist_rx() only mask interrupts while moving
+ * this many bytes at a time, rather than for the whole transaction,
+ * so that the interrupt latency they add is bounded however much
+ * data they move. Other tasks are kept off the chanend in the
+ * meantime by a lock. They must then not be called from an ISR.
+ */
+#ifndef SOC_PERIPHERAL_CONTROL_CHUNK_SIZE
+#define SOC_PERIPHERAL_CONTROL_CHUNK_SIZE 0
+#endif
+
+/*
+ * The largest message that may be sent with soc_msg_send(), and
+ * the number of messages each tile may send to another before
+ * that tile has received them. Each endpoint holds a slot of
+ * SOC_MSG_MAX_LEN bytes for every credit it grants.
+ */
+#ifndef SOC_MSG_MAX_LEN
+#define SOC_MSG_MAX_LEN 64
+#endif
+
+#ifndef SOC_MSG_CREDITS
+#define SOC_MSG_CREDITS 2
+#endif
+
+/*
+ * The RTOS IRQ priorities given to the interrupts of the audio
+ * peripherals, so that their ISRs run ahead of those for bulk
+ * peripherals such as Ethernet when both are pending.
+ */
+#ifndef SOC_I2S_IRQ_PRIORITY
+#define SOC_I2S_IRQ_PRIORITY RTOS_IRQ_PRIORITY_HIGHEST
+#endif
+
+#ifndef SOC_MICARRAY_IRQ_PRIORITY
+#define SOC_MICARRAY_IRQ_PRIORITY RTOS_IRQ_PRIORITY_HIGHEST
+#endif
+
+/*
+ * When set to 1, DMA buffer descriptors and the peripheral DMA
+ * transfer functions use 32-bit lengths, so that more than 64 KiB
+ * may be moved with a single descriptor or transfer. Each buffer
+ * descriptor grows from two words to three.
+ */
+#ifndef SOC_DMA_LENGTH_32BIT
+#define SOC_DMA_LENGTH_32BIT 0
+#endif
+
+/*
+ * When set to 1, the length, status and last flag of each DMA buffer
+ * descriptor are packed into a single word. Each descriptor update is
+ * then a single store and each poll of one a single load.
+ */
+#ifndef SOC_DMA_BUF_DESC_PACKED
+#define SOC_DMA_BUF_DESC_PACKED 0
+#endif
+
+/*
+ * When set to 1, each DMA buffer descriptor also holds a reference
+ * clock timestamp, adding a word to it. Transmit buffers are stamped
+ * when they are given to the DMA, and receive buffers with the time
+ * given by the device with soc_peripheral_tx_dma_ts_xfer(), or when
+ * the hub received them otherwise. See soc_dma_ring_rx_buf_ts_get()
+ * and soc_dma_ring_tx_buf_ts_get().
+ */
+#ifndef SOC_DMA_BUF_DESC_TIMESTAMP
+#define SOC_DMA_BUF_DESC_TIMESTAMP 0
+#endif
+
+/*
+ * When set to 1, each DMA buffer descriptor also holds a metadata word,
+ * adding a word to it. The word is given by the device with each
+ * transfer with soc_peripheral_tx_dma_ex_xfer(), such as a sequence
+ * number, channel ID and flags, and is 0 otherwise. See
+ * soc_dma_ring_rx_buf_ex_get().
+ */
+#ifndef SOC_DMA_BUF_DESC_META
+#define SOC_DMA_BUF_DESC_META 0
+#endif
+
+/*
+ * When set to 1, a DMA ring may be made safe for several tasks to give
+ * it transmit buffers at once. See soc_dma_ring_buf_multi_producer_set().
+ */
+#ifndef SOC_DMA_RING_MULTI_PRODUCER
+#define SOC_DMA_RING_MULTI_PRODUCER 0
+#endif
+
+/*
+ * When set to 1, soc_dma_ring_rx_buf_get(), soc_dma_ring_rx_buf_sg_get()
+ * and soc_dma_ring_tx_buf_get() are compiled inline into the code that
+ * calls them, such as device ISRs, rather than called in dma_ring_buf.c.
+ * The descriptors are handed back in the same way either way, so this
+ * need not be set the same for every source file.
+ */
+#ifndef SOC_DMA_RING_INLINE
+#define SOC_DMA_RING_INLINE 0
+#endif
+
+/*
+ * The alignment in bytes of descriptor arrays declared with
+ * SOC_DMA_BUF_DESC_ARRAY(). The default places each two word
+ * descriptor within a single double word.
+ */
+#ifndef SOC_DMA_BUF_DESC_ALIGNMENT
+#define SOC_DMA_BUF_DESC_ALIGNMENT 8
+#endif
+
+/*
+ * Optionally, the name of the linker section to place descriptor
+ * arrays declared with SOC_DMA_BUF_DESC_ARRAY() in, for example to
+ * keep them in a particular memory bank.
+ */
+#ifdef SOC_DMA_BUF_DESC_SECTION
+#define SOC_DMA_BUF_DESC_SECTION_ATTR __attribute__((section(SOC_DMA_BUF_DESC_SECTION)))
+#else
+#define SOC_DMA_BUF_DESC_SECTION_ATTR
+#endif
+
 #endif /* SOC_CONF_DEFAULTS_H_ */
@@ -3,45 +3,255 @@
 #ifndef SOC_DMA_RING_BUF_H_
 #define SOC_DMA_RING_BUF_H_
 
+#include <stdint.h>
+
+/*
+ * The type of DMA buffer and transfer lengths. When SOC_DMA_LENGTH_32BIT
+ * is set to 1 a single descriptor, and a single transfer, may be larger
+ * than 64 KiB, at the cost of a larger descriptor.
+ */
+#if SOC_DMA_LENGTH_32BIT
+typedef uint32_t soc_dma_length_t;
+#else
+typedef uint16_t soc_dma_length_t;
+#endif
+
 #ifndef __XC__
 
-#include <stdint.h>
+#if SOC_DMA_LENGTH_32BIT
+#if SOC_DMA_BUF_DESC_PACKED
+#error SOC_DMA_BUF_DESC_PACKED does not support SOC_DMA_LENGTH_32BIT
+#endif
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+#define SOC_DMA_BUF_DESC_BASE_WORDSIZE 4
+#else
+#define SOC_DMA_BUF_DESC_BASE_WORDSIZE 3
+#endif
+#else
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+#define SOC_DMA_BUF_DESC_BASE_WORDSIZE 3
+#else
+#define SOC_DMA_BUF_DESC_BASE_WORDSIZE 2
+#endif
+#endif
+
+#if SOC_DMA_BUF_DESC_META
+#define SOC_DMA_BUF_DESC_WORDSIZE (SOC_DMA_BUF_DESC_BASE_WORDSIZE + 1)
+#else
+#define SOC_DMA_BUF_DESC_WORDSIZE SOC_DMA_BUF_DESC_BASE_WORDSIZE
+#endif
+
+/*
+ * A suggested layout for the metadata word kept in each descriptor
+ * when SOC_DMA_BUF_DESC_META is enabled. Devices may use the word
+ * however they like, so long as their drivers agree.
+ */
+#define SOC_DMA_META(seq, channel, flags) \
+    (((uint32_t) (flags) << 24) | (((uint32_t) (channel) & 0xFF) << 16) | ((uint32_t) (seq) & 0xFFFF))
+#define SOC_DMA_META_SEQ(meta)      ((meta) & 0xFFFF)
+#define SOC_DMA_META_CHANNEL(meta)  (((meta) >> 16) & 0xFF)
+#define SOC_DMA_META_FLAGS(meta)    ((meta) >> 24)
 
-#define SOC_DMA_BUF_DESC_WORDSIZE 2
+/*
+ * Declares an array that may be passed to soc_dma_ring_buf_init()
+ * to hold count descriptors. It is aligned to SOC_DMA_BUF_DESC_ALIGNMENT
+ * and placed in SOC_DMA_BUF_DESC_SECTION if that is defined.
+ */
+#define SOC_DMA_BUF_DESC_ARRAY(name, count) \
+    uint32_t name[(count) * SOC_DMA_BUF_DESC_WORDSIZE] \
+    __attribute__((aligned(SOC_DMA_BUF_DESC_ALIGNMENT))) SOC_DMA_BUF_DESC_SECTION_ATTR
 
 typedef struct soc_dma_buf_desc soc_dma_buf_desc_t;
 
-typedef struct {
+typedef struct soc_dma_ring_buf soc_dma_ring_buf_t;
+
+/*
+ * A function that the transmit functions call while they wait for a
+ * descriptor to become free, rather than spinning. It may block the
+ * calling task until, for example, the peripheral's TX done interrupt
+ * fires. It may return early, in which case it is simply called again.
+ */
+typedef void (*soc_dma_ring_wait_hook_t)(soc_dma_ring_buf_t *ring_buf, void *arg);
+
+struct soc_dma_ring_buf {
     soc_dma_buf_desc_t *desc;
     int desc_count;
+    int desc_mask; /* desc_count - 1 when it is a power of two, else 0 */
     int dma_next;
     int app_next;
     int done_next;
-} soc_dma_ring_buf_t;
+    soc_dma_ring_wait_hook_t wait_hook;
+    void *wait_hook_arg;
+#if SOC_DMA_RING_MULTI_PRODUCER
+    int multi_producer;
+#endif
+};
 
 void soc_dma_ring_buf_init(
         soc_dma_ring_buf_t *ring_buf,
         uint32_t *desc_buf,
         int buf_desc_count);
 
+/*
+ * Sets the function called by soc_dma_ring_tx_buf_set(),
+ * soc_dma_ring_tx_bufs_set() and soc_dma_ring_tx_buf_sg_set() while
+ * they wait for a free descriptor. With no hook set, the default,
+ * they spin.
+ */
+void soc_dma_ring_buf_wait_hook_set(
+        soc_dma_ring_buf_t *ring_buf,
+        soc_dma_ring_wait_hook_t wait_hook,
+        void *arg);
+
+#if SOC_DMA_RING_MULTI_PRODUCER
+/*
+ * When enable is non-zero, soc_dma_ring_tx_buf_set(),
+ * soc_dma_ring_tx_buf_try_set() and soc_dma_ring_tx_bufs_set() may be
+ * called on the ring by several tasks, on any RTOS cores, at once. Each
+ * first claims the descriptors it needs by moving app_next on, with a
+ * hardware lock held for just that. It then fills them in while other
+ * tasks claim the next. A claimed descriptor is marked as reserved, so
+ * the hub stops at it until it is handed over, and so sends the buffers
+ * in the order they were claimed. soc_dma_ring_tx_buf_sg_set() and
+ * soc_dma_ring_tx_buf_sg_try_set() may then not be used on the ring,
+ * and the transmitted buffers must still be taken back by a single task.
+ * Only set this before any buffer is given to the ring.
+ */
+void soc_dma_ring_buf_multi_producer_set(
+        soc_dma_ring_buf_t *ring_buf,
+        int enable);
+#endif
+
 void soc_dma_ring_rx_buf_set(
         soc_dma_ring_buf_t *ring_buf,
         void *buf,
-        uint16_t length);
+        soc_dma_length_t length);
+
+/*
+ * Gives count receive buffers to the DMA at once. Only one call to
+ * soc_peripheral_hub_dma_request() is then needed for all of them.
+ * There must be at least count descriptors ready for new buffers.
+ */
+void soc_dma_ring_rx_bufs_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count);
+
+/*
+ * Gives buf_count receive buffers to the DMA for a single incoming
+ * transfer, so that, for example, a frame's header lands in one buffer
+ * and its payload in another, aligned one. Each buffer is filled before
+ * the next, and any left over once the transfer has ended are returned
+ * with a length of 0. index is the buffer's position in the transfer.
+ * As with soc_dma_ring_tx_buf_sg_set(), the first buffer, at index 0,
+ * must be set last, as that is what makes the buffers visible to the
+ * DMA. There must be buf_count descriptors ready for new buffers. The
+ * buffers should be got back with soc_dma_ring_rx_buf_sg_get().
+ */
+void soc_dma_ring_rx_buf_sg_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void *buf,
+        soc_dma_length_t length,
+        int index,
+        int buf_count);
 
 void *soc_dma_ring_rx_buf_get(
         soc_dma_ring_buf_t *ring_buf,
         int *length);
 
+/*
+ * The same as soc_dma_ring_rx_buf_get(), but also sets *more to
+ * non-zero if the next buffer received holds the rest of the same
+ * transfer, as it may when the buffers were set with
+ * soc_dma_ring_rx_buf_sg_set(). more may be NULL.
+ */
+void *soc_dma_ring_rx_buf_sg_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more);
+
+#if SOC_DMA_BUF_DESC_META
+/*
+ * The same as soc_dma_ring_rx_buf_sg_get(), but also gets the buffer's
+ * timestamp, as soc_dma_ring_rx_buf_ts_get() does, and the metadata word
+ * the device gave with its data. timestamp is set to 0 unless
+ * SOC_DMA_BUF_DESC_TIMESTAMP is enabled. more, timestamp and meta may be
+ * NULL.
+ */
+void *soc_dma_ring_rx_buf_ex_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more,
+        uint32_t *timestamp,
+        uint32_t *meta);
+#endif
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+/*
+ * The same as soc_dma_ring_rx_buf_get(), but also gets the buffer's
+ * timestamp, which is the reference time at which the device said
+ * its data was received, such as the MAC's RX timestamp for an
+ * Ethernet frame. timestamp may be NULL.
+ */
+void *soc_dma_ring_rx_buf_ts_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        uint32_t *timestamp);
+#endif
+
+/*
+ * Gets up to max completed receive buffers at once, so that none are
+ * left behind when one interrupt stands for several completions.
+ * lengths may be NULL. Returns the number of buffers got.
+ */
+int soc_dma_ring_rx_bufs_get(
+        soc_dma_ring_buf_t *ring_buf,
+        void *bufs[],
+        int lengths[],
+        int max);
+
 void soc_dma_ring_tx_buf_set(
         soc_dma_ring_buf_t *ring_buf,
         void *buf,
-        uint16_t length);
+        soc_dma_length_t length);
+
+/*
+ * The same as soc_dma_ring_tx_buf_set() but never waits. Returns 0
+ * if the buffer was given to the DMA, or -1 if the ring is full.
+ */
+int soc_dma_ring_tx_buf_try_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void *buf,
+        soc_dma_length_t length);
+
+/*
+ * Gives count transmit buffers, each a complete frame, to the DMA at
+ * once. Only one call to soc_peripheral_hub_dma_request() is then
+ * needed for all of them. Waits for enough descriptors to be ready.
+ */
+void soc_dma_ring_tx_bufs_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count);
 
 void soc_dma_ring_tx_buf_sg_set(
         soc_dma_ring_buf_t *ring_buf,
         void *buf,
-        uint16_t length,
+        soc_dma_length_t length,
+        int index,
+        int buf_count);
+
+/*
+ * The same as soc_dma_ring_tx_buf_sg_set() but never waits. Returns 0
+ * if the buffer was given to the DMA, or -1 if its descriptor is not
+ * yet free.
+ */
+int soc_dma_ring_tx_buf_sg_try_set(
+        soc_dma_ring_buf_t *ring_buf,
+        void *buf,
+        soc_dma_length_t length,
         int index,
         int buf_count);
 
@@ -50,6 +260,46 @@ void *soc_dma_ring_tx_buf_get(
         int *length,
         int *more);
 
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+/*
+ * The same as soc_dma_ring_tx_buf_get(), but also gets the reference
+ * time at which the buffer was given to the DMA. timestamp may be NULL.
+ */
+void *soc_dma_ring_tx_buf_ts_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more,
+        uint32_t *timestamp);
+#endif
+
+/*
+ * Gets up to max completed transmit buffers at once. lengths and
+ * more may be NULL. Returns the number of buffers got.
+ */
+int soc_dma_ring_tx_bufs_get(
+        soc_dma_ring_buf_t *ring_buf,
+        void *bufs[],
+        int lengths[],
+        int more[],
+        int max);
+
+#if SOC_DMA_RING_INLINE && !defined(SOC_DMA_RING_BUF_IMPL)
+/*
+ * The functions that take completed buffers back, which interrupt
+ * handlers call most, are compiled inline into their callers rather
+ * than called. The functions are still built into dma_ring_buf.c, so
+ * their addresses may still be taken.
+ */
+#include "soc_dma_ring_buf_inline.h"
+
+#define soc_dma_ring_rx_buf_get(ring_buf, length) \
+    soc_dma_ring_rx_buf_get_inline(ring_buf, length)
+#define soc_dma_ring_rx_buf_sg_get(ring_buf, length, more) \
+    soc_dma_ring_rx_buf_sg_get_inline(ring_buf, length, more)
+#define soc_dma_ring_tx_buf_get(ring_buf, length, more) \
+    soc_dma_ring_tx_buf_get_inline(ring_buf, length, more)
+#endif
+
 #endif // __XC__
 
 #endif /* SOC_DMA_RING_BUF_H_ */
@@ -0,0 +1,222 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_DMA_RING_BUF_INLINE_H_
+#define SOC_DMA_RING_BUF_INLINE_H_
+
+/*
+ * The layout of the DMA buffer descriptors, and inline versions of
+ * the functions that take completed buffers back from a ring. This is
+ * included by soc_dma_ring_buf.h when SOC_DMA_RING_INLINE is set to 1,
+ * and otherwise only by dma_ring_buf.c. Application code should not
+ * include it directly, nor rely on anything in it other than through
+ * the functions in soc_dma_ring_buf.h.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "soc_dma_ring_buf.h"
+
+/*
+ * The buffer descriptor status when a DMA receive operation
+ * on it has just completed. The application should receive
+ * these by calling soc_dma_ring_rx_buf_get().
+ */
+#define SOC_DMA_BUF_DESC_STATUS_RX_DONE  3
+
+/*
+ * The buffer descriptor status when a DMA transmit operation
+ * on it has just completed. The application should receive
+ * these by calling soc_dma_ring_tx_buf_get().
+ */
+#define SOC_DMA_BUF_DESC_STATUS_TX_DONE  2
+
+/*
+ * The buffer descriptor status when the application has sent
+ * it to the DMA and is waiting for the operation to complete.
+ */
+#define SOC_DMA_BUF_DESC_STATUS_WAITING  1
+
+/*
+ * The buffer descriptor status when it is ready to be assigned
+ * a new buffer by the application.
+ */
+#define SOC_DMA_BUF_DESC_STATUS_READY 0
+
+/*
+ * The buffer descriptor status when one of several tasks sharing a
+ * multi-producer ring has claimed it, but not yet filled it in.
+ */
+#define SOC_DMA_BUF_DESC_STATUS_RESERVED 4
+
+#if SOC_DMA_BUF_DESC_PACKED
+
+/*
+ * The length, status and last flag share a single word so that
+ * they are published with one store and polled with one load.
+ */
+#define SOC_DMA_INFO_LENGTH_MASK  0x0000FFFF
+#define SOC_DMA_INFO_STATUS_SHIFT 16
+#define SOC_DMA_INFO_STATUS_MASK  0x00FF0000
+#define SOC_DMA_INFO_LAST_SHIFT   24
+
+struct soc_dma_buf_desc {
+    void *buf;
+    volatile uint32_t info;
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+    uint32_t timestamp;
+#endif
+#if SOC_DMA_BUF_DESC_META
+    uint32_t meta;
+#endif
+};
+
+/*
+ * A snapshot of a descriptor's length, status and last flag,
+ * taken with a single load.
+ */
+typedef uint32_t soc_dma_desc_info_t;
+
+#define SOC_DMA_DESC_INFO(d)       ((d)->info)
+#define SOC_DMA_INFO_LENGTH(i)     ((i) & SOC_DMA_INFO_LENGTH_MASK)
+#define SOC_DMA_INFO_STATUS(i)     (((i) & SOC_DMA_INFO_STATUS_MASK) >> SOC_DMA_INFO_STATUS_SHIFT)
+#define SOC_DMA_INFO_LAST(i)       ((i) >> SOC_DMA_INFO_LAST_SHIFT)
+
+/* Nothing to do here, these are all written by SOC_DMA_DESC_PUBLISH() */
+#define SOC_DMA_DESC_FIELDS_SET(d, len, lst)
+
+#define SOC_DMA_DESC_PUBLISH(d, len, lst, stat) \
+    ((d)->info = ((uint32_t) (lst) << SOC_DMA_INFO_LAST_SHIFT) | ((uint32_t) (stat) << SOC_DMA_INFO_STATUS_SHIFT) | (uint16_t) (len))
+
+#else
+
+struct soc_dma_buf_desc {
+    void *buf;
+    soc_dma_length_t length;
+    volatile uint8_t status;
+    uint8_t last;
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+    uint32_t timestamp;
+#endif
+#if SOC_DMA_BUF_DESC_META
+    uint32_t meta;
+#endif
+};
+
+/*
+ * The fields are separate here, so the "snapshot" is just
+ * the descriptor itself and each field is loaded when used.
+ */
+typedef soc_dma_buf_desc_t *soc_dma_desc_info_t;
+
+#define SOC_DMA_DESC_INFO(d)       (d)
+#define SOC_DMA_INFO_LENGTH(i)     ((i)->length)
+#define SOC_DMA_INFO_STATUS(i)     ((i)->status)
+#define SOC_DMA_INFO_LAST(i)       ((i)->last)
+
+#define SOC_DMA_DESC_FIELDS_SET(d, len, lst) \
+    do { (d)->length = (len); (d)->last = (lst); } while (0)
+
+#define SOC_DMA_DESC_PUBLISH(d, len, lst, stat) \
+    ((d)->status = (stat))
+
+#endif
+
+#define SOC_DMA_DESC_STATUS(d) SOC_DMA_INFO_STATUS(SOC_DMA_DESC_INFO(d))
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+#define SOC_DMA_DESC_TIMESTAMP_SET(d, ts) ((d)->timestamp = (ts))
+#else
+#define SOC_DMA_DESC_TIMESTAMP_SET(d, ts)
+#endif
+
+/*
+ * Sets a descriptor's length and last flag and then, once they are
+ * visible, its status. SOC_DMA_DESC_FIELDS_SET() may also be called on
+ * several descriptors before a single barrier and their
+ * SOC_DMA_DESC_PUBLISH() calls.
+ */
+#define SOC_DMA_DESC_SET(d, len, lst, stat) \
+    do { \
+        SOC_DMA_DESC_FIELDS_SET(d, len, lst); \
+        asm volatile( "" ::: "memory" ); \
+        SOC_DMA_DESC_PUBLISH(d, len, lst, stat); \
+    } while (0)
+
+/*
+ * Returns the index n descriptors on from i. On a ring of a power of
+ * two descriptors this is a single mask, otherwise n must be no more
+ * than the number of descriptors.
+ */
+static inline int soc_dma_ring_buf_add(
+        soc_dma_ring_buf_t *ring_buf,
+        int i,
+        int n)
+{
+    i += n;
+    if (ring_buf->desc_mask != 0) {
+        return i & ring_buf->desc_mask;
+    }
+    if (i >= ring_buf->desc_count) {
+        i -= ring_buf->desc_count;
+    }
+
+    return i;
+}
+
+/*
+ * Takes back the next buffer from the ring if its descriptor has the
+ * status done_status, and hands the descriptor back to the application.
+ */
+static inline void *soc_dma_ring_done_buf_get(
+        soc_dma_ring_buf_t *ring_buf,
+        int done_status,
+        int *length,
+        int *more)
+{
+    soc_dma_buf_desc_t *desc = &ring_buf->desc[ring_buf->done_next];
+    soc_dma_desc_info_t info = SOC_DMA_DESC_INFO(desc);
+    void *buf = NULL;
+
+    if (SOC_DMA_INFO_STATUS(info) == done_status) {
+
+        if (length != NULL) {
+            *length = SOC_DMA_INFO_LENGTH(info);
+        }
+        if (more != NULL) {
+            *more = !SOC_DMA_INFO_LAST(info);
+        }
+
+        buf = desc->buf;
+        asm volatile( "" ::: "memory" );
+        SOC_DMA_DESC_PUBLISH(desc, SOC_DMA_INFO_LENGTH(info), SOC_DMA_INFO_LAST(info), SOC_DMA_BUF_DESC_STATUS_READY);
+        ring_buf->done_next = soc_dma_ring_buf_add(ring_buf, ring_buf->done_next, 1);
+    }
+
+    return buf;
+}
+
+static inline void *soc_dma_ring_rx_buf_get_inline(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length)
+{
+    return soc_dma_ring_done_buf_get(ring_buf, SOC_DMA_BUF_DESC_STATUS_RX_DONE, length, NULL);
+}
+
+static inline void *soc_dma_ring_rx_buf_sg_get_inline(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more)
+{
+    return soc_dma_ring_done_buf_get(ring_buf, SOC_DMA_BUF_DESC_STATUS_RX_DONE, length, more);
+}
+
+static inline void *soc_dma_ring_tx_buf_get_inline(
+        soc_dma_ring_buf_t *ring_buf,
+        int *length,
+        int *more)
+{
+    return soc_dma_ring_done_buf_get(ring_buf, SOC_DMA_BUF_DESC_STATUS_TX_DONE, length, more);
+}
+
+#endif /* SOC_DMA_RING_BUF_INLINE_H_ */
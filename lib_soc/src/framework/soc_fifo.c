@@ -0,0 +1,128 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "rtos_macros.h"
+
+#include "soc_fifo.h"
+
+unsigned soc_fifo_level(soc_fifo_t fifo)
+{
+    return fifo->head - fifo->tail;
+}
+
+unsigned soc_fifo_space(soc_fifo_t fifo)
+{
+    return fifo->mask + 1 - soc_fifo_level(fifo);
+}
+
+int soc_fifo_full(soc_fifo_t fifo)
+{
+    return soc_fifo_space(fifo) == 0;
+}
+
+int soc_fifo_empty(soc_fifo_t fifo)
+{
+    return soc_fifo_level(fifo) == 0;
+}
+
+int soc_fifo_ready(soc_fifo_t fifo)
+{
+    if (!fifo->ready && soc_fifo_level(fifo) >= fifo->ready_level) {
+        fifo->ready = 1;
+    }
+
+    return fifo->ready;
+}
+
+unsigned soc_fifo_ready_level(soc_fifo_t fifo)
+{
+    return fifo->ready_level;
+}
+
+void soc_fifo_ready_level_set(soc_fifo_t fifo, unsigned ready_level)
+{
+    if (ready_level > fifo->mask + 1) {
+        ready_level = fifo->mask + 1;
+    }
+    fifo->ready_level = ready_level;
+}
+
+int soc_fifo_put_n(soc_fifo_t fifo, const void *elements, unsigned n)
+{
+    const uint8_t *src = elements;
+    const unsigned head = fifo->head;
+    const unsigned index = head & fifo->mask;
+    unsigned first;
+
+    if (fifo->mask + 1 - (head - fifo->tail) < n) {
+        return -1;
+    }
+
+    /* The elements may wrap around the end of the buffer */
+    first = fifo->mask + 1 - index;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(fifo->buffer + index * fifo->element_size, src, first * fifo->element_size);
+    memcpy(fifo->buffer, src + first * fifo->element_size, (n - first) * fifo->element_size);
+
+    /* The elements must be written before the consumer can see them */
+    RTOS_MEMORY_BARRIER();
+    fifo->head = head + n;
+
+    return 0;
+}
+
+int soc_fifo_get_n(soc_fifo_t fifo, void *elements, unsigned n)
+{
+    uint8_t *dst = elements;
+    const unsigned tail = fifo->tail;
+    const unsigned index = tail & fifo->mask;
+    unsigned first;
+
+    if (!soc_fifo_ready(fifo) || fifo->head - tail < n) {
+        memset(dst, 0, n * fifo->element_size);
+        return -1;
+    }
+
+    /* The head must be read before the elements it covers */
+    RTOS_MEMORY_BARRIER();
+
+    first = fifo->mask + 1 - index;
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dst, fifo->buffer + index * fifo->element_size, first * fifo->element_size);
+    memcpy(dst + first * fifo->element_size, fifo->buffer, (n - first) * fifo->element_size);
+
+    /* The elements must be read before the producer can overwrite them */
+    RTOS_MEMORY_BARRIER();
+    fifo->tail = tail + n;
+
+    if (fifo->head == fifo->tail) {
+        fifo->ready = 0;
+    }
+
+    return 0;
+}
+
+int soc_fifo_put(soc_fifo_t fifo, const void *element)
+{
+    return soc_fifo_put_n(fifo, element, 1);
+}
+
+int soc_fifo_get(soc_fifo_t fifo, void *element)
+{
+    return soc_fifo_get_n(fifo, element, 1);
+}
+
+void soc_fifo_put_blocking(soc_fifo_t fifo, const void *element)
+{
+    while (soc_fifo_put_n(fifo, element, 1) != 0);
+}
+
+void soc_fifo_get_blocking(soc_fifo_t fifo, void *element)
+{
+    while (soc_fifo_get_n(fifo, element, 1) != 0);
+}
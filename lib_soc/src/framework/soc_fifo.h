@@ -0,0 +1,120 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_FIFO_H_
+#define SOC_FIFO_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#ifdef __XC__
+extern "C" {
+#endif //__XC__
+
+/*
+ * A lock free single producer, single consumer FIFO of fixed size
+ * elements, for passing data between two tasks on the same tile, such
+ * as the logical cores of a bitstream device.
+ *
+ * The number of elements must be a power of two. head and tail count
+ * every element ever written and read, so the level is always
+ * head - tail and they are masked to index the buffer. Only the
+ * producer writes head and only the consumer writes tail and ready, so
+ * no lock is needed. Each side makes its element accesses before it
+ * advances its own index, keeping the other side from seeing an index
+ * ahead of the data.
+ *
+ * The consumer only sees the FIFO as ready once its level reaches
+ * ready_level, and then until it is empty again.
+ */
+
+#ifdef __XC__
+/*
+ * can't use the volatile keyword
+ * in the xC definition of the struct
+ * below. This is fine since only the
+ * C code in soc_fifo.c requires that
+ * the members be volatile.
+ */
+#define volatile
+#endif
+
+struct soc_fifo {
+    uint8_t * const buffer;
+    const unsigned mask;           // element count - 1
+    const size_t element_size;     // in bytes
+    unsigned ready_level;          // in elements
+    volatile int ready;
+    volatile unsigned head;        // total elements written
+    volatile unsigned tail;        // total elements read
+};
+
+typedef struct soc_fifo * soc_fifo_t;
+
+#ifdef __XC__
+#undef volatile
+#endif
+
+/*
+ * Declares a FIFO of buf_len elements of el_sz bytes each, and sets
+ * fptr to point to it. buf_len must be a power of two.
+ */
+#define soc_fifo_init(fptr, buf_len, el_sz, rdy_lvl)  \
+uint8_t fptr##_buf[(buf_len)*(el_sz)] = {0};          \
+struct soc_fifo fptr##_f = {                          \
+    (fptr##_buf),                                     \
+    (buf_len) - 1,                                    \
+    (el_sz),                                          \
+    (rdy_lvl),                                        \
+    0,                                                \
+    0,                                                \
+    0};                                               \
+fptr = &fptr##_f;
+
+/* The number of elements in the FIFO */
+unsigned soc_fifo_level(soc_fifo_t fifo);
+
+/* The number of elements that may be put into the FIFO */
+unsigned soc_fifo_space(soc_fifo_t fifo);
+
+int soc_fifo_full(soc_fifo_t fifo);
+int soc_fifo_empty(soc_fifo_t fifo);
+
+/* Only to be called by the consumer */
+int soc_fifo_ready(soc_fifo_t fifo);
+
+/*
+ * Gets and sets the level the FIFO must reach before the consumer sees
+ * it as ready. The level is limited to the number of elements the
+ * FIFO holds. Only to be called by the consumer.
+ */
+unsigned soc_fifo_ready_level(soc_fifo_t fifo);
+void soc_fifo_ready_level_set(soc_fifo_t fifo, unsigned ready_level);
+
+/*
+ * Puts n elements into the FIFO. Returns 0, or -1 without putting any
+ * if there is not space for all n.
+ */
+int soc_fifo_put_n(soc_fifo_t fifo, const void *elements, unsigned n);
+
+/*
+ * Gets n elements from the FIFO. Returns 0, or -1 without getting any
+ * if the FIFO is not ready or holds fewer than n. The elements are
+ * then zeroed.
+ */
+int soc_fifo_get_n(soc_fifo_t fifo, void *elements, unsigned n);
+
+int soc_fifo_put(soc_fifo_t fifo, const void *element);
+int soc_fifo_get(soc_fifo_t fifo, void *element);
+
+/*
+ * These spin until they can put or get an element, so should only be
+ * used by tasks that have a logical core to themselves.
+ */
+void soc_fifo_put_blocking(soc_fifo_t fifo, const void *element);
+void soc_fifo_get_blocking(soc_fifo_t fifo, void *element);
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* SOC_FIFO_H_ */
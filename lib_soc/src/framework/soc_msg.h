@@ -0,0 +1,154 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_MSG_H_
+#define SOC_MSG_H_
+
+#ifndef __XC__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Addressed messages between tiles, with credit based flow control.
+ *
+ * Each tile that takes part creates one endpoint with
+ * soc_msg_endpoint_init(). Any endpoint may then send a message to any
+ * other by tile number, without a channel being established for each
+ * pair of tiles. The xCORE switch carries each message to its
+ * destination, over as many links as are needed.
+ *
+ * Every message is a complete packet, closed with an END token, so no
+ * route through the switch is held open between messages and traffic to
+ * one tile never waits behind traffic to another. A sender may only send
+ * to a tile while it holds one of the SOC_MSG_CREDITS credits that tile
+ * grants it, and each credit stands for a free slot in the receiver.
+ * Credits go back to the sender as messages are taken by the receiving
+ * application.
+ *
+ * Each endpoint receives into its slots on a thread of its own, which
+ * runs soc_msg_endpoint_receiver(). That thread only ever reads from the
+ * endpoint's mailbox chanend, so the packets sent to a tile are always
+ * taken off the switch, however slowly its application takes them from
+ * the endpoint and even while that application is itself blocked
+ * sending. Two tiles sending to each other at once therefore both
+ * finish. Sends and credit returns are made from a separate chanend.
+ *
+ * Other than soc_msg_endpoint_receiver(), an endpoint must only be used
+ * by one thread or task at a time.
+ */
+
+#define SOC_MSG_TILE_COUNT 4
+
+#define SOC_MSG_SLOT_COUNT (SOC_MSG_TILE_COUNT * SOC_MSG_CREDITS)
+
+typedef struct {
+    int src;
+    int length;
+    uint32_t data[(SOC_MSG_MAX_LEN + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+} soc_msg_slot_t;
+
+typedef struct {
+    int tile;
+
+    /* The mailbox that the other tiles send to, only read by the receiver */
+    chanend rx_c;
+
+    /* The chanend that messages and credit returns are sent from */
+    chanend tx_c;
+
+    /* The mailbox of each other tile, or 0 for tiles not taking part */
+    chanend peer[SOC_MSG_TILE_COUNT];
+
+    /*
+     * The credits used for sending to each tile, and those that it has
+     * returned. The first is only written by the application and the
+     * second only by the receiver, so neither needs a lock.
+     */
+    unsigned tx_credits_used[SOC_MSG_TILE_COUNT];
+    volatile unsigned tx_credits_returned[SOC_MSG_TILE_COUNT];
+
+    /*
+     * Received messages not yet taken by the application. slot_in is
+     * the count of messages received, only written by the receiver,
+     * and slot_out the count taken, only written by the application.
+     */
+    soc_msg_slot_t slot[SOC_MSG_SLOT_COUNT];
+    volatile unsigned slot_in;
+    volatile unsigned slot_out;
+} soc_msg_endpoint_t;
+
+/**
+ * Creates the endpoint for the calling tile. This must be called by
+ * every tile taking part at the same time, in the same way as
+ * soc_channel_establish(). Each of the xTileNChan arguments is the
+ * already established channel to tile N, as passed to the tile's
+ * bitstream or main function, or 0 for this tile and for tiles that
+ * are not taking part.
+ *
+ * \param ep    The endpoint to initialize.
+ * \param tile  The number of the calling tile.
+ */
+void soc_msg_endpoint_init(
+        soc_msg_endpoint_t *ep,
+        int tile,
+        chanend xTile0Chan,
+        chanend xTile1Chan,
+        chanend xTile2Chan,
+        chanend xTile3Chan);
+
+/**
+ * Receives the messages and credit returns sent to the endpoint,
+ * forever. Must run on its own thread on the same tile, started once
+ * soc_msg_endpoint_init() has returned.
+ *
+ * \param ep  The endpoint.
+ */
+void soc_msg_endpoint_receiver(
+        soc_msg_endpoint_t *ep);
+
+/**
+ * Sends a message to the endpoint on another tile. This may wait for
+ * the switch to carry the message, but the receiver always takes it, so
+ * never waits for the receiving application.
+ *
+ * \param ep        The sending endpoint.
+ * \param dst_tile  The tile to send the message to.
+ * \param msg       The message, which must be word aligned.
+ * \param length    The length of the message in bytes, no more than
+ *                  SOC_MSG_MAX_LEN.
+ *
+ * \returns 0 if the message was sent, or -1 if no credit is held for
+ *          dst_tile. The credits come back as dst_tile takes the
+ *          messages already sent to it.
+ */
+int soc_msg_send(
+        soc_msg_endpoint_t *ep,
+        int dst_tile,
+        const void *msg,
+        size_t length);
+
+/**
+ * Takes the oldest received message, copying it to msg. Returns its
+ * length, and sets *src_tile to the tile it came from. Returns -1 if no
+ * message has been received, or -2 if the message is longer than
+ * max_length, in which case it is left to be taken into a larger buffer.
+ */
+int soc_msg_try_receive(
+        soc_msg_endpoint_t *ep,
+        int *src_tile,
+        void *msg,
+        size_t max_length);
+
+/**
+ * The same as soc_msg_try_receive(), but waits until a message has
+ * been received.
+ */
+int soc_msg_receive(
+        soc_msg_endpoint_t *ep,
+        int *src_tile,
+        void *msg,
+        size_t max_length);
+
+#endif // __XC__
+
+#endif /* SOC_MSG_H_ */
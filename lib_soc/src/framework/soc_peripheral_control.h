@@ -92,6 +92,160 @@ void soc_peripheral_varlist_rx(
         int num_args,
         ...);
 
+/*
+ * The packed control protocol.
+ *
+ * Each control call made with soc_peripheral_control_call() is a single
+ * packet holding an 8-bit function code followed by all of its
+ * parameters, with the return values, if there are any, coming back in
+ * a single reply packet. This replaces the two or three synchronized
+ * transactions of a call made with soc_peripheral_function_code_tx(),
+ * soc_peripheral_varlist_tx() and soc_peripheral_varlist_rx().
+ *
+ * A peripheral must use one protocol or the other for all of its
+ * function codes, as the two are not interchangeable.
+ *
+ * Function codes used with the packed protocol must be less than
+ * SOC_PERIPHERAL_CONTROL_ASYNC.
+ */
+
+/*
+ * Set in the function code received by the peripheral
+ * when the call was made with soc_peripheral_control_submit().
+ */
+#define SOC_PERIPHERAL_CONTROL_ASYNC 0x80
+
+/** Call a control function in a bitstream peripheral.
+ *
+ * This function is intended to be used by a software driver. It sends
+ * the function code and all of its parameters at once, and then, only
+ * when num_results is not zero, waits for the return values.
+ *
+ * \param[in] c           The control chanend for the peripheral.
+ * \param[in] code        The function code to send.
+ * \param[in] num_args    The number of parameters to send.
+ * \param[in] num_results The number of return values to receive.
+ * \param[in,out] ...     A pair for each parameter, followed by a pair
+ *                        for each return value. The first value of each
+ *                        pair is an int with the length. The second is a
+ *                        pointer to the parameter to send or to where the
+ *                        return value should be received.
+ */
+void soc_peripheral_control_call(
+        chanend c,
+        uint8_t code,
+        int num_args,
+        int num_results,
+        ...);
+
+/** Submit a control call to a bitstream peripheral without waiting for it.
+ *
+ * This function is intended to be used by a software driver, for calls
+ * that may take the peripheral a long time, such as I2C transfers. It
+ * sends the function code and all of its parameters, and returns
+ * straight away. When the peripheral has the return values ready it
+ * sends SOC_PERIPHERAL_ISR_CONTROL_DONE_BM to the ISR registered for it,
+ * after which they must be received with soc_peripheral_control_result_rx().
+ *
+ * Only one call may be outstanding on a control channel at a time, and
+ * the peripheral must have an IRQ channel.
+ *
+ * \param[in] c        The control chanend for the peripheral.
+ * \param[in] code     The function code to send.
+ * \param[in] num_args The number of parameters to send.
+ * \param[in] ...      A pair for each parameter, as with
+ *                     soc_peripheral_varlist_tx().
+ */
+void soc_peripheral_control_submit(
+        chanend c,
+        uint8_t code,
+        int num_args,
+        ...);
+
+/** Receive the return values of a call made with soc_peripheral_control_submit().
+ *
+ * This must only be called once the peripheral has sent
+ * SOC_PERIPHERAL_ISR_CONTROL_DONE_BM, so it never waits.
+ *
+ * \param[in] c           The control chanend for the peripheral.
+ * \param[in] num_results The number of return values to receive.
+ * \param[in,out] ...     A pair for each return value, as with
+ *                        soc_peripheral_varlist_rx().
+ */
+void soc_peripheral_control_result_rx(
+        chanend c,
+        int num_results,
+        ...);
+
+/** Receive a packed function code from a software driver.
+ *
+ * This function is intended to be used by a bitstream peripheral.
+ * It may be used as a select case. The parameters that follow must
+ * then be received with soc_peripheral_control_args_rx(), and the call
+ * completed with soc_peripheral_control_results_tx().
+ *
+ * \param[in]  c    The control chanend for the peripheral.
+ * \param[out] code The received function code.
+ */
+#ifdef __XC__
+#pragma select handler
+#endif //__XC__
+void soc_peripheral_control_code_rx(
+        chanend c,
+        uint8_t *code);
+
+/** Receive the parameters of a packed control call.
+ *
+ * This may be called more than once for a single call, for example
+ * when the length of one parameter is given by an earlier one.
+ *
+ * \param[in] c        The control chanend for the peripheral.
+ * \param[in] num_args The number of parameters to receive.
+ * \param[in,out] ...  A pair for each parameter, as with
+ *                     soc_peripheral_varlist_rx().
+ */
+void soc_peripheral_control_args_rx(
+        chanend c,
+        int num_args,
+        ...);
+
+/** Complete a packed control call, sending its return values.
+ *
+ * This must be called once for every call received, after all of its
+ * parameters, with the same number of return values as the driver
+ * passed to soc_peripheral_control_call(). This may be zero.
+ *
+ * \param[in] c           The control chanend for the peripheral.
+ * \param[in] num_results The number of return values to send.
+ * \param[in] ...         A pair for each return value, as with
+ *                        soc_peripheral_varlist_tx().
+ */
+void soc_peripheral_control_results_tx(
+        chanend c,
+        int num_results,
+        ...);
+
+/** Complete a packed control call that may have been submitted asynchronously.
+ *
+ * The same as soc_peripheral_control_results_tx(), except that when
+ * code, as received by soc_peripheral_control_code_rx(), has
+ * SOC_PERIPHERAL_CONTROL_ASYNC set, SOC_PERIPHERAL_ISR_CONTROL_DONE_BM
+ * is first sent over irq_c to tell the driver that the return values
+ * are ready.
+ *
+ * \param[in] c           The control chanend for the peripheral.
+ * \param[in] irq_c       The IRQ chanend for the peripheral.
+ * \param[in] code        The function code received for the call.
+ * \param[in] num_results The number of return values to send.
+ * \param[in] ...         A pair for each return value.
+ */
+void soc_peripheral_control_results_irq_tx(
+        chanend c,
+        NULLABLE_RESOURCE(chanend, irq_c),
+        uint8_t code,
+        int num_results,
+        ...);
+
 #ifdef __XC__
 }
 #endif //__XC__
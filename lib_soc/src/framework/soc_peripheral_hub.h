@@ -5,6 +5,8 @@
 
 #include <stdint.h>
 
+#include "soc_dma_ring_buf.h"
+
 #define SOC_PERIPHERAL_CHANNEL_COUNT 4
 #define SOC_PERIPHERAL_FROM_DMA_CH   0
 #define SOC_PERIPHERAL_TO_DMA_CH     1
@@ -14,6 +16,44 @@
 #define SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM 0x00000001
 #define SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM 0x00000002
 
+/*
+ * Ring occupancy notifications, only sent once enabled with
+ * soc_peripheral_dma_watermarks_set(). LOW means the number of
+ * buffers waiting for the DMA has fallen below the low watermark.
+ * HIGH means the number of completed buffers not yet taken back by
+ * the application has reached the high watermark.
+ */
+#define SOC_PERIPHERAL_ISR_DMA_RX_LOW_BM  0x00000004
+#define SOC_PERIPHERAL_ISR_DMA_RX_HIGH_BM 0x00000008
+#define SOC_PERIPHERAL_ISR_DMA_TX_LOW_BM  0x00000010
+#define SOC_PERIPHERAL_ISR_DMA_TX_HIGH_BM 0x00000020
+
+/*
+ * Sent by a peripheral that supports asynchronous control calls when
+ * the results of one submitted with soc_peripheral_control_submit()
+ * are ready to be received with soc_peripheral_control_result_rx().
+ */
+#define SOC_PERIPHERAL_ISR_CONTROL_DONE_BM 0x00000040
+
+/*
+ * Flags for soc_peripheral_register_flags().
+ *
+ * SOC_PERIPHERAL_TX_DMA_STREAMING: the device sends its data to the
+ * hub with soc_peripheral_tx_dma_stream_xfer() rather than with
+ * soc_peripheral_tx_dma_xfer().
+ */
+#define SOC_PERIPHERAL_TX_DMA_STREAMING 0x00000001
+
+/*
+ * SOC_PERIPHERAL_TX_DMA_REMOTE: the hub does not receive the device's
+ * data. Instead soc_peripheral_tx_dma_remote_receiver() must be run for
+ * the device on another thread of the hub's tile, and receives its data
+ * straight into the RX ring. This is meant for a device on another tile,
+ * so that the hub thread does not have to take in every frame it sends.
+ * It may be combined with SOC_PERIPHERAL_TX_DMA_STREAMING.
+ */
+#define SOC_PERIPHERAL_TX_DMA_REMOTE    0x00000002
+
 typedef enum {
     SOC_DMA_TX_REQUEST,
     SOC_DMA_RX_REQUEST
@@ -31,18 +71,217 @@ typedef struct soc_peripheral * unsafe soc_peripheral_t;
 
 #ifndef __XC__
 
-#include "soc_dma_ring_buf.h"
 #include "rtos_support.h"
 
 soc_peripheral_t soc_peripheral_register(
         chanend c[SOC_PERIPHERAL_CHANNEL_COUNT]);
 
+/**
+ * Registers a peripheral with the hub in the same way as
+ * soc_peripheral_register(), but with flags that choose how the
+ * hub transfers data with it. This must match what the device
+ * itself uses.
+ *
+ * \param c      The device's channel ends.
+ * \param flags  A bitwise OR of the SOC_PERIPHERAL_*_DMA_* flags.
+ *
+ * \returns the peripheral device.
+ */
+soc_peripheral_t soc_peripheral_register_flags(
+        chanend c[SOC_PERIPHERAL_CHANNEL_COUNT],
+        uint32_t flags);
+
 void soc_peripheral_handler_register(
         soc_peripheral_t device,
         int core_id,
         void *app_data,
         rtos_irq_isr_t isr);
 
+#if SOC_PERIPHERAL_IRQ_AFFINITY
+
+/**
+ * Moves the handling of a peripheral's interrupts to another RTOS core.
+ * May be called at any time after soc_peripheral_handler_register().
+ * An IRQ already pending on the previous core is still handled there,
+ * but the ISR is never run on both cores at once.
+ *
+ * \param device   The peripheral device.
+ * \param core_id  The RTOS core that will handle the peripheral's interrupts.
+ */
+void soc_peripheral_irq_core_set(
+        soc_peripheral_t device,
+        int core_id);
+
+/**
+ * Gets the RTOS core that handles a peripheral's interrupts.
+ *
+ * \param device   The peripheral device.
+ *
+ * \returns the RTOS core ID.
+ */
+int soc_peripheral_irq_core_get(
+        soc_peripheral_t device);
+
+/**
+ * Balances the peripheral ISR load across the RTOS cores. This compares
+ * the time each core has spent in peripheral ISRs since the previous call.
+ * If the difference between the busiest and idlest cores is greater than
+ * threshold, the busiest peripheral that can be moved to the idlest core
+ * without making the imbalance worse is moved there.
+ *
+ * This is meant to be called periodically from a single RTOS task.
+ *
+ * \param threshold  The imbalance, in reference timer ticks, at which a
+ *                   peripheral is moved.
+ *
+ * \returns the ID of the peripheral that was moved, or -1 if none was.
+ */
+int soc_peripheral_irq_balance(
+        uint32_t threshold);
+
+#endif /* SOC_PERIPHERAL_IRQ_AFFINITY */
+
+#if SOC_PERIPHERAL_STATS
+
+/*
+ * The DMA counters of a peripheral. TX is data taken from its TX ring
+ * by the device, and RX is data put in its RX ring by the device. All
+ * times are in reference timer ticks.
+ */
+typedef struct {
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t tx_transfers;
+    uint32_t rx_transfers;
+
+    /* The number of times data from the device had to wait for a free RX buffer */
+    uint32_t rx_stalls;
+
+    /* The number of times soc_peripheral_tx_dma_direct_get() found no free RX buffer */
+    uint32_t rx_drops;
+
+    /* The time the hub has spent in dma_to_device() and device_to_dma() */
+    uint64_t tx_ticks;
+    uint64_t rx_ticks;
+} soc_peripheral_stats_t;
+
+/*
+ * The time a peripheral hub instance has spent waiting for
+ * events, and handling them, in reference timer ticks.
+ */
+typedef struct {
+    uint64_t busy_ticks;
+    uint64_t idle_ticks;
+} soc_peripheral_hub_stats_t;
+
+/**
+ * Gets a snapshot of a peripheral's DMA counters. The counters are
+ * never reset, so rates are found from the difference between two
+ * snapshots. This may be called from any core at any time, and never
+ * makes the hub wait.
+ *
+ * \param device  The peripheral device.
+ * \param stats   Set to the peripheral's counters.
+ */
+void soc_peripheral_stats_get(
+        soc_peripheral_t device,
+        soc_peripheral_stats_t *stats);
+
+/**
+ * Gets a snapshot of how busy a peripheral hub instance has been
+ * since it started.
+ *
+ * \param hub_id  The hub instance.
+ * \param stats   Set to the hub's busy and idle times.
+ */
+void soc_peripheral_hub_stats_get(
+        int hub_id,
+        soc_peripheral_hub_stats_t *stats);
+
+#endif /* SOC_PERIPHERAL_STATS */
+
+/**
+ * Sets the priority of a peripheral's interrupts. When the interrupts of
+ * several peripherals are pending on the same RTOS core at once, the ISRs
+ * of those with a higher priority are run first.
+ *
+ * Must be called after soc_peripheral_handler_register().
+ *
+ * \param device    The peripheral device.
+ * \param priority  The priority, from RTOS_IRQ_PRIORITY_LOWEST to
+ *                  RTOS_IRQ_PRIORITY_HIGHEST.
+ */
+void soc_peripheral_irq_priority_set(
+        soc_peripheral_t device,
+        int priority);
+
+/**
+ * Masks a peripheral's interrupts, so that its ISR is not run until
+ * soc_peripheral_irq_unmask() is called, while other peripherals' ISRs
+ * still are. Interrupts sent meanwhile are run once it is unmasked.
+ * See rtos_irq_source_mask().
+ *
+ * Must be called after soc_peripheral_handler_register().
+ *
+ * \param device    The peripheral device.
+ */
+void soc_peripheral_irq_mask(
+        soc_peripheral_t device);
+
+/**
+ * Unmasks a peripheral's interrupts masked by soc_peripheral_irq_mask().
+ *
+ * \param device    The peripheral device.
+ */
+void soc_peripheral_irq_unmask(
+        soc_peripheral_t device);
+
+/**
+ * Sets the IRQ moderation for a peripheral whose DMA is performed by the
+ * peripheral hub. Rather than sending an IRQ for every completed DMA transfer,
+ * the hub sends one once count transfers have completed, or once ticks timer
+ * ticks have passed since the first of them, whichever happens first.
+ *
+ * When moderation is enabled a single IRQ may stand for several completed
+ * DMA transfers, so the ISR must handle every completed buffer in the ring
+ * rather than just one. count should be less than the number of descriptors
+ * in the ring.
+ *
+ * \param device  The peripheral device.
+ * \param count   The number of completed transfers per IRQ. 1 disables moderation.
+ * \param ticks   The maximum number of 100 MHz reference timer ticks an IRQ may
+ *                be deferred for. Must be non-zero when count is greater than 1.
+ */
+void soc_peripheral_irq_moderation_set(
+        soc_peripheral_t device,
+        int count,
+        uint32_t ticks);
+
+/**
+ * Sets the occupancy watermarks of one of a peripheral's DMA rings.
+ * Each time a DMA transfer takes the number of buffers waiting in the
+ * ring from at least low to below it, the peripheral's ISR is sent
+ * SOC_PERIPHERAL_ISR_DMA_RX_LOW_BM or SOC_PERIPHERAL_ISR_DMA_TX_LOW_BM.
+ * Each time a transfer takes the number of completed buffers not yet
+ * taken back by the application from below high to at least high, it
+ * is sent SOC_PERIPHERAL_ISR_DMA_RX_HIGH_BM or _TX_HIGH_BM. These are
+ * sent straight away, even when IRQ moderation is enabled.
+ *
+ * A refill task can use the RX low watermark to add buffers before
+ * the ring runs dry and the device has to wait.
+ *
+ * \param device  The peripheral device.
+ * \param ring    SOC_DMA_RX_REQUEST for the RX ring, or SOC_DMA_TX_REQUEST
+ *                for the TX ring.
+ * \param low     The low watermark. 0 disables it.
+ * \param high    The high watermark. 0 disables it.
+ */
+void soc_peripheral_dma_watermarks_set(
+        soc_peripheral_t device,
+        soc_dma_request_t ring,
+        int low,
+        int high);
+
 void *soc_peripheral_app_data(
         soc_peripheral_t device);
 
@@ -62,6 +301,100 @@ void soc_peripheral_hub_dma_request(
 uint32_t soc_peripheral_interrupt_status(
         soc_peripheral_t device);
 
+/**
+ * Lends a peripheral on the same tile as its driver the next buffer
+ * in its TX ring, so that it may read from it in place rather than
+ * have it copied by soc_peripheral_rx_dma_direct_xfer(). The buffer
+ * must be returned with soc_peripheral_rx_dma_direct_commit() once
+ * the peripheral is done with it.
+ *
+ * The direct calls, those with _direct_ in their names, each update
+ * the device's ring buffers, counters and interrupt status without a
+ * lock. All of a device's direct calls must therefore be made by the
+ * same thread, which is asserted when SOC_PERIPHERAL_LOCKLESS_STATUS
+ * is enabled. A device with separate RX and TX threads must use the
+ * channel transfers for one of them.
+ *
+ * \param device  The peripheral device.
+ * \param length  Set to the length of the buffer.
+ * \param more    Set to non-zero if the buffer is not the last of a frame.
+ *
+ * \returns the buffer, or NULL if there is none ready.
+ */
+void *soc_peripheral_rx_dma_direct_get(
+        soc_peripheral_t device,
+        int *length,
+        int *more);
+
+/**
+ * Returns the buffer lent by soc_peripheral_rx_dma_direct_get() to
+ * the TX ring. Once the last buffer of a frame is returned the driver
+ * is sent a DMA TX done interrupt.
+ *
+ * All of a device's direct calls must be made by the same thread.
+ *
+ * \param device  The peripheral device.
+ */
+void soc_peripheral_rx_dma_direct_commit(
+        soc_peripheral_t device);
+
+/**
+ * Lends a peripheral on the same tile as its driver the next buffer
+ * in its RX ring, so that it may write to it in place rather than
+ * have data copied in by soc_peripheral_tx_dma_direct_xfer(). The
+ * buffer must be returned with soc_peripheral_tx_dma_direct_commit().
+ *
+ * All of a device's direct calls must be made by the same thread.
+ *
+ * \param device      The peripheral device.
+ * \param max_length  Set to the size of the buffer.
+ *
+ * \returns the buffer, or NULL if there is none ready.
+ */
+void *soc_peripheral_tx_dma_direct_get(
+        soc_peripheral_t device,
+        int *max_length);
+
+/**
+ * Returns the buffer lent by soc_peripheral_tx_dma_direct_get() to
+ * the RX ring, and sends the driver a DMA RX done interrupt.
+ *
+ * All of a device's direct calls must be made by the same thread.
+ *
+ * \param device  The peripheral device.
+ * \param length  The number of bytes written to the buffer.
+ */
+void soc_peripheral_tx_dma_direct_commit(
+        soc_peripheral_t device,
+        soc_dma_length_t length);
+
+/**
+ * Sends count buffers to the hub, one after the other, as a single
+ * frame, as if they had first been copied together and then sent with
+ * soc_peripheral_tx_dma_xfer(). The stream variant is the same for
+ * soc_peripheral_tx_dma_stream_xfer(), and the direct variant for
+ * soc_peripheral_tx_dma_direct_xfer().
+ *
+ * All of a device's direct calls must be made by the same thread.
+ */
+void soc_peripheral_tx_dma_gather_xfer(
+        chanend c,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count);
+
+void soc_peripheral_tx_dma_stream_gather_xfer(
+        chanend c,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count);
+
+void soc_peripheral_tx_dma_direct_gather_xfer(
+        soc_peripheral_t device,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count);
+
 #endif // __XC__
 
 #ifdef __XC__
@@ -77,36 +410,145 @@ extern "C" {
 void soc_peripheral_rx_dma_ready(
         chanend c);
 
-uint16_t soc_peripheral_rx_dma_xfer(
+soc_dma_length_t soc_peripheral_rx_dma_xfer(
         chanend c,
         void *data,
-        uint16_t max_length);
+        soc_dma_length_t max_length);
 
-uint16_t soc_peripheral_rx_dma_direct_xfer(
+/**
+ * Copies the next frame in the TX ring of a peripheral on the same
+ * tile as its driver into data, and sends the driver a DMA TX done
+ * interrupt. All of a device's direct calls must be made by the
+ * same thread.
+ *
+ * \returns the length of the frame, or 0 if there is none ready.
+ */
+soc_dma_length_t soc_peripheral_rx_dma_direct_xfer(
         soc_peripheral_t device,
         void *data,
-        uint16_t max_length);
+        soc_dma_length_t max_length);
 
 void soc_peripheral_tx_dma_xfer(
         chanend c,
         void *data,
-        uint16_t length);
+        soc_dma_length_t length);
 
+/**
+ * Copies data into the next frame of the RX ring of a peripheral on
+ * the same tile as its driver, and sends the driver a DMA RX done
+ * interrupt. All of a device's direct calls must be made by the same
+ * thread.
+ */
 void soc_peripheral_tx_dma_direct_xfer(
         soc_peripheral_t device,
         void *data,
-        uint16_t length);
+        soc_dma_length_t length);
+
+/**
+ * The same as soc_peripheral_tx_dma_xfer() and
+ * soc_peripheral_tx_dma_direct_xfer(), but with the reference time
+ * at which the data was received by the device, such as a MAC's RX
+ * timestamp. When SOC_DMA_BUF_DESC_TIMESTAMP is enabled it is kept in
+ * each descriptor the data is received into, for the driver to get
+ * with soc_dma_ring_rx_buf_ts_get(). Otherwise it is dropped.
+ * All of a device's direct calls must be made by the same thread.
+ */
+void soc_peripheral_tx_dma_ts_xfer(
+        chanend c,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp);
+
+void soc_peripheral_tx_dma_direct_ts_xfer(
+        soc_peripheral_t device,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp);
+
+/**
+ * The same as soc_peripheral_tx_dma_ts_xfer() and
+ * soc_peripheral_tx_dma_direct_ts_xfer(), but also with a metadata word
+ * describing the data, such as its sequence number, the channel it came
+ * from and flags, see SOC_DMA_META(). When SOC_DMA_BUF_DESC_META is
+ * enabled it is kept in each descriptor the data is received into, for
+ * the driver to get with soc_dma_ring_rx_buf_ex_get(), rather than in
+ * the data itself. Otherwise it is dropped.
+ * All of a device's direct calls must be made by the same thread.
+ */
+void soc_peripheral_tx_dma_ex_xfer(
+        chanend c,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp,
+        uint32_t meta);
+
+void soc_peripheral_tx_dma_direct_ex_xfer(
+        soc_peripheral_t device,
+        void *data,
+        soc_dma_length_t length,
+        uint32_t timestamp,
+        uint32_t meta);
+
+/**
+ * Sends data to the hub like soc_peripheral_tx_dma_xfer(), for a device
+ * registered with SOC_PERIPHERAL_TX_DMA_STREAMING. The data is sent a
+ * word at a time over a route that is left open between transfers, so
+ * there is no transaction set up or torn down for each one. This suits
+ * fixed rate devices that send a frame of the same size each time.
+ *
+ * Both data and length must be a multiple of 4, as must the length of
+ * every buffer in the RX ring that the data is received into.
+ */
+void soc_peripheral_tx_dma_stream_xfer(
+        chanend c,
+        void *data,
+        soc_dma_length_t length);
+
+#ifdef __XC__
+/*
+ * soc_peripheral_rx_dma_direct_get() and
+ * soc_peripheral_rx_dma_direct_commit(), for devices written in XC,
+ * which read the lent buffer through an unsafe pointer.
+ */
+void * unsafe soc_peripheral_rx_dma_direct_get(
+        soc_peripheral_t device,
+        int * unsafe length,
+        int * unsafe more);
+
+void soc_peripheral_rx_dma_direct_commit(
+        soc_peripheral_t device);
+#endif //__XC__
 
 void soc_peripheral_irq_send(
         chanend c,
         uint32_t status);
 
+/**
+ * Sends the driver of a peripheral on the same tile an interrupt with
+ * status, like soc_peripheral_irq_send(). All of a device's direct
+ * calls must be made by the same thread.
+ */
 void soc_peripheral_irq_direct_send(
         soc_peripheral_t device,
         uint32_t status);
 
 void soc_peripheral_hub();
 
+void soc_peripheral_hub_instance(int hub_id);
+
+/**
+ * Receives the data sent by a device registered with
+ * SOC_PERIPHERAL_TX_DMA_REMOTE straight into its RX ring, forever.
+ * Must run on its own thread on the same tile as the hub. The hub
+ * then only does the bookkeeping for the device's RX ring, and the
+ * frames it sends no longer take up the hub thread. It makes the
+ * device's direct calls, so nothing else may make them.
+ *
+ * \param device  The peripheral device.
+ */
+void soc_peripheral_tx_dma_remote_receiver(
+        soc_peripheral_t device);
+
 #ifdef __XC__
 }
 #endif //__XC__
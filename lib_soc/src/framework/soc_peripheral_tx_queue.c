@@ -0,0 +1,116 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "soc.h"
+#include "soc_peripheral_tx_queue.h"
+
+#include "xassert.h"
+
+#if SOC_PERIPHERAL_TX_QUEUE_COUNT > 0
+
+/*
+ * Each queue is written only by its device's thread, and read only by
+ * its sender's thread. head and tail count frames, and are only
+ * reduced to a slot when a frame is accessed.
+ */
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    soc_dma_length_t lengths[SOC_PERIPHERAL_TX_QUEUE_LEN];
+    uint32_t frames[SOC_PERIPHERAL_TX_QUEUE_LEN][SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE / sizeof(uint32_t)];
+} tx_queue_t;
+
+static tx_queue_t tx_queues[SOC_PERIPHERAL_TX_QUEUE_COUNT];
+
+/*
+ * Waits for a free frame in a queue. The sender is only slower than
+ * the device if the link cannot keep up, so this is not expected to
+ * wait for long.
+ */
+static uint8_t *tx_queue_claim(tx_queue_t *q)
+{
+    while (q->head - q->tail == SOC_PERIPHERAL_TX_QUEUE_LEN);
+
+    return (uint8_t *) q->frames[q->head % SOC_PERIPHERAL_TX_QUEUE_LEN];
+}
+
+static void tx_queue_commit(tx_queue_t *q, soc_dma_length_t length)
+{
+    q->lengths[q->head % SOC_PERIPHERAL_TX_QUEUE_LEN] = length;
+    RTOS_MEMORY_BARRIER();
+    q->head++;
+}
+
+void soc_peripheral_tx_queue_put(
+        int queue_id,
+        void *data,
+        soc_dma_length_t length)
+{
+    tx_queue_t *q;
+
+    xassert(queue_id >= 0 && queue_id < SOC_PERIPHERAL_TX_QUEUE_COUNT);
+    xassert(length <= SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE);
+    q = &tx_queues[queue_id];
+
+    memcpy(tx_queue_claim(q), data, length);
+    tx_queue_commit(q, length);
+}
+
+void soc_peripheral_tx_queue_gather_put(
+        int queue_id,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
+{
+    tx_queue_t *q;
+    uint8_t *frame;
+    soc_dma_length_t length = 0;
+    int i;
+
+    xassert(queue_id >= 0 && queue_id < SOC_PERIPHERAL_TX_QUEUE_COUNT);
+    q = &tx_queues[queue_id];
+
+    frame = tx_queue_claim(q);
+    for (i = 0; i < count; i++) {
+        xassert(length + lengths[i] <= SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE);
+        memcpy(frame + length, bufs[i], lengths[i]);
+        length += lengths[i];
+    }
+    tx_queue_commit(q, length);
+}
+
+void soc_peripheral_tx_queue_sender(
+        int queue_id,
+        chanend c,
+        uint32_t flags)
+{
+    tx_queue_t *q;
+    hwtimer_t tmr;
+
+    xassert(queue_id >= 0 && queue_id < SOC_PERIPHERAL_TX_QUEUE_COUNT);
+    q = &tx_queues[queue_id];
+
+    hwtimer_alloc(&tmr);
+
+    for (;;) {
+        int slot;
+
+        while (q->tail == q->head) {
+            hwtimer_delay(tmr, SOC_PERIPHERAL_TX_QUEUE_POLL_TICKS);
+        }
+        RTOS_MEMORY_BARRIER();
+
+        slot = q->tail % SOC_PERIPHERAL_TX_QUEUE_LEN;
+        if (flags & SOC_PERIPHERAL_TX_DMA_STREAMING) {
+            soc_peripheral_tx_dma_stream_xfer(c, q->frames[slot], q->lengths[slot]);
+        } else {
+            soc_peripheral_tx_dma_xfer(c, q->frames[slot], q->lengths[slot]);
+        }
+
+        RTOS_MEMORY_BARRIER();
+        q->tail++;
+    }
+}
+
+#endif /* SOC_PERIPHERAL_TX_QUEUE_COUNT > 0 */
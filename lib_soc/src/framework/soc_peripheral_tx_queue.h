@@ -0,0 +1,81 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_PERIPHERAL_TX_QUEUE_H_
+#define SOC_PERIPHERAL_TX_QUEUE_H_
+
+#include <stdint.h>
+#include <xccompat.h>
+
+#include "soc_dma_ring_buf.h"
+
+/*
+ * A sender-side queue for a device on another tile from its hub.
+ *
+ * Normally a device sends each frame to the hub itself, and is held up
+ * until the whole frame has crossed the switch. With a queue, the device
+ * only copies each frame into the queue with one of the put functions.
+ * soc_peripheral_tx_queue_sender(), running on another thread of the
+ * device's tile, sends the frames on to the hub in order. The next frame
+ * is then taken while the previous one is still in flight, and the time
+ * the device spends sending no longer depends on the link's round trip
+ * time. A put only waits when all SOC_PERIPHERAL_TX_QUEUE_LEN frames of
+ * the queue are still waiting to be sent.
+ *
+ * There are SOC_PERIPHERAL_TX_QUEUE_COUNT queues, numbered from 0, each
+ * with room for frames of up to SOC_PERIPHERAL_TX_QUEUE_FRAME_SIZE bytes.
+ */
+
+#if __XC__
+extern "C" {
+#endif //__XC__
+
+/**
+ * Sends the frames put into a queue on to the hub over c, forever.
+ * Sleeps on a timer between polls while the queue is empty.
+ *
+ * \param queue_id  The queue.
+ * \param c         The device's channel to the hub, SOC_PERIPHERAL_TO_DMA_CH.
+ * \param flags     SOC_PERIPHERAL_TX_DMA_STREAMING if the device is registered
+ *                  with it, otherwise 0.
+ */
+void soc_peripheral_tx_queue_sender(
+        int queue_id,
+        chanend c,
+        uint32_t flags);
+
+#ifndef __XC__
+
+/**
+ * Copies a frame into a queue, to be sent to the hub.
+ *
+ * \param queue_id  The queue.
+ * \param data      The frame.
+ * \param length    The length of the frame in bytes.
+ */
+void soc_peripheral_tx_queue_put(
+        int queue_id,
+        void *data,
+        soc_dma_length_t length);
+
+/**
+ * Copies count buffers, one after the other, into a queue as a single
+ * frame, to be sent to the hub.
+ *
+ * \param queue_id  The queue.
+ * \param bufs      The buffers.
+ * \param lengths   The length of each buffer in bytes.
+ * \param count     The number of buffers.
+ */
+void soc_peripheral_tx_queue_gather_put(
+        int queue_id,
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count);
+
+#endif // __XC__
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* SOC_PERIPHERAL_TX_QUEUE_H_ */
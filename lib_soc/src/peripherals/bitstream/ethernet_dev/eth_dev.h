@@ -16,11 +16,23 @@
 #include "smi.h"
 #include "otp_board_info.h"
 
+/*
+ * irq_c is only needed to tell the driver of link state changes, and
+ * may be null when the device is given its peripheral.
+ *
+ * hp_peripheral and hp_data_from_dma_c are the high priority TX device,
+ * whose frames are sent through the RT MAC's high priority queue when
+ * ETHCONF_USE_RT_MAC is set. They may be NULL and null when there is
+ * no such device, and are not used without the RT MAC.
+ */
 void eth_dev(
         soc_peripheral_t peripheral,
         chanend ?data_to_dma_c,
         chanend ?data_from_dma_c,
         chanend ?ctrl_c,
+        chanend ?irq_c,
+        soc_peripheral_t hp_peripheral,
+        chanend ?hp_data_from_dma_c,
         port p_eth_rxclk,
         port p_eth_rxerr,
         port p_eth_rxd,
@@ -40,6 +52,9 @@ void eth_dev_smi_singleport(
         chanend ?data_to_dma_c,
         chanend ?data_from_dma_c,
         chanend ?ctrl_c,
+        chanend ?irq_c,
+        soc_peripheral_t hp_peripheral,
+        chanend ?hp_data_from_dma_c,
         port p_eth_rxclk,
         port p_eth_rxerr,
         port p_eth_rxd,
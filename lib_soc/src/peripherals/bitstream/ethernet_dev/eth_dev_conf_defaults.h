@@ -22,6 +22,16 @@
 #define ETHCONF_SMI_MDC_BIT_POS     (0)
 #endif
 
+/*
+ * How often in reference clock ticks the device reads the PHY's link
+ * state, to send the driver an IRQ when it changes. 0 leaves this out.
+ * The SMI read is local to the device, so only changes cross to the
+ * driver. The default is every 50 ms.
+ */
+#ifndef ETHCONF_LINK_POLL_TICKS
+#define ETHCONF_LINK_POLL_TICKS     (5000000)
+#endif
+
 
 /* RT MAC defaults */
 #ifndef ETHCONF_USE_RT_MAC
@@ -40,4 +50,34 @@
 #define ETHCONF_USE_SHAPER          (0)
 #endif
 
+/*
+ * The bandwidth in bits per second that the shaper lets the high
+ * priority TX queue use, leaving the rest of the link to low priority
+ * frames. 0 leaves the MAC's own setting.
+ */
+#ifndef ETHCONF_SHAPER_IDLE_SLOPE_BPS
+#define ETHCONF_SHAPER_IDLE_SLOPE_BPS (0)
+#endif
+
+
+/* RX defaults */
+
+/*
+ * The most received frames that are sent to the DMA in one go,
+ * while more are waiting in the MAC, before TX and control
+ * requests are serviced again.
+ */
+#ifndef ETHCONF_RX_BATCH
+#define ETHCONF_RX_BATCH            (1)
+#endif
+
+/*
+ * When set to 1, ARP frames are received from the MAC through their own
+ * client, with their own MAC queue, apart from IP frames. The two are
+ * serviced in turn so that a storm of either cannot starve the other.
+ */
+#ifndef ETHCONF_RX_SPLIT_ETHERTYPES
+#define ETHCONF_RX_SPLIT_ETHERTYPES (0)
+#endif
+
 #endif /* ETH_DEV_CONF_DEFAULTS_H_ */
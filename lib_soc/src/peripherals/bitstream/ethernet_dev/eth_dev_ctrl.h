@@ -9,4 +9,18 @@
 #define ETH_DEV_SMI_WRITE_REG          0x04
 #define ETH_DEV_SMI_GET_LINK_STATUS    0x05
 
+/*
+ * Sent to the driver's ISR when the PHY's link comes up or goes down.
+ * When both are set the link changed more than once since the ISR last
+ * ran, and the state it is left in is not known from them alone.
+ */
+#define ETH_DEV_ISR_LINK_UP_BM         0x00000100
+#define ETH_DEV_ISR_LINK_DOWN_BM       0x00000200
+
+/*
+ * The largest frame the device sends to its RX DMA ring. This is
+ * ETHERNET_MAX_PACKET_SIZE from lib_ethernet.
+ */
+#define ETH_DEV_MAX_FRAME_SIZE         (1518)
+
 #endif /* ETH_DEV_CTRL_H_ */
@@ -20,194 +20,585 @@ static const port gpio_lookup[ GPIO_TOTAL_PORT_CNT ] =
 };
 
 static uint32_t port_irq_flags;
+static uint32_t port_event_flags;
+
+static gpio_event_t event_batch[ GPIOCONF_EVENT_BATCH_MAX ];
+static int event_count;
+
+/* The select event ID of the control channel, and of the waveform timer */
+#define GPIO_CTRL_EVENT_ID  ( GPIO_TOTAL_PORT_CNT )
+#define GPIO_WAVE_EVENT_ID  ( GPIO_TOTAL_PORT_CNT + 1 )
+
+typedef struct {
+    int active;
+    port port_res;
+    uint32_t mask;
+    int repeat;                 /* The passes left, or 0 to repeat forever */
+    int step_count;
+    int step;
+    uint32_t next_time;
+    gpio_wave_step_t steps[ GPIOCONF_WAVE_STEPS_MAX ];
+} gpio_wave_t;
+
+static gpio_wave_t waves[ GPIOCONF_WAVE_COUNT ];
+static hwtimer_t wave_timer;
+static int wave_timer_allocated;
 
 static port get_port( gpio_id_t gpio_id )
 {
     return gpio_lookup[ gpio_id ];
 }
 
-void gpio_dev(
-        soc_peripheral_t peripheral,
-        chanend data_to_dma_c,
-        chanend data_from_dma_c,
-        chanend ctrl_c,
-        chanend irq_c)
+/*
+ * Reads a port. If its IRQ has been sent, its trigger is rearmed with
+ * the value read.
+ */
+static int gpio_port_in(
+        gpio_id_t gpio_id,
+        uint32_t *data )
 {
-    gpio_id_t gpio_id;
+    port port_res = get_port( gpio_id );
+    uint32_t mask = ( 0x1 << gpio_id );
     int retval_int;
-    port port_res;
-    uint32_t cmd;
-    uint32_t data;
-    uint32_t mask;
 
-    select_disable_trigger_all();
-    chanend_setup_select( ctrl_c, GPIO_TOTAL_PORT_CNT );
-    chanend_enable_trigger( ctrl_c );
+    if( ( port_irq_flags & mask ) != 0 )
+    {
+        port_irq_flags &= ~mask;
+        retval_int = port_in( port_res, data );
+        port_set_trigger_in_not_equal( port_res, *data );
+        port_enable_trigger( port_res );
+    }
+    else
+    {
+        retval_int = port_peek( port_res, data );
+    }
 
-    //while( !rtos_irq_ready() );
+    return retval_int;
+}
 
-    for( ;; )
-    {
-        int event_id;
+static void wave_step_output(
+        gpio_wave_t *wave )
+{
+    uint32_t pins;
 
-        event_id = select_wait();
+    port_peek( wave->port_res, &pins );
+    port_out( wave->port_res, ( pins & ~wave->mask ) | ( wave->steps[ wave->step ].value & wave->mask ) );
+}
 
-        /* event_id 0-31 are ports, 32 is control channel rx */
-        do {
-            if( ( event_id >= 0 ) && ( event_id < GPIO_TOTAL_PORT_CNT ) )
-            {
-                mask = ( 0x1 << event_id );
-                port_disable_trigger( get_port(event_id) );
-                port_irq_flags |= mask;
-                if ( irq_c != 0 )
-                {
-                    soc_peripheral_irq_send( irq_c, mask );
-                }
-                else if ( peripheral != NULL )
-                {
-                    soc_peripheral_irq_direct_send( peripheral, mask );
-                }
-            }
-            else if( event_id == GPIO_TOTAL_PORT_CNT )
-            {
-                soc_peripheral_function_code_rx(ctrl_c, &cmd);
+/*
+ * Outputs every waveform step that is due, and sets the timer for the
+ * next one. A waveform that has run all of its passes is left at the
+ * value of its last step.
+ */
+static void wave_service( void )
+{
+    uint32_t now;
+    uint32_t next = 0;
+    int pending = 0;
 
-                switch( cmd )
-                {
-                case GPIO_DEV_PORT_ALLOC:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
+    hwtimer_get_time( wave_timer, &now );
 
-                    port_res = get_port( gpio_id );
-                    retval_int = port_alloc( &port_res, (port_id_t)port_res );
+    for( int i = 0; i < GPIOCONF_WAVE_COUNT; i++ )
+    {
+        gpio_wave_t *wave = &waves[ i ];
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 1,
-                            sizeof(retval_int), &retval_int);
+        while( wave->active && ( int32_t ) ( wave->next_time - now ) <= 0 )
+        {
+            if( ++wave->step == wave->step_count )
+            {
+                wave->step = 0;
+                if( wave->repeat > 0 && --wave->repeat == 0 )
+                {
+                    wave->active = 0;
                     break;
+                }
+            }
 
-                case GPIO_DEV_PORT_FREE:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
-
-                    port_res = get_port( gpio_id );
-                    retval_int = port_free( &port_res );
+            wave_step_output( wave );
+            wave->next_time += wave->steps[ wave->step ].ticks;
+        }
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 1,
-                            sizeof(retval_int), &retval_int);
-                    break;
+        if( wave->active && ( !pending || ( int32_t ) ( wave->next_time - next ) < 0 ) )
+        {
+            next = wave->next_time;
+            pending = 1;
+        }
+    }
 
-                case GPIO_DEV_PORT_IN:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
+    if( pending )
+    {
+        hwtimer_change_trigger_time( wave_timer, next );
+        hwtimer_enable_trigger( wave_timer );
+    }
+    else
+    {
+        hwtimer_disable_trigger( wave_timer );
+    }
+}
 
-                    port_res = get_port( gpio_id );
-                    mask = ( 0x1 << gpio_id );
+/*
+ * Starts a waveform whose steps have already been received. Its first
+ * step is output straight away.
+ */
+static int wave_start(
+        gpio_wave_t *wave,
+        gpio_id_t gpio_id )
+{
+    uint32_t now;
 
-                    if( ( port_irq_flags & mask ) != 0 )
-                    {
-                        port_irq_flags &= ~mask;
-                        retval_int = port_in( port_res, &data );
-                        port_set_trigger_in_not_equal( port_res, data );
-                        port_enable_trigger( port_res );
-                    }
-                    else
-                    {
-                        retval_int = port_peek( port_res, &data );
-                    }
+    if( !wave_timer_allocated )
+    {
+        if( hwtimer_alloc( &wave_timer ) != 0 )
+        {
+            return -1;
+        }
+        hwtimer_get_time( wave_timer, &now );
+        hwtimer_setup_select( wave_timer, now, GPIO_WAVE_EVENT_ID );
+        wave_timer_allocated = 1;
+    }
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 2,
-                            sizeof(data), &data,
-                            sizeof(retval_int), &retval_int);
-                    break;
+    for( int i = 0; i < wave->step_count; i++ )
+    {
+        xassert( wave->steps[ i ].ticks > 0 );
+    }
 
-                case GPIO_DEV_PORT_OUT:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 2,
-                            sizeof(gpio_id), &gpio_id,
-                            sizeof(data), &data);
+    hwtimer_get_time( wave_timer, &now );
 
-                    port_res = get_port( gpio_id );
+    wave->port_res = get_port( gpio_id );
+    wave->step = 0;
+    wave->next_time = now + wave->steps[ 0 ].ticks;
+    wave_step_output( wave );
+    wave->active = 1;
 
-                    retval_int = port_out( port_res, data );
+    wave_service();
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 1,
-                            sizeof(retval_int), &retval_int);
-                    break;
+    return 0;
+}
 
-                case GPIO_DEV_PORT_PEEK:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
+/* Sends the events batched up so far to the DMA RX ring */
+static void event_batch_flush(
+        soc_peripheral_t peripheral,
+        chanend data_to_dma_c )
+{
+    if( event_count > 0 )
+    {
+        if ( data_to_dma_c != 0 )
+        {
+            soc_peripheral_tx_dma_xfer( data_to_dma_c, event_batch, event_count * sizeof( gpio_event_t ) );
+        }
+        else if ( peripheral != NULL )
+        {
+            soc_peripheral_tx_dma_direct_xfer( peripheral, event_batch, event_count * sizeof( gpio_event_t ) );
+        }
+        event_count = 0;
+    }
+}
 
-                    port_res = get_port( gpio_id );
+/*
+ * Reads a port that has events enabled and batches up the change. The
+ * trigger is rearmed with the new value straight away, so no change
+ * is missed while the driver gets to the event.
+ */
+static void event_batch_add(
+        soc_peripheral_t peripheral,
+        chanend data_to_dma_c,
+        gpio_id_t gpio_id )
+{
+    port port_res = get_port( gpio_id );
+    gpio_event_t *event = &event_batch[ event_count ];
+    uint32_t data;
 
-                    retval_int = port_peek( port_res, &data );
+    port_in( port_res, &data );
+    port_set_trigger_in_not_equal( port_res, data );
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 2,
-                            sizeof(data), &data,
-                            sizeof(retval_int), &retval_int);
-                    break;
+    event->gpio_id = gpio_id;
+    event->value = data;
+    event->timestamp = get_reference_time();
 
-                case GPIO_DEV_PORT_IRQ_SETUP:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
+    if( ++event_count == GPIOCONF_EVENT_BATCH_MAX )
+    {
+        event_batch_flush( peripheral, data_to_dma_c );
+    }
+}
 
-                    port_res = get_port( gpio_id );
+/*
+ * Carries out the control command cmd, whose code has already been
+ * received over ctrl_c. Commands that need port or timer events fail
+ * with -1 unless events_allowed is set.
+ */
+void gpio_dev_control(
+        soc_peripheral_t peripheral,
+        chanend data_to_dma_c,
+        chanend ctrl_c,
+        uint8_t cmd,
+        int events_allowed )
+{
+    gpio_id_t gpio_id;
+    int retval_int;
+    port port_res;
+    uint32_t data;
+    uint32_t mask;
+    uint32_t pins;
+    int count;
+    int wave_id;
+    int repeat;
+    gpio_id_t multi_ids[ GPIO_TOTAL_PORT_CNT ];
+    uint32_t multi_data[ GPIO_TOTAL_PORT_CNT ];
+
+    switch( cmd )
+    {
+    case GPIO_DEV_PORT_ALLOC:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+        retval_int = port_alloc( &port_res, (port_id_t)port_res );
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_FREE:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+        retval_int = port_free( &port_res );
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_IN:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        retval_int = gpio_port_in( gpio_id, &data );
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 2,
+                sizeof(data), &data,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_OUT:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 2,
+                sizeof(gpio_id), &gpio_id,
+                sizeof(data), &data);
+
+        port_res = get_port( gpio_id );
+
+        retval_int = port_out( port_res, data );
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_PEEK:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+
+        retval_int = port_peek( port_res, &data );
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 2,
+                sizeof(data), &data,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_IRQ_SETUP:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+
+        if( events_allowed )
+        {
+            retval_int = port_setup_select( port_res, gpio_id );
+        }
+        else
+        {
+            retval_int = -1;
+        }
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_IRQ_ENABLE:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+
+        if( events_allowed )
+        {
+            port_peek( port_res, &data );
+            port_set_trigger_in_not_equal( port_res, data );
+            retval_int = port_enable_trigger( port_res );
+        }
+        else
+        {
+            retval_int = -1;
+        }
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_IRQ_DISABLE:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+
+        port_event_flags &= ~( 0x1 << gpio_id );
+        retval_int = port_disable_trigger( port_res );
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_EVENT_ENABLE:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(gpio_id), &gpio_id);
+
+        port_res = get_port( gpio_id );
+
+        if ( events_allowed && ( data_to_dma_c != 0 || peripheral != NULL ) )
+        {
+            port_event_flags |= ( 0x1 << gpio_id );
+            retval_int = port_setup_select( port_res, gpio_id );
+            port_peek( port_res, &data );
+            port_set_trigger_in_not_equal( port_res, data );
+            if ( retval_int == 0 )
+            {
+                retval_int = port_enable_trigger( port_res );
+            }
+        }
+        else
+        {
+            /* There is no way to get or send events */
+            retval_int = -1;
+        }
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_OUT_MULTI:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(count), &count);
+
+        xassert( count > 0 && count <= GPIO_TOTAL_PORT_CNT );
+
+        soc_peripheral_control_args_rx(
+                ctrl_c, 2,
+                count * sizeof(gpio_id_t), multi_ids,
+                count * sizeof(uint32_t), multi_data);
+
+        retval_int = 0;
+        for( int i = 0; i < count; i++ )
+        {
+            int ret = port_out( get_port( multi_ids[ i ] ), multi_data[ i ] );
+            if( retval_int == 0 )
+            {
+                retval_int = ret;
+            }
+        }
 
-                    retval_int = port_setup_select( port_res, gpio_id );
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 1,
-                            sizeof(retval_int), &retval_int);
-                    break;
+    case GPIO_DEV_PORT_IN_MULTI:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(count), &count);
 
-                case GPIO_DEV_PORT_IRQ_ENABLE:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
+        xassert( count > 0 && count <= GPIO_TOTAL_PORT_CNT );
 
-                    port_res = get_port( gpio_id );
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                count * sizeof(gpio_id_t), multi_ids);
 
-                    port_peek( port_res, &data );
-                    port_set_trigger_in_not_equal( port_res, data );
-                    retval_int = port_enable_trigger( port_res );
+        retval_int = 0;
+        for( int i = 0; i < count; i++ )
+        {
+            int ret = gpio_port_in( multi_ids[ i ], &multi_data[ i ] );
+            if( retval_int == 0 )
+            {
+                retval_int = ret;
+            }
+        }
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 2,
+                count * sizeof(uint32_t), multi_data,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_PORT_PINS_SET:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 3,
+                sizeof(gpio_id), &gpio_id,
+                sizeof(data), &data,
+                sizeof(mask), &mask);
+
+        port_res = get_port( gpio_id );
+
+        /* data is the pins to set and mask the pins to clear */
+        retval_int = port_peek( port_res, &pins );
+        if( retval_int == 0 )
+        {
+            retval_int = port_out( port_res, ( pins & ~mask ) | data );
+        }
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_WAVE_START:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 5,
+                sizeof(wave_id), &wave_id,
+                sizeof(gpio_id), &gpio_id,
+                sizeof(mask), &mask,
+                sizeof(repeat), &repeat,
+                sizeof(count), &count);
+
+        xassert( wave_id >= 0 && wave_id < GPIOCONF_WAVE_COUNT );
+        xassert( count > 0 && count <= GPIOCONF_WAVE_STEPS_MAX );
+
+        waves[ wave_id ].active = 0;
+        waves[ wave_id ].mask = mask;
+        waves[ wave_id ].repeat = repeat;
+        waves[ wave_id ].step_count = count;
+
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                count * sizeof(gpio_wave_step_t), waves[ wave_id ].steps);
+
+        if( events_allowed )
+        {
+            retval_int = wave_start( &waves[ wave_id ], gpio_id );
+        }
+        else
+        {
+            retval_int = -1;
+        }
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    case GPIO_DEV_WAVE_STOP:
+        soc_peripheral_control_args_rx(
+                ctrl_c, 1,
+                sizeof(wave_id), &wave_id);
+
+        xassert( wave_id >= 0 && wave_id < GPIOCONF_WAVE_COUNT );
+
+        waves[ wave_id ].active = 0;
+        if( wave_timer_allocated )
+        {
+            wave_service();
+        }
+        retval_int = 0;
+
+        soc_peripheral_control_results_tx(
+                ctrl_c, 1,
+                sizeof(retval_int), &retval_int);
+        break;
+
+    default:
+        fail( "Invalid CMD" );
+        break;
+    }
+}
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 1,
-                            sizeof(retval_int), &retval_int);
-                    break;
+void gpio_dev(
+        soc_peripheral_t peripheral,
+        chanend data_to_dma_c,
+        chanend data_from_dma_c,
+        chanend ctrl_c,
+        chanend irq_c)
+{
+    uint8_t cmd;
+    uint32_t mask;
 
-                case GPIO_DEV_PORT_IRQ_DISABLE:
-                    soc_peripheral_varlist_rx(
-                            ctrl_c, 1,
-                            sizeof(gpio_id), &gpio_id);
+    select_disable_trigger_all();
+    chanend_setup_select( ctrl_c, GPIO_CTRL_EVENT_ID );
+    chanend_enable_trigger( ctrl_c );
 
-                    port_res = get_port( gpio_id );
+    //while( !rtos_irq_ready() );
 
-                    retval_int = port_disable_trigger( port_res );
+    for( ;; )
+    {
+        int event_id;
 
-                    soc_peripheral_varlist_tx(
-                            ctrl_c, 1,
-                            sizeof(retval_int), &retval_int);
-                    break;
+        event_id = select_wait();
 
-                default:
-                    fail( "Invalid CMD" );
-                    break;
+        /* event_id 0-31 are ports, 32 is control channel rx, 33 is the waveform timer */
+        do {
+            if( ( event_id >= 0 ) && ( event_id < GPIO_TOTAL_PORT_CNT ) )
+            {
+                mask = ( 0x1 << event_id );
+                if( ( port_event_flags & mask ) != 0 )
+                {
+                    event_batch_add( peripheral, data_to_dma_c, event_id );
+                }
+                else
+                {
+                    port_disable_trigger( get_port(event_id) );
+                    port_irq_flags |= mask;
+                    if ( irq_c != 0 )
+                    {
+                        soc_peripheral_irq_send( irq_c, mask );
+                    }
+                    else if ( peripheral != NULL )
+                    {
+                        soc_peripheral_irq_direct_send( peripheral, mask );
+                    }
                 }
             }
+            else if( event_id == GPIO_WAVE_EVENT_ID )
+            {
+                wave_service();
+            }
+            else if( event_id == GPIO_CTRL_EVENT_ID )
+            {
+                soc_peripheral_control_code_rx(ctrl_c, &cmd);
+                gpio_dev_control( peripheral, data_to_dma_c, ctrl_c, cmd, 1 );
+            }
 
             event_id = select_no_wait( -1 );
         } while( event_id != -1 );
+
+        /* Nothing else is pending, so send the events seen together */
+        event_batch_flush( peripheral, data_to_dma_c );
     }
 }
 
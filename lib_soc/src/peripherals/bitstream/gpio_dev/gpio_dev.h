@@ -24,8 +24,32 @@ void gpio_dev(
         chanend ctrl_c,
         chanend irq_c);
 
+/*
+ * Carries out a single control command for gpio_dev() or
+ * gpio_dev_combinable(), once its code has been received.
+ */
+void gpio_dev_control(
+        soc_peripheral_t peripheral,
+        NULLABLE_RESOURCE(chanend, data_to_dma_c),
+        chanend ctrl_c,
+        uint8_t cmd,
+        int events_allowed);
+
 #ifdef __XC__
 }
 #endif //__XC__
 
+#ifdef __XC__
+/*
+ * A control only GPIO device that may be combined onto one logical
+ * core with other combinable device loops, such as i2c_dev(). Ports
+ * may be read and written, and their pins set, but port IRQs, port
+ * events and waveforms need the event vectors that gpio_dev() sets up
+ * for itself, so the commands that start them fail with -1.
+ */
+[[combinable]]
+void gpio_dev_combinable(
+        chanend ctrl_c);
+#endif //__XC__
+
 #endif /* GPIO_DEV_H_ */
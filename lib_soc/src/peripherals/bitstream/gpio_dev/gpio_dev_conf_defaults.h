@@ -3,5 +3,25 @@
 #ifndef GPIO_DEV_CONF_DEFAULTS_H_
 #define GPIO_DEV_CONF_DEFAULTS_H_
 
+/*
+ * The most port events that are sent to the DMA RX ring in one
+ * buffer. Events that happen together are sent together, up to this
+ * many, and the driver's RX buffers are this many events long.
+ */
+#ifndef GPIOCONF_EVENT_BATCH_MAX
+#define GPIOCONF_EVENT_BATCH_MAX    (8)
+#endif
+
+/*
+ * The number of waveforms that may be output at once, and the most
+ * steps each may have.
+ */
+#ifndef GPIOCONF_WAVE_COUNT
+#define GPIOCONF_WAVE_COUNT         (4)
+#endif
+
+#ifndef GPIOCONF_WAVE_STEPS_MAX
+#define GPIOCONF_WAVE_STEPS_MAX     (8)
+#endif
 
 #endif /* GPIO_DEV_CONF_DEFAULTS_H_ */
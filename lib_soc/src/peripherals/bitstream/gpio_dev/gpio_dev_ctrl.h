@@ -11,5 +11,11 @@
 #define GPIO_DEV_PORT_IRQ_SETUP     0x06
 #define GPIO_DEV_PORT_IRQ_ENABLE    0x07
 #define GPIO_DEV_PORT_IRQ_DISABLE   0x08
+#define GPIO_DEV_PORT_EVENT_ENABLE  0x09
+#define GPIO_DEV_PORT_OUT_MULTI     0x0A
+#define GPIO_DEV_PORT_IN_MULTI      0x0B
+#define GPIO_DEV_PORT_PINS_SET      0x0C
+#define GPIO_DEV_WAVE_START         0x0D
+#define GPIO_DEV_WAVE_STOP          0x0E
 
 #endif /* GPIO_DEV_CTRL_H_ */
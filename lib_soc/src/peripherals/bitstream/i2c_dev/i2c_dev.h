@@ -14,9 +14,14 @@
 #include "i2c.h"
 #include "i2c_dev_ctrl.h"
 
+/*
+ * irq_c is only needed to support the asynchronous
+ * calls made with the I2C driver's submit functions.
+ */
 [[combinable]]
 void i2c_dev(
         chanend ctrl_c,
+        chanend ?irq_c,
         client i2c_master_if i2c);
 
 #endif /* I2C_DEV_H_ */
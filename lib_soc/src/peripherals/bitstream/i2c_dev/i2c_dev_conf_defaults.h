@@ -7,4 +7,9 @@
 #define I2CCONF_MAX_BUF_LEN     (128)
 #endif
 
+/* The most operations in one batch */
+#ifndef I2CCONF_MAX_BATCH_LEN
+#define I2CCONF_MAX_BATCH_LEN   (32)
+#endif
+
 #endif /* I2C_DEV_CONF_DEFAULTS_H_ */
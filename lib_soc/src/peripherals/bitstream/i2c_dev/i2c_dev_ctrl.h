@@ -3,9 +3,37 @@
 #ifndef I2C_DEV_CTRL_H_
 #define I2C_DEV_CTRL_H_
 
+#include <stdint.h>
+
 #define I2C_DEV_WRITE      0x01
 #define I2C_DEV_READ       0x02
 #define I2C_DEV_WRITE_REG  0x03
 #define I2C_DEV_READ_REG   0x04
+#define I2C_DEV_BATCH      0x05
+
+/*
+ * One operation of a batch run by I2C_DEV_BATCH. A register write
+ * writes data to reg, a register read reads reg into data, and a delay
+ * waits for delay_us microseconds. result is set to the operation's
+ * i2c_regop_res_t, which is always I2C_REGOP_SUCCESS for a delay.
+ */
+#define I2C_OP_WRITE_REG   0x00
+#define I2C_OP_READ_REG    0x01
+#define I2C_OP_DELAY       0x02
+
+typedef struct {
+    uint8_t type;
+    uint8_t device_addr;
+    uint8_t reg;
+    uint8_t data;
+    uint16_t delay_us;
+    uint8_t result;
+    uint8_t reserved;
+} i2c_op_t;
+
+/* Initializers for each type of operation */
+#define I2C_OP_WRITE(device_addr, reg, data) { I2C_OP_WRITE_REG, (device_addr), (reg), (data), 0, 0, 0 }
+#define I2C_OP_READ(device_addr, reg)        { I2C_OP_READ_REG, (device_addr), (reg), 0, 0, 0, 0 }
+#define I2C_OP_WAIT(us)                      { I2C_OP_DELAY, 0, 0, 0, (us), 0, 0 }
 
 #endif /* I2C_DEV_CTRL_H_ */
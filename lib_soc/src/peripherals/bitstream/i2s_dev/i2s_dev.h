@@ -11,6 +11,18 @@
 
 #include "i2s_dev_conf_defaults.h"
 
+#if( I2SCONF_OFF_TILE && ( I2SCONF_FRAME_BUF_CNT & ( I2SCONF_FRAME_BUF_CNT - 1 ) ) != 0 )
+#error I2SCONF_FRAME_BUF_CNT must be a power of two
+#endif
+
+#if( I2SCONF_OFF_TILE && I2SCONF_RX_CHANNELS > 0 && ( I2SCONF_RX_FRAME_BUF_CNT & ( I2SCONF_RX_FRAME_BUF_CNT - 1 ) ) != 0 )
+#error I2SCONF_RX_FRAME_BUF_CNT must be a power of two
+#endif
+
+#if( I2SCONF_OFF_TILE && ( I2SCONF_READY_LEVEL < 1 || I2SCONF_READY_LEVEL > I2SCONF_FRAME_BUF_CNT - 1 ) )
+#error I2SCONF_READY_LEVEL must be between 1 and I2SCONF_FRAME_BUF_CNT - 1
+#endif
+
 void i2s_dev(
         soc_peripheral_t peripheral,
         chanend ?data_to_dma_c,
@@ -21,6 +33,57 @@ void i2s_dev(
         out port p_bclk,
         out buffered port:32 (&?p_dout)[num_out],
         static const size_t num_out,
+        in buffered port:32 (&?p_din)[num_in],
+        static const size_t num_in,
         clock bclk);
 
+/*
+ * The same as i2s_dev(), but sends each data line in TDM, with
+ * I2SCONF_TDM_CHANNELS_PER_LINE channels per line, so that
+ * num_out * I2SCONF_TDM_CHANNELS_PER_LINE channels are sent. bclk is
+ * clocked directly from p_mclk, which must therefore run at the TDM
+ * bit clock rate, I2SCONF_SAMPLE_FREQ * 32 * I2SCONF_TDM_CHANNELS_PER_LINE.
+ * Input lines are received in TDM the same way.
+ */
+void i2s_dev_tdm(
+        soc_peripheral_t peripheral,
+        chanend ?data_to_dma_c,
+        chanend ?data_from_dma_c,
+        chanend ?ctrl_c,
+        in port p_mclk,
+        out buffered port:32 p_fsync,
+        out buffered port:32 (&?p_dout)[num_out],
+        static const size_t num_out,
+        in buffered port:32 (&?p_din)[num_in],
+        static const size_t num_in,
+        clock bclk);
+
+/*
+ * Moves frames between the DMA engine and the device when
+ * I2SCONF_OFF_TILE is set. i2s_dev() and i2s_dev_tdm() run it
+ * themselves unless I2SCONF_DECOUPLER_COMBINED is set, in which case it
+ * must be run on the same tile, for example in a [[combine]] par with
+ * other off-tile devices' loops, so that they share one logical core.
+ * c_from_dma and c_to_dma are the channels that would otherwise be
+ * passed to i2s_dev() as data_from_dma_c and data_to_dma_c.
+ */
+#if I2SCONF_OFF_TILE
+[[combinable]]
+void i2s_dev_decoupler(
+        chanend c_from_dma,
+        chanend ?c_to_dma);
+#endif
+
+/*
+ * The number of times a frame was not ready in time, and the last
+ * frame or silence was sent in its place.
+ */
+unsigned i2s_dev_underrun_count(void);
+
+/*
+ * The number of captured frames that were dropped because there was
+ * nowhere to send them.
+ */
+unsigned i2s_dev_overrun_count(void);
+
 #endif /* I2S_DEV_H_ */
@@ -15,12 +15,116 @@
 #define I2SCONF_AUDIO_FRAME_LEN     (256)
 #endif
 
+/*
+ * The number of channels in each frame. Each frame holds
+ * I2SCONF_AUDIO_FRAME_LEN samples of every channel, interleaved, and
+ * output channel i gets channel i % I2SCONF_CHANNELS. The default of 1
+ * sends the same samples on every output channel.
+ */
+#ifndef I2SCONF_CHANNELS
+#define I2SCONF_CHANNELS            (1)
+#endif
+
+/*
+ * The layout of each data line's TDM frame when the device is run with
+ * i2s_dev_tdm(). Each frame is I2SCONF_TDM_CHANNELS_PER_LINE 32 bit
+ * slots, and frame sync is high for I2SCONF_TDM_SYNC_LEN bit clocks,
+ * I2SCONF_TDM_OFFSET bit clocks before the first slot.
+ */
+#ifndef I2SCONF_TDM_CHANNELS_PER_LINE
+#define I2SCONF_TDM_CHANNELS_PER_LINE   (8)
+#endif
+
+#ifndef I2SCONF_TDM_SYNC_LEN
+#define I2SCONF_TDM_SYNC_LEN        (1)
+#endif
+
+#ifndef I2SCONF_TDM_OFFSET
+#define I2SCONF_TDM_OFFSET          (0)
+#endif
+
+/*
+ * The number of channels captured from the data input lines. 0 leaves
+ * the receive path out. Channel i gets input channel i, and any input
+ * channels beyond the last are dropped.
+ */
+#ifndef I2SCONF_RX_CHANNELS
+#define I2SCONF_RX_CHANNELS         (0)
+#endif
+
+/*
+ * The number of samples of each channel in each captured frame. Each
+ * is sent to the DMA RX ring as one buffer, with its channels
+ * interleaved, just as the frames sent to the device are.
+ */
+#ifndef I2SCONF_RX_FRAME_LEN
+#define I2SCONF_RX_FRAME_LEN        (I2SCONF_AUDIO_FRAME_LEN)
+#endif
+
+/*
+ * With I2SCONF_OFF_TILE, the number of captured frames that may be
+ * waiting to be sent across to the DMA engine. When they are all
+ * waiting, the frame being captured is dropped.
+ */
+#ifndef I2SCONF_RX_FRAME_BUF_CNT
+#define I2SCONF_RX_FRAME_BUF_CNT    (4)
+#endif
+
 #ifndef I2SCONF_FRAME_BUF_CNT
 #define I2SCONF_FRAME_BUF_CNT       (4)
 #endif
 
+/*
+ * The frames sent to the device hold packed 16 bit samples if 1,
+ * otherwise 32 bit samples. 16 bit samples are sent to the DAC as
+ * the top half of each 32 bit sample, and captured samples are the
+ * top half of each 32 bit sample received.
+ */
+#ifndef I2SCONF_WORD_LENGTH_SHORT
+#define I2SCONF_WORD_LENGTH_SHORT   (0)
+#endif
+
 #ifndef I2SCONF_OFF_TILE
 #define I2SCONF_OFF_TILE            (1)
 #endif
 
+/*
+ * What to send when the next frame is not ready in time. If 1 the last
+ * frame is sent again, otherwise a frame of silence is sent.
+ */
+#ifndef I2SCONF_UNDERRUN_REPEAT
+#define I2SCONF_UNDERRUN_REPEAT     (0)
+#endif
+
+/*
+ * With I2SCONF_OFF_TILE, the number of frames that must be buffered
+ * before they start to be sent, both at startup and after an underrun.
+ * Each underrun raises it by one, up to I2SCONF_FRAME_BUF_CNT - 1, so
+ * that a bursty source gets more buffering only once it needs it.
+ */
+#ifndef I2SCONF_READY_LEVEL
+#define I2SCONF_READY_LEVEL         (I2SCONF_FRAME_BUF_CNT - 1)
+#endif
+
+/*
+ * With I2SCONF_OFF_TILE, whether i2s_dev() and i2s_dev_tdm() leave the
+ * decoupler out. If 1 the application must run i2s_dev_decoupler()
+ * itself, on the same tile, so that it may be combined onto one
+ * logical core with other combinable tasks, such as other devices'
+ * control loops.
+ */
+#ifndef I2SCONF_DECOUPLER_COMBINED
+#define I2SCONF_DECOUPLER_COMBINED  (0)
+#endif
+
+/*
+ * With I2SCONF_OFF_TILE, how often in reference clock ticks the
+ * decoupler checks for captured frames to send, and for a free buffer
+ * to take the next frame into. The default is a quarter of a frame.
+ */
+#ifndef I2SCONF_DECOUPLER_POLL_TICKS
+#define I2SCONF_DECOUPLER_POLL_TICKS \
+        ((uint32_t) ((uint64_t) I2SCONF_AUDIO_FRAME_LEN * 100000000 / I2SCONF_SAMPLE_FREQ / 4))
+#endif
+
 #endif /* I2S_DEV_CONF_DEFAULTS_H_ */
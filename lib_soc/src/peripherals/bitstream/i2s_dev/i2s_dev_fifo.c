@@ -0,0 +1,50 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <stddef.h>
+
+#include "soc.h"
+
+#include "i2s_dev_conf_defaults.h"
+#include "i2s_dev_fifo.h"
+
+#if I2SCONF_OFF_TILE
+static uint8_t tx_fifo_buf[I2SCONF_FRAME_BUF_CNT * sizeof(int)];
+static struct soc_fifo tx_fifo = {
+    tx_fifo_buf,
+    I2SCONF_FRAME_BUF_CNT - 1,
+    sizeof(int),
+    I2SCONF_READY_LEVEL,
+    0,
+    0,
+    0};
+
+#if I2SCONF_RX_CHANNELS > 0
+static uint8_t rx_fifo_buf[I2SCONF_RX_FRAME_BUF_CNT * sizeof(int)];
+static struct soc_fifo rx_fifo = {
+    rx_fifo_buf,
+    I2SCONF_RX_FRAME_BUF_CNT - 1,
+    sizeof(int),
+    1,
+    0,
+    0,
+    0};
+#endif
+#endif
+
+soc_fifo_t i2s_dev_tx_fifo(void)
+{
+#if I2SCONF_OFF_TILE
+    return &tx_fifo;
+#else
+    return NULL;
+#endif
+}
+
+soc_fifo_t i2s_dev_rx_fifo(void)
+{
+#if I2SCONF_OFF_TILE && I2SCONF_RX_CHANNELS > 0
+    return &rx_fifo;
+#else
+    return NULL;
+#endif
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef I2S_DEV_FIFO_H_
+#define I2S_DEV_FIFO_H_
+
+#include "soc_fifo.h"
+
+#ifdef __XC__
+extern "C" {
+#endif //__XC__
+
+/*
+ * The FIFOs between the I2S handler and the decoupler when
+ * I2SCONF_OFF_TILE is set. They are kept here, rather than on the
+ * stack of i2s_dev(), so that the decoupler may run outside of it,
+ * combined with other tasks, when I2SCONF_DECOUPLER_COMBINED is set.
+ *
+ * The TX FIFO holds the numbers of the frames received from the DMA
+ * engine, waiting to be sent. The RX FIFO holds the numbers of the
+ * captured frames waiting to be sent to the DMA engine. Both return
+ * NULL when I2SCONF_OFF_TILE is not set, and the RX FIFO also when
+ * I2SCONF_RX_CHANNELS is 0.
+ */
+soc_fifo_t i2s_dev_tx_fifo(void);
+soc_fifo_t i2s_dev_rx_fifo(void);
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* I2S_DEV_FIFO_H_ */
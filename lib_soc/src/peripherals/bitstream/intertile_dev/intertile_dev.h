@@ -0,0 +1,39 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef INTERTILE_DEV_H_
+#define INTERTILE_DEV_H_
+
+#if __soc_conf_h_exists__
+#include "soc_conf.h"
+#else
+#warning soc_conf.h not found
+#endif
+
+#include "intertile_dev_conf_defaults.h"
+
+/*
+ * Carries DMA transfers from one peripheral hub to another, normally
+ * the hubs of RTOS instances on two different tiles.
+ *
+ * Each RTOS registers its end of the link as a peripheral with its own
+ * hub. data_from_dma_c is the device side of the SOC_PERIPHERAL_FROM_DMA_CH
+ * channel registered for the sending end, and data_to_dma_c is the device
+ * side of the SOC_PERIPHERAL_TO_DMA_CH channel registered for the receiving
+ * end. Either may be a channel established to the other tile with
+ * soc_channel_establish(). Every buffer sent from the sending
+ * end's TX ring arrives in the receiving end's RX ring, and both ends
+ * get their usual DMA done interrupts.
+ *
+ * Up to INTERTILECONF_PIPELINE_DEPTH transfers are in flight at once,
+ * so that the next one is taken from the sending hub while the last is
+ * still crossing the switch. A receiver with no free RX buffers holds
+ * up the sender once the pipeline is full.
+ *
+ * Two instances, one for each direction, make a two way link. Each
+ * uses two logical cores.
+ */
+void intertile_dev(
+        chanend data_from_dma_c,
+        chanend data_to_dma_c);
+
+#endif /* INTERTILE_DEV_H_ */
@@ -0,0 +1,40 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef INTERTILE_DEV_CONF_DEFAULTS_H_
+#define INTERTILE_DEV_CONF_DEFAULTS_H_
+
+/* The largest DMA transfer that the intertile device can carry */
+#ifndef INTERTILECONF_MAX_BUF_LEN
+#define INTERTILECONF_MAX_BUF_LEN    (2048)
+#endif
+
+/*
+ * The number of transfers that may be held by the intertile device
+ * at once, between being taken from the sending tile's TX ring and
+ * being delivered to the receiving tile's RX ring.
+ */
+#ifndef INTERTILECONF_PIPELINE_DEPTH
+#define INTERTILECONF_PIPELINE_DEPTH (2)
+#endif
+
+/*
+ * The block size in bytes of the remote memory windows carried over an
+ * intertile link by intertile_mem. Reads and writes cross the link in
+ * blocks of no more than this, and each is cached as a whole block.
+ * It must be a power of two, and a block with its header must fit in
+ * INTERTILECONF_MAX_BUF_LEN.
+ */
+#ifndef INTERTILECONF_MEM_BLOCK_SIZE
+#define INTERTILECONF_MEM_BLOCK_SIZE (512)
+#endif
+
+/*
+ * The number of blocks that each end of an intertile_mem link holds
+ * buffers for. On the client this is the number of blocks cached and
+ * the number of reads and writes that may be in flight at once.
+ */
+#ifndef INTERTILECONF_MEM_SLOTS
+#define INTERTILECONF_MEM_SLOTS      (4)
+#endif
+
+#endif /* INTERTILE_DEV_CONF_DEFAULTS_H_ */
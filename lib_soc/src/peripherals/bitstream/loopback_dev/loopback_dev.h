@@ -0,0 +1,30 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef LOOPBACK_DEV_H_
+#define LOOPBACK_DEV_H_
+
+#if __soc_conf_h_exists__
+#include "soc_conf.h"
+#else
+#warning soc_conf.h not found
+#endif
+
+#include "loopback_dev_conf_defaults.h"
+
+#include "loopback_dev_ctrl.h"
+
+/*
+ * A peripheral with no I/O that sends every buffer it receives from
+ * its TX DMA ring straight back to its RX DMA ring. It is used to
+ * measure the performance of the DMA framework itself.
+ *
+ * It starts in LOOPBACK_DEV_MODE_CHANNEL. LOOPBACK_DEV_MODE_DIRECT
+ * may only be selected when peripheral is not NULL.
+ */
+void loopback_dev(
+        soc_peripheral_t peripheral,
+        chanend ?data_to_dma_c,
+        chanend ?data_from_dma_c,
+        chanend ?ctrl_c);
+
+#endif /* LOOPBACK_DEV_H_ */
@@ -0,0 +1,11 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef LOOPBACK_DEV_CONF_DEFAULTS_H_
+#define LOOPBACK_DEV_CONF_DEFAULTS_H_
+
+/* The largest DMA transfer that the loopback device can send back */
+#ifndef LOOPBACKCONF_MAX_BUF_LEN
+#define LOOPBACKCONF_MAX_BUF_LEN    (4096)
+#endif
+
+#endif /* LOOPBACK_DEV_CONF_DEFAULTS_H_ */
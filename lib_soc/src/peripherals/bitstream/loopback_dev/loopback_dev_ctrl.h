@@ -0,0 +1,14 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef LOOPBACK_DEV_CTRL_H_
+#define LOOPBACK_DEV_CTRL_H_
+
+#define LOOPBACK_DEV_MODE_SET       0x01
+
+/* Transfers go over the DMA channels, through the peripheral hub */
+#define LOOPBACK_DEV_MODE_CHANNEL   0
+
+/* Transfers go straight to the DMA rings, for a device on the same tile */
+#define LOOPBACK_DEV_MODE_DIRECT    1
+
+#endif /* LOOPBACK_DEV_CTRL_H_ */
@@ -10,9 +10,27 @@
 #endif
 
 #include "micarray_dev_conf_defaults.h"
+#include "micarray_dev_ctrl.h"
+#include "micarray_dev_dma.h"
 
-#if( MICARRAYCONF_DECIMATOR_COUNT != 1 )
-#error Library currently does not support decimator counts other than 1
+#if( MICARRAYCONF_DECIMATOR_COUNT < 1 || MICARRAYCONF_DECIMATOR_COUNT > 4 )
+#error MICARRAYCONF_DECIMATOR_COUNT must be between 1 and 4
+#endif
+
+#if( MICARRAYCONF_DMA_CHANNEL_COUNT == 0 || ( MICARRAYCONF_DMA_CHANNEL_MASK >> MICARRAYCONF_NUM_MICS ) != 0 )
+#error MICARRAYCONF_DMA_CHANNEL_MASK must select at least one of the MICARRAYCONF_NUM_MICS mics
+#endif
+
+#if( MICARRAYCONF_NUM_MICS != 4 * MICARRAYCONF_DECIMATOR_COUNT )
+#error Each decimator handles 4 mics, so MICARRAYCONF_NUM_MICS must be 4 * MICARRAYCONF_DECIMATOR_COUNT
+#endif
+
+#if( MICARRAYCONF_MIN_SAMPLE_RATE > MICARRAYCONF_SAMPLE_RATE )
+#error MICARRAYCONF_MIN_SAMPLE_RATE must not be above MICARRAYCONF_SAMPLE_RATE
+#endif
+
+#if( MICARRAYCONF_FRAME_SIZE_LOG2 < 1 || MICARRAYCONF_FRAME_SIZE_LOG2 > MICARRAYCONF_MAX_FRAME_SIZE_LOG2 )
+#error MICARRAYCONF_FRAME_SIZE_LOG2 must be between 1 and MICARRAYCONF_MAX_FRAME_SIZE_LOG2
 #endif
 
 void micarray_dev_init(
@@ -21,12 +39,23 @@ void micarray_dev_init(
         out port p_pdm_clk,
         buffered in port:32 p_pdm_mics);
 
+/*
+ * If ctrl_c is not null, the frame size and sample rate may be
+ * changed at run time with micarray_driver_frame_size_set() and
+ * micarray_driver_sample_rate_set().
+ */
 [[combinable]]
 void micarray_dev_to_dma(
         soc_peripheral_t peripheral,
         chanend ?data_to_dma_c,
+        chanend ?ctrl_c,
         streaming chanend c_ds_output[]);
 
+/*
+ * A single 8-bit PDM port carries up to 8 mics, so up to two
+ * decimators. Each decimator runs on its own logical core.
+ */
+#if( MICARRAYCONF_DECIMATOR_COUNT <= 2 )
 void micarray_dev_task(
         in buffered port:32 p_pdm_mics,
         streaming chanend c_ds_output[]);
@@ -37,5 +66,32 @@ void micarray_dev(
         chanend ?data_from_dma_c,
         chanend ?ctrl_c,
         in buffered port:32 p_pdm_mics);
+#endif
+
+/*
+ * More than 8 mics need a second 8-bit PDM port, p_pdm_mics_b, which
+ * carries mics 8 and up. It is clocked by the same PDM clock.
+ */
+#if( MICARRAYCONF_DECIMATOR_COUNT > 2 )
+void micarray_dev_init_dual_port(
+        clock pdmclk,
+        in port p_mclk,
+        out port p_pdm_clk,
+        buffered in port:32 p_pdm_mics,
+        buffered in port:32 p_pdm_mics_b);
+
+void micarray_dev_task_dual_port(
+        in buffered port:32 p_pdm_mics,
+        in buffered port:32 p_pdm_mics_b,
+        streaming chanend c_ds_output[]);
+
+void micarray_dev_dual_port(
+        soc_peripheral_t peripheral,
+        chanend ?data_to_dma_c,
+        chanend ?data_from_dma_c,
+        chanend ?ctrl_c,
+        in buffered port:32 p_pdm_mics,
+        in buffered port:32 p_pdm_mics_b);
+#endif
 
 #endif /* MICARRAY_DEV_H_ */
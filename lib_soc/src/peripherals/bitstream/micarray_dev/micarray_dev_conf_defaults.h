@@ -8,11 +8,37 @@
 #define MICARRAYCONF_WORD_LENGTH_SHORT      (0)
 #endif
 
+/* The number of bytes in each sample */
+#if MICARRAYCONF_WORD_LENGTH_SHORT
+#define MICARRAYCONF_SAMPLE_SIZE            (2)
+#else
+#define MICARRAYCONF_SAMPLE_SIZE            (4)
+#endif
+
 /* Indicates size of frames coming from decimator */
 #ifndef MICARRAYCONF_MAX_FRAME_SIZE_LOG2
 #define MICARRAYCONF_MAX_FRAME_SIZE_LOG2    (8)
 #endif
 
+/*
+ * The size of the frames the decimators start with. This may be
+ * changed at run time with micarray_driver_frame_size_set(), up to
+ * MICARRAYCONF_MAX_FRAME_SIZE_LOG2. Smaller frames, down to 16 or 32
+ * samples, cut the latency at the cost of more frames per second.
+ */
+#ifndef MICARRAYCONF_FRAME_SIZE_LOG2
+#define MICARRAYCONF_FRAME_SIZE_LOG2        MICARRAYCONF_MAX_FRAME_SIZE_LOG2
+#endif
+
+/*
+ * If 1 the decimators start with overlapping frames, each of which
+ * repeats the last half of the one before it, so that a frame is sent
+ * every half frame.
+ */
+#ifndef MICARRAYCONF_FRAME_OVERLAP
+#define MICARRAYCONF_FRAME_OVERLAP          (0)
+#endif
+
 #ifndef MICARRAYCONF_NUM_MICS
 #define MICARRAYCONF_NUM_MICS               (4)
 #endif
@@ -25,6 +51,16 @@
 #define MICARRAYCONF_NUM_FRAME_BUFFERS      (2)
 #endif
 
+/*
+ * The number of reference clock ticks the decimators are given to fill
+ * with PDM samples after they are configured, before the first frame is
+ * taken from them. This runs in parallel with the rest of the boot, but
+ * also delays each change of the frame size or sample rate.
+ */
+#ifndef MICARRAYCONF_WARMUP_TICKS
+#define MICARRAYCONF_WARMUP_TICKS           (150000)
+#endif
+
 #ifndef MICARRAYCONF_PDM_INTEGRATION_FACTOR
 #define MICARRAYCONF_PDM_INTEGRATION_FACTOR (32)
 #endif
@@ -33,6 +69,15 @@
 #define MICARRAYCONF_SAMPLE_RATE            (48000)
 #endif
 
+/*
+ * The lowest sample rate that may be selected at run time with
+ * micarray_driver_sample_rate_set(). The decimators' FIR data memory
+ * is sized for it, so lower values cost more memory.
+ */
+#ifndef MICARRAYCONF_MIN_SAMPLE_RATE
+#define MICARRAYCONF_MIN_SAMPLE_RATE        MICARRAYCONF_SAMPLE_RATE
+#endif
+
 #ifndef MICARRAYCONF_MASTER_TO_PDM_CLOCK_DIVIDER
 #define MICARRAYCONF_MASTER_TO_PDM_CLOCK_DIVIDER    (8)
 #endif
@@ -41,4 +86,138 @@
 #define MICARRAYCONF_MASTER_CLOCK_FREQUENCY (24576000)
 #endif
 
+/*
+ * Send frames to the hub with soc_peripheral_tx_dma_stream_xfer() if 1.
+ * The device must then be registered with SOC_PERIPHERAL_TX_DMA_STREAMING.
+ */
+#ifndef MICARRAYCONF_DMA_STREAMING
+#define MICARRAYCONF_DMA_STREAMING          (0)
+#endif
+
+/*
+ * When 1, the device is registered with SOC_PERIPHERAL_TX_DMA_REMOTE,
+ * and the bitstream must run soc_peripheral_tx_dma_remote_receiver()
+ * for it on the hub's tile. This does not change the device itself.
+ */
+#ifndef MICARRAYCONF_DMA_REMOTE
+#define MICARRAYCONF_DMA_REMOTE             (0)
+#endif
+
+/*
+ * When 0 or more, the sender-side queue that frames are put into,
+ * rather than sent to the hub by the mic array thread itself. This is
+ * meant for when the hub is on another tile. The bitstream must then run
+ * soc_peripheral_tx_queue_sender() for the queue with the device's
+ * channel to the hub, and give micarray_dev() a null data_to_dma_c.
+ */
+#ifndef MICARRAYCONF_DMA_TX_QUEUE
+#define MICARRAYCONF_DMA_TX_QUEUE           (-1)
+#endif
+
+/*
+ * The mics whose samples are sent in each DMA frame, one bit per mic.
+ * The default sends only mic 0.
+ */
+#ifndef MICARRAYCONF_DMA_CHANNEL_MASK
+#define MICARRAYCONF_DMA_CHANNEL_MASK       (0x0001)
+#endif
+
+/*
+ * The layout of the samples in each DMA frame. If 0 the frame is
+ * planar, holding all of the first mic's samples, then all of the
+ * next's. Planar frames are sent straight from the decimator's frame
+ * buffer, with runs of adjacent mics as single buffers. If 1 the
+ * frame is interleaved, holding the first sample of every mic, then
+ * the second, which costs a copy.
+ */
+#ifndef MICARRAYCONF_DMA_INTERLEAVED
+#define MICARRAYCONF_DMA_INTERLEAVED        (0)
+#endif
+
+/*
+ * When 1, lib_mic_array prepares each frame for an FFT as it writes it.
+ * Samples are stored in bit reversed order, so that the FFT can skip its
+ * bit reversal, and windowed by a square root Hann window, which suits
+ * overlap-add resynthesis when MICARRAYCONF_FRAME_OVERLAP is also set.
+ * Each pair of mics is packed into one frame of complex samples, the
+ * even mic's in the real parts and the odd mic's in the imaginary
+ * parts, so that one complex FFT gives the spectra of both. These
+ * frames are sent to the DMA one whole selected pair after another, so
+ * MICARRAYCONF_DMA_CHANNEL_MASK must select whole pairs.
+ */
+#ifndef MICARRAYCONF_FFT_PREPROCESSED
+#define MICARRAYCONF_FFT_PREPROCESSED       (0)
+#endif
+
+/*
+ * When set to 1, every frame sent to the DMA is also sent to the host,
+ * as it is sent, over the xSCOPE probe MICARRAYCONF_CAPTURE_XSCOPE_PROBE.
+ * The probe must be in the application's config.xscope. The host script
+ * lib_soc/host/mic_capture.py records the frames to a file, which may
+ * then be replayed with MICARRAYCONF_REPLAY. The mic array thread waits
+ * for xSCOPE to take each frame, so the host must keep up with the frame
+ * rate.
+ */
+#ifndef MICARRAYCONF_CAPTURE_XSCOPE
+#define MICARRAYCONF_CAPTURE_XSCOPE         (0)
+#endif
+
+/* The xSCOPE probe that frames are captured over, generated from config.xscope */
+#ifndef MICARRAYCONF_CAPTURE_XSCOPE_PROBE
+#define MICARRAYCONF_CAPTURE_XSCOPE_PROBE   MIC_CAPTURE
+#endif
+
+/* The most bytes of a frame that are sent in each xSCOPE record */
+#ifndef MICARRAYCONF_CAPTURE_XSCOPE_CHUNK
+#define MICARRAYCONF_CAPTURE_XSCOPE_CHUNK   (256)
+#endif
+
+/*
+ * When set to 1, the frames that the application defines in
+ * micarray_dev_replay_frames[] are sent to the DMA in place of the mics',
+ * one after another and then from the first again. The decimators still
+ * run, and each replayed frame is sent when a frame from them would have
+ * been, so the frame rate and the load on the tile are the same as when
+ * the mics are live. This gives benchmarks of everything downstream the
+ * same input on every run.
+ */
+#ifndef MICARRAYCONF_REPLAY
+#define MICARRAYCONF_REPLAY                 (0)
+#endif
+
+#if MICARRAYCONF_FFT_PREPROCESSED
+#if MICARRAYCONF_WORD_LENGTH_SHORT || MICARRAYCONF_DMA_INTERLEAVED
+#error MICARRAYCONF_FFT_PREPROCESSED frames must be planar with 32 bit samples
+#endif
+#if ((MICARRAYCONF_DMA_CHANNEL_MASK ^ (MICARRAYCONF_DMA_CHANNEL_MASK >> 1)) & 0x5555) != 0
+#error MICARRAYCONF_DMA_CHANNEL_MASK must select whole pairs of mics with MICARRAYCONF_FFT_PREPROCESSED
+#endif
+#endif
+
+/* The number of mics sent in each DMA frame */
+#define MICARRAYCONF_DMA_CHANNEL_COUNT ( \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 0) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 1) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 2) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 3) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 4) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 5) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 6) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 7) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 8) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 9) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 10) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 11) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 12) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 13) & 1) + \
+        ((MICARRAYCONF_DMA_CHANNEL_MASK >> 14) & 1) + ((MICARRAYCONF_DMA_CHANNEL_MASK >> 15) & 1))
+
+/* The number of bytes in each DMA frame for frames of (1 << frame_size_log2) samples */
+#define MICARRAYCONF_DMA_FRAME_SIZE_FOR(frame_size_log2) \
+        (MICARRAYCONF_DMA_CHANNEL_COUNT * (1 << (frame_size_log2)) * MICARRAYCONF_SAMPLE_SIZE)
+
+/* The number of bytes in each DMA frame at the starting frame size */
+#define MICARRAYCONF_DMA_FRAME_SIZE \
+        MICARRAYCONF_DMA_FRAME_SIZE_FOR(MICARRAYCONF_FRAME_SIZE_LOG2)
+
+/*
+ * The number of bytes in the largest DMA frame. RX buffers of this
+ * size hold a frame of any size.
+ */
+#define MICARRAYCONF_DMA_FRAME_SIZE_MAX \
+        MICARRAYCONF_DMA_FRAME_SIZE_FOR(MICARRAYCONF_MAX_FRAME_SIZE_LOG2)
+
 #endif /* MICARRAY_DEV_CONF_DEFAULTS_H_ */
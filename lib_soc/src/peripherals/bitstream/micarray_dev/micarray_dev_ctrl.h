@@ -0,0 +1,9 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef MICARRAY_DEV_CTRL_H_
+#define MICARRAY_DEV_CTRL_H_
+
+#define MICARRAY_DEV_FRAME_SIZE_SET    0x01
+#define MICARRAY_DEV_SAMPLE_RATE_SET   0x02
+
+#endif /* MICARRAY_DEV_CTRL_H_ */
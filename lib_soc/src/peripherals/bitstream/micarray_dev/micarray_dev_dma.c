@@ -0,0 +1,183 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "soc.h"
+#include "xassert.h"
+
+#include "micarray_dev_conf_defaults.h"
+#include "micarray_dev_dma.h"
+
+#if MICARRAYCONF_CAPTURE_XSCOPE
+#include <xscope.h>
+#endif
+
+/* The number of samples between the start of each mic's samples in a frame */
+#define FRAME_STRIDE (1 << MICARRAYCONF_MAX_FRAME_SIZE_LOG2)
+
+#if MICARRAYCONF_WORD_LENGTH_SHORT
+typedef int16_t sample_t;
+#else
+typedef int32_t sample_t;
+#endif
+
+#if MICARRAYCONF_CAPTURE_XSCOPE
+/*
+ * Sends the buffers of a frame to the host, after a header that
+ * lets the host find the start of each frame and spot lost ones.
+ */
+static void frame_capture(
+        void * const bufs[],
+        const soc_dma_length_t lengths[],
+        int count)
+{
+    static uint32_t seq;
+    uint32_t header[3];
+    int i;
+
+    header[0] = MICARRAY_DEV_CAPTURE_MAGIC;
+    header[1] = seq++;
+    header[2] = 0;
+    for (i = 0; i < count; i++) {
+        header[2] += lengths[i];
+    }
+    xscope_bytes(MICARRAYCONF_CAPTURE_XSCOPE_PROBE, sizeof(header), (const unsigned char *) header);
+
+    for (i = 0; i < count; i++) {
+        const unsigned char *p = bufs[i];
+        int left = lengths[i];
+
+        while (left > 0) {
+            int chunk = left < MICARRAYCONF_CAPTURE_XSCOPE_CHUNK ? left : MICARRAYCONF_CAPTURE_XSCOPE_CHUNK;
+            xscope_bytes(MICARRAYCONF_CAPTURE_XSCOPE_PROBE, chunk, p);
+            p += chunk;
+            left -= chunk;
+        }
+    }
+}
+#endif
+
+#if MICARRAYCONF_REPLAY
+/*
+ * Sets up the next replay frame to be sent as a single buffer,
+ * and returns the buffer count.
+ */
+static int replay_gather(
+        void *bufs[],
+        soc_dma_length_t lengths[])
+{
+    static unsigned next;
+
+    xassert(micarray_dev_replay_frame_count > 0);
+
+    bufs[0] = (uint8_t *) micarray_dev_replay_frames + next * micarray_dev_replay_frame_size;
+    lengths[0] = micarray_dev_replay_frame_size;
+
+    if (++next == micarray_dev_replay_frame_count) {
+        next = 0;
+    }
+
+    return 1;
+}
+#else
+
+#if MICARRAYCONF_DMA_INTERLEAVED
+static sample_t interleaved_frame[MICARRAYCONF_DMA_CHANNEL_COUNT * FRAME_STRIDE];
+#endif
+
+/*
+ * Sets up the mics selected by MICARRAYCONF_DMA_CHANNEL_MASK from a
+ * decimated frame to be sent as a gather list, and returns the buffer
+ * count.
+ */
+static int frame_gather(
+        void *frame,
+        unsigned frame_size_log2,
+        void *bufs[],
+        soc_dma_length_t lengths[])
+{
+    sample_t *samples = frame;
+    const int frame_samples = 1 << frame_size_log2;
+    int count = 0;
+
+#if MICARRAYCONF_DMA_INTERLEAVED
+    sample_t *out = interleaved_frame;
+
+    for (int s = 0; s < frame_samples; s++) {
+        for (int mic = 0; mic < MICARRAYCONF_NUM_MICS; mic++) {
+            if (MICARRAYCONF_DMA_CHANNEL_MASK & (1 << mic)) {
+                *out++ = samples[mic * FRAME_STRIDE + s];
+            }
+        }
+    }
+
+    bufs[0] = interleaved_frame;
+    lengths[0] = MICARRAYCONF_DMA_CHANNEL_COUNT * frame_samples * sizeof(sample_t);
+    count = 1;
+#elif MICARRAYCONF_FFT_PREPROCESSED
+    /*
+     * Each pair of mics is frame_samples complex samples, which are
+     * contiguous, so each selected pair is sent as a single buffer.
+     */
+    for (int pair = 0; pair < MICARRAYCONF_NUM_MICS / 2; pair++) {
+        if (MICARRAYCONF_DMA_CHANNEL_MASK & (1 << (2 * pair))) {
+            bufs[count] = &samples[pair * 2 * FRAME_STRIDE];
+            lengths[count] = 2 * frame_samples * sizeof(sample_t);
+            count++;
+        }
+    }
+#else
+    /*
+     * When the frames are the largest size, each run of adjacent
+     * selected mics is already contiguous in the frame, so it is sent
+     * as a single buffer.
+     */
+    for (int mic = 0; mic < MICARRAYCONF_NUM_MICS; mic++) {
+        if (MICARRAYCONF_DMA_CHANNEL_MASK & (1 << mic)) {
+            if (frame_samples == FRAME_STRIDE && mic > 0 && (MICARRAYCONF_DMA_CHANNEL_MASK & (1 << (mic - 1)))) {
+                lengths[count - 1] += frame_samples * sizeof(sample_t);
+            } else {
+                bufs[count] = &samples[mic * FRAME_STRIDE];
+                lengths[count] = frame_samples * sizeof(sample_t);
+                count++;
+            }
+        }
+    }
+#endif
+
+    return count;
+}
+#endif
+
+void micarray_dev_frame_send(
+        chanend data_to_dma_c,
+        soc_peripheral_t peripheral,
+        void *frame,
+        unsigned frame_size_log2)
+{
+    void *bufs[MICARRAYCONF_DMA_CHANNEL_COUNT];
+    soc_dma_length_t lengths[MICARRAYCONF_DMA_CHANNEL_COUNT];
+    int count;
+
+#if MICARRAYCONF_REPLAY
+    count = replay_gather(bufs, lengths);
+#else
+    count = frame_gather(frame, frame_size_log2, bufs, lengths);
+#endif
+
+#if MICARRAYCONF_CAPTURE_XSCOPE
+    frame_capture(bufs, lengths, count);
+#endif
+
+#if MICARRAYCONF_DMA_TX_QUEUE >= 0
+    soc_peripheral_tx_queue_gather_put(MICARRAYCONF_DMA_TX_QUEUE, bufs, lengths, count);
+#else
+    if (data_to_dma_c != 0) {
+#if MICARRAYCONF_DMA_STREAMING
+        soc_peripheral_tx_dma_stream_gather_xfer(data_to_dma_c, bufs, lengths, count);
+#else
+        soc_peripheral_tx_dma_gather_xfer(data_to_dma_c, bufs, lengths, count);
+#endif
+    } else if (peripheral != NULL) {
+        soc_peripheral_tx_dma_direct_gather_xfer(peripheral, bufs, lengths, count);
+    }
+#endif
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef MICARRAY_DEV_DMA_H_
+#define MICARRAY_DEV_DMA_H_
+
+#include "soc.h"
+
+#ifdef __XC__
+extern "C" {
+#endif //__XC__
+
+/*
+ * Sends the mics selected by MICARRAYCONF_DMA_CHANNEL_MASK from a
+ * decimated frame to the DMA, as a single frame laid out as set by
+ * MICARRAYCONF_DMA_INTERLEAVED. frame points to the frame's samples,
+ * which are planar, with (1 << MICARRAYCONF_MAX_FRAME_SIZE_LOG2)
+ * samples set aside for each of the MICARRAYCONF_NUM_MICS mics, the
+ * first (1 << frame_size_log2) of which are sent.
+ *
+ * The frame goes into the sender-side queue MICARRAYCONF_DMA_TX_QUEUE
+ * if that is set. Otherwise it goes over data_to_dma_c if it is not
+ * null, and otherwise straight into the RX ring of peripheral.
+ *
+ * With MICARRAYCONF_REPLAY, the next replay frame is sent instead, and
+ * frame is not used. With MICARRAYCONF_CAPTURE_XSCOPE, whichever frame
+ * is sent is also captured.
+ */
+void micarray_dev_frame_send(
+        NULLABLE_RESOURCE(chanend, data_to_dma_c),
+        soc_peripheral_t peripheral,
+        void *frame,
+        unsigned frame_size_log2);
+
+/*
+ * The first word of the header that precedes each frame captured over
+ * xSCOPE. The second is the frame's sequence number, and the third its
+ * length in bytes. The frame follows in records of up to
+ * MICARRAYCONF_CAPTURE_XSCOPE_CHUNK bytes.
+ */
+#define MICARRAY_DEV_CAPTURE_MAGIC 0x4D434150
+
+#if MICARRAYCONF_REPLAY
+/*
+ * The frames sent with MICARRAYCONF_REPLAY, which the application must
+ * define, for example in a file generated from a capture by
+ * lib_soc/host/mic_capture.py. There are micarray_dev_replay_frame_count
+ * of them, each micarray_dev_replay_frame_size bytes, one after another.
+ * They are sent exactly as they are, so should have been captured with
+ * the same mics selected and the same frame size and layout.
+ */
+extern const uint32_t micarray_dev_replay_frames[];
+extern const unsigned micarray_dev_replay_frame_count;
+extern const unsigned micarray_dev_replay_frame_size;
+#endif
+
+#ifdef __XC__
+}
+#endif //__XC__
+
+#endif /* MICARRAY_DEV_DMA_H_ */
@@ -25,4 +25,20 @@ void sdram_dev(
         out port p_sdram_clk,
         clock sdram_cb_clk);
 
+/*
+ * The part of sdram_dev() that serves the driver, talking to an
+ * sdram_server() over c_sdram. It only waits in its select between
+ * requests, so an application that runs sdram_server() itself may
+ * combine this with other low rate device loops, such as i2c_dev(),
+ * rather than give it a logical core of its own. A long control
+ * channel transfer holds up the other tasks combined with it until
+ * it completes.
+ */
+[[combinable]]
+unsafe void sdram_dev_handler(
+        chanend ?data_to_dma_c,
+        chanend ?data_from_dma_c,
+        chanend ?ctrl_c,
+        streaming chanend c_sdram);
+
 #endif /* SDRAM_DEV_H_ */
@@ -7,6 +7,26 @@
 #define SDRAMCONF_READ_BUFFER_SIZE      256
 #define SDRAMCONF_WRITE_BUFFER_SIZE     256
 
+/*
+ * Reads and writes made over the control channel are split into
+ * chunks of this many words, so that the SDRAM may access one chunk
+ * while the previous one crosses the channel. The device holds two
+ * chunks at once.
+ */
+#ifndef SDRAMCONF_PIPELINE_WORDS
+#define SDRAMCONF_PIPELINE_WORDS        (SDRAMCONF_READ_BUFFER_SIZE / 2)
+#endif
+
+/* The most extents that may be given to a single scatter read */
+#ifndef SDRAMCONF_SCATTER_MAX_EXTENTS
+#define SDRAMCONF_SCATTER_MAX_EXTENTS   8
+#endif
+
+/* The largest read or write, in words, that may be requested over the DMA rings */
+#ifndef SDRAMCONF_DMA_MAX_WORDS
+#define SDRAMCONF_DMA_MAX_WORDS         256
+#endif
+
 /* Use the IS45S16160D 256Mb part or comparable */
 #define SDRAMCONF_USE_256MB             1
 
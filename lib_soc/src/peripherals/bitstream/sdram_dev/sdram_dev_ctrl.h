@@ -6,5 +6,18 @@
 #define SDRAM_DEV_SHUTDOWN              0x01
 #define SDRAM_DEV_WRITE                 0x02
 #define SDRAM_DEV_READ                  0x03
+#define SDRAM_DEV_READ_SCATTER          0x04
+
+/*
+ * Requests sent to the device over its TX DMA ring end with a header
+ * of SDRAM_DEV_DMA_HEADER_WORDS words. For a write the header follows
+ * the data to write, as the last buffer of the same frame. For a read
+ * the header is the whole frame, and the data read is sent back to the
+ * RX DMA ring. The command is SDRAM_DEV_WRITE or SDRAM_DEV_READ.
+ */
+#define SDRAM_DEV_DMA_HEADER_CMD        0
+#define SDRAM_DEV_DMA_HEADER_ADDRESS    1
+#define SDRAM_DEV_DMA_HEADER_WORD_COUNT 2
+#define SDRAM_DEV_DMA_HEADER_WORDS      3
 
 #endif /* SDRAM_DEV_CTRL_H_ */
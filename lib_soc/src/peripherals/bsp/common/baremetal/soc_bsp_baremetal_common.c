@@ -0,0 +1,157 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <stdlib.h>
+
+#include "soc.h"
+#include "soc_bsp_common.h"
+
+#include "xassert.h"
+
+#if !RTOS_FREERTOS
+
+/*
+ * The backend used when the DMA framework is used from plain threads,
+ * with no RTOS. Each logical core is a waiter. Its thread sleeps on a
+ * timer between polls of its notification count, so it takes no
+ * pipeline cycles from the other threads while it waits.
+ */
+
+#define WAIT_POLL_TICKS 100
+
+/* The number of logical cores on a tile */
+#define LOGICAL_CORE_COUNT 8
+
+typedef struct {
+    volatile int notified;
+    hwtimer_t tmr;
+} waiter_t;
+
+static waiter_t waiters[LOGICAL_CORE_COUNT];
+
+void *soc_bsp_mem_alloc(size_t size)
+{
+    /* malloc() returns double word aligned memory */
+    return malloc(size);
+}
+
+int soc_bsp_isr_core_valid(int isr_core)
+{
+    return isr_core >= 0 && isr_core < RTOS_MAX_CORE_COUNT;
+}
+
+soc_bsp_waiter_t soc_bsp_waiter_get(void)
+{
+    return &waiters[get_logical_core_id()];
+}
+
+int soc_bsp_wait(uint32_t timeout_ticks)
+{
+    waiter_t *waiter = &waiters[get_logical_core_id()];
+    uint32_t start = get_reference_time();
+
+    if (waiter->tmr == 0) {
+        hwtimer_alloc(&waiter->tmr);
+    }
+
+    for (;;) {
+        uint32_t mask;
+        int notified;
+
+        /*
+         * Interrupts are masked so that a notification from an ISR on
+         * this core cannot land between the check and the clear. Any
+         * that land together are taken as one.
+         */
+        mask = rtos_interrupt_mask_all();
+        notified = waiter->notified;
+        if (notified) {
+            waiter->notified = 0;
+        }
+        rtos_interrupt_mask_set(mask);
+
+        if (notified) {
+            return 1;
+        }
+        if (timeout_ticks != SOC_BSP_WAIT_FOREVER && get_reference_time() - start >= timeout_ticks) {
+            return 0;
+        }
+        hwtimer_delay(waiter->tmr, WAIT_POLL_TICKS);
+    }
+}
+
+int soc_bsp_notify_from_isr(soc_bsp_waiter_t waiter)
+{
+    ((waiter_t *) waiter)->notified = 1;
+
+    /* No scheduler to switch to anything */
+    return 0;
+}
+
+/*
+ * There are no priorities to inherit without an RTOS, so a mutex just
+ * has an owner, which waits between polls of it in the same way as
+ * soc_bsp_wait().
+ */
+typedef struct {
+    waiter_t *owner;
+    int count;
+} mutex_t;
+
+soc_bsp_mutex_t soc_bsp_mutex_create(void)
+{
+    mutex_t *mutex = soc_bsp_mem_alloc(sizeof(mutex_t));
+
+    xassert(mutex != NULL);
+    mutex->owner = NULL;
+    mutex->count = 0;
+
+    return mutex;
+}
+
+void soc_bsp_mutex_lock(soc_bsp_mutex_t mutex)
+{
+    mutex_t *m = mutex;
+    waiter_t *self = &waiters[get_logical_core_id()];
+
+    for (;;) {
+        uint32_t mask;
+        int acquired;
+
+        mask = rtos_interrupt_mask_all();
+        rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_CONTROL);
+        acquired = m->owner == NULL || m->owner == self;
+        if (acquired) {
+            m->owner = self;
+            m->count++;
+        }
+        rtos_lock_domain_release(RTOS_LOCK_DOMAIN_CONTROL);
+        rtos_interrupt_mask_set(mask);
+
+        if (acquired) {
+            return;
+        }
+
+        if (self->tmr == 0) {
+            hwtimer_alloc(&self->tmr);
+        }
+        hwtimer_delay(self->tmr, WAIT_POLL_TICKS);
+    }
+}
+
+void soc_bsp_mutex_unlock(soc_bsp_mutex_t mutex)
+{
+    mutex_t *m = mutex;
+    uint32_t mask;
+
+    xassert(m->owner == &waiters[get_logical_core_id()]);
+
+    mask = rtos_interrupt_mask_all();
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_CONTROL);
+    if (--m->count == 0) {
+        m->owner = NULL;
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_CONTROL);
+    rtos_interrupt_mask_set(mask);
+}
+
+#endif /* !RTOS_FREERTOS */
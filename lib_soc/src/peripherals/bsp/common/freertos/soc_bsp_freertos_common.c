@@ -1,53 +1,86 @@
 // Copyright (c) 2019, XMOS Ltd, All rights reserved
 
 #include "soc.h"
+#include "soc_bsp_common.h"
 
 #if RTOS_FREERTOS
 
 #include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
 
-void soc_peripheral_common_dma_init(
-        soc_peripheral_t device,
-        int rx_desc_count,
-        int rx_buf_size,
-        int tx_desc_count,
-        void *app_data,
-        int isr_core,
-        rtos_irq_isr_t isr)
+/* The number of reference clock ticks in each RTOS tick. The port clocks the RTOS from the reference clock. */
+#define REF_TICKS_PER_RTOS_TICK (configCPU_CLOCK_HZ / configTICK_RATE_HZ)
+
+void *soc_bsp_mem_alloc(size_t size)
 {
-    soc_dma_ring_buf_t *ring_buf;
-    uint32_t *buf_desc;
-    int i;
+    /* pvPortMalloc() returns double word aligned memory */
+    return pvPortMalloc(size);
+}
 
+int soc_bsp_isr_core_valid(int isr_core)
+{
 #ifdef taskVALID_CORE_ID
-    configASSERT(taskVALID_CORE_ID(isr_core));
+    return taskVALID_CORE_ID(isr_core);
+#else
+    return isr_core >= 0 && isr_core < RTOS_MAX_CORE_COUNT;
 #endif
+}
 
-    if (rx_desc_count > 0) {
-        buf_desc = pvPortMalloc(rx_desc_count * SOC_DMA_BUF_DESC_WORDSIZE * sizeof(uint32_t));
-        configASSERT(buf_desc != NULL);
+soc_bsp_waiter_t soc_bsp_waiter_get(void)
+{
+    return xTaskGetCurrentTaskHandle();
+}
 
-        ring_buf = soc_peripheral_rx_dma_ring_buf(device);
-        soc_dma_ring_buf_init(ring_buf, buf_desc, rx_desc_count);
+int soc_bsp_wait(uint32_t timeout_ticks)
+{
+    TickType_t rtos_ticks;
 
-        if (rx_buf_size > 0) {
-            for (i = 0; i < rx_desc_count; i++) {
-                void *buf = pvPortMalloc(rx_buf_size);
-                configASSERT(buf != NULL);
-                soc_dma_ring_rx_buf_set(ring_buf, buf, rx_buf_size);
-            }
-        }
+    if (timeout_ticks == SOC_BSP_WAIT_FOREVER) {
+        rtos_ticks = portMAX_DELAY;
+    } else {
+        rtos_ticks = (timeout_ticks + REF_TICKS_PER_RTOS_TICK - 1) / REF_TICKS_PER_RTOS_TICK;
     }
 
-    if (tx_desc_count > 0) {
-        buf_desc = pvPortMalloc(tx_desc_count * SOC_DMA_BUF_DESC_WORDSIZE * sizeof(uint32_t));
-        configASSERT(buf_desc != NULL);
-        ring_buf = soc_peripheral_tx_dma_ring_buf(device);
-        soc_dma_ring_buf_init(ring_buf, buf_desc, tx_desc_count);
+    return ulTaskNotifyTake(pdTRUE, rtos_ticks) != 0;
+}
+
+int soc_bsp_notify_from_isr(soc_bsp_waiter_t waiter)
+{
+    BaseType_t xYieldRequired = pdFALSE;
+
+    vTaskNotifyGiveFromISR(waiter, &xYieldRequired);
+
+    return xYieldRequired;
+}
+
+soc_bsp_mutex_t soc_bsp_mutex_create(void)
+{
+    SemaphoreHandle_t mutex;
+
+    /* FreeRTOS mutexes have priority inheritance */
+    mutex = xSemaphoreCreateRecursiveMutex();
+    configASSERT(mutex != NULL);
+
+    return mutex;
+}
+
+/*
+ * Before the scheduler is started there is only the one thread of
+ * execution, so nothing to lock against, and no task to hold the mutex.
+ */
+void soc_bsp_mutex_lock(soc_bsp_mutex_t mutex)
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
     }
+}
 
-    soc_peripheral_handler_register(device, isr_core, app_data, isr);
+void soc_bsp_mutex_unlock(soc_bsp_mutex_t mutex)
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        xSemaphoreGiveRecursive(mutex);
+    }
 }
 
 #endif /* RTOS_FREERTOS */
-
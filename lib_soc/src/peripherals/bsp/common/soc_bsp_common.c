@@ -0,0 +1,410 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "soc.h"
+#include "soc_bsp_common.h"
+
+#include "xassert.h"
+
+#if SOC_DMA_HEAP_SIZE > 0
+static uint8_t dma_heap[SOC_DMA_HEAP_SIZE] __attribute__((aligned(8))) SOC_DMA_HEAP_SECTION_ATTR;
+static size_t dma_heap_used;
+#endif
+
+/*
+ * Allocates double word aligned memory for the DMA, either from the
+ * DMA heap region or from the backend's allocator. It is never freed.
+ */
+static void *dma_mem_alloc(size_t size)
+{
+#if SOC_DMA_HEAP_SIZE > 0
+    void *mem = NULL;
+    uint32_t mask;
+
+    size = SOC_DMA_BUF_POOL_ALIGN(size);
+
+    mask = rtos_interrupt_mask_all();
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_BUF_POOL);
+    if (size <= SOC_DMA_HEAP_SIZE - dma_heap_used) {
+        mem = &dma_heap[dma_heap_used];
+        dma_heap_used += size;
+    }
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_BUF_POOL);
+    rtos_interrupt_mask_set(mask);
+
+    return mem;
+#else
+    return soc_bsp_mem_alloc(size);
+#endif
+}
+
+#if SOC_PERIPHERAL_DMA_INIT_DEFERRED
+/*
+ * The ring sizes of each device that has been initialized but
+ * not yet opened. Unused entries have a NULL device.
+ */
+static struct {
+    soc_peripheral_t device;
+    int rx_desc_count;
+    int rx_buf_size;
+    int tx_desc_count;
+} deferred_init[SOC_MAX_PERIPHERALS];
+#endif
+
+/*
+ * The control lock of each device that has one. Unused entries have a
+ * NULL device. The mutex is set before the device, so one that is found
+ * is always ready to use.
+ */
+static struct {
+    soc_peripheral_t device;
+    soc_bsp_mutex_t mutex;
+} ctrl_locks[SOC_MAX_PERIPHERALS];
+
+static soc_bsp_mutex_t ctrl_lock_find(
+        soc_peripheral_t device)
+{
+    int i;
+
+    for (i = 0; i < SOC_MAX_PERIPHERALS; i++) {
+        if (ctrl_locks[i].device == device) {
+            return ctrl_locks[i].mutex;
+        }
+    }
+
+    return NULL;
+}
+
+void soc_bsp_ctrl_lock_init(
+        soc_peripheral_t device)
+{
+    soc_bsp_mutex_t mutex;
+    uint32_t mask;
+    int i;
+
+    if (ctrl_lock_find(device) != NULL) {
+        return;
+    }
+
+    mutex = soc_bsp_mutex_create();
+
+    /*
+     * Other devices' drivers may be initialized at the same time, so
+     * an entry is claimed with the lock held. The mutex is created
+     * first, as that may not be done with interrupts masked.
+     */
+    mask = rtos_interrupt_mask_all();
+    rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_CONTROL);
+
+    for (i = 0; i < SOC_MAX_PERIPHERALS; i++) {
+        if (ctrl_locks[i].device == NULL) {
+            break;
+        }
+    }
+    xassert(i < SOC_MAX_PERIPHERALS);
+
+    ctrl_locks[i].mutex = mutex;
+    RTOS_MEMORY_BARRIER();
+    ctrl_locks[i].device = device;
+
+    rtos_lock_domain_release(RTOS_LOCK_DOMAIN_CONTROL);
+    rtos_interrupt_mask_set(mask);
+}
+
+void soc_bsp_ctrl_lock(
+        soc_peripheral_t device)
+{
+    soc_bsp_mutex_t mutex = ctrl_lock_find(device);
+
+    /* The device's driver has not been initialized */
+    xassert(mutex != NULL);
+
+    soc_bsp_mutex_lock(mutex);
+}
+
+void soc_bsp_ctrl_unlock(
+        soc_peripheral_t device)
+{
+    soc_bsp_mutex_unlock(ctrl_lock_find(device));
+}
+
+static void dma_rings_alloc(
+        soc_peripheral_t device,
+        int rx_desc_count,
+        int rx_buf_size,
+        int tx_desc_count)
+{
+    soc_dma_ring_buf_t *ring_buf;
+    uint32_t *buf_desc;
+    int i;
+
+    if (rx_desc_count > 0) {
+        buf_desc = dma_mem_alloc(rx_desc_count * SOC_DMA_BUF_DESC_WORDSIZE * sizeof(uint32_t));
+        xassert(buf_desc != NULL);
+
+        ring_buf = soc_peripheral_rx_dma_ring_buf(device);
+        soc_dma_ring_buf_init(ring_buf, buf_desc, rx_desc_count);
+
+        if (rx_buf_size > 0) {
+            for (i = 0; i < rx_desc_count; i++) {
+                void *buf = dma_mem_alloc(rx_buf_size);
+                xassert(buf != NULL);
+                soc_dma_ring_rx_buf_set(ring_buf, buf, rx_buf_size);
+            }
+        }
+    }
+
+    if (tx_desc_count > 0) {
+        buf_desc = dma_mem_alloc(tx_desc_count * SOC_DMA_BUF_DESC_WORDSIZE * sizeof(uint32_t));
+        xassert(buf_desc != NULL);
+        ring_buf = soc_peripheral_tx_dma_ring_buf(device);
+        soc_dma_ring_buf_init(ring_buf, buf_desc, tx_desc_count);
+    }
+}
+
+void soc_peripheral_common_dma_init(
+        soc_peripheral_t device,
+        int rx_desc_count,
+        int rx_buf_size,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr)
+{
+    xassert(soc_bsp_isr_core_valid(isr_core));
+
+#if SOC_PERIPHERAL_DMA_INIT_DEFERRED
+    int i;
+
+    for (i = 0; i < SOC_MAX_PERIPHERALS; i++) {
+        if (deferred_init[i].device == NULL) {
+            break;
+        }
+    }
+    xassert(i < SOC_MAX_PERIPHERALS);
+
+    deferred_init[i].rx_desc_count = rx_desc_count;
+    deferred_init[i].rx_buf_size = rx_buf_size;
+    deferred_init[i].tx_desc_count = tx_desc_count;
+    deferred_init[i].device = device;
+#else
+    dma_rings_alloc(device, rx_desc_count, rx_buf_size, tx_desc_count);
+#endif
+
+    soc_bsp_ctrl_lock_init(device);
+    soc_peripheral_handler_register(device, isr_core, app_data, isr);
+}
+
+void soc_peripheral_common_dma_open(
+        soc_peripheral_t device)
+{
+#if SOC_PERIPHERAL_DMA_INIT_DEFERRED
+    int i;
+
+    for (i = 0; i < SOC_MAX_PERIPHERALS; i++) {
+        if (deferred_init[i].device == device) {
+            dma_rings_alloc(
+                    device,
+                    deferred_init[i].rx_desc_count,
+                    deferred_init[i].rx_buf_size,
+                    deferred_init[i].tx_desc_count);
+            deferred_init[i].device = NULL;
+            break;
+        }
+    }
+#endif
+}
+
+void soc_peripheral_common_dma_init_static(
+        soc_peripheral_t device,
+        uint32_t *rx_desc_buf,
+        int rx_desc_count,
+        void *rx_bufs,
+        int rx_buf_size,
+        uint32_t *tx_desc_buf,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr)
+{
+    soc_dma_ring_buf_t *ring_buf;
+    int i;
+
+    xassert(soc_bsp_isr_core_valid(isr_core));
+
+    if (rx_desc_count > 0) {
+        xassert(rx_desc_buf != NULL);
+
+        ring_buf = soc_peripheral_rx_dma_ring_buf(device);
+        soc_dma_ring_buf_init(ring_buf, rx_desc_buf, rx_desc_count);
+
+        if (rx_buf_size > 0) {
+            xassert(rx_bufs != NULL);
+            xassert(((uintptr_t) rx_bufs & 7) == 0);
+
+            for (i = 0; i < rx_desc_count; i++) {
+                void *buf = (uint8_t *) rx_bufs + i * SOC_DMA_BUF_POOL_ALIGN(rx_buf_size);
+                soc_dma_ring_rx_buf_set(ring_buf, buf, rx_buf_size);
+            }
+        }
+    }
+
+    if (tx_desc_count > 0) {
+        xassert(tx_desc_buf != NULL);
+
+        ring_buf = soc_peripheral_tx_dma_ring_buf(device);
+        soc_dma_ring_buf_init(ring_buf, tx_desc_buf, tx_desc_count);
+    }
+
+    soc_bsp_ctrl_lock_init(device);
+    soc_peripheral_handler_register(device, isr_core, app_data, isr);
+}
+
+soc_dma_buf_pool_t *soc_dma_buf_pool_create(
+        int buf_size,
+        int buf_count)
+{
+    soc_dma_buf_pool_t *pool;
+    void *mem;
+
+    pool = dma_mem_alloc(SOC_DMA_BUF_POOL_ALIGN(sizeof(soc_dma_buf_pool_t)) + SOC_DMA_BUF_POOL_MEM_SIZE(buf_size, buf_count));
+    xassert(pool != NULL);
+
+    mem = (uint8_t *) pool + SOC_DMA_BUF_POOL_ALIGN(sizeof(soc_dma_buf_pool_t));
+    soc_dma_buf_pool_init(pool, mem, buf_size, buf_count);
+
+    return pool;
+}
+
+void soc_bsp_ring_wait_hook(
+        soc_dma_ring_buf_t *ring_buf,
+        void *arg)
+{
+    (void) ring_buf;
+    (void) arg;
+
+    soc_bsp_wait(SOC_BSP_RING_WAIT_TICKS);
+}
+
+/*
+ * The owner of a ring is kept as the argument of its wait hook, so
+ * that the ISR finds it straight from the device.
+ */
+static soc_bsp_waiter_t ring_owner(
+        soc_dma_ring_buf_t *ring_buf)
+{
+    return ring_buf->wait_hook == soc_bsp_ring_wait_hook ? ring_buf->wait_hook_arg : NULL;
+}
+
+void soc_bsp_ring_owner_set(
+        soc_peripheral_t device,
+        soc_dma_request_t ring)
+{
+    soc_dma_ring_buf_t *ring_buf;
+
+    if (ring == SOC_DMA_TX_REQUEST) {
+        ring_buf = soc_peripheral_tx_dma_ring_buf(device);
+    } else {
+        ring_buf = soc_peripheral_rx_dma_ring_buf(device);
+    }
+
+    soc_dma_ring_buf_wait_hook_set(ring_buf, soc_bsp_ring_wait_hook, soc_bsp_waiter_get());
+}
+
+int soc_bsp_ring_owner_notify_from_isr(
+        soc_peripheral_t device,
+        uint32_t status)
+{
+    soc_bsp_waiter_t tx_owner = NULL;
+    soc_bsp_waiter_t rx_owner = NULL;
+    int yield = 0;
+
+    if (status & SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM) {
+        tx_owner = ring_owner(soc_peripheral_tx_dma_ring_buf(device));
+        if (tx_owner != NULL) {
+            yield |= soc_bsp_notify_from_isr(tx_owner);
+        }
+    }
+
+    if (status & SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM) {
+        rx_owner = ring_owner(soc_peripheral_rx_dma_ring_buf(device));
+        /* A task that owns both rings is only woken once */
+        if (rx_owner != NULL && rx_owner != tx_owner) {
+            yield |= soc_bsp_notify_from_isr(rx_owner);
+        }
+    }
+
+    return yield;
+}
+
+/*
+ * Waits for the next notification, for no longer than is left of
+ * timeout_ticks since start. Returns 0 once the time is up.
+ */
+static int ring_wait(
+        uint32_t start,
+        uint32_t timeout_ticks)
+{
+    uint32_t elapsed;
+
+    if (timeout_ticks == SOC_BSP_WAIT_FOREVER) {
+        soc_bsp_wait(SOC_BSP_WAIT_FOREVER);
+        return 1;
+    }
+
+    elapsed = get_reference_time() - start;
+    if (elapsed >= timeout_ticks) {
+        return 0;
+    }
+
+    soc_bsp_wait(timeout_ticks - elapsed);
+    return 1;
+}
+
+int soc_bsp_tx_ring_wait(
+        soc_peripheral_t device,
+        void *bufs[],
+        int lengths[],
+        int more[],
+        int max,
+        uint32_t timeout_ticks)
+{
+    soc_dma_ring_buf_t *ring_buf = soc_peripheral_tx_dma_ring_buf(device);
+    uint32_t start = get_reference_time();
+    int count;
+
+    xassert(ring_owner(ring_buf) == soc_bsp_waiter_get());
+
+    /*
+     * The ring is checked before each wait, and a notification given
+     * after the check is kept until the wait, so none are missed.
+     */
+    while ((count = soc_dma_ring_tx_bufs_get(ring_buf, bufs, lengths, more, max)) == 0) {
+        if (!ring_wait(start, timeout_ticks)) {
+            break;
+        }
+    }
+
+    return count;
+}
+
+int soc_bsp_rx_ring_wait(
+        soc_peripheral_t device,
+        void *bufs[],
+        int lengths[],
+        int max,
+        uint32_t timeout_ticks)
+{
+    soc_dma_ring_buf_t *ring_buf = soc_peripheral_rx_dma_ring_buf(device);
+    uint32_t start = get_reference_time();
+    int count;
+
+    xassert(ring_owner(ring_buf) == soc_bsp_waiter_get());
+
+    while ((count = soc_dma_ring_rx_bufs_get(ring_buf, bufs, lengths, max)) == 0) {
+        if (!ring_wait(start, timeout_ticks)) {
+            break;
+        }
+    }
+
+    return count;
+}
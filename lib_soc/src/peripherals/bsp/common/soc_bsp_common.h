@@ -3,9 +3,227 @@
 #ifndef SOC_BSP_COMMON_H_
 #define SOC_BSP_COMMON_H_
 
+#include <stddef.h>
+
 #include "soc.h"
 #include "rtos_support.h"
+#include "soc_dma_buf_pool.h"
+
+/*
+ * The common BSP code is the same whether or not there is an RTOS.
+ * What it needs from the RTOS, an allocator and a way for a thread of
+ * execution to wait until it is notified, is provided by one backend:
+ * bsp/common/freertos when built with RTOS_FREERTOS, and otherwise
+ * bsp/common/baremetal, which lets plain threads use the DMA framework
+ * without an RTOS scheduler.
+ */
+
+/* Something that may wait with soc_bsp_wait(): a task, or a bare-metal logical core */
+typedef void *soc_bsp_waiter_t;
+
+/* The timeout for soc_bsp_wait() that never times out */
+#define SOC_BSP_WAIT_FOREVER 0xFFFFFFFF
+
+/*
+ * The longest, in reference clock ticks, that soc_bsp_ring_wait_hook()
+ * waits for a notification before letting the ring check again.
+ */
+#ifndef SOC_BSP_RING_WAIT_TICKS
+#define SOC_BSP_RING_WAIT_TICKS 100000
+#endif
+
+/**
+ * Allocates size bytes of double word aligned memory, which is never
+ * freed. Provided by the backend.
+ *
+ * \returns the memory, or NULL if there is not enough.
+ */
+void *soc_bsp_mem_alloc(size_t size);
+
+/**
+ * Checks that isr_core may be given to soc_peripheral_handler_register().
+ * Provided by the backend.
+ */
+int soc_bsp_isr_core_valid(int isr_core);
+
+/**
+ * Gets the waiter for the calling task or thread, to be passed to
+ * whatever will call soc_bsp_notify_from_isr() for it, such as a
+ * device's ISR through its app_data.
+ */
+soc_bsp_waiter_t soc_bsp_waiter_get(void);
+
+/**
+ * Waits for the calling task or thread to be notified with
+ * soc_bsp_notify_from_isr(). Notifications given before the wait are
+ * not lost, and any number of them are taken together.
+ *
+ * \param timeout_ticks  The longest time to wait, in reference clock
+ *                       ticks, or SOC_BSP_WAIT_FOREVER.
+ *
+ * \returns 1 if notified, or 0 if the wait timed out.
+ */
+int soc_bsp_wait(uint32_t timeout_ticks);
+
+/**
+ * Notifies a waiter. May be called from a peripheral's ISR.
+ *
+ * \returns non-zero if the ISR must request a context switch, and so
+ * should be returned by the ISR.
+ */
+int soc_bsp_notify_from_isr(soc_bsp_waiter_t waiter);
+
+/* A mutex that a task or thread blocks on, rather than spins on, while another holds it */
+typedef void *soc_bsp_mutex_t;
+
+/**
+ * Creates a mutex. It may be locked again by the task or thread that
+ * holds it, and is only released once it has been unlocked as many
+ * times. With FreeRTOS it is a recursive mutex, so a task that holds it
+ * inherits the priority of the highest priority task waiting for it.
+ * Provided by the backend.
+ */
+soc_bsp_mutex_t soc_bsp_mutex_create(void);
+
+/**
+ * Locks a mutex, waiting for as long as another task or thread holds
+ * it. Must not be called from an ISR. Provided by the backend.
+ */
+void soc_bsp_mutex_lock(soc_bsp_mutex_t mutex);
+
+/**
+ * Unlocks a mutex held by the calling task or thread. Provided by the
+ * backend.
+ */
+void soc_bsp_mutex_unlock(soc_bsp_mutex_t mutex);
+
+/**
+ * Creates the lock that keeps the control calls a driver makes to a
+ * device for one operation from interleaving with another task's. Each
+ * device has a single control chanend, and while one packed control
+ * call is sent and received as a whole, an operation may be several
+ * calls, such as sdram_driver_write(), or a call submitted and then
+ * finished later. Each driver's init function calls this, directly or
+ * through soc_peripheral_common_dma_init(). It does nothing if the lock
+ * has already been created. It may be called for different devices by
+ * several tasks at once, but not for the same device.
+ *
+ * \param device  The peripheral device.
+ */
+void soc_bsp_ctrl_lock_init(
+        soc_peripheral_t device);
+
+/**
+ * Takes a device's control lock, for the control calls of one driver
+ * operation. It is a soc_bsp_mutex_t, so a task that waits for it
+ * sleeps, and with FreeRTOS a low priority task holding it through a
+ * long SDRAM or I2C transfer is raised to the priority of the task
+ * waiting on it, such as one changing the volume. It may be taken again
+ * by the task that holds it.
+ *
+ * \param device  The peripheral device.
+ */
+void soc_bsp_ctrl_lock(
+        soc_peripheral_t device);
+
+/**
+ * Releases a device's control lock taken with soc_bsp_ctrl_lock().
+ *
+ * \param device  The peripheral device.
+ */
+void soc_bsp_ctrl_unlock(
+        soc_peripheral_t device);
+
+/**
+ * A ring wait hook, for soc_dma_ring_buf_wait_hook_set(), that has the
+ * caller wait with soc_bsp_wait() rather than spin. The device's ISR
+ * must notify the waiter when its TX DMA completes.
+ */
+void soc_bsp_ring_wait_hook(
+        soc_dma_ring_buf_t *ring_buf,
+        void *arg);
 
+/**
+ * Makes the calling task or thread the owner of one of a device's DMA
+ * rings. Only the owner may then wait on the ring with
+ * soc_bsp_tx_ring_wait() or soc_bsp_rx_ring_wait(). The ring's wait
+ * hook is set to soc_bsp_ring_wait_hook(), so the owner also blocks
+ * rather than spins when soc_dma_ring_tx_buf_set() waits for a free
+ * descriptor. The device's ISR must pass its interrupt status to
+ * soc_bsp_ring_owner_notify_from_isr().
+ *
+ * \param device  The peripheral device.
+ * \param ring    SOC_DMA_TX_REQUEST for the TX ring, or
+ *                SOC_DMA_RX_REQUEST for the RX ring.
+ */
+void soc_bsp_ring_owner_set(
+        soc_peripheral_t device,
+        soc_dma_request_t ring);
+
+/**
+ * Notifies the owner of the device's TX ring if status holds
+ * SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM, and the owner of its RX ring if
+ * status holds SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM. Rings with no owner
+ * are left alone. To be called from the device's ISR.
+ *
+ * \returns non-zero if the ISR must request a context switch.
+ */
+int soc_bsp_ring_owner_notify_from_isr(
+        soc_peripheral_t device,
+        uint32_t status);
+
+/**
+ * Gets up to max buffers that the DMA has finished sending from the
+ * device's TX ring, waiting until there is at least one. Must only be
+ * called by the ring's owner.
+ *
+ * \param bufs           Set to the buffers, in the order they were sent.
+ * \param lengths        Set to their lengths. May be NULL.
+ * \param more           Set to non-zero for each buffer that is not
+ *                       the last of its frame. May be NULL.
+ * \param max            The most buffers to get.
+ * \param timeout_ticks  The longest time to wait, in reference clock
+ *                       ticks, 0 to not wait, or SOC_BSP_WAIT_FOREVER.
+ *
+ * \returns the number of buffers got, which is 0 only on a timeout.
+ */
+int soc_bsp_tx_ring_wait(
+        soc_peripheral_t device,
+        void *bufs[],
+        int lengths[],
+        int more[],
+        int max,
+        uint32_t timeout_ticks);
+
+/**
+ * Gets up to max buffers that the DMA has filled in the device's RX
+ * ring, waiting until there is at least one, in the same way as
+ * soc_bsp_tx_ring_wait(). Must only be called by the ring's owner.
+ *
+ * \returns the number of buffers got, which is 0 only on a timeout.
+ */
+int soc_bsp_rx_ring_wait(
+        soc_peripheral_t device,
+        void *bufs[],
+        int lengths[],
+        int max,
+        uint32_t timeout_ticks);
+
+/*
+ * Declares the memory for count receive buffers of size bytes each,
+ * that may be given to soc_peripheral_common_dma_init_static(). Each
+ * buffer is kept double word aligned.
+ */
+#define SOC_DMA_RX_BUF_ARRAY(name, count, size) \
+    uint8_t name[(count) * SOC_DMA_BUF_POOL_ALIGN(size)] __attribute__((aligned(8)))
+
+/**
+ * Initializes a device's DMA rings and registers its ISR. The descriptors
+ * and RX buffers are allocated with soc_bsp_mem_alloc(), or from the DMA heap
+ * region when SOC_DMA_HEAP_SIZE is set. Their allocation is deferred
+ * until soc_peripheral_common_dma_open() when
+ * SOC_PERIPHERAL_DMA_INIT_DEFERRED is set.
+ */
 void soc_peripheral_common_dma_init(
         soc_peripheral_t device,
         int rx_desc_count,
@@ -15,4 +233,53 @@ void soc_peripheral_common_dma_init(
         int isr_core,
         rtos_irq_isr_t isr);
 
+/**
+ * Initializes a device's DMA rings and registers its ISR, in the same
+ * way as soc_peripheral_common_dma_init(), but with memory provided by
+ * the caller. Nothing is allocated, so the memory layout is fixed at
+ * compile time. The rings are ready straight away, whether or not
+ * SOC_PERIPHERAL_DMA_INIT_DEFERRED is set.
+ *
+ * \param device         The peripheral device.
+ * \param rx_desc_buf    The RX descriptors, declared with
+ *                       SOC_DMA_BUF_DESC_ARRAY(name, rx_desc_count).
+ *                       May be NULL if rx_desc_count is 0.
+ * \param rx_desc_count  The number of RX descriptors.
+ * \param rx_bufs        The RX buffers, declared with
+ *                       SOC_DMA_RX_BUF_ARRAY(name, rx_desc_count, rx_buf_size).
+ *                       May be NULL if rx_buf_size is 0, in which case the
+ *                       application gives the RX ring its buffers.
+ * \param rx_buf_size    The size in bytes of each RX buffer.
+ * \param tx_desc_buf    The TX descriptors, declared with
+ *                       SOC_DMA_BUF_DESC_ARRAY(name, tx_desc_count).
+ *                       May be NULL if tx_desc_count is 0.
+ * \param tx_desc_count  The number of TX descriptors.
+ * \param app_data       Application specific data for the ISR.
+ * \param isr_core       The RTOS core that handles the device's interrupts.
+ * \param isr            The ISR.
+ */
+void soc_peripheral_common_dma_init_static(
+        soc_peripheral_t device,
+        uint32_t *rx_desc_buf,
+        int rx_desc_count,
+        void *rx_bufs,
+        int rx_buf_size,
+        uint32_t *tx_desc_buf,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr);
+
+/**
+ * Allocates the descriptor rings and RX buffers of a device whose init
+ * was deferred by SOC_PERIPHERAL_DMA_INIT_DEFERRED. This must be called
+ * before the device's rings are first used, and does nothing if they
+ * have already been allocated. It must not be called for the same device
+ * by two tasks at once.
+ *
+ * \param device  The peripheral device.
+ */
+void soc_peripheral_common_dma_open(
+        soc_peripheral_t device);
+
 #endif /* SOC_BSP_COMMON_H_ */
@@ -0,0 +1,207 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <stdlib.h>
+
+#include "soc.h"
+#include "soc_dma_buf_pool.h"
+
+#include "xassert.h"
+
+#define ITEM_SIZE SOC_DMA_BUF_POOL_ALIGN(sizeof(soc_dma_buf_pool_item_t))
+
+#define BUF_ITEM(buf) ((soc_dma_buf_pool_item_t *) ((uint8_t *) (buf) - ITEM_SIZE))
+
+/*
+ * Each pool operation is only a few instructions long, so rather than
+ * take turns through anything more elaborate, interrupts are masked
+ * and the buffer pool lock domain is held just for the list update.
+ * Masking interrupts allows ISRs on the same core to use the pool.
+ */
+#define POOL_LOCK(mask) \
+    do { \
+        mask = rtos_interrupt_mask_all(); \
+        rtos_lock_domain_acquire(RTOS_LOCK_DOMAIN_BUF_POOL); \
+    } while (0)
+
+#define POOL_UNLOCK(mask) \
+    do { \
+        rtos_lock_domain_release(RTOS_LOCK_DOMAIN_BUF_POOL); \
+        rtos_interrupt_mask_set(mask); \
+    } while (0)
+
+void soc_dma_buf_pool_init(
+        soc_dma_buf_pool_t *pool,
+        void *mem,
+        int buf_size,
+        int buf_count)
+{
+    uint8_t *p = mem;
+    int stride;
+    int i;
+
+    xassert(((uintptr_t) mem & 7) == 0);
+    xassert(buf_size > 0 && buf_count > 0);
+
+    stride = ITEM_SIZE + SOC_DMA_BUF_POOL_ALIGN(buf_size);
+
+    pool->free_list = NULL;
+    pool->buf_size = buf_size;
+    pool->buf_count = buf_count;
+    pool->free_count = buf_count;
+
+    for (i = buf_count - 1; i >= 0; i--) {
+        soc_dma_buf_pool_item_t *item = (soc_dma_buf_pool_item_t *) (p + i * stride);
+        item->pool = pool;
+        item->refs = 0;
+        item->next = pool->free_list;
+        pool->free_list = item;
+    }
+}
+
+void *soc_dma_buf_pool_get(
+        soc_dma_buf_pool_t *pool)
+{
+    soc_dma_buf_pool_item_t *item;
+    uint32_t mask;
+
+    POOL_LOCK(mask);
+    item = pool->free_list;
+    if (item != NULL) {
+        pool->free_list = item->next;
+        pool->free_count--;
+        item->refs = 1;
+    }
+    POOL_UNLOCK(mask);
+
+    if (item != NULL) {
+        return (uint8_t *) item + ITEM_SIZE;
+    } else {
+        return NULL;
+    }
+}
+
+void soc_dma_buf_pool_put(
+        void *buf)
+{
+    soc_dma_buf_pool_item_t *item;
+    soc_dma_buf_pool_t *pool;
+    uint32_t mask;
+
+    xassert(buf != NULL);
+
+    item = BUF_ITEM(buf);
+    pool = item->pool;
+
+    POOL_LOCK(mask);
+    xassert(item->refs > 0);
+    if (--item->refs == 0) {
+        xassert(pool->free_count < pool->buf_count);
+        item->next = pool->free_list;
+        pool->free_list = item;
+        pool->free_count++;
+    }
+    POOL_UNLOCK(mask);
+}
+
+void soc_dma_buf_pool_ref(
+        void *buf,
+        int count)
+{
+    soc_dma_buf_pool_item_t *item;
+    uint32_t mask;
+
+    xassert(buf != NULL);
+    xassert(count >= 0);
+
+    item = BUF_ITEM(buf);
+
+    POOL_LOCK(mask);
+    xassert(item->refs > 0);
+    item->refs += count;
+    POOL_UNLOCK(mask);
+}
+
+void soc_dma_buf_pool_timestamp_set(
+        void *buf,
+        uint32_t timestamp)
+{
+    xassert(buf != NULL);
+
+    BUF_ITEM(buf)->timestamp = timestamp;
+}
+
+uint32_t soc_dma_buf_pool_timestamp_get(
+        const void *buf)
+{
+    xassert(buf != NULL);
+
+    return BUF_ITEM((void *) buf)->timestamp;
+}
+
+int soc_dma_buf_pool_free_count(
+        soc_dma_buf_pool_t *pool)
+{
+    return pool->free_count;
+}
+
+int soc_dma_ring_rx_buf_pool_fill(
+        soc_dma_ring_buf_t *ring_buf,
+        soc_dma_buf_pool_t *pool,
+        int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        void *buf = soc_dma_buf_pool_get(pool);
+        if (buf == NULL) {
+            break;
+        }
+        soc_dma_ring_rx_buf_set(ring_buf, buf, pool->buf_size);
+    }
+
+    return i;
+}
+
+int soc_dma_buf_pool_rx_refill(
+        soc_peripheral_t device,
+        soc_dma_buf_pool_t *pool,
+        void *bufs[],
+        int max)
+{
+    soc_dma_ring_buf_t *ring_buf = soc_peripheral_rx_dma_ring_buf(device);
+    int resubmitted = 0;
+    int count = 0;
+
+    while (count < max) {
+        uint32_t timestamp;
+        void *buf;
+        void *new_buf;
+
+#if SOC_DMA_BUF_DESC_TIMESTAMP
+        buf = soc_dma_ring_rx_buf_ts_get(ring_buf, NULL, &timestamp);
+#else
+        buf = soc_dma_ring_rx_buf_get(ring_buf, NULL);
+        timestamp = get_reference_time();
+#endif
+        if (buf == NULL) {
+            break;
+        }
+
+        new_buf = soc_dma_buf_pool_get(pool);
+        if (new_buf != NULL) {
+            BUF_ITEM(buf)->timestamp = timestamp;
+            bufs[count++] = buf;
+        } else {
+            /* Drop this one rather than leave the ring short */
+            new_buf = buf;
+        }
+        soc_dma_ring_rx_buf_set(ring_buf, new_buf, pool->buf_size);
+        resubmitted++;
+    }
+
+    if (resubmitted > 0) {
+        soc_peripheral_hub_dma_request(device, SOC_DMA_RX_REQUEST);
+    }
+
+    return count;
+}
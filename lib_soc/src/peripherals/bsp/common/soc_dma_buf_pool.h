@@ -0,0 +1,145 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SOC_DMA_BUF_POOL_H_
+#define SOC_DMA_BUF_POOL_H_
+
+#include "soc.h"
+
+typedef struct soc_dma_buf_pool soc_dma_buf_pool_t;
+
+/*
+ * The header kept in front of every buffer in a pool. While the
+ * buffer is free it links it into the pool's free list. The pool
+ * pointer lets soc_dma_buf_pool_put() find the buffer's pool, and
+ * the reference count lets one buffer be shared by several users.
+ * The timestamp travels with the buffer wherever it is passed.
+ */
+typedef struct soc_dma_buf_pool_item {
+    soc_dma_buf_pool_t *pool;
+    struct soc_dma_buf_pool_item *next;
+    volatile int refs;
+    uint32_t timestamp;
+} soc_dma_buf_pool_item_t;
+
+/*
+ * A pool of fixed size buffers for use with the DMA rings.
+ * Getting and putting buffers takes constant time and never
+ * touches the heap.
+ */
+struct soc_dma_buf_pool {
+    soc_dma_buf_pool_item_t *free_list;
+    int buf_size;
+    int buf_count;
+    volatile int free_count;
+};
+
+/* Buffers are kept double word aligned */
+#define SOC_DMA_BUF_POOL_ALIGN(n) (((n) + 7) & ~7)
+
+/*
+ * The number of bytes of memory that must be given to
+ * soc_dma_buf_pool_init() for buf_count buffers of buf_size bytes.
+ */
+#define SOC_DMA_BUF_POOL_MEM_SIZE(buf_size, buf_count) \
+    ((buf_count) * (SOC_DMA_BUF_POOL_ALIGN(sizeof(soc_dma_buf_pool_item_t)) + SOC_DMA_BUF_POOL_ALIGN(buf_size)))
+
+/*
+ * Initializes a pool with buf_count buffers of buf_size bytes, carved
+ * out of mem. mem must be double word aligned and at least
+ * SOC_DMA_BUF_POOL_MEM_SIZE(buf_size, buf_count) bytes.
+ */
+void soc_dma_buf_pool_init(
+        soc_dma_buf_pool_t *pool,
+        void *mem,
+        int buf_size,
+        int buf_count);
+
+/*
+ * Creates a pool with buf_count buffers of buf_size bytes, with
+ * a single allocation. This is provided by the RTOS specific BSP code.
+ */
+soc_dma_buf_pool_t *soc_dma_buf_pool_create(
+        int buf_size,
+        int buf_count);
+
+/*
+ * Gets a buffer from a pool, holding a single reference to it.
+ * Returns NULL if the pool is empty. May be called from both
+ * tasks and ISRs.
+ */
+void *soc_dma_buf_pool_get(
+        soc_dma_buf_pool_t *pool);
+
+/*
+ * Releases a reference to a buffer. Once the last reference is
+ * released the buffer goes back to the pool it was got from.
+ * May be called from both tasks and ISRs.
+ */
+void soc_dma_buf_pool_put(
+        void *buf);
+
+/*
+ * Adds count references to a buffer that the caller already holds
+ * a reference to, so that it may be handed to count more users
+ * without being copied. Each of them then calls soc_dma_buf_pool_put()
+ * when done with it. The buffer must not be modified while shared.
+ * May be called from both tasks and ISRs.
+ */
+void soc_dma_buf_pool_ref(
+        void *buf,
+        int count);
+
+/*
+ * Sets a reference clock time kept with a buffer, such as the time
+ * its data was captured. It is carried along with the buffer through
+ * any queues it is passed through, as only its address is passed. It
+ * is not cleared when the buffer goes back to its pool.
+ */
+void soc_dma_buf_pool_timestamp_set(
+        void *buf,
+        uint32_t timestamp);
+
+/*
+ * Gets the time last set with soc_dma_buf_pool_timestamp_set().
+ */
+uint32_t soc_dma_buf_pool_timestamp_get(
+        const void *buf);
+
+/*
+ * Returns the number of buffers currently free in a pool.
+ */
+int soc_dma_buf_pool_free_count(
+        soc_dma_buf_pool_t *pool);
+
+/*
+ * Gives up to count buffers from a pool to a DMA ring buffer for
+ * receiving into. Returns the number of buffers given, which is
+ * less than count if the pool runs out.
+ */
+int soc_dma_ring_rx_buf_pool_fill(
+        soc_dma_ring_buf_t *ring_buf,
+        soc_dma_buf_pool_t *pool,
+        int count);
+
+/*
+ * Gets up to max completed buffers from a device's RX ring that was
+ * filled from pool, and gives the ring a free buffer from the pool in
+ * place of each one, then asks the hub to carry on receiving into them.
+ * The ring is refilled before anything downstream sees the buffers, so
+ * it never runs dry because a consumer is late. Consumers just give the
+ * buffers back to the pool with soc_dma_buf_pool_put() when done.
+ *
+ * If the pool is empty the received buffer goes straight back into the
+ * ring instead, and its data is dropped. Each buffer got has its
+ * timestamp set to the time its data was received.
+ *
+ * Returns the number of buffers got. Meant to be called from the
+ * device's RX ISR, which must then be the only user of the ring.
+ */
+int soc_dma_buf_pool_rx_refill(
+        soc_peripheral_t device,
+        soc_dma_buf_pool_t *pool,
+        void *bufs[],
+        int max);
+
+#endif /* SOC_DMA_BUF_POOL_H_ */
@@ -11,6 +11,25 @@
 soc_peripheral_t bitstream_eth_devices[BITSTREAM_ETHERNET_DEVICE_COUNT];
 #endif /* SOC_ETHERNET_PERIPHERAL_USED */
 
+/* The link state of each device, as last sent by it */
+static volatile ethernet_link_state_t link_state[BITSTREAM_ETHERNET_DEVICE_COUNT];
+
+/* The high priority TX device of each device, if it has one */
+static soc_peripheral_t hp_devices[BITSTREAM_ETHERNET_DEVICE_COUNT];
+
+static int device_index(
+        soc_peripheral_t dev)
+{
+    for (int i = 0; i < BITSTREAM_ETHERNET_DEVICE_COUNT; i++) {
+        if (bitstream_ethernet_devices[i] == dev) {
+            return i;
+        }
+    }
+
+    xassert(0);
+    return -1;
+}
+
 void ethernet_driver_send_packet(
         soc_peripheral_t dev,
         void *packet,
@@ -21,6 +40,94 @@ void ethernet_driver_send_packet(
     soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
 }
 
+void ethernet_driver_send_packet_sg(
+        soc_peripheral_t dev,
+        void * const bufs[],
+        const unsigned lengths[],
+        int count)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+    unsigned total = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        total += lengths[i];
+    }
+    xassert(count > 0 && total <= ETH_DEV_MAX_FRAME_SIZE);
+
+    /*
+     * The first buffer is set last, as that is what makes the frame
+     * visible to the DMA.
+     */
+    for (i = count - 1; i >= 0; i--) {
+        soc_dma_ring_tx_buf_sg_set(tx_ring_buf, bufs[i], lengths[i], i, count);
+    }
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+}
+
+int ethernet_driver_send_packet_async(
+        soc_peripheral_t dev,
+        void *packet,
+        unsigned n)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+
+    if (soc_dma_ring_tx_buf_try_set(tx_ring_buf, packet, n) != 0) {
+        return -1;
+    }
+
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+
+    return 0;
+}
+
+int ethernet_driver_send_packet_hp_async(
+        soc_peripheral_t dev,
+        void *packet,
+        unsigned n)
+{
+    soc_peripheral_t hp_dev = hp_devices[device_index(dev)];
+    soc_dma_ring_buf_t *tx_ring_buf;
+
+    xassert(hp_dev != NULL);
+    tx_ring_buf = soc_peripheral_tx_dma_ring_buf(hp_dev);
+
+    if (soc_dma_ring_tx_buf_try_set(tx_ring_buf, packet, n) != 0) {
+        return -1;
+    }
+
+    /*
+     * A high priority device moved by the hub is sent the frame on its
+     * own channel. One that takes its frames straight from the ring has
+     * no control channel, so the main device is woken instead and looks
+     * at the high priority ring first.
+     */
+    soc_peripheral_hub_dma_request(hp_dev, SOC_DMA_TX_REQUEST);
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+
+    return 0;
+}
+
+void *ethernet_driver_send_packet_hp_done_get(
+        soc_peripheral_t dev,
+        int *more)
+{
+    soc_peripheral_t hp_dev = hp_devices[device_index(dev)];
+
+    xassert(hp_dev != NULL);
+
+    return soc_dma_ring_tx_buf_get(soc_peripheral_tx_dma_ring_buf(hp_dev), NULL, more);
+}
+
+void *ethernet_driver_send_packet_done_get(
+        soc_peripheral_t dev,
+        int *more)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+
+    return soc_dma_ring_tx_buf_get(tx_ring_buf, NULL, more);
+}
+
 void ethernet_driver_send_packet_wait_for_copy(
         soc_peripheral_t dev,
         void *packet,
@@ -35,6 +142,28 @@ void ethernet_driver_send_packet_wait_for_copy(
     }
 }
 
+void ethernet_driver_rx_buf_give(
+        soc_peripheral_t dev,
+        void *buf,
+        unsigned size)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+
+    xassert(size >= ETH_DEV_MAX_FRAME_SIZE);
+
+    soc_dma_ring_rx_buf_set(rx_ring_buf, buf, size);
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_RX_REQUEST);
+}
+
+void *ethernet_driver_rx_frame_get(
+        soc_peripheral_t dev,
+        int *length)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+
+    return soc_dma_ring_rx_buf_get(rx_ring_buf, length);
+}
+
 void ethernet_get_mac_addr(
         soc_peripheral_t dev,
         size_t ifnum,
@@ -42,6 +171,8 @@ void ethernet_get_mac_addr(
 {
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
+    soc_bsp_ctrl_lock(dev);
+
     soc_peripheral_function_code_tx(c, ETH_DEV_GET_MAC_ADDR);
 
     soc_peripheral_varlist_tx(
@@ -51,6 +182,8 @@ void ethernet_get_mac_addr(
     soc_peripheral_varlist_rx(
             c, 1,
             ETHERNET_MACADDR_NUM_BYTES, mac_address);
+
+    soc_bsp_ctrl_unlock(dev);
 }
 
 void ethernet_set_mac_addr(
@@ -60,12 +193,16 @@ void ethernet_set_mac_addr(
 {
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
+    soc_bsp_ctrl_lock(dev);
+
     soc_peripheral_function_code_tx(c, ETH_DEV_SET_MAC_ADDR);
 
     soc_peripheral_varlist_tx(
             c, 2,
             sizeof(ifnum), &ifnum,
             ETHERNET_MACADDR_NUM_BYTES, mac_address);
+
+    soc_bsp_ctrl_unlock(dev);
 }
 
 void ethernet_driver_smi_write_reg(
@@ -76,6 +213,8 @@ void ethernet_driver_smi_write_reg(
 {
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
+    soc_bsp_ctrl_lock(dev);
+
     soc_peripheral_function_code_tx(c, ETH_DEV_SMI_WRITE_REG);
 
     soc_peripheral_varlist_tx(
@@ -83,6 +222,8 @@ void ethernet_driver_smi_write_reg(
             sizeof(phy_addr), &phy_addr,
             sizeof(reg_addr), &reg_addr,
             sizeof(val), &val);
+
+    soc_bsp_ctrl_unlock(dev);
 }
 
 uint16_t ethernet_driver_smi_read_reg(
@@ -93,6 +234,8 @@ uint16_t ethernet_driver_smi_read_reg(
     chanend c = soc_peripheral_ctrl_chanend(dev);
     uint16_t retVal;
 
+    soc_bsp_ctrl_lock(dev);
+
     soc_peripheral_function_code_tx(c, ETH_DEV_SMI_READ_REG);
 
     soc_peripheral_varlist_tx(
@@ -104,6 +247,8 @@ uint16_t ethernet_driver_smi_read_reg(
             c, 1,
             sizeof(retVal), &retVal);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return retVal;
 }
 
@@ -114,15 +259,45 @@ ethernet_link_state_t ethernet_driver_smi_get_link_state(
     chanend c = soc_peripheral_ctrl_chanend(dev);
     ethernet_link_state_t retVal;
 
+    soc_bsp_ctrl_lock(dev);
+
     soc_peripheral_function_code_tx(c, ETH_DEV_SMI_GET_LINK_STATUS);
 
     soc_peripheral_varlist_rx(
             c, 1,
             sizeof(retVal), &retVal);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return retVal;
 }
 
+int ethernet_driver_link_status_update(
+        soc_peripheral_t dev,
+        uint32_t status)
+{
+    status &= ETH_DEV_ISR_LINK_UP_BM | ETH_DEV_ISR_LINK_DOWN_BM;
+
+    switch (status) {
+    case 0:
+        return 0;
+    case ETH_DEV_ISR_LINK_UP_BM:
+        link_state[device_index(dev)] = ETHERNET_LINK_UP;
+        return 1;
+    case ETH_DEV_ISR_LINK_DOWN_BM:
+        link_state[device_index(dev)] = ETHERNET_LINK_DOWN;
+        return 1;
+    default:
+        return -1;
+    }
+}
+
+ethernet_link_state_t ethernet_driver_link_state_get(
+        soc_peripheral_t dev)
+{
+    return link_state[device_index(dev)];
+}
+
 soc_peripheral_t ethernet_driver_init(
         int device_id,
         int rx_desc_count,
@@ -147,5 +322,40 @@ soc_peripheral_t ethernet_driver_init(
             isr_core,
             isr);
 
+    /*
+     * The network interface uses the rings without opening the
+     * device first, so they are never deferred.
+     */
+    soc_peripheral_common_dma_open(device);
+
     return device;
 }
+
+void ethernet_driver_hp_init(
+        soc_peripheral_t dev,
+        int hp_device_id,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr)
+{
+    soc_peripheral_t hp_dev;
+
+    xassert(hp_device_id >= 0 && hp_device_id < BITSTREAM_ETHERNET_DEVICE_COUNT);
+
+    hp_dev = bitstream_ethernet_devices[hp_device_id];
+    xassert(hp_dev != dev);
+
+    soc_peripheral_common_dma_init(
+            hp_dev,
+            0,
+            0,
+            tx_desc_count,
+            app_data,
+            isr_core,
+            isr);
+
+    soc_peripheral_common_dma_open(hp_dev);
+
+    hp_devices[device_index(dev)] = hp_dev;
+}
@@ -19,11 +19,110 @@ void ethernet_driver_send_packet(
         void *packet,
         unsigned n);
 
+/*
+ * Sends a frame made up of count separate buffers, such as a header
+ * and its payload, without first copying them together. Each buffer
+ * takes its own TX descriptor, and they are gathered into one frame
+ * as they are moved to the device, straight into the buffer that it
+ * hands to the MAC. The total length must be no more than
+ * ETH_DEV_MAX_FRAME_SIZE.
+ *
+ * The ISR is sent SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM once the whole
+ * frame has been taken, and each of its buffers is then got back from
+ * the TX ring in order, with all but the last having more set.
+ */
+void ethernet_driver_send_packet_sg(
+        soc_peripheral_t dev,
+        void * const bufs[],
+        const unsigned lengths[],
+        int count);
+
+/*
+ * Queues a frame to send and returns straight away, without waiting
+ * for it to be taken. Returns 0 if the frame was queued, or -1 if the
+ * TX ring is full, in which case nothing was queued and it may be tried
+ * again after the next TX done interrupt. The packet pointer is the
+ * frame's token: the ISR, on SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM, gets it
+ * back with ethernet_driver_send_packet_done_get() once the packet may
+ * be freed or reused. Frames are given back in the order they are sent.
+ */
+int ethernet_driver_send_packet_async(
+        soc_peripheral_t dev,
+        void *packet,
+        unsigned n);
+
+/*
+ * Queues a frame on the device's high priority TX ring, in the same way
+ * as ethernet_driver_send_packet_async(). The device sends it through
+ * the RT MAC's high priority queue, ahead of every frame on the normal
+ * ring, and with the shaper enabled its latency is bounded however
+ * busy the link is. The ring must first have been set up with
+ * ethernet_driver_hp_init(), and it is the high priority device's ISR
+ * that is sent SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM.
+ */
+int ethernet_driver_send_packet_hp_async(
+        soc_peripheral_t dev,
+        void *packet,
+        unsigned n);
+
+/*
+ * Returns the next buffer that the device has finished with from its
+ * high priority TX ring, or NULL if there is none.
+ */
+void *ethernet_driver_send_packet_hp_done_get(
+        soc_peripheral_t dev,
+        int *more);
+
+/*
+ * Returns the next buffer that the device has finished with, or NULL
+ * if there is none. For frames sent with ethernet_driver_send_packet_sg()
+ * each of their buffers is returned in turn, with *more set for all but
+ * the last. more may be NULL.
+ */
+void *ethernet_driver_send_packet_done_get(
+        soc_peripheral_t dev,
+        int *more);
+
+/*
+ * Sends a frame and spins until it has been taken. Any other buffers
+ * that complete while it waits are taken from the TX ring and dropped,
+ * so this must only be used when nothing else sends on the device. The
+ * ethernet_driver_send_packet_async() API should otherwise be used.
+ */
 void ethernet_driver_send_packet_wait_for_copy(
         soc_peripheral_t dev,
         void *packet,
         unsigned n);
 
+/*
+ * Gives the device a buffer to receive a frame into, of size bytes,
+ * which must be at least ETH_DEV_MAX_FRAME_SIZE.
+ *
+ * When the driver is initialized with an rx_buf_size of 0 its RX ring
+ * starts out empty, and every receive buffer is given this way. The
+ * buffers may then be the ones handed up to the network stack, such
+ * as the pucEthernetBuffer of a FreeRTOS+TCP network buffer descriptor,
+ * so that the DMA receives each frame straight into its final buffer
+ * and it can be passed up without being copied. The descriptor can be
+ * found again from the buffer with pxPacketBuffer_to_NetworkBuffer().
+ *
+ * May be called from the ISR to replace each buffer as it is taken.
+ */
+void ethernet_driver_rx_buf_give(
+        soc_peripheral_t dev,
+        void *buf,
+        unsigned size);
+
+/*
+ * Returns the buffer holding the next received frame, and its length
+ * in bytes in *length, or NULL if no frame has been received. The
+ * buffer is no longer owned by the driver. This is normally called
+ * from the ISR when it is sent SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM.
+ */
+void *ethernet_driver_rx_frame_get(
+        soc_peripheral_t dev,
+        int *length);
+
 void ethernet_get_mac_addr(
         soc_peripheral_t dev,
         size_t ifnum,
@@ -49,6 +148,28 @@ ethernet_link_state_t ethernet_driver_smi_get_link_state(
         soc_peripheral_t dev,
         uint8_t phy_addr);
 
+/*
+ * To be called by the ISR with each status it is sent, so that the
+ * driver follows the link state changes the device sends it. Returns
+ * 1 if the status holds a link change, or 0 if it does not.
+ *
+ * When the status holds both ETH_DEV_ISR_LINK_UP_BM and
+ * ETH_DEV_ISR_LINK_DOWN_BM, the state is left as it was and -1 is
+ * returned. The state must then be got from a task with
+ * ethernet_driver_smi_get_link_state().
+ */
+int ethernet_driver_link_status_update(
+        soc_peripheral_t dev,
+        uint32_t status);
+
+/*
+ * Returns the link state last given by the device's IRQs, without a
+ * call to the device, so that it may be checked as often as needed.
+ * It is ETHERNET_LINK_DOWN until the device first says otherwise.
+ */
+ethernet_link_state_t ethernet_driver_link_state_get(
+        soc_peripheral_t dev);
+
 soc_peripheral_t ethernet_driver_init(
         int device_id,
         int rx_desc_count,
@@ -58,4 +179,20 @@ soc_peripheral_t ethernet_driver_init(
         int isr_core,
         rtos_irq_isr_t isr);
 
+/*
+ * Gives an Ethernet device a high priority TX ring. hp_device_id is the
+ * device that was passed to the Ethernet device as its hp_peripheral,
+ * or whose channels were given as its hp_data_from_dma_c. Only its TX
+ * ring is used, and isr is sent its TX done interrupts. The Ethernet
+ * device must be built with ETHCONF_USE_RT_MAC set, and usually with
+ * ETHCONF_USE_SHAPER and ETHCONF_SHAPER_IDLE_SLOPE_BPS set too.
+ */
+void ethernet_driver_hp_init(
+        soc_peripheral_t dev,
+        int hp_device_id,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr);
+
 #endif /* ETHERNET_DRIVER_H_ */
@@ -1,5 +1,7 @@
 // Copyright (c) 2019, XMOS Ltd, All rights reserved
 
+#include <string.h>
+
 #include "soc.h"
 #include "soc_bsp_common.h"
 #include "bitstream_devices.h"
@@ -18,16 +20,15 @@ static int gpio_driver_alloc(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_ALLOC );
-
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_rx(
-            c, 1,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_ALLOC, 1, 1,
+            sizeof(id), &id,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -38,16 +39,15 @@ static int gpio_driver_free(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_FREE );
-
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_rx(
-            c, 1,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_FREE, 1, 1,
+            sizeof(id), &id,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -59,17 +59,16 @@ static int gpio_driver_read(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_IN );
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
-
-    soc_peripheral_varlist_rx(
-            c, 2,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_IN, 1, 2,
+            sizeof(id), &id,
             sizeof(uint32_t), data,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -81,39 +80,85 @@ static int gpio_driver_write(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_OUT );
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_tx(
-            c, 2,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_OUT, 2, 1,
             sizeof(id), &id,
-            sizeof(data), &data);
+            sizeof(data), &data,
+            sizeof(int), &retval);
+
+    soc_bsp_ctrl_unlock( dev );
+
+    return retval;
+}
+
+static int gpio_driver_write_multi(
+        soc_peripheral_t dev,
+        const gpio_id_t *ids,
+        const uint32_t *data,
+        int count)
+{
+    int retval;
+    chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_varlist_rx(
-            c, 1,
+    soc_bsp_ctrl_lock( dev );
+
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_OUT_MULTI, 3, 1,
+            sizeof(count), &count,
+            count * sizeof(gpio_id_t), ids,
+            count * sizeof(uint32_t), data,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
-static int gpio_driver_peek(
+static int gpio_driver_read_multi(
         soc_peripheral_t dev,
-        gpio_id_t id,
-        uint32_t *data)
+        const gpio_id_t *ids,
+        uint32_t *data,
+        int count)
 {
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_PEEK );
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_IN_MULTI, 2, 2,
+            sizeof(count), &count,
+            count * sizeof(gpio_id_t), ids,
+            count * sizeof(uint32_t), data,
+            sizeof(int), &retval);
 
-    soc_peripheral_varlist_rx(
-            c, 2,
-            sizeof(uint32_t), data,
+    soc_bsp_ctrl_unlock( dev );
+
+    return retval;
+}
+
+static int gpio_driver_pins_set(
+        soc_peripheral_t dev,
+        gpio_id_t id,
+        uint32_t set_mask,
+        uint32_t clear_mask)
+{
+    int retval;
+    chanend c = soc_peripheral_ctrl_chanend( dev );
+
+    soc_bsp_ctrl_lock( dev );
+
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_PINS_SET, 3, 1,
+            sizeof(id), &id,
+            sizeof(set_mask), &set_mask,
+            sizeof(clear_mask), &clear_mask,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -124,16 +169,15 @@ static int gpio_driver_irq_setup(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_IRQ_SETUP );
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
-
-    soc_peripheral_varlist_rx(
-            c, 1,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_IRQ_SETUP, 1, 1,
+            sizeof(id), &id,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -144,16 +188,15 @@ static int gpio_driver_irq_enable(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_IRQ_ENABLE );
-
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_rx(
-            c, 1,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_IRQ_ENABLE, 1, 1,
+            sizeof(id), &id,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -164,16 +207,82 @@ static int gpio_driver_irq_disable(
     int retval;
     chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_function_code_tx( c, GPIO_DEV_PORT_IRQ_DISABLE );
+    soc_bsp_ctrl_lock( dev );
+
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_IRQ_DISABLE, 1, 1,
+            sizeof(id), &id,
+            sizeof(int), &retval);
+
+    soc_bsp_ctrl_unlock( dev );
+
+    return retval;
+}
+
+static int gpio_driver_event_enable(
+        soc_peripheral_t dev,
+        gpio_id_t id)
+{
+    int retval;
+    chanend c = soc_peripheral_ctrl_chanend( dev );
+
+    soc_bsp_ctrl_lock( dev );
+
+    soc_peripheral_control_call(
+            c, GPIO_DEV_PORT_EVENT_ENABLE, 1, 1,
+            sizeof(id), &id,
+            sizeof(int), &retval);
+
+    soc_bsp_ctrl_unlock( dev );
+
+    return retval;
+}
+
+static int gpio_driver_wave_start(
+        soc_peripheral_t dev,
+        int wave_id,
+        gpio_id_t id,
+        uint32_t mask,
+        const gpio_wave_step_t *steps,
+        int step_count,
+        int repeat)
+{
+    int retval;
+    chanend c = soc_peripheral_ctrl_chanend( dev );
+
+    soc_bsp_ctrl_lock( dev );
+
+    soc_peripheral_control_call(
+            c, GPIO_DEV_WAVE_START, 6, 1,
+            sizeof(wave_id), &wave_id,
+            sizeof(id), &id,
+            sizeof(mask), &mask,
+            sizeof(repeat), &repeat,
+            sizeof(step_count), &step_count,
+            step_count * sizeof(gpio_wave_step_t), steps,
+            sizeof(int), &retval);
+
+    soc_bsp_ctrl_unlock( dev );
+
+    return retval;
+}
+
+static int gpio_driver_wave_stop(
+        soc_peripheral_t dev,
+        int wave_id)
+{
+    int retval;
+    chanend c = soc_peripheral_ctrl_chanend( dev );
 
-    soc_peripheral_varlist_tx(
-            c, 1,
-            sizeof(id), &id);
+    soc_bsp_ctrl_lock( dev );
 
-    soc_peripheral_varlist_rx(
-            c, 1,
+    soc_peripheral_control_call(
+            c, GPIO_DEV_WAVE_STOP, 1, 1,
+            sizeof(wave_id), &wave_id,
             sizeof(int), &retval);
 
+    soc_bsp_ctrl_unlock( dev );
+
     return retval;
 }
 
@@ -204,6 +313,77 @@ int gpio_irq_disable( soc_peripheral_t dev, gpio_id_t gpio_id )
     return retVal;
 }
 
+int gpio_event_enable( soc_peripheral_t dev, gpio_id_t gpio_id )
+{
+    uint32_t retVal;
+
+    retVal = gpio_driver_event_enable( dev, gpio_id );
+
+    return retVal;
+}
+
+int gpio_events_get( soc_peripheral_t dev, gpio_event_t *events, int max )
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf( dev );
+    int count = 0;
+    void *rx_buf;
+    int length;
+
+    xassert( max >= GPIOCONF_EVENT_BATCH_MAX );
+
+    while( count + GPIOCONF_EVENT_BATCH_MAX <= max &&
+           ( rx_buf = soc_dma_ring_rx_buf_get( rx_ring_buf, &length ) ) != NULL )
+    {
+        memcpy( &events[ count ], rx_buf, length );
+        count += length / sizeof( gpio_event_t );
+
+        soc_dma_ring_rx_buf_set( rx_ring_buf, rx_buf, GPIO_DRIVER_EVENT_BUF_SIZE );
+    }
+
+    if( count > 0 )
+    {
+        soc_peripheral_hub_dma_request( dev, SOC_DMA_RX_REQUEST );
+    }
+
+    return count;
+}
+
+int gpio_wave_start( soc_peripheral_t dev, int wave_id, gpio_id_t gpio_id, uint32_t mask,
+                     const gpio_wave_step_t *steps, int step_count, int repeat )
+{
+    xassert( wave_id >= 0 && wave_id < GPIOCONF_WAVE_COUNT );
+    xassert( step_count > 0 && step_count <= GPIOCONF_WAVE_STEPS_MAX );
+
+    for( int i = 0; i < step_count; i++ )
+    {
+        xassert( steps[ i ].ticks > 0 );
+    }
+
+    return gpio_driver_wave_start( dev, wave_id, gpio_id, mask, steps, step_count, repeat );
+}
+
+int gpio_pwm_start( soc_peripheral_t dev, int wave_id, gpio_id_t gpio_id, int pin,
+                    uint32_t period_ticks, uint32_t high_ticks )
+{
+    gpio_wave_step_t steps[ 2 ];
+
+    xassert( high_ticks > 0 && high_ticks < period_ticks );
+
+    steps[ 0 ].value = 1 << pin;
+    steps[ 0 ].ticks = high_ticks;
+    steps[ 1 ].value = 0;
+    steps[ 1 ].ticks = period_ticks - high_ticks;
+
+    return gpio_wave_start( dev, wave_id, gpio_id, 1 << pin, steps, 2, 0 );
+}
+
+int gpio_wave_stop( soc_peripheral_t dev, int wave_id )
+{
+    xassert( wave_id >= 0 && wave_id < GPIOCONF_WAVE_COUNT );
+
+    return gpio_driver_wave_stop( dev, wave_id );
+}
+
 int gpio_init( soc_peripheral_t dev, gpio_id_t gpio_id )
 {
     int retVal;
@@ -225,20 +405,26 @@ void gpio_write( soc_peripheral_t dev, gpio_id_t gpio_id, uint32_t value )
 
 void gpio_write_pin( soc_peripheral_t dev, gpio_id_t gpio_id, int pin, uint32_t value )
 {
-    uint32_t port_state;
-
-    gpio_driver_peek( dev, gpio_id, &port_state );
-
     if( value == 0 )
     {
-        port_state &= ~( 1 << pin );
+        gpio_driver_pins_set( dev, gpio_id, 0, 1 << pin );
     }
     else
     {
-        port_state |= ( 1 << pin );
+        gpio_driver_pins_set( dev, gpio_id, 1 << pin, 0 );
     }
+}
+
+int gpio_write_pins( soc_peripheral_t dev, gpio_id_t gpio_id, uint32_t set_mask, uint32_t clear_mask )
+{
+    return gpio_driver_pins_set( dev, gpio_id, set_mask, clear_mask );
+}
+
+int gpio_write_multi( soc_peripheral_t dev, const gpio_id_t *gpio_ids, const uint32_t *values, int count )
+{
+    xassert( count > 0 && count <= GPIO_TOTAL_PORT_CNT );
 
-    gpio_driver_write( dev, gpio_id, port_state );
+    return gpio_driver_write_multi( dev, gpio_ids, values, count );
 }
 
 uint32_t gpio_read( soc_peripheral_t dev, gpio_id_t gpio_id )
@@ -250,6 +436,13 @@ uint32_t gpio_read( soc_peripheral_t dev, gpio_id_t gpio_id )
     return retVal;
 }
 
+int gpio_read_multi( soc_peripheral_t dev, const gpio_id_t *gpio_ids, uint32_t *values, int count )
+{
+    xassert( count > 0 && count <= GPIO_TOTAL_PORT_CNT );
+
+    return gpio_driver_read_multi( dev, gpio_ids, values, count );
+}
+
 uint32_t gpio_read_pin( soc_peripheral_t dev, gpio_id_t gpio_id, int pin )
 {
     uint32_t retVal;
@@ -262,6 +455,7 @@ uint32_t gpio_read_pin( soc_peripheral_t dev, gpio_id_t gpio_id, int pin )
 
 soc_peripheral_t gpio_driver_init(
         int device_id,
+        int rx_desc_count,
         void *app_data,
         int isr_core,
         rtos_irq_isr_t isr)
@@ -272,7 +466,14 @@ soc_peripheral_t gpio_driver_init(
 
     device = bitstream_gpio_devices[ device_id ];
 
-    soc_peripheral_handler_register( device, isr_core, app_data, isr );
+    soc_peripheral_common_dma_init(
+            device,
+            rx_desc_count,
+            GPIO_DRIVER_EVENT_BUF_SIZE,
+            0,
+            app_data,
+            isr_core,
+            isr );
 
     return device;
 }
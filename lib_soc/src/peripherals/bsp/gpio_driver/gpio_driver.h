@@ -5,12 +5,20 @@
 
 #include <stdint.h>
 #include "soc.h"
+#include "gpio_dev_conf_defaults.h"
 #include "gpio_dev_ctrl.h"
 #include "gpio_port_map.h"
 
-/* Initialize device */
+/* The size of each DMA RX buffer that port events are received into */
+#define GPIO_DRIVER_EVENT_BUF_SIZE ( GPIOCONF_EVENT_BATCH_MAX * sizeof( gpio_event_t ) )
+
+/*
+ * Initialize device. rx_desc_count is the number of DMA RX buffers
+ * for port events, which may be 0 if no port has events enabled.
+ */
 soc_peripheral_t gpio_driver_init(
         int device_id,
+        int rx_desc_count,
         void *app_data,
         int isr_core,
         rtos_irq_isr_t isr);
@@ -22,10 +30,23 @@ int gpio_init( soc_peripheral_t dev, gpio_id_t gpio_id );
 void gpio_write( soc_peripheral_t dev, gpio_id_t gpio_id, uint32_t value );
 void gpio_write_pin( soc_peripheral_t dev, gpio_id_t gpio_id, int pin, uint32_t value );
 
+/*
+ * Sets the pins in set_mask and clears the pins in clear_mask, leaving
+ * the others as they are. This is done by the device in one call, so
+ * no other write to the port can come in between.
+ */
+int gpio_write_pins( soc_peripheral_t dev, gpio_id_t gpio_id, uint32_t set_mask, uint32_t clear_mask );
+
+/* Writes values[i] to port gpio_ids[i] for each of count ports, in one call */
+int gpio_write_multi( soc_peripheral_t dev, const gpio_id_t *gpio_ids, const uint32_t *values, int count );
+
 /* Read from port */
 uint32_t gpio_read( soc_peripheral_t dev, gpio_id_t gpio_id );
 uint32_t gpio_read_pin( soc_peripheral_t dev, gpio_id_t gpio_id, int pin );
 
+/* Reads port gpio_ids[i] into values[i] for each of count ports, in one call */
+int gpio_read_multi( soc_peripheral_t dev, const gpio_id_t *gpio_ids, uint32_t *values, int count );
+
 /* Free port */
 void gpio_free( soc_peripheral_t dev, gpio_id_t gpio_id );
 
@@ -34,4 +55,38 @@ int gpio_irq_setup( soc_peripheral_t dev, gpio_id_t gpio_id );
 int gpio_irq_enable( soc_peripheral_t dev, gpio_id_t gpio_id );
 int gpio_irq_disable( soc_peripheral_t dev, gpio_id_t gpio_id );
 
+/*
+ * GPIO event support. Once events are enabled on a port, each change
+ * to it is queued with its value and a timestamp into the DMA RX ring,
+ * and changes that happen together arrive in one buffer, with a single
+ * DMA RX done interrupt. The port does not need to be read to rearm
+ * it. gpio_irq_disable() stops its events.
+ *
+ * gpio_events_get() may be called from the ISR, or from a bottom half
+ * that it queues with rtos_bh_queue(), to get the events received, up
+ * to max, which must be at least GPIOCONF_EVENT_BATCH_MAX. It returns
+ * the number of events got, and gives their buffers back to the device.
+ */
+int gpio_event_enable( soc_peripheral_t dev, gpio_id_t gpio_id );
+int gpio_events_get( soc_peripheral_t dev, gpio_event_t *events, int max );
+
+/*
+ * GPIO waveform support. A waveform is run by the device from its own
+ * timer, so each step costs the RTOS nothing. Only the pins in mask
+ * are driven; the others keep their values. Each step is output for
+ * its ticks, and the steps are repeated until they have been run
+ * through repeat times, or forever if repeat is 0. The pins are then
+ * left at the value of the last step. Starting a waveform on wave_id
+ * replaces the one already running on it. wave_id must be less than
+ * GPIOCONF_WAVE_COUNT.
+ *
+ * gpio_pwm_start() runs a waveform that drives one pin high for
+ * high_ticks of every period_ticks.
+ */
+int gpio_wave_start( soc_peripheral_t dev, int wave_id, gpio_id_t gpio_id, uint32_t mask,
+                     const gpio_wave_step_t *steps, int step_count, int repeat );
+int gpio_pwm_start( soc_peripheral_t dev, int wave_id, gpio_id_t gpio_id, int pin,
+                    uint32_t period_ticks, uint32_t high_ticks );
+int gpio_wave_stop( soc_peripheral_t dev, int wave_id );
+
 #endif /* GPIO_DRIVER_H_ */
@@ -42,4 +42,24 @@ typedef enum {
     gpio_32B
 } gpio_id_t;
 
+/*
+ * A change seen on a port that has events enabled. timestamp is the
+ * reference time it was seen at. gpio_id is a gpio_id_t, held in a
+ * word so that arrays of events have no padding.
+ */
+typedef struct {
+    uint32_t gpio_id;
+    uint32_t value;
+    uint32_t timestamp;
+} gpio_event_t;
+
+/*
+ * One step of a waveform. The pins of the waveform's mask are set to
+ * value for ticks reference clock ticks, which must not be zero.
+ */
+typedef struct {
+    uint32_t value;
+    uint32_t ticks;
+} gpio_wave_step_t;
+
 #endif /* GPIO_PORT_MAP_H_ */
@@ -22,23 +22,19 @@ i2c_res_t i2c_driver_write(
     i2c_res_t res;
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
-    soc_peripheral_function_code_tx(c, I2C_DEV_WRITE);
+    soc_bsp_ctrl_lock(dev);
 
-    soc_peripheral_varlist_tx(
-            c, 3,
+    soc_peripheral_control_call(
+            c, I2C_DEV_WRITE, 4, 2,
             sizeof(device_addr), &device_addr,
             sizeof(n), &n,
-            sizeof(send_stop_bit), &send_stop_bit);
-
-    soc_peripheral_varlist_tx(
-            c, 1,
-            n, buf);
-
-    soc_peripheral_varlist_rx(
-            c, 2,
+            sizeof(send_stop_bit), &send_stop_bit,
+            n, buf,
             sizeof(size_t), num_bytes_sent,
             sizeof(res), &res);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return res;
 }
 
@@ -52,19 +48,18 @@ i2c_res_t i2c_driver_read(
     i2c_res_t res;
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
-    soc_peripheral_function_code_tx(c, I2C_DEV_READ);
+    soc_bsp_ctrl_lock(dev);
 
-    soc_peripheral_varlist_tx(
-            c, 3,
+    soc_peripheral_control_call(
+            c, I2C_DEV_READ, 3, 2,
             sizeof(device_addr), &device_addr,
             sizeof(n), &n,
-            sizeof(send_stop_bit), &send_stop_bit);
-
-    soc_peripheral_varlist_rx(
-            c, 2,
+            sizeof(send_stop_bit), &send_stop_bit,
             n, buf,
             sizeof(res), &res);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return res;
 }
 
@@ -77,18 +72,17 @@ i2c_regop_res_t i2c_driver_write_reg(
     i2c_regop_res_t res;
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
-    soc_peripheral_function_code_tx(c, I2C_DEV_WRITE_REG);
+    soc_bsp_ctrl_lock(dev);
 
-    soc_peripheral_varlist_tx(
-            c, 3,
+    soc_peripheral_control_call(
+            c, I2C_DEV_WRITE_REG, 3, 1,
             sizeof(device_addr), &device_addr,
             sizeof(reg), &reg,
-            sizeof(data), &data);
-
-    soc_peripheral_varlist_rx(
-            c, 1,
+            sizeof(data), &data,
             sizeof(res), &res);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return res;
 }
 
@@ -101,18 +95,107 @@ uint8_t i2c_driver_read_reg(
     uint8_t data;
     chanend c = soc_peripheral_ctrl_chanend(dev);
 
-    soc_peripheral_function_code_tx(c, I2C_DEV_READ_REG);
+    soc_bsp_ctrl_lock(dev);
 
-    soc_peripheral_varlist_tx(
-            c, 2,
+    soc_peripheral_control_call(
+            c, I2C_DEV_READ_REG, 2, 2,
+            sizeof(device_addr), &device_addr,
+            sizeof(reg), &reg,
+            sizeof(i2c_regop_res_t), result,
+            sizeof(data), &data);
+
+    soc_bsp_ctrl_unlock(dev);
+
+    return data;
+}
+
+int i2c_driver_batch(
+        soc_peripheral_t dev,
+        i2c_op_t ops[],
+        size_t n)
+{
+    int failed;
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    xassert(n > 0 && n <= I2CCONF_MAX_BATCH_LEN);
+
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_control_call(
+            c, I2C_DEV_BATCH, 2, 2,
+            sizeof(n), &n,
+            n * sizeof(i2c_op_t), ops,
+            n * sizeof(i2c_op_t), ops,
+            sizeof(failed), &failed);
+
+    soc_bsp_ctrl_unlock(dev);
+
+    return failed;
+}
+
+void i2c_driver_write_reg_submit(
+        soc_peripheral_t dev,
+        uint8_t device_addr,
+        uint8_t reg,
+        uint8_t data)
+{
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    /* Held until the result has been got */
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_control_submit(
+            c, I2C_DEV_WRITE_REG, 3,
+            sizeof(device_addr), &device_addr,
+            sizeof(reg), &reg,
+            sizeof(data), &data);
+}
+
+i2c_regop_res_t i2c_driver_write_reg_result(
+        soc_peripheral_t dev)
+{
+    i2c_regop_res_t res;
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    soc_peripheral_control_result_rx(
+            c, 1,
+            sizeof(res), &res);
+
+    soc_bsp_ctrl_unlock(dev);
+
+    return res;
+}
+
+void i2c_driver_read_reg_submit(
+        soc_peripheral_t dev,
+        uint8_t device_addr,
+        uint8_t reg)
+{
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    /* Held until the result has been got */
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_control_submit(
+            c, I2C_DEV_READ_REG, 2,
             sizeof(device_addr), &device_addr,
             sizeof(reg), &reg);
+}
 
-    soc_peripheral_varlist_rx(
+uint8_t i2c_driver_read_reg_result(
+        soc_peripheral_t dev,
+        i2c_regop_res_t *result)
+{
+    uint8_t data;
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    soc_peripheral_control_result_rx(
             c, 2,
             sizeof(i2c_regop_res_t), result,
             sizeof(data), &data);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return data;
 }
 
@@ -125,5 +208,7 @@ soc_peripheral_t i2c_driver_init(
 
     device = bitstream_i2c_devices[device_id];
 
+    soc_bsp_ctrl_lock_init(device);
+
     return device;
 }
@@ -4,6 +4,7 @@
 #define I2C_DRIVER_H_
 
 #include "soc.h"
+#include "i2c_dev_conf_defaults.h"
 #include "i2c_dev_ctrl.h"
 
 typedef enum {
@@ -44,6 +45,50 @@ uint8_t i2c_driver_read_reg(
         uint8_t reg,
         i2c_regop_res_t *result);
 
+/*
+ * Runs n register writes, register reads and delays back to back in a
+ * single call to the device, which may be up to I2CCONF_MAX_BATCH_LEN.
+ * Every operation is run even if one before it fails. Each has its
+ * result set, and each read its data. Returns the number of operations
+ * that failed.
+ */
+int i2c_driver_batch(
+        soc_peripheral_t dev,
+        i2c_op_t ops[],
+        size_t n);
+
+/*
+ * Asynchronous versions of i2c_driver_write_reg() and
+ * i2c_driver_read_reg(), that do not hold the calling core while the
+ * I2C transfer takes place. The device must have been given an IRQ
+ * channel, and an ISR registered for it with
+ * soc_peripheral_handler_register().
+ *
+ * The submit function returns straight away. Once the ISR is sent
+ * SOC_PERIPHERAL_ISR_CONTROL_DONE_BM, the matching result function
+ * must be called to get the outcome. Only one operation may be
+ * outstanding on the device at a time. The device's control lock is
+ * held from the submit until the result has been got, so both must be
+ * called by the same task, and any other task's calls wait until then.
+ */
+void i2c_driver_write_reg_submit(
+        soc_peripheral_t dev,
+        uint8_t device_addr,
+        uint8_t reg,
+        uint8_t data);
+
+i2c_regop_res_t i2c_driver_write_reg_result(
+        soc_peripheral_t dev);
+
+void i2c_driver_read_reg_submit(
+        soc_peripheral_t dev,
+        uint8_t device_addr,
+        uint8_t reg);
+
+uint8_t i2c_driver_read_reg_result(
+        soc_peripheral_t dev,
+        i2c_regop_res_t *result);
+
 soc_peripheral_t i2c_driver_init(
         int device_id);
 
@@ -0,0 +1,185 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "soc.h"
+#include "xassert.h"
+
+#include "i2c_regmap.h"
+
+#define REG_KNOWN     0x01
+#define REG_VOLATILE  0x02
+
+static int reg_index(
+        i2c_regmap_t *map,
+        uint8_t reg)
+{
+    int i = reg - map->first_reg;
+
+    xassert(i >= 0 && i < map->reg_count);
+
+    return i;
+}
+
+/*
+ * Makes the queued operations. The shadow already holds the value of
+ * each register written, so a register whose write failed is
+ * forgotten instead.
+ */
+static void ops_run(
+        i2c_regmap_t *map)
+{
+    if (map->op_count == 0) {
+        return;
+    }
+
+    map->failed += i2c_driver_batch(map->dev, map->ops, map->op_count);
+
+    for (int i = 0; i < map->op_count; i++) {
+        if (map->ops[i].type == I2C_OP_WRITE_REG && map->ops[i].result != I2C_REGOP_SUCCESS) {
+            map->flags[reg_index(map, map->ops[i].reg)] &= ~REG_KNOWN;
+        }
+    }
+
+    map->op_count = 0;
+}
+
+static void op_queue(
+        i2c_regmap_t *map,
+        const i2c_op_t *op)
+{
+    if (map->op_count == I2CCONF_MAX_BATCH_LEN) {
+        ops_run(map);
+    }
+
+    map->ops[map->op_count++] = *op;
+}
+
+void i2c_regmap_init(
+        i2c_regmap_t *map,
+        soc_peripheral_t dev,
+        uint8_t device_addr,
+        uint8_t first_reg,
+        int reg_count,
+        void *mem)
+{
+    xassert(reg_count > 0 && first_reg + reg_count <= 256);
+
+    map->dev = dev;
+    map->device_addr = device_addr;
+    map->first_reg = first_reg;
+    map->reg_count = reg_count;
+    map->values = mem;
+    map->flags = map->values + reg_count;
+    map->failed = 0;
+    map->op_count = 0;
+
+    memset(mem, 0, I2C_REGMAP_MEM_SIZE(reg_count));
+}
+
+void i2c_regmap_seed(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t value)
+{
+    int i = reg_index(map, reg);
+
+    map->values[i] = value;
+    map->flags[i] |= REG_KNOWN;
+}
+
+void i2c_regmap_volatile_set(
+        i2c_regmap_t *map,
+        uint8_t reg)
+{
+    map->flags[reg_index(map, reg)] |= REG_VOLATILE;
+}
+
+void i2c_regmap_invalidate(
+        i2c_regmap_t *map)
+{
+    for (int i = 0; i < map->reg_count; i++) {
+        map->flags[i] &= ~REG_KNOWN;
+    }
+}
+
+i2c_regop_res_t i2c_regmap_read(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t *value)
+{
+    int i = reg_index(map, reg);
+    i2c_regop_res_t res;
+
+    if ((map->flags[i] & (REG_KNOWN | REG_VOLATILE)) == REG_KNOWN) {
+        *value = map->values[i];
+        return I2C_REGOP_SUCCESS;
+    }
+
+    ops_run(map);
+
+    *value = i2c_driver_read_reg(map->dev, map->device_addr, reg, &res);
+    if (res == I2C_REGOP_SUCCESS) {
+        map->values[i] = *value;
+        map->flags[i] |= REG_KNOWN;
+    }
+
+    return res;
+}
+
+void i2c_regmap_write(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t value)
+{
+    int i = reg_index(map, reg);
+    const i2c_op_t op = I2C_OP_WRITE(map->device_addr, reg, value);
+
+    if ((map->flags[i] & (REG_KNOWN | REG_VOLATILE)) == REG_KNOWN && map->values[i] == value) {
+        return;
+    }
+
+    map->values[i] = value;
+    map->flags[i] |= REG_KNOWN;
+
+    op_queue(map, &op);
+}
+
+i2c_regop_res_t i2c_regmap_update_bits(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t mask,
+        uint8_t value)
+{
+    uint8_t old;
+    i2c_regop_res_t res;
+
+    res = i2c_regmap_read(map, reg, &old);
+    if (res == I2C_REGOP_SUCCESS) {
+        i2c_regmap_write(map, reg, (old & ~mask) | (value & mask));
+    }
+
+    return res;
+}
+
+void i2c_regmap_delay(
+        i2c_regmap_t *map,
+        uint16_t delay_us)
+{
+    const i2c_op_t op = I2C_OP_WAIT(delay_us);
+
+    op_queue(map, &op);
+}
+
+int i2c_regmap_flush(
+        i2c_regmap_t *map)
+{
+    int failed;
+
+    ops_run(map);
+
+    failed = map->failed;
+    map->failed = 0;
+
+    return failed;
+}
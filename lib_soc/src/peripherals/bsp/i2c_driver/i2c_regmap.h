@@ -0,0 +1,131 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef I2C_REGMAP_H_
+#define I2C_REGMAP_H_
+
+#include "soc.h"
+#include "i2c_driver.h"
+
+/*
+ * A shadow copy, held locally, of a range of an I2C device's 8 bit
+ * registers, so that register reads and read-modify-writes do not
+ * each need a call to the I2C device.
+ *
+ * A register is read from the device the first time it is read, and
+ * then served from the shadow. Writes update the shadow and are queued
+ * rather than made straight away. A write of the value the shadow
+ * already holds is dropped. The queued writes are made together, in
+ * the order they were queued, by a single i2c_driver_batch() call when
+ * the map is flushed, or when the queue fills. A register whose write
+ * fails is forgotten, so that it is read from the device again.
+ *
+ * Registers that the device changes itself, such as status registers,
+ * should be marked volatile, so that they are always read from the
+ * device and their writes are never dropped.
+ *
+ * A map is not safe to use from more than one task at a time without
+ * a lock around it.
+ */
+
+typedef struct {
+    soc_peripheral_t dev;
+    uint8_t device_addr;
+    uint8_t first_reg;
+    int reg_count;
+    uint8_t *values;
+    uint8_t *flags;
+    int failed;
+    int op_count;
+    i2c_op_t ops[I2CCONF_MAX_BATCH_LEN];
+} i2c_regmap_t;
+
+/*
+ * The number of bytes of memory that must be given to i2c_regmap_init()
+ * for reg_count registers.
+ */
+#define I2C_REGMAP_MEM_SIZE(reg_count) (2 * (reg_count))
+
+/*
+ * Initializes a map of the reg_count registers of the device at
+ * device_addr starting at first_reg, kept in mem, which must be at
+ * least I2C_REGMAP_MEM_SIZE(reg_count) bytes. No register is known
+ * until it is read, written or seeded.
+ */
+void i2c_regmap_init(
+        i2c_regmap_t *map,
+        soc_peripheral_t dev,
+        uint8_t device_addr,
+        uint8_t first_reg,
+        int reg_count,
+        void *mem);
+
+/*
+ * Sets the value the shadow holds for reg, without any I2C transfer,
+ * such as to the register's value after the device is reset.
+ */
+void i2c_regmap_seed(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t value);
+
+/*
+ * Marks reg as volatile, so that it is never served from the shadow.
+ */
+void i2c_regmap_volatile_set(
+        i2c_regmap_t *map,
+        uint8_t reg);
+
+/*
+ * Forgets every register, such as after the device has been reset
+ * other than by a write through the map. Queued writes are kept.
+ */
+void i2c_regmap_invalidate(
+        i2c_regmap_t *map);
+
+/*
+ * Gets the value of reg, from the shadow if it is known. Otherwise
+ * the queued writes are first made, so that the device is read after
+ * them, and it is then read from the device.
+ */
+i2c_regop_res_t i2c_regmap_read(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t *value);
+
+/*
+ * Queues a write of value to reg, unless the shadow already holds it.
+ */
+void i2c_regmap_write(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t value);
+
+/*
+ * Queues a write of reg with the bits in mask set to those of value
+ * and the rest unchanged. The register is read first if it is not
+ * known.
+ */
+i2c_regop_res_t i2c_regmap_update_bits(
+        i2c_regmap_t *map,
+        uint8_t reg,
+        uint8_t mask,
+        uint8_t value);
+
+/*
+ * Queues a delay of delay_us microseconds between the queued writes
+ * either side of it, such as for a device to settle after it is
+ * powered up.
+ */
+void i2c_regmap_delay(
+        i2c_regmap_t *map,
+        uint16_t delay_us);
+
+/*
+ * Makes the queued writes. Returns the number of writes that have
+ * failed since the last flush, including any made when the queue
+ * filled.
+ */
+int i2c_regmap_flush(
+        i2c_regmap_t *map);
+
+#endif /* I2C_REGMAP_H_ */
@@ -33,5 +33,7 @@ soc_peripheral_t i2s_driver_init(
             isr_core,
             isr);
 
+    soc_peripheral_irq_priority_set(device, SOC_I2S_IRQ_PRIORITY);
+
     return device;
 }
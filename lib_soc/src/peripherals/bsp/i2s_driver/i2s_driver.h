@@ -4,6 +4,28 @@
 #define I2S_DRIVER_H_
 
 #include "soc.h"
+#include "i2s_dev_conf_defaults.h"
+
+/*
+ * The type of each sample in the frames sent to the I2S device. Each
+ * frame holds I2SCONF_AUDIO_FRAME_LEN samples of each of the
+ * I2SCONF_CHANNELS channels, interleaved.
+ */
+#if I2SCONF_WORD_LENGTH_SHORT
+typedef int16_t i2s_sample_t;
+#else
+typedef int32_t i2s_sample_t;
+#endif
+
+/*
+ * The size in bytes of each frame captured by the I2S device when
+ * I2SCONF_RX_CHANNELS is non-zero. Each holds I2SCONF_RX_FRAME_LEN
+ * samples of each of the I2SCONF_RX_CHANNELS channels, interleaved,
+ * and arrives in the RX ring as one buffer, so rx_buf_size given to
+ * i2s_driver_init() must be at least this.
+ */
+#define I2S_DRIVER_RX_FRAME_SIZE \
+    (I2SCONF_RX_FRAME_LEN * I2SCONF_RX_CHANNELS * sizeof(i2s_sample_t))
 
 soc_peripheral_t i2s_driver_init(
         int device_id,
@@ -0,0 +1,88 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "soc.h"
+#include "soc_bsp_common.h"
+#include "bitstream_devices.h"
+
+#include "intertile_driver.h"
+
+#if ( SOC_INTERTILE_PERIPHERAL_USED == 0 )
+#define BITSTREAM_INTERTILE_DEVICE_COUNT 0
+soc_peripheral_t bitstream_intertile_devices[BITSTREAM_INTERTILE_DEVICE_COUNT];
+#endif /* SOC_INTERTILE_PERIPHERAL_USED */
+
+soc_peripheral_t intertile_driver_init(
+        int device_id,
+        int rx_desc_count,
+        int rx_buf_size,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr)
+{
+    soc_peripheral_t device;
+
+    xassert(device_id >= 0 && device_id < BITSTREAM_INTERTILE_DEVICE_COUNT);
+
+    device = bitstream_intertile_devices[device_id];
+
+    soc_peripheral_common_dma_init(
+            device,
+            rx_desc_count,
+            rx_buf_size,
+            tx_desc_count,
+            app_data,
+            isr_core,
+            isr);
+
+    if (rx_desc_count > 0 && rx_buf_size > 0) {
+        soc_peripheral_hub_dma_request(device, SOC_DMA_RX_REQUEST);
+    }
+
+    return device;
+}
+
+int intertile_driver_send(
+        soc_peripheral_t dev,
+        void *buf,
+        size_t len)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+
+    xassert(len <= INTERTILECONF_MAX_BUF_LEN);
+
+    if (soc_dma_ring_tx_buf_try_set(tx_ring_buf, buf, len) != 0) {
+        return -1;
+    }
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+
+    return 0;
+}
+
+void *intertile_driver_send_done_get(
+        soc_peripheral_t dev)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+
+    return soc_dma_ring_tx_buf_get(tx_ring_buf, NULL, NULL);
+}
+
+void *intertile_driver_receive(
+        soc_peripheral_t dev,
+        int *len)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+
+    return soc_dma_ring_rx_buf_get(rx_ring_buf, len);
+}
+
+void intertile_driver_receive_buf_set(
+        soc_peripheral_t dev,
+        void *buf,
+        size_t len)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+
+    soc_dma_ring_rx_buf_set(rx_ring_buf, buf, len);
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_RX_REQUEST);
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef INTERTILE_DRIVER_H_
+#define INTERTILE_DRIVER_H_
+
+#include "soc.h"
+#include "intertile_dev_conf_defaults.h"
+
+/*
+ * Initializes this RTOS's end of an intertile DMA link, carried by
+ * intertile_dev() in the bitstream. rx_desc_count buffers of rx_buf_size
+ * bytes are given to the RX ring, and to the hub, up front. The ISR is sent
+ * SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM for each buffer received from the
+ * other end, and SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM as each buffer sent
+ * is taken by it.
+ */
+soc_peripheral_t intertile_driver_init(
+        int device_id,
+        int rx_desc_count,
+        int rx_buf_size,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr);
+
+/*
+ * Queues buf to be sent to the other end of the link and returns
+ * straight away. buf must not be modified until it is given back by
+ * intertile_driver_send_done_get(). Several sends may be in flight at
+ * once, up to the number of TX descriptors. Returns 0 if the buffer
+ * was queued, or -1 if the TX ring is full.
+ */
+int intertile_driver_send(
+        soc_peripheral_t dev,
+        void *buf,
+        size_t len);
+
+/*
+ * Returns the next buffer that has been sent, so that it may be
+ * reused or freed, or NULL if there is none.
+ */
+void *intertile_driver_send_done_get(
+        soc_peripheral_t dev);
+
+/*
+ * Returns the next buffer received from the other end of the link, and
+ * its length in *len, or NULL if there is none. Once the application
+ * is done with it, it must be given back, or replaced by another buffer
+ * of rx_buf_size bytes, with intertile_driver_receive_buf_set().
+ */
+void *intertile_driver_receive(
+        soc_peripheral_t dev,
+        int *len);
+
+void intertile_driver_receive_buf_set(
+        soc_peripheral_t dev,
+        void *buf,
+        size_t len);
+
+#endif /* INTERTILE_DRIVER_H_ */
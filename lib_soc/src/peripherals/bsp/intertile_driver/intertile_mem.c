@@ -0,0 +1,575 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "soc.h"
+#include "soc_bsp_common.h"
+
+#include "intertile_mem.h"
+
+#include "xassert.h"
+
+#define OP_READ  0
+#define OP_WRITE 1
+
+#define SLOT_FREE      0
+#define SLOT_READING   1
+#define SLOT_VALID     2
+#define SLOT_FAILED    3
+#define SLOT_COMBINING 4
+#define SLOT_WRITING   5
+
+#define BLOCK_SIZE INTERTILECONF_MEM_BLOCK_SIZE
+#define SLOTS      INTERTILECONF_MEM_SLOTS
+
+RTOS_IRQ_ISR_ATTR
+static int intertile_mem_isr(soc_peripheral_t device)
+{
+    return soc_bsp_ring_owner_notify_from_isr(device, soc_peripheral_interrupt_status(device));
+}
+
+/*
+ * Sets up the calling task's end of the link. The RX ring is given the
+ * buffers in rx_buf, and the calling task is made the owner of both
+ * rings, so that it sleeps while it waits on them.
+ */
+static soc_peripheral_t link_init(
+        int device_id,
+        intertile_mem_msg_t rx_buf[SLOTS],
+        int isr_core)
+{
+    soc_peripheral_t dev;
+    int i;
+
+    xassert(sizeof(intertile_mem_msg_t) <= INTERTILECONF_MAX_BUF_LEN);
+
+    dev = intertile_driver_init(
+            device_id,
+            SLOTS,
+            0,
+            SLOTS,
+            NULL,
+            isr_core,
+            (rtos_irq_isr_t) intertile_mem_isr);
+
+    soc_peripheral_common_dma_open(dev);
+    soc_bsp_ring_owner_set(dev, SOC_DMA_TX_REQUEST);
+    soc_bsp_ring_owner_set(dev, SOC_DMA_RX_REQUEST);
+
+    for (i = 0; i < SLOTS; i++) {
+        intertile_driver_receive_buf_set(dev, &rx_buf[i], sizeof(rx_buf[i]));
+    }
+
+    return dev;
+}
+
+/*
+ * Sends a message, waiting for the other end to take an earlier one if
+ * the TX ring is full. The buffers it takes are not needed back, as each
+ * end knows from the messages it receives when a buffer is free again.
+ */
+static void msg_send(
+        soc_peripheral_t dev,
+        intertile_mem_msg_t *msg,
+        size_t len)
+{
+    void *done[SLOTS];
+
+    while (intertile_driver_send(dev, msg, len) != 0) {
+        soc_bsp_tx_ring_wait(dev, done, NULL, NULL, SLOTS, SOC_BSP_WAIT_FOREVER);
+    }
+}
+
+static void msg_hdr_set(
+        intertile_mem_msg_t *msg,
+        int op,
+        int window,
+        int slot,
+        uint32_t offset,
+        uint32_t length)
+{
+    msg->hdr.op = op;
+    msg->hdr.window = window;
+    msg->hdr.slot = slot;
+    msg->hdr.status = 0;
+    msg->hdr.offset = offset;
+    msg->hdr.length = length;
+}
+
+/* Server */
+
+void intertile_mem_server_init(
+        intertile_mem_server_t *srv,
+        int device_id,
+        int isr_core)
+{
+    memset(srv, 0, sizeof(*srv));
+    srv->dev = link_init(device_id, srv->rx_buf, isr_core);
+}
+
+void intertile_mem_server_window_add(
+        intertile_mem_server_t *srv,
+        int window_id,
+        void *base,
+        size_t size,
+        int writable)
+{
+    xassert(window_id >= 0 && window_id < INTERTILE_MEM_MAX_WINDOWS);
+    xassert(base != NULL);
+
+    srv->window[window_id].size = size;
+    srv->window[window_id].writable = writable;
+    srv->window[window_id].base = base;
+}
+
+/*
+ * Returns the next reply buffer. They are used in turn, and the DMA
+ * finishes with them in the same order, so the one returned is free
+ * once fewer than SLOTS are in flight.
+ */
+static intertile_mem_msg_t *reply_buf_get(
+        intertile_mem_server_t *srv)
+{
+    intertile_mem_msg_t *reply;
+    void *done[SLOTS];
+
+    srv->tx_in_flight -= soc_bsp_tx_ring_wait(
+            srv->dev, done, NULL, NULL, SLOTS,
+            srv->tx_in_flight < SLOTS ? 0 : SOC_BSP_WAIT_FOREVER);
+
+    reply = &srv->tx_buf[srv->tx_next];
+    srv->tx_next = (srv->tx_next + 1) % SLOTS;
+    srv->tx_in_flight++;
+
+    return reply;
+}
+
+static void request_handle(
+        intertile_mem_server_t *srv,
+        intertile_mem_msg_t *req,
+        int length)
+{
+    intertile_mem_msg_t *reply = reply_buf_get(srv);
+    intertile_mem_window_t *w = NULL;
+    size_t reply_len = sizeof(reply->hdr);
+    uint32_t offset = req->hdr.offset;
+    uint32_t n = 0;
+
+    reply->hdr = req->hdr;
+    reply->hdr.status = -1;
+
+    if (length >= sizeof(req->hdr) && req->hdr.window < INTERTILE_MEM_MAX_WINDOWS) {
+        w = &srv->window[req->hdr.window];
+    }
+
+    if (w != NULL && w->base != NULL && offset < w->size) {
+        n = req->hdr.length;
+        if (n > w->size - offset) {
+            n = w->size - offset;
+        }
+
+        if (req->hdr.op == OP_READ && n <= sizeof(reply->data)) {
+            /* A read of a block that runs past the end of the window gets what there is */
+            memcpy(reply->data, (uint8_t *) w->base + offset, n);
+            reply->hdr.length = n;
+            reply->hdr.status = 0;
+            reply_len += n;
+        } else if (req->hdr.op == OP_WRITE && w->writable &&
+                   n == req->hdr.length && length >= sizeof(req->hdr) + n) {
+            memcpy((uint8_t *) w->base + offset, req->data, n);
+            reply->hdr.status = 0;
+        }
+    }
+
+    msg_send(srv->dev, reply, reply_len);
+}
+
+void intertile_mem_server_run(
+        intertile_mem_server_t *srv)
+{
+    void *bufs[SLOTS];
+    int lengths[SLOTS];
+    int count;
+    int i;
+
+    for (;;) {
+        count = soc_bsp_rx_ring_wait(srv->dev, bufs, lengths, SLOTS, SOC_BSP_WAIT_FOREVER);
+
+        for (i = 0; i < count; i++) {
+            request_handle(srv, bufs[i], lengths[i]);
+            intertile_driver_receive_buf_set(srv->dev, bufs[i], sizeof(intertile_mem_msg_t));
+        }
+    }
+}
+
+/* Client */
+
+void intertile_mem_client_init(
+        intertile_mem_client_t *cli,
+        int device_id,
+        int isr_core)
+{
+    memset(cli, 0, sizeof(*cli));
+    cli->dev = link_init(device_id, cli->rx_buf, isr_core);
+}
+
+/*
+ * Handles the replies from the server, waiting up to timeout_ticks for
+ * the first. This must only wait when a read or write is in flight.
+ */
+static void replies_handle(
+        intertile_mem_client_t *cli,
+        uint32_t timeout_ticks)
+{
+    void *bufs[SLOTS];
+    int lengths[SLOTS];
+    int count;
+    int i;
+
+    count = soc_bsp_rx_ring_wait(cli->dev, bufs, lengths, SLOTS, timeout_ticks);
+
+    for (i = 0; i < count; i++) {
+        intertile_mem_msg_t *reply = bufs[i];
+        intertile_mem_slot_t *s;
+
+        xassert(reply->hdr.slot < SLOTS);
+        s = &cli->slot[reply->hdr.slot];
+
+        if (reply->hdr.op == OP_READ) {
+            xassert(s->state == SLOT_READING);
+            if (reply->hdr.status == 0) {
+                memcpy(s->msg.data, reply->data, reply->hdr.length);
+                s->start = 0;
+                s->length = reply->hdr.length;
+                s->state = SLOT_VALID;
+            } else {
+                s->state = SLOT_FAILED;
+            }
+        } else {
+            xassert(s->state == SLOT_WRITING);
+            if (reply->hdr.status != 0) {
+                cli->error = 1;
+            }
+            s->state = SLOT_FREE;
+        }
+
+        intertile_driver_receive_buf_set(cli->dev, reply, sizeof(intertile_mem_msg_t));
+    }
+}
+
+/* Returns the slot that holds, or is reading, a block, or NULL */
+static intertile_mem_slot_t *slot_find(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t block)
+{
+    int i;
+
+    for (i = 0; i < SLOTS; i++) {
+        intertile_mem_slot_t *s = &cli->slot[i];
+
+        if ((s->state == SLOT_READING || s->state == SLOT_VALID) &&
+                s->window == window && s->block == block) {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Returns a free slot, or else the least recently used cached block,
+ * other than blocks first to last of window. Returns NULL if every slot
+ * is in use. window may be -1 to allow any cached block to be evicted.
+ */
+static intertile_mem_slot_t *slot_alloc(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t first,
+        uint32_t last)
+{
+    intertile_mem_slot_t *lru = NULL;
+    int i;
+
+    for (i = 0; i < SLOTS; i++) {
+        intertile_mem_slot_t *s = &cli->slot[i];
+
+        if (s->state == SLOT_FREE || s->state == SLOT_FAILED) {
+            return s;
+        }
+        if (s->state == SLOT_VALID &&
+                !(s->window == window && s->block >= first && s->block <= last) &&
+                (lru == NULL || (int32_t) (s->last_used - lru->last_used) < 0)) {
+            lru = s;
+        }
+    }
+
+    return lru;
+}
+
+/*
+ * Asks the server for a block, unless it is already cached or being
+ * read. Returns its slot, or NULL if slot_alloc() finds none.
+ */
+static intertile_mem_slot_t *block_request(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t block,
+        int protect_window,
+        uint32_t first,
+        uint32_t last)
+{
+    intertile_mem_slot_t *s;
+
+    s = slot_find(cli, window, block);
+    if (s != NULL) {
+        return s;
+    }
+
+    s = slot_alloc(cli, protect_window, first, last);
+    if (s == NULL) {
+        return NULL;
+    }
+
+    s->state = SLOT_READING;
+    s->window = window;
+    s->block = block;
+    s->last_used = ++cli->use_count;
+
+    /*
+     * The request is sent from the slot's own buffer. The reply only
+     * comes once the request has been taken, so it may be written over.
+     */
+    msg_hdr_set(&s->msg, OP_READ, window, s - cli->slot, block * BLOCK_SIZE, BLOCK_SIZE);
+    msg_send(cli->dev, &s->msg, sizeof(s->msg.hdr));
+
+    return s;
+}
+
+static void combining_flush(
+        intertile_mem_client_t *cli)
+{
+    intertile_mem_slot_t *c = cli->combining;
+
+    if (c == NULL) {
+        return;
+    }
+
+    cli->combining = NULL;
+    c->state = SLOT_WRITING;
+
+    msg_hdr_set(&c->msg, OP_WRITE, c->window, c - cli->slot, c->block * BLOCK_SIZE + c->start, c->length);
+    msg_send(cli->dev, &c->msg, sizeof(c->msg.hdr) + c->length);
+}
+
+int intertile_mem_read(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t offset,
+        void *buf,
+        size_t len)
+{
+    uint8_t *dst = buf;
+    uint32_t first;
+    uint32_t last;
+    uint32_t block;
+    uint32_t ahead;
+    int ret = 0;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    /* So that the read sees the writes before it */
+    combining_flush(cli);
+
+    first = offset / BLOCK_SIZE;
+    last = (offset + len - 1) / BLOCK_SIZE;
+
+    for (block = first; block <= last; block++) {
+        intertile_mem_slot_t *s;
+        uint32_t start = (block == first) ? offset % BLOCK_SIZE : 0;
+        size_t n = BLOCK_SIZE - start;
+
+        if (n > len) {
+            n = len;
+        }
+
+        /*
+         * Every slot is busy with a read or write when none can be
+         * had, so there is always a reply to wait for.
+         */
+        while ((s = block_request(cli, window, block, -1, 0, 0)) == NULL) {
+            replies_handle(cli, SOC_BSP_WAIT_FOREVER);
+        }
+
+        /*
+         * Asks for the blocks that follow before waiting for this one,
+         * without evicting any that this read still needs.
+         */
+        for (ahead = block + 1; ahead <= last && ahead < block + SLOTS; ahead++) {
+            if (block_request(cli, window, ahead, window, block, last) == NULL) {
+                break;
+            }
+        }
+
+        while (s->state == SLOT_READING) {
+            replies_handle(cli, SOC_BSP_WAIT_FOREVER);
+        }
+
+        if (s->state == SLOT_VALID && start + n <= s->length) {
+            memcpy(dst, &s->msg.data[start], n);
+            s->last_used = ++cli->use_count;
+        } else {
+            ret = -1;
+        }
+
+        dst += n;
+        len -= n;
+    }
+
+    return ret;
+}
+
+void intertile_mem_prefetch(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t offset,
+        size_t len)
+{
+    uint32_t first;
+    uint32_t last;
+    uint32_t block;
+
+    if (len == 0) {
+        return;
+    }
+
+    combining_flush(cli);
+
+    first = offset / BLOCK_SIZE;
+    last = (offset + len - 1) / BLOCK_SIZE;
+
+    for (block = first; block <= last; block++) {
+        if (block_request(cli, window, block, window, first, last) == NULL) {
+            break;
+        }
+    }
+
+    /* Takes any replies already in, without waiting */
+    replies_handle(cli, 0);
+}
+
+void intertile_mem_write(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t offset,
+        const void *buf,
+        size_t len)
+{
+    const uint8_t *src = buf;
+
+    while (len > 0) {
+        intertile_mem_slot_t *s;
+        intertile_mem_slot_t *c;
+        uint32_t block = offset / BLOCK_SIZE;
+        uint32_t start = offset % BLOCK_SIZE;
+        size_t n = BLOCK_SIZE - start;
+
+        if (n > len) {
+            n = len;
+        }
+
+        /* Keeps a cached copy of the block up to date */
+        s = slot_find(cli, window, block);
+        if (s != NULL) {
+            while (s->state == SLOT_READING) {
+                replies_handle(cli, SOC_BSP_WAIT_FOREVER);
+            }
+            if (s->state == SLOT_VALID) {
+                if (start + n <= s->length) {
+                    memcpy(&s->msg.data[start], src, n);
+                } else {
+                    s->state = SLOT_FREE;
+                }
+            }
+        }
+
+        c = cli->combining;
+        if (c == NULL || c->window != window || c->block != block || c->start + c->length != start) {
+            combining_flush(cli);
+
+            while ((c = slot_alloc(cli, -1, 0, 0)) == NULL) {
+                replies_handle(cli, SOC_BSP_WAIT_FOREVER);
+            }
+
+            c->state = SLOT_COMBINING;
+            c->window = window;
+            c->block = block;
+            c->start = start;
+            c->length = 0;
+            cli->combining = c;
+        }
+
+        memcpy(&c->msg.data[c->length], src, n);
+        c->length += n;
+
+        if (c->start + c->length == BLOCK_SIZE) {
+            combining_flush(cli);
+        }
+
+        src += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+int intertile_mem_flush(
+        intertile_mem_client_t *cli)
+{
+    int writing;
+    int ret;
+    int i;
+
+    combining_flush(cli);
+
+    do {
+        writing = 0;
+        for (i = 0; i < SLOTS; i++) {
+            if (cli->slot[i].state == SLOT_WRITING) {
+                writing = 1;
+            }
+        }
+        if (writing) {
+            replies_handle(cli, SOC_BSP_WAIT_FOREVER);
+        }
+    } while (writing);
+
+    ret = cli->error ? -1 : 0;
+    cli->error = 0;
+
+    return ret;
+}
+
+void intertile_mem_invalidate(
+        intertile_mem_client_t *cli,
+        int window)
+{
+    int i;
+
+    for (i = 0; i < SLOTS; i++) {
+        intertile_mem_slot_t *s = &cli->slot[i];
+
+        if (window >= 0 && s->window != window) {
+            continue;
+        }
+
+        /* A read in flight may have been served before the change */
+        while (s->state == SLOT_READING) {
+            replies_handle(cli, SOC_BSP_WAIT_FOREVER);
+        }
+        if (s->state == SLOT_VALID || s->state == SLOT_FAILED) {
+            s->state = SLOT_FREE;
+        }
+    }
+}
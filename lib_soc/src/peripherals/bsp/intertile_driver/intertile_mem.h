@@ -0,0 +1,186 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef INTERTILE_MEM_H_
+#define INTERTILE_MEM_H_
+
+#include "soc.h"
+#include "intertile_driver.h"
+
+/*
+ * Remote memory windows, carried over an intertile DMA link, so that a
+ * task on one tile may read and write memory on another, such as SDRAM
+ * or bitstream state, without a message format of its own.
+ *
+ * The tile that holds the memory runs a server, which exports ranges of
+ * it as numbered windows. The other tile's client reads and writes them
+ * by window and offset. Data crosses the link in blocks of
+ * INTERTILECONF_MEM_BLOCK_SIZE bytes:
+ *
+ * - A read of several blocks asks for all of them, up to
+ *   INTERTILECONF_MEM_SLOTS at a time, before waiting for the first,
+ *   so that they cross the link back to back.
+ * - Blocks read are cached by the client until they are evicted or
+ *   invalidated. intertile_mem_prefetch() asks for blocks ahead of time
+ *   without waiting for them.
+ * - Writes to consecutive bytes of the same block are combined and
+ *   sent as one, when the block fills, when a write is made elsewhere,
+ *   before a read, or on intertile_mem_flush().
+ *
+ * The link is in order, so a read always sees the client's own writes.
+ * The client's cache is not told of changes made on the server's tile,
+ * so a window that changes there must be invalidated before it is read
+ * again.
+ *
+ * Each end is used by a single task, which must be the one that calls
+ * its init function, as it is made the owner of the link's DMA rings.
+ */
+
+#if INTERTILECONF_MEM_BLOCK_SIZE & (INTERTILECONF_MEM_BLOCK_SIZE - 1)
+#error INTERTILECONF_MEM_BLOCK_SIZE must be a power of two
+#endif
+
+/* The most windows a server may export */
+#define INTERTILE_MEM_MAX_WINDOWS 8
+
+/* The header at the start of every message */
+typedef struct {
+    uint8_t op;
+    uint8_t window;
+    uint8_t slot;
+    int8_t status;
+    uint32_t offset;
+    uint32_t length;
+} intertile_mem_hdr_t;
+
+typedef struct {
+    intertile_mem_hdr_t hdr;
+    uint8_t data[INTERTILECONF_MEM_BLOCK_SIZE];
+} intertile_mem_msg_t;
+
+typedef struct {
+    int state;
+    int window;
+    uint32_t block;
+    uint32_t last_used;
+    /*
+     * For a cached block, start is 0 and length is the number of its
+     * bytes that are in the window. For combined writes they are the
+     * range of the block that the data in msg is for.
+     */
+    uint32_t start;
+    uint32_t length;
+    intertile_mem_msg_t msg;
+} intertile_mem_slot_t;
+
+typedef struct {
+    soc_peripheral_t dev;
+    uint32_t use_count;
+    int error;
+    /* The slot being filled by combined writes, or NULL */
+    intertile_mem_slot_t *combining;
+    intertile_mem_slot_t slot[INTERTILECONF_MEM_SLOTS];
+    intertile_mem_msg_t rx_buf[INTERTILECONF_MEM_SLOTS];
+} intertile_mem_client_t;
+
+typedef struct {
+    void *base;
+    size_t size;
+    int writable;
+} intertile_mem_window_t;
+
+typedef struct {
+    soc_peripheral_t dev;
+    int tx_next;
+    int tx_in_flight;
+    intertile_mem_window_t window[INTERTILE_MEM_MAX_WINDOWS];
+    intertile_mem_msg_t tx_buf[INTERTILECONF_MEM_SLOTS];
+    intertile_mem_msg_t rx_buf[INTERTILECONF_MEM_SLOTS];
+} intertile_mem_server_t;
+
+/*
+ * Initializes the server end of a link, on intertile device device_id.
+ * No windows are exported until they are added.
+ */
+void intertile_mem_server_init(
+        intertile_mem_server_t *srv,
+        int device_id,
+        int isr_core);
+
+/*
+ * Exports size bytes at base as window window_id. When writable is 0
+ * the client may only read it.
+ */
+void intertile_mem_server_window_add(
+        intertile_mem_server_t *srv,
+        int window_id,
+        void *base,
+        size_t size,
+        int writable);
+
+/*
+ * Serves the client's reads and writes. Never returns.
+ */
+void intertile_mem_server_run(
+        intertile_mem_server_t *srv);
+
+/*
+ * Initializes the client end of a link, on intertile device device_id.
+ */
+void intertile_mem_client_init(
+        intertile_mem_client_t *cli,
+        int device_id,
+        int isr_core);
+
+/*
+ * Reads len bytes at offset in window into buf, from the client's
+ * cache where it can. Returns 0, or -1 if any of it could not be read,
+ * such as when it is outside the window.
+ */
+int intertile_mem_read(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t offset,
+        void *buf,
+        size_t len);
+
+/*
+ * Asks for the blocks holding len bytes at offset in window, without
+ * waiting for them, so that a later read finds them in the cache.
+ * Blocks already cached or asked for are skipped, and so are any that
+ * there is no free slot for.
+ */
+void intertile_mem_prefetch(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t offset,
+        size_t len);
+
+/*
+ * Writes len bytes from buf to offset in window. The data may be held
+ * back to be combined with the writes that follow, so it is only known
+ * to have reached the window after intertile_mem_flush(). Errors are
+ * kept until then.
+ */
+void intertile_mem_write(
+        intertile_mem_client_t *cli,
+        int window,
+        uint32_t offset,
+        const void *buf,
+        size_t len);
+
+/*
+ * Sends any combined writes and waits until every write has been made.
+ * Returns 0, or -1 if any write since the last flush failed.
+ */
+int intertile_mem_flush(
+        intertile_mem_client_t *cli);
+
+/*
+ * Drops every block of window from the client's cache, so that it is
+ * read again from the server. Pass -1 to drop every window.
+ */
+void intertile_mem_invalidate(
+        intertile_mem_client_t *cli,
+        int window);
+
+#endif /* INTERTILE_MEM_H_ */
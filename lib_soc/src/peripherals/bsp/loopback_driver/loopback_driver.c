@@ -0,0 +1,56 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include "soc.h"
+#include "soc_bsp_common.h"
+#include "bitstream_devices.h"
+
+#include "loopback_driver.h"
+
+#if ( SOC_LOOPBACK_PERIPHERAL_USED == 0 )
+#define BITSTREAM_LOOPBACK_DEVICE_COUNT 0
+soc_peripheral_t bitstream_loopback_devices[BITSTREAM_LOOPBACK_DEVICE_COUNT];
+#endif /* SOC_LOOPBACK_PERIPHERAL_USED */
+
+soc_peripheral_t loopback_driver_init(
+        int device_id,
+        int rx_desc_count,
+        int rx_buf_size,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr)
+{
+    soc_peripheral_t device;
+
+    xassert(device_id >= 0 && device_id < BITSTREAM_LOOPBACK_DEVICE_COUNT);
+
+    device = bitstream_loopback_devices[device_id];
+
+    soc_peripheral_common_dma_init(
+            device,
+            rx_desc_count,
+            rx_buf_size,
+            tx_desc_count,
+            app_data,
+            isr_core,
+            isr);
+
+    return device;
+}
+
+void loopback_driver_mode_set(
+        soc_peripheral_t dev,
+        int mode)
+{
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_function_code_tx(c, LOOPBACK_DEV_MODE_SET);
+
+    soc_peripheral_varlist_tx(
+            c, 1,
+            sizeof(mode), &mode);
+
+    soc_bsp_ctrl_unlock(dev);
+}
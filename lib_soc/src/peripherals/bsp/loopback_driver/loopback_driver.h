@@ -0,0 +1,27 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef LOOPBACK_DRIVER_H_
+#define LOOPBACK_DRIVER_H_
+
+#include "soc.h"
+#include "loopback_dev_ctrl.h"
+
+soc_peripheral_t loopback_driver_init(
+        int device_id,
+        int rx_desc_count,
+        int rx_buf_size,
+        int tx_desc_count,
+        void *app_data,
+        int isr_core,
+        rtos_irq_isr_t isr);
+
+/*
+ * Selects whether the loopback device transfers its data over its DMA
+ * channels or straight to its DMA rings. mode is one of
+ * LOOPBACK_DEV_MODE_CHANNEL or LOOPBACK_DEV_MODE_DIRECT.
+ */
+void loopback_driver_mode_set(
+        soc_peripheral_t dev,
+        int mode);
+
+#endif /* LOOPBACK_DRIVER_H_ */
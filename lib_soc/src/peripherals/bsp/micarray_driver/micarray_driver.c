@@ -4,6 +4,8 @@
 #include "soc_bsp_common.h"
 #include "bitstream_devices.h"
 
+#include "micarray_driver.h"
+
 #if ( SOC_MICARRAY_PERIPHERAL_USED == 0 )
 #define BITSTREAM_MICARRAY_DEVICE_COUNT 0
 soc_peripheral_t bitstream_micarray_devices[BITSTREAM_MICARRAY_DEVICE_COUNT];
@@ -33,5 +35,43 @@ soc_peripheral_t micarray_driver_init(
             isr_core,
             isr);
 
+    soc_peripheral_irq_priority_set(device, SOC_MICARRAY_IRQ_PRIORITY);
+
     return device;
 }
+
+void micarray_driver_frame_size_set(
+        soc_peripheral_t dev,
+        unsigned frame_size_log2,
+        int overlap)
+{
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    xassert(frame_size_log2 >= 1 && frame_size_log2 <= MICARRAYCONF_MAX_FRAME_SIZE_LOG2);
+
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_control_call(
+            c, MICARRAY_DEV_FRAME_SIZE_SET, 2, 0,
+            sizeof(frame_size_log2), &frame_size_log2,
+            sizeof(overlap), &overlap);
+
+    soc_bsp_ctrl_unlock(dev);
+}
+
+void micarray_driver_sample_rate_set(
+        soc_peripheral_t dev,
+        unsigned sample_rate)
+{
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+
+    xassert(sample_rate >= MICARRAYCONF_MIN_SAMPLE_RATE);
+
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_control_call(
+            c, MICARRAY_DEV_SAMPLE_RATE_SET, 1, 0,
+            sizeof(sample_rate), &sample_rate);
+
+    soc_bsp_ctrl_unlock(dev);
+}
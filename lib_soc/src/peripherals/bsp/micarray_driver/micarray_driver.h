@@ -4,6 +4,17 @@
 #define MICARRAY_DRIVER_H_
 
 #include "soc.h"
+#include "micarray_dev_ctrl.h"
+#include "micarray_dev_conf_defaults.h"
+
+/*
+ * The type of each sample in the frames received from the mic array.
+ */
+#if MICARRAYCONF_WORD_LENGTH_SHORT
+typedef int16_t micarray_sample_t;
+#else
+typedef int32_t micarray_sample_t;
+#endif
 
 soc_peripheral_t micarray_driver_init(
         int device_id,
@@ -14,4 +25,36 @@ soc_peripheral_t micarray_driver_init(
         int isr_core,
         rtos_irq_isr_t isr);
 
+/*
+ * Changes the size of the frames the mic array sends to
+ * (1 << frame_size_log2) samples, up to MICARRAYCONF_MAX_FRAME_SIZE_LOG2.
+ * If overlap is non-zero each frame repeats the last half of the one
+ * before it, and a frame is sent every half frame. Each DMA frame is
+ * then MICARRAYCONF_DMA_FRAME_SIZE_FOR(frame_size_log2) bytes, so RX
+ * buffers of MICARRAYCONF_DMA_FRAME_SIZE_MAX bytes hold a frame of any
+ * size.
+ *
+ * The device must have a control channel. A few frames are lost while
+ * the decimators restart.
+ */
+void micarray_driver_frame_size_set(
+        soc_peripheral_t dev,
+        unsigned frame_size_log2,
+        int overlap);
+
+/*
+ * Changes the mic array's sample rate. The PDM rate divided by
+ * sample_rate must be 2, 4, 6, 8 or 12, and sample_rate must be no
+ * lower than MICARRAYCONF_MIN_SAMPLE_RATE. With the default 3.072 MHz
+ * PDM clock this allows 48, 24 and 16 kHz, among others. Lower rates
+ * save decimator cycles and DMA bandwidth. Any other consumers of the
+ * samples, such as I2S, are not changed.
+ *
+ * The device must have a control channel. A few frames are lost while
+ * the decimators restart.
+ */
+void micarray_driver_sample_rate_set(
+        soc_peripheral_t dev,
+        unsigned sample_rate);
+
 #endif /* MICARRAY_DRIVER_H_ */
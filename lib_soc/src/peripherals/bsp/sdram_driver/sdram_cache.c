@@ -0,0 +1,243 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#include <string.h>
+
+#include "soc.h"
+#include "xassert.h"
+
+#include "sdram_cache.h"
+
+static unsigned page_address(
+        sdram_cache_t *cache,
+        unsigned page)
+{
+    return cache->base + page * cache->page_words;
+}
+
+static sdram_cache_line_t *line_lookup(
+        sdram_cache_t *cache,
+        unsigned page)
+{
+    for (int i = 0; i < cache->line_count; i++) {
+        sdram_cache_line_t *line = &cache->lines[i];
+        if (line->valid && line->page == page) {
+            return line;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Frees up a line, preferring one that is not in use, and otherwise
+ * the least recently used one, writing it back if it is dirty. The
+ * line being prefetched into is never chosen.
+ */
+static sdram_cache_line_t *line_evict(
+        sdram_cache_t *cache)
+{
+    sdram_cache_line_t *victim = NULL;
+
+    for (int i = 0; i < cache->line_count; i++) {
+        sdram_cache_line_t *line = &cache->lines[i];
+
+        if (line == cache->prefetch_line) {
+            continue;
+        }
+        if (!line->valid) {
+            victim = line;
+            break;
+        }
+        if (victim == NULL || (int) (line->last_use - victim->last_use) < 0) {
+            victim = line;
+        }
+    }
+
+    xassert(victim != NULL);
+
+    if (victim->valid && victim->dirty) {
+        sdram_driver_write(cache->dev, page_address(cache, victim->page), cache->page_words, victim->data);
+    }
+    victim->valid = 0;
+    victim->dirty = 0;
+
+    return victim;
+}
+
+/*
+ * Waits for the prefetch in progress, if there is one, to complete.
+ * Its line then holds a valid page.
+ */
+static void prefetch_wait(
+        sdram_cache_t *cache)
+{
+    sdram_cache_line_t *line = cache->prefetch_line;
+    int length;
+
+    if (line == NULL) {
+        return;
+    }
+
+    while (sdram_driver_read_done_get(cache->dev, &length) == NULL);
+    while (sdram_driver_request_done_get(cache->dev) == NULL);
+
+    line->valid = 1;
+    line->dirty = 0;
+    cache->prefetch_line = NULL;
+}
+
+static void prefetch_start(
+        sdram_cache_t *cache,
+        unsigned page)
+{
+    sdram_cache_line_t *line;
+
+    prefetch_wait(cache);
+
+    if (line_lookup(cache, page) != NULL) {
+        return;
+    }
+
+    line = line_evict(cache);
+    line->page = page;
+    line->last_use = cache->use_clock;
+    cache->prefetch_line = line;
+
+    sdram_driver_read_submit(cache->dev, &cache->prefetch_req, page_address(cache, page), cache->page_words, line->data);
+}
+
+void sdram_cache_init(
+        sdram_cache_t *cache,
+        soc_peripheral_t dev,
+        unsigned base,
+        unsigned page_words,
+        int line_count,
+        void *mem,
+        int prefetch)
+{
+    uint32_t *data;
+
+    xassert(((uintptr_t) mem & 3) == 0);
+    xassert(page_words > 0 && line_count > 0);
+    xassert(!prefetch || (line_count >= 2 && page_words <= SDRAMCONF_DMA_MAX_WORDS));
+
+    cache->dev = dev;
+    cache->base = base;
+    cache->page_words = page_words;
+    cache->line_count = line_count;
+    cache->lines = mem;
+    cache->use_clock = 0;
+    cache->prefetch = prefetch;
+    cache->last_miss = -2;
+    cache->prefetch_line = NULL;
+
+    data = (uint32_t *) &cache->lines[line_count];
+    for (int i = 0; i < line_count; i++) {
+        cache->lines[i].data = data + i * page_words;
+        cache->lines[i].valid = 0;
+        cache->lines[i].dirty = 0;
+        cache->lines[i].last_use = 0;
+    }
+}
+
+uint32_t *sdram_cache_page_get(
+        sdram_cache_t *cache,
+        unsigned page,
+        int write)
+{
+    sdram_cache_line_t *line;
+
+    line = line_lookup(cache, page);
+
+    if (line == NULL) {
+        if (cache->prefetch_line != NULL && cache->prefetch_line->page == page) {
+            line = cache->prefetch_line;
+            prefetch_wait(cache);
+        } else {
+            line = line_evict(cache);
+            sdram_driver_read(cache->dev, page_address(cache, page), cache->page_words, line->data);
+            line->page = page;
+            line->valid = 1;
+        }
+
+        line->last_use = ++cache->use_clock;
+
+        if (cache->prefetch && page == cache->last_miss + 1) {
+            prefetch_start(cache, page + 1);
+        }
+        cache->last_miss = page;
+    } else {
+        line->last_use = ++cache->use_clock;
+    }
+
+    if (write) {
+        line->dirty = 1;
+    }
+
+    return line->data;
+}
+
+void sdram_cache_read(
+        sdram_cache_t *cache,
+        unsigned address,
+        unsigned word_count,
+        void *buffer)
+{
+    uint32_t *p = buffer;
+
+    while (word_count > 0) {
+        unsigned offset = address % cache->page_words;
+        unsigned n = cache->page_words - offset;
+        uint32_t *data;
+
+        if (n > word_count) {
+            n = word_count;
+        }
+
+        data = sdram_cache_page_get(cache, address / cache->page_words, 0);
+        memcpy(p, data + offset, n * sizeof(uint32_t));
+
+        p += n;
+        address += n;
+        word_count -= n;
+    }
+}
+
+void sdram_cache_write(
+        sdram_cache_t *cache,
+        unsigned address,
+        unsigned word_count,
+        const void *buffer)
+{
+    const uint32_t *p = buffer;
+
+    while (word_count > 0) {
+        unsigned offset = address % cache->page_words;
+        unsigned n = cache->page_words - offset;
+        uint32_t *data;
+
+        if (n > word_count) {
+            n = word_count;
+        }
+
+        data = sdram_cache_page_get(cache, address / cache->page_words, 1);
+        memcpy(data + offset, p, n * sizeof(uint32_t));
+
+        p += n;
+        address += n;
+        word_count -= n;
+    }
+}
+
+void sdram_cache_flush(
+        sdram_cache_t *cache)
+{
+    for (int i = 0; i < cache->line_count; i++) {
+        sdram_cache_line_t *line = &cache->lines[i];
+
+        if (line->valid && line->dirty) {
+            sdram_driver_write(cache->dev, page_address(cache, line->page), cache->page_words, line->data);
+            line->dirty = 0;
+        }
+    }
+}
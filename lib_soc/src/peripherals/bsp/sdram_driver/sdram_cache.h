@@ -0,0 +1,111 @@
+// Copyright (c) 2019, XMOS Ltd, All rights reserved
+
+#ifndef SDRAM_CACHE_H_
+#define SDRAM_CACHE_H_
+
+#include "soc.h"
+#include "sdram_driver.h"
+
+/*
+ * A write-back cache of fixed size pages of SDRAM, held in SRAM.
+ *
+ * The SDRAM is divided into pages of page_words words, starting at
+ * the SDRAM word address base. Pages are brought into the cache's
+ * lines when they are accessed. When no line is free the least
+ * recently used one is given up, and written back first if it is
+ * dirty.
+ *
+ * When prefetching is enabled, a miss on the page after the last one
+ * missed also starts a read of the page after it, using the SDRAM
+ * device's DMA rings, so that a sequential scan finds each page
+ * already on its way. The device must then have been initialized with
+ * at least one RX and one TX descriptor, and its ISR must not take
+ * any buffers from its rings, as the cache polls for them itself.
+ *
+ * A cache is not safe to use from more than one task at a time
+ * without a lock around it.
+ */
+
+typedef struct {
+    uint32_t *data;
+    unsigned page;
+    unsigned last_use;
+    uint8_t valid;
+    uint8_t dirty;
+} sdram_cache_line_t;
+
+typedef struct {
+    soc_peripheral_t dev;
+    unsigned base;
+    unsigned page_words;
+    int line_count;
+    sdram_cache_line_t *lines;
+    unsigned use_clock;
+
+    int prefetch;
+    unsigned last_miss;
+    sdram_cache_line_t *prefetch_line;
+    sdram_driver_request_t prefetch_req;
+} sdram_cache_t;
+
+/*
+ * The number of bytes of memory that must be given to sdram_cache_init()
+ * for line_count lines of page_words words.
+ */
+#define SDRAM_CACHE_MEM_SIZE(page_words, line_count) \
+    ((line_count) * (sizeof(sdram_cache_line_t) + (page_words) * sizeof(uint32_t)))
+
+/*
+ * Initializes a cache of line_count lines of page_words words, carved
+ * out of mem. mem must be word aligned and at least
+ * SDRAM_CACHE_MEM_SIZE(page_words, line_count) bytes. With prefetch,
+ * page_words must be no more than SDRAMCONF_DMA_MAX_WORDS.
+ */
+void sdram_cache_init(
+        sdram_cache_t *cache,
+        soc_peripheral_t dev,
+        unsigned base,
+        unsigned page_words,
+        int line_count,
+        void *mem,
+        int prefetch);
+
+/*
+ * Returns a pointer to the cached copy of a page, reading it in first
+ * if it is not in the cache. If it is to be written to, write must be
+ * non-zero so that it is written back. The pointer is only valid
+ * until the next call made on the cache.
+ */
+uint32_t *sdram_cache_page_get(
+        sdram_cache_t *cache,
+        unsigned page,
+        int write);
+
+/*
+ * Reads word_count words starting at the word offset address,
+ * relative to the cache's base, through the cache.
+ */
+void sdram_cache_read(
+        sdram_cache_t *cache,
+        unsigned address,
+        unsigned word_count,
+        void *buffer);
+
+/*
+ * Writes word_count words starting at the word offset address,
+ * relative to the cache's base, through the cache. They reach the
+ * SDRAM once their page is given up or the cache is flushed.
+ */
+void sdram_cache_write(
+        sdram_cache_t *cache,
+        unsigned address,
+        unsigned word_count,
+        const void *buffer);
+
+/*
+ * Writes back every dirty page. The pages stay in the cache.
+ */
+void sdram_cache_flush(
+        sdram_cache_t *cache);
+
+#endif /* SDRAM_CACHE_H_ */
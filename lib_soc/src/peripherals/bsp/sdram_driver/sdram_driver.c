@@ -20,6 +20,10 @@ int sdram_driver_write(
 {
     int dummy;
     chanend c = soc_peripheral_ctrl_chanend(dev);
+    uint32_t *p = buffer;
+    unsigned n;
+
+    soc_bsp_ctrl_lock(dev);
 
     soc_peripheral_function_code_tx(c, SDRAM_DEV_WRITE);
 
@@ -28,15 +32,25 @@ int sdram_driver_write(
             sizeof(address), &address,
             sizeof(word_count), &word_count);
 
-    soc_peripheral_varlist_tx(
-            c, 1,
-            word_count, buffer);
+    /* The device pipelines the write in chunks */
+    while (word_count > 0) {
+        n = word_count < SDRAMCONF_PIPELINE_WORDS ? word_count : SDRAMCONF_PIPELINE_WORDS;
+
+        soc_peripheral_varlist_tx(
+                c, 1,
+                n * sizeof(uint32_t), p);
+
+        p += n;
+        word_count -= n;
+    }
 
     /* RX something to know that the write was complete */
     soc_peripheral_varlist_rx(
             c, 1,
             sizeof( dummy ), &dummy);
 
+    soc_bsp_ctrl_unlock(dev);
+
     return 1;
 }
 
@@ -48,6 +62,10 @@ int sdram_driver_read(
         )
 {
     chanend c = soc_peripheral_ctrl_chanend(dev);
+    uint32_t *p = buffer;
+    unsigned n;
+
+    soc_bsp_ctrl_lock(dev);
 
     soc_peripheral_function_code_tx(c, SDRAM_DEV_READ);
 
@@ -56,13 +74,145 @@ int sdram_driver_read(
             sizeof(address), &address,
             sizeof(word_count), &word_count);
 
-    soc_peripheral_varlist_rx(
+    /* The device pipelines the read in chunks */
+    while (word_count > 0) {
+        n = word_count < SDRAMCONF_PIPELINE_WORDS ? word_count : SDRAMCONF_PIPELINE_WORDS;
+
+        soc_peripheral_varlist_rx(
+                c, 1,
+                n * sizeof(uint32_t), p);
+
+        p += n;
+        word_count -= n;
+    }
+
+    soc_bsp_ctrl_unlock(dev);
+
+    return 1;
+}
+
+int sdram_driver_read_scatter(
+        soc_peripheral_t dev,
+        unsigned extent_count,
+        const sdram_driver_extent_t *extents,
+        void *buffer
+        )
+{
+    chanend c = soc_peripheral_ctrl_chanend(dev);
+    uint32_t *p = buffer;
+    unsigned word_count;
+    unsigned n;
+
+    xassert(extent_count <= SDRAMCONF_SCATTER_MAX_EXTENTS);
+
+    soc_bsp_ctrl_lock(dev);
+
+    soc_peripheral_function_code_tx(c, SDRAM_DEV_READ_SCATTER);
+
+    soc_peripheral_varlist_tx(
+            c, 1,
+            sizeof(extent_count), &extent_count);
+
+    soc_peripheral_varlist_tx(
             c, 1,
-            word_count, buffer);
+            extent_count * sizeof(sdram_driver_extent_t), extents);
+
+    /* The device sends each extent in chunks, just as for a single read */
+    for (int i = 0; i < extent_count; i++) {
+        word_count = extents[i].word_count;
+
+        while (word_count > 0) {
+            n = word_count < SDRAMCONF_PIPELINE_WORDS ? word_count : SDRAMCONF_PIPELINE_WORDS;
+
+            soc_peripheral_varlist_rx(
+                    c, 1,
+                    n * sizeof(uint32_t), p);
+
+            p += n;
+            word_count -= n;
+        }
+    }
+
+    soc_bsp_ctrl_unlock(dev);
 
     return 1;
 }
 
+void sdram_driver_write_submit(
+        soc_peripheral_t dev,
+        sdram_driver_request_t *req,
+        unsigned address,
+        unsigned word_count,
+        void *buffer)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+
+    xassert(word_count <= SDRAMCONF_DMA_MAX_WORDS);
+
+    req->header[SDRAM_DEV_DMA_HEADER_CMD] = SDRAM_DEV_WRITE;
+    req->header[SDRAM_DEV_DMA_HEADER_ADDRESS] = address;
+    req->header[SDRAM_DEV_DMA_HEADER_WORD_COUNT] = word_count;
+
+    /*
+     * The header goes last, so that the data lands at the start of the
+     * device's buffer. It is given to the ring before the data so that
+     * the frame is complete once the first descriptor is.
+     */
+    soc_dma_ring_tx_buf_sg_set(tx_ring_buf, req->header, sizeof(req->header), 1, 2);
+    soc_dma_ring_tx_buf_sg_set(tx_ring_buf, buffer, word_count * sizeof(uint32_t), 0, 2);
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+}
+
+void sdram_driver_read_submit(
+        soc_peripheral_t dev,
+        sdram_driver_request_t *req,
+        unsigned address,
+        unsigned word_count,
+        void *buffer)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+
+    xassert(word_count <= SDRAMCONF_DMA_MAX_WORDS);
+
+    /* Reads complete in order, so their buffers are used in order too */
+    soc_dma_ring_rx_buf_set(rx_ring_buf, buffer, word_count * sizeof(uint32_t));
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_RX_REQUEST);
+
+    req->header[SDRAM_DEV_DMA_HEADER_CMD] = SDRAM_DEV_READ;
+    req->header[SDRAM_DEV_DMA_HEADER_ADDRESS] = address;
+    req->header[SDRAM_DEV_DMA_HEADER_WORD_COUNT] = word_count;
+
+    soc_dma_ring_tx_buf_set(tx_ring_buf, req->header, sizeof(req->header));
+    soc_peripheral_hub_dma_request(dev, SOC_DMA_TX_REQUEST);
+}
+
+sdram_driver_request_t *sdram_driver_request_done_get(
+        soc_peripheral_t dev)
+{
+    soc_dma_ring_buf_t *tx_ring_buf = soc_peripheral_tx_dma_ring_buf(dev);
+    void *buf;
+    int more;
+
+    buf = soc_dma_ring_tx_buf_get(tx_ring_buf, NULL, &more);
+
+    /* The header is always the last buffer of its frame */
+    while (buf != NULL && more) {
+        buf = soc_dma_ring_tx_buf_get(tx_ring_buf, NULL, &more);
+    }
+
+    return buf;
+}
+
+void *sdram_driver_read_done_get(
+        soc_peripheral_t dev,
+        int *length)
+{
+    soc_dma_ring_buf_t *rx_ring_buf = soc_peripheral_rx_dma_ring_buf(dev);
+
+    return soc_dma_ring_rx_buf_get(rx_ring_buf, length);
+}
+
 soc_peripheral_t sdram_driver_init(
         int device_id,
         int rx_desc_count,
@@ -78,5 +228,14 @@ soc_peripheral_t sdram_driver_init(
 
     device = bitstream_sdram_devices[device_id];
 
+    soc_peripheral_common_dma_init(
+            device,
+            rx_desc_count,
+            rx_buf_size,
+            tx_desc_count,
+            app_data,
+            isr_core,
+            isr);
+
     return device;
 }
@@ -5,6 +5,24 @@
 
 #include "soc.h"
 #include "sdram_dev_ctrl.h"
+#include "sdram_dev_conf_defaults.h"
+
+/*
+ * One extent of a scatter read.
+ */
+typedef struct {
+    unsigned address;
+    unsigned word_count;
+} sdram_driver_extent_t;
+
+/*
+ * The header of a read or write request made over the DMA rings.
+ * It must stay valid until the request is given back by
+ * sdram_driver_request_done_get().
+ */
+typedef struct {
+    uint32_t header[SDRAM_DEV_DMA_HEADER_WORDS];
+} sdram_driver_request_t;
 
 int sdram_driver_write(
         soc_peripheral_t dev,
@@ -20,6 +38,70 @@ int sdram_driver_read(
         void *buffer
         );
 
+/*
+ * Reads each of the extent_count extents, of which there may be up
+ * to SDRAMCONF_SCATTER_MAX_EXTENTS, into buffer one after the other,
+ * as a single request to the device.
+ */
+int sdram_driver_read_scatter(
+        soc_peripheral_t dev,
+        unsigned extent_count,
+        const sdram_driver_extent_t *extents,
+        void *buffer
+        );
+
+/*
+ * Queues a write of word_count words from buffer to the SDRAM at
+ * address, and returns without waiting for it. Several reads and
+ * writes may be queued at once, up to the number of TX descriptors,
+ * with each write using two of them. They are carried out in order.
+ *
+ * The ISR is sent SOC_PERIPHERAL_ISR_DMA_TX_DONE_BM once the request,
+ * and buffer, have been taken by the device, after which the request
+ * may be got back with sdram_driver_request_done_get().
+ */
+void sdram_driver_write_submit(
+        soc_peripheral_t dev,
+        sdram_driver_request_t *req,
+        unsigned address,
+        unsigned word_count,
+        void *buffer);
+
+/*
+ * Queues a read of word_count words from the SDRAM at address into
+ * buffer, and returns without waiting for it. The ISR is sent
+ * SOC_PERIPHERAL_ISR_DMA_RX_DONE_BM once the data is in buffer, after
+ * which it may be got with sdram_driver_read_done_get(). The request
+ * itself is given back by sdram_driver_request_done_get() once it
+ * has been taken by the device.
+ */
+void sdram_driver_read_submit(
+        soc_peripheral_t dev,
+        sdram_driver_request_t *req,
+        unsigned address,
+        unsigned word_count,
+        void *buffer);
+
+/*
+ * Returns the next request that the device has taken, so that it may
+ * be reused, or NULL if there is none.
+ */
+sdram_driver_request_t *sdram_driver_request_done_get(
+        soc_peripheral_t dev);
+
+/*
+ * Returns the buffer of the next read that has completed, and its
+ * length in bytes in *length, or NULL if there is none.
+ */
+void *sdram_driver_read_done_get(
+        soc_peripheral_t dev,
+        int *length);
+
+/*
+ * Initializes the DMA rings used by sdram_driver_write_submit() and
+ * sdram_driver_read_submit(). As read buffers are given with each
+ * request, rx_buf_size should normally be 0.
+ */
 soc_peripheral_t sdram_driver_init(
         int device_id,
         int rx_desc_count,